@@ -0,0 +1,273 @@
+/*
+ * File: arena.c
+ *
+ * Author: Mike Swift
+ * Email: theycallmeswift@gmail.com
+ * Date Created: May 11th, 2011
+ * Date Modified: May 11th, 2011
+ */
+
+/********************************
+ *          1. Includes         *
+ ********************************/
+
+#include "arena.h"
+
+/********************************
+ *          2. Structs          *
+ ********************************/
+
+/* ArenaAlign_
+ *
+ * Every allocation is rounded up to a multiple of this union so
+ * it is aligned for any type.
+ */
+
+union ArenaAlign_ {
+    long l;
+    double d;
+    void *p;
+};
+
+/* Chunk_
+ *
+ * @param   next        next chunk in the arena
+ * @param   size        usable bytes in the chunk
+ *
+ * The memory follows the header in the same allocation.
+ */
+
+struct Chunk_ {
+    Chunk next;
+    size_t size;
+    union ArenaAlign_ align;
+};
+
+/* Arena_
+ *
+ * @param   chunkSize   default size of a chunk
+ * @param   head        first chunk
+ * @param   curr        chunk being bumped through
+ * @param   used        bytes used in curr
+ */
+
+struct Arena_ {
+    size_t chunkSize;
+    Chunk head;
+    Chunk curr;
+    size_t used;
+};
+
+/********************************
+ *      3. Helper Functions     *
+ ********************************/
+
+/* createChunk
+ *
+ * Allocates a chunk big enough for size bytes and links it in
+ * right after the current chunk.
+ *
+ * @param   arena       arena to grow
+ * @param   size        minimum usable size
+ *
+ * @return  success     new Chunk
+ * @return  failure     NULL
+ */
+
+Chunk createChunk(Arena arena, size_t size)
+{
+    Chunk chunk;
+    
+    if(size < arena->chunkSize)
+    {
+        size = arena->chunkSize;
+    }
+    
+    chunk = (Chunk) malloc(sizeof(struct Chunk_) + size);
+    if(chunk == NULL)
+    {
+        fprintf(stderr, "Error: Could not allocate space for arena chunk.\n");
+        return NULL;
+    }
+    
+    chunk->size = size;
+    
+    if(arena->curr == NULL)
+    {
+        chunk->next = arena->head;
+        arena->head = chunk;
+    }
+    else
+    {
+        chunk->next = arena->curr->next;
+        arena->curr->next = chunk;
+    }
+    
+    return chunk;
+}
+
+/********************************
+ *      4. Arena Functions      *
+ ********************************/
+
+/* createArena
+ *
+ * Creates a bump allocator. Allocations are carved out of large
+ * chunks in order and are never freed one at a time; the whole
+ * arena is reset or destroyed at once.
+ *
+ * @param   chunkSize       size of each chunk in bytes
+ *
+ * @return  success         new Arena
+ * @return  failure         NULL
+ */
+
+Arena createArena(size_t chunkSize)
+{
+    Arena arena;
+    
+    if(chunkSize == 0)
+    {
+        fprintf(stderr, "Error: Arena chunks must have a size.\n");
+        return NULL;
+    }
+    
+    arena = (Arena) malloc(sizeof(struct Arena_));
+    if(arena == NULL)
+    {
+        fprintf(stderr, "Error: Could not allocate space for arena.\n");
+        return NULL;
+    }
+    
+    arena->chunkSize = chunkSize;
+    arena->head = NULL;
+    arena->curr = NULL;
+    arena->used = 0;
+    
+    return arena;
+}
+
+/* destroyArena
+ *
+ * Frees every chunk in the arena. NULL is ignored.
+ *
+ * @param   arena           arena to destroy
+ *
+ * @return  void
+ */
+
+void destroyArena(Arena arena)
+{
+    Chunk curr, next;
+    
+    if(arena != NULL)
+    {
+        curr = arena->head;
+        while(curr != NULL)
+        {
+            next = curr->next;
+            free(curr);
+            curr = next;
+        }
+        
+        free(arena);
+    }
+}
+
+/* arenaAlloc
+ *
+ * Bumps out size bytes, aligned for any type. Requests larger
+ * than a chunk get a chunk of their own.
+ *
+ * @param   arena           arena to allocate from
+ * @param   size            number of bytes
+ *
+ * @return  success         pointer to the memory
+ * @return  failure         NULL
+ */
+
+void *arenaAlloc(Arena arena, size_t size)
+{
+    void *ptr;
+    size_t align;
+    
+    if(arena == NULL)
+    {
+        fprintf(stderr, "Error: Cannot allocate from NULL arena.\n");
+        return NULL;
+    }
+    
+    align = sizeof(union ArenaAlign_);
+    size = ((size + align - 1) / align) * align;
+    
+    if(arena->curr == NULL || arena->used + size > arena->curr->size)
+    {
+        /* Step into the chunk kept from before the last reset, if it fits */
+        if(arena->curr == NULL && arena->head != NULL && arena->head->size >= size)
+        {
+            arena->curr = arena->head;
+        }
+        else if(arena->curr != NULL && arena->curr->next != NULL && arena->curr->next->size >= size)
+        {
+            arena->curr = arena->curr->next;
+        }
+        else
+        {
+            arena->curr = createChunk(arena, size);
+            if(arena->curr == NULL)
+            {
+                return NULL;
+            }
+        }
+        
+        arena->used = 0;
+    }
+    
+    ptr = (char*) &arena->curr->align + arena->used;
+    arena->used += size;
+    
+    return ptr;
+}
+
+/* arenaString
+ *
+ * Copies a string into the arena.
+ *
+ * @param   arena           arena to allocate from
+ * @param   str             string to copy
+ *
+ * @return  success         copy of str
+ * @return  failure         NULL
+ */
+
+char *arenaString(Arena arena, char *str)
+{
+    char *copy;
+    
+    copy = (char*) arenaAlloc(arena, strlen(str) + 1);
+    if(copy != NULL)
+    {
+        strcpy(copy, str);
+    }
+    
+    return copy;
+}
+
+/* resetArena
+ *
+ * Forgets every allocation in O(1). The chunks are kept and
+ * bumped through again by the next round of allocations.
+ *
+ * @param   arena           arena to reset
+ *
+ * @return  void
+ */
+
+void resetArena(Arena arena)
+{
+    if(arena != NULL)
+    {
+        arena->curr = NULL;
+        arena->used = 0;
+    }
+}
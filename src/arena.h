@@ -0,0 +1,105 @@
+/*
+ * File: arena.h
+ *
+ * Author: Mike Swift
+ * Email: theycallmeswift@gmail.com
+ * Date Created: May 11th, 2011
+ * Date Modified: May 11th, 2011
+ */
+
+#ifndef SWIFT_ARENA_H_
+#define SWIFT_ARENA_H_
+
+/********************************
+ *          1. Includes         *
+ ********************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/********************************
+ *          2. Constants        *
+ ********************************/
+
+/* Default size of each chunk the arena bumps through */
+#define ARENA_CHUNK_SIZE 65536
+
+/********************************
+ *      3. Structs & Typedefs   *
+ ********************************/
+
+struct Chunk_;
+typedef struct Chunk_* Chunk;
+
+struct Arena_;
+typedef struct Arena_* Arena;
+
+/********************************
+ *      4. Arena Functions      *
+ ********************************/
+
+/* createArena
+ *
+ * Creates a bump allocator. Allocations are carved out of large
+ * chunks in order and are never freed one at a time; the whole
+ * arena is reset or destroyed at once.
+ *
+ * @param   chunkSize       size of each chunk in bytes
+ *
+ * @return  success         new Arena
+ * @return  failure         NULL
+ */
+
+Arena createArena(size_t chunkSize);
+
+/* destroyArena
+ *
+ * Frees every chunk in the arena. NULL is ignored.
+ *
+ * @param   arena           arena to destroy
+ *
+ * @return  void
+ */
+
+void destroyArena(Arena arena);
+
+/* arenaAlloc
+ *
+ * Bumps out size bytes, aligned for any type. Requests larger
+ * than a chunk get a chunk of their own.
+ *
+ * @param   arena           arena to allocate from
+ * @param   size            number of bytes
+ *
+ * @return  success         pointer to the memory
+ * @return  failure         NULL
+ */
+
+void *arenaAlloc(Arena arena, size_t size);
+
+/* arenaString
+ *
+ * Copies a string into the arena.
+ *
+ * @param   arena           arena to allocate from
+ * @param   str             string to copy
+ *
+ * @return  success         copy of str
+ * @return  failure         NULL
+ */
+
+char *arenaString(Arena arena, char *str);
+
+/* resetArena
+ *
+ * Forgets every allocation in O(1). The chunks are kept and
+ * bumped through again by the next round of allocations.
+ *
+ * @param   arena           arena to reset
+ *
+ * @return  void
+ */
+
+void resetArena(Arena arena);
+
+#endif /* SWIFT_ARENA_H_ */
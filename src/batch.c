@@ -0,0 +1,189 @@
+/*
+ * File: batch.c
+ *
+ * Author: Mike Swift
+ * Email: theycallmeswift@gmail.com
+ * Date Created: May 15th, 2011
+ * Date Modified: May 15th, 2011
+ */
+
+/********************************
+ *          1. Includes         *
+ ********************************/
+
+#include "batch.h"
+
+/********************************
+ *      2. Batch Functions      *
+ ********************************/
+
+/* answerBatch
+ *
+ * Runs a batch of queries the way the REPL would (see search),
+ * with the postings of their terms fetched once for all of them
+ * (see loadBatch), and writes out every result as it comes, one
+ * line each, best first within a query:
+ *
+ *      <query number> TAB <rank> TAB <score> TAB <path>
+ *
+ * Queries are numbered by their line in the file and ranks start
+ * at 1. A query with no results writes nothing, a line that is
+ * not a query is reported on stderr. An index written anew since
+ * it was opened is opened again for the batch, with a word cache
+ * of its own (see currentIndex).
+ *
+ * @param   queries     the batch, one query per line
+ * @param   numqueries  number of queries
+ * @param   first       number of the first query
+ * @param   files       filelist object
+ * @param   cache       Cache object
+ * @param   out         where to write the results
+ *
+ * @return  success     1
+ * @return  failure     0
+ */
+
+int answerBatch(char **queries, int numqueries, int first, Filelist files, Cache cache, FILE *out)
+{
+    char path[MAX_BUFFER_SIZE];
+    Filelist current;
+    Cache words;
+    Result result;
+    int i, rank;
+    
+    words = cache;
+    current = currentIndex(files, &words);
+    
+    if(loadBatch(current, queries, numqueries) < 0)
+    {
+        if(current != files)
+        {
+            destroyFilelist(current);
+            destroyCache(words);
+        }
+        return 0;
+    }
+    
+    for(i = 0; i < numqueries; i++)
+    {
+        if(queries[i][0] == 's' && (queries[i][1] == 'o' || queries[i][1] == 'a'))
+        {
+            search(queries[i], current->tok, current, words);
+        }
+        else if(queries[i][0] != '\n')
+        {
+            fprintf(stderr, "Error: Line %d is not a query.\n", first + i);
+        }
+        
+        rank = 0;
+        for(result = current->results; result != NULL; result = result->next)
+        {
+            if(result->frequency >= 0 && getFilename(current, result->filenum, path, MAX_BUFFER_SIZE) != NULL)
+            {
+                rank++;
+                fprintf(out, "%d\t%d\t%f\t%s\n", first + i, rank, result->score, path);
+            }
+        }
+        
+        resetResults(current);
+    }
+    
+    clearBatch(current);
+    
+    if(current != files)
+    {
+        destroyFilelist(current);
+        destroyCache(words);
+    }
+    
+    return 1;
+}
+
+/* runBatch
+ *
+ * Answers every query in a file, BATCH_QUERIES at a time (see
+ * answerBatch), and writes the results to stdout.
+ *
+ * @param   path        file of queries, "so ..." or "sa ..." per
+ *                      line, "-" for stdin
+ * @param   files       filelist object
+ * @param   cache       Cache object
+ *
+ * @return  success     1
+ * @return  failure     0
+ */
+
+int runBatch(char *path, Filelist files, Cache cache)
+{
+    FILE *in;
+    char *lines, *queries[BATCH_QUERIES];
+    int count, first, res, n, c;
+    
+    in = (strcmp(path, "-") == 0) ? stdin : fopen(path, "r");
+    if(in == NULL)
+    {
+        fprintf(stderr, "Error: Could not open %s.\n", path);
+        return 0;
+    }
+    
+    lines = (char*) malloc(BATCH_QUERIES * BATCH_LINE);
+    if(lines == NULL)
+    {
+        fprintf(stderr, "Error: Could not allocate space for a batch.\n");
+        if(in != stdin)
+        {
+            fclose(in);
+        }
+        return 0;
+    }
+    
+    first = 1;
+    res = 1;
+    
+    while(res == 1)
+    {
+        for(count = 0; count < BATCH_QUERIES; count++)
+        {
+            queries[count] = lines + count * BATCH_LINE;
+            if(fgets(queries[count], BATCH_LINE, in) == NULL)
+            {
+                break;
+            }
+            
+            /* Ended with a newline, like a line the REPL reads */
+            n = strlen(queries[count]);
+            if(n + 1 < BATCH_LINE && (n == 0 || queries[count][n - 1] != '\n'))
+            {
+                strcat(queries[count], "\n");
+            }
+            else if(queries[count][n - 1] != '\n')
+            {
+                /* Too long, the rest of the line is dropped so the numbers stay right */
+                fprintf(stderr, "Error: Line %d is too long, cut to %d characters.\n", first + count, BATCH_LINE - 2);
+                queries[count][n - 1] = '\n';
+                
+                while((c = fgetc(in)) != EOF && c != '\n')
+                {
+                }
+            }
+        }
+        
+        if(count == 0)
+        {
+            break;
+        }
+        
+        res = answerBatch(queries, count, first, files, cache, stdout);
+        first += count;
+    }
+    
+    fflush(stdout);
+    free(lines);
+    
+    if(in != stdin)
+    {
+        fclose(in);
+    }
+    
+    return res;
+}
@@ -0,0 +1,77 @@
+/*
+ * File: batch.h
+ *
+ * Author: Mike Swift
+ * Email: theycallmeswift@gmail.com
+ * Date Created: May 15th, 2011
+ * Date Modified: May 15th, 2011
+ */
+
+#ifndef SWIFT_BATCH_H_
+#define SWIFT_BATCH_H_
+
+/********************************
+ *          1. Includes         *
+ ********************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "csearch.h"
+
+/********************************
+ *          2. Constants        *
+ ********************************/
+
+/* Queries whose terms are fetched together, more are run in several batches */
+#define BATCH_QUERIES 4096
+
+/* Longest query line, same as the REPL */
+#define BATCH_LINE 1024
+
+/********************************
+ *      3. Batch Functions      *
+ ********************************/
+
+/* answerBatch
+ *
+ * Runs a batch of queries the way the REPL would (see search),
+ * with the postings of their terms fetched once for all of them
+ * (see loadBatch), and writes out every result as it comes, one
+ * line each, best first within a query:
+ *
+ *      <query number> TAB <rank> TAB <score> TAB <path>
+ *
+ * Queries are numbered by their line in the file and ranks start
+ * at 1. A query with no results writes nothing, a line that is
+ * not a query is reported on stderr.
+ *
+ * @param   queries     the batch, one query per line
+ * @param   numqueries  number of queries
+ * @param   first       number of the first query
+ * @param   files       filelist object
+ * @param   cache       Cache object
+ * @param   out         where to write the results
+ *
+ * @return  success     1
+ * @return  failure     0
+ */
+
+int answerBatch(char **queries, int numqueries, int first, Filelist files, Cache cache, FILE *out);
+
+/* runBatch
+ *
+ * Answers every query in a file, BATCH_QUERIES at a time (see
+ * answerBatch), and writes the results to stdout.
+ *
+ * @param   path        file of queries, "so ..." or "sa ..." per
+ *                      line, "-" for stdin
+ * @param   files       filelist object
+ * @param   cache       Cache object
+ *
+ * @return  success     1
+ * @return  failure     0
+ */
+
+int runBatch(char *path, Filelist files, Cache cache);
+
+#endif /* SWIFT_BATCH_H_ */
@@ -0,0 +1,154 @@
+/*
+ * File: blockmax.c
+ *
+ * Author: Mike Swift
+ * Email: theycallmeswift@gmail.com
+ * Date Created: May 15th, 2011
+ * Date Modified: May 15th, 2011
+ */
+
+/********************************
+ *          1. Includes         *
+ ********************************/
+
+#include "blockmax.h"
+
+/********************************
+ *      2. Block Functions      *
+ ********************************/
+
+/* writeBlockMaxima
+ *
+ * Cuts the postings of a word, in file number order, into blocks
+ * of BLOCK_SIZE and writes a summary of each to the block stream:
+ *
+ *      #blocks
+ *      per block: gap to the last file of the previous block,
+ *                 highest frequency in the block
+ *
+ * Every number is written with writeVByte. The highest frequency
+ * bounds the score any file of the block can get from the word,
+ * which lets top-k searches skip whole blocks.
+ *
+ * @param   file            block stream
+ * @param   word            word about to be written to the index
+ *
+ * @return  success         offset the summary starts at
+ * @return  failure         -1
+ */
+
+long writeBlockMaxima(FILE *file, Word word)
+{
+    Entry ent, *entries;
+    long offset;
+    int i, n, max, last;
+    
+    if(file == NULL || word == NULL)
+    {
+        fprintf(stderr, "Error: Cannot write blocks of NULL word.\n");
+        return -1;
+    }
+    
+    n = 0;
+    for(ent = word->head; ent != NULL; ent = ent->next)
+    {
+        n++;
+    }
+    
+    entries = (Entry*) malloc(sizeof(Entry) * (n + 1));
+    if(entries == NULL)
+    {
+        fprintf(stderr, "Error: Could not allocate space for blocks.\n");
+        return -1;
+    }
+    
+    i = 0;
+    for(ent = word->head; ent != NULL; ent = ent->next)
+    {
+        entries[i] = ent;
+        i++;
+    }
+    
+    /* The index keeps postings by frequency, blocks go by file */
+    qsort(entries, n, sizeof(Entry), compEntryFiles);
+    
+    offset = ftell(file);
+    
+    if(writeVByte(file, NUM_BLOCKS(n)) == 0)
+    {
+        free(entries);
+        return -1;
+    }
+    
+    last = 0;
+    max = 0;
+    
+    for(i = 0; i < n; i++)
+    {
+        if(entries[i]->frequency > max)
+        {
+            max = entries[i]->frequency;
+        }
+        
+        /* Close the block on its last posting */
+        if(i % BLOCK_SIZE == BLOCK_SIZE - 1 || i == n - 1)
+        {
+            if(writeVByte(file, entries[i]->filenumber - last) == 0 || writeVByte(file, max) == 0)
+            {
+                free(entries);
+                return -1;
+            }
+            
+            last = entries[i]->filenumber;
+            max = 0;
+        }
+    }
+    
+    free(entries);
+    
+    return offset;
+}
+
+/* readBlockMaxima
+ *
+ * Reads back the summary written by writeBlockMaxima.
+ *
+ * @param   file            block stream
+ * @param   offset          offset the summary starts at
+ * @param   last            where to store the last file of each block
+ * @param   max             where to store the highest frequency of
+ *                          each block
+ * @param   size            room in last and max
+ *
+ * @return  success         number of blocks
+ * @return  failure         -1
+ */
+
+int readBlockMaxima(FILE *file, long offset, int *last, int *max, int size)
+{
+    unsigned int count, gap, freq;
+    int i, doc;
+    
+    if(file == NULL || fseek(file, offset, SEEK_SET) != 0 || readVByte(file, &count) == 0 || (int) count > size)
+    {
+        fprintf(stderr, "Error: Malformed block file.\n");
+        return -1;
+    }
+    
+    doc = 0;
+    
+    for(i = 0; i < (int) count; i++)
+    {
+        if(readVByte(file, &gap) == 0 || readVByte(file, &freq) == 0)
+        {
+            fprintf(stderr, "Error: Malformed block file.\n");
+            return -1;
+        }
+        
+        doc += gap;
+        last[i] = doc;
+        max[i] = freq;
+    }
+    
+    return count;
+}
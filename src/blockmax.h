@@ -0,0 +1,78 @@
+/*
+ * File: blockmax.h
+ *
+ * Author: Mike Swift
+ * Email: theycallmeswift@gmail.com
+ * Date Created: May 15th, 2011
+ * Date Modified: May 15th, 2011
+ */
+
+#ifndef SWIFT_BLOCKMAX_H_
+#define SWIFT_BLOCKMAX_H_
+
+/********************************
+ *          1. Includes         *
+ ********************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "postings.h"
+#include "words.h"
+
+/********************************
+ *          2. Constants        *
+ ********************************/
+
+/* Binary stream of per block maximum frequencies next to an inverted index */
+#define BLOCKMAX_SUFFIX ".bmx"
+
+/* Number of postings (in file number order) summed up by one block */
+#define BLOCK_SIZE 64
+
+/* Number of blocks a list of n postings is cut into */
+#define NUM_BLOCKS(n) (((n) + BLOCK_SIZE - 1) / BLOCK_SIZE)
+
+/********************************
+ *      3. Block Functions      *
+ ********************************/
+
+/* writeBlockMaxima
+ *
+ * Cuts the postings of a word, in file number order, into blocks
+ * of BLOCK_SIZE and writes a summary of each to the block stream:
+ *
+ *      #blocks
+ *      per block: gap to the last file of the previous block,
+ *                 highest frequency in the block
+ *
+ * Every number is written with writeVByte. The highest frequency
+ * bounds the score any file of the block can get from the word,
+ * which lets top-k searches skip whole blocks.
+ *
+ * @param   file            block stream
+ * @param   word            word about to be written to the index
+ *
+ * @return  success         offset the summary starts at
+ * @return  failure         -1
+ */
+
+long writeBlockMaxima(FILE *file, Word word);
+
+/* readBlockMaxima
+ *
+ * Reads back the summary written by writeBlockMaxima.
+ *
+ * @param   file            block stream
+ * @param   offset          offset the summary starts at
+ * @param   last            where to store the last file of each block
+ * @param   max             where to store the highest frequency of
+ *                          each block
+ * @param   size            room in last and max
+ *
+ * @return  success         number of blocks
+ * @return  failure         -1
+ */
+
+int readBlockMaxima(FILE *file, long offset, int *last, int *max, int size);
+
+#endif /* SWIFT_BLOCKMAX_H_ */
@@ -0,0 +1,348 @@
+/*
+ * File: bloom.c
+ *
+ * Author: Mike Swift
+ * Email: theycallmeswift@gmail.com
+ * Date Created: May 15th, 2011
+ * Date Modified: May 15th, 2011
+ */
+
+/********************************
+ *          1. Includes         *
+ ********************************/
+
+#include "bloom.h"
+
+/********************************
+ *          2. Structs          *
+ ********************************/
+
+/* Bloom_
+ *
+ * A filter being built only holds the hashes of its terms, a
+ * loaded one only its bits.
+ *
+ * @param   keys        hash of every term added
+ * @param   count       number of terms added
+ * @param   capacity    number of terms there is room for
+ * @param   bits        the filter, numbits / 8 bytes
+ * @param   numbits     number of bits, a multiple of 8
+ * @param   numhashes   number of bits set for each term
+ */
+
+struct Bloom_ {
+    unsigned int *keys;
+    int count;
+    int capacity;
+    unsigned char *bits;
+    unsigned int numbits;
+    unsigned int numhashes;
+};
+
+/********************************
+ *      3. Helper Functions     *
+ ********************************/
+
+/* hashTerm
+ *
+ * 32 bit FNV-1a hash of a term.
+ *
+ * @param   term        term to hash
+ *
+ * @return  unsigned int    the hash
+ */
+
+unsigned int hashTerm(char *term)
+{
+    unsigned int h;
+    
+    h = 2166136261U;
+    
+    while(*term != '\0')
+    {
+        h ^= (unsigned char) *term++;
+        h = (h * 16777619U) & 0xFFFFFFFFU;
+    }
+    
+    return h;
+}
+
+/* probeBloom
+ *
+ * Sets, or checks, the bits of one hashed term. The bits are
+ * h, h + delta, h + 2 * delta, ... with delta the hash rotated by
+ * 15, which is as good as numhashes hashes of their own.
+ *
+ * @param   bloom       Bloom object with its bits
+ * @param   h           hash of the term (see hashTerm)
+ * @param   set         1 to set the bits, 0 to check them
+ *
+ * @return  all set     1
+ * @return  otherwise   0
+ */
+
+int probeBloom(Bloom bloom, unsigned int h, int set)
+{
+    unsigned int delta, bit, i;
+    
+    delta = ((h >> 17) | (h << 15)) & 0xFFFFFFFFU;
+    
+    for(i = 0; i < bloom->numhashes; i++)
+    {
+        bit = h % bloom->numbits;
+        
+        if(set)
+        {
+            bloom->bits[bit / 8] |= (unsigned char) (1 << (bit % 8));
+        }
+        else if((bloom->bits[bit / 8] & (1 << (bit % 8))) == 0)
+        {
+            return 0;
+        }
+        
+        h = (h + delta) & 0xFFFFFFFFU;
+    }
+    
+    return 1;
+}
+
+/********************************
+ *      4. Bloom Functions      *
+ ********************************/
+
+/* createBloom
+ *
+ * Creates a filter to add the terms of an index to. The filter is
+ * only sized once every term is in (see writeBloom), so the number
+ * of terms need not be known up front.
+ *
+ * @return  success         new Bloom
+ * @return  failure         NULL
+ */
+
+Bloom createBloom(void)
+{
+    Bloom bloom;
+    
+    bloom = (Bloom) malloc(sizeof(struct Bloom_));
+    if(bloom == NULL)
+    {
+        fprintf(stderr, "Error: Could not allocate space for a Bloom filter.\n");
+        return NULL;
+    }
+    
+    bloom->keys = (unsigned int*) malloc(sizeof(unsigned int) * BLOOM_SIZE);
+    bloom->count = 0;
+    bloom->capacity = BLOOM_SIZE;
+    bloom->bits = NULL;
+    bloom->numbits = 0;
+    bloom->numhashes = BLOOM_HASHES;
+    
+    if(bloom->keys == NULL)
+    {
+        fprintf(stderr, "Error: Could not allocate space for a Bloom filter.\n");
+        free(bloom);
+        return NULL;
+    }
+    
+    return bloom;
+}
+
+/* destroyBloom
+ *
+ * Frees a filter. NULL is ignored.
+ *
+ * @param   bloom           Bloom object
+ *
+ * @return  void
+ */
+
+void destroyBloom(Bloom bloom)
+{
+    if(bloom != NULL)
+    {
+        free(bloom->keys);
+        free(bloom->bits);
+        free(bloom);
+    }
+}
+
+/* addBloom
+ *
+ * Adds a term to a filter being built.
+ *
+ * @param   bloom           Bloom object
+ * @param   term            term to add
+ *
+ * @return  success         1
+ * @return  failure         0
+ */
+
+int addBloom(Bloom bloom, char *term)
+{
+    unsigned int *keys;
+    
+    if(bloom->count == bloom->capacity)
+    {
+        keys = (unsigned int*) realloc(bloom->keys, sizeof(unsigned int) * bloom->capacity * 2);
+        if(keys == NULL)
+        {
+            fprintf(stderr, "Error: Could not allocate space for a Bloom filter.\n");
+            return 0;
+        }
+        bloom->keys = keys;
+        bloom->capacity *= 2;
+    }
+    
+    bloom->keys[bloom->count++] = hashTerm(term);
+    
+    return 1;
+}
+
+/* writeBloom
+ *
+ * Sizes a filter for the terms added to it, BLOOM_BITS_PER_KEY bits
+ * each, and writes it next to an index.
+ *
+ * @param   bloom           Bloom object
+ * @param   index           name of the index
+ *
+ * @return  success         1
+ * @return  failure         0
+ */
+
+int writeBloom(Bloom bloom, char *index)
+{
+    FILE *file;
+    int i, ok;
+    
+    /* Tiny filters fill up too fast, so never go below 64 bits */
+    bloom->numbits = (unsigned int) bloom->count * BLOOM_BITS_PER_KEY;
+    if(bloom->numbits < 64)
+    {
+        bloom->numbits = 64;
+    }
+    bloom->numbits = (bloom->numbits + 7) / 8 * 8;
+    
+    free(bloom->bits);
+    bloom->bits = (unsigned char*) calloc(bloom->numbits / 8, 1);
+    if(bloom->bits == NULL)
+    {
+        fprintf(stderr, "Error: Could not allocate space for a Bloom filter.\n");
+        return 0;
+    }
+    
+    for(i = 0; i < bloom->count; i++)
+    {
+        probeBloom(bloom, bloom->keys[i], 1);
+    }
+    
+    file = openSidecar(index, BLOOM_SUFFIX, "wb");
+    if(file == NULL)
+    {
+        fprintf(stderr, "Error: Could not create the Bloom filter of %s.\n", index);
+        return 0;
+    }
+    
+    ok = writeVByte(file, bloom->numbits) && writeVByte(file, bloom->numhashes) &&
+         fwrite(bloom->bits, 1, bloom->numbits / 8, file) == bloom->numbits / 8;
+    
+    if(fclose(file) != 0 || !ok)
+    {
+        fprintf(stderr, "Error: Could not write the Bloom filter of %s.\n", index);
+        return 0;
+    }
+    
+    return 1;
+}
+
+/* loadBloom
+ *
+ * Loads the filter written next to an index (see writeBloom).
+ *
+ * @param   index           name of the index
+ *
+ * @return  success         new Bloom
+ * @return  no filter       NULL
+ */
+
+Bloom loadBloom(char *index)
+{
+    Bloom bloom;
+    FILE *file;
+    unsigned int numbits, numhashes;
+    
+    file = openSidecar(index, BLOOM_SUFFIX, "rb");
+    if(file == NULL)
+    {
+        return NULL;
+    }
+    
+    if(readVByte(file, &numbits) == 0 || readVByte(file, &numhashes) == 0 ||
+       numbits == 0 || numbits % 8 != 0 || numhashes == 0 || numhashes > 32)
+    {
+        fprintf(stderr, "Error: Malformed Bloom filter file.\n");
+        fclose(file);
+        return NULL;
+    }
+    
+    bloom = (Bloom) malloc(sizeof(struct Bloom_));
+    if(bloom == NULL)
+    {
+        fprintf(stderr, "Error: Could not allocate space for a Bloom filter.\n");
+        fclose(file);
+        return NULL;
+    }
+    
+    bloom->keys = NULL;
+    bloom->count = 0;
+    bloom->capacity = 0;
+    bloom->numbits = numbits;
+    bloom->numhashes = numhashes;
+    
+    bloom->bits = (unsigned char*) malloc(numbits / 8);
+    if(bloom->bits == NULL)
+    {
+        fprintf(stderr, "Error: Could not allocate space for a Bloom filter.\n");
+        destroyBloom(bloom);
+        fclose(file);
+        return NULL;
+    }
+    
+    /* A filter cut short would turn away terms the index has */
+    if(fread(bloom->bits, 1, numbits / 8, file) != numbits / 8)
+    {
+        fprintf(stderr, "Error: Malformed Bloom filter file.\n");
+        destroyBloom(bloom);
+        fclose(file);
+        return NULL;
+    }
+    
+    fclose(file);
+    
+    return bloom;
+}
+
+/* bloomContains
+ *
+ * Checks whether a term may be in the index of a loaded filter.
+ * A term that is in it always passes, one that is not is turned
+ * away without touching the index all but about 1% of the time.
+ *
+ * @param   bloom           Bloom object
+ * @param   term            term to check
+ *
+ * @return  maybe there     1
+ * @return  not there       0
+ */
+
+int bloomContains(Bloom bloom, char *term)
+{
+    /* A filter still being built can't turn anything away */
+    if(bloom->bits == NULL)
+    {
+        return 1;
+    }
+    
+    return probeBloom(bloom, hashTerm(term), 0);
+}
@@ -0,0 +1,123 @@
+/*
+ * File: bloom.h
+ *
+ * Author: Mike Swift
+ * Email: theycallmeswift@gmail.com
+ * Date Created: May 15th, 2011
+ * Date Modified: May 15th, 2011
+ */
+
+#ifndef SWIFT_BLOOM_H_
+#define SWIFT_BLOOM_H_
+
+/********************************
+ *          1. Includes         *
+ ********************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "postings.h"
+
+/********************************
+ *          2. Constants        *
+ ********************************/
+
+/* Binary stream of writeVByte(#bits), writeVByte(#hashes) and the bits next to the index */
+#define BLOOM_SUFFIX ".blm"
+
+/* About 1% of the terms an index lacks get past a filter this size */
+#define BLOOM_BITS_PER_KEY 10
+#define BLOOM_HASHES 7
+
+/* Initial number of terms a filter being built has room for (grows as needed) */
+#define BLOOM_SIZE 1024
+
+/********************************
+ *      3. Structs & Typedefs   *
+ ********************************/
+
+struct Bloom_;
+typedef struct Bloom_* Bloom;
+
+/********************************
+ *      4. Bloom Functions      *
+ ********************************/
+
+/* createBloom
+ *
+ * Creates a filter to add the terms of an index to. The filter is
+ * only sized once every term is in (see writeBloom), so the number
+ * of terms need not be known up front.
+ *
+ * @return  success         new Bloom
+ * @return  failure         NULL
+ */
+
+Bloom createBloom(void);
+
+/* destroyBloom
+ *
+ * Frees a filter. NULL is ignored.
+ *
+ * @param   bloom           Bloom object
+ *
+ * @return  void
+ */
+
+void destroyBloom(Bloom bloom);
+
+/* addBloom
+ *
+ * Adds a term to a filter being built.
+ *
+ * @param   bloom           Bloom object
+ * @param   term            term to add
+ *
+ * @return  success         1
+ * @return  failure         0
+ */
+
+int addBloom(Bloom bloom, char *term);
+
+/* writeBloom
+ *
+ * Sizes a filter for the terms added to it, BLOOM_BITS_PER_KEY bits
+ * each, and writes it next to an index.
+ *
+ * @param   bloom           Bloom object
+ * @param   index           name of the index
+ *
+ * @return  success         1
+ * @return  failure         0
+ */
+
+int writeBloom(Bloom bloom, char *index);
+
+/* loadBloom
+ *
+ * Loads the filter written next to an index (see writeBloom).
+ *
+ * @param   index           name of the index
+ *
+ * @return  success         new Bloom
+ * @return  no filter       NULL
+ */
+
+Bloom loadBloom(char *index);
+
+/* bloomContains
+ *
+ * Checks whether a term may be in the index of a loaded filter.
+ * A term that is in it always passes, one that is not is turned
+ * away without touching the index all but about 1% of the time.
+ *
+ * @param   bloom           Bloom object
+ * @param   term            term to check
+ *
+ * @return  maybe there     1
+ * @return  not there       0
+ */
+
+int bloomContains(Bloom bloom, char *term);
+
+#endif /* SWIFT_BLOOM_H_ */
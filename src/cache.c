@@ -10,7 +10,11 @@
 /****************************
  * 1. Includes              *
  ****************************/
- 
+
+/* Read-write locks are POSIX, not ANSI */
+#define _XOPEN_SOURCE 600
+
+#include <pthread.h>
 #include "cache.h"
 
 /****************************
@@ -25,79 +29,430 @@ struct Block_ {
 };
 
 
-struct Cache_ {
+struct Stripe_ {
     Block front;
     Block last;
     int numBlocks;
-    unsigned long long max_size;
     unsigned long long curr_size;
     HashTable table;
+    Pool blocks;
+    pthread_rwlock_t lock;
+};
+
+
+struct Cache_ {
+    struct Stripe_ stripes[CACHE_STRIPES];
+    unsigned long long max_size;
+    unsigned long long curr_size;
+    pthread_mutex_t size_lock;
 };
 
 /****************************
  * 3. Helper Functions      *
  ****************************/
 
+/* wordSize
+ *
+ * Number of bytes a word is charged in the cache.
+ *
+ * @param   word            word to measure
+ *
+ * @return  unsigned long long size
+ */
 
-/****************************
- * 4. Cache Functions       *
- ****************************/
+unsigned long long wordSize(Word word)
+{
+    unsigned long long size, temp;
+    
+    size = 0;
+    
+    /* Size of the Word Pointer */
+    temp = (unsigned long long) sizeof(Word);
+    size += temp;
+    
+    /* Size of the Word Structure */
+    temp = (unsigned long long) sizeof(struct Word_);
+    size += temp;
+    
+    /* Size of the word string */
+    temp = (unsigned long long) ( sizeof(char) * (strlen(word->word) + 1) );
+    size += temp;
+    
+    /* Size of an Entry Structure * number of entries */
+    temp = (unsigned long long) (sizeof(struct Entry_) * word->numFiles);
+    size += temp;
+    
+    return size;
+}
 
-/* createCache
+/* packWord
  *
- * Function to create a new cache struct.  Returns the new struct on success
- * and NULL on failure.
+ * Copies a word for the cache into a single allocation: the Word,
+ * then its entries, then its string. Freeing it is one free, which
+ * any thread can do, unlike words from the shared pools of words.c.
  *
- * @param   cache_size      size of cache in bytes
+ * @param   word            word to copy
  *
- * @return  success         new Cache
+ * @return  success         new Word, to be freed with free
  * @return  failure         NULL
  */
- 
-Cache createCache(char* cache_size)
+
+Word packWord(Word word)
 {
-    Cache cache;
-    char bytesize;
-    int counter, bytes;
+    Word copy;
+    Entry ent, entries;
+    size_t length;
+    int count, i;
     
-    cache = (Cache) malloc(sizeof(struct Cache_));
-    if(cache == NULL)
+    count = 0;
+    for(ent = word->head; ent != NULL; ent = ent->next)
     {
-        fprintf(stderr, "Error: Could not allocate space for Cache.\n");
+        count++;
+    }
+    
+    length = strlen(word->word) + 1;
+    
+    copy = (Word) malloc(sizeof(struct Word_) + sizeof(struct Entry_) * count + length);
+    if(copy == NULL)
+    {
+        fprintf(stderr, "Error: Could not allocate space for a cached word.\n");
         return NULL;
     }
+    
+    entries = (Entry) (copy + 1);
+    
+    copy->word = (char*) (entries + count);
+    memcpy(copy->word, word->word, length);
+    copy->head = (count > 0) ? entries : NULL;
+    copy->numFiles = word->numFiles;
+    copy->totalAppearances = word->totalAppearances;
+    copy->positions = word->positions;
+    
+    for(ent = word->head, i = 0; ent != NULL; ent = ent->next, i++)
+    {
+        entries[i].filename = NULL;
+        entries[i].filenumber = ent->filenumber;
+        entries[i].frequency = ent->frequency;
+        entries[i].positions = NULL;
+        entries[i].lastPositions = NULL;
+        entries[i].numPositions = 0;
+        entries[i].next = (i + 1 < count) ? &entries[i + 1] : NULL;
+    }
+    
+    return copy;
+}
 
-    cache->front = NULL;
-    cache->last  = NULL;
-    cache->curr_size = 0;
+/* getStripe
+ *
+ * Finds the stripe a word belongs to.
+ *
+ * @param   cache           Cache object
+ * @param   str             the word
+ *
+ * @return  Stripe
+ */
+
+Stripe getStripe(Cache cache, char *str)
+{
+    return &cache->stripes[hash(str) % CACHE_STRIPES];
+}
+
+/* reserveRoom
+ *
+ * Takes room for a word out of the cache's one budget, if there
+ * is that much left. The stripes all draw on the same curr_size,
+ * so a word as big as the whole cache can be kept.
+ *
+ * @param   cache           Cache object
+ * @param   size            bytes the word is charged
+ *
+ * @return  reserved        1
+ * @return  no room         0
+ */
+
+int reserveRoom(Cache cache, unsigned long long size)
+{
+    int res;
+    
+    pthread_mutex_lock(&cache->size_lock);
+    
+    res = (cache->max_size == 0 || cache->curr_size + size <= cache->max_size);
+    if(res)
+    {
+        cache->curr_size += size;
+    }
+    
+    pthread_mutex_unlock(&cache->size_lock);
+    
+    return res;
+}
+
+/* releaseRoom
+ *
+ * Gives room taken with reserveRoom back to the cache.
+ *
+ * @param   cache           Cache object
+ * @param   size            bytes to give back
+ *
+ * @return  void
+ */
+
+void releaseRoom(Cache cache, unsigned long long size)
+{
+    pthread_mutex_lock(&cache->size_lock);
+    cache->curr_size -= size;
+    pthread_mutex_unlock(&cache->size_lock);
+}
+
+/* evictOldest
+ *
+ * Clears the least recently added word out of a stripe and gives
+ * its room back to the cache. The caller holds the stripe's lock
+ * for writing.
+ *
+ * @param   cache           Cache object
+ * @param   stripe          stripe to clear a word out of
+ *
+ * @return  success         bytes given back
+ * @return  empty stripe    0
+ */
+
+unsigned long long evictOldest(Cache cache, Stripe stripe)
+{
+    Block block;
+    unsigned long long size;
+    
+    block = stripe->last;
+    if(block == NULL)
+    {
+        return 0;
+    }
+    
+    if(CACHE_DEBUG) printf("Removing %s\n", block->word->word);
+    
+    if(block->prev == NULL)
+    {
+        /* Block is at the front of the list */
+        stripe->last = NULL;
+        stripe->front = NULL;
+    }
+    else
+    {
+        stripe->last = block->prev;
+        stripe->last->next = NULL;
+    }
+    
+    removeHT(stripe->table, block->word->word);
+    
+    size = block->size;
+    stripe->numBlocks--;
+    stripe->curr_size -= size;
+    
+    poolFree(stripe->blocks, block);
+    releaseRoom(cache, size);
+    
+    return size;
+}
+
+/* evictElsewhere
+ *
+ * Clears the oldest word out of some other stripe, for a word
+ * whose own stripe is empty but the cache is full. The caller
+ * already holds its own stripe's lock, so stripes busy with
+ * another thread are passed over rather than waited for: two
+ * threads each waiting on the other's stripe would never wake.
+ *
+ * @param   cache           Cache object
+ * @param   stripe          the caller's own stripe, locked
+ *
+ * @return  success         bytes given back
+ * @return  nothing freed   0
+ */
+
+unsigned long long evictElsewhere(Cache cache, Stripe stripe)
+{
+    Stripe other;
+    unsigned long long size;
+    int i, own;
+    
+    own = (int) (stripe - cache->stripes);
+    
+    for(i = 1; i < CACHE_STRIPES; i++)
+    {
+        other = &cache->stripes[(own + i) % CACHE_STRIPES];
+        
+        if(pthread_rwlock_trywrlock(&other->lock) != 0)
+        {
+            continue;
+        }
+        
+        size = evictOldest(cache, other);
+        pthread_rwlock_unlock(&other->lock);
+        
+        if(size > 0)
+        {
+            return size;
+        }
+    }
+    
+    return 0;
+}
+
+/* printStripe
+ *
+ * Prints the words of one stripe, most recently added first and
+ * then backwards.
+ *
+ * @param   stripe          stripe to print
+ *
+ * @return  void
+ */
+
+void printStripe(Stripe stripe)
+{
+    int i;
+    Block block;
+    
+    printf("Num Blocks: %i\n", stripe->numBlocks);
+    printf("Curr Size: %llu\n\n", stripe->curr_size);
+    
+    block = stripe->front;
+    
+    printf("Forwards: \n");
+    for(i = 0; i < stripe->numBlocks; i++)
+    {
+        printf("[%i]: %s\n", i, block->word->word);
+        block = block->next;
+    }
+    
+    block = stripe->last;
+    
+    printf("Backwards: \n");
+    for(i = stripe->numBlocks; i > 0; i--)
+    {
+        printf("[%i]: %s\n", i, block->word->word);
+        block = block->prev;
+    }
+}
+
+/****************************
+ * 4. Cache Functions       *
+ ****************************/
+
+/* parseCacheSize
+ *
+ * Reads a cache size given as a number of KB, MB or GB, e.g.
+ * "64MB". 0 of any of them leaves the cache unbounded.
+ *
+ * @param   cache_size      the size as given
+ * @param   bytes           where to store the size in bytes
+ *
+ * @return  success         1
+ * @return  failure         0
+ */
+
+int parseCacheSize(char *cache_size, unsigned long long *bytes)
+{
+    char bytesize;
+    int counter;
     
     counter = strlen(cache_size);
     
-    bytes = atol(cache_size);
-    bytesize = cache_size[counter - 2];
+    *bytes = atol(cache_size);
+    bytesize = (counter >= 2) ? cache_size[counter - 2] : '\0';
     
     if(bytesize == 'K')
     {
-        bytes = bytes * 1024;
+        *bytes = *bytes * 1024;
     }
     else if(bytesize == 'M')
     {
-        bytes = bytes * 1048576;
+        *bytes = *bytes * 1048576;
     }
     else if(bytesize == 'G')
     {
-        bytes = bytes * 1073741824;
+        *bytes = *bytes * 1073741824;
     }
     else
     {
         fprintf(stderr, "Error: Cache size must be in either KB, MB, or GB.\n");
+        return 0;
+    }
+    
+    return 1;
+}
+
+/* createCache
+ *
+ * Function to create a new cache struct.  Returns the new struct on success
+ * and NULL on failure.
+ *
+ * @param   cache_size      size of cache in bytes
+ *
+ * @return  success         new Cache
+ * @return  failure         NULL
+ */
+ 
+Cache createCache(char* cache_size)
+{
+    Cache cache;
+    Stripe stripe;
+    unsigned long long bytes;
+    int i;
+    
+    if(parseCacheSize(cache_size, &bytes) == 0)
+    {
+        return NULL;
+    }
+    
+    cache = (Cache) malloc(sizeof(struct Cache_));
+    if(cache == NULL)
+    {
+        fprintf(stderr, "Error: Could not allocate space for Cache.\n");
         return NULL;
     }
     
     cache->max_size = bytes;
-    cache->numBlocks = 0;
+    cache->curr_size = 0;
+    
+    if(pthread_mutex_init(&cache->size_lock, NULL) != 0)
+    {
+        fprintf(stderr, "Error: Could not allocate space for Cache.\n");
+        free(cache);
+        return NULL;
+    }
     
-    cache->table = createHT(hash, compStrings, NULL, destroyWord, printWordHT);
+    for(i = 0; i < CACHE_STRIPES; i++)
+    {
+        stripe = &cache->stripes[i];
+        
+        stripe->front = NULL;
+        stripe->last = NULL;
+        stripe->numBlocks = 0;
+        stripe->curr_size = 0;
+        
+        stripe->table = createHT(hash, compStrings, NULL, free, printWordHT);
+        stripe->blocks = createPool(sizeof(struct Block_), POOL_SLAB_ITEMS);
+        
+        if(stripe->table == NULL || stripe->blocks == NULL || pthread_rwlock_init(&stripe->lock, NULL) != 0)
+        {
+            fprintf(stderr, "Error: Could not allocate space for Cache.\n");
+            destroyHT(stripe->table);
+            destroyPool(stripe->blocks);
+            
+            while(--i >= 0)
+            {
+                stripe = &cache->stripes[i];
+                destroyPool(stripe->blocks);
+                destroyHT(stripe->table);
+                pthread_rwlock_destroy(&stripe->lock);
+            }
+            
+            pthread_mutex_destroy(&cache->size_lock);
+            free(cache);
+            return NULL;
+        }
+    }
     
     if(CACHE_DEBUG) printf("Max Size: %llu\n", cache->max_size);
     
@@ -118,19 +473,22 @@ Cache createCache(char* cache_size)
  
 void destroyCache(Cache cache)
 {
-    Block curr, next;
+    Stripe stripe;
+    int i;
+    
     if(cache != NULL)
     {
-        
-        curr = cache->front;
-        while(curr != NULL)
+        for(i = 0; i < CACHE_STRIPES; i++)
         {
-            next = curr->next;
-            free(curr);
-            curr = next;            
+            stripe = &cache->stripes[i];
+            
+            /* Blocks go with their pool, the table frees the words */
+            destroyPool(stripe->blocks);
+            destroyHT(stripe->table);
+            pthread_rwlock_destroy(&stripe->lock);
         }
         
-        destroyHT(cache->table);
+        pthread_mutex_destroy(&cache->size_lock);
         free(cache);
     }
 }
@@ -146,43 +504,36 @@ void destroyCache(Cache cache)
 void printCache(Cache cache)
 {
     int i;
-    Block block;
     
     if(cache != NULL)
     {
-        printf("Num Blocks: %i\n", cache->numBlocks);
         printf("Max Size: %llu\n", cache->max_size);
         printf("Curr Size: %llu\n\n", cache->curr_size);
         
-        block = cache->front;
-        
-        printf("Forwards: \n");
-        for(i = 0; i < cache->numBlocks; i++)
+        for(i = 0; i < CACHE_STRIPES; i++)
         {
-            printf("[%i]: %s\n", i, block->word->word);
-            block = block->next;
-        }
-        
-        block = cache->last;
-        
-        printf("Backwards: \n");
-        for(i = cache->numBlocks; i > 0; i--)
-        {
-            printf("[%i]: %s\n", i, block->word->word);
-            block = block->prev;
+            pthread_rwlock_rdlock(&cache->stripes[i].lock);
+            printf("Stripe %i:\n", i);
+            printStripe(&cache->stripes[i]);
+            pthread_rwlock_unlock(&cache->stripes[i].lock);
         }
     }
 }
 
 /* insertWord
  * 
- * Inserts a word into the cache.  If the cache is full,
- * words are cleared out 1 at a time until either there
- * are no blocks left or there is enough room for the new
- * word.
+ * Keeps a copy of a word in the cache. Words go into one of
+ * CACHE_STRIPES stripes by their hash, but all the stripes share
+ * the one size of the cache. If it is full, the word's own stripe
+ * has its words cleared out 1 at a time, and once that is empty
+ * the oldest words of the other stripes not in use by another
+ * thread, until there is enough room for the new word. If there
+ * still isn't, the word is left out. Words that could never fit
+ * (see fitsCache) or that are already there are left alone. Safe
+ * to call from any thread.
  * 
  * @param   cache           Cache object
- * @param   word            word to insert
+ * @param   word            word to copy in
  *
  * @return  success         1 = nothing was removed, -1 = removed
  * @return  failure         0
@@ -190,8 +541,10 @@ void printCache(Cache cache)
 
 int insertWord(Cache cache, Word word)
 {
+    Stripe stripe;
     Block block;
-    unsigned long long size, temp;
+    Word copy;
+    unsigned long long size;
     int res;
     
     if(cache == NULL)
@@ -206,96 +559,103 @@ int insertWord(Cache cache, Word word)
         return 0;
     }
     
+    if(!fitsCache(cache, word))
+    {
+        return 1;
+    }
     
-    size = 0;
-    
-    /* Size of the Word Pointer */
-    temp = (unsigned long long) sizeof(Word);
-    size += temp;
+    /* Copy before taking the lock, readers only wait for the list surgery */
+    copy = packWord(word);
+    if(copy == NULL)
+    {
+        return 0;
+    }
     
-    /* Size of the Word Structure */
-    temp = (unsigned long long) sizeof(struct Word_);
-    size += temp;
+    size = wordSize(copy);
+    stripe = getStripe(cache, copy->word);
+    res = 1;
     
-    /* Size of the word string */
-    temp = (unsigned long long) ( sizeof(char) * (strlen(word->word) + 1) );
-    size += temp;
+    pthread_rwlock_wrlock(&stripe->lock);
     
-    /* Size of an Entry Structure * number of entries */
-    temp = (unsigned long long) (sizeof(struct Entry_) * word->numFiles);
-    size += temp;
+    /* Another query may have got here first */
+    if(searchHT(stripe->table, copy->word) != NULL)
+    {
+        pthread_rwlock_unlock(&stripe->lock);
+        free(copy);
+        return 1;
+    }
     
-    if(cache->max_size != 0 && (cache->curr_size + size > cache->max_size))
+    while(!reserveRoom(cache, size))
     {
-        if(CACHE_DEBUG) printf("%llu + %llu (%llu) > %llu\n", cache->curr_size, size, cache->curr_size + size, cache->max_size);
-        
-        while(cache->numBlocks != 0 && (cache->curr_size + size > cache->max_size))
+        if(evictOldest(cache, stripe) == 0 && evictElsewhere(cache, stripe) == 0)
         {
-            block = cache->last;
-            
-            if(block == NULL)
-            printf("Block is NULL\n");
-            
-            if(CACHE_DEBUG) printf("Removing %s\n", block->word->word);
-            
-            if(block->prev == NULL)
-            {
-                /* Block is at the front of the list */
-                cache->last = NULL;
-                cache->front = NULL;
-            }
-            else
-            {
-                cache->last = block->prev;
-                cache->last->next = NULL;
-            }
-            
-            removeHT(cache->table, block->word->word);
-            
-            cache->numBlocks--;
-            cache->curr_size -= block->size;
-            
-            free(block);
+            /* Every other word is in a stripe held by another thread */
+            pthread_rwlock_unlock(&stripe->lock);
+            free(copy);
+            return res;
         }
         
+        res = -1;
     }
     
     /* Now make the block */
-    block = (Block) malloc(sizeof(struct Block_));
-    if(block == NULL)
+    block = (Block) poolAlloc(stripe->blocks);
+    if(block == NULL || insertHT(stripe->table, copy->word, copy) == 0)
     {
         fprintf(stderr, "Error: Could not allocate space for Block.\n");
+        if(block != NULL)
+        {
+            poolFree(stripe->blocks, block);
+        }
+        releaseRoom(cache, size);
+        pthread_rwlock_unlock(&stripe->lock);
+        free(copy);
         return 0;
     }
     
-    /* put the word in the HT */
-    res = insertHT(cache->table, word->word, word);
-    
-    block->next = cache->front;
+    block->next = stripe->front;
     block->prev = NULL;
     block->size = size;
-    block->word = word;
+    block->word = copy;
     
-    cache->curr_size += size;
-    cache->numBlocks++;
-    if(cache->front != NULL) cache->front->prev = block;
-    cache->front = block;
-    if(cache->last == NULL)
+    stripe->curr_size += size;
+    stripe->numBlocks++;
+    if(stripe->front != NULL) stripe->front->prev = block;
+    stripe->front = block;
+    if(stripe->last == NULL)
     {
-        cache->last = block;
+        stripe->last = block;
     }
     
+    pthread_rwlock_unlock(&stripe->lock);
+    
     if(CACHE_DEBUG) printf("Inserted a word of size %llu Bytes.\n", size);
-    return 1;
+    return res;
 }
 
-Word searchCache(Cache cache, char* str)
+/* searchCache
+ *
+ * Looks a word up in the cache. Lookups only take their stripe's
+ * lock for reading, so any number of them run at once. The word
+ * is copied into the caller's arena while the lock is held, since
+ * another thread may evict it right after.
+ *
+ * @param   cache           Cache object
+ * @param   str             word to look for
+ * @param   arena           where to copy the word
+ *
+ * @return  success         copy of the cached word
+ * @return  not found       NULL
+ */
+
+Word searchCache(Cache cache, char* str, Arena arena)
 {
+    Stripe stripe;
     Word res;
     
     if(cache == NULL)
     {
-        fprintf(stderr, "Error: Cannot insert into NULL cache.\n");
+        fprintf(stderr, "Error: Cannot search a NULL cache.\n");
         return NULL;
     }
     
@@ -305,8 +665,40 @@ Word searchCache(Cache cache, char* str)
         return NULL;
     }
     
-    res = (Word) searchHT(cache->table, (void*)str);
+    stripe = getStripe(cache, str);
+    
+    pthread_rwlock_rdlock(&stripe->lock);
+    
+    res = (Word) searchHT(stripe->table, (void*)str);
+    if(res != NULL)
+    {
+        res = copyArenaWord(arena, res);
+    }
+    
+    pthread_rwlock_unlock(&stripe->lock);
+    
     return res;
 }
 
+/* fitsCache
+ *
+ * Checks whether a word could ever be kept in the cache, i.e.
+ * the cache is unbounded or the word is no bigger than the whole
+ * cache. Words that don't fit are not worth copying for it.
+ *
+ * @param   cache           Cache object
+ * @param   word            word to check
+ *
+ * @return  fits            1
+ * @return  too big         0
+ */
 
+int fitsCache(Cache cache, Word word)
+{
+    if(cache == NULL || word == NULL)
+    {
+        return 0;
+    }
+    
+    return cache->max_size == 0 || wordSize(word) <= cache->max_size;
+}
@@ -14,6 +14,8 @@
 #include <stdio.h>
 #include <string.h>
 #include "hashtable.h"
+#include "pool.h"
+#include "arena.h"
 #include "words.h"
 
 /********************************
@@ -22,6 +24,9 @@
 
 #define CACHE_DEBUG 0
 
+/* Independently locked parts of a cache, all drawing on its one size */
+#define CACHE_STRIPES 16
+
 
 /********************************
  * 2. Structs & Typedefs        *
@@ -30,6 +35,9 @@
 struct Block_;
 typedef struct Block_* Block;
 
+struct Stripe_;
+typedef struct Stripe_* Stripe;
+
 struct Cache_;
 typedef struct Cache_* Cache;
 
@@ -37,6 +45,20 @@ typedef struct Cache_* Cache;
  * 3. Functions                 *
  ********************************/
 
+/* parseCacheSize
+ *
+ * Reads a cache size given as a number of KB, MB or GB, e.g.
+ * "64MB". 0 of any of them leaves the cache unbounded.
+ *
+ * @param   cache_size      the size as given
+ * @param   bytes           where to store the size in bytes
+ *
+ * @return  success         1
+ * @return  failure         0
+ */
+
+int parseCacheSize(char *cache_size, unsigned long long *bytes);
+
 /* createCache
  *
  * Function to create a new cache struct.  Returns the new struct on success
@@ -75,13 +97,18 @@ void printCache(Cache cache);
 
 /* insertWord
  * 
- * Inserts a word into the cache.  If the cache is full,
- * words are cleared out 1 at a time until either there
- * are no blocks left or there is enough room for the new
- * word.
+ * Keeps a copy of a word in the cache. Words go into one of
+ * CACHE_STRIPES stripes by their hash, but all the stripes share
+ * the one size of the cache. If it is full, the word's own stripe
+ * has its words cleared out 1 at a time, and once that is empty
+ * the oldest words of the other stripes not in use by another
+ * thread, until there is enough room for the new word. If there
+ * still isn't, the word is left out. Words that could never fit
+ * (see fitsCache) or that are already there are left alone. Safe
+ * to call from any thread.
  * 
  * @param   cache           Cache object
- * @param   word            word to insert
+ * @param   word            word to copy in
  *
  * @return  success         1 = nothing was removed, -1 = removed
  * @return  failure         0
@@ -89,7 +116,37 @@ void printCache(Cache cache);
 
 int insertWord(Cache cache, Word word);
 
-Word searchCache(Cache cache, char* str);
+/* searchCache
+ *
+ * Looks a word up in the cache. Lookups only take their stripe's
+ * lock for reading, so any number of them run at once. The word
+ * is copied into the caller's arena while the lock is held, since
+ * another thread may evict it right after.
+ *
+ * @param   cache           Cache object
+ * @param   str             word to look for
+ * @param   arena           where to copy the word
+ *
+ * @return  success         copy of the cached word
+ * @return  not found       NULL
+ */
+
+Word searchCache(Cache cache, char* str, Arena arena);
+
+/* fitsCache
+ *
+ * Checks whether a word could ever be kept in the cache, i.e.
+ * the cache is unbounded or the word is no bigger than the whole
+ * cache. Words that don't fit are not worth copying for it.
+ *
+ * @param   cache           Cache object
+ * @param   word            word to check
+ *
+ * @return  fits            1
+ * @return  too big         0
+ */
+
+int fitsCache(Cache cache, Word word);
 
 
 #endif
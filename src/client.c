@@ -0,0 +1,148 @@
+/*
+ * File: client.c
+ *
+ * Author: Mike Swift
+ * Email: theycallmeswift@gmail.com
+ * Date Created: May 15th, 2011
+ * Date Modified: May 15th, 2011
+ */
+
+/********************************
+ *          1. Includes         *
+ ********************************/
+
+/* close is POSIX, not ANSI */
+#define _XOPEN_SOURCE 600
+
+#include <unistd.h>
+#include "client.h"
+
+/********************************
+ *      2. Client Functions     *
+ ********************************/
+
+/* askServer
+ *
+ * Sends one request to a search server and prints its answer.
+ *
+ * @param   fd              socket connected to the server
+ * @param   request         "so ..." or "sa ..."
+ *
+ * @return  success         1
+ * @return  failure         0 (the server went away)
+ */
+
+int askServer(int fd, char *request)
+{
+    char *answer;
+    unsigned long length;
+    
+    if(writeMessage(fd, request, strlen(request)) == 0)
+    {
+        fprintf(stderr, "Error: Could not send the query.\n");
+        return 0;
+    }
+    
+    answer = readMessage(fd, MAX_RESPONSE_SIZE, &length);
+    if(answer == NULL)
+    {
+        fprintf(stderr, "Error: The server hung up.\n");
+        return 0;
+    }
+    
+    fwrite(answer, 1, length, stdout);
+    fflush(stdout);
+    free(answer);
+    
+    return 1;
+}
+
+/* runclient
+ *
+ * Client for a search server (see serveSearch). The query on the
+ * command line is sent as one request, or without one every line
+ * of stdin is, until "q" or the end of the input. Answers are
+ * printed as they come, the same lines the REPL would print.
+ *
+ * @param   argc            number of arguments
+ * @param   argv            [-s <socket>] [so|sa <terms> ...]
+ *
+ * @return  success         1
+ * @return  failure         0
+ */
+
+int runclient(int argc, char **argv)
+{
+    char *path, *query, line[MAX_QUERY_LINE];
+    int fd, first, i, res;
+    unsigned long size;
+    
+    /* Check for the help flag */
+    if(argc >= 2 && argv[1][0] == '-' && argv[1][1] == 'h')
+    {
+        fprintf(stderr, "Usage: %s [-s <socket>] [so|sa <terms> ...]\n", argv[0]);
+        return 1;
+    }
+    
+    path = DEFAULT_SOCKET;
+    first = 1;
+    
+    if(argc > 2 && strcmp(argv[1], "-s") == 0)
+    {
+        path = argv[2];
+        first = 3;
+    }
+    
+    fd = connectSocket(path);
+    if(fd < 0)
+    {
+        return 0;
+    }
+    
+    res = 1;
+    
+    if(first < argc)
+    {
+        /* The rest of the command line is the query */
+        size = 1;
+        for(i = first; i < argc; i++)
+        {
+            size += strlen(argv[i]) + 1;
+        }
+        
+        query = (char*) malloc(size);
+        if(query == NULL)
+        {
+            fprintf(stderr, "Error: Could not allocate space for the query.\n");
+            close(fd);
+            return 0;
+        }
+        
+        query[0] = '\0';
+        for(i = first; i < argc; i++)
+        {
+            strcat(query, argv[i]);
+            if(i + 1 < argc)
+            {
+                strcat(query, " ");
+            }
+        }
+        
+        res = askServer(fd, query);
+        free(query);
+    }
+    else
+    {
+        while(res == 1 && fgets(line, MAX_QUERY_LINE, stdin) != NULL && line[0] != 'q')
+        {
+            line[strcspn(line, "\r\n")] = '\0';
+            res = askServer(fd, line);
+        }
+    }
+    
+    /* Let the server know, rather than just hanging up */
+    writeMessage(fd, QUIT_REQUEST, strlen(QUIT_REQUEST));
+    close(fd);
+    
+    return res;
+}
@@ -0,0 +1,61 @@
+/*
+ * File: client.h
+ *
+ * Author: Mike Swift
+ * Email: theycallmeswift@gmail.com
+ * Date Created: May 15th, 2011
+ * Date Modified: May 15th, 2011
+ */
+
+#ifndef SWIFT_CLIENT_H_
+#define SWIFT_CLIENT_H_
+
+/********************************
+ *          1. Includes         *
+ ********************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "protocol.h"
+
+/********************************
+ *          2. Constants        *
+ ********************************/
+
+/* Longest query line read from stdin, same as the REPL */
+#define MAX_QUERY_LINE 1024
+
+/********************************
+ *      3. Client Functions     *
+ ********************************/
+
+/* askServer
+ *
+ * Sends one request to a search server and prints its answer.
+ *
+ * @param   fd              socket connected to the server
+ * @param   request         "so ..." or "sa ..."
+ *
+ * @return  success         1
+ * @return  failure         0 (the server went away)
+ */
+
+int askServer(int fd, char *request);
+
+/* runclient
+ *
+ * Client for a search server (see serveSearch). The query on the
+ * command line is sent as one request, or without one every line
+ * of stdin is, until "q" or the end of the input. Answers are
+ * printed as they come, the same lines the REPL would print.
+ *
+ * @param   argc            number of arguments
+ * @param   argv            [-s <socket>] [so|sa <terms> ...]
+ *
+ * @return  success         1
+ * @return  failure         0
+ */
+
+int runclient(int argc, char **argv);
+
+#endif /* SWIFT_CLIENT_H_ */
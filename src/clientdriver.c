@@ -0,0 +1,17 @@
+/*
+ * File: clientdriver.c
+ *
+ * Author: Mike Swift
+ * Email: theycallmeswift@gmail.com
+ * Date Created: May 15th, 2011
+ * Date Modified: May 15th, 2011
+ */
+
+/* This is a simple driver for the search client */
+
+#include "client.h"
+
+int main(int argc, char** argv )
+{
+    return runclient(argc, argv );
+}
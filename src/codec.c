@@ -0,0 +1,1244 @@
+/*
+ * File: codec.c
+ *
+ * Author: Mike Swift
+ * Email: theycallmeswift@gmail.com
+ * Date Created: May 15th, 2011
+ * Date Modified: May 15th, 2011
+ */
+
+/********************************
+ *          1. Includes         *
+ ********************************/
+
+#include "codec.h"
+
+#if INTERSECT_SIMD
+#include <immintrin.h>
+#endif
+
+/********************************
+ *          2. Tables           *
+ ********************************/
+
+static char *codecNames[NUM_CODECS] = {"vbyte", "streamvbyte", "pfor"};
+
+#if INTERSECT_SIMD
+
+/* pshufb masks that spread the bytes picked by a Stream VByte control byte into four numbers */
+static unsigned char svbShuffle[256][16];
+
+/* Data bytes a control byte covers */
+static unsigned char svbLength[256];
+
+/* Filled in by buildTables, writing the same bytes if two threads race to it */
+static volatile int tablesReady = 0;
+
+#endif
+
+/* Decoders decodeBlock runs, picked by pickDecoders */
+static DecodeFunc bestDecoders[NUM_CODECS];
+
+/********************************
+ *      3. Helper Functions     *
+ ********************************/
+
+#if INTERSECT_SIMD
+
+/* buildTables
+ *
+ * Works out the Stream VByte shuffle and length tables, once.
+ *
+ * @return  void
+ */
+
+void buildTables(void)
+{
+    int c, j, k, len, src;
+    
+    if(tablesReady)
+    {
+        return;
+    }
+    
+    for(c = 0; c < 256; c++)
+    {
+        src = 0;
+        
+        for(j = 0; j < 4; j++)
+        {
+            len = ((c >> (2 * j)) & 3) + 1;
+            
+            for(k = 0; k < 4; k++)
+            {
+                svbShuffle[c][4 * j + k] = (k < len) ? (unsigned char) (src + k) : 0x80;
+            }
+            
+            src += len;
+        }
+        
+        svbLength[c] = (unsigned char) src;
+    }
+    
+    tablesReady = 1;
+}
+
+#endif
+
+/* putVByte
+ *
+ * writeVByte into memory.
+ *
+ * @param   out         where to write
+ * @param   value       value to write
+ *
+ * @return  int         bytes written
+ */
+
+int putVByte(unsigned char *out, unsigned int value)
+{
+    int bytes;
+    
+    bytes = 0;
+    
+    while(value >= 0x80)
+    {
+        out[bytes] = (unsigned char) ((value & 0x7f) | 0x80);
+        value >>= 7;
+        bytes++;
+    }
+    
+    out[bytes] = (unsigned char) value;
+    
+    return bytes + 1;
+}
+
+/* getVByte
+ *
+ * readVByte from memory.
+ *
+ * @param   in          where to read, moved past the value
+ * @param   end         end of the readable bytes
+ * @param   value       where to store the value
+ *
+ * @return  success     1
+ * @return  failure     0
+ */
+
+int getVByte(const unsigned char **in, const unsigned char *end, unsigned int *value)
+{
+    const unsigned char *p;
+    unsigned int result;
+    int shift;
+    
+    p = *in;
+    result = 0;
+    
+    for(shift = 0; shift <= 28 && p < end; shift += 7)
+    {
+        result |= (unsigned int) (*p & 0x7f) << shift;
+        
+        if((*p & 0x80) == 0)
+        {
+            *value = result;
+            *in = p + 1;
+            return 1;
+        }
+        
+        p++;
+    }
+    
+    return 0;
+}
+
+/* putVLong
+ *
+ * putVByte for a file offset.
+ *
+ * @param   out         where to write
+ * @param   value       offset to write
+ *
+ * @return  int         bytes written
+ */
+
+int putVLong(unsigned char *out, unsigned long value)
+{
+    int bytes;
+    
+    bytes = 0;
+    
+    while(value >= 0x80)
+    {
+        out[bytes] = (unsigned char) ((value & 0x7f) | 0x80);
+        value >>= 7;
+        bytes++;
+    }
+    
+    out[bytes] = (unsigned char) value;
+    
+    return bytes + 1;
+}
+
+/* getVLong
+ *
+ * Reads an offset written by putVLong.
+ *
+ * @param   in          where to read, moved past the offset
+ * @param   end         end of the readable bytes
+ * @param   value       where to store the offset
+ *
+ * @return  success     1
+ * @return  failure     0
+ */
+
+int getVLong(const unsigned char **in, const unsigned char *end, unsigned long *value)
+{
+    const unsigned char *p;
+    unsigned long result;
+    int shift;
+    
+    p = *in;
+    result = 0;
+    
+    for(shift = 0; shift < (int) (sizeof(unsigned long) * 8) && p < end; shift += 7)
+    {
+        result |= (unsigned long) (*p & 0x7f) << shift;
+        
+        if((*p & 0x80) == 0)
+        {
+            *value = result;
+            *in = p + 1;
+            return 1;
+        }
+        
+        p++;
+    }
+    
+    return 0;
+}
+
+/* bitWidth
+ *
+ * @param   value       number
+ *
+ * @return  int         bits it takes (0 for 0)
+ */
+
+int bitWidth(unsigned int value)
+{
+    int bits;
+    
+    for(bits = 0; value != 0; bits++)
+    {
+        value >>= 1;
+    }
+    
+    return bits;
+}
+
+/* lowMask
+ *
+ * @param   bits        bit width, 0 to 32
+ *
+ * @return  unsigned    the low bits bits set
+ */
+
+unsigned int lowMask(int bits)
+{
+    return (bits >= 32) ? 0xFFFFFFFFU : (1U << bits) - 1;
+}
+
+/* packedWord
+ *
+ * Reads the k-th 32 bit word of a lane of a pfor block, low byte
+ * first whatever the processor.
+ *
+ * @param   in          packed bits
+ * @param   k           word number
+ * @param   lane        lane, 0 to 3
+ *
+ * @return  unsigned    the word
+ */
+
+unsigned int packedWord(const unsigned char *in, int k, int lane)
+{
+    in += 16 * k + 4 * lane;
+    
+    return (unsigned int) in[0] | ((unsigned int) in[1] << 8) | ((unsigned int) in[2] << 16) | ((unsigned int) in[3] << 24);
+}
+
+/* encodeVByteBlock
+ *
+ * encodeBlock for CODEC_VBYTE.
+ *
+ * @param   in          numbers to code
+ * @param   out         where to write them
+ *
+ * @return  int         bytes written
+ */
+
+int encodeVByteBlock(const unsigned int *in, unsigned char *out)
+{
+    int i, n;
+    
+    n = 0;
+    for(i = 0; i < CODEC_BLOCK; i++)
+    {
+        n += putVByte(out + n, in[i]);
+    }
+    
+    return n;
+}
+
+/* encodeStreamVByte
+ *
+ * encodeBlock for CODEC_STREAMVBYTE.
+ *
+ * @param   in          numbers to code
+ * @param   out         where to write them
+ *
+ * @return  int         bytes written
+ */
+
+int encodeStreamVByte(const unsigned int *in, unsigned char *out)
+{
+    unsigned char *data;
+    unsigned int value;
+    int i, k, len;
+    
+    data = out + CODEC_BLOCK / 4;
+    memset(out, 0, CODEC_BLOCK / 4);
+    
+    for(i = 0; i < CODEC_BLOCK; i++)
+    {
+        value = in[i];
+        len = (value < (1U << 8)) ? 1 : (value < (1U << 16)) ? 2 : (value < (1U << 24)) ? 3 : 4;
+        
+        out[i / 4] |= (unsigned char) ((len - 1) << (2 * (i % 4)));
+        
+        for(k = 0; k < len; k++)
+        {
+            *data = (unsigned char) (value >> (8 * k));
+            data++;
+        }
+    }
+    
+    return data - out;
+}
+
+/* encodePFor
+ *
+ * encodeBlock for CODEC_PFOR. Tries every bit width and keeps the
+ * one that makes the block smallest, counting what the numbers
+ * that do not fit (the exceptions) cost on top.
+ *
+ * @param   in          numbers to code
+ * @param   out         where to write them
+ *
+ * @return  int         bytes written
+ */
+
+int encodePFor(const unsigned int *in, unsigned char *out)
+{
+    unsigned char scratch[8];
+    unsigned int word, low;
+    int i, b, best, cost, bestcost, exceptions, pos, k, off, lane, n;
+    
+    best = 32;
+    bestcost = 16 * 32;
+    
+    for(b = 0; b < 32; b++)
+    {
+        cost = 16 * b;
+        exceptions = 0;
+        
+        for(i = 0; i < CODEC_BLOCK && cost < bestcost; i++)
+        {
+            if(bitWidth(in[i]) > b)
+            {
+                cost += 1 + putVByte(scratch, in[i] >> b);
+                exceptions++;
+            }
+        }
+        
+        cost += putVByte(scratch, exceptions);
+        
+        if(cost < bestcost)
+        {
+            best = b;
+            bestcost = cost;
+        }
+    }
+    
+    b = best;
+    out[0] = (unsigned char) b;
+    
+    exceptions = 0;
+    for(i = 0; i < CODEC_BLOCK; i++)
+    {
+        if(bitWidth(in[i]) > b)
+        {
+            exceptions++;
+        }
+    }
+    
+    n = 1 + putVByte(out + 1, exceptions);
+    
+    /* Number i of a lane starts at bit i * b of the lane */
+    memset(out + n, 0, 16 * b);
+    
+    for(i = 0; i < CODEC_BLOCK && b > 0; i++)
+    {
+        lane = i % 4;
+        pos = (i / 4) * b;
+        k = pos / 32;
+        off = pos % 32;
+        low = in[i] & lowMask(b);
+        
+        word = low << off;
+        out[n + 16 * k + 4 * lane] |= (unsigned char) word;
+        out[n + 16 * k + 4 * lane + 1] |= (unsigned char) (word >> 8);
+        out[n + 16 * k + 4 * lane + 2] |= (unsigned char) (word >> 16);
+        out[n + 16 * k + 4 * lane + 3] |= (unsigned char) (word >> 24);
+        
+        if(off + b > 32)
+        {
+            word = low >> (32 - off);
+            out[n + 16 * (k + 1) + 4 * lane] |= (unsigned char) word;
+            out[n + 16 * (k + 1) + 4 * lane + 1] |= (unsigned char) (word >> 8);
+            out[n + 16 * (k + 1) + 4 * lane + 2] |= (unsigned char) (word >> 16);
+            out[n + 16 * (k + 1) + 4 * lane + 3] |= (unsigned char) (word >> 24);
+        }
+    }
+    
+    n += 16 * b;
+    
+    for(i = 0; i < CODEC_BLOCK; i++)
+    {
+        if(bitWidth(in[i]) > b)
+        {
+            out[n] = (unsigned char) i;
+            n++;
+            n += putVByte(out + n, in[i] >> b);
+        }
+    }
+    
+    return n;
+}
+
+/* patchExceptions
+ *
+ * Puts back the high bits of the numbers of a pfor block that did
+ * not fit in its bit width.
+ *
+ * @param   in          first exception
+ * @param   b           bit width
+ * @param   exceptions  number of exceptions
+ * @param   out         the block's numbers, low bits already there
+ *
+ * @return  success     bytes the exceptions took
+ * @return  failure     -1
+ */
+
+int patchExceptions(const unsigned char *in, int b, int exceptions, unsigned int *out)
+{
+    const unsigned char *p;
+    unsigned int high;
+    int i, pos;
+    
+    p = in;
+    
+    for(i = 0; i < exceptions; i++)
+    {
+        pos = *p;
+        p++;
+        
+        if(pos >= CODEC_BLOCK || getVByte(&p, in + CODEC_BLOCK * 6, &high) == 0)
+        {
+            return -1;
+        }
+        
+        out[pos] |= high << b;
+    }
+    
+    return p - in;
+}
+
+/* pforHeader
+ *
+ * Reads the bit width and number of exceptions of a pfor block.
+ *
+ * @param   in          coded block
+ * @param   b           where to store the bit width
+ * @param   exceptions  where to store the number of exceptions
+ *
+ * @return  success     bytes the header took
+ * @return  failure     -1
+ */
+
+int pforHeader(const unsigned char *in, int *b, int *exceptions)
+{
+    const unsigned char *p;
+    unsigned int value;
+    
+    p = in + 1;
+    *b = in[0];
+    
+    if(*b > 32 || getVByte(&p, in + 6, &value) == 0 || value > CODEC_BLOCK || (*b == 32 && value > 0))
+    {
+        return -1;
+    }
+    
+    *exceptions = value;
+    
+    return p - in;
+}
+
+/* decodeVByteBlock
+ *
+ * DecodeFunc for CODEC_VBYTE.
+ *
+ * @param   in          coded block
+ * @param   out         where to store the numbers
+ *
+ * @return  success     bytes the block took
+ * @return  failure     -1
+ */
+
+int decodeVByteBlock(const unsigned char *in, unsigned int *out)
+{
+    const unsigned char *p;
+    int i;
+    
+    p = in;
+    
+    for(i = 0; i < CODEC_BLOCK; i++)
+    {
+        if(getVByte(&p, p + 5, out + i) == 0)
+        {
+            return -1;
+        }
+    }
+    
+    return p - in;
+}
+
+/* decodeStreamVByteScalar
+ *
+ * DecodeFunc for CODEC_STREAMVBYTE, a byte at a time.
+ *
+ * @param   in          coded block
+ * @param   out         where to store the numbers
+ *
+ * @return  int         bytes the block took
+ */
+
+int decodeStreamVByteScalar(const unsigned char *in, unsigned int *out)
+{
+    const unsigned char *data;
+    unsigned int value;
+    int i, k, len;
+    
+    data = in + CODEC_BLOCK / 4;
+    
+    for(i = 0; i < CODEC_BLOCK; i++)
+    {
+        len = ((in[i / 4] >> (2 * (i % 4))) & 3) + 1;
+        
+        value = 0;
+        for(k = 0; k < len; k++)
+        {
+            value |= (unsigned int) data[k] << (8 * k);
+        }
+        
+        out[i] = value;
+        data += len;
+    }
+    
+    return data - in;
+}
+
+/* decodePForScalar
+ *
+ * DecodeFunc for CODEC_PFOR, a number at a time.
+ *
+ * @param   in          coded block
+ * @param   out         where to store the numbers
+ *
+ * @return  success     bytes the block took
+ * @return  failure     -1
+ */
+
+int decodePForScalar(const unsigned char *in, unsigned int *out)
+{
+    const unsigned char *bits;
+    unsigned int value, mask;
+    int i, b, exceptions, n, pos, k, off, lane, used;
+    
+    n = pforHeader(in, &b, &exceptions);
+    if(n < 0)
+    {
+        return -1;
+    }
+    
+    bits = in + n;
+    mask = lowMask(b);
+    
+    for(i = 0; i < CODEC_BLOCK; i++)
+    {
+        if(b == 0)
+        {
+            out[i] = 0;
+            continue;
+        }
+        
+        lane = i % 4;
+        pos = (i / 4) * b;
+        k = pos / 32;
+        off = pos % 32;
+        
+        value = packedWord(bits, k, lane) >> off;
+        if(off + b > 32)
+        {
+            value |= packedWord(bits, k + 1, lane) << (32 - off);
+        }
+        
+        out[i] = value & mask;
+    }
+    
+    n += 16 * b;
+    
+    used = patchExceptions(in + n, b, exceptions, out);
+    
+    return (used < 0) ? -1 : n + used;
+}
+
+#if INTERSECT_SIMD
+
+/* decodeStreamVByteSSE
+ *
+ * DecodeFunc for CODEC_STREAMVBYTE, four numbers per shuffle: the
+ * control byte picks the mask that moves their bytes into place.
+ *
+ * @param   in          coded block
+ * @param   out         where to store the numbers
+ *
+ * @return  int         bytes the block took
+ */
+
+__attribute__((target("sse4.2")))
+int decodeStreamVByteSSE(const unsigned char *in, unsigned int *out)
+{
+    const unsigned char *data;
+    __m128i bytes;
+    int q, c;
+    
+    data = in + CODEC_BLOCK / 4;
+    
+    for(q = 0; q < CODEC_BLOCK / 4; q++)
+    {
+        c = in[q];
+        bytes = _mm_loadu_si128((const __m128i*) data);
+        _mm_storeu_si128((__m128i*) (out + 4 * q), _mm_shuffle_epi8(bytes, _mm_loadu_si128((const __m128i*) svbShuffle[c])));
+        data += svbLength[c];
+    }
+    
+    return data - in;
+}
+
+/* unpackSSE
+ *
+ * Unpacks the low bits of a pfor block, four lanes at a time: the
+ * i-th number of every lane sits at the same bit offset, so one
+ * shift (and another for numbers that straddle two words) and a
+ * mask unpack four of them. Inlined once per bit width, so the
+ * loop unrolls into constant shifts.
+ *
+ * @param   bits        packed bits
+ * @param   out         where to store the numbers
+ * @param   b           bit width, 1 to 32
+ *
+ * @return  void
+ */
+
+__attribute__((target("sse4.2"), always_inline))
+static __inline__ void unpackSSE(const __m128i *bits, unsigned int *out, const int b)
+{
+    __m128i mask, value;
+    int i, pos, k, off;
+    
+    mask = _mm_set1_epi32((int) lowMask(b));
+    
+    for(i = 0; i < CODEC_BLOCK / 4; i++)
+    {
+        pos = i * b;
+        k = pos / 32;
+        off = pos % 32;
+        
+        value = _mm_srli_epi32(_mm_loadu_si128(bits + k), off);
+        
+        if(off + b > 32)
+        {
+            value = _mm_or_si128(value, _mm_slli_epi32(_mm_loadu_si128(bits + k + 1), 32 - off));
+        }
+        
+        _mm_storeu_si128((__m128i*) (out + 4 * i), _mm_and_si128(value, mask));
+    }
+}
+
+/* decodePForSSE
+ *
+ * DecodeFunc for CODEC_PFOR, with unpackSSE.
+ *
+ * @param   in          coded block
+ * @param   out         where to store the numbers
+ *
+ * @return  success     bytes the block took
+ * @return  failure     -1
+ */
+
+#define UNPACK_WIDTH(B) case B: unpackSSE(bits, out, B); break;
+
+__attribute__((target("sse4.2")))
+int decodePForSSE(const unsigned char *in, unsigned int *out)
+{
+    const __m128i *bits;
+    int b, exceptions, n, used;
+    
+    n = pforHeader(in, &b, &exceptions);
+    if(n < 0)
+    {
+        return -1;
+    }
+    
+    bits = (const __m128i*) (in + n);
+    
+    switch(b)
+    {
+        case 0:
+            memset(out, 0, sizeof(unsigned int) * CODEC_BLOCK);
+            break;
+        
+        UNPACK_WIDTH(1) UNPACK_WIDTH(2) UNPACK_WIDTH(3) UNPACK_WIDTH(4)
+        UNPACK_WIDTH(5) UNPACK_WIDTH(6) UNPACK_WIDTH(7) UNPACK_WIDTH(8)
+        UNPACK_WIDTH(9) UNPACK_WIDTH(10) UNPACK_WIDTH(11) UNPACK_WIDTH(12)
+        UNPACK_WIDTH(13) UNPACK_WIDTH(14) UNPACK_WIDTH(15) UNPACK_WIDTH(16)
+        UNPACK_WIDTH(17) UNPACK_WIDTH(18) UNPACK_WIDTH(19) UNPACK_WIDTH(20)
+        UNPACK_WIDTH(21) UNPACK_WIDTH(22) UNPACK_WIDTH(23) UNPACK_WIDTH(24)
+        UNPACK_WIDTH(25) UNPACK_WIDTH(26) UNPACK_WIDTH(27) UNPACK_WIDTH(28)
+        UNPACK_WIDTH(29) UNPACK_WIDTH(30) UNPACK_WIDTH(31) UNPACK_WIDTH(32)
+    }
+    
+    n += 16 * b;
+    
+    used = patchExceptions(in + n, b, exceptions, out);
+    
+    return (used < 0) ? -1 : n + used;
+}
+
+#endif
+
+/********************************
+ *      4. Codec Functions      *
+ ********************************/
+
+/* codecByName
+ *
+ * @param   name            "vbyte", "streamvbyte" or "pfor"
+ *
+ * @return  success         CODEC_VBYTE, CODEC_STREAMVBYTE or CODEC_PFOR
+ * @return  failure         -1
+ */
+
+int codecByName(char *name)
+{
+    int i;
+    
+    for(i = 0; i < NUM_CODECS; i++)
+    {
+        if(strcmp(name, codecNames[i]) == 0)
+        {
+            return i;
+        }
+    }
+    
+    return -1;
+}
+
+/* codecName
+ *
+ * @param   codec           codec
+ *
+ * @return  char*           its name (see codecByName)
+ */
+
+char *codecName(int codec)
+{
+    return (codec >= 0 && codec < NUM_CODECS) ? codecNames[codec] : "unknown";
+}
+
+/* encodeBlock
+ *
+ * Codes CODEC_BLOCK numbers:
+ *
+ *      vbyte:          writeVByte of each
+ *      streamvbyte:    2 bits per number holding its length in
+ *                      bytes - 1, then the bytes of every number,
+ *                      low byte first, with no flag bits
+ *      pfor:           a bit width b and the number of exceptions,
+ *                      then the low b bits of every number packed
+ *                      four lanes wide (number i goes to lane i % 4),
+ *                      then the position and high bits of each
+ *                      number that does not fit in b
+ *
+ * b is picked to make the block smallest.
+ *
+ * @param   codec           codec
+ * @param   in              numbers to code
+ * @param   out             where to write them, room for
+ *                          CODEC_BLOCK_BYTES
+ *
+ * @return  int             bytes written
+ */
+
+int encodeBlock(int codec, const unsigned int *in, unsigned char *out)
+{
+    switch(codec)
+    {
+        case CODEC_STREAMVBYTE:
+            return encodeStreamVByte(in, out);
+        
+        case CODEC_PFOR:
+            return encodePFor(in, out);
+    }
+    
+    return encodeVByteBlock(in, out);
+}
+
+/* decodeKernel
+ *
+ * @param   codec           codec
+ * @param   level           SIMD_SCALAR, SIMD_SSE or SIMD_AVX2
+ *
+ * @return  success         the codec's decoder for that instruction
+ *                          set (or the best one below it, if the
+ *                          codec has none)
+ * @return  failure         NULL, if the processor lacks it
+ */
+
+DecodeFunc decodeKernel(int codec, int level)
+{
+    if(level > simdLevel() || codec < 0 || codec >= NUM_CODECS)
+    {
+        return NULL;
+    }
+    
+#if INTERSECT_SIMD
+    if(level >= SIMD_SSE)
+    {
+        buildTables();
+        
+        switch(codec)
+        {
+            case CODEC_STREAMVBYTE:
+                return decodeStreamVByteSSE;
+            
+            case CODEC_PFOR:
+                return decodePForSSE;
+        }
+    }
+#endif
+    
+    switch(codec)
+    {
+        case CODEC_STREAMVBYTE:
+            return decodeStreamVByteScalar;
+        
+        case CODEC_PFOR:
+            return decodePForScalar;
+    }
+    
+    return decodeVByteBlock;
+}
+
+/* pickDecoders
+ *
+ * Picks the decoder decodeBlock runs for every codec. It does so
+ * itself on its first call, a program that decodes from several
+ * threads picks them up front so they never race to.
+ *
+ * @return  void
+ */
+
+void pickDecoders(void)
+{
+    int codec;
+    
+    for(codec = 0; codec < NUM_CODECS; codec++)
+    {
+        bestDecoders[codec] = decodeKernel(codec, simdLevel());
+    }
+}
+
+/* decodeBlock
+ *
+ * Decodes a block with the best decoder for this processor (see
+ * simdLevel).
+ *
+ * @param   codec           codec
+ * @param   in              coded block, CODEC_BLOCK_BYTES readable
+ * @param   out             where to store the numbers
+ *
+ * @return  success         bytes the block took
+ * @return  failure         -1
+ */
+
+int decodeBlock(int codec, const unsigned char *in, unsigned int *out)
+{
+    if(codec < 0 || codec >= NUM_CODECS)
+    {
+        return -1;
+    }
+    
+    /* The processor does not change, ask once */
+    if(bestDecoders[codec] == NULL)
+    {
+        pickDecoders();
+    }
+    
+    return bestDecoders[codec](in, out);
+}
+
+/* writeCodecHeader
+ *
+ * Starts a packed stream: CODEC_MAGIC, the codec (one byte) and
+ * CODEC_BLOCK (writeVByte).
+ *
+ * @param   file            packed stream
+ * @param   codec           codec of its blocks
+ *
+ * @return  success         1
+ * @return  failure         0
+ */
+
+int writeCodecHeader(FILE *file, int codec)
+{
+    if(file == NULL || fwrite(CODEC_MAGIC, 1, CODEC_MAGIC_SIZE, file) != CODEC_MAGIC_SIZE ||
+       putc(codec, file) == EOF || writeVByte(file, CODEC_BLOCK) == 0)
+    {
+        fprintf(stderr, "Error: Could not write packed postings.\n");
+        return 0;
+    }
+    
+    return 1;
+}
+
+/* readCodecHeader
+ *
+ * Reads the header written by writeCodecHeader. A stream with
+ * another block size than this build's cannot be read.
+ *
+ * @param   file            packed stream
+ *
+ * @return  success         codec of its blocks
+ * @return  failure         -1
+ */
+
+int readCodecHeader(FILE *file)
+{
+    char magic[CODEC_MAGIC_SIZE];
+    unsigned int block;
+    int codec;
+    
+    if(fread(magic, 1, CODEC_MAGIC_SIZE, file) != CODEC_MAGIC_SIZE || memcmp(magic, CODEC_MAGIC, CODEC_MAGIC_SIZE) != 0 ||
+       (codec = getc(file)) == EOF || codec >= NUM_CODECS || readVByte(file, &block) == 0)
+    {
+        fprintf(stderr, "Error: Malformed packed postings file.\n");
+        return -1;
+    }
+    
+    if(block != CODEC_BLOCK)
+    {
+        fprintf(stderr, "Error: Packed postings use blocks of %u, this build reads %d.\n", block, CODEC_BLOCK);
+        return -1;
+    }
+    
+#if INTERSECT_SIMD
+    /* Before any query runs */
+    buildTables();
+#endif
+    
+    return codec;
+}
+
+/* openPacked
+ *
+ * Opens the packed stream of an inverted index and reads its
+ * header.
+ *
+ * @param   index           name of the inverted index
+ * @param   codec           where to store the codec of its blocks
+ *
+ * @return  success         FILE pointer
+ * @return  failure         NULL (no stream, or one this build
+ *                          cannot read)
+ */
+
+FILE *openPacked(char *index, int *codec)
+{
+    FILE *file;
+    
+    file = openSidecar(index, PACKED_SUFFIX, "rb");
+    if(file == NULL)
+    {
+        return NULL;
+    }
+    
+    *codec = readCodecHeader(file);
+    if(*codec < 0)
+    {
+        fclose(file);
+        return NULL;
+    }
+    
+    return file;
+}
+
+/* writePacked
+ *
+ * Writes the postings of a word to the packed stream, in the same
+ * order as its <list> in the index:
+ *
+ *      #bytes of what follows
+ *      offset of its positions, #files
+ *      per run of files with the same frequency, going one way:
+ *          frequency, 2 * #files + 1 if they go down, then the
+ *          first file number and the gaps between the others,
+ *          CODEC_BLOCK at a time with the codec and whatever is
+ *          left over with writeVByte
+ *      0 (end of the list)
+ *
+ * Numbers outside the blocks are written like writeVByte.
+ *
+ * @param   file            packed stream
+ * @param   codec           codec of its blocks
+ * @param   word            word about to be written to the index,
+ *                          entries already sorted (see sortEntries)
+ * @param   positions       offset of the word's positions
+ *
+ * @return  success         offset the postings start at
+ * @return  failure         -1
+ */
+
+long writePacked(FILE *file, int codec, Word word, long positions)
+{
+    Entry ent, first, prev;
+    unsigned char *body, header[8];
+    unsigned int *gaps;
+    long offset;
+    int n, i, count, last, size, down;
+    
+    if(file == NULL || word == NULL)
+    {
+        fprintf(stderr, "Error: Cannot write packed postings of NULL word.\n");
+        return -1;
+    }
+    
+    n = 0;
+    for(ent = word->head; ent != NULL; ent = ent->next)
+    {
+        n++;
+    }
+    
+    /* A number never takes more than 5 bytes, a run header 10 */
+    body = (unsigned char*) malloc(32 + 15 * n);
+    gaps = (unsigned int*) malloc(sizeof(unsigned int) * (n + 1));
+    if(body == NULL || gaps == NULL)
+    {
+        fprintf(stderr, "Error: Could not allocate space for packed postings.\n");
+        free(body);
+        free(gaps);
+        return -1;
+    }
+    
+    size = putVLong(body, (unsigned long) positions);
+    size += putVByte(body + size, n);
+    
+    for(first = word->head; first != NULL; first = ent)
+    {
+        if(first->frequency <= 0)
+        {
+            fprintf(stderr, "Error: Cannot pack a frequency of %i.\n", first->frequency);
+            free(body);
+            free(gaps);
+            return -1;
+        }
+        
+        /* Files of the same frequency go the way they were added, usually down */
+        down = (first->next != NULL && first->next->frequency == first->frequency &&
+                first->next->filenumber < first->filenumber);
+        
+        /* A run ends where the frequency changes or the files turn around */
+        count = 0;
+        last = 0;
+        prev = NULL;
+        
+        for(ent = first; ent != NULL && ent->frequency == first->frequency && (prev == NULL ||
+            (down ? ent->filenumber < prev->filenumber : ent->filenumber > prev->filenumber)); ent = ent->next)
+        {
+            gaps[count] = (prev == NULL || !down) ? ent->filenumber - last : last - ent->filenumber;
+            last = ent->filenumber;
+            count++;
+            prev = ent;
+        }
+        
+        size += putVByte(body + size, first->frequency);
+        size += putVByte(body + size, 2 * count + down);
+        
+        for(i = 0; i + CODEC_BLOCK <= count; i += CODEC_BLOCK)
+        {
+            size += encodeBlock(codec, gaps + i, body + size);
+        }
+        
+        for(; i < count; i++)
+        {
+            size += putVByte(body + size, gaps[i]);
+        }
+    }
+    
+    size += putVByte(body + size, 0);
+    
+    offset = ftell(file);
+    
+    i = putVByte(header, size);
+    if(fwrite(header, 1, i, file) != (size_t) i || fwrite(body, 1, size, file) != (size_t) size)
+    {
+        fprintf(stderr, "Error: Could not write packed postings.\n");
+        offset = -1;
+    }
+    
+    free(body);
+    free(gaps);
+    
+    return offset;
+}
+
+/* readPacked
+ *
+ * Reads back the postings written by writePacked, decoding whole
+ * blocks at a time.
+ *
+ * @param   file            packed stream
+ * @param   offset          offset the postings start at
+ * @param   codec           codec of its blocks
+ * @param   arena           where to put the postings
+ * @param   files           where to store the file numbers
+ * @param   freqs           where to store the frequencies
+ * @param   positions       where to store the offset of the positions
+ *
+ * @return  success         number of files
+ * @return  failure         -1
+ */
+
+int readPacked(FILE *file, long offset, int codec, Arena arena, int **files, int **freqs, long *positions)
+{
+    const unsigned char *p, *end;
+    unsigned char *raw;
+    unsigned int length, n, freq, count, down, *gaps;
+    unsigned long start;
+    int i, k, used, doc;
+    
+    if(fseek(file, offset, SEEK_SET) != 0 || readVByte(file, &length) == 0)
+    {
+        fprintf(stderr, "Error: Malformed packed postings file.\n");
+        return -1;
+    }
+    
+    /* Decoders may read a block's worth past the end */
+    raw = (unsigned char*) arenaAlloc(arena, length + CODEC_BLOCK_BYTES);
+    if(raw == NULL)
+    {
+        return -1;
+    }
+    
+    if(fread(raw, 1, length, file) != length)
+    {
+        fprintf(stderr, "Error: Malformed packed postings file.\n");
+        return -1;
+    }
+    memset(raw + length, 0, CODEC_BLOCK_BYTES);
+    
+    p = raw;
+    end = raw + length;
+    
+    /* A packed block takes at least a byte, however many files it holds */
+    if(getVLong(&p, end, &start) == 0 || getVByte(&p, end, &n) == 0 || n / CODEC_BLOCK > length)
+    {
+        fprintf(stderr, "Error: Malformed packed postings file.\n");
+        return -1;
+    }
+    
+    *positions = (long) start;
+    *files = (int*) arenaAlloc(arena, sizeof(int) * (n + 1));
+    *freqs = (int*) arenaAlloc(arena, sizeof(int) * (n + 1));
+    if(*files == NULL || *freqs == NULL)
+    {
+        return -1;
+    }
+    
+    /* Gaps are decoded in place, then summed into file numbers */
+    gaps = (unsigned int*) *files;
+    k = 0;
+    freq = 1;
+    
+    while(getVByte(&p, end, &freq) == 1 && freq != 0)
+    {
+        if(getVByte(&p, end, &count) == 0 || count / 2 > n - k)
+        {
+            fprintf(stderr, "Error: Malformed packed postings file.\n");
+            return -1;
+        }
+        
+        down = count % 2;
+        count /= 2;
+        
+        for(i = 0; i + CODEC_BLOCK <= (int) count; i += CODEC_BLOCK)
+        {
+            used = decodeBlock(codec, p, gaps + k + i);
+            if(used < 0 || used > end - p)
+            {
+                fprintf(stderr, "Error: Malformed packed postings file.\n");
+                return -1;
+            }
+            p += used;
+        }
+        
+        for(; i < (int) count; i++)
+        {
+            if(getVByte(&p, end, gaps + k + i) == 0)
+            {
+                fprintf(stderr, "Error: Malformed packed postings file.\n");
+                return -1;
+            }
+        }
+        
+        /* The first gap is the file number itself, whichever way the run goes */
+        doc = 0;
+        for(i = 0; i < (int) count; i++)
+        {
+            doc += (down && i > 0) ? -(int) gaps[k + i] : (int) gaps[k + i];
+            (*files)[k + i] = doc;
+            (*freqs)[k + i] = freq;
+        }
+        
+        k += count;
+    }
+    
+    if(freq != 0 || k != (int) n)
+    {
+        fprintf(stderr, "Error: Malformed packed postings file.\n");
+        return -1;
+    }
+    
+    return k;
+}
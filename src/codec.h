@@ -0,0 +1,243 @@
+/*
+ * File: codec.h
+ *
+ * Author: Mike Swift
+ * Email: theycallmeswift@gmail.com
+ * Date Created: May 15th, 2011
+ * Date Modified: May 15th, 2011
+ */
+
+#ifndef SWIFT_CODEC_H_
+#define SWIFT_CODEC_H_
+
+/********************************
+ *          1. Includes         *
+ ********************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "arena.h"
+#include "intersect.h"
+#include "postings.h"
+#include "words.h"
+
+/********************************
+ *          2. Constants        *
+ ********************************/
+
+/* Binary stream of the postings of every word, block coded, next to an inverted index */
+#define PACKED_SUFFIX ".pak"
+
+/* First bytes of a packed stream, before its codec and block size */
+#define CODEC_MAGIC "SWPK"
+#define CODEC_MAGIC_SIZE 4
+
+/* Ways a block of numbers can be coded */
+#define CODEC_VBYTE 0
+#define CODEC_STREAMVBYTE 1
+#define CODEC_PFOR 2
+#define NUM_CODECS 3
+
+/* Codec of a new index, unless index is told otherwise (-c) */
+#ifndef DEFAULT_CODEC
+#define DEFAULT_CODEC CODEC_PFOR
+#endif
+
+/* Numbers in a block, lists are coded a block at a time */
+#define CODEC_BLOCK 128
+
+/* Most bytes a decoder reads for one block, however it was coded */
+#define CODEC_BLOCK_BYTES (CODEC_BLOCK * 11 + 8)
+
+/********************************
+ *      3. Structs & Typedefs   *
+ ********************************/
+
+/* DecodeFunc
+ *
+ * A block decoder: reads CODEC_BLOCK numbers coded by encodeBlock
+ * and returns the number of bytes they took, -1 if they make no
+ * sense. It may read up to CODEC_BLOCK_BYTES past in, whatever the
+ * block really takes.
+ */
+
+typedef int (*DecodeFunc)(const unsigned char *in, unsigned int *out);
+
+/********************************
+ *      4. Codec Functions      *
+ ********************************/
+
+/* codecByName
+ *
+ * @param   name            "vbyte", "streamvbyte" or "pfor"
+ *
+ * @return  success         CODEC_VBYTE, CODEC_STREAMVBYTE or CODEC_PFOR
+ * @return  failure         -1
+ */
+
+int codecByName(char *name);
+
+/* codecName
+ *
+ * @param   codec           codec
+ *
+ * @return  char*           its name (see codecByName)
+ */
+
+char *codecName(int codec);
+
+/* encodeBlock
+ *
+ * Codes CODEC_BLOCK numbers:
+ *
+ *      vbyte:          writeVByte of each
+ *      streamvbyte:    2 bits per number holding its length in
+ *                      bytes - 1, then the bytes of every number,
+ *                      low byte first, with no flag bits
+ *      pfor:           a bit width b and the number of exceptions,
+ *                      then the low b bits of every number packed
+ *                      four lanes wide (number i goes to lane i % 4),
+ *                      then the position and high bits of each
+ *                      number that does not fit in b
+ *
+ * b is picked to make the block smallest.
+ *
+ * @param   codec           codec
+ * @param   in              numbers to code
+ * @param   out             where to write them, room for
+ *                          CODEC_BLOCK_BYTES
+ *
+ * @return  int             bytes written
+ */
+
+int encodeBlock(int codec, const unsigned int *in, unsigned char *out);
+
+/* decodeKernel
+ *
+ * @param   codec           codec
+ * @param   level           SIMD_SCALAR, SIMD_SSE or SIMD_AVX2
+ *
+ * @return  success         the codec's decoder for that instruction
+ *                          set (or the best one below it, if the
+ *                          codec has none)
+ * @return  failure         NULL, if the processor lacks it
+ */
+
+DecodeFunc decodeKernel(int codec, int level);
+
+/* pickDecoders
+ *
+ * Picks the decoder decodeBlock runs for every codec. It does so
+ * itself on its first call, a program that decodes from several
+ * threads picks them up front so they never race to.
+ *
+ * @return  void
+ */
+
+void pickDecoders(void);
+
+/* decodeBlock
+ *
+ * Decodes a block with the best decoder for this processor (see
+ * simdLevel).
+ *
+ * @param   codec           codec
+ * @param   in              coded block, CODEC_BLOCK_BYTES readable
+ * @param   out             where to store the numbers
+ *
+ * @return  success         bytes the block took
+ * @return  failure         -1
+ */
+
+int decodeBlock(int codec, const unsigned char *in, unsigned int *out);
+
+/* writeCodecHeader
+ *
+ * Starts a packed stream: CODEC_MAGIC, the codec (one byte) and
+ * CODEC_BLOCK (writeVByte).
+ *
+ * @param   file            packed stream
+ * @param   codec           codec of its blocks
+ *
+ * @return  success         1
+ * @return  failure         0
+ */
+
+int writeCodecHeader(FILE *file, int codec);
+
+/* readCodecHeader
+ *
+ * Reads the header written by writeCodecHeader. A stream with
+ * another block size than this build's cannot be read.
+ *
+ * @param   file            packed stream
+ *
+ * @return  success         codec of its blocks
+ * @return  failure         -1
+ */
+
+int readCodecHeader(FILE *file);
+
+/* openPacked
+ *
+ * Opens the packed stream of an inverted index and reads its
+ * header.
+ *
+ * @param   index           name of the inverted index
+ * @param   codec           where to store the codec of its blocks
+ *
+ * @return  success         FILE pointer
+ * @return  failure         NULL (no stream, or one this build
+ *                          cannot read)
+ */
+
+FILE *openPacked(char *index, int *codec);
+
+/* writePacked
+ *
+ * Writes the postings of a word to the packed stream, in the same
+ * order as its <list> in the index:
+ *
+ *      #bytes of what follows
+ *      offset of its positions, #files
+ *      per run of files with the same frequency, going one way:
+ *          frequency, 2 * #files + 1 if they go down, then the
+ *          first file number and the gaps between the others,
+ *          CODEC_BLOCK at a time with the codec and whatever is
+ *          left over with writeVByte
+ *      0 (end of the list)
+ *
+ * Numbers outside the blocks are written like writeVByte.
+ *
+ * @param   file            packed stream
+ * @param   codec           codec of its blocks
+ * @param   word            word about to be written to the index,
+ *                          entries already sorted (see sortEntries)
+ * @param   positions       offset of the word's positions
+ *
+ * @return  success         offset the postings start at
+ * @return  failure         -1
+ */
+
+long writePacked(FILE *file, int codec, Word word, long positions);
+
+/* readPacked
+ *
+ * Reads back the postings written by writePacked, decoding whole
+ * blocks at a time.
+ *
+ * @param   file            packed stream
+ * @param   offset          offset the postings start at
+ * @param   codec           codec of its blocks
+ * @param   arena           where to put the postings
+ * @param   files           where to store the file numbers
+ * @param   freqs           where to store the frequencies
+ * @param   positions       where to store the offset of the positions
+ *
+ * @return  success         number of files
+ * @return  failure         -1
+ */
+
+int readPacked(FILE *file, long offset, int codec, Arena arena, int **files, int **freqs, long *positions);
+
+#endif /* SWIFT_CODEC_H_ */
@@ -12,438 +12,4366 @@
  ****************************/
 
 #include "csearch.h"
+#include "batch.h"
+#include "server.h"
+#include "shard.h"
 
 /****************************
- * 2. Structs               *
+ * 2. Helper Functions      *
  ****************************/
 
-
-
-/****************************
- * 3. File List Functions   *
- ****************************/
- 
-/* getFilelist
+/* createResult
  *
- * This function takes in a tokenizer object that points
- * to the start of an inverted index. It then parses the 
- * list of files between <files> and </files> and returns
- * an object that contains the total number of files, an
- * array that maps a number to the filename, and an array 
- * of integers that will hold the search results.
+ * Creates an empty Result for a file in the query arena.
  *
- * @param   tok         Tokenizer object (pointing to top of inverted index)
- * 
- * @return  success     Filelist
+ * @param   files       filelist object
+ * @param   filenum     number of the file
+ *
+ * @return  success     new Result
  * @return  failure     NULL
  */
 
-Filelist getFilelist(TokenizerT tok)
+Result createResult(Filelist files, int filenum)
 {
-    Filelist files;
-    char **file_list, *str;
-    int counter, numfiles;
-    
-    /* Validate inputs */
+    Result result;
     
-    if(tok == NULL)
+    result = (Result) arenaAlloc(files->arena, sizeof(struct Result_));
+    if(result == NULL)
     {
-        fprintf(stderr, "Error: Cannot generate filelist from NULL tokenizer.\n");
+        fprintf(stderr, "Error: Could not allocate space for results.\n");
         return NULL;
     }
     
-    /* Make sure we are looking at the top of the file */
+    result->filenum = filenum;
+    result->numfiles = 0;
+    result->frequency = 0;
+    result->score = 0.0;
+    result->next = NULL;
+    
+    return result;
+}
+
+/* readTerm
+ *
+ * Reads the postings of the i-th term of the lexicon: decoded a
+ * block at a time from the packed stream when the index has one
+ * (see readPacked), else parsed out of its <list> in the index
+ * (see getWord). Either way the entries come out in list order.
+ *
+ * @param   files       filelist object
+ * @param   tok         tokenizer object
+ * @param   i           term number
+ *
+ * @return  success     Word
+ * @return  failure     NULL
+ */
+
+Word readTerm(Filelist files, TokenizerT tok, int i)
+{
+    Word word;
+    Entry ent, tail;
+    long offset, positions;
+    int *docs, *freqs, n, k;
     
-    str = TKGetNextToken(tok);
-    if(str == 0 || strcmp(str, "files") != 0)
+    offset = (files->packed == NULL) ? -1 : lexiconPacked(files->lexicon, i);
+    if(offset < 0)
     {
-        fprintf(stderr, "Error: Malformed index file.\n");
-        exit(-1);
+        if(fseek(tok->file, lexiconOffset(files->lexicon, i), SEEK_SET) != 0)
+        {
+            return NULL;
+        }
+        
+        return getWord(tok, lexiconTerm(files->lexicon, i), files->arena);
     }
-    free(str);
-    
-    /* get the total number of files */
-    
-    str = TKGetNextToken(tok);
-    numfiles = atoi(str);
-    free(str);
-    
-    if(DEBUG) printf("Total Files: %i\n", numfiles);
     
-    /* Allocate space for the file array */
-    
-    file_list = (char**) malloc(sizeof(char*) * numfiles);
-    if(file_list == NULL)
+    n = readPacked(files->packed, offset, files->codec, files->arena, &docs, &freqs, &positions);
+    if(n < 0)
     {
-        fprintf(stderr, "Error: Could not allocate space for file list.\n");
         return NULL;
     }
     
-    /* Parse the list of files */
+    word = createArenaWord(files->arena, lexiconTerm(files->lexicon, i));
+    if(word == NULL)
+    {
+        return NULL;
+    }
     
-    counter = 0;
+    word->numFiles = n;
+    word->positions = positions;
+    tail = NULL;
     
-    while((str = TKGetNextToken(tok)) != 0 && strcmp(str, "/files") != 0)
+    for(k = 0; k < n; k++)
     {
-        /* First str is just the int index (equal to counter) */
-        free(str);
-        str = TKGetNextToken(tok);
-        
-        file_list[counter] = (char*) malloc(sizeof(char) * (strlen(str) + 1));
-        if(file_list[counter] == NULL)
+        ent = createArenaEntry(files->arena, docs[k], freqs[k]);
+        if(ent == NULL)
         {
-            fprintf(stderr, "Error: Could not allocate space for filename.\n");
             return NULL;
         }
-        strcpy(file_list[counter], str);
         
-        free(str);
+        if(tail == NULL)
+        {
+            word->head = ent;
+        }
+        else
+        {
+            tail->next = ent;
+        }
         
-        counter++;
+        tail = ent;
+        word->totalAppearances += freqs[k];
     }
     
-    free(str);
+    return word;
+}
+
+/* lookupWord
+ *
+ * Finds a term in the cache, or failing that in the index. Terms
+ * the index's Bloom filter turns away are not looked for at all.
+ * With a lexicon the index is read right where the term starts,
+ * and terms that are not in it cost a binary search. Without one
+ * the index is scanned, so a term that turns out not to be there
+ * is cached as an empty Word, and found there as such next time.
+ * Words read from the index live in the query arena, the cache
+ * gets its own copy when there is room. Terms of a batch (see
+ * loadBatch) come from the batch.
+ *
+ * @param   term        term to look up
+ * @param   tok         tokenizer object
+ * @param   files       filelist object
+ * @param   cache       Cache object
+ *
+ * @return  success     Word
+ * @return  not found   NULL
+ */
+
+Word lookupWord(char *term, TokenizerT tok, Filelist files, Cache cache)
+{
+    Word found;
+    int i;
     
-    /* Now allocate the actual struct */
+    /* A batch fetched its terms up front, the ones the index lacks too */
+    if(files->batch != NULL && (found = (Word) searchHT(files->batch, term)) != NULL)
+    {
+        return (found->numFiles > 0) ? copyArenaWord(files->arena, found) : NULL;
+    }
     
-    files = (Filelist) malloc(sizeof(struct Filelist_));
-    if(files == NULL)
+    /* The filter never turns away a term the index has */
+    if(files->index->bloom != NULL && !bloomContains(files->index->bloom, term))
     {
-        fprintf(stderr, "Error: Could not allocate space for filelist.\n");
         return NULL;
     }
     
-    files->list = file_list;
-    files->numfiles = numfiles;
-    
-    files->results = NULL;
+    found = searchCache(cache, term, files->arena);
+    if(found == NULL)
+    {
+        /* The lexicon knows where the term is, or that it is not there */
+        if(files->lexicon != NULL)
+        {
+            i = findTerm(files->lexicon, term);
+            if(i < 0)
+            {
+                return NULL;
+            }
+            
+            found = readTerm(files, tok, i);
+        }
+        else
+        {
+            found = getWord(tok, term, files->arena);
+            
+            /* Scanning the whole index for nothing is worth not doing twice */
+            if(found == NULL)
+            {
+                found = createArenaWord(files->arena, term);
+                if(found != NULL)
+                {
+                    insertWord(cache, found);
+                }
+                
+                return NULL;
+            }
+        }
+        
+        if(found != NULL)
+        {
+            insertWord(cache, found);
+        }
+    }
+    else
+    {
+        if(DEBUG) printf("Found %s in cache.\n", term);
+        
+        /* A term an earlier scan did not find */
+        if(found->numFiles == 0)
+        {
+            return NULL;
+        }
+    }
     
-    return files;
+    return found;
 }
 
-/* destroyFilelist
+/* expandWord
  *
- * Function that destroys a filelist object.
+ * Expands a wildcard or fuzzy query word in the lexicon (see
+ * expandWildcard and expandFuzzy).
  *
- * @param   files       pointer to filelist
+ * @param   word        query word
+ * @param   distance    edit distance for a fuzzy word, -1 for a
+ *                      wildcard
+ * @param   files       filelist object, with a lexicon
+ * @param   terms       where to store up to max term numbers, in
+ *                      index order
+ * @param   max         most terms to keep
  *
- * @return  void
+ * @return  success     number of terms kept
+ * @return  failure     -1
  */
 
-void destroyFilelist(Filelist files)
+int expandWord(char *word, int distance, Filelist files, int *terms, int max)
 {
-    int counter;
+    char *term;
     
-    if(files != NULL)
+    if(distance < 0)
     {
-        for(counter = 0; counter < files->numfiles; counter++)
-        {
-            free(files->list[counter]);
-        }
-        
-        free(files->list);
-        resetResults(files);
-        
-        free(files);
+        return expandWildcard(files->lexicon, word, terms, max);
+    }
+    
+    /* The term is what comes before the operator */
+    term = arenaString(files->arena, word);
+    if(term == NULL)
+    {
+        return -1;
     }
+    *strchr(term, FUZZY_OPERATOR) = '\0';
+    
+    return expandFuzzy(files->lexicon, term, distance, terms, max);
 }
 
-/* resetResults
+/* chosenExpansions
  *
- * Resets the results after a search has been completed.
+ * Finds the terms the coordinator of a sharded index chose for a
+ * wildcard or fuzzy query word (see files->expansions), the ones
+ * the shard has.
  *
- * @param   files       filelist object
+ * @param   files       filelist object, with a lexicon
+ * @param   word        query word
+ * @param   terms       where to store up to MAX_EXPANSIONS term
+ *                      numbers, in index order
  *
- * @return  void
+ * @return  chosen      number of terms
+ * @return  not chosen  -1
  */
- 
-void resetResults(Filelist files)
+
+int chosenExpansions(Filelist files, char *word, int *terms)
 {
-    Result curr, next;
+    char **line, *term, *end, *copy;
+    int count, len, i, j;
     
-    curr = files->results;
-    while(curr != NULL)
+    if(files->expansions == NULL)
     {
-        next = curr->next;
+        return -1;
+    }
+    
+    len = strlen(word);
+    
+    for(line = files->expansions; *line != NULL; line++)
+    {
+        if(strncmp(*line, word, len) == 0 && ((*line)[len] == ' ' || (*line)[len] == '\0'))
+        {
+            break;
+        }
+    }
+    
+    if(*line == NULL)
+    {
+        return -1;
+    }
+    
+    count = 0;
+    
+    for(term = *line + len; *term == ' ' && count < MAX_EXPANSIONS; term = end)
+    {
+        term++;
+        end = term + strcspn(term, " ");
         
-        free(curr);
+        copy = (char*) arenaAlloc(files->arena, end - term + 1);
+        if(copy == NULL)
+        {
+            return -1;
+        }
+        memcpy(copy, term, end - term);
+        copy[end - term] = '\0';
         
-        curr = next;
+        /* A term none of this shard's files hold is simply not read */
+        i = findTerm(files->lexicon, copy);
+        if(i < 0)
+        {
+            continue;
+        }
+        
+        /* Kept in index order as they come */
+        for(j = count; j > 0 && terms[j - 1] > i; j--)
+        {
+            terms[j] = terms[j - 1];
+        }
+        terms[j] = i;
+        count++;
     }
     
-    files->results = NULL;
+    return count;
 }
 
-/* sortResults
+/* lookupExpansion
  *
- * Sorts the results in order of frequency (Eventually this
- * will be score)
+ * Finds a wildcard or fuzzy query word in the cache, or failing
+ * that expands it in the lexicon (see expandWord) and reads the
+ * union of the postings of at most MAX_EXPANSIONS terms, in index
+ * order so the reads only move forward. A shard expands it to the
+ * terms its coordinator chose instead (see chosenExpansions). The
+ * union is cached under the query word as typed, which can never
+ * clash with an index term.
  *
+ * @param   word        query word
+ * @param   distance    edit distance for a fuzzy word, -1 for a
+ *                      wildcard
+ * @param   tok         tokenizer object
  * @param   files       filelist object
+ * @param   cache       Cache object
  *
- * @return  void
+ * @return  success     Word
+ * @return  no match    NULL
  */
 
-void sortResults(Filelist files)
+Word lookupExpansion(char *word, int distance, TokenizerT tok, Filelist files, Cache cache)
 {
-    Result curr, next, sorted, scurr, sprev;
-    int inserted;
-    double diff;
+    Lexicon lex;
+    Word found, expansion;
+    Entry ent, tail;
+    int *expansions, *counts, i, numexpansions;
     
-    curr = files->results;
-    sorted = NULL;
+    found = searchCache(cache, word, files->arena);
+    if(found != NULL)
+    {
+        if(DEBUG) printf("Found %s in cache.\n", word);
+        return found;
+    }
     
-    while(curr != NULL)
+    lex = files->lexicon;
+    if(lex == NULL)
     {
-        next = curr->next;
-        
-        /* Set scurr to the front of the list, sprev to NULL, and inserted to 0 */
-        scurr = sorted;
-        sprev = NULL;
-        inserted = 0;
+        fprintf(stderr, "Error: Wildcard and fuzzy terms need the index's lexicon.\n");
+        return NULL;
+    }
+    
+    expansions = (int*) arenaAlloc(files->arena, sizeof(int) * MAX_EXPANSIONS);
+    counts = (int*) arenaAlloc(files->arena, sizeof(int) * (files->numfiles + 1));
+    if(expansions == NULL || counts == NULL)
+    {
+        return NULL;
+    }
+    
+    numexpansions = chosenExpansions(files, word, expansions);
+    if(numexpansions < 0)
+    {
+        numexpansions = expandWord(word, distance, files, expansions, MAX_EXPANSIONS);
+    }
+    
+    if(DEBUG) printf("%s: %i terms kept\n", word, numexpansions);
+    
+    memset(counts, 0, sizeof(int) * (files->numfiles + 1));
+    
+    for(i = 0; i < numexpansions; i++)
+    {
+        expansion = readTerm(files, tok, expansions[i]);
+        if(expansion == NULL)
+        {
+            return NULL;
+        }
         
-        while(scurr != NULL && inserted == 0)
+        for(ent = expansion->head; ent != NULL; ent = ent->next)
         {
-            diff = curr->score - scurr->score;
-            
-            if(diff >= 0.0)
+            if(ent->filenumber >= 0 && ent->filenumber < files->numfiles)
             {
-                /* The new one is bigger than the current node */
-                if(sprev == NULL)
-                {
-                    /* Insert it at the front of the list */
-                    curr->next = scurr;
-                    sorted = curr;
-                }
-                else
-                {
-                    sprev->next = curr;
-                    curr->next = scurr;
-                }
-                inserted = 1;
+                counts[ent->filenumber] += ent->frequency;
             }
-            
-            sprev = scurr;
-            scurr = scurr->next;
+        }
+    }
+    
+    /* Gather the union, one entry per file */
+    found = createArenaWord(files->arena, word);
+    if(found == NULL)
+    {
+        return NULL;
+    }
+    
+    tail = NULL;
+    
+    for(i = 0; i < files->numfiles; i++)
+    {
+        if(counts[i] == 0)
+        {
+            continue;
         }
         
-        if(inserted == 0)
+        ent = createArenaEntry(files->arena, i, counts[i]);
+        if(ent == NULL)
         {
-            /* We reached the end of the list, put it there */
-            if(sprev == NULL)
-            {
-                /* Insert it at the front of the list */
-                curr->next = scurr;
-                sorted = curr;
-            }
-            else
-            {
-                sprev->next = curr;
-                curr->next = scurr;
-            }
+            return NULL;
         }
         
-        curr = next;
+        if(tail == NULL)
+        {
+            found->head = ent;
+        }
+        else
+        {
+            tail->next = ent;
+        }
+        tail = ent;
+        
+        found->numFiles++;
+        found->totalAppearances += counts[i];
     }
     
-    files->results = sorted;
+    if(found->head == NULL)
+    {
+        return NULL;
+    }
+    
+    insertWord(cache, found);
+    
+    return found;
+}
 
+/* compPositionLists
+ *
+ * qsort comparator that orders PositionLists by file number.
+ *
+ * @param   ptr1        first list
+ * @param   ptr2        second list
+ *
+ * @return  int         <0, 0 or >0
+ */
+
+int compPositionLists(const void *ptr1, const void *ptr2)
+{
+    return ((PositionList) ptr1)->filenum - ((PositionList) ptr2)->filenum;
 }
 
-/* scoreFile
+/* matchPhrase
  *
- * Function that computes the Term frequency and inverse document frequency
+ * Counts how often the words of a phrase follow each other in one
+ * file. lists[i] points at word i's positions in that file. Every
+ * list is walked once, since both the start of the phrase and the
+ * position word i needs only ever go up.
  *
- * @param   totalFiles              the total number of files in the index
- * @param   filescontword           total number of files containing the word
- * @param   freq                    frequency of the word in the document in question
+ * @param   lists       positions of each word in the file
+ * @param   numterms    number of words in the phrase
+ * @param   cursor      scratch space for numterms ints
  *
- * @return  double                  score
+ * @return  int         number of occurrences
  */
 
-double scoreFile(int totalFiles, int filescontword, int freq)
+int matchPhrase(PositionList *lists, int numterms, int *cursor)
 {
-    /* N = Total files, Nt = Number of files containing the result, Ft = frequency in the file */
-    int Nt, N, Ft;
-    double IDFt, TFt;
-    
-    Nt = totalFiles;
-    N = filescontword;
-    Ft = freq;
+    int i, j, count, match;
+    unsigned int start;
+    PositionList list;
     
+    count = 0;
     
-    IDFt = log((1.0 + ((double)N / Nt)));
-    TFt = 1 + log((double)Ft);
+    for(i = 0; i < numterms; i++)
+    {
+        cursor[i] = 0;
+    }
+    
+    for(j = 0; j < lists[0]->count; j++)
+    {
+        start = lists[0]->positions[j];
+        match = 1;
+        
+        for(i = 1; i < numterms && match; i++)
+        {
+            list = lists[i];
+            
+            while(cursor[i] < list->count && list->positions[cursor[i]] < start + i)
+            {
+                cursor[i]++;
+            }
+            
+            /* Word i has no positions left, later starts cannot match either */
+            if(cursor[i] == list->count)
+            {
+                return count;
+            }
+            
+            match = (list->positions[cursor[i]] == start + i);
+        }
+        
+        count += match;
+    }
+    
+    return count;
+}
+
+/* windowScan
+ *
+ * Slides a window over the positions of several words in one file.
+ * Each step moves the word with the smallest current position on
+ * to its next position, so every list is walked exactly once and
+ * the cost is linear in the number of positions, however many
+ * there are. Every step where the window (smallest to largest
+ * current position) spans at most window tokens counts as a match.
+ *
+ * @param   lists       positions of each word in the file
+ * @param   numterms    number of words
+ * @param   window      widest span that counts as a match
+ * @param   cursor      scratch space for numterms ints
+ * @param   matches     where to store the number of matches
+ *
+ * @return  int         smallest span that covers every word
+ */
+
+int windowScan(PositionList *lists, int numterms, int window, int *cursor, int *matches)
+{
+    int i, low, best;
+    unsigned int lowest, highest, pos;
+    
+    *matches = 0;
+    best = -1;
+    
+    for(i = 0; i < numterms; i++)
+    {
+        cursor[i] = 0;
+    }
+    
+    while(1)
+    {
+        low = 0;
+        lowest = highest = lists[0]->positions[cursor[0]];
+        
+        for(i = 1; i < numterms; i++)
+        {
+            pos = lists[i]->positions[cursor[i]];
+            
+            if(pos < lowest)
+            {
+                lowest = pos;
+                low = i;
+            }
+            if(pos > highest)
+            {
+                highest = pos;
+            }
+        }
+        
+        if(best < 0 || (int) (highest - lowest) < best)
+        {
+            best = (int) (highest - lowest);
+        }
+        
+        if((int) (highest - lowest) <= window)
+        {
+            (*matches)++;
+        }
+        
+        /* Once the lowest word runs out, the window can only get wider */
+        cursor[low]++;
+        if(cursor[low] == lists[low]->count)
+        {
+            break;
+        }
+    }
+    
+    return best;
+}
+
+/* isNearOperator
+ *
+ * Checks whether a query word is the NEAR/k operator.
+ *
+ * @param   word        query word
+ *
+ * @return  operator    1
+ * @return  term        0
+ */
+
+int isNearOperator(char *word)
+{
+    int i, len;
+    
+    len = strlen(NEAR_OPERATOR);
+    
+    for(i = 0; i < len; i++)
+    {
+        if(tolower(word[i]) != NEAR_OPERATOR[i])
+        {
+            return 0;
+        }
+    }
+    
+    return isdigit(word[len]) != 0;
+}
+
+/* isWildcard
+ *
+ * @param   word        query word
+ *
+ * @return  wildcard    1
+ * @return  otherwise   0
+ */
+
+int isWildcard(char *word)
+{
+    return strpbrk(word, WILDCARD_CHARS) != NULL;
+}
+
+/* fuzzyDistance
+ *
+ * Reads the edit distance off a fuzzy query word: "term~N", or
+ * "term~" for FUZZY_DISTANCE. Distances above MAX_FUZZY_DISTANCE
+ * are cut down to it.
+ *
+ * @param   word        query word
+ *
+ * @return  fuzzy       edit distance
+ * @return  otherwise   -1
+ */
+
+int fuzzyDistance(char *word)
+{
+    char *op, *c;
+    int distance;
+    
+    op = strrchr(word, FUZZY_OPERATOR);
+    if(op == NULL || op == word)
+    {
+        return -1;
+    }
+    
+    for(c = op + 1; *c != '\0'; c++)
+    {
+        if(!isdigit(*c))
+        {
+            return -1;
+        }
+    }
+    
+    distance = (op[1] == '\0') ? FUZZY_DISTANCE : atoi(op + 1);
+    
+    return (distance > MAX_FUZZY_DISTANCE) ? MAX_FUZZY_DISTANCE : distance;
+}
+
+/* operatorUnit
+ *
+ * Checks whether a query word is a boolean operator.
+ *
+ * @param   word        query word
+ *
+ * @return  operator    UNIT_AND, UNIT_OR or UNIT_NOT
+ * @return  term        -1
+ */
+
+int operatorUnit(char *word)
+{
+    if(strcmp(word, AND_OPERATOR) == 0)
+    {
+        return UNIT_AND;
+    }
+    if(strcmp(word, OR_OPERATOR) == 0)
+    {
+        return UNIT_OR;
+    }
+    if(strcmp(word, NOT_OPERATOR) == 0)
+    {
+        return UNIT_NOT;
+    }
+    
+    return -1;
+}
+
+/* parseQuery
+ *
+ * Splits a query into units. A word on its own is a term, words
+ * between double quotes are a phrase and words joined by NEAR/k
+ * are a NEAR group (a chain uses the smallest k). A word holding
+ * '*' or '?' is a wildcard and a word ending in ~N is fuzzy, both
+ * always stand on their own. Text between single quotes (spaces
+ * included) is one substring. AND, OR, NOT and each parenthesis
+ * outside a phrase are units of their own, holding no words. The
+ * words of a unit are stored next to each other in terms.
+ *
+ * @param   query       query text
+ * @param   arena       query arena
+ * @param   terms       where to store the array of words
+ * @param   numunits    where to store the number of units
+ *
+ * @return  success     array of QueryUnits
+ * @return  failure     NULL
+ */
+
+QueryUnit parseQuery(char *query, Arena arena, char ***terms, int *numunits)
+{
+    QueryUnit units, last;
+    char **words, *start, *word;
+    int len, numwords, n, inphrase, near, distance, op;
+    
+    /* There can't be more words or units than characters */
+    len = strlen(query);
+    words = (char**) arenaAlloc(arena, sizeof(char*) * (len + 1));
+    units = (QueryUnit) arenaAlloc(arena, sizeof(struct QueryUnit_) * (len + 1));
+    if(words == NULL || units == NULL)
+    {
+        return NULL;
+    }
+    
+    numwords = 0;
+    n = 0;
+    inphrase = 0;
+    near = -1;
+    
+    while(*query != '\0' && *query != '\n')
+    {
+        if(*query == ' ')
+        {
+            query++;
+            continue;
+        }
+        
+        if(*query == '"')
+        {
+            if(inphrase)
+            {
+                /* Drop empty phrases */
+                inphrase = 0;
+                if(units[n - 1].numterms == 0)
+                {
+                    n--;
+                }
+            }
+            else
+            {
+                inphrase = 1;
+                near = -1;
+                
+                units[n].type = UNIT_PHRASE;
+                units[n].first = numwords;
+                units[n].numterms = 0;
+                units[n].window = PHRASE_WINDOW;
+                n++;
+            }
+            
+            query++;
+            continue;
+        }
+        
+        if((*query == '(' || *query == ')') && !inphrase)
+        {
+            units[n].type = (*query == '(') ? UNIT_OPEN : UNIT_CLOSE;
+            units[n].first = numwords;
+            units[n].numterms = 0;
+            units[n].window = 0;
+            n++;
+            
+            near = -1;
+            query++;
+            continue;
+        }
+        
+        if(*query == SUBSTRING_QUOTE && !inphrase)
+        {
+            /* Everything up to the closing quote (or the end of the line) */
+            start = ++query;
+            while(*query != '\0' && *query != '\n' && *query != SUBSTRING_QUOTE)
+            {
+                query++;
+            }
+            
+            if(query > start)
+            {
+                word = (char*) arenaAlloc(arena, query - start + 1);
+                if(word == NULL)
+                {
+                    return NULL;
+                }
+                memcpy(word, start, query - start);
+                word[query - start] = '\0';
+                
+                units[n].type = UNIT_SUBSTRING;
+                units[n].first = numwords;
+                units[n].numterms = 1;
+                units[n].window = 0;
+                n++;
+                
+                words[numwords] = word;
+                numwords++;
+            }
+            
+            if(*query == SUBSTRING_QUOTE)
+            {
+                query++;
+            }
+            
+            near = -1;
+            continue;
+        }
+        
+        /* A word runs up to the next space or quote (or parenthesis) */
+        start = query;
+        while(*query != '\0' && *query != '\n' && *query != ' ' && *query != '"' &&
+              (inphrase || (*query != '(' && *query != ')')))
+        {
+            query++;
+        }
+        
+        word = (char*) arenaAlloc(arena, query - start + 1);
+        if(word == NULL)
+        {
+            return NULL;
+        }
+        memcpy(word, start, query - start);
+        word[query - start] = '\0';
+        
+        last = (n > 0) ? &units[n - 1] : NULL;
+        op = operatorUnit(word);
+        
+        if(inphrase)
+        {
+            words[numwords] = word;
+            numwords++;
+            last->numterms++;
+        }
+        else if(op >= 0)
+        {
+            units[n].type = op;
+            units[n].first = numwords;
+            units[n].numterms = 0;
+            units[n].window = 0;
+            n++;
+            
+            near = -1;
+        }
+        else if(isNearOperator(word))
+        {
+            /* Only terms and NEAR groups can be joined */
+            if(last != NULL && (last->type == UNIT_TERM || last->type == UNIT_NEAR))
+            {
+                near = atoi(word + strlen(NEAR_OPERATOR));
+            }
+        }
+        else if(near >= 0 && !isWildcard(word) && fuzzyDistance(word) < 0)
+        {
+            if(last->type == UNIT_TERM || near < last->window)
+            {
+                last->window = near;
+            }
+            last->type = UNIT_NEAR;
+            
+            words[numwords] = word;
+            numwords++;
+            last->numterms++;
+            
+            near = -1;
+        }
+        else
+        {
+            distance = fuzzyDistance(word);
+            
+            units[n].type = UNIT_TERM;
+            units[n].first = numwords;
+            units[n].numterms = 1;
+            units[n].window = 0;
+            
+            if(distance >= 0)
+            {
+                units[n].type = UNIT_FUZZY;
+                units[n].window = distance;
+            }
+            else if(isWildcard(word))
+            {
+                units[n].type = UNIT_WILDCARD;
+            }
+            n++;
+            
+            words[numwords] = word;
+            numwords++;
+            
+            near = -1;
+        }
+    }
+    
+    /* An unclosed phrase ends with the line */
+    if(inphrase && units[n - 1].numterms == 0)
+    {
+        n--;
+    }
+    
+    *terms = words;
+    *numunits = n;
+    
+    return units;
+}
+
+/* boostProximity
+ *
+ * Adds a proximity boost to every result that holds more than one
+ * of the plain query terms. The boost is PROXIMITY_WEIGHT for each
+ * extra term when the terms are adjacent and shrinks as the
+ * smallest window that covers them (see windowScan) grows. Does
+ * nothing when the index has no positions.
+ *
+ * @param   files       filelist object
+ * @param   words       the plain terms that were found
+ * @param   numwords    number of words
+ *
+ * @return  void
+ */
+
+void boostProximity(Filelist files, Word *words, int numwords)
+{
+    PositionList *lists, *present;
+    struct PositionList_ key;
+    int *counts, *cursor, i, m, span, matches;
+    Result result;
+    
+    if(files->positions == NULL)
+    {
+        return;
+    }
+    
+    lists = (PositionList*) arenaAlloc(files->arena, sizeof(PositionList) * numwords);
+    present = (PositionList*) arenaAlloc(files->arena, sizeof(PositionList) * numwords);
+    counts = (int*) arenaAlloc(files->arena, sizeof(int) * numwords);
+    cursor = (int*) arenaAlloc(files->arena, sizeof(int) * numwords);
+    
+    if(lists == NULL || present == NULL || counts == NULL || cursor == NULL)
+    {
+        return;
+    }
+    
+    for(i = 0; i < numwords; i++)
+    {
+        lists[i] = readPositions(files, words[i], &counts[i]);
+        if(lists[i] == NULL)
+        {
+            return;
+        }
+    }
+    
+    for(result = files->results; result != NULL; result = result->next)
+    {
+        /* Collect the terms this file holds (lists are sorted by file) */
+        key.filenum = result->filenum;
+        m = 0;
+        
+        for(i = 0; i < numwords; i++)
+        {
+            present[m] = (PositionList) bsearch(&key, lists[i], counts[i], sizeof(struct PositionList_), compPositionLists);
+            if(present[m] != NULL)
+            {
+                m++;
+            }
+        }
+        
+        if(m > 1)
+        {
+            /* Adjacent terms span m - 1 tokens (less if a term is repeated) */
+            span = windowScan(present, m, 0, cursor, &matches) - (m - 1);
+            if(span < 0)
+            {
+                span = 0;
+            }
+            
+            result->score += PROXIMITY_WEIGHT * (m - 1) / (1.0 + span);
+        }
+    }
+}
+
+/* matchPositions
+ *
+ * Finds the files that hold every word (walking the words' lists
+ * in file order, led by the rarest word) and keeps the ones where
+ * the words are close enough. A window of PHRASE_WINDOW asks for
+ * the words in order at consecutive positions, any other window
+ * is handed to windowScan.
+ *
+ * @param   terms       words to match
+ * @param   numterms    number of words
+ * @param   window      PHRASE_WINDOW or the widest span allowed
+ * @param   tok         tokenizer object
+ * @param   files       filelist object
+ * @param   cache       Cache object
+ *
+ * @return  success     Word holding the matches per file
+ * @return  no match    NULL
+ */
+
+Word matchPositions(char **terms, int numterms, int window, TokenizerT tok, Filelist files, Cache cache)
+{
+    Word word, group;
+    Entry ent;
+    PositionList *lists, *current;
+    int *counts, *next, *cursor;
+    int i, j, lead, match, occurrences;
+    
+    if(numterms == 1)
+    {
+        return lookupWord(terms[0], tok, files, cache);
+    }
+    
+    lists = (PositionList*) arenaAlloc(files->arena, sizeof(PositionList) * numterms);
+    current = (PositionList*) arenaAlloc(files->arena, sizeof(PositionList) * numterms);
+    counts = (int*) arenaAlloc(files->arena, sizeof(int) * numterms);
+    next = (int*) arenaAlloc(files->arena, sizeof(int) * numterms);
+    cursor = (int*) arenaAlloc(files->arena, sizeof(int) * numterms);
+    
+    if(lists == NULL || current == NULL || counts == NULL || next == NULL || cursor == NULL)
+    {
+        return NULL;
+    }
+    
+    /* Every word has to be there, and the rarest one leads the walk */
+    lead = 0;
+    
+    for(i = 0; i < numterms; i++)
+    {
+        word = lookupWord(terms[i], tok, files, cache);
+        if(word == NULL)
+        {
+            return NULL;
+        }
+        
+        lists[i] = readPositions(files, word, &counts[i]);
+        if(lists[i] == NULL)
+        {
+            return NULL;
+        }
+        
+        next[i] = 0;
+        
+        if(counts[i] < counts[lead])
+        {
+            lead = i;
+        }
+    }
+    
+    group = createArenaWord(files->arena, terms[0]);
+    if(group == NULL)
+    {
+        return NULL;
+    }
+    
+    ent = NULL;
+    
+    for(j = 0; j < counts[lead]; j++)
+    {
+        /* Move every other word up to the lead's file */
+        match = 1;
+        
+        for(i = 0; i < numterms; i++)
+        {
+            if(i != lead)
+            {
+                while(next[i] < counts[i] && lists[i][next[i]].filenum < lists[lead][j].filenum)
+                {
+                    next[i]++;
+                }
+                
+                if(next[i] == counts[i])
+                {
+                    /* This word has no files left, neither does the group */
+                    j = counts[lead];
+                    match = 0;
+                    break;
+                }
+                
+                if(lists[i][next[i]].filenum != lists[lead][j].filenum)
+                {
+                    match = 0;
+                }
+            }
+            
+            current[i] = (i == lead) ? &lists[lead][j] : &lists[i][next[i]];
+        }
+        
+        if(match == 0)
+        {
+            continue;
+        }
+        
+        if(window == PHRASE_WINDOW)
+        {
+            occurrences = matchPhrase(current, numterms, cursor);
+        }
+        else
+        {
+            windowScan(current, numterms, window, cursor, &occurrences);
+        }
+        
+        if(occurrences == 0)
+        {
+            continue;
+        }
+        
+        if(ent == NULL)
+        {
+            group->head = createArenaEntry(files->arena, lists[lead][j].filenum, occurrences);
+            ent = group->head;
+        }
+        else
+        {
+            ent->next = createArenaEntry(files->arena, lists[lead][j].filenum, occurrences);
+            ent = ent->next;
+        }
+        
+        if(ent == NULL)
+        {
+            return NULL;
+        }
+        
+        group->numFiles++;
+        group->totalAppearances += occurrences;
+    }
+    
+    if(group->head == NULL)
+    {
+        return NULL;
+    }
+    
+    return group;
+}
+
+/* lookupUnit
+ *
+ * Finds the postings of one unit of a query, whatever kind it is
+ * (see parseQuery). Operators and parentheses have none.
+ *
+ * @param   unit        query unit
+ * @param   terms       terms of the query
+ * @param   tok         tokenizer object
+ * @param   files       filelist object
+ * @param   cache       Cache object
+ * @param   found       where to store its word, NULL when it
+ *                      matched nothing
+ *
+ * @return  postings    1
+ * @return  operator    0
+ */
+
+int lookupUnit(QueryUnit unit, char **terms, TokenizerT tok, Filelist files, Cache cache, Word *found)
+{
+    *found = NULL;
+    
+    if(unit->type == UNIT_PHRASE)
+    {
+        *found = getPhrase(terms + unit->first, unit->numterms, tok, files, cache);
+    }
+    else if(unit->type == UNIT_NEAR)
+    {
+        *found = getNear(terms + unit->first, unit->numterms, unit->window, tok, files, cache);
+    }
+    else if(unit->type == UNIT_WILDCARD)
+    {
+        *found = getWildcard(terms[unit->first], tok, files, cache);
+    }
+    else if(unit->type == UNIT_FUZZY)
+    {
+        *found = getFuzzy(terms[unit->first], unit->window, tok, files, cache);
+    }
+    else if(unit->type == UNIT_SUBSTRING)
+    {
+        *found = getSubstring(terms[unit->first], files);
+    }
+    else if(unit->type == UNIT_TERM)
+    {
+        *found = lookupWord(terms[unit->first], tok, files, cache);
+    }
+    else
+    {
+        return 0;
+    }
+    
+    return 1;
+}
+
+/* unitFiles
+ *
+ * Number of files holding a unit of the query, the one its score
+ * goes by: the index's own count, or the count over every shard
+ * when the query is one shard's part of a bigger one (see
+ * files->unitFiles).
+ *
+ * @param   files       filelist object
+ * @param   unit        number of the unit
+ * @param   found       word of the unit
+ *
+ * @return  int         number of files
+ */
+
+int unitFiles(Filelist files, int unit, Word found)
+{
+    return (files->unitFiles != NULL) ? files->unitFiles[unit] : found->numFiles;
+}
+
+/* compTerms
+ *
+ * qsort comparator for terms, in strcmp order.
+ *
+ * @param   ptr1        first term
+ * @param   ptr2        second term
+ *
+ * @return  int         <0, 0 or >0
+ */
+
+int compTerms(const void *ptr1, const void *ptr2)
+{
+    return strcmp(*(char* const*) ptr1, *(char* const*) ptr2);
+}
+
+/* answerKey
+ *
+ * Normalizes a query into the key of its answer in the result
+ * cache. Plain terms with no operators between them give the same
+ * answer in any order, so their key is the search type and the
+ * terms sorted: "so cats dogs" for "so dogs cats". A term given
+ * twice counts twice in the scores, so it stays in twice. Any
+ * other query is its own key, as typed.
+ *
+ * @param   action      "so ..." or "sa ..."
+ * @param   arena       where to build the key
+ *
+ * @return  success     the key
+ * @return  failure     NULL (the query cannot be parsed)
+ */
+
+char *answerKey(char *action, Arena arena)
+{
+    QueryUnit units;
+    char **terms, **sorted, *key;
+    size_t length;
+    int i, numunits;
+    
+    units = parseQuery(action + 3, arena, &terms, &numunits);
+    if(units == NULL)
+    {
+        return NULL;
+    }
+    
+    length = strcspn(action, "\r\n");
+    
+    for(i = 0; i < numunits && units[i].type == UNIT_TERM; i++)
+    {
+        length += strlen(terms[units[i].first]) + 1;
+    }
+    
+    key = (char*) arenaAlloc(arena, length + 4);
+    sorted = (char**) arenaAlloc(arena, sizeof(char*) * (numunits + 1));
+    if(key == NULL || sorted == NULL)
+    {
+        fprintf(stderr, "Error: Could not allocate space for the query.\n");
+        return NULL;
+    }
+    
+    if(i < numunits || numunits == 0)
+    {
+        memcpy(key, action, strcspn(action, "\r\n"));
+        key[strcspn(action, "\r\n")] = '\0';
+        return key;
+    }
+    
+    for(i = 0; i < numunits; i++)
+    {
+        sorted[i] = terms[units[i].first];
+    }
+    qsort(sorted, numunits, sizeof(char*), compTerms);
+    
+    key[0] = action[0];
+    key[1] = action[1];
+    key[2] = '\0';
+    
+    for(i = 0; i < numunits; i++)
+    {
+        strcat(key, " ");
+        strcat(key, sorted[i]);
+    }
+    
+    return key;
+}
+
+/* keepAnswer
+ *
+ * Keeps the results of the query just run in the result cache.
+ *
+ * @param   files       filelist object
+ * @param   key         the query, normalized (see answerKey)
+ *
+ * @return  success     1
+ * @return  failure     0
+ */
+
+int keepAnswer(Filelist files, char *key)
+{
+    Result result;
+    Hit hits;
+    int count;
+    
+    count = 0;
+    for(result = files->results; result != NULL; result = result->next)
+    {
+        count++;
+    }
+    
+    hits = (Hit) arenaAlloc(files->arena, sizeof(struct Hit_) * (count + 1));
+    if(hits == NULL)
+    {
+        fprintf(stderr, "Error: Could not allocate space for the answer.\n");
+        return 0;
+    }
+    
+    count = 0;
+    for(result = files->results; result != NULL; result = result->next)
+    {
+        hits[count].filenum = result->filenum;
+        hits[count].frequency = result->frequency;
+        hits[count].numfiles = result->numfiles;
+        hits[count].score = result->score;
+        count++;
+    }
+    
+    return insertAnswer(files->answers, key, files->index->generation, hits, count);
+}
+
+/* replayAnswer
+ *
+ * Turns a cached answer back into the results of the query.
+ *
+ * @param   files       filelist object
+ * @param   hits        the results, best first
+ * @param   count       number of results
+ *
+ * @return  success     1
+ * @return  failure     0
+ */
+
+int replayAnswer(Filelist files, Hit hits, int count)
+{
+    Result result, tail;
+    int i;
+    
+    files->results = NULL;
+    tail = NULL;
+    
+    for(i = 0; i < count; i++)
+    {
+        result = createResult(files, hits[i].filenum);
+        if(result == NULL)
+        {
+            return 0;
+        }
+        
+        result->frequency = hits[i].frequency;
+        result->numfiles = hits[i].numfiles;
+        result->score = hits[i].score;
+        
+        if(tail == NULL)
+        {
+            files->results = result;
+        }
+        else
+        {
+            tail->next = result;
+        }
+        tail = result;
+    }
+    
+    return 1;
+}
+
+/* startsOperand
+ *
+ * Checks whether a unit can start an operand of a boolean query
+ * (a term of any kind, NOT or an opening parenthesis).
+ *
+ * @param   unit        query unit
+ *
+ * @return  operand     1
+ * @return  otherwise   0
+ */
+
+int startsOperand(QueryUnit unit)
+{
+    return unit->type != UNIT_AND && unit->type != UNIT_OR && unit->type != UNIT_CLOSE;
+}
+
+/* Operands hold whole levels between parentheses */
+PlanNode compileLevel(int type, QueryUnit units, int numunits, PlanNode *leaves, int *pos, int op, Arena arena);
+
+/* compileOperand
+ *
+ * Compiles one operand of a boolean query: a unit's leaf, NOT and
+ * its operand, or a query between parentheses (an unmatched one is
+ * closed by the end of the query).
+ *
+ * @param   units       query units
+ * @param   numunits    number of units
+ * @param   leaves      leaf of each unit
+ * @param   pos         index of the next unit, moved past the operand
+ * @param   op          PLAN_AND or PLAN_OR, joins operands that have
+ *                      no operator between them
+ * @param   arena       query arena
+ *
+ * @return  success     PlanNode
+ * @return  no operand  NULL
+ */
+
+PlanNode compileOperand(QueryUnit units, int numunits, PlanNode *leaves, int *pos, int op, Arena arena)
+{
+    PlanNode node;
+    
+    if(*pos >= numunits || !startsOperand(&units[*pos]))
+    {
+        return NULL;
+    }
+    
+    (*pos)++;
+    
+    if(units[*pos - 1].type == UNIT_NOT)
+    {
+        node = compileOperand(units, numunits, leaves, pos, op, arena);
+        return (node == NULL) ? NULL : createOperatorNode(arena, PLAN_NOT, &node, 1);
+    }
+    
+    if(units[*pos - 1].type == UNIT_OPEN)
+    {
+        node = compileLevel(PLAN_OR, units, numunits, leaves, pos, op, arena);
+        if(*pos < numunits && units[*pos].type == UNIT_CLOSE)
+        {
+            (*pos)++;
+        }
+        return node;
+    }
+    
+    return leaves[*pos - 1];
+}
+
+/* compileLevel
+ *
+ * Compiles a run of operands joined by OR (made of ANDs) or by AND
+ * (made of operands), so NOT binds tighter than AND and AND tighter
+ * than OR. Operands with no operator between them are joined by op.
+ * Missing operands ("a AND", "OR b") are left out.
+ *
+ * @param   type        PLAN_OR or PLAN_AND
+ * @param   units       query units
+ * @param   numunits    number of units
+ * @param   leaves      leaf of each unit
+ * @param   pos         index of the next unit, moved past the run
+ * @param   op          PLAN_AND or PLAN_OR
+ * @param   arena       query arena
+ *
+ * @return  success     PlanNode
+ * @return  no operand  NULL
+ */
+
+PlanNode compileLevel(int type, QueryUnit units, int numunits, PlanNode *leaves, int *pos, int op, Arena arena)
+{
+    PlanNode node, *operands;
+    int count, operator;
+    
+    operands = (PlanNode*) arenaAlloc(arena, sizeof(PlanNode) * (numunits + 1));
+    if(operands == NULL)
+    {
+        return NULL;
+    }
+    
+    operator = (type == PLAN_OR) ? UNIT_OR : UNIT_AND;
+    count = 0;
+    
+    while(1)
+    {
+        if(type == PLAN_OR)
+        {
+            node = compileLevel(PLAN_AND, units, numunits, leaves, pos, op, arena);
+        }
+        else
+        {
+            node = compileOperand(units, numunits, leaves, pos, op, arena);
+        }
+        
+        if(node != NULL)
+        {
+            operands[count] = node;
+            count++;
+        }
+        
+        if(*pos >= numunits)
+        {
+            break;
+        }
+        
+        if(units[*pos].type == operator)
+        {
+            (*pos)++;
+        }
+        else if(op != type || !startsOperand(&units[*pos]))
+        {
+            break;
+        }
+    }
+    
+    if(count == 0)
+    {
+        return NULL;
+    }
+    
+    return (count == 1) ? operands[0] : createOperatorNode(arena, type, operands, count);
+}
+
+/* compileQuery
+ *
+ * Compiles the units of a query into a plan. A stray closing
+ * parenthesis is skipped.
+ *
+ * @param   units       query units
+ * @param   numunits    number of units
+ * @param   leaves      leaf of each unit (NULL for operators)
+ * @param   op          PLAN_AND or PLAN_OR
+ * @param   arena       query arena
+ *
+ * @return  success     root of the plan
+ * @return  empty       NULL
+ */
+
+PlanNode compileQuery(QueryUnit units, int numunits, PlanNode *leaves, int op, Arena arena)
+{
+    PlanNode node, *operands;
+    int pos, count;
+    
+    operands = (PlanNode*) arenaAlloc(arena, sizeof(PlanNode) * (numunits + 1));
+    if(operands == NULL)
+    {
+        return NULL;
+    }
+    
+    pos = 0;
+    count = 0;
+    
+    while(pos < numunits)
+    {
+        node = compileLevel(PLAN_OR, units, numunits, leaves, &pos, op, arena);
+        if(node != NULL)
+        {
+            operands[count] = node;
+            count++;
+        }
+        
+        if(pos < numunits)
+        {
+            pos++;
+        }
+    }
+    
+    if(count == 0)
+    {
+        return NULL;
+    }
+    
+    return (count == 1) ? operands[0] : createOperatorNode(arena, op, operands, count);
+}
+
+/* isDisjunction
+ *
+ * Checks whether a plan is a single leaf or leaves OR'd together,
+ * the queries searchTopK can answer.
+ *
+ * @param   root        root of the plan
+ *
+ * @return  disjunction 1
+ * @return  otherwise   0
+ */
+
+int isDisjunction(PlanNode root)
+{
+    int i;
+    
+    if(root->type == PLAN_TERM)
+    {
+        return 1;
+    }
+    
+    if(root->type != PLAN_OR)
+    {
+        return 0;
+    }
+    
+    for(i = 0; i < root->numchildren; i++)
+    {
+        if(root->children[i]->type != PLAN_TERM)
+        {
+            return 0;
+        }
+    }
+    
+    return 1;
+}
+
+/* leafBlocks
+ *
+ * Gives a leaf its block summaries: a plain term's are read from
+ * the index, any other unit's (or those of an index without
+ * summaries) are worked out from its files.
+ *
+ * @param   files       filelist object
+ * @param   leaf        leaf of the plan
+ * @param   found       word of the leaf's unit
+ * @param   plain       whether the unit is a plain term
+ *
+ * @return  success     1
+ * @return  failure     0
+ */
+
+int leafBlocks(Filelist files, PlanNode leaf, Word found, int plain)
+{
+    long offset;
+    int i, size;
+    
+    if(plain && found != NULL && files->blocks != NULL && files->lexicon != NULL)
+    {
+        i = findTerm(files->lexicon, found->word);
+        offset = (i < 0) ? -1 : lexiconBlocks(files->lexicon, i);
+        
+        if(offset >= 0)
+        {
+            size = NUM_BLOCKS(leaf->count) + 1;
+            leaf->blocklast = (int*) arenaAlloc(files->arena, sizeof(int) * size);
+            leaf->blockmax = (int*) arenaAlloc(files->arena, sizeof(int) * size);
+            if(leaf->blocklast == NULL || leaf->blockmax == NULL)
+            {
+                return 0;
+            }
+            
+            leaf->numblocks = readBlockMaxima(files->blocks, offset, leaf->blocklast, leaf->blockmax, size);
+            leaf->block = 0;
+            if(leaf->numblocks >= 0)
+            {
+                return 1;
+            }
+        }
+    }
+    
+    return computeBlockMaxima(files->arena, leaf);
+}
+
+/* leafBitmap
+ *
+ * Gives the leaf of a common plain term the bitmap of its files,
+ * read from the containers in the index (see readContainers).
+ * Other leaves keep iterating over their files.
+ *
+ * @param   files       filelist object
+ * @param   leaf        leaf of the plan
+ * @param   found       word of the leaf's unit
+ *
+ * @return  success     1
+ * @return  failure     0
+ */
+
+int leafBitmap(Filelist files, PlanNode leaf, Word found)
+{
+    long offset;
+    int i;
+    
+    if(found == NULL || files->containers == NULL || files->lexicon == NULL)
+    {
+        return 1;
+    }
+    
+    i = findTerm(files->lexicon, found->word);
+    offset = (i < 0) ? -1 : lexiconContainers(files->lexicon, i);
+    if(offset < 0)
+    {
+        return 1;
+    }
+    
+    leaf->bits = (unsigned long*) arenaAlloc(files->arena, sizeof(unsigned long) * (BITMAP_WORDS(files->numfiles) + 1));
+    if(leaf->bits == NULL)
+    {
+        return 0;
+    }
+    
+    if(readContainers(files->containers, offset, leaf->bits, files->numfiles) == 0)
+    {
+        leaf->bits = NULL;
+    }
+    
+    return 1;
+}
+
+/* scoreBound
+ *
+ * Upper bound on the score a word can give a file, from the
+ * highest frequency it could have there.
+ *
+ * @param   files       filelist object
+ * @param   unit        number of the word's unit
+ * @param   found       word
+ * @param   freq        highest frequency
+ *
+ * @return  double      bound
+ */
+
+double scoreBound(Filelist files, int unit, Word found, int freq)
+{
+    return scoreFile(files->totalFiles, unitFiles(files, unit, found), freq) * (1.0 + BOUND_SLACK);
+}
+
+/* worseResult
+ *
+ * Checks whether a result ranks below another. Of two results with
+ * the same score the one with the higher file number ranks lower,
+ * as it does after sortResults.
+ *
+ * @param   a           first result
+ * @param   b           second result
+ *
+ * @return  lower       1
+ * @return  otherwise   0
+ */
+
+int worseResult(Result a, Result b)
+{
+    return a->score < b->score || (a->score == b->score && a->filenum > b->filenum);
+}
+
+/* compResults
+ *
+ * qsort comparator that orders Result pointers best first.
+ *
+ * @param   ptr1        first result
+ * @param   ptr2        second result
+ *
+ * @return  int         <0, 0 or >0
+ */
+
+int compResults(const void *ptr1, const void *ptr2)
+{
+    Result a, b;
+    
+    a = *(Result*) ptr1;
+    b = *(Result*) ptr2;
+    
+    if(worseResult(a, b))
+    {
+        return 1;
+    }
+    
+    return worseResult(b, a) ? -1 : 0;
+}
+
+/* pushResult
+ *
+ * Offers a result to a min-heap of the best k results so far, the
+ * worst of them at the top.
+ *
+ * @param   heap        the heap
+ * @param   size        number of results in it, updated
+ * @param   k           room in the heap
+ * @param   result      result to offer
+ *
+ * @return  void
+ */
+
+void pushResult(Result *heap, int *size, int k, Result result)
+{
+    int i, child;
+    
+    if(*size < k)
+    {
+        /* Still room, sift it up */
+        i = *size;
+        (*size)++;
+        
+        while(i > 0 && worseResult(result, heap[(i - 1) / 2]))
+        {
+            heap[i] = heap[(i - 1) / 2];
+            i = (i - 1) / 2;
+        }
+        
+        heap[i] = result;
+        return;
+    }
+    
+    if(!worseResult(heap[0], result))
+    {
+        return;
+    }
+    
+    /* Replace the worst one and sift it down */
+    i = 0;
+    
+    while((child = 2 * i + 1) < k)
+    {
+        if(child + 1 < k && worseResult(heap[child + 1], heap[child]))
+        {
+            child++;
+        }
+        
+        if(!worseResult(heap[child], result))
+        {
+            break;
+        }
+        
+        heap[i] = heap[child];
+        i = child;
+    }
+    
+    heap[i] = result;
+}
+
+/* initRange
+ *
+ * Sets up a range of files for scoreRange: its leaves are moved to
+ * the first file of the range and it gets room for its best k.
+ * A range can never keep more results than it has files.
+ *
+ * @param   files       filelist object
+ * @param   range       range to set up
+ * @param   leaves      leaves of the plan, in query order, with blocks
+ * @param   numleaves   number of leaves
+ * @param   found       word of each unit
+ * @param   bounds      score bound of each unit
+ * @param   first       first file of the range
+ * @param   end         file just past the range
+ * @param   k           number of results wanted
+ * @param   copy        whether the range needs copies of the leaves,
+ *                      so it can move them without the other ranges
+ *                      noticing
+ *
+ * @return  success     1
+ * @return  failure     0
+ */
+
+int initRange(Filelist files, TopKRange range, PlanNode *leaves, int numleaves, Word *found, double *bounds, int first, int end, int k, int copy)
+{
+    PlanNode leaf;
+    int i;
+    
+    if(end > files->numfiles)
+    {
+        end = files->numfiles;
+    }
+    
+    if(end - first < k)
+    {
+        k = end - first;
+    }
+    
+    range->files = files;
+    range->found = found;
+    range->bounds = bounds;
+    range->numleaves = numleaves;
+    range->first = first;
+    range->end = end;
+    range->k = k;
+    range->size = 0;
+    range->scored = 0;
+    
+    range->leaves = (PlanNode*) arenaAlloc(files->arena, sizeof(PlanNode) * numleaves);
+    range->order = (PlanNode*) arenaAlloc(files->arena, sizeof(PlanNode) * numleaves);
+    range->heap = (Result*) arenaAlloc(files->arena, sizeof(Result) * (k + 1));
+    range->slots = (Result) arenaAlloc(files->arena, sizeof(struct Result_) * (k + 1));
+    if(range->leaves == NULL || range->order == NULL || range->heap == NULL || range->slots == NULL)
+    {
+        fprintf(stderr, "Error: Could not allocate space for results.\n");
+        return 0;
+    }
+    
+    range->spare = &range->slots[0];
+    
+    for(i = 0; i < numleaves; i++)
+    {
+        leaf = leaves[i];
+        if(copy)
+        {
+            /* The files and blocks are shared, only the cursors are the range's own */
+            leaf = (PlanNode) arenaAlloc(files->arena, sizeof(struct PlanNode_));
+            if(leaf == NULL)
+            {
+                fprintf(stderr, "Error: Could not allocate space for results.\n");
+                return 0;
+            }
+            
+            *leaf = *leaves[i];
+        }
+        
+        range->leaves[i] = leaf;
+        range->order[i] = leaf;
+        
+        advancePlan(leaf, first);
+    }
+    
+    return 1;
+}
+
+/* scoreRange
+ *
+ * Finds the k best files of a range with Block-Max WAND. The
+ * leaves are kept in file order and the pivot is the first file
+ * that the leaves up to it could score above the worst of the k
+ * best so far (theta), going by each word's highest frequency.
+ * Files before the pivot are skipped. The pivot itself is only
+ * scored when the blocks that would hold it still add up to more
+ * than theta, otherwise the leaves skip to the end of the nearest
+ * block. Gives exactly the k results an exhaustive search of the
+ * range would. Only touches the range itself, so ranges can be
+ * scored at the same time.
+ *
+ * @param   range       range set up by initRange
+ *
+ * @return  void
+ */
+
+void scoreRange(TopKRange range)
+{
+    Filelist files;
+    PlanNode *leaves, *order, leaf;
+    Result result, evicted;
+    Word *found;
+    double *bounds, theta, acc;
+    int i, j, n, p, b, doc, next;
+    
+    files = range->files;
+    leaves = range->leaves;
+    order = range->order;
+    found = range->found;
+    bounds = range->bounds;
+    n = range->numleaves;
+    theta = -1.0;
+    
+    while(1)
+    {
+        /* Keep the leaves in file order, they hardly ever move far */
+        for(i = 1; i < n; i++)
+        {
+            for(j = i; j > 0 && order[j]->doc < order[j - 1]->doc; j--)
+            {
+                leaf = order[j];
+                order[j] = order[j - 1];
+                order[j - 1] = leaf;
+            }
+        }
+        
+        /* The pivot is where the bounds first add up to more than theta */
+        acc = 0.0;
+        p = -1;
+        
+        for(i = 0; i < n && order[i]->doc < range->end; i++)
+        {
+            acc += bounds[order[i]->leaf];
+            if(acc > theta)
+            {
+                p = i;
+                break;
+            }
+        }
+        
+        if(p < 0)
+        {
+            break;
+        }
+        
+        doc = order[p]->doc;
+        while(p + 1 < n && order[p + 1]->doc == doc)
+        {
+            p++;
+        }
+        
+        /* Tighten the bound with the blocks that would hold the pivot */
+        acc = 0.0;
+        next = (p + 1 < n) ? order[p + 1]->doc : PLAN_END;
+        
+        for(i = 0; i <= p; i++)
+        {
+            b = shallowAdvance(order[i], doc);
+            if(b < order[i]->numblocks)
+            {
+                acc += scoreBound(files, order[i]->leaf, found[order[i]->leaf], order[i]->blockmax[b]);
+                
+                if(order[i]->blocklast[b] + 1 < next)
+                {
+                    next = order[i]->blocklast[b] + 1;
+                }
+            }
+        }
+        
+        if(acc <= theta)
+        {
+            /* Nothing up to the end of the nearest block can make it */
+            for(i = 0; i <= p; i++)
+            {
+                advancePlan(order[i], next);
+            }
+            continue;
+        }
+        
+        if(order[0]->doc != doc)
+        {
+            /* Nothing before the pivot can make it */
+            for(i = 0; i < p; i++)
+            {
+                advancePlan(order[i], doc);
+            }
+            continue;
+        }
+        
+        /* Every leaf on the pivot is in order[0..p], score it in query order */
+        result = range->spare;
+        result->filenum = doc;
+        result->numfiles = 0;
+        result->frequency = 0;
+        result->score = 0.0;
+        result->next = NULL;
+        
+        for(i = 0; i < n; i++)
+        {
+            leaf = leaves[i];
+            if(leaf->doc == doc)
+            {
+                result->numfiles++;
+                result->frequency += leaf->freqs[leaf->pos];
+                result->score += scoreFile(files->totalFiles, unitFiles(files, leaf->leaf, found[leaf->leaf]), leaf->freqs[leaf->pos]);
+            }
+        }
+        range->scored++;
+        
+        /* Whatever the result pushes out is scored into next */
+        if(range->size < range->k || worseResult(range->heap[0], result))
+        {
+            evicted = (range->size == range->k) ? range->heap[0] : NULL;
+            pushResult(range->heap, &range->size, range->k, result);
+            range->spare = (evicted != NULL) ? evicted : &range->slots[range->size];
+            
+            if(range->size == range->k)
+            {
+                theta = range->heap[0]->score;
+            }
+        }
+        
+        for(i = 0; i <= p; i++)
+        {
+            advancePlan(order[i], doc + 1);
+        }
+    }
+}
+
+/* scoreRangeJob
+ *
+ * JobFunc that scores one range of a top-k search on a thread of
+ * the pool (see scoreRange).
+ *
+ * @param   worker      unused
+ * @param   job         the range
+ *
+ * @return  void
+ */
+
+void scoreRangeJob(void *worker, void *job)
+{
+    scoreRange((TopKRange) job);
+}
+
+/* searchTopK
+ *
+ * Finds the k best files for a disjunction (see scoreRange).
+ * When the Filelist asks for ranges and the lists are long
+ * enough, the files are split into that many ranges, starting at
+ * even steps through the longest list so each gets about as much
+ * of it, and every range is scored on a thread of the Filelist's
+ * pool (see Filelist_). The best k of every range are then
+ * merged, which gives the same results, in the same order, as
+ * scoring all the files as one range.
+ *
+ * @param   files       filelist object
+ * @param   root        root of the plan, every leaf has blocks
+ * @param   found       word of each unit
+ * @param   numunits    number of units
+ * @param   k           number of results wanted
+ *
+ * @return  success     1
+ * @return  failure     0
+ */
+
+int searchTopK(Filelist files, PlanNode root, Word *found, int numunits, int k)
+{
+    PlanNode *leaves, leaf, longest;
+    TopKRange ranges;
+    ThreadPool pool;
+    Result *merged;
+    double *bounds;
+    int *starts;
+    int i, j, n, b, max, doc, numranges, total, size, scored;
+    
+    if(root->type == PLAN_TERM)
+    {
+        leaves = &root;
+        n = 1;
+    }
+    else
+    {
+        leaves = root->children;
+        n = root->numchildren;
+    }
+    
+    bounds = (double*) arenaAlloc(files->arena, sizeof(double) * (numunits + 1));
+    if(bounds == NULL)
+    {
+        return 0;
+    }
+    
+    longest = leaves[0];
+    total = 0;
+    
+    for(i = 0; i < n; i++)
+    {
+        leaf = leaves[i];
+        
+        max = 0;
+        for(b = 0; b < leaf->numblocks; b++)
+        {
+            if(leaf->blockmax[b] > max)
+            {
+                max = leaf->blockmax[b];
+            }
+        }
+        
+        bounds[leaf->leaf] = (leaf->count == 0) ? 0.0 : scoreBound(files, leaf->leaf, found[leaf->leaf], max);
+        
+        total += leaf->count;
+        if(leaf->count > longest->count)
+        {
+            longest = leaf;
+        }
+    }
+    
+    /* Only lists this long are worth the threads */
+    numranges = (files->ranges > 1 && total >= MIN_RANGE_POSTINGS) ? files->ranges : 1;
+    if(numranges > MAX_THREADS)
+    {
+        numranges = MAX_THREADS;
+    }
+    
+    starts = (int*) arenaAlloc(files->arena, sizeof(int) * (numranges + 1));
+    ranges = (TopKRange) arenaAlloc(files->arena, sizeof(struct TopKRange_) * numranges);
+    if(starts == NULL || ranges == NULL)
+    {
+        return 0;
+    }
+    
+    /* A range is never empty, a file that starts two is only given to one */
+    starts[0] = 0;
+    j = 1;
+    
+    for(i = 1; i < numranges; i++)
+    {
+        doc = longest->docs[(long) longest->count * i / numranges];
+        if(doc > starts[j - 1])
+        {
+            starts[j++] = doc;
+        }
+    }
+    
+    numranges = j;
+    starts[numranges] = PLAN_END;
+    
+    for(i = 0; i < numranges; i++)
+    {
+        if(initRange(files, &ranges[i], leaves, n, found, bounds, starts[i], starts[i + 1], k, numranges > 1) == 0)
+        {
+            return 0;
+        }
+    }
+    
+    /* The threads are started once, for the first search that splits its files, and kept */
+    if(numranges > 1 && files->rangePool == NULL)
+    {
+        files->rangePool = createThreadPool((files->ranges < MAX_THREADS) ? files->ranges : MAX_THREADS, scoreRangeJob, NULL);
+        files->ownsPool = (files->rangePool != NULL);
+    }
+    
+    /* Without a pool, or room to queue a range, it is scored right here */
+    pool = (numranges > 1) ? files->rangePool : NULL;
+    
+    for(i = 0; i < numranges; i++)
+    {
+        if(pool == NULL || submitJob(pool, &ranges[i]) == 0)
+        {
+            scoreRange(&ranges[i]);
+        }
+    }
+    
+    /* Waits for every range to finish */
+    waitThreadPool(pool);
+    
+    total = 0;
+    scored = 0;
+    for(i = 0; i < numranges; i++)
+    {
+        total += ranges[i].size;
+        scored += ranges[i].scored;
+    }
+    
+    if(DEBUG) printf("Scored %i files in %i ranges.\n", scored, numranges);
+    
+    merged = (Result*) arenaAlloc(files->arena, sizeof(Result) * (total + 1));
+    if(merged == NULL)
+    {
+        return 0;
+    }
+    
+    size = 0;
+    for(i = 0; i < numranges; i++)
+    {
+        for(j = 0; j < ranges[i].size; j++)
+        {
+            merged[size++] = ranges[i].heap[j];
+        }
+    }
+    
+    qsort(merged, size, sizeof(Result), compResults);
+    
+    if(size > k)
+    {
+        size = k;
+    }
+    
+    for(i = 0; i < size; i++)
+    {
+        merged[i]->next = (i + 1 < size) ? merged[i + 1] : NULL;
+    }
+    files->results = (size > 0) ? merged[0] : NULL;
+    
+    return 1;
+}
+
+/* plainTerms
+ *
+ * Collects the words of the plain terms in a plan that are not
+ * negated, the ones proximity scoring looks at.
+ *
+ * @param   node        plan node
+ * @param   units       query units
+ * @param   found       word of each unit
+ * @param   plain       where to store the words
+ * @param   count       number of words stored so far
+ *
+ * @return  int         new number of words stored
+ */
+
+int plainTerms(PlanNode node, QueryUnit units, Word *found, Word *plain, int count)
+{
+    int i;
+    
+    if(node->type == PLAN_NOT)
+    {
+        return count;
+    }
+    
+    if(node->type == PLAN_TERM)
+    {
+        if(units[node->leaf].type == UNIT_TERM && found[node->leaf] != NULL)
+        {
+            plain[count] = found[node->leaf];
+            count++;
+        }
+        return count;
+    }
+    
+    for(i = 0; i < node->numchildren; i++)
+    {
+        count = plainTerms(node->children[i], units, found, plain, count);
+    }
+    
+    return count;
+}
+
+/* isPlainDisjunction
+ *
+ * Checks whether a query only ORs plain terms together, the
+ * queries searchImpacts can answer. Terms with no operator between
+ * them only count as OR'd when op says so.
+ *
+ * @param   units       query units
+ * @param   numunits    number of units
+ * @param   op          PLAN_AND or PLAN_OR, for terms with no
+ *                      operator between them
+ *
+ * @return  disjunction 1
+ * @return  otherwise   0
+ */
+
+int isPlainDisjunction(QueryUnit units, int numunits, int op)
+{
+    int i;
+    
+    if(numunits == 0)
+    {
+        return 0;
+    }
+    
+    for(i = 0; i < numunits; i++)
+    {
+        if(units[i].type == UNIT_OR)
+        {
+            /* Only ever between two terms */
+            if(i == 0 || i == numunits - 1 || units[i - 1].type != UNIT_TERM || units[i + 1].type != UNIT_TERM)
+            {
+                return 0;
+            }
+        }
+        else if(units[i].type != UNIT_TERM)
+        {
+            return 0;
+        }
+        else if(i > 0 && units[i - 1].type == UNIT_TERM && op != PLAN_OR)
+        {
+            return 0;
+        }
+    }
+    
+    return 1;
+}
+
+/* scoreImpacts
+ *
+ * Scores the files an impact search has come across so far. The
+ * score of a file (its lower bound) only counts the words it was
+ * found for, in query order, which is what an exhaustive search
+ * would give it once nothing is left to find. Its upper bound adds
+ * the bound of every word it was not found for yet.
+ *
+ * @param   files       filelist object
+ * @param   ranked      results so far
+ * @param   size        number of results
+ * @param   rows        frequency of each word in each file, by file
+ * @param   df          number of files holding each word
+ * @param   bounds      bound on what each word can still give a file
+ * @param   numunits    number of units
+ * @param   hi          where to store the upper bounds, by file
+ *
+ * @return  void
+ */
+
+void scoreImpacts(Filelist files, Result *ranked, int size, int **rows, int *df, double *bounds, int numunits, double *hi)
+{
+    Result result;
+    double rest;
+    int i, u, *row;
+    
+    for(i = 0; i < size; i++)
+    {
+        result = ranked[i];
+        row = rows[result->filenum];
+        
+        result->score = 0.0;
+        result->frequency = 0;
+        result->numfiles = 0;
+        rest = 0.0;
+        
+        for(u = 0; u < numunits; u++)
+        {
+            if(row[u] > 0)
+            {
+                result->numfiles++;
+                result->frequency += row[u];
+                result->score += scoreFile(files->totalFiles, df[u], row[u]);
+            }
+            else
+            {
+                rest += bounds[u];
+            }
+        }
+        
+        hi[result->filenum] = result->score + rest;
+    }
+}
+
+/* impactsSettled
+ *
+ * Checks whether the k best results of an impact search, and their
+ * order, can still change. Files that were not come across yet
+ * cannot get more than the bounds add up to, and a file whose
+ * upper bound is its score is done. Scores that are merged with
+ * those of other shards have to be whole, so then each of the k
+ * best has to be done as well.
+ *
+ * @param   ranked      results so far, sorted best first
+ * @param   size        number of results
+ * @param   k           number of results wanted
+ * @param   hi          upper bound of each file
+ * @param   rest        sum of the bounds of every word
+ * @param   exact       whether the k best need their whole score
+ *
+ * @return  settled     1
+ * @return  otherwise   0
+ */
+
+int impactsSettled(Result *ranked, int size, int k, double *hi, double rest, int exact)
+{
+    Result result;
+    int i;
+    
+    if(size < k)
+    {
+        return rest == 0.0;
+    }
+    
+    if(rest >= ranked[k - 1]->score)
+    {
+        return 0;
+    }
+    
+    for(i = 0; i < size; i++)
+    {
+        result = ranked[i];
+        
+        if(hi[result->filenum] == result->score)
+        {
+            continue;
+        }
+        
+        /* Inside the k best each has to stay below the one before it, outside below the k-th */
+        if((exact && i < k) || (i > 0 && hi[result->filenum] >= ranked[(i < k) ? i - 1 : k - 1]->score))
+        {
+            return 0;
+        }
+    }
+    
+    return 1;
+}
+
+/* searchImpacts
+ *
+ * Finds the k best files for terms OR'd together from the impact
+ * ordered lists (see writeImpacts), score at a time: the segment
+ * read next is always the one that can add the most to a file.
+ * The search stops as soon as the k best and their order cannot
+ * change any more, which usually leaves all but the heads of the
+ * lists unread. Gives exactly the k results an exhaustive search
+ * would.
+ *
+ * @param   files       filelist object, with a lexicon and impacts
+ * @param   units       query units, plain terms and ORs only
+ * @param   terms       terms of the units
+ * @param   numunits    number of units
+ * @param   k           number of results wanted
+ *
+ * @return  success     1
+ * @return  failure     0
+ */
+
+int searchImpacts(Filelist files, QueryUnit units, char **terms, int numunits, int k)
+{
+    long *pos;
+    int *freq, *count, *df, **rows, *buffer;
+    double *bounds, *hi, rest;
+    Result *ranked, result;
+    int i, u, t, size, segments, read;
+    
+    pos = (long*) arenaAlloc(files->arena, sizeof(long) * (numunits + 1));
+    freq = (int*) arenaAlloc(files->arena, sizeof(int) * (numunits + 1));
+    count = (int*) arenaAlloc(files->arena, sizeof(int) * (numunits + 1));
+    df = (int*) arenaAlloc(files->arena, sizeof(int) * (numunits + 1));
+    bounds = (double*) arenaAlloc(files->arena, sizeof(double) * (numunits + 1));
+    rows = (int**) arenaAlloc(files->arena, sizeof(int*) * (files->numfiles + 1));
+    hi = (double*) arenaAlloc(files->arena, sizeof(double) * (files->numfiles + 1));
+    ranked = (Result*) arenaAlloc(files->arena, sizeof(Result) * (files->numfiles + 1));
+    buffer = (int*) arenaAlloc(files->arena, sizeof(int) * (files->numfiles + 1));
+    if(pos == NULL || freq == NULL || count == NULL || df == NULL || bounds == NULL ||
+       rows == NULL || hi == NULL || ranked == NULL || buffer == NULL)
+    {
+        return 0;
+    }
+    
+    for(i = 0; i < files->numfiles; i++)
+    {
+        rows[i] = NULL;
+    }
+    
+    /* Every term starts out at the head of its list */
+    for(u = 0; u < numunits; u++)
+    {
+        freq[u] = 0;
+        count[u] = 0;
+        df[u] = 0;
+        bounds[u] = 0.0;
+        
+        if(units[u].type != UNIT_TERM)
+        {
+            continue;
+        }
+        
+        /* A term that is not in the index can give nothing */
+        t = findTerm(files->lexicon, terms[units[u].first]);
+        if(t < 0)
+        {
+            continue;
+        }
+        
+        pos[u] = lexiconImpacts(files->lexicon, t);
+        df[u] = (files->unitFiles != NULL) ? files->unitFiles[u] : lexiconFrequency(files->lexicon, t);
+        
+        if(pos[u] < 0 || readImpactSegment(files->impacts, &pos[u], &freq[u], &count[u]) == 0)
+        {
+            return 0;
+        }
+        
+        if(freq[u] > 0)
+        {
+            bounds[u] = scoreFile(files->totalFiles, df[u], freq[u]) * (1.0 + BOUND_SLACK);
+        }
+    }
+    
+    size = 0;
+    segments = 0;
+    read = 0;
+    
+    while(1)
+    {
+        /* Read on where the most can still be had */
+        u = 0;
+        rest = 0.0;
+        
+        for(i = 0; i < numunits; i++)
+        {
+            rest += bounds[i];
+            if(bounds[i] > bounds[u])
+            {
+                u = i;
+            }
+        }
+        
+        if(bounds[u] == 0.0)
+        {
+            break;
+        }
+        
+        if(count[u] > files->numfiles || readImpactFiles(files->impacts, &pos[u], buffer, count[u]) == 0)
+        {
+            return 0;
+        }
+        segments++;
+        read += count[u];
+        
+        for(i = 0; i < count[u]; i++)
+        {
+            t = buffer[i];
+            if(t < 0 || t >= files->numfiles)
+            {
+                fprintf(stderr, "Error: Malformed impact file.\n");
+                return 0;
+            }
+            
+            if(rows[t] == NULL)
+            {
+                rows[t] = (int*) arenaAlloc(files->arena, sizeof(int) * (numunits + 1));
+                ranked[size] = createResult(files, t);
+                if(rows[t] == NULL || ranked[size] == NULL)
+                {
+                    return 0;
+                }
+                memset(rows[t], 0, sizeof(int) * (numunits + 1));
+                size++;
+            }
+            
+            rows[t][u] = freq[u];
+        }
+        
+        /* On to the next segment, it cannot give as much */
+        rest -= bounds[u];
+        bounds[u] = 0.0;
+        
+        if(readImpactSegment(files->impacts, &pos[u], &freq[u], &count[u]) == 0)
+        {
+            return 0;
+        }
+        
+        if(freq[u] > 0)
+        {
+            bounds[u] = scoreFile(files->totalFiles, df[u], freq[u]) * (1.0 + BOUND_SLACK);
+        }
+        rest += bounds[u];
+        
+        scoreImpacts(files, ranked, size, rows, df, bounds, numunits, hi);
+        qsort(ranked, size, sizeof(Result), compResults);
+        
+        if(impactsSettled(ranked, size, k, hi, rest, files->unitFiles != NULL))
+        {
+            break;
+        }
+    }
+    
+    if(DEBUG) printf("Read %i segments, %i files.\n", segments, read);
+    
+    /* The results were scored and sorted after the last segment */
+    if(size > k)
+    {
+        size = k;
+    }
+    
+    for(i = 0; i < size; i++)
+    {
+        result = ranked[i];
+        result->next = (i + 1 < size) ? ranked[i + 1] : NULL;
+    }
+    files->results = (size > 0) ? ranked[0] : NULL;
+    
+    return 1;
+}
+
+
+
+/* compInts
+ *
+ * qsort comparator for ints, ascending.
+ *
+ * @param   ptr1        first int
+ * @param   ptr2        second int
+ *
+ * @return  int         <0, 0 or >0
+ */
+
+int compInts(const void *ptr1, const void *ptr2)
+{
+    int a, b;
+    
+    a = *(const int*) ptr1;
+    b = *(const int*) ptr2;
+    
+    return (a > b) - (a < b);
+}
+
+/* addBatchTerms
+ *
+ * Adds the terms a query looks up (plain terms and the words of
+ * phrases and NEAR groups) to the batch, as empty Words to be
+ * filled in by fetchBatch.
+ *
+ * @param   files       filelist object
+ * @param   query       "so ..." or "sa ..." line
+ *
+ * @return  success     number of new terms
+ * @return  failure     -1
+ */
+
+int addBatchTerms(Filelist files, char *query)
+{
+    QueryUnit units;
+    Word word;
+    char **terms;
+    int i, j, numunits, added;
+    
+    units = parseQuery(query + 3, files->arena, &terms, &numunits);
+    if(units == NULL)
+    {
+        return -1;
+    }
+    
+    added = 0;
+    
+    for(i = 0; i < numunits; i++)
+    {
+        if(units[i].type != UNIT_TERM && units[i].type != UNIT_PHRASE && units[i].type != UNIT_NEAR)
+        {
+            continue;
+        }
+        
+        for(j = units[i].first; j < units[i].first + units[i].numterms; j++)
+        {
+            if(searchHT(files->batch, terms[j]) != NULL)
+            {
+                continue;
+            }
+            
+            word = createArenaWord(files->batchArena, terms[j]);
+            if(word == NULL || insertHT(files->batch, word->word, word) == 0)
+            {
+                return -1;
+            }
+            
+            added++;
+        }
+    }
+    
+    return added;
+}
+
+/* fetchBatch
+ *
+ * Fills in the postings of the batch's terms. With a lexicon the
+ * terms are read in lexicon order, so the reads only move forward,
+ * else the index is read once from the first list to the last and
+ * the terms of the batch are picked out as they go by. Terms the
+ * index lacks stay empty.
+ *
+ * @param   files       filelist object
+ * @param   numterms    number of terms in the batch
+ *
+ * @return  success     1
+ * @return  failure     0
+ */
+
+int fetchBatch(Filelist files, int numterms)
+{
+    HTIterator iter;
+    Word word, read, copy;
+    char *key, *first;
+    int *slots, i, count, found, seen;
+    
+    if(numterms == 0)
+    {
+        return 1;
+    }
+    
+    if(files->lexicon != NULL)
+    {
+        slots = (int*) arenaAlloc(files->batchArena, sizeof(int) * numterms);
+        if(slots == NULL)
+        {
+            return 0;
+        }
+        
+        count = 0;
+        seen = 0;
+        iter = createIterHT(files->batch);
+        while(iter != NULL && HTNextItem(iter, (void**) &key, (void**) &word) == 1)
+        {
+            seen++;
+            i = findTerm(files->lexicon, key);
+            if(i >= 0)
+            {
+                slots[count++] = i;
+            }
+        }
+        destroyIterHT(iter);
+        
+        /* A term that was never visited would be answered as absent */
+        if(seen != numterms)
+        {
+            fprintf(stderr, "Error: Went over %d of the %d terms of the batch.\n", seen, numterms);
+            return 0;
+        }
+        
+        qsort(slots, count, sizeof(int), compInts);
+        
+        for(i = 0; i < count; i++)
+        {
+            read = readTerm(files, files->tok, slots[i]);
+            copy = (read != NULL) ? copyArenaWord(files->batchArena, read) : NULL;
+            resetArena(files->arena);
+            
+            if(copy == NULL)
+            {
+                return 0;
+            }
+            
+            word = (Word) searchHT(files->batch, copy->word);
+            *word = *copy;
+        }
+        
+        return 1;
+    }
+    
+    /* No lexicon: one pass from the first list, until it comes round again */
+    if(fseek(files->tok->file, files->index->lists, SEEK_SET) != 0)
+    {
+        return 0;
+    }
+    
+    first = NULL;
+    found = 0;
+    
+    while(found < numterms)
+    {
+        read = getWord(files->tok, NULL, files->arena);
+        if(read == NULL || (first != NULL && strcmp(read->word, first) == 0))
+        {
+            break;
+        }
+        
+        if(first == NULL)
+        {
+            first = arenaString(files->batchArena, read->word);
+        }
+        
+        word = (Word) searchHT(files->batch, read->word);
+        if(word != NULL)
+        {
+            copy = copyArenaWord(files->batchArena, read);
+            if(copy == NULL)
+            {
+                return 0;
+            }
+            
+            *word = *copy;
+            found++;
+        }
+        
+        resetArena(files->arena);
+    }
+    
+    resetArena(files->arena);
+    
+    return 1;
+}
+
+/****************************
+ * 3. File List Functions   *
+ ****************************/
+ 
+/* openSearchIndex
+ *
+ * This function takes in a tokenizer object that points to the
+ * start of an inverted index. It parses the list of files between
+ * <files> and </files> into a front-coded table that maps a number
+ * to the filename (see getFilename), and loads the index's lexicon
+ * and trigrams, if there are any. The tokenizer is left just past
+ * </files>.
+ *
+ * @param   tok         Tokenizer object (pointing to top of inverted index)
+ * 
+ * @return  success     SearchIndex
+ * @return  failure     NULL
+ */
+
+SearchIndex openSearchIndex(TokenizerT tok)
+{
+    SearchIndex index;
+    FileTable table;
+    char str[MAX_BUFFER_SIZE], path[MAX_BUFFER_SIZE];
+    int counter, numfiles, shared;
+    long generation;
+    
+    /* Validate inputs */
+    
+    if(tok == NULL)
+    {
+        fprintf(stderr, "Error: Cannot open an index from NULL tokenizer.\n");
+        return NULL;
+    }
+    
+    /* Make sure we are looking at the top of the file */
+    
+    if(TKGetNextTokenInto(tok, str, MAX_BUFFER_SIZE) == 0 || strcmp(str, "files") != 0)
+    {
+        fprintf(stderr, "Error: Malformed index file.\n");
+        return NULL;
+    }
+    
+    /* get the total number of files and the generation (one token, spaces are file chars),
+       an index written before there were generations has none and counts as generation 0 */
+    
+    generation = 0;
+    
+    if(TKGetNextTokenInto(tok, str, MAX_BUFFER_SIZE) == 0 || sscanf(str, "%d %ld", &numfiles, &generation) < 1)
+    {
+        fprintf(stderr, "Error: Malformed index file.\n");
+        return NULL;
+    }
+    
+    if(DEBUG) printf("Total Files: %i\n", numfiles);
+    
+    /* Allocate space for the file table */
+    
+    table = createFileTable(numfiles);
+    if(table == NULL)
+    {
+        return NULL;
+    }
+    
+    /* Parse the list of files, path always holds the previous name */
+    
+    path[0] = '\0';
+    
+    for(counter = 0; counter < numfiles; counter++)
+    {
+        /* First token is just the int index (equal to counter) */
+        if(TKGetNextTokenInto(tok, str, MAX_BUFFER_SIZE) == 0 ||
+           TKGetNextTokenInto(tok, str, MAX_BUFFER_SIZE) == 0)
+        {
+            fprintf(stderr, "Error: Malformed index file.\n");
+            destroyFileTable(table);
+            return NULL;
+        }
+        
+        shared = atoi(str);
+        
+        if(shared < 0 || (size_t) shared > strlen(path) ||
+           TKGetNextTokenInto(tok, path + shared, MAX_BUFFER_SIZE - shared) == 0)
+        {
+            fprintf(stderr, "Error: Malformed index file.\n");
+            destroyFileTable(table);
+            return NULL;
+        }
+        
+        if(addFilePath(table, path) == 0)
+        {
+            destroyFileTable(table);
+            return NULL;
+        }
+    }
+    
+    if(TKGetNextTokenInto(tok, str, MAX_BUFFER_SIZE) == 0 || strcmp(str, "/files") != 0)
+    {
+        fprintf(stderr, "Error: Malformed index file.\n");
+        destroyFileTable(table);
+        return NULL;
+    }
+    
+    /* Now allocate the actual struct */
+    
+    index = (SearchIndex) malloc(sizeof(struct SearchIndex_));
+    if(index == NULL)
+    {
+        fprintf(stderr, "Error: Could not allocate space for the index.\n");
+        destroyFileTable(table);
+        return NULL;
+    }
+    
+    index->filename = (char*) malloc(strlen(tok->filename) + 1);
+    if(index->filename == NULL)
+    {
+        fprintf(stderr, "Error: Could not allocate space for the index.\n");
+        destroyFileTable(table);
+        free(index);
+        return NULL;
+    }
+    strcpy(index->filename, tok->filename);
+    
+    index->table = table;
+    index->numfiles = numfiles;
+    index->generation = generation;
+    
+    /* Every query starts reading lists from here */
+    index->lists = ftell(tok->file);
+    
+    /* Without a lexicon terms are found by scanning and wildcards are off */
+    index->lexicon = loadLexicon(tok->filename);
+    
+    /* Substrings need the trigrams of an index built with -t */
+    index->trigrams = openTrigramIndex(tok->filename);
+    
+    /* Terms the index lacks are turned away by its filter, if it has one */
+    index->bloom = loadBloom(tok->filename);
+    
+    return index;
+}
+
+/* closeSearchIndex
+ *
+ * Closes an index opened by openSearchIndex. Every Filelist made
+ * from it has to be destroyed first. NULL is ignored.
+ *
+ * @param   index       index to close
+ *
+ * @return  void
+ */
+
+void closeSearchIndex(SearchIndex index)
+{
+    if(index != NULL)
+    {
+        destroyFileTable(index->table);
+        destroyLexicon(index->lexicon);
+        closeTrigramIndex(index->trigrams);
+        destroyBloom(index->bloom);
+        free(index->filename);
+        free(index);
+    }
+}
+
+/* createContext
+ *
+ * Makes a Filelist to run queries on an open index with. It has
+ * its own tokenizer (in files->tok, pointing at the first list),
+ * its own positions stream, trigrams, block summaries, impact
+ * ordered lists, containers and packed postings, if there are
+ * any, and its own arena and results, so queries on different
+ * Filelists of the same index can run at the same time.
+ *
+ * @param   index       open index
+ * 
+ * @return  success     Filelist
+ * @return  failure     NULL
+ */
+
+Filelist createContext(SearchIndex index)
+{
+    Filelist files;
+    
+    if(index == NULL)
+    {
+        fprintf(stderr, "Error: Cannot search a NULL index.\n");
+        return NULL;
+    }
+    
+    files = (Filelist) malloc(sizeof(struct Filelist_));
+    if(files == NULL)
+    {
+        fprintf(stderr, "Error: Could not allocate space for filelist.\n");
+        return NULL;
+    }
+    
+    files->arena = createArena(ARENA_CHUNK_SIZE);
+    files->tok = TKCreate(STRING_CHARS, index->filename);
+    if(files->arena == NULL || files->tok == NULL || fseek(files->tok->file, index->lists, SEEK_SET) != 0)
+    {
+        fprintf(stderr, "Error: Could not open %s for another query.\n", index->filename);
+        destroyArena(files->arena);
+        TKDestroy(files->tok);
+        free(files);
+        return NULL;
+    }
+    
+    files->index = index;
+    files->ownsIndex = 0;
+    files->table = index->table;
+    files->lexicon = index->lexicon;
+    files->numfiles = index->numfiles;
+    files->proximity = 0;
+    files->topk = 0;
+    files->ranges = 1;
+    files->rangePool = NULL;
+    files->ownsPool = 0;
+    files->totalFiles = index->numfiles;
+    files->unitFiles = NULL;
+    files->expansions = NULL;
+    files->answers = NULL;
+    
+    /* Phrase queries need positions, plain ones work without them */
+    files->positions = openSidecar(index->filename, POSITIONS_SUFFIX, "rb");
+    
+    /* Substrings read trigram lists through a file of their own */
+    files->trigrams = shareTrigramIndex(index->trigrams, index->filename);
+    
+    /* Top-k searches read block summaries, or work them out if there are none */
+    files->blocks = openSidecar(index->filename, BLOCKMAX_SUFFIX, "rb");
+    
+    /* An index built with -i lets them stop at the heads of the lists */
+    files->impacts = openSidecar(index->filename, IMPACT_SUFFIX, "rb");
+    
+    /* Common words come as bitmaps too, for AND, OR and NOT a word at a time */
+    files->containers = openSidecar(index->filename, ROARING_SUFFIX, "rb");
+    
+    /* Postings are decoded from binary blocks rather than parsed, if the lexicon says where */
+    files->codec = DEFAULT_CODEC;
+    files->packed = openPacked(index->filename, &files->codec);
+    
+    files->results = NULL;
+    files->batch = NULL;
+    files->batchArena = NULL;
+    
+    return files;
+}
+
+/* getFilelist
+ *
+ * Opens an index (see openSearchIndex) and makes a Filelist for it
+ * (see createContext) that closes the index when it is destroyed.
+ * The tokenizer passed in is left just past </files>, where it can
+ * read the lists for queries as well as files->tok can.
+ *
+ * @param   tok         Tokenizer object (pointing to top of inverted index)
+ * 
+ * @return  success     Filelist
+ * @return  failure     NULL
+ */
+
+Filelist getFilelist(TokenizerT tok)
+{
+    SearchIndex index;
+    Filelist files;
+    
+    index = openSearchIndex(tok);
+    if(index == NULL)
+    {
+        return NULL;
+    }
+    
+    files = createContext(index);
+    if(files == NULL)
+    {
+        closeSearchIndex(index);
+        return NULL;
+    }
+    
+    files->ownsIndex = 1;
+    
+    return files;
+}
+
+/* freshFilelist
+ *
+ * Opens the index a Filelist was made from again, as it is on disk
+ * now, with the settings of the old Filelist but no result cache.
+ * The old Filelist is left as it is. A malformed or half written
+ * index is reported and nothing is opened.
+ *
+ * @param   files       filelist object
+ *
+ * @return  success     the new Filelist
+ * @return  failure     NULL
+ */
+
+Filelist freshFilelist(Filelist files)
+{
+    TokenizerT tok;
+    Filelist fresh;
+    
+    tok = TKCreate(FILE_CHARS, files->index->filename);
+    if(tok == NULL)
+    {
+        fprintf(stderr, "Error: Could not open %s again.\n", files->index->filename);
+        return NULL;
+    }
+    
+    fresh = getFilelist(tok);
+    TKDestroy(tok);
+    
+    if(fresh == NULL)
+    {
+        fprintf(stderr, "Error: Could not open %s again.\n", files->index->filename);
+        return NULL;
+    }
+    
+    fresh->proximity = files->proximity;
+    fresh->topk = files->topk;
+    fresh->ranges = files->ranges;
+    
+    /* Only ever used by the thread using files, so the range threads can be shared */
+    fresh->rangePool = files->rangePool;
+    
+    return fresh;
+}
+
+/* reopenIndex
+ *
+ * Opens an index again when it was written anew since it was
+ * opened (see indexGeneration), so the prompt goes on with the
+ * index as it is now. The new Filelist keeps the settings and the
+ * result cache of the old one, which is destroyed. Answers worked
+ * out on the old index stay under its generation and are never
+ * handed out again.
+ *
+ * @param   files       filelist object from getFilelist
+ *
+ * @return  unchanged   files
+ * @return  reopened    the new Filelist
+ * @return  failure     NULL, files is left open as it was
+ */
+
+Filelist reopenIndex(Filelist files)
+{
+    Filelist fresh;
+    
+    if(indexGeneration(files->index->filename) == files->index->generation)
+    {
+        return files;
+    }
+    
+    fresh = freshFilelist(files);
+    if(fresh == NULL)
+    {
+        return NULL;
+    }
+    
+    fresh->answers = files->answers;
+    
+    /* The range threads go on with the new Filelist */
+    fresh->ownsPool = files->ownsPool;
+    files->ownsPool = 0;
+    
+    destroyFilelist(files);
+    
+    return fresh;
+}
+
+/* currentIndex
+ *
+ * Picks what a query that shares files and cache with others (a
+ * server's or a batch's) is answered with. While the index is as
+ * it was opened that is files and cache themselves. Once it was
+ * written anew (see indexGeneration), the words in the cache, the
+ * lexicon and the file table all describe the old index, so the
+ * query gets the index opened again (see freshFilelist) and a word
+ * cache of its own, which the caller frees when the new Filelist
+ * is not files. If the index cannot be opened again, say it is
+ * only half written, files and cache are kept.
+ *
+ * @param   files       filelist object the query was given
+ * @param   cache       the query's word cache, replaced by its own
+ *                      when the index is opened again
+ *
+ * @return  Filelist    files, or the index opened again
+ */
+
+Filelist currentIndex(Filelist files, Cache *cache)
+{
+    Filelist fresh;
+    Cache words;
+    
+    if(indexGeneration(files->index->filename) == files->index->generation)
+    {
+        return files;
+    }
+    
+    fresh = freshFilelist(files);
+    if(fresh == NULL)
+    {
+        return files;
+    }
+    
+    words = createCache(DEFAULT_CACHE_SIZE);
+    if(words == NULL)
+    {
+        destroyFilelist(fresh);
+        return files;
+    }
+    
+    *cache = words;
+    
+    return fresh;
+}
+
+/* destroyFilelist
+ *
+ * Function that destroys a filelist object, its index too if it
+ * came from getFilelist and its pool of range threads if it is
+ * its own.
+ *
+ * @param   files       pointer to filelist
+ *
+ * @return  void
+ */
+
+void destroyFilelist(Filelist files)
+{
+    if(files != NULL)
+    {
+        destroyArena(files->arena);
+        TKDestroy(files->tok);
+        
+        if(files->positions != NULL)
+        {
+            fclose(files->positions);
+        }
+        
+        if(files->blocks != NULL)
+        {
+            fclose(files->blocks);
+        }
+        
+        if(files->impacts != NULL)
+        {
+            fclose(files->impacts);
+        }
+        
+        if(files->containers != NULL)
+        {
+            fclose(files->containers);
+        }
+        
+        if(files->packed != NULL)
+        {
+            fclose(files->packed);
+        }
+        
+        closeTrigramIndex(files->trigrams);
+        clearBatch(files);
+        
+        if(files->ownsIndex)
+        {
+            closeSearchIndex(files->index);
+        }
+        
+        if(files->ownsPool)
+        {
+            destroyThreadPool(files->rangePool);
+        }
+        
+        free(files);
+    }
+}
+
+/* getFilename
+ *
+ * Rebuilds the name of a file from the front-coded file table.
+ * Only the results that are actually shown need to pay for this.
+ *
+ * @param   files       filelist object
+ * @param   filenum     number of the file
+ * @param   buffer      where to write the name
+ * @param   size        size of buffer
+ *
+ * @return  success     buffer
+ * @return  failure     NULL
+ */
+
+char *getFilename(Filelist files, int filenum, char *buffer, int size)
+{
+    return getFilePath(files->table, filenum, buffer, size);
+}
+
+/* resetResults
+ *
+ * Resets the results after a search has been completed. Every
+ * allocation the search made (Results, Words and Entries read
+ * from the index, scratch buffers) lives in the filelist's query
+ * arena, which is reset in one step.
+ *
+ * @param   files       filelist object
+ *
+ * @return  void
+ */
+ 
+void resetResults(Filelist files)
+{
+    resetArena(files->arena);
+    files->results = NULL;
+}
+
+/* loadBatch
+ *
+ * Fetches the postings of every term a batch of queries looks up
+ * (see lookupWord), each distinct term once: in lexicon order
+ * with a lexicon, else in one pass over the index. Until the
+ * batch is cleared, lookups of those terms are answered from the
+ * batch, terms the index lacks included. Wildcard, fuzzy and
+ * substring terms are looked up as usual.
+ *
+ * @param   files       filelist object
+ * @param   queries     "so ..." or "sa ..." lines, others are skipped
+ * @param   numqueries  number of queries
+ *
+ * @return  success     number of distinct terms
+ * @return  failure     -1
+ */
+
+int loadBatch(Filelist files, char **queries, int numqueries)
+{
+    int i, added, numterms;
+    
+    clearBatch(files);
+    
+    files->batch = createHT(hash, compStrings, NULL, NULL, NULL);
+    files->batchArena = createArena(ARENA_CHUNK_SIZE);
+    if(files->batch == NULL || files->batchArena == NULL)
+    {
+        fprintf(stderr, "Error: Could not allocate space for a batch.\n");
+        clearBatch(files);
+        return -1;
+    }
+    
+    numterms = 0;
+    
+    for(i = 0; i < numqueries; i++)
+    {
+        if(queries[i][0] != 's' || (queries[i][1] != 'o' && queries[i][1] != 'a'))
+        {
+            continue;
+        }
+        
+        added = addBatchTerms(files, queries[i]);
+        resetArena(files->arena);
+        
+        if(added < 0)
+        {
+            clearBatch(files);
+            return -1;
+        }
+        
+        numterms += added;
+    }
+    
+    if(fetchBatch(files, numterms) == 0)
+    {
+        fprintf(stderr, "Error: Could not read the terms of a batch.\n");
+        clearBatch(files);
+        return -1;
+    }
+    
+    return numterms;
+}
+
+/* clearBatch
+ *
+ * Frees the terms of the last batch (see loadBatch), lookups go
+ * back to the cache and the index.
+ *
+ * @param   files       filelist object
+ *
+ * @return  void
+ */
+
+void clearBatch(Filelist files)
+{
+    destroyHT(files->batch);
+    destroyArena(files->batchArena);
+    
+    files->batch = NULL;
+    files->batchArena = NULL;
+}
+
+/* sortResults
+ *
+ * Sorts the results in order of score. Results with the same
+ * score keep their order (file number order).
+ *
+ * @param   files       filelist object
+ *
+ * @return  void
+ */
+
+void sortResults(Filelist files)
+{
+    Result curr, next, sorted, scurr, sprev;
+    int inserted;
+    double diff;
+    
+    curr = files->results;
+    sorted = NULL;
+    
+    while(curr != NULL)
+    {
+        next = curr->next;
+        
+        /* Set scurr to the front of the list, sprev to NULL, and inserted to 0 */
+        scurr = sorted;
+        sprev = NULL;
+        inserted = 0;
+        
+        while(scurr != NULL && inserted == 0)
+        {
+            diff = curr->score - scurr->score;
+            
+            if(diff > 0.0)
+            {
+                /* The new one is bigger than the current node */
+                if(sprev == NULL)
+                {
+                    /* Insert it at the front of the list */
+                    curr->next = scurr;
+                    sorted = curr;
+                }
+                else
+                {
+                    sprev->next = curr;
+                    curr->next = scurr;
+                }
+                inserted = 1;
+            }
+            
+            sprev = scurr;
+            scurr = scurr->next;
+        }
+        
+        if(inserted == 0)
+        {
+            /* We reached the end of the list, put it there */
+            if(sprev == NULL)
+            {
+                /* Insert it at the front of the list */
+                curr->next = scurr;
+                sorted = curr;
+            }
+            else
+            {
+                sprev->next = curr;
+                curr->next = scurr;
+            }
+        }
+        
+        curr = next;
+    }
+    
+    files->results = sorted;
+
+}
+
+/* scoreFile
+ *
+ * Function that computes the Term frequency and inverse document frequency
+ *
+ * @param   totalFiles              the total number of files in the index
+ * @param   filescontword           total number of files containing the word
+ * @param   freq                    frequency of the word in the document in question
+ *
+ * @return  double                  score
+ */
+
+double scoreFile(int totalFiles, int filescontword, int freq)
+{
+    /* N = Total files, Nt = Number of files containing the result, Ft = frequency in the file */
+    int Nt, N, Ft;
+    double IDFt, TFt;
+    
+    Nt = totalFiles;
+    N = filescontword;
+    Ft = freq;
+    
+    
+    IDFt = log((1.0 + ((double)N / Nt)));
+    TFt = 1 + log((double)Ft);
     
     if(DEBUG) printf("%f = %f * %f\n",IDFt * TFt, IDFt, TFt);
     
-    return IDFt * TFt;
+    return IDFt * TFt;
+}
+
+/* getWord
+ *
+ * This is the function that is responsible for retriving the
+ * Word objects from the inverted index. The first method of 
+ * searching is by specifying a specific searchterm.  The function
+ * walks through the tokenizer until it either finds the term and 
+ * parses it into a word object or it reaches the end of the list.
+ * If the end is reached, it resets the list to the top and continues
+ * until it reaches the first term it parsed. If you pass in NULL as 
+ * the search term, the function will return the next word it
+ * encounters in the list. If the term is not encountered in the 
+ * list or an error occurs, the function returns NULL. The Word,
+ * its Entries and the scratch space used while scanning all come
+ * out of the query arena; copyArenaWord moves the Word to another
+ * arena, and insertWord keeps it in the cache (see packWord).
+ *
+ * @param   tok           Tokenizer pointing to a <list> element in an inverted index
+ * @param   searchterm    Either term to search for or NULL
+ * @param   arena         query arena
+ *
+ * @return  success       Word
+ * @return  failure       NULL
+ */  
+
+Word getWord(TokenizerT tok, char* searchterm, Arena arena)
+{
+    Word word;
+    Entry ent;
+    char *str, *start;
+    int res, cont, filenum, frequency;
+    
+    start = NULL;
+    ent = NULL;
+    cont = 1;
+    
+    /* Every token is scanned into one scratch buffer, nothing is malloc'd per token */
+    str = (char*) arenaAlloc(arena, MAX_BUFFER_SIZE);
+    if(str == NULL)
+    {
+        return NULL;
+    }
+    
+    while(cont)
+    {
+        if(TKGetNextTokenInto(tok, str, MAX_BUFFER_SIZE) == 0)
+        {
+            if(DEBUG) printf("Reseting list!\n");
+            adjustAllowedChars(tok, FILE_CHARS);
+    
+            TKReset(tok);
+            
+            /* Skip the files, three tokens each (a suffix could look like "/files") */
+            if(TKGetNextTokenInto(tok, str, MAX_BUFFER_SIZE) == 0 || strcmp(str, "files") != 0 ||
+               TKGetNextTokenInto(tok, str, MAX_BUFFER_SIZE) == 0)
+            {
+                fprintf(stderr, "Error: Malformed index file.\n");
+                return NULL;
+            }
+            
+            for(filenum = atoi(str) * 3; filenum > 0; filenum--)
+            {
+                TKGetNextTokenInto(tok, str, MAX_BUFFER_SIZE);
+            }
+            
+            if(TKGetNextTokenInto(tok, str, MAX_BUFFER_SIZE) == 0 || strcmp(str, "/files") != 0)
+            {
+                fprintf(stderr, "Error: Malformed index file.\n");
+                return NULL;
+            }
+            
+            adjustAllowedChars(tok, STRING_CHARS);
+            
+            if(TKGetNextTokenInto(tok, str, MAX_BUFFER_SIZE) == 0)
+            {
+                fprintf(stderr, "Error: Malformed index file.\n");
+                return NULL;
+            }
+        }
+        
+        /* Verify that we started on a list */
+        if(strcmp(str, "list") != 0)
+        {
+            fprintf(stderr, "Error: Malformed index file.\n");
+            return NULL;
+        }
+        
+        /* Next get the term */
+        if(TKGetNextTokenInto(tok, str, MAX_BUFFER_SIZE) == 0)
+        {
+            fprintf(stderr, "Error: Malformed index file.\n");
+            return NULL;
+        }
+        
+       
+        res = 0;
+        if(searchterm != NULL)
+        {
+            res = strcmp(searchterm, str);
+        }
+        
+        if(res == 0)
+        {
+            
+            /* Found it */
+            if(DEBUG) printf("Found Term: %s\n", str);
+            
+            word = createArenaWord(arena, str);
+            if(word == NULL)
+            {
+                fprintf(stderr, "Error: Could not create word.\n");
+                return NULL;
+            }
+            
+            /* Get the total files */
+            TKGetNextTokenInto(tok, str, MAX_BUFFER_SIZE);
+            word->numFiles = atoi(str);
+            
+            /* And where its positions start */
+            TKGetNextTokenInto(tok, str, MAX_BUFFER_SIZE);
+            word->positions = atol(str);
+            
+            /* Move on */
+            while(TKGetNextTokenInto(tok, str, MAX_BUFFER_SIZE) != 0 && strcmp(str, "list") != 0)
+            {
+                filenum = atoi(str);
+                
+                TKGetNextTokenInto(tok, str, MAX_BUFFER_SIZE);
+                frequency = atoi(str);
+                word->totalAppearances += frequency;
+                
+                if(ent == NULL)
+                {
+                    word->head = createArenaEntry(arena, filenum, frequency);
+                    ent = word->head;
+                }
+                else
+                {
+                    ent->next = createArenaEntry(arena, filenum, frequency);
+                    ent = ent->next;
+                }
+                
+                if(ent == NULL)
+                {
+                    return NULL;
+                }
+            }
+            
+            return word;
+        }
+        else
+        {
+            if(start == NULL)
+            {
+                start = arenaString(arena, str);
+            }
+            else
+            {
+                if(strcmp(start, str) == 0)
+                {
+                    if(DEBUG) printf("Looped back to %s\n", start);
+                    cont = 0;
+                }
+            }
+            /* Move on */
+            while(TKGetNextTokenInto(tok, str, MAX_BUFFER_SIZE) != 0 && strcmp(str, "list") != 0)
+            {
+            }
+        }
+    }
+    
+    if(DEBUG) printf("Reached the end of the list.\n");
+    
+    return NULL;
+    
+}
+
+/* readPositions
+ *
+ * Reads the token positions of every file a word appears in from
+ * the positions stream. The lists come back sorted by file number
+ * and live in the query arena.
+ *
+ * @param   files         filelist object
+ * @param   word          word to read the positions of
+ * @param   count         where to store the number of lists
+ *
+ * @return  success       array of PositionLists
+ * @return  failure       NULL
+ */
+
+PositionList readPositions(Filelist files, Word word, int *count)
+{
+    PositionList lists;
+    Entry ent;
+    unsigned int *all, gap, position;
+    int i, n, used;
+    
+    *count = 0;
+    
+    if(files->positions == NULL || word->positions < 0)
+    {
+        fprintf(stderr, "Error: Index has no positions for %s.\n", word->word);
+        return NULL;
+    }
+    
+    n = 0;
+    for(ent = word->head; ent != NULL; ent = ent->next)
+    {
+        n++;
+    }
+    
+    lists = (PositionList) arenaAlloc(files->arena, sizeof(struct PositionList_) * (n + 1));
+    all = (unsigned int*) arenaAlloc(files->arena, sizeof(unsigned int) * (word->totalAppearances + 1));
+    if(lists == NULL || all == NULL)
+    {
+        return NULL;
+    }
+    
+    if(fseek(files->positions, word->positions, SEEK_SET) != 0)
+    {
+        fprintf(stderr, "Error: Malformed positions file.\n");
+        return NULL;
+    }
+    
+    /* The lists are stored in entry order, one gap-coded run per entry */
+    n = 0;
+    used = 0;
+    
+    for(ent = word->head; ent != NULL; ent = ent->next)
+    {
+        lists[n].filenum = ent->filenumber;
+        lists[n].count = ent->frequency;
+        lists[n].positions = all + used;
+        
+        position = 0;
+        for(i = 0; i < ent->frequency; i++)
+        {
+            if(used == word->totalAppearances || readVByte(files->positions, &gap) == 0)
+            {
+                fprintf(stderr, "Error: Malformed positions file.\n");
+                return NULL;
+            }
+            
+            position += gap;
+            all[used] = position;
+            used++;
+        }
+        
+        n++;
+    }
+    
+    qsort(lists, n, sizeof(struct PositionList_), compPositionLists);
+    
+    *count = n;
+    
+    return lists;
+}
+
+/* getPhrase
+ *
+ * Matches an exact phrase. Every word of the phrase is looked up
+ * (cache first, then the index), the files that hold all of them
+ * are found by walking the lists in file order, and each of those
+ * files is kept only if the words also sit at consecutive
+ * positions. The result is a Word in the query arena whose entries
+ * count the phrase occurrences per file, so it can be scored like
+ * any other term.
+ *
+ * @param   terms         words of the phrase, in order
+ * @param   numterms      number of words
+ * @param   tok           tokenizer object
+ * @param   files         filelist object
+ * @param   cache         Cache object
+ *
+ * @return  success       Word
+ * @return  no match      NULL
+ */
+
+Word getPhrase(char **terms, int numterms, TokenizerT tok, Filelist files, Cache cache)
+{
+    return matchPositions(terms, numterms, PHRASE_WINDOW, tok, files, cache);
+}
+
+/* getNear
+ *
+ * Matches words that all occur within a window of each other, in
+ * any order (the NEAR/k operator). Files are found the same way as
+ * for getPhrase, then a window slides over the words' positions in
+ * each file (see windowScan). The result is a Word in the query
+ * arena whose entries count the matching windows per file.
+ *
+ * @param   terms         words to match
+ * @param   numterms      number of words
+ * @param   window        largest distance allowed between the first
+ *                        and the last word of a match
+ * @param   tok           tokenizer object
+ * @param   files         filelist object
+ * @param   cache         Cache object
+ *
+ * @return  success       Word
+ * @return  no match      NULL
+ */
+
+Word getNear(char **terms, int numterms, int window, TokenizerT tok, Filelist files, Cache cache)
+{
+    if(window < 0)
+    {
+        window = 0;
+    }
+    
+    return matchPositions(terms, numterms, window, tok, files, cache);
+}
+
+/* getWildcard
+ *
+ * Matches every term of the lexicon that fits a pattern, where '*'
+ * stands for any run of characters and '?' for exactly one (see
+ * expandWildcard). The result is a Word in the query arena holding
+ * the union of the postings of at most MAX_EXPANSIONS of them
+ * (those in the most files, of the whole index on a shard),
+ * frequencies added up per file.
+ *
+ * @param   pattern       wildcard pattern
+ * @param   tok           tokenizer object
+ * @param   files         filelist object
+ * @param   cache         Cache object
+ *
+ * @return  success       Word
+ * @return  no match      NULL
+ */
+
+Word getWildcard(char *pattern, TokenizerT tok, Filelist files, Cache cache)
+{
+    return lookupExpansion(pattern, -1, tok, files, cache);
+}
+
+/* getFuzzy
+ *
+ * Matches every term of the lexicon within an edit distance of a
+ * query term (the ~N operator, see expandFuzzy). The result is a
+ * Word in the query arena holding the union of the postings of at
+ * most MAX_EXPANSIONS of them (those in the most files, of the
+ * whole index on a shard), frequencies added up per file.
+ *
+ * @param   word          query word, e.g. "speling~2"
+ * @param   distance      largest edit distance allowed
+ * @param   tok           tokenizer object
+ * @param   files         filelist object
+ * @param   cache         Cache object
+ *
+ * @return  success       Word
+ * @return  no match      NULL
+ */
+
+Word getFuzzy(char *word, int distance, TokenizerT tok, Filelist files, Cache cache)
+{
+    if(distance < 0)
+    {
+        distance = 0;
+    }
+    
+    return lookupExpansion(word, distance, tok, files, cache);
+}
+
+/* getSubstring
+ *
+ * Matches files that hold a string anywhere, punctuation and all
+ * (e.g. "buffer_size"), ignoring case. The trigram index narrows
+ * the files down to the ones holding every trigram of the string,
+ * then each candidate is read to verify it and count the matches.
+ * Strings shorter than three characters have to check every file.
+ * The result is a Word in the query arena whose entries count the
+ * matches per file.
+ *
+ * @param   str           string to look for
+ * @param   files         filelist object
+ *
+ * @return  success       Word
+ * @return  no match      NULL
+ */
+
+Word getSubstring(char *str, Filelist files)
+{
+    Word found;
+    Entry ent, tail;
+    char path[MAX_BUFFER_SIZE];
+    int *candidates, count, i, n;
+    
+    if(files->trigrams == NULL)
+    {
+        fprintf(stderr, "Error: Substrings need a trigram index (index -t).\n");
+        return NULL;
+    }
+    
+    candidates = (int*) arenaAlloc(files->arena, sizeof(int) * (files->numfiles + 1));
+    if(candidates == NULL)
+    {
+        return NULL;
+    }
+    
+    if(strlen(str) < 3)
+    {
+        /* No trigrams to go on, every file is a candidate */
+        for(i = 0; i < files->numfiles; i++)
+        {
+            candidates[i] = i;
+        }
+        count = files->numfiles;
+    }
+    else
+    {
+        count = findCandidates(files->trigrams, str, candidates);
+    }
+    
+    if(DEBUG) printf("'%s': %i candidates\n", str, count);
+    
+    found = createArenaWord(files->arena, str);
+    if(found == NULL)
+    {
+        return NULL;
+    }
+    
+    tail = NULL;
+    
+    /* Trigrams can only rule files out, the file itself has the final say */
+    for(i = 0; i < count; i++)
+    {
+        if(getFilename(files, candidates[i], path, MAX_BUFFER_SIZE) == NULL)
+        {
+            continue;
+        }
+        
+        n = countSubstring(path, str);
+        if(n <= 0)
+        {
+            continue;
+        }
+        
+        ent = createArenaEntry(files->arena, candidates[i], n);
+        if(ent == NULL)
+        {
+            return NULL;
+        }
+        
+        if(tail == NULL)
+        {
+            found->head = ent;
+        }
+        else
+        {
+            tail->next = ent;
+        }
+        tail = ent;
+        
+        found->numFiles++;
+        found->totalAppearances += n;
+    }
+    
+    if(found->head == NULL)
+    {
+        return NULL;
+    }
+    
+    return found;
+}
+
+/* countUnits
+ *
+ * Looks up every unit of a query the way search does and counts
+ * the files holding each one, so a coordinator can add up the
+ * counts of every shard and have each shard score its files with
+ * the totals (see answerStats).
+ *
+ * @param   action          "so ..." or "sa ..."
+ * @param   tok             tokenizer object
+ * @param   files           filelist object
+ * @param   cache           Cache object
+ * @param   counts          where to store the count of each unit,
+ *                          0 for operators, in the query arena
+ *
+ * @return  success         number of units
+ * @return  failure         -1
+ */
+
+int countUnits(char *action, TokenizerT tok, Filelist files, Cache cache, int **counts)
+{
+    QueryUnit units;
+    char **terms;
+    int i, numunits;
+    Word found;
+    
+    units = parseQuery(action + 3, files->arena, &terms, &numunits);
+    if(units == NULL)
+    {
+        return -1;
+    }
+    
+    *counts = (int*) arenaAlloc(files->arena, sizeof(int) * (numunits + 1));
+    if(*counts == NULL)
+    {
+        fprintf(stderr, "Error: Could not allocate space for the counts.\n");
+        return -1;
+    }
+    
+    for(i = 0; i < numunits; i++)
+    {
+        (*counts)[i] = 0;
+        
+        if(lookupUnit(&units[i], terms, tok, files, cache, &found) == 1 && found != NULL)
+        {
+            (*counts)[i] = found->numFiles;
+        }
+    }
+    
+    return numunits;
+}
+
+/* matchExpansions
+ *
+ * Expands a wildcard or fuzzy query word into every term of the
+ * lexicon it matches, not just the MAX_EXPANSIONS in the most
+ * files, so the coordinator of a sharded index can add up the
+ * counts of every shard and choose the terms once for all of them
+ * (see chooseExpansions).
+ *
+ * @param   word            wildcard or fuzzy query word
+ * @param   files           filelist object, with a lexicon
+ * @param   terms           where to store the term numbers, in
+ *                          index order, in the query arena
+ *
+ * @return  success         number of terms
+ * @return  failure         -1
+ */
+
+int matchExpansions(char *word, Filelist files, int **terms)
+{
+    int distance, size;
+    
+    if(files->lexicon == NULL)
+    {
+        fprintf(stderr, "Error: Wildcard and fuzzy terms need the index's lexicon.\n");
+        return -1;
+    }
+    
+    distance = fuzzyDistance(word);
+    if(distance < 0 && !isWildcard(word))
+    {
+        fprintf(stderr, "Error: %s is neither a wildcard nor a fuzzy term.\n", word);
+        return -1;
+    }
+    
+    size = lexiconSize(files->lexicon);
+    if(size == 0)
+    {
+        *terms = NULL;
+        return 0;
+    }
+    
+    *terms = (int*) arenaAlloc(files->arena, sizeof(int) * size);
+    if(*terms == NULL)
+    {
+        fprintf(stderr, "Error: Could not allocate space for the expansions.\n");
+        return -1;
+    }
+    
+    return expandWord(word, distance, files, *terms, size);
+}
+
+/* countTerms
+ *
+ * Counts the files holding each unit of a query from the
+ * statistics block of a sharded index instead of the shards
+ * themselves, which only works when every unit is a plain term
+ * (see countUnits).
+ *
+ * @param   action          "so ..." or "sa ..."
+ * @param   arena           arena for the query
+ * @param   stats           statistics block of the index
+ * @param   counts          where to store the count of each unit,
+ *                          0 for operators, in the arena
+ *
+ * @return  success         number of units
+ * @return  failure         -1 (also for a phrase, a wildcard and
+ *                          the like, which only the shards can
+ *                          count)
+ */
+
+int countTerms(char *action, Arena arena, Stats stats, int **counts)
+{
+    QueryUnit units;
+    char **terms;
+    int i, numunits;
+    
+    units = parseQuery(action + 3, arena, &terms, &numunits);
+    if(units == NULL)
+    {
+        return -1;
+    }
+    
+    *counts = (int*) arenaAlloc(arena, sizeof(int) * (numunits + 1));
+    if(*counts == NULL)
+    {
+        fprintf(stderr, "Error: Could not allocate space for the counts.\n");
+        return -1;
+    }
+    
+    for(i = 0; i < numunits; i++)
+    {
+        (*counts)[i] = 0;
+        
+        if(units[i].type == UNIT_TERM)
+        {
+            (*counts)[i] = statsFrequency(stats, terms[units[i].first]);
+        }
+        else if(units[i].type < UNIT_AND)
+        {
+            /* Only the shards know how many files a phrase or a wildcard matches */
+            return -1;
+        }
+    }
+    
+    return numunits;
+}
+
+/* expandableWords
+ *
+ * Finds the wildcard and fuzzy words of a query, the ones a
+ * sharded index has to choose the expansions of for every shard
+ * (see matchExpansions).
+ *
+ * @param   action          "so ..." or "sa ..."
+ * @param   arena           arena for the query
+ * @param   words           where to store the words, in the arena
+ *
+ * @return  success         number of words
+ * @return  failure         -1
+ */
+
+int expandableWords(char *action, Arena arena, char ***words)
+{
+    QueryUnit units;
+    char **terms;
+    int i, numunits, count;
+    
+    units = parseQuery(action + 3, arena, &terms, &numunits);
+    if(units == NULL)
+    {
+        return -1;
+    }
+    
+    *words = (char**) arenaAlloc(arena, sizeof(char*) * (numunits + 1));
+    if(*words == NULL)
+    {
+        fprintf(stderr, "Error: Could not allocate space for the words.\n");
+        return -1;
+    }
+    
+    count = 0;
+    
+    for(i = 0; i < numunits; i++)
+    {
+        if(units[i].type == UNIT_WILDCARD || units[i].type == UNIT_FUZZY)
+        {
+            (*words)[count++] = terms[units[i].first];
+        }
+    }
+    
+    return count;
 }
 
-/* getWord
+/* runQuery
  *
- * This is the function that is responsible for retriving the
- * Word objects from the inverted index. The first method of 
- * searching is by specifying a specific searchterm.  The function
- * walks through the tokenizer until it either finds the term and 
- * parses it into a word object or it reaches the end of the list.
- * If the end is reached, it resets the list to the top and continues
- * until it reaches the first term it parsed. If you pass in NULL as 
- * the search term, the function will return the next word it
- * encounters in the list. If the term is not encountered in the 
- * list or an error occurs, the function returns NULL.
+ * Works out the answer to a query (see search), without looking
+ * in the result cache.
  *
- * @param   tok           Tokenizer pointing to a <list> element in an inverted index
- * @param   searchterm    Either term to search for or NULL
+ * @param   action          string containing the search type and terms
+ * @param   tok             tokenizer object
+ * @param   files           filelist object
+ * @param   cache           Cache object
  *
- * @return  success       Word
- * @return  failure       NULL
- */  
+ * @return  void
+ */
 
-Word getWord(TokenizerT tok, char* searchterm)
-{
-    Word word;
-    Entry ent;
-    char *str, *start;
-    int res, cont, reset, filenum, frequency;
+void runQuery(char* action, TokenizerT tok, Filelist files, Cache cache)
+{    
+    QueryUnit units;
+    PlanNode root, *leaves, *matched, leaf;
+    char **terms;
+    int i, j, doc, numunits, numplain, nummatched, op;
+    Word *found, *plain;
+    Result result, tail;
     
-    start = NULL;
-    ent = NULL;
-    cont = 1;
-    reset = 0;
+    /* Terms with no operator between them are OR'd by "so", AND'd by "sa" */
+    op = (action[1] == 'a') ? PLAN_AND : PLAN_OR;
     
-    while(cont)
+    units = parseQuery(action + 3, files->arena, &terms, &numunits);
+    if(units == NULL)
+    {
+        return;
+    }
+    
+    /* With impact ordered lists the best few of plain terms OR'd together come from the heads */
+    if(files->topk > 0 && !files->proximity && files->impacts != NULL && files->lexicon != NULL &&
+       isPlainDisjunction(units, numunits, op) && searchImpacts(files, units, terms, numunits, files->topk))
+    {
+        return;
+    }
+    
+    found = (Word*) arenaAlloc(files->arena, sizeof(Word) * (numunits + 1));
+    leaves = (PlanNode*) arenaAlloc(files->arena, sizeof(PlanNode) * (numunits + 1));
+    matched = (PlanNode*) arenaAlloc(files->arena, sizeof(PlanNode) * (numunits + 1));
+    plain = (Word*) arenaAlloc(files->arena, sizeof(Word) * (numunits + 1));
+    if(found == NULL || leaves == NULL || matched == NULL || plain == NULL)
     {
-        str = TKGetNextToken(tok);
-        if(str == 0)
+        return;
+    }
+    
+    for(i = 0; i < numunits; i++)
+    {
+        leaves[i] = NULL;
+        
+        if(lookupUnit(&units[i], terms, tok, files, cache, &found[i]) == 0)
         {
-            if(DEBUG) printf("Reseting list!\n");
-            adjustAllowedChars(tok, FILE_CHARS);
+            /* Operators have no postings */
+            continue;
+        }
+        
+        if(DEBUG && found[i] != NULL) printWord(found[i]);
+        
+        /* A unit that matched nothing still has a leaf, NOT needs it */
+        leaves[i] = createTermNode(files->arena, i, found[i]);
+        if(leaves[i] == NULL)
+        {
+            return;
+        }
+    }
     
-            TKReset(tok);
-            
-            /* Skip the files */
-            str = TKGetNextToken(tok);
-            if(str == 0 || strcmp(str, "files") != 0)
-            {
-                fprintf(stderr, "Error: Malformed index file.\n");
-                exit(-1);
-            }
-            free(str);
-            
-            while((str = TKGetNextToken(tok)) != 0 && strcmp(str, "/files") != 0)
+    root = compileQuery(units, numunits, leaves, op, files->arena);
+    if(root == NULL)
+    {
+        return;
+    }
+    
+    optimizePlan(root, files->numfiles);
+    
+    /* The best few of a plain OR can skip most files (not with proximity, which adds to scores) */
+    if(files->topk > 0 && !files->proximity && isDisjunction(root))
+    {
+        for(i = 0; i < numunits; i++)
+        {
+            if(leaves[i] != NULL && leafBlocks(files, leaves[i], found[i], units[i].type == UNIT_TERM) == 0)
             {
-                free(str);
+                return;
             }
-            free(str);
-            
-            adjustAllowedChars(tok, STRING_CHARS);
-            str = TKGetNextToken(tok);
-            
-            /* Set the reset flag to TRUE */
-            reset = 1;
         }
         
-        /* Verify that we started on a list */
-        if(str == 0 || strcmp(str, "list") != 0)
+        searchTopK(files, root, found, numunits, files->topk);
+        return;
+    }
+    
+    /* Common terms skip through bitmaps, and so does whatever only combines them */
+    for(i = 0; i < numunits; i++)
+    {
+        if(leaves[i] != NULL && units[i].type == UNIT_TERM && leafBitmap(files, leaves[i], found[i]) == 0)
         {
-            fprintf(stderr, "Error: Malformed index file.\n");
-            exit(-1);
+            return;
+        }
+    }
+    
+    if(combineBitmaps(files->arena, root) == 0 || intersectLeaves(files->arena, root) == 0)
+    {
+        return;
+    }
+    
+    /* Walk the matches in file order, every one becomes a result */
+    tail = NULL;
+    
+    for(doc = advancePlan(root, 0); doc != PLAN_END; doc = advancePlan(root, doc + 1))
+    {
+        result = createResult(files, doc);
+        if(result == NULL)
+        {
+            return;
         }
         
-        free(str);
+        nummatched = matchingLeaves(root, doc, matched, 0);
         
-        /* Next get the term */
-        str = TKGetNextToken(tok);
-        if(str == 0)
+        /* Score in query order, whatever order the plan runs in */
+        for(i = 1; i < nummatched; i++)
         {
-            fprintf(stderr, "Error: Malformed index file.\n");
-            exit(-1);
+            for(j = i; j > 0 && matched[j]->leaf < matched[j - 1]->leaf; j--)
+            {
+                leaf = matched[j];
+                matched[j] = matched[j - 1];
+                matched[j - 1] = leaf;
+            }
         }
         
-       
-        res = 0;
-        if(searchterm != NULL)
+        for(i = 0; i < nummatched; i++)
         {
-            res = strcmp(searchterm, str);
+            leaf = matched[i];
+            
+            result->numfiles++;
+            result->frequency += leaf->freqs[leaf->pos];
+            result->score += scoreFile(files->totalFiles, unitFiles(files, leaf->leaf, found[leaf->leaf]), leaf->freqs[leaf->pos]);
         }
         
-        if(res == 0)
+        if(tail == NULL)
         {
-            
-            /* Found it */
-            if(DEBUG) printf("Found Term: %s\n", str);
-            
-            word = createWord(str);
-            if(word == NULL)
-            {
-                fprintf(stderr, "Error: Could not create word.\n");
-                return NULL;
-            }
-            
-            free(str);
-            
-            /* Get the total files */
-            str = TKGetNextToken(tok);
-            word->numFiles = atoi(str);
-            free(str);
-            
-            /* Move on */
-            while((str = TKGetNextToken(tok)) != 0 && strcmp(str, "list") != 0)
-            {
-                filenum = atoi(str);
-                free(str);
-                
-                str = TKGetNextToken(tok);
-                frequency = atoi(str);
-                word->totalAppearances += frequency;
-                free(str);
-                
-                if(ent == NULL)
-                {
-                    word->head = createEntry(NULL, filenum, frequency);
-                    ent = word->head;
-                }
-                else
-                {
-                    ent->next = createEntry(NULL, filenum, frequency);
-                    ent = ent->next;
-                }
-            }
-            free(str);
-            free(start);
-            
-            return word;
+            files->results = result;
         }
         else
         {
-            if(start == NULL)
-            {
-                start = str;
-            }
-            else
-            {
-                if(strcmp(start, str) == 0)
-                {
-                    if(DEBUG) printf("Looped back to %s\n", start);
-                    cont = 0;
-                    free(start);
-                }
-                free(str);
-            }
-            /* Move on */
-            while((str = TKGetNextToken(tok)) != 0 && strcmp(str, "list") != 0)
-            {
-                free(str);
-            }
-            free(str);
+            tail->next = result;
         }
+        tail = result;
     }
     
-    if(DEBUG) printf("Reached the end of the list.\n");
+    /* The plain terms are kept around for proximity scoring */
+    numplain = plainTerms(root, units, found, plain, 0);
     
-    return NULL;
+    if(files->proximity && numplain > 1)
+    {
+        boostProximity(files, plain, numplain);
+    }
+    
+    sortResults(files);
     
+    /* Only the best topk are kept */
+    if(files->topk > 0)
+    {
+        result = files->results;
+        for(i = 1; result != NULL && i < files->topk; i++)
+        {
+            result = result->next;
+        }
+        
+        if(result != NULL)
+        {
+            result->next = NULL;
+        }
+    }
+
 }
 
 /* search
@@ -451,8 +4379,34 @@ Word getWord(TokenizerT tok, char* searchterm)
  * This function searchs for all the terms entered by the user.
  * It first checks the cache to see if the term in question is
  * present, and if not it searches the index file for the word.
- * It creates a linked list of results and then sorts them based
- * on score and the logical operation being performed.
+ * Terms between double quotes form a phrase that has to match
+ * exactly (see getPhrase), and terms joined by NEAR/k have to
+ * occur within k tokens of each other (see getNear). A term
+ * holding '*' or '?' matches many terms (see getWildcard), and so
+ * does a term ending in ~N (see getFuzzy). Text between single
+ * quotes matches anywhere in a file (see getSubstring). Each of
+ * these counts as a single term. Terms can be combined with AND,
+ * OR and NOT (upper case only) and grouped with parentheses, terms
+ * with no operator between them are OR'd by "so" and AND'd by
+ * "sa". The query is compiled into a plan of postings iterators
+ * that only ever skip forward (see advancePlan), with the rarest
+ * operand of every AND leading. Common terms come as bitmaps, and
+ * whatever only combines them is worked out a word at a time (see
+ * combineBitmaps), and an AND of terms intersects their lists up
+ * front with vector instructions (see intersectLeaves). With
+ * proximity scoring turned on, files where the plain terms sit
+ * close together get a boost. It creates a linked list of results
+ * and then sorts them by score.
+ * When only the best few are wanted (files->topk) a query that
+ * just ORs terms together skips the files that cannot make it
+ * (see searchTopK), or with impact ordered lists stops reading
+ * them once the best few are settled (see searchImpacts).
+ * Answers are kept in files->answers, when there is one, under the
+ * query normalized (see answerKey), so a query that was asked
+ * before is answered without going near the index. The index is
+ * looked at again (see indexGeneration) before every query, and
+ * once it was written anew since it was opened no answer is handed
+ * out or kept until it is opened again (see reopenIndex).
  *
  * @param   action          string containing the search type and terms
  * @param   tok             tokenizer object
@@ -463,142 +4417,33 @@ Word getWord(TokenizerT tok, char* searchterm)
  */
 
 void search(char* action, TokenizerT tok, Filelist files, Cache cache)
-{    
-    char term[1024];
-    int acounter, tcounter, numterms, cont, stype, rfound;
-    Word found;
-    Entry ent;
-    Result result;
-    
-    result = NULL;
-    acounter = 3;
-    tcounter = 0;
-    numterms = 0;
-    stype = 0;
+{
+    char *key;
+    Hit hits;
+    int count;
     
-    /* stype (0 = Logical OR, 1 = Logical AND) */
-    if(action[1] == 'a')
+    /* A shard scoring with the counts of the whole index has nothing to share, nor has an index written anew */
+    if(files->answers == NULL || files->unitFiles != NULL ||
+       indexGeneration(files->index->filename) != files->index->generation)
     {
-        stype = 1;
+        runQuery(action, tok, files, cache);
+        return;
     }
     
-    cont = 1;
-    
-    while(cont)
+    key = answerKey(action, files->arena);
+    if(key == NULL)
     {
-        if(action[acounter] == ' ' || action[acounter] == '\0' || action[acounter] == '\n')
-        {
-            if(tcounter > 0)
-            {
-                term[tcounter] = '\0';
-                
-                numterms++;
-                
-                found = searchCache(cache, term);
-                if(found == NULL)
-                {
-                    found = getWord(tok, term);
-                    if(found != NULL) insertWord(cache, found);
-                }
-                else
-                {
-                    if(DEBUG) printf("Found %s in cache.\n", term);
-                }
-                
-                if(found != NULL)
-                {
-                    if(DEBUG) printWord(found);
-                                        
-                    ent = found->head;
-                    
-                    while(ent != NULL)
-                    {
-                        if(files->results == NULL)
-                        {
-                            files->results = (Result) malloc(sizeof(struct Result_));
-                            if(files->results == NULL)
-                            {
-                                fprintf(stderr, "Error: Could not allocate space for results.\n");
-                                return;
-                            }
-                            result = files->results;
-                            result->filenum = ent->filenumber;
-                            result->numfiles = 1;
-                            result->frequency = ent->frequency;
-                            result->score = scoreFile(files->numfiles, found->numFiles, ent->frequency);
-                            result->next = NULL;
-                        }
-                        else
-                        {
-                            rfound = 0;
-                            result = files->results;
-                            while(result != NULL)
-                            {
-                                if(result->filenum == ent->filenumber)
-                                {
-                                    /* Found it */
-                                    result->numfiles++;
-                                    result->frequency += ent->frequency;
-                                    result->score += scoreFile(files->numfiles, found->numFiles, ent->frequency);
-                                    rfound = 1;
-                                }
-                                
-                                if(result->next == NULL && rfound == 0)
-                                {
-                                    result->next = (Result) malloc(sizeof(struct Result_));
-                                    if(result->next == NULL)
-                                    {
-                                        fprintf(stderr, "Error: Could not allocate space for results.\n");
-                                        return;
-                                    }
-                                    result = result->next;
-                                    result->filenum = ent->filenumber;
-                                    result->numfiles = 1;
-                                    result->frequency = ent->frequency;
-                                    result->score = scoreFile(files->numfiles, found->numFiles, ent->frequency);
-                                    result->next = NULL;
-                                }
-                                result = result->next;
-                            }
-                            
-                        }
-                        
-                        ent = ent->next;
-                    }
-                }
-            }
-            /* always set the tcounter to 0 */
-            tcounter = 0;
-            
-            if(action[acounter] == '\0' || action[acounter] == '\n')
-            {
-                cont = 0;
-            }
-        }
-        else
-        {
-            term[tcounter] = action[acounter];
-            tcounter++;
-        }
-        acounter++;
+        return;
     }
     
-    sortResults(files);
-    
-    result = files->results;
-    while(result != NULL)
+    if(searchAnswers(files->answers, key, files->index->generation, files->arena, &hits, &count))
     {
-        if(stype == 0 || (stype == 1 && result->numfiles == numterms))
-        {
-            /* printf("%s\n", files->list[result->filenum]); */
-        }
-        else
-        {
-            result->frequency = -1;
-        }
-        result = result->next;
+        replayAnswer(files, hits, count);
+        return;
     }
-
+    
+    runQuery(action, tok, files, cache);
+    keepAnswer(files, key);
 }
 
 
@@ -606,19 +4451,26 @@ int runsearch( int argc, char** argv )
 {
     Cache cache;
     TokenizerT tok;
-    int counter;
-    char *cachesize, action[1024];
-    Filelist files;
+    int counter, proximity, topk, threads, ranges, res;
+    char *cachesize, *answersize, *socketpath, *batchpath, action[1024], path[MAX_BUFFER_SIZE];
+    Filelist files, fresh;
     Result result;
     
     /* Check for the help flag */
     if(argc >= 2 && argv[1][0] == '-' && argv[1][1] == 'h')
     {
-        fprintf(stderr, "Usage: %s <inverted-index filename>\n", argv[0]);
+        fprintf(stderr, "Usage: %s [-m <cache size>] [-q <result cache size>] [-p] [-k <results>] [-d <socket>] [-j <threads>] [-r <ranges>] [-b <queries>] <inverted-index filename>\n", argv[0]);
         return 1;
     }
     
     cachesize = DEFAULT_CACHE_SIZE;
+    answersize = DEFAULT_RESULT_CACHE_SIZE;
+    proximity = 0;
+    topk = 0;
+    socketpath = NULL;
+    batchpath = NULL;
+    threads = DEFAULT_THREADS;
+    ranges = 1;
     
     /* Parse any flags */
     if(argc > 2)
@@ -633,10 +4485,57 @@ int runsearch( int argc, char** argv )
                     
                     cachesize = argv[counter+1];
                 }
+                else if(argv[counter][1] == 'q')
+                {
+                    /* Room for the answers to whole queries */
+                    answersize = argv[counter+1];
+                }
+                else if(argv[counter][1] == 'p')
+                {
+                    /* Rank files where the terms are close together higher */
+                    proximity = 1;
+                }
+                else if(argv[counter][1] == 'k')
+                {
+                    /* Only show the best results */
+                    topk = atoi(argv[counter+1]);
+                }
+                else if(argv[counter][1] == 'd')
+                {
+                    /* Serve queries on a socket instead of reading them from stdin */
+                    socketpath = argv[counter+1];
+                }
+                else if(argv[counter][1] == 'j')
+                {
+                    /* Queries the server answers at once */
+                    threads = atoi(argv[counter+1]);
+                }
+                else if(argv[counter][1] == 'r')
+                {
+                    /* Ranges of files one top-k query is scored in at once */
+                    ranges = atoi(argv[counter+1]);
+                }
+                else if(argv[counter][1] == 'b')
+                {
+                    /* Answer a file of queries, fetching their terms once */
+                    batchpath = argv[counter+1];
+                }
             }
         }
     }
     
+    /* A sharded index is searched by a worker per shard */
+    if(isManifest(argv[argc-1]))
+    {
+        if(socketpath != NULL || batchpath != NULL)
+        {
+            fprintf(stderr, "Error: A sharded index can only be searched from the prompt.\n");
+            return 0;
+        }
+        
+        return runShards(argv[argc-1], cachesize, proximity, topk, ranges);
+    }
+    
     /* Create a tokenizer */
     tok = TKCreate(FILE_CHARS, argv[argc-1]);
     if(tok == NULL)
@@ -647,12 +4546,18 @@ int runsearch( int argc, char** argv )
     
     if(DEBUG) printf("Getting files\n");
     
-    /* Get the file list */
+    /* Get the file list, it reads the lists with a tokenizer of its own */
     files = getFilelist(tok);
+    TKDestroy(tok);
+    tok = NULL;
+    
     if(files == NULL)
     {
         return 0;
     }
+    files->proximity = proximity;
+    files->topk = topk;
+    files->ranges = ranges;
     
     /* Create a cache */
     cache = createCache(cachesize);
@@ -662,49 +4567,86 @@ int runsearch( int argc, char** argv )
         return 0;
     }
     
-    /* Update the allowed characters */
-    adjustAllowedChars(tok, STRING_CHARS);
+    /* Queries asked again are answered from here */
+    files->answers = createResultCache(answersize);
+    if(files->answers == NULL)
+    {
+        destroyCache(cache);
+        destroyFilelist(files);
+        return 0;
+    }
+    
+    res = 1;
     
-    /* Main Loop */
-    printf("search> ");
-    fgets(action, 1024, stdin);
-        
-    while(action[0] != 'q')
+    /* The index stays open and the cache warm for every client */
+    if(socketpath != NULL)
     {
-        if(action[0] == 's' && (action[1] == 'o' || action[1] == 'a'))
-        {
-            search(action, tok, files, cache);
-        }
-        else
-        {
-            printf("Command not found.\n");
-        }
+        res = serveSearch(socketpath, files, cache, threads);
+    }
+    else if(batchpath != NULL)
+    {
+        res = runBatch(batchpath, files, cache);
+    }
+    else
+    {
+        /* Main Loop */
+        printf("search> ");
+        fgets(action, 1024, stdin);
         
-        result = files->results;
-        while(result != NULL)
+        while(action[0] != 'q')
         {
-            if(result->frequency > 0)
+            /* An index written anew is opened again, the words cached from the old one go with it */
+            fresh = reopenIndex(files);
+            if(fresh != NULL && fresh != files)
+            {
+                files = fresh;
+                destroyCache(cache);
+                cache = createCache(cachesize);
+                if(cache == NULL)
+                {
+                    fprintf(stderr, "Error: Could not allocate space for Cache.\n");
+                    res = 0;
+                    break;
+                }
+            }
+            
+            if(action[0] == 's' && (action[1] == 'o' || action[1] == 'a'))
             {
-                printf("%s\n", files->list[result->filenum]);
+                search(action, files->tok, files, cache);
             }
-            result = result->next;
+            else
+            {
+                printf("Command not found.\n");
+            }
+            
+            result = files->results;
+            while(result != NULL)
+            {
+                if(result->frequency >= 0 && getFilename(files, result->filenum, path, MAX_BUFFER_SIZE) != NULL)
+                {
+                    printf("%s\n", path);
+                }
+                result = result->next;
+            }
+            
+            resetResults(files);
+            
+            printf("search> ");
+            fgets(action, 1024, stdin);
         }
-        
-        resetResults(files);
-        
-        printf("search> ");
-        fgets(action, 1024, stdin);
-    } 
+    }
     
     /* Ok, now we're done. Burn it down */
     destroyCache(cache);
     cache = NULL;
     
+    destroyResultCache(files->answers);
+    files->answers = NULL;
+    
     destroyFilelist(files);
     files = NULL;
     
-    TKDestroy(tok);
-    tok = NULL;
+    releaseWords();
     
-    return 1;
+    return res;
 }
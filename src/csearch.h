@@ -13,9 +13,24 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <ctype.h>
 #include <math.h>
+#include "arena.h"
+#include "blockmax.h"
+#include "bloom.h"
 #include "cache.h"
+#include "codec.h"
+#include "filetable.h"
+#include "impact.h"
+#include "lexicon.h"
+#include "plan.h"
+#include "postings.h"
+#include "resultcache.h"
+#include "roaring.h"
+#include "stats.h"
+#include "threadpool.h"
 #include "tokenizer.h"
+#include "trigram.h"
 #include "words.h"
 
 /********************************
@@ -29,6 +44,54 @@
 
 #define DEFAULT_CACHE_SIZE "0KB"
 
+/* Query operator joining terms that must be close: "a NEAR/3 b" */
+#define NEAR_OPERATOR "near/"
+
+/* Window that asks for an exact phrase instead of a NEAR match */
+#define PHRASE_WINDOW -1
+
+/* Boost for a file where all the plain terms are adjacent */
+#define PROXIMITY_WEIGHT 1.0
+
+/* Query suffix that makes a term fuzzy: "speling~2" */
+#define FUZZY_OPERATOR '~'
+
+/* Edit distance of a bare "term~" and the largest one allowed */
+#define FUZZY_DISTANCE 1
+#define MAX_FUZZY_DISTANCE 3
+
+/* Quote around a substring query: 'buffer_size' */
+#define SUBSTRING_QUOTE '\''
+
+/* Most terms a wildcard or fuzzy term expands to (the ones in the most files win) */
+#define MAX_EXPANSIONS 256
+
+/* Boolean operators, upper case only: "cats AND (dogs OR mice) AND NOT fish" */
+#define AND_OPERATOR "AND"
+#define OR_OPERATOR "OR"
+#define NOT_OPERATOR "NOT"
+
+/* Score bounds are nudged up by this much, so rounding never prunes a top-k file */
+#define BOUND_SLACK 1e-9
+
+/* A top-k disjunction is only split over ranges of files once its lists hold this many files */
+#ifndef MIN_RANGE_POSTINGS
+#define MIN_RANGE_POSTINGS 65536
+#endif
+
+/* Kinds of QueryUnit, every kind of term before the operators */
+#define UNIT_TERM 0
+#define UNIT_PHRASE 1
+#define UNIT_NEAR 2
+#define UNIT_WILDCARD 3
+#define UNIT_FUZZY 4
+#define UNIT_SUBSTRING 5
+#define UNIT_AND 6
+#define UNIT_OR 7
+#define UNIT_NOT 8
+#define UNIT_OPEN 9
+#define UNIT_CLOSE 10
+
 /********************************
  * 2. Typedefs & Structs        *
  ********************************/
@@ -36,9 +99,21 @@
 struct Result_;
 typedef struct Result_* Result;
 
+struct SearchIndex_;
+typedef struct SearchIndex_* SearchIndex;
+
 struct Filelist_;
 typedef struct Filelist_* Filelist;
 
+struct PositionList_;
+typedef struct PositionList_* PositionList;
+
+struct QueryUnit_;
+typedef struct QueryUnit_* QueryUnit;
+
+struct TopKRange_;
+typedef struct TopKRange_* TopKRange;
+
 
 struct Result_ {
     int filenum;
@@ -48,24 +123,217 @@ struct Result_ {
     Result next;
 };
 
+/* SearchIndex_
+ *
+ * The parts of an open index every query shares. Nothing changes
+ * them once the index is open, so any number of threads can read
+ * them at once, each through its own Filelist (see createContext).
+ *
+ * @param   filename    name of the inverted index
+ * @param   table       front-coded file table (see getFilename)
+ * @param   lexicon     the index's lexicon, NULL if there is none
+ * @param   trigrams    the index's trigrams, NULL if there are none
+ * @param   bloom       the index's Bloom filter, NULL if there is none
+ * @param   lists       offset of the first list, just past </files>
+ * @param   numfiles    number of files in the index
+ * @param   generation  generation of the index (see indexGeneration)
+ */
+
+struct SearchIndex_ {
+    char *filename;
+    FileTable table;
+    Lexicon lexicon;
+    TrigramIndex trigrams;
+    Bloom bloom;
+    long lists;
+    int numfiles;
+    long generation;
+};
+
+/* Filelist_
+ *
+ * Everything one query at a time works with: the index it reads
+ * (table, lexicon and numfiles are borrowed from it), its own
+ * tokenizer and open files to read it with, its own arena and
+ * results, and the terms of a batch of queries fetched up front
+ * (see loadBatch). A Filelist is only ever used by one thread at
+ * a time, though a top-k search on it may split its files into
+ * ranges that are scored on threads of their own (ranges), the
+ * threads of rangePool, started for its first such search and
+ * kept for the rest. A Filelist opened again from another (see
+ * freshFilelist) borrows its pool, and only frees it if ownsPool
+ * says it is its own. Files are scored against totalFiles files,
+ * numfiles unless the index is one shard of a bigger one, and
+ * unitFiles (when not NULL) holds the number of files of the
+ * whole index holding each unit of the query being run (see
+ * answerScores). The coordinator of such an index may hand the
+ * shard the terms it chose for each wildcard or fuzzy word of
+ * that query in expansions, one "word term term ..." line each,
+ * which it reads in place of its own (see getWildcard). Answers
+ * to whole queries are kept in answers, shared by every Filelist
+ * of the index, when it is not NULL (see search).
+ */
+
 struct Filelist_ {
-    char** list;
+    SearchIndex index;
+    int ownsIndex;
+    TokenizerT tok;
+    FileTable table;
     Result results;
+    Arena arena;
+    FILE *positions;
+    Lexicon lexicon;
+    TrigramIndex trigrams;
+    FILE *blocks;
+    FILE *impacts;
+    FILE *containers;
+    FILE *packed;
+    HashTable batch;
+    Arena batchArena;
+    int codec;
     int numfiles;
+    int proximity;
+    int topk;
+    int ranges;
+    ThreadPool rangePool;
+    int ownsPool;
+    int totalFiles;
+    int *unitFiles;
+    char **expansions;
+    ResultCache answers;
+};
+
+/* PositionList_
+ *
+ * @param   filenum     file the positions are in
+ * @param   count       number of positions
+ * @param   positions   token positions, ascending
+ */
+
+struct PositionList_ {
+    int filenum;
+    int count;
+    unsigned int *positions;
+};
+
+/* QueryUnit_
+ *
+ * One scored unit of a query: a term, a phrase, a NEAR group, a
+ * wildcard, a fuzzy term or a substring. Boolean operators and
+ * parentheses are units too, without any terms.
+ *
+ * @param   type        UNIT_TERM, UNIT_PHRASE, UNIT_NEAR,
+ *                      UNIT_WILDCARD, UNIT_FUZZY, UNIT_SUBSTRING,
+ *                      UNIT_AND, UNIT_OR, UNIT_NOT, UNIT_OPEN or
+ *                      UNIT_CLOSE
+ * @param   first       index of the unit's first term
+ * @param   numterms    number of terms in the unit
+ * @param   window      NEAR window (smallest k given), or the edit
+ *                      distance of a fuzzy term
+ */
+
+struct QueryUnit_ {
+    int type;
+    int first;
+    int numterms;
+    int window;
+};
+
+/* TopKRange_
+ *
+ * One range of files a top-k search looks through (see
+ * searchTopK), with its own copies of the leaves and its own best
+ * results, so that ranges can be searched on different threads.
+ *
+ * @param   files       filelist object, only read
+ * @param   leaves      the range's leaves, in query order
+ * @param   order       the same leaves, kept in file order
+ * @param   found       word of each unit
+ * @param   bounds      score bound of each unit
+ * @param   numleaves   number of leaves
+ * @param   first       first file of the range
+ * @param   end         file just past the range
+ * @param   k           room in the heap
+ * @param   heap        best results so far, the worst on top
+ * @param   size        number of results in the heap
+ * @param   slots       results the heap and spare are taken from
+ * @param   spare       result the next file is scored into
+ * @param   scored      number of files scored
+ */
+
+struct TopKRange_ {
+    Filelist files;
+    PlanNode *leaves;
+    PlanNode *order;
+    Word *found;
+    double *bounds;
+    int numleaves;
+    int first;
+    int end;
+    int k;
+    Result *heap;
+    int size;
+    Result slots;
+    Result spare;
+    int scored;
 };
 
 /********************************
  * 3. File List Functions       *
  ********************************/
  
+/* openSearchIndex
+ *
+ * This function takes in a tokenizer object that points to the
+ * start of an inverted index. It parses the list of files between
+ * <files> and </files> into a front-coded table that maps a number
+ * to the filename (see getFilename), and loads the index's lexicon
+ * and trigrams, if there are any. The tokenizer is left just past
+ * </files>.
+ *
+ * @param   tok         Tokenizer object (pointing to top of inverted index)
+ * 
+ * @return  success     SearchIndex
+ * @return  failure     NULL
+ */
+
+SearchIndex openSearchIndex(TokenizerT tok);
+
+/* closeSearchIndex
+ *
+ * Closes an index opened by openSearchIndex. Every Filelist made
+ * from it has to be destroyed first. NULL is ignored.
+ *
+ * @param   index       index to close
+ *
+ * @return  void
+ */
+
+void closeSearchIndex(SearchIndex index);
+
+/* createContext
+ *
+ * Makes a Filelist to run queries on an open index with. It has
+ * its own tokenizer (in files->tok, pointing at the first list),
+ * its own positions stream, trigrams, block summaries, impact
+ * ordered lists, containers and packed postings, if there are
+ * any, and its own arena and results, so queries on different
+ * Filelists of the same index can run at the same time.
+ *
+ * @param   index       open index
+ * 
+ * @return  success     Filelist
+ * @return  failure     NULL
+ */
+
+Filelist createContext(SearchIndex index);
+
 /* getFilelist
  *
- * This function takes in a tokenizer object that points
- * to the start of an inverted index. It then parses the 
- * list of files between <files> and </files> and returns
- * an object that contains the total number of files, an
- * array that maps a number to the filename, and an array 
- * of integers that will hold the search results.
+ * Opens an index (see openSearchIndex) and makes a Filelist for it
+ * (see createContext) that closes the index when it is destroyed.
+ * The tokenizer passed in is left just past </files>, where it can
+ * read the lists for queries as well as files->tok can.
  *
  * @param   tok         Tokenizer object (pointing to top of inverted index)
  * 
@@ -75,9 +343,65 @@ struct Filelist_ {
 
 Filelist getFilelist(TokenizerT tok);
 
+/* freshFilelist
+ *
+ * Opens the index a Filelist was made from again, as it is on disk
+ * now, with the settings of the old Filelist but no result cache.
+ * The old Filelist is left as it is. A malformed or half written
+ * index is reported and nothing is opened.
+ *
+ * @param   files       filelist object
+ *
+ * @return  success     the new Filelist
+ * @return  failure     NULL
+ */
+
+Filelist freshFilelist(Filelist files);
+
+/* reopenIndex
+ *
+ * Opens an index again when it was written anew since it was
+ * opened (see indexGeneration), so the prompt goes on with the
+ * index as it is now. The new Filelist keeps the settings and the
+ * result cache of the old one, which is destroyed. Answers worked
+ * out on the old index stay under its generation and are never
+ * handed out again.
+ *
+ * @param   files       filelist object from getFilelist
+ *
+ * @return  unchanged   files
+ * @return  reopened    the new Filelist
+ * @return  failure     NULL, files is left open as it was
+ */
+
+Filelist reopenIndex(Filelist files);
+
+/* currentIndex
+ *
+ * Picks what a query that shares files and cache with others (a
+ * server's or a batch's) is answered with. While the index is as
+ * it was opened that is files and cache themselves. Once it was
+ * written anew (see indexGeneration), the words in the cache, the
+ * lexicon and the file table all describe the old index, so the
+ * query gets the index opened again (see freshFilelist) and a word
+ * cache of its own, which the caller frees when the new Filelist
+ * is not files. If the index cannot be opened again, say it is
+ * only half written, files and cache are kept.
+ *
+ * @param   files       filelist object the query was given
+ * @param   cache       the query's word cache, replaced by its own
+ *                      when the index is opened again
+ *
+ * @return  Filelist    files, or the index opened again
+ */
+
+Filelist currentIndex(Filelist files, Cache *cache);
+
 /* destroyFilelist
  *
- * Function that destroys a filelist object.
+ * Function that destroys a filelist object, its index too if it
+ * came from getFilelist and its pool of range threads if it is
+ * its own.
  *
  * @param   files       pointer to filelist
  *
@@ -86,9 +410,28 @@ Filelist getFilelist(TokenizerT tok);
 
 void destroyFilelist(Filelist files);
 
+/* getFilename
+ *
+ * Rebuilds the name of a file from the front-coded file table.
+ * Only the results that are actually shown need to pay for this.
+ *
+ * @param   files       filelist object
+ * @param   filenum     number of the file
+ * @param   buffer      where to write the name
+ * @param   size        size of buffer
+ *
+ * @return  success     buffer
+ * @return  failure     NULL
+ */
+
+char *getFilename(Filelist files, int filenum, char *buffer, int size);
+
 /* resetResults
  *
- * Resets the results after a search has been completed.
+ * Resets the results after a search has been completed. Every
+ * allocation the search made (Results, Words and Entries read
+ * from the index, scratch buffers) lives in the filelist's query
+ * arena, which is reset in one step.
  *
  * @param   files       filelist object
  *
@@ -97,10 +440,41 @@ void destroyFilelist(Filelist files);
  
 void resetResults(Filelist files);
 
+/* loadBatch
+ *
+ * Fetches the postings of every term a batch of queries looks up
+ * (see lookupWord), each distinct term once: in lexicon order
+ * with a lexicon, else in one pass over the index. Until the
+ * batch is cleared, lookups of those terms are answered from the
+ * batch, terms the index lacks included. Wildcard, fuzzy and
+ * substring terms are looked up as usual.
+ *
+ * @param   files       filelist object
+ * @param   queries     "so ..." or "sa ..." lines, others are skipped
+ * @param   numqueries  number of queries
+ *
+ * @return  success     number of distinct terms
+ * @return  failure     -1
+ */
+
+int loadBatch(Filelist files, char **queries, int numqueries);
+
+/* clearBatch
+ *
+ * Frees the terms of the last batch (see loadBatch), lookups go
+ * back to the cache and the index.
+ *
+ * @param   files       filelist object
+ *
+ * @return  void
+ */
+
+void clearBatch(Filelist files);
+
 /* sortResults
  *
- * Sorts the results in order of frequency (Eventually this
- * will be score)
+ * Sorts the results in order of score. Results with the same
+ * score keep their order (file number order).
  *
  * @param   files       filelist object
  *
@@ -133,24 +507,249 @@ double scoreFile(int totalFiles, int filescontword, int freq);
  * until it reaches the first term it parsed. If you pass in NULL as 
  * the search term, the function will return the next word it
  * encounters in the list. If the term is not encountered in the 
- * list or an error occurs, the function returns NULL.
+ * list or an error occurs, the function returns NULL. The Word,
+ * its Entries and the scratch space used while scanning all come
+ * out of the query arena; copyArenaWord moves the Word to another
+ * arena, and insertWord keeps it in the cache (see packWord).
  *
  * @param   tok           Tokenizer pointing to a <list> element in an inverted index
  * @param   searchterm    Either term to search for or NULL
+ * @param   arena         query arena
  *
  * @return  success       Word
  * @return  failure       NULL
  */  
 
-Word getWord(TokenizerT tok, char* searchterm);
+Word getWord(TokenizerT tok, char* searchterm, Arena arena);
+
+/* readPositions
+ *
+ * Reads the token positions of every file a word appears in from
+ * the positions stream. The lists come back sorted by file number
+ * and live in the query arena.
+ *
+ * @param   files         filelist object
+ * @param   word          word to read the positions of
+ * @param   count         where to store the number of lists
+ *
+ * @return  success       array of PositionLists
+ * @return  failure       NULL
+ */
+
+PositionList readPositions(Filelist files, Word word, int *count);
+
+/* getPhrase
+ *
+ * Matches an exact phrase. Every word of the phrase is looked up
+ * (cache first, then the index), the files that hold all of them
+ * are found by walking the lists in file order, and each of those
+ * files is kept only if the words also sit at consecutive
+ * positions. The result is a Word in the query arena whose entries
+ * count the phrase occurrences per file, so it can be scored like
+ * any other term.
+ *
+ * @param   terms         words of the phrase, in order
+ * @param   numterms      number of words
+ * @param   tok           tokenizer object
+ * @param   files         filelist object
+ * @param   cache         Cache object
+ *
+ * @return  success       Word
+ * @return  no match      NULL
+ */
+
+Word getPhrase(char **terms, int numterms, TokenizerT tok, Filelist files, Cache cache);
+
+/* getNear
+ *
+ * Matches words that all occur within a window of each other, in
+ * any order (the NEAR/k operator). Files are found the same way as
+ * for getPhrase, then a window slides over the words' positions in
+ * each file (see windowScan). The result is a Word in the query
+ * arena whose entries count the matching windows per file.
+ *
+ * @param   terms         words to match
+ * @param   numterms      number of words
+ * @param   window        largest distance allowed between the first
+ *                        and the last word of a match
+ * @param   tok           tokenizer object
+ * @param   files         filelist object
+ * @param   cache         Cache object
+ *
+ * @return  success       Word
+ * @return  no match      NULL
+ */
+
+Word getNear(char **terms, int numterms, int window, TokenizerT tok, Filelist files, Cache cache);
+
+/* getWildcard
+ *
+ * Matches every term of the lexicon that fits a pattern, where '*'
+ * stands for any run of characters and '?' for exactly one (see
+ * expandWildcard). The result is a Word in the query arena holding
+ * the union of the postings of at most MAX_EXPANSIONS of them
+ * (those in the most files, of the whole index on a shard),
+ * frequencies added up per file.
+ *
+ * @param   pattern       wildcard pattern
+ * @param   tok           tokenizer object
+ * @param   files         filelist object
+ * @param   cache         Cache object
+ *
+ * @return  success       Word
+ * @return  no match      NULL
+ */
+
+Word getWildcard(char *pattern, TokenizerT tok, Filelist files, Cache cache);
+
+/* getFuzzy
+ *
+ * Matches every term of the lexicon within an edit distance of a
+ * query term (the ~N operator, see expandFuzzy). The result is a
+ * Word in the query arena holding the union of the postings of at
+ * most MAX_EXPANSIONS of them (those in the most files, of the
+ * whole index on a shard), frequencies added up per file.
+ *
+ * @param   word          query word, e.g. "speling~2"
+ * @param   distance      largest edit distance allowed
+ * @param   tok           tokenizer object
+ * @param   files         filelist object
+ * @param   cache         Cache object
+ *
+ * @return  success       Word
+ * @return  no match      NULL
+ */
+
+Word getFuzzy(char *word, int distance, TokenizerT tok, Filelist files, Cache cache);
+
+/* getSubstring
+ *
+ * Matches files that hold a string anywhere, punctuation and all
+ * (e.g. "buffer_size"), ignoring case. The trigram index narrows
+ * the files down to the ones holding every trigram of the string,
+ * then each candidate is read to verify it and count the matches.
+ * Strings shorter than three characters have to check every file.
+ * The result is a Word in the query arena whose entries count the
+ * matches per file.
+ *
+ * @param   str           string to look for
+ * @param   files         filelist object
+ *
+ * @return  success       Word
+ * @return  no match      NULL
+ */
+
+Word getSubstring(char *str, Filelist files);
+
+/* countUnits
+ *
+ * Looks up every unit of a query the way search does and counts
+ * the files holding each one, so a coordinator can add up the
+ * counts of every shard and have each shard score its files with
+ * the totals (see answerStats).
+ *
+ * @param   action          "so ..." or "sa ..."
+ * @param   tok             tokenizer object
+ * @param   files           filelist object
+ * @param   cache           Cache object
+ * @param   counts          where to store the count of each unit,
+ *                          0 for operators, in the query arena
+ *
+ * @return  success         number of units
+ * @return  failure         -1
+ */
+
+int countUnits(char *action, TokenizerT tok, Filelist files, Cache cache, int **counts);
+
+/* matchExpansions
+ *
+ * Expands a wildcard or fuzzy query word into every term of the
+ * lexicon it matches, not just the MAX_EXPANSIONS in the most
+ * files, so the coordinator of a sharded index can add up the
+ * counts of every shard and choose the terms once for all of them
+ * (see chooseExpansions).
+ *
+ * @param   word            wildcard or fuzzy query word
+ * @param   files           filelist object, with a lexicon
+ * @param   terms           where to store the term numbers, in
+ *                          index order, in the query arena
+ *
+ * @return  success         number of terms
+ * @return  failure         -1
+ */
+
+int matchExpansions(char *word, Filelist files, int **terms);
+
+/* countTerms
+ *
+ * Counts the files holding each unit of a query from the
+ * statistics block of a sharded index instead of the shards
+ * themselves, which only works when every unit is a plain term
+ * (see countUnits).
+ *
+ * @param   action          "so ..." or "sa ..."
+ * @param   arena           arena for the query
+ * @param   stats           statistics block of the index
+ * @param   counts          where to store the count of each unit,
+ *                          0 for operators, in the arena
+ *
+ * @return  success         number of units
+ * @return  failure         -1 (also for a phrase, a wildcard and
+ *                          the like, which only the shards can
+ *                          count)
+ */
+
+int countTerms(char *action, Arena arena, Stats stats, int **counts);
+
+/* expandableWords
+ *
+ * Finds the wildcard and fuzzy words of a query, the ones a
+ * sharded index has to choose the expansions of for every shard
+ * (see matchExpansions).
+ *
+ * @param   action          "so ..." or "sa ..."
+ * @param   arena           arena for the query
+ * @param   words           where to store the words, in the arena
+ *
+ * @return  success         number of words
+ * @return  failure         -1
+ */
+
+int expandableWords(char *action, Arena arena, char ***words);
 
 /* search
  *
  * This function searchs for all the terms entered by the user.
  * It first checks the cache to see if the term in question is
  * present, and if not it searches the index file for the word.
- * It creates a linked list of results and then sorts them based
- * on score and the logical operation being performed.
+ * Terms between double quotes form a phrase that has to match
+ * exactly (see getPhrase), and terms joined by NEAR/k have to
+ * occur within k tokens of each other (see getNear). A term
+ * holding '*' or '?' matches many terms (see getWildcard), and so
+ * does a term ending in ~N (see getFuzzy). Text between single
+ * quotes matches anywhere in a file (see getSubstring). Each of
+ * these counts as a single term. Terms can be combined with AND,
+ * OR and NOT (upper case only) and grouped with parentheses, terms
+ * with no operator between them are OR'd by "so" and AND'd by
+ * "sa". The query is compiled into a plan of postings iterators
+ * that only ever skip forward (see advancePlan), with the rarest
+ * operand of every AND leading. Common terms come as bitmaps, and
+ * whatever only combines them is worked out a word at a time (see
+ * combineBitmaps), and an AND of terms intersects their lists up
+ * front with vector instructions (see intersectLeaves). With
+ * proximity scoring turned on, files where the plain terms sit
+ * close together get a boost. It creates a linked list of results
+ * and then sorts them by score.
+ * When only the best few are wanted (files->topk) a query that
+ * just ORs terms together skips the files that cannot make it
+ * (see searchTopK), or with impact ordered lists stops reading
+ * them once the best few are settled (see searchImpacts).
+ * Answers are kept in files->answers, when there is one, under the
+ * query normalized (see answerKey), so a query that was asked
+ * before is answered without going near the index. The index is
+ * looked at again (see indexGeneration) before every query, and
+ * once it was written anew since it was opened no answer is handed
+ * out or kept until it is opened again (see reopenIndex).
  *
  * @param   action          string containing the search type and terms
  * @param   tok             tokenizer object
@@ -0,0 +1,377 @@
+/*
+ * File: filetable.c
+ *
+ * Author: Mike Swift
+ * Email: theycallmeswift@gmail.com
+ * Date Created: May 11th, 2011
+ * Date Modified: May 11th, 2011
+ */
+
+/********************************
+ *          1. Includes         *
+ ********************************/
+
+#include "filetable.h"
+
+/********************************
+ *          2. Structs          *
+ ********************************/
+
+/* FileTable_
+ *
+ * @param   data        records, each one is the shared length in two
+ *                      bytes followed by the '\0' terminated suffix
+ * @param   used        bytes of data in use
+ * @param   size        bytes of data allocated
+ * @param   blocks      offset of every FILETABLE_BLOCK-th record
+ * @param   numfiles    paths added so far
+ * @param   maxfiles    paths the table was created for
+ * @param   prev        copy of the last path added
+ * @param   prevSize    bytes allocated for prev
+ */
+
+struct FileTable_ {
+    unsigned char *data;
+    size_t used;
+    size_t size;
+    size_t *blocks;
+    int numfiles;
+    int maxfiles;
+    char *prev;
+    size_t prevSize;
+};
+
+/********************************
+ *      3. Helper Functions     *
+ ********************************/
+
+/* reserveFileTable
+ *
+ * Makes sure the record buffer has room for more bytes.
+ *
+ * @param   table       file table
+ * @param   bytes       bytes about to be written
+ *
+ * @return  success     1
+ * @return  failure     0
+ */
+
+int reserveFileTable(FileTable table, size_t bytes)
+{
+    unsigned char *data;
+    size_t size;
+
+    if(table->used + bytes <= table->size)
+    {
+        return 1;
+    }
+
+    size = table->size;
+    while(table->used + bytes > size)
+    {
+        size *= 2;
+    }
+
+    data = (unsigned char*) realloc(table->data, size);
+    if(data == NULL)
+    {
+        fprintf(stderr, "Error: Could not allocate space for file table.\n");
+        return 0;
+    }
+
+    table->data = data;
+    table->size = size;
+
+    return 1;
+}
+
+/********************************
+ *      4. FileTable Functions  *
+ ********************************/
+
+/* createFileTable
+ *
+ * Creates an empty, front-coded table of file paths. Each path is
+ * stored as the length of the prefix it shares with the path before
+ * it plus the rest of the path, so deep directory trees cost little
+ * more than their file names.
+ *
+ * @param   numfiles        number of paths that will be added
+ *
+ * @return  success         new FileTable
+ * @return  failure         NULL
+ */
+
+FileTable createFileTable(int numfiles)
+{
+    FileTable table;
+
+    if(numfiles < 0)
+    {
+        fprintf(stderr, "Error: File table cannot have a negative size.\n");
+        return NULL;
+    }
+
+    table = (FileTable) malloc(sizeof(struct FileTable_));
+    if(table == NULL)
+    {
+        fprintf(stderr, "Error: Could not allocate space for file table.\n");
+        return NULL;
+    }
+
+    table->data = (unsigned char*) malloc(FILETABLE_DATA_SIZE);
+    table->blocks = (size_t*) malloc(sizeof(size_t) * (numfiles / FILETABLE_BLOCK + 1));
+    table->prev = (char*) malloc(FILETABLE_DATA_SIZE);
+
+    if(table->data == NULL || table->blocks == NULL || table->prev == NULL)
+    {
+        fprintf(stderr, "Error: Could not allocate space for file table.\n");
+        free(table->data);
+        free(table->blocks);
+        free(table->prev);
+        free(table);
+        return NULL;
+    }
+
+    table->used = 0;
+    table->size = FILETABLE_DATA_SIZE;
+    table->numfiles = 0;
+    table->maxfiles = numfiles;
+    table->prev[0] = '\0';
+    table->prevSize = FILETABLE_DATA_SIZE;
+
+    return table;
+}
+
+/* destroyFileTable
+ *
+ * Frees the table and every path in it. NULL is ignored.
+ *
+ * @param   table           table to destroy
+ *
+ * @return  void
+ */
+
+void destroyFileTable(FileTable table)
+{
+    if(table != NULL)
+    {
+        free(table->data);
+        free(table->blocks);
+        free(table->prev);
+        free(table);
+    }
+}
+
+/* addFilePath
+ *
+ * Appends the next path to the table. Paths are numbered in the
+ * order they are added, starting at 0.
+ *
+ * @param   table           file table
+ * @param   path            path of the next file
+ *
+ * @return  success         1
+ * @return  failure         0
+ */
+
+int addFilePath(FileTable table, char *path)
+{
+    int shared;
+    size_t len;
+    char *prev;
+
+    if(table == NULL || path == NULL)
+    {
+        fprintf(stderr, "Error: Cannot add NULL path to file table.\n");
+        return 0;
+    }
+
+    if(table->numfiles >= table->maxfiles)
+    {
+        fprintf(stderr, "Error: File table is full.\n");
+        return 0;
+    }
+
+    /* The first record of every block stands on its own */
+    if(table->numfiles % FILETABLE_BLOCK == 0)
+    {
+        table->blocks[table->numfiles / FILETABLE_BLOCK] = table->used;
+        shared = 0;
+    }
+    else
+    {
+        shared = sharedPrefix(table->prev, path);
+    }
+
+    len = strlen(path);
+
+    if(reserveFileTable(table, len - shared + 3) == 0)
+    {
+        return 0;
+    }
+
+    table->data[table->used++] = (unsigned char) (shared >> 8);
+    table->data[table->used++] = (unsigned char) (shared & 0xff);
+    memcpy(table->data + table->used, path + shared, len - shared + 1);
+    table->used += len - shared + 1;
+
+    /* Remember the path for coding the next one */
+    if(len + 1 > table->prevSize)
+    {
+        prev = (char*) realloc(table->prev, len + 1);
+        if(prev == NULL)
+        {
+            fprintf(stderr, "Error: Could not allocate space for file table.\n");
+            return 0;
+        }
+        table->prev = prev;
+        table->prevSize = len + 1;
+    }
+    strcpy(table->prev, path);
+
+    table->numfiles++;
+
+    return 1;
+}
+
+/* getFilePath
+ *
+ * Rebuilds the path of a file into a buffer supplied by the caller.
+ *
+ * @param   table           file table
+ * @param   filenum         number of the file
+ * @param   buffer          where to write the path
+ * @param   size            size of buffer
+ *
+ * @return  success         buffer
+ * @return  failure         NULL
+ */
+
+char *getFilePath(FileTable table, int filenum, char *buffer, int size)
+{
+    unsigned char *record;
+    int i, shared;
+    size_t len;
+
+    if(table == NULL || filenum < 0 || filenum >= table->numfiles)
+    {
+        fprintf(stderr, "Error: No such file in file table.\n");
+        return NULL;
+    }
+
+    /* Walk forward from the start of the file's block */
+    record = table->data + table->blocks[filenum / FILETABLE_BLOCK];
+
+    for(i = filenum - filenum % FILETABLE_BLOCK; i <= filenum; i++)
+    {
+        shared = (record[0] << 8) | record[1];
+        record += 2;
+
+        len = strlen((char*) record);
+        if(shared + len + 1 > (size_t) size)
+        {
+            fprintf(stderr, "Error: Path does not fit in buffer.\n");
+            return NULL;
+        }
+
+        memcpy(buffer + shared, record, len + 1);
+        record += len + 1;
+    }
+
+    return buffer;
+}
+
+/* sharedPrefix
+ *
+ * Returns how many leading characters path can borrow from prev when
+ * it is front-coded. At least one character is always left over, so
+ * the stored suffix is never empty.
+ *
+ * @param   prev            previous path (NULL for the first one)
+ * @param   path            path being coded
+ *
+ * @return  int             length of the shared prefix
+ */
+
+int sharedPrefix(char *prev, char *path)
+{
+    int shared;
+
+    if(prev == NULL || path == NULL)
+    {
+        return 0;
+    }
+
+    shared = 0;
+    while(prev[shared] != '\0' && prev[shared] == path[shared] && shared < FILETABLE_MAX_SHARED)
+    {
+        shared++;
+    }
+
+    /* Leave the last character of path for the suffix */
+    if(shared > 0 && path[shared] == '\0')
+    {
+        shared--;
+    }
+
+    return shared;
+}
+
+/* indexGeneration
+ *
+ * Generation of an index on disk, as its <files> line gives it
+ * (see nextGeneration): it changes whenever the index is written
+ * again, so answers worked out on an older one can be told apart.
+ * An index written before there were generations is generation 0.
+ *
+ * @param   index           name of the index
+ *
+ * @return  success         the generation
+ * @return  failure         -1
+ */
+
+long indexGeneration(char *index)
+{
+    FILE *file;
+    long numfiles, generation;
+
+    file = fopen(index, "r");
+    if(file == NULL)
+    {
+        return -1;
+    }
+
+    generation = 0;
+
+    if(fscanf(file, "<files> %ld %ld", &numfiles, &generation) < 1 || generation < 0)
+    {
+        generation = -1;
+    }
+
+    fclose(file);
+
+    return generation;
+}
+
+/* nextGeneration
+ *
+ * Generation to give an index about to be written under a name:
+ * one past that of the index there now, so every rewrite counts up
+ * whatever its time and size, and never behind the clock, so an
+ * index deleted and written again still moves on.
+ *
+ * @param   index           name the index will be written under
+ *
+ * @return  long            the generation
+ */
+
+long nextGeneration(char *index)
+{
+    long generation, now;
+
+    generation = indexGeneration(index) + 1;
+    now = (long) time(NULL);
+
+    return (generation > now) ? generation : now;
+}
@@ -0,0 +1,144 @@
+/*
+ * File: filetable.h
+ *
+ * Author: Mike Swift
+ * Email: theycallmeswift@gmail.com
+ * Date Created: May 11th, 2011
+ * Date Modified: May 11th, 2011
+ */
+
+#ifndef SWIFT_FILETABLE_H_
+#define SWIFT_FILETABLE_H_
+
+/********************************
+ *          1. Includes         *
+ ********************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/********************************
+ *          2. Constants        *
+ ********************************/
+
+/* Every FILETABLE_BLOCK-th path is stored in full, so rebuilding a
+ * path never walks more than FILETABLE_BLOCK - 1 other records */
+#define FILETABLE_BLOCK 16
+
+/* Longest prefix a record can share (it is stored in two bytes) */
+#define FILETABLE_MAX_SHARED 65535
+
+/* Initial size of the record buffer (grows as needed) */
+#define FILETABLE_DATA_SIZE 4096
+
+/********************************
+ *      3. Structs & Typedefs   *
+ ********************************/
+
+struct FileTable_;
+typedef struct FileTable_* FileTable;
+
+/********************************
+ *      4. FileTable Functions  *
+ ********************************/
+
+/* createFileTable
+ *
+ * Creates an empty, front-coded table of file paths. Each path is
+ * stored as the length of the prefix it shares with the path before
+ * it plus the rest of the path, so deep directory trees cost little
+ * more than their file names.
+ *
+ * @param   numfiles        number of paths that will be added
+ *
+ * @return  success         new FileTable
+ * @return  failure         NULL
+ */
+
+FileTable createFileTable(int numfiles);
+
+/* destroyFileTable
+ *
+ * Frees the table and every path in it. NULL is ignored.
+ *
+ * @param   table           table to destroy
+ *
+ * @return  void
+ */
+
+void destroyFileTable(FileTable table);
+
+/* addFilePath
+ *
+ * Appends the next path to the table. Paths are numbered in the
+ * order they are added, starting at 0.
+ *
+ * @param   table           file table
+ * @param   path            path of the next file
+ *
+ * @return  success         1
+ * @return  failure         0
+ */
+
+int addFilePath(FileTable table, char *path);
+
+/* getFilePath
+ *
+ * Rebuilds the path of a file into a buffer supplied by the caller.
+ *
+ * @param   table           file table
+ * @param   filenum         number of the file
+ * @param   buffer          where to write the path
+ * @param   size            size of buffer
+ *
+ * @return  success         buffer
+ * @return  failure         NULL
+ */
+
+char *getFilePath(FileTable table, int filenum, char *buffer, int size);
+
+/* sharedPrefix
+ *
+ * Returns how many leading characters path can borrow from prev when
+ * it is front-coded. At least one character is always left over, so
+ * the stored suffix is never empty.
+ *
+ * @param   prev            previous path (NULL for the first one)
+ * @param   path            path being coded
+ *
+ * @return  int             length of the shared prefix
+ */
+
+int sharedPrefix(char *prev, char *path);
+
+/* indexGeneration
+ *
+ * Generation of an index on disk, as its <files> line gives it
+ * (see nextGeneration): it changes whenever the index is written
+ * again, so answers worked out on an older one can be told apart.
+ * An index written before there were generations is generation 0.
+ *
+ * @param   index           name of the index
+ *
+ * @return  success         the generation
+ * @return  failure         -1
+ */
+
+long indexGeneration(char *index);
+
+/* nextGeneration
+ *
+ * Generation to give an index about to be written under a name:
+ * one past that of the index there now, so every rewrite counts up
+ * whatever its time and size, and never behind the clock, so an
+ * index deleted and written again still moves on.
+ *
+ * @param   index           name the index will be written under
+ *
+ * @return  long            the generation
+ */
+
+long nextGeneration(char *index);
+
+#endif /* SWIFT_FILETABLE_H_ */
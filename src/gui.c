@@ -38,6 +38,8 @@ void destroySearch()
     
     TKDestroy(tok);
     tok = NULL;
+    
+    releaseWords();
 }
 
 void createSearch()
@@ -90,7 +92,7 @@ void orsearch(GtkWidget *widget, gpointer data)
     GtkTextIter iter;
     
     gchar *search_text;
-    char buffer[1024];
+    char buffer[1024], path[MAX_BUFFER_SIZE];
     Result result;
     
     search_text = gtk_entry_get_text(GTK_ENTRY(data));
@@ -116,11 +118,11 @@ void orsearch(GtkWidget *widget, gpointer data)
     result = files->results;
     while(result != NULL)
     {
-        if(result->frequency > 0)
+        if(result->frequency >= 0 && getFilename(files, result->filenum, path, MAX_BUFFER_SIZE) != NULL)
         {
-            gtk_text_buffer_insert (gbuffer, &iter, files->list[result->filenum], -1);
+            gtk_text_buffer_insert (gbuffer, &iter, path, -1);
             gtk_text_buffer_insert (gbuffer, &iter, "\n", -1);
-            printf("%s\n", files->list[result->filenum]);
+            printf("%s\n", path);
         }
         result = result->next;
     }
@@ -136,7 +138,7 @@ void andsearch(GtkWidget *widget, gpointer data)
     
     
     gchar *search_text;
-    char buffer[1024];
+    char buffer[1024], path[MAX_BUFFER_SIZE];
     Result result;
     
     search_text = gtk_entry_get_text(GTK_ENTRY(data));
@@ -162,11 +164,11 @@ void andsearch(GtkWidget *widget, gpointer data)
     result = files->results;
     while(result != NULL)
     {
-        if(result->frequency > 0)
+        if(result->frequency >= 0 && getFilename(files, result->filenum, path, MAX_BUFFER_SIZE) != NULL)
         {
-            gtk_text_buffer_insert (gbuffer, &iter, files->list[result->filenum], -1);
+            gtk_text_buffer_insert (gbuffer, &iter, path, -1);
             gtk_text_buffer_insert (gbuffer, &iter, "\n", -1);
-            printf("%s\n", files->list[result->filenum]);
+            printf("%s\n", path);
         }
         result = result->next;
     }
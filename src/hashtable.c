@@ -12,6 +12,7 @@
 #include <assert.h>
 #include <string.h>
 #include "hashtable.h"
+#include "pool.h"
 
 
 /* Define internal structs */
@@ -42,6 +43,7 @@ typedef struct Pair_* Pair;
  * @param   key_destroy_func    Pointer to a function that destroys keys
  * @param   val_destroy_func    Pointer to a function that destroys values
  * @param   buckets             Array of Pairs
+ * @param   pairs               Pool the Pairs are allocated from
  */
 
 struct HashTable_ {
@@ -56,6 +58,7 @@ struct HashTable_ {
     destroy_val val_destroy_func;
     print_func print;
     Pair* buckets;
+    Pool pairs;
 };
 
 /* HTIterator
@@ -200,6 +203,10 @@ HashTable createHT(hash_func hash, comp_func comp, destroy_key key, destroy_val
     table->buckets = (Pair*) malloc( sizeof( Pair ) * table->numBuckets );
     assert(table->buckets != NULL);
     
+    /* Pairs come out of slabs so a big table isn't millions of mallocs */
+    table->pairs = createPool(sizeof(struct Pair_), POOL_SLAB_ITEMS);
+    assert(table->pairs != NULL);
+    
     table->val_destroy_func = val;
     table->key_destroy_func = key;
     table->print = print;
@@ -224,6 +231,8 @@ HashTable createHT(hash_func hash, comp_func comp, destroy_key key, destroy_val
  * passed in value is NULL, no action is performed. This function frees ALL 
  * data in the remaining nodes if there are destroy_key or destroy_val functions
  * defined.  Remember to set the variable pointers to NULL after they have been freed.
+ * When neither function is defined the buckets are not walked at all, the Pairs
+ * are released with their pool.
  *
  * @param   table       HashTable to be freed.
  *
@@ -237,33 +246,36 @@ void destroyHT(HashTable table)
     
     if(table != NULL)
     {
-        for(i = 0; i < table->numBuckets; i++)
+        /* Only walk the buckets if there is data we are responsible for */
+        if(table->key_destroy_func || table->val_destroy_func)
         {
-            curr = table->buckets[i];
-            while(curr != NULL)
+            for(i = 0; i < table->numBuckets; i++)
             {
-                next = curr->next;
-                /* Check if the destroy functions exist and call them if they do... */
-                if(table->key_destroy_func)
+                curr = table->buckets[i];
+                while(curr != NULL)
                 {
-                    table->key_destroy_func(curr->key);
-                    curr->key = NULL;
+                    next = curr->next;
+                    /* Check if the destroy functions exist and call them if they do... */
+                    if(table->key_destroy_func)
+                    {
+                        table->key_destroy_func(curr->key);
+                        curr->key = NULL;
+                    }
+                    
+                    if(table->val_destroy_func)
+                    {
+                        table->val_destroy_func(curr->val);
+                        curr->val = NULL;
+                    }
+                    
+                    /* ... And move on, the Pair itself goes with the pool ... */
+                    curr = next;
                 }
-                
-                if(table->val_destroy_func)
-                {
-                    table->val_destroy_func(curr->val);
-                    curr->val = NULL;
-                }
-                
-                /* Okay, any data we are responsible for is gone. Lets free the Pair struct */
-                free(curr);
-                
-                /* ... And move on ... */
-                curr = next;
             }
+            
         }
         
+        destroyPool(table->pairs);
         free(table->buckets);
         free(table);
     }
@@ -361,7 +373,7 @@ int insertHT(HashTable table, void *key, void *val)
     }
     
     /* Ok, lets make a key/value pair... */
-    kvpair = (Pair) malloc( sizeof(struct Pair_) );
+    kvpair = (Pair) poolAlloc(table->pairs);
     assert(kvpair != NULL);
     
     kvpair->hash = table->hash(key);    
@@ -496,8 +508,8 @@ int removeHT(HashTable table, void *key)
                 table->val_destroy_func(curr->val);
             }
             
-            /* Okay, any data we are responsible for is gone. Lets free the Pair struct */
-            free(curr);
+            /* Okay, any data we are responsible for is gone. Lets give the Pair back */
+            poolFree(table->pairs, curr);
             
             table->version++;
             
@@ -597,10 +609,16 @@ int HTNextItem(HTIterator iter, void** key, void** val)
         return -1;
     }
     
-    while(iter->row != (iter->table->numBuckets - 1))
+    while(1)
     {
         if(iter->curr == NULL)
         {
+            /* The chain of the last bucket is walked like any other */
+            if(iter->row == iter->table->numBuckets - 1)
+            {
+                return 0;
+            }
+            
             iter->row++;
             iter->curr = iter->table->buckets[iter->row];
         }
@@ -616,8 +634,6 @@ int HTNextItem(HTIterator iter, void** key, void** val)
             return 1;
         }
     }
-    
-    return 0;
 }
 
 
@@ -635,6 +651,20 @@ int getNumBuckets(HashTable table)
     return table->numBuckets;
 }
 
+/* getNumItems
+ *
+ * Returns the current number of items.
+ *
+ * @param       table           hashtable object
+ *
+ * @return      int             number of items
+ */
+
+int getNumItems(HashTable table)
+{
+    return table->numItems;
+}
+
 /* hash
  *
  * Simple hashing function for strings.
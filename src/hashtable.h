@@ -86,6 +86,8 @@ HashTable createHT(hash_func hash, comp_func comp, destroy_key key, destroy_val
  * passed in value is NULL, no action is performed. This function frees ALL 
  * data in the remaining nodes if there are destroy_key or destroy_val functions
  * defined.  Remember to set the variable pointers to NULL after they have been freed.
+ * When neither function is defined the buckets are not walked at all, the Pairs
+ * are released with their pool.
  *
  * @param   table       HashTable to be freed.
  *
@@ -223,6 +225,17 @@ int HTNextItem(HTIterator iter, void** key, void** val);
 
 int getNumBuckets(HashTable table);
 
+/* getNumItems
+ *
+ * Returns the current number of items.
+ *
+ * @param       table           hashtable object
+ *
+ * @return      int             number of items
+ */
+
+int getNumItems(HashTable table);
+
 /* hash
  *
  * Simple hashing function for strings.
@@ -0,0 +1,227 @@
+/*
+ * File: impact.c
+ *
+ * Author: Mike Swift
+ * Email: theycallmeswift@gmail.com
+ * Date Created: May 15th, 2011
+ * Date Modified: May 15th, 2011
+ */
+
+/********************************
+ *          1. Includes         *
+ ********************************/
+
+#include "impact.h"
+
+/********************************
+ *      2. Helper Functions     *
+ ********************************/
+
+/* compEntryImpacts
+ *
+ * qsort comparator that orders Entry pointers by frequency (desc),
+ * then by file number.
+ *
+ * @param   ptr1        first entry
+ * @param   ptr2        second entry
+ *
+ * @return  int         <0, 0 or >0
+ */
+
+int compEntryImpacts(const void *ptr1, const void *ptr2)
+{
+    Entry a, b;
+    
+    a = *(Entry*) ptr1;
+    b = *(Entry*) ptr2;
+    
+    if(a->frequency != b->frequency)
+    {
+        return b->frequency - a->frequency;
+    }
+    
+    return a->filenumber - b->filenumber;
+}
+
+/********************************
+ *      3. Impact Functions     *
+ ********************************/
+
+/* writeImpacts
+ *
+ * Writes the postings of a word to the impact stream, best first.
+ * A word's score in a file only depends on its frequency there, so
+ * the postings are grouped into segments of equal frequency, one
+ * impact level each, highest first:
+ *
+ *      per segment: frequency, #files, then the gaps between
+ *                   its file numbers (ascending)
+ *      0 (end of the list)
+ *
+ * Every number is written with writeVByte. A reader can stop after
+ * any segment and knows nothing after it scores higher.
+ *
+ * @param   file            impact stream
+ * @param   word            word about to be written to the index
+ *
+ * @return  success         offset the list starts at
+ * @return  failure         -1
+ */
+
+long writeImpacts(FILE *file, Word word)
+{
+    Entry ent, *entries;
+    long offset;
+    int i, j, n, last;
+    
+    if(file == NULL || word == NULL)
+    {
+        fprintf(stderr, "Error: Cannot write impacts of NULL word.\n");
+        return -1;
+    }
+    
+    n = 0;
+    for(ent = word->head; ent != NULL; ent = ent->next)
+    {
+        n++;
+    }
+    
+    entries = (Entry*) malloc(sizeof(Entry) * (n + 1));
+    if(entries == NULL)
+    {
+        fprintf(stderr, "Error: Could not allocate space for impacts.\n");
+        return -1;
+    }
+    
+    i = 0;
+    for(ent = word->head; ent != NULL; ent = ent->next)
+    {
+        entries[i] = ent;
+        i++;
+    }
+    
+    qsort(entries, n, sizeof(Entry), compEntryImpacts);
+    
+    offset = ftell(file);
+    
+    for(i = 0; i < n; i = j)
+    {
+        /* Find the end of the segment */
+        for(j = i; j < n && entries[j]->frequency == entries[i]->frequency; j++)
+        {
+        }
+        
+        if(writeVByte(file, entries[i]->frequency) == 0 || writeVByte(file, j - i) == 0)
+        {
+            free(entries);
+            return -1;
+        }
+        
+        last = 0;
+        for(; i < j; i++)
+        {
+            if(writeVByte(file, entries[i]->filenumber - last) == 0)
+            {
+                free(entries);
+                return -1;
+            }
+            last = entries[i]->filenumber;
+        }
+    }
+    
+    free(entries);
+    
+    if(writeVByte(file, 0) == 0)
+    {
+        return -1;
+    }
+    
+    return offset;
+}
+
+/* readImpactSegment
+ *
+ * Reads the header of the segment at *pos and moves *pos past it.
+ *
+ * @param   file            impact stream
+ * @param   pos             offset of the segment, updated
+ * @param   freq            where to store its frequency (0 once the
+ *                          list has ended)
+ * @param   count           where to store its number of files
+ *
+ * @return  success         1
+ * @return  failure         0
+ */
+
+int readImpactSegment(FILE *file, long *pos, int *freq, int *count)
+{
+    unsigned int value;
+    
+    *freq = 0;
+    *count = 0;
+    
+    if(fseek(file, *pos, SEEK_SET) != 0 || readVByte(file, &value) == 0)
+    {
+        fprintf(stderr, "Error: Malformed impact file.\n");
+        return 0;
+    }
+    *freq = value;
+    
+    if(value != 0)
+    {
+        if(readVByte(file, &value) == 0)
+        {
+            fprintf(stderr, "Error: Malformed impact file.\n");
+            return 0;
+        }
+        *count = value;
+    }
+    
+    *pos = ftell(file);
+    
+    return 1;
+}
+
+/* readImpactFiles
+ *
+ * Reads the file numbers that follow a segment header and moves
+ * *pos past them.
+ *
+ * @param   file            impact stream
+ * @param   pos             offset of the file numbers, updated
+ * @param   files           where to store them
+ * @param   count           number of files in the segment
+ *
+ * @return  success         1
+ * @return  failure         0
+ */
+
+int readImpactFiles(FILE *file, long *pos, int *files, int count)
+{
+    unsigned int gap;
+    int i, doc;
+    
+    if(fseek(file, *pos, SEEK_SET) != 0)
+    {
+        fprintf(stderr, "Error: Malformed impact file.\n");
+        return 0;
+    }
+    
+    doc = 0;
+    
+    for(i = 0; i < count; i++)
+    {
+        if(readVByte(file, &gap) == 0)
+        {
+            fprintf(stderr, "Error: Malformed impact file.\n");
+            return 0;
+        }
+        
+        doc += gap;
+        files[i] = doc;
+    }
+    
+    *pos = ftell(file);
+    
+    return 1;
+}
@@ -0,0 +1,88 @@
+/*
+ * File: impact.h
+ *
+ * Author: Mike Swift
+ * Email: theycallmeswift@gmail.com
+ * Date Created: May 15th, 2011
+ * Date Modified: May 15th, 2011
+ */
+
+#ifndef SWIFT_IMPACT_H_
+#define SWIFT_IMPACT_H_
+
+/********************************
+ *          1. Includes         *
+ ********************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "postings.h"
+#include "words.h"
+
+/********************************
+ *          2. Constants        *
+ ********************************/
+
+/* Binary stream of impact ordered postings next to an inverted index */
+#define IMPACT_SUFFIX ".imp"
+
+/********************************
+ *      3. Impact Functions     *
+ ********************************/
+
+/* writeImpacts
+ *
+ * Writes the postings of a word to the impact stream, best first.
+ * A word's score in a file only depends on its frequency there, so
+ * the postings are grouped into segments of equal frequency, one
+ * impact level each, highest first:
+ *
+ *      per segment: frequency, #files, then the gaps between
+ *                   its file numbers (ascending)
+ *      0 (end of the list)
+ *
+ * Every number is written with writeVByte. A reader can stop after
+ * any segment and knows nothing after it scores higher.
+ *
+ * @param   file            impact stream
+ * @param   word            word about to be written to the index
+ *
+ * @return  success         offset the list starts at
+ * @return  failure         -1
+ */
+
+long writeImpacts(FILE *file, Word word);
+
+/* readImpactSegment
+ *
+ * Reads the header of the segment at *pos and moves *pos past it.
+ *
+ * @param   file            impact stream
+ * @param   pos             offset of the segment, updated
+ * @param   freq            where to store its frequency (0 once the
+ *                          list has ended)
+ * @param   count           where to store its number of files
+ *
+ * @return  success         1
+ * @return  failure         0
+ */
+
+int readImpactSegment(FILE *file, long *pos, int *freq, int *count);
+
+/* readImpactFiles
+ *
+ * Reads the file numbers that follow a segment header and moves
+ * *pos past them.
+ *
+ * @param   file            impact stream
+ * @param   pos             offset of the file numbers, updated
+ * @param   files           where to store them
+ * @param   count           number of files in the segment
+ *
+ * @return  success         1
+ * @return  failure         0
+ */
+
+int readImpactFiles(FILE *file, long *pos, int *files, int count);
+
+#endif /* SWIFT_IMPACT_H_ */
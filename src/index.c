@@ -16,9 +16,17 @@
  *          2. Globals          *
  ********************************/
 HashTable wordTable;
+Arena termPool;
 Entry file_list;
+Entry file_tail;
+Trigrams trigrams;
 int totalFiles;
 
+/* The index being built is shard shardNumber of numShards, walkedFiles counts every file met */
+int numShards = 1;
+int shardNumber = 0;
+int walkedFiles;
+
 /********************************
  *      3. Helper Functions     *
  ********************************/
@@ -41,7 +49,8 @@ int plist(const char *name, const struct stat *status, int type) {
         return 0;
     }
 
-    if(type == FTW_F)
+    /* Every walk meets the files in the same order, a shard takes every numShards-th one */
+    if(type == FTW_F && walkedFiles++ % numShards == shardNumber)
     {
         if(DEBUG) printf("plist: Attempting to tokenize %s.\n", (char *) name);
         tokenizeFile( (char *) name );
@@ -50,6 +59,59 @@ int plist(const char *name, const struct stat *status, int type) {
     return 0;
 }
 
+/* compWordPtrs
+ *
+ * qsort wrapper around compWords for an array of Words.
+ *
+ * @param   ptr1        pointer to the first Word
+ * @param   ptr2        pointer to the second Word
+ *
+ * @return  int         same as compWords
+ */
+
+int compWordPtrs(const void *ptr1, const void *ptr2)
+{
+    return compWords(*(Word*) ptr1, *(Word*) ptr2);
+}
+
+/* writePositions
+ *
+ * Writes the positions of an entry as gaps, the first one being
+ * relative to 0.
+ *
+ * @param   positions   positions stream
+ * @param   ent         entry to write
+ *
+ * @return  success     1
+ * @return  failure     0
+ */
+
+int writePositions(FILE *positions, Entry ent)
+{
+    PosBlock block;
+    unsigned int prev;
+    int i;
+    
+    prev = 0;
+    block = ent->positions;
+    
+    for(i = 0; i < ent->numPositions; i++)
+    {
+        if(i > 0 && i % POSITION_BLOCK == 0)
+        {
+            block = block->next;
+        }
+        
+        if(writeVByte(positions, block->pos[i % POSITION_BLOCK] - prev) == 0)
+        {
+            return 0;
+        }
+        prev = block->pos[i % POSITION_BLOCK];
+    }
+    
+    return 1;
+}
+
 
 /********************************
  *      4. Indexer Functions    *
@@ -70,15 +132,31 @@ int tokenizeFile( char* filename )
 {
     TokenizerT tok;
     Word word;
-    char *str;
-    int res;
+    char str[MAX_BUFFER_SIZE], *term;
+    int res, position;
     Entry file;
     
-    /* Insert filename into the file_list */
-    file = createEntry(filename, -1, 1);
-    file->next = file_list;
-    file_list = file;
+    /* Append filename to the file_list, its position is its file number */
+    file = createEntry(filename, totalFiles, 1);
+    assert(file != NULL);
+    
+    if(file_tail == NULL)
+    {
+        file_list = file;
+    }
+    else
+    {
+        file_tail->next = file;
+    }
+    file_tail = file;
     totalFiles++;
+    
+    /* Substring search works on the raw bytes, not on the tokens */
+    if(trigrams != NULL)
+    {
+        res = addFileTrigrams(trigrams, filename, file->filenumber);
+        assert(res != 0);
+    }
         
     /* Create a Tokenizer for the file */
     tok = TKCreate(STRING_CHARS, filename);
@@ -86,8 +164,10 @@ int tokenizeFile( char* filename )
     
     if(DEBUG) printf("tokenizeFile: Created Tokenizer.\n");
     
-    /* Parse the file */
-    while((str = TKGetNextToken(tok)) != 0)
+    /* Parse the file, every token lands in the same buffer */
+    position = 0;
+    
+    while(TKGetNextTokenInto(tok, str, MAX_BUFFER_SIZE) != 0)
     {        
         /* Search the hash table for the key/file combo */
         if(DEBUG) { printf("Searching for %s\n", str); }
@@ -97,27 +177,31 @@ int tokenizeFile( char* filename )
         {
             if(DEBUG) printf("tokenizeFile: Couldn't find %s in HT.\n", str);
             
+            /* Intern the term once, the HT key and the Word share it */
+            term = arenaString(termPool, str);
+            assert(term != NULL);
+            
             /* Create the word */
-            word = createWord(str);
+            word = createInternedWord(term);
             assert(word != NULL);
             
             /* Append the file entry */
-            res = insertEntry(word, filename);
+            res = insertEntry(word, file->filenumber, position);
             assert(res != 0);
             
             /* Insert it into the HT */
-            res = insertHT(wordTable, (void*) str, (void*) word);
+            res = insertHT(wordTable, (void*) term, (void*) word);
             assert(res != 0);
         }
         else
         {
             if(DEBUG) printf("tokenizeFile: Found %s in HT.\n", str);
             
-            res = insertEntry(word, filename);
+            res = insertEntry(word, file->filenumber, position);
             assert(res != 0);
-
-            if(str != NULL) free(str);
         }
+        
+        position++;
     }
     
     TKDestroy(tok);
@@ -131,7 +215,11 @@ int tokenizeFile( char* filename )
 /* HTtoSL
  *
  * Function that converts a HashTable to a Sorted List.
- * Returns a new list on success and NULL on failure.
+ * Returns a new list on success and NULL on failure. The
+ * list does not own the words, they are released in bulk
+ * with releaseWords. The words are sorted with qsort first
+ * and then inserted largest first, so every SLInsert lands
+ * at the head of the list.
  *
  * @param   table       hashtable
  *
@@ -142,33 +230,48 @@ int tokenizeFile( char* filename )
 SortedListT HTtoSL(HashTable table)
 {
     HTIterator iter;
-    int res;
+    int i, count;
     void *key, *val;
-    char* str;
-    Word word;
+    Word *words;
     SortedListT list;
     
     /* Create a new Sorted List */
-    list = SLCreate(compWords, destroyWord);
+    list = SLCreate(compWords, NULL);
     if(list == NULL)
     {
         fprintf(stderr, "Error: Could not allocate enough memory for list.\n");
         return NULL;
     }
     
+    words = (Word*) malloc(sizeof(Word) * (getNumItems(table) + 1));
+    if(words == NULL)
+    {
+        fprintf(stderr, "Error: Could not allocate enough memory for list.\n");
+        SLDestroy(list);
+        return NULL;
+    }
+    
     iter = createIterHT(table);
+    count = 0;
     
-    while((res = HTNextItem(iter, &key, &val) == 1))
+    while(HTNextItem(iter, &key, &val) == 1)
     {
-        str = (char*)key;
-        word = (Word)val;
-        
-        SLInsert(list, (void*)word);
+        words[count] = (Word)val;
+        count++;
     }
         
     destroyIterHT(iter);
     iter = NULL;
     
+    qsort(words, count, sizeof(Word), compWordPtrs);
+    
+    for(i = count - 1; i >= 0; i--)
+    {
+        SLInsert(list, (void*)words[i]);
+    }
+    
+    free(words);
+    
     return list;
 }
 
@@ -177,24 +280,29 @@ SortedListT HTtoSL(HashTable table)
  * Writes the file list to an inverted index in the following 
  * format:
  *
- * <files>
- *      file#:filename
- *      file#:filename
+ * <files> #files generation
+ *      file#:shared:suffix
+ *      file#:shared:suffix
  *      ... etc ...
  * </files>
  *
- * Returns a 1 on success, 0 on failure.
+ * The paths are front-coded: each one keeps only the part that
+ * differs from the path before it, shared being the number of
+ * leading characters it borrows. Returns a 1 on success, 0 on
+ * failure.
  *
  * @param   file        pointer to the file
  * @param   list        list of file entries
+ * @param   generation  generation of the index (see nextGeneration)
  *
  * @result  success     1
  * @result  failure     0
  */
-int indexFiles(FILE* file, Entry list)
+int indexFiles(FILE* file, Entry list, long generation)
 {    
-    int i;
-    char buffer[1024];
+    int i, shared;
+    char buffer[1024], *prev;
+    Entry ent;
     
     if(file == NULL)
     {
@@ -202,25 +310,36 @@ int indexFiles(FILE* file, Entry list)
         return 0;
     }
     
+    /* Count the files so callers other than runindex can write a table */
+    i = 0;
+    for(ent = list; ent != NULL; ent = ent->next)
+    {
+        i++;
+    }
+    
     fputs("<files> ", file);
     
-    sprintf(buffer, "%i\n", totalFiles);
+    sprintf(buffer, "%i %ld\n", i, generation);
     fputs(buffer, file);
     
     i = 0;
+    prev = NULL;
     
     while(list != NULL)
     {
         fputs("\t", file);
         
-        /* Convert the file number to a string */
-        sprintf(buffer, "%i", i);
+        shared = sharedPrefix(prev, list->filename);
+        
+        /* Convert the file number and shared length to a string */
+        sprintf(buffer, "%i:%i", i, shared);
         
         fputs(buffer, file);
         fputs(":", file);
-        fputs(list->filename, file);
+        fputs(list->filename + shared, file);
         fputs("\n", file);
         
+        prev = list->filename;
         list = list->next;
         i++;
     }
@@ -233,22 +352,30 @@ int indexFiles(FILE* file, Entry list)
  *
  * Writes a Word to an inverted index in the following format:
  *
- * <list> Word #files
+ * <list> Word #files offset
  *      file#: frequency
  *      file#: frequency
  *      ... etc ...
  * </list>
  *
+ * The token positions of every entry go to the positions stream,
+ * in the same order as the entries, each list gap encoded with
+ * writeVByte. offset is where the word's positions start.
+ *
+ * Entries with a NULL filename are written with their stored
+ * filenumber instead of being looked up in the global file_list.
+ *
  * Returns a 1 on success, 0 on failure.
  *
  * @param   file        pointer to the file
+ * @param   positions   pointer to the positions stream
  * @param   word        Word object to write
  *
  * @return  success     1
  * @return  failure     0
  */
 
-int indexWord(FILE *file, Word word)
+int indexWord(FILE *file, FILE *positions, Word word)
 {
     Entry ent, currfile;
     char buffer[255];
@@ -266,11 +393,17 @@ int indexWord(FILE *file, Word word)
         return 0;
     }
     
+    if(positions == NULL)
+    {
+        fprintf(stderr, "Error: Positions file cannot be NULL.\n");
+        return 0;
+    }
+    
     /* Write the <list> header */
     fputs("<list> ", file);
     fputs(word->word, file);
     
-    sprintf(buffer, " %i\n", word->numFiles);
+    sprintf(buffer, " %i %li\n", word->numFiles, ftell(positions));
     
     fputs(buffer, file);
     
@@ -286,18 +419,26 @@ int indexWord(FILE *file, Word word)
     {
         fputs("\t", file);
         
-        /* Convert filename to int */
-        i = 0;
-        currfile = file_list;
-        
-        while(currfile != NULL && strcmp(currfile->filename, ent->filename) != 0)
+        if(ent->filename == NULL)
         {
-            i++;
-            currfile = currfile->next;
+            /* Entry was read back from an index, it already has a number */
+            i = ent->filenumber;
+        }
+        else
+        {
+            /* Convert filename to int */
+            i = 0;
+            currfile = file_list;
+            
+            while(currfile != NULL && strcmp(currfile->filename, ent->filename) != 0)
+            {
+                i++;
+                currfile = currfile->next;
+            }
+            
+            /* Validate that the file was found */
+            assert(currfile != NULL);
         }
-        
-        /* Validate that the file was found */
-        assert(currfile != NULL);
         
         sprintf(buffer, "%i: ", i);
         
@@ -309,6 +450,12 @@ int indexWord(FILE *file, Word word)
         fputs(buffer, file);
         fputs("\n", file);
         
+        if(writePositions(positions, ent) == 0)
+        {
+            fprintf(stderr, "Error: Could not write positions.\n");
+            return 0;
+        }
+        
         ent = ent->next;
     }
     
@@ -318,23 +465,52 @@ int indexWord(FILE *file, Word word)
 }
 
 
-int runindex( int argc, char** argv )
-{    
+/* buildIndex
+ *
+ * Walks a file or directory and writes an inverted index of what
+ * it finds, with every stream that goes next to one. When the
+ * index is split into shards (see numShards) only the files of
+ * the current shard (shardNumber) go into it.
+ *
+ * @param   name        name of the inverted index
+ * @param   dir         file or directory to index
+ * @param   codec       codec of the packed postings
+ * @param   withImpacts whether to write impact ordered lists
+ * @param   withTrigrams whether to write a trigram index
+ *
+ * @return  success     1
+ */
+
+int buildIndex(char *name, char *dir, int codec, int withImpacts, int withTrigrams)
+{
     int i, res;
     Entry ent, next;
     void* ptr;
     Word word;
+    Bloom bloom;
+    Mphf mphf;
     SortedListT wordList;
     SortedListIterT iter;
-    FILE *index;
+    FILE *index, *positions, *lexicon, *blocks, *impacts, *containers, *packed;
+    long offset, first, summary, impact, container, pack, generation;
     
     totalFiles = 0;
+    walkedFiles = 0;
+    trigrams = NULL;
+    impacts = NULL;
     
-    /* Validate the inputs */
-    if( (argc == 2 && argv[1][0] == '-' && argv[1][1] == 'h') || argc < 3 )
+    if(withTrigrams)
     {
-        fprintf(stderr, "Usage: %s <inverted-index filename> <file or directory>\n", argv[0]);
-        return 1;
+        /* Build a trigram index for substring search too */
+        trigrams = createTrigrams();
+        assert(trigrams != NULL);
+    }
+    
+    if(withImpacts)
+    {
+        /* And impact ordered lists for early terminating top-k */
+        impacts = openSidecar(name, IMPACT_SUFFIX, "wb");
+        assert(impacts != NULL);
     }
     
     /* By default, set wordList = NULL */
@@ -342,16 +518,21 @@ int runindex( int argc, char** argv )
     
     /* Create a HashTable to hold our entries. We are setting the destroy value
     method = NULL because we will use it once the sortedList is destroyed */
-    wordTable = createHT(hash, compStrings, destroyString, NULL, printWordHT);
+    wordTable = createHT(hash, compStrings, NULL, NULL, printWordHT);
     assert(wordTable != NULL);
     
+    /* Every distinct term is stored exactly once, in here */
+    termPool = createArena(ARENA_CHUNK_SIZE);
+    assert(termPool != NULL);
+    
     if(DEBUG) printf("main: Created HashTable.\n");
     
     /* Set file_list = NULL because the list starts out empty */
     file_list = NULL;
+    file_tail = NULL;
     
     /* Recursivly walk through each file in a directory and tokenize */    
-    ftw(argv[2], plist, 1);
+    ftw(dir, plist, 1);
     
     /* Print out the HT */
     if(DEBUG) toStringHT(wordTable);
@@ -375,13 +556,47 @@ int runindex( int argc, char** argv )
     wordList = HTtoSL(wordTable);
     assert(wordList != NULL);
     
+    /* One past the index this one replaces, so it has to be read before that is gone */
+    generation = nextGeneration(name);
+    
     /* Create the new index file */
-    index = fopen(argv[1], "w");
+    index = fopen(name, "w");
     assert(index != NULL);
     
-    res = indexFiles(index, file_list);
+    /* Positions go to their own binary stream next to the index */
+    positions = openSidecar(name, POSITIONS_SUFFIX, "wb");
+    assert(positions != NULL);
+    
+    /* And the sorted lexicon, so search can jump straight to a term */
+    lexicon = openSidecar(name, LEXICON_SUFFIX, "w");
+    assert(lexicon != NULL);
+    
+    /* And a summary of every block of postings, for top-k searches */
+    blocks = openSidecar(name, BLOCKMAX_SUFFIX, "wb");
+    assert(blocks != NULL);
+    
+    /* And the file sets of common words, for bitwise AND, OR and NOT */
+    containers = openSidecar(name, ROARING_SUFFIX, "wb");
+    assert(containers != NULL);
+    
+    /* And every list again, block coded, so search can decode instead of parse */
+    packed = openSidecar(name, PACKED_SUFFIX, "wb");
+    assert(packed != NULL);
+    
+    res = writeCodecHeader(packed, codec);
     assert(res != 0);
     
+    res = indexFiles(index, file_list, generation);
+    assert(res != 0);
+    
+    /* And a Bloom filter of the terms, so search turns away the ones it lacks */
+    bloom = createBloom();
+    assert(bloom != NULL);
+    
+    /* And a minimal perfect hash of them, so it finds a term without searching */
+    mphf = createMphf();
+    assert(mphf != NULL);
+    
     /* Get ready to iterate over the table */
     iter = SLCreateIterator(wordList);
     i = 0;
@@ -392,7 +607,39 @@ int runindex( int argc, char** argv )
         
         if(DEBUG) printf("[%i]: %s\n", i, word->word);
         
-        res = indexWord(index, word);
+        offset = ftell(index);
+        first = ftell(positions);
+        
+        res = indexWord(index, positions, word);
+        assert(res != 0);
+        
+        pack = writePacked(packed, codec, word, first);
+        assert(pack >= 0);
+        
+        summary = writeBlockMaxima(blocks, word);
+        assert(summary >= 0);
+        
+        impact = -1;
+        if(impacts != NULL)
+        {
+            impact = writeImpacts(impacts, word);
+            assert(impact >= 0);
+        }
+        
+        container = -1;
+        if(IS_DENSE(word->numFiles, totalFiles))
+        {
+            container = writeContainers(containers, word);
+            assert(container >= 0);
+        }
+        
+        res = writeLexiconEntry(lexicon, word, offset, summary, impact, container, pack);
+        assert(res != 0);
+        
+        res = addBloom(bloom, word->word);
+        assert(res != 0);
+        
+        res = addMphf(mphf, word->word);
         assert(res != 0);
         
         i++;
@@ -402,6 +649,60 @@ int runindex( int argc, char** argv )
     fclose(index);
     index = NULL;
     
+    fclose(positions);
+    positions = NULL;
+    
+    fclose(lexicon);
+    lexicon = NULL;
+    
+    fclose(blocks);
+    blocks = NULL;
+    
+    fclose(containers);
+    containers = NULL;
+    
+    fclose(packed);
+    packed = NULL;
+    
+    res = writeBloom(bloom, name);
+    assert(res != 0);
+    
+    destroyBloom(bloom);
+    bloom = NULL;
+    
+    res = writeMphf(mphf, name);
+    assert(res != 0);
+    
+    destroyMphf(mphf);
+    mphf = NULL;
+    
+    /* Impacts are optional too, same deal as the trigrams below */
+    if(impacts != NULL)
+    {
+        fclose(impacts);
+        impacts = NULL;
+    }
+    else
+    {
+        res = removeSidecar(name, IMPACT_SUFFIX);
+        assert(res != 0);
+    }
+    
+    /* Trigrams are optional, but never leave stale ones behind */
+    if(trigrams != NULL)
+    {
+        res = writeTrigrams(trigrams, name);
+        assert(res != 0);
+        
+        destroyTrigrams(trigrams);
+        trigrams = NULL;
+    }
+    else
+    {
+        res = removeSidecar(name, TRIGRAM_SUFFIX);
+        assert(res != 0);
+    }
+    
     /* Now we're done with the iterator, goodbye. */
     SLDestroyIterator(iter);
     iter = NULL;
@@ -421,9 +722,125 @@ int runindex( int argc, char** argv )
     {
         next = ent->next;
         free(ent->filename);
-        free(ent);
+        ent->filename = NULL;
         ent = next;
     }
     
+    file_list = NULL;
+    file_tail = NULL;
+    
+    /* Every Word, Entry and term goes back in one shot */
+    releaseWords();
+    
+    destroyArena(termPool);
+    termPool = NULL;
+    
     return 1;
 }
+
+
+int runindex( int argc, char** argv )
+{    
+    static char *suffixes[] = {POSITIONS_SUFFIX, LEXICON_SUFFIX, BLOCKMAX_SUFFIX, IMPACT_SUFFIX,
+                               ROARING_SUFFIX, PACKED_SUFFIX, TRIGRAM_SUFFIX, BLOOM_SUFFIX, MPHF_SUFFIX};
+    int i, res, codec, shards, withImpacts, withTrigrams;
+    char *name, *shard;
+    Stats stats;
+    
+    codec = DEFAULT_CODEC;
+    shards = 1;
+    withImpacts = 0;
+    withTrigrams = 0;
+    
+    /* Validate the inputs */
+    if( (argc == 2 && argv[1][0] == '-' && argv[1][1] == 'h') || argc < 3 )
+    {
+        fprintf(stderr, "Usage: %s [-t] [-i] [-c vbyte|streamvbyte|pfor] [-s <shards>] <inverted-index filename> <file or directory>\n", argv[0]);
+        return 1;
+    }
+    
+    /* The index and the directory always come last */
+    name = argv[argc - 2];
+    
+    for(i = 1; i < argc - 2; i++)
+    {
+        if(strcmp(argv[i], "-t") == 0)
+        {
+            withTrigrams = 1;
+        }
+        else if(strcmp(argv[i], "-i") == 0)
+        {
+            withImpacts = 1;
+        }
+        else if(strcmp(argv[i], "-c") == 0 && i + 1 < argc - 2)
+        {
+            /* And the codec of the packed postings */
+            i++;
+            codec = codecByName(argv[i]);
+            if(codec < 0)
+            {
+                fprintf(stderr, "Error: Unknown codec %s, try vbyte, streamvbyte or pfor.\n", argv[i]);
+                return 1;
+            }
+        }
+        else if(strcmp(argv[i], "-s") == 0 && i + 1 < argc - 2)
+        {
+            /* Split the files over that many self-contained indexes */
+            i++;
+            shards = atoi(argv[i]);
+            if(shards < 1 || shards > MAX_SHARDS)
+            {
+                fprintf(stderr, "Error: An index is split into 1 to %d shards.\n", MAX_SHARDS);
+                return 1;
+            }
+        }
+    }
+    
+    if(shards == 1)
+    {
+        numShards = 1;
+        shardNumber = 0;
+        
+        /* Only a sharded or a merged index has a statistics block */
+        res = removeSidecar(name, STATS_SUFFIX);
+        assert(res != 0);
+        
+        return buildIndex(name, argv[argc - 1], codec, withImpacts, withTrigrams);
+    }
+    
+    /* Every shard is a whole index, the index itself only names them */
+    numShards = shards;
+    
+    stats = createStats();
+    assert(stats != NULL);
+    
+    for(shardNumber = 0; shardNumber < numShards; shardNumber++)
+    {
+        shard = shardName(name, shardNumber);
+        assert(shard != NULL);
+        
+        res = buildIndex(shard, argv[argc - 1], codec, withImpacts, withTrigrams);
+        assert(res != 0);
+        
+        /* Each shard adds its counts to those of the whole index */
+        res = addIndexStats(stats, shard);
+        assert(res != 0);
+        
+        free(shard);
+    }
+    
+    res = writeStats(stats, name);
+    assert(res != 0);
+    
+    destroyStats(stats);
+    stats = NULL;
+    
+    /* Streams of an index that used to be here would be read with the manifest */
+    for(i = 0; i < (int) (sizeof(suffixes) / sizeof(suffixes[0])); i++)
+    {
+        res = removeSidecar(name, suffixes[i]);
+        assert(res != 0);
+    }
+    
+    return writeManifest(name, numShards);
+}
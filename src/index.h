@@ -18,9 +18,21 @@
 #include <string.h>
 #include <assert.h>
 #include <ftw.h>
+#include "arena.h"
+#include "blockmax.h"
+#include "bloom.h"
+#include "codec.h"
+#include "filetable.h"
+#include "lexicon.h"
+#include "manifest.h"
+#include "postings.h"
+#include "roaring.h"
 #include "hashtable.h"
+#include "impact.h"
 #include "tokenizer.h"
 #include "sorted-list.h"
+#include "stats.h"
+#include "trigram.h"
 #include "words.h"
 
 /********************************
@@ -51,7 +63,11 @@ int tokenizeFile( char* filename );
 /* HTtoSL
  *
  * Function that converts a HashTable to a Sorted List.
- * Returns a new list on success and NULL on failure.
+ * Returns a new list on success and NULL on failure. The
+ * list does not own the words, they are released in bulk
+ * with releaseWords. The words are sorted with qsort first
+ * and then inserted largest first, so every SLInsert lands
+ * at the head of the list.
  *
  * @param   table       hashtable
  *
@@ -66,42 +82,72 @@ SortedListT HTtoSL(HashTable table);
  * Writes the file list to an inverted index in the following 
  * format:
  *
- * <files>
- *      file#:filename
- *      file#:filename
+ * <files> #files generation
+ *      file#:shared:suffix
+ *      file#:shared:suffix
  *      ... etc ...
  * </files>
  *
- * Returns a 1 on success, 0 on failure.
+ * The paths are front-coded: each one keeps only the part that
+ * differs from the path before it, shared being the number of
+ * leading characters it borrows. Returns a 1 on success, 0 on
+ * failure.
  *
  * @param   file        pointer to the file
  * @param   list        list of file entries
+ * @param   generation  generation of the index (see nextGeneration)
  *
  * @result  success     1
  * @result  failure     0
  */
-int indexFiles(FILE* file, Entry list);
+int indexFiles(FILE* file, Entry list, long generation);
 
 /* indexWord
  *
  * Writes a Word to an inverted index in the following format:
  *
- * <list> Word
+ * <list> Word #files offset
  *      file#: frequency
  *      file#: frequency
  *      ... etc ...
  * </list>
  *
+ * The token positions of every entry go to the positions stream,
+ * in the same order as the entries, each list gap encoded with
+ * writeVByte. offset is where the word's positions start.
+ *
+ * Entries with a NULL filename are written with their stored
+ * filenumber instead of being looked up in the global file_list.
+ *
  * Returns a 1 on success, 0 on failure.
  *
  * @param   file        pointer to the file
+ * @param   positions   pointer to the positions stream
  * @param   word        Word object to write
  *
  * @return  success     1
  * @return  failure     0
  */
 
-int indexWord(FILE *file, Word word);
+int indexWord(FILE *file, FILE *positions, Word word);
+
+/* buildIndex
+ *
+ * Walks a file or directory and writes an inverted index of what
+ * it finds, with every stream that goes next to one. When the
+ * index is split into shards (see numShards) only the files of
+ * the current shard (shardNumber) go into it.
+ *
+ * @param   name        name of the inverted index
+ * @param   dir         file or directory to index
+ * @param   codec       codec of the packed postings
+ * @param   withImpacts whether to write impact ordered lists
+ * @param   withTrigrams whether to write a trigram index
+ *
+ * @return  success     1
+ */
+
+int buildIndex(char *name, char *dir, int codec, int withImpacts, int withTrigrams);
 
 /* Driver */
 int runindex( int argc, char** argv );
@@ -0,0 +1,545 @@
+/*
+ * File: intersect.c
+ *
+ * Author: Mike Swift
+ * Email: theycallmeswift@gmail.com
+ * Date Created: May 15th, 2011
+ * Date Modified: May 15th, 2011
+ */
+
+/********************************
+ *          1. Includes         *
+ ********************************/
+
+#include "intersect.h"
+
+#if INTERSECT_SIMD
+#include <immintrin.h>
+#endif
+
+/********************************
+ *          2. Tables           *
+ ********************************/
+
+#if INTERSECT_SIMD
+
+/* pshufb masks that move the 32 bit lanes picked by a 4 bit mask to the front */
+static const unsigned char packLanes[16][16] = {
+    {0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0, 1, 2, 3, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {4, 5, 6, 7, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0, 1, 2, 3, 4, 5, 6, 7, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {8, 9, 10, 11, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0, 1, 2, 3, 8, 9, 10, 11, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {4, 5, 6, 7, 8, 9, 10, 11, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 0x80, 0x80, 0x80, 0x80},
+    {12, 13, 14, 15, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0, 1, 2, 3, 12, 13, 14, 15, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {4, 5, 6, 7, 12, 13, 14, 15, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0, 1, 2, 3, 4, 5, 6, 7, 12, 13, 14, 15, 0x80, 0x80, 0x80, 0x80},
+    {8, 9, 10, 11, 12, 13, 14, 15, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80},
+    {0, 1, 2, 3, 8, 9, 10, 11, 12, 13, 14, 15, 0x80, 0x80, 0x80, 0x80},
+    {4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 0x80, 0x80, 0x80, 0x80},
+    {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15}
+};
+
+/* Number of lanes a 4 bit mask picks */
+static const int laneCount[16] = {0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4};
+
+#endif
+
+/* Kernel intersectSorted runs, picked by pickKernel */
+static IntersectFunc bestKernel = NULL;
+
+/********************************
+ *      3. Helper Functions     *
+ ********************************/
+
+/* gallop
+ *
+ * Finds the first number of a list that is not below x, galloping
+ * forward from a position, then bisecting.
+ *
+ * @param   b           list, ascending
+ * @param   nb          its length
+ * @param   j           position to start from
+ * @param   x           number to look for
+ *
+ * @return  int         position, nb if every number is below x
+ */
+
+int gallop(const int *b, int nb, int j, int x)
+{
+    int low, high, mid, step;
+    
+    low = j;
+    high = j;
+    step = 1;
+    
+    while(high < nb && b[high] < x)
+    {
+        low = high + 1;
+        high += step;
+        step *= 2;
+    }
+    
+    if(high > nb)
+    {
+        high = nb;
+    }
+    
+    while(low < high)
+    {
+        mid = low + (high - low) / 2;
+        
+        if(b[mid] < x)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+    
+    return low;
+}
+
+/* skipBlocks
+ *
+ * Skips the whole blocks of a list that end below x, galloping over
+ * the last number of each block, then bisecting.
+ *
+ * @param   b           list, ascending
+ * @param   nb          its length
+ * @param   j           start of the current block
+ * @param   x           number to look for
+ * @param   block       numbers in a block
+ *
+ * @return  int         start of the first block that ends at or past
+ *                      x, or of the partial block at the end
+ */
+
+int skipBlocks(const int *b, int nb, int j, int x, int block)
+{
+    int low, high, mid, n;
+    
+    n = (nb - j) / block;
+    if(n == 0 || b[j + block - 1] >= x)
+    {
+        return j;
+    }
+    
+    /* Block low ends below x, block high (if there is one) does not */
+    low = 0;
+    high = 1;
+    
+    while(high < n && b[j + high * block + block - 1] < x)
+    {
+        low = high;
+        high *= 2;
+    }
+    
+    if(high > n)
+    {
+        high = n;
+    }
+    
+    while(low + 1 < high)
+    {
+        mid = low + (high - low) / 2;
+        
+        if(b[j + mid * block + block - 1] < x)
+        {
+            low = mid;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+    
+    return j + high * block;
+}
+
+#if INTERSECT_SIMD
+
+/* intersectSSE
+ *
+ * SSE4.2 kernel. Lists of about the same length are compared four
+ * numbers against four at a time, every rotation of one block
+ * against the other, and the matches packed with one shuffle. A
+ * much shorter list has each of its numbers compared against
+ * blocks of sixteen of the longer one, after skipping the blocks
+ * that end below it.
+ *
+ * @param   a           first list, ascending
+ * @param   na          its length
+ * @param   b           second list, ascending
+ * @param   nb          its length
+ * @param   out         where to write the common numbers
+ *
+ * @return  int         number of common numbers
+ */
+
+__attribute__((target("sse4.2")))
+int intersectSSE(const int *a, int na, const int *b, int nb, int *out)
+{
+    __m128i va, vb, match;
+    const int *t;
+    int i, j, k, mask, amax, bmax;
+    
+    if(na > nb)
+    {
+        t = a;
+        a = b;
+        b = t;
+        i = na;
+        na = nb;
+        nb = i;
+    }
+    
+    i = 0;
+    j = 0;
+    k = 0;
+    
+    if((long) na * SKEW_RATIO <= nb)
+    {
+        for(; i < na; i++)
+        {
+            j = skipBlocks(b, nb, j, a[i], 16);
+            if(j + 16 > nb)
+            {
+                break;
+            }
+            
+            va = _mm_set1_epi32(a[i]);
+            match = _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi32(va, _mm_loadu_si128((const __m128i*) (b + j))),
+                             _mm_cmpeq_epi32(va, _mm_loadu_si128((const __m128i*) (b + j + 4)))),
+                _mm_or_si128(_mm_cmpeq_epi32(va, _mm_loadu_si128((const __m128i*) (b + j + 8))),
+                             _mm_cmpeq_epi32(va, _mm_loadu_si128((const __m128i*) (b + j + 12)))));
+            
+            if(_mm_movemask_epi8(match) != 0)
+            {
+                out[k] = a[i];
+                k++;
+            }
+        }
+    }
+    else
+    {
+        while(i + 4 <= na && j + 4 <= nb)
+        {
+            va = _mm_loadu_si128((const __m128i*) (a + i));
+            vb = _mm_loadu_si128((const __m128i*) (b + j));
+            
+            match = _mm_or_si128(
+                _mm_or_si128(_mm_cmpeq_epi32(va, vb),
+                             _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(0, 3, 2, 1)))),
+                _mm_or_si128(_mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(1, 0, 3, 2))),
+                             _mm_cmpeq_epi32(va, _mm_shuffle_epi32(vb, _MM_SHUFFLE(2, 1, 0, 3)))));
+            
+            mask = _mm_movemask_ps(_mm_castsi128_ps(match));
+            _mm_storeu_si128((__m128i*) (out + k), _mm_shuffle_epi8(va, _mm_loadu_si128((const __m128i*) packLanes[mask])));
+            k += laneCount[mask];
+            
+            /* Move on whichever block ends first, or both */
+            amax = a[i + 3];
+            bmax = b[j + 3];
+            
+            if(amax <= bmax)
+            {
+                i += 4;
+            }
+            if(bmax <= amax)
+            {
+                j += 4;
+            }
+        }
+    }
+    
+    /* Whatever does not fill a block is left to the reference kernel */
+    return k + intersectScalar(a + i, na - i, b + j, nb - j, out + k);
+}
+
+/* intersectAVX2
+ *
+ * AVX2 kernel, intersectSSE with twice the lanes: blocks of eight
+ * against eight (every rotation, through a lane permute) for lists
+ * of about the same length, and blocks of thirty two for a much
+ * shorter list.
+ *
+ * @param   a           first list, ascending
+ * @param   na          its length
+ * @param   b           second list, ascending
+ * @param   nb          its length
+ * @param   out         where to write the common numbers
+ *
+ * @return  int         number of common numbers
+ */
+
+__attribute__((target("avx2")))
+int intersectAVX2(const int *a, int na, const int *b, int nb, int *out)
+{
+    __m256i va, vb, match, rot;
+    __m128i half;
+    const int *t;
+    int i, j, k, r, mask, amax, bmax;
+    
+    if(na > nb)
+    {
+        t = a;
+        a = b;
+        b = t;
+        i = na;
+        na = nb;
+        nb = i;
+    }
+    
+    i = 0;
+    j = 0;
+    k = 0;
+    
+    if((long) na * SKEW_RATIO <= nb)
+    {
+        for(; i < na; i++)
+        {
+            j = skipBlocks(b, nb, j, a[i], 32);
+            if(j + 32 > nb)
+            {
+                break;
+            }
+            
+            va = _mm256_set1_epi32(a[i]);
+            match = _mm256_or_si256(
+                _mm256_or_si256(_mm256_cmpeq_epi32(va, _mm256_loadu_si256((const __m256i*) (b + j))),
+                                _mm256_cmpeq_epi32(va, _mm256_loadu_si256((const __m256i*) (b + j + 8)))),
+                _mm256_or_si256(_mm256_cmpeq_epi32(va, _mm256_loadu_si256((const __m256i*) (b + j + 16))),
+                                _mm256_cmpeq_epi32(va, _mm256_loadu_si256((const __m256i*) (b + j + 24)))));
+            
+            if(_mm256_movemask_epi8(match) != 0)
+            {
+                out[k] = a[i];
+                k++;
+            }
+        }
+    }
+    else
+    {
+        while(i + 8 <= na && j + 8 <= nb)
+        {
+            va = _mm256_loadu_si256((const __m256i*) (a + i));
+            vb = _mm256_loadu_si256((const __m256i*) (b + j));
+            
+            /* Every rotation of the b block against the a block */
+            match = _mm256_cmpeq_epi32(va, vb);
+            rot = _mm256_setr_epi32(1, 2, 3, 4, 5, 6, 7, 0);
+            
+            for(r = 1; r < 8; r++)
+            {
+                vb = _mm256_permutevar8x32_epi32(vb, rot);
+                match = _mm256_or_si256(match, _mm256_cmpeq_epi32(va, vb));
+            }
+            
+            mask = _mm256_movemask_ps(_mm256_castsi256_ps(match));
+            
+            /* Pack each half with the SSE table */
+            half = _mm256_castsi256_si128(va);
+            _mm_storeu_si128((__m128i*) (out + k), _mm_shuffle_epi8(half, _mm_loadu_si128((const __m128i*) packLanes[mask & 15])));
+            k += laneCount[mask & 15];
+            
+            half = _mm256_extracti128_si256(va, 1);
+            _mm_storeu_si128((__m128i*) (out + k), _mm_shuffle_epi8(half, _mm_loadu_si128((const __m128i*) packLanes[mask >> 4])));
+            k += laneCount[mask >> 4];
+            
+            amax = a[i + 7];
+            bmax = b[j + 7];
+            
+            if(amax <= bmax)
+            {
+                i += 8;
+            }
+            if(bmax <= amax)
+            {
+                j += 8;
+            }
+        }
+    }
+    
+    return k + intersectScalar(a + i, na - i, b + j, nb - j, out + k);
+}
+
+#endif
+
+/********************************
+ *    4. Intersect Functions    *
+ ********************************/
+
+/* simdLevel
+ *
+ * Finds the best instruction set the processor running us has,
+ * and that the kernels were compiled for.
+ *
+ * @return  int             SIMD_SCALAR, SIMD_SSE or SIMD_AVX2
+ */
+
+int simdLevel(void)
+{
+#if INTERSECT_SIMD
+    if(__builtin_cpu_supports("avx2"))
+    {
+        return SIMD_AVX2;
+    }
+    
+    if(__builtin_cpu_supports("sse4.2"))
+    {
+        return SIMD_SSE;
+    }
+#endif
+    
+    return SIMD_SCALAR;
+}
+
+/* intersectKernel
+ *
+ * @param   level           SIMD_SCALAR, SIMD_SSE or SIMD_AVX2
+ *
+ * @return  success         the kernel for that instruction set
+ * @return  failure         NULL, if the processor lacks it
+ */
+
+IntersectFunc intersectKernel(int level)
+{
+    if(level > simdLevel())
+    {
+        return NULL;
+    }
+    
+    switch(level)
+    {
+        case SIMD_SCALAR:
+            return intersectScalar;
+    
+#if INTERSECT_SIMD
+        case SIMD_SSE:
+            return intersectSSE;
+        
+        case SIMD_AVX2:
+            return intersectAVX2;
+#endif
+    }
+    
+    return NULL;
+}
+
+/* intersectScalar
+ *
+ * The reference kernel: merges the two lists, or when one is
+ * SKEW_RATIO times longer gallops through it for every number of
+ * the shorter one. Every other kernel has to give the same output.
+ *
+ * @param   a               first list, ascending
+ * @param   na              its length
+ * @param   b               second list, ascending
+ * @param   nb              its length
+ * @param   out             where to write the common numbers
+ *
+ * @return  int             number of common numbers
+ */
+
+int intersectScalar(const int *a, int na, const int *b, int nb, int *out)
+{
+    const int *t;
+    int i, j, k;
+    
+    if(na > nb)
+    {
+        t = a;
+        a = b;
+        b = t;
+        i = na;
+        na = nb;
+        nb = i;
+    }
+    
+    i = 0;
+    j = 0;
+    k = 0;
+    
+    if((long) na * SKEW_RATIO <= nb)
+    {
+        for(; i < na && j < nb; i++)
+        {
+            j = gallop(b, nb, j, a[i]);
+            if(j < nb && b[j] == a[i])
+            {
+                out[k] = a[i];
+                k++;
+            }
+        }
+        
+        return k;
+    }
+    
+    while(i < na && j < nb)
+    {
+        if(a[i] < b[j])
+        {
+            i++;
+        }
+        else if(a[i] > b[j])
+        {
+            j++;
+        }
+        else
+        {
+            out[k] = a[i];
+            k++;
+            i++;
+            j++;
+        }
+    }
+    
+    return k;
+}
+
+/* pickKernel
+ *
+ * Picks the kernel intersectSorted runs. It does so itself on its
+ * first call, a program that intersects from several threads picks
+ * it up front so they never race to.
+ *
+ * @return  void
+ */
+
+void pickKernel(void)
+{
+    bestKernel = intersectKernel(simdLevel());
+}
+
+/* intersectSorted
+ *
+ * Intersects two lists with the best kernel for this processor
+ * (see simdLevel).
+ *
+ * @param   a               first list, ascending
+ * @param   na              its length
+ * @param   b               second list, ascending
+ * @param   nb              its length
+ * @param   out             where to write the common numbers, room
+ *                          for the shorter list plus INTERSECT_SLACK
+ *
+ * @return  int             number of common numbers
+ */
+
+int intersectSorted(const int *a, int na, const int *b, int nb, int *out)
+{
+    /* The processor does not change, ask once */
+    if(bestKernel == NULL)
+    {
+        pickKernel();
+    }
+    
+    return bestKernel(a, na, b, nb, out);
+}
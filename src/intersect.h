@@ -0,0 +1,125 @@
+/*
+ * File: intersect.h
+ *
+ * Author: Mike Swift
+ * Email: theycallmeswift@gmail.com
+ * Date Created: May 15th, 2011
+ * Date Modified: May 15th, 2011
+ */
+
+#ifndef SWIFT_INTERSECT_H_
+#define SWIFT_INTERSECT_H_
+
+/********************************
+ *          1. Includes         *
+ ********************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/********************************
+ *          2. Constants        *
+ ********************************/
+
+/* The vector kernels need GCC's target attributes on x86 */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define INTERSECT_SIMD 1
+#else
+#define INTERSECT_SIMD 0
+#endif
+
+/* Instruction sets an intersection kernel can use */
+#define SIMD_SCALAR 0
+#define SIMD_SSE 1
+#define SIMD_AVX2 2
+
+/* Lists this many times longer than the other are probed, not merged */
+#define SKEW_RATIO 32
+
+/* Room out needs past the shorter list, vector kernels store whole blocks */
+#define INTERSECT_SLACK 8
+
+/********************************
+ *      3. Structs & Typedefs   *
+ ********************************/
+
+/* IntersectFunc
+ *
+ * An intersection kernel: writes the numbers found in both of two
+ * ascending lists (without repeats) to out, ascending, and returns
+ * how many there are. out needs room for the shorter list plus
+ * INTERSECT_SLACK, and cannot be a or b.
+ */
+
+typedef int (*IntersectFunc)(const int *a, int na, const int *b, int nb, int *out);
+
+/********************************
+ *    4. Intersect Functions    *
+ ********************************/
+
+/* simdLevel
+ *
+ * Finds the best instruction set the processor running us has,
+ * and that the kernels were compiled for.
+ *
+ * @return  int             SIMD_SCALAR, SIMD_SSE or SIMD_AVX2
+ */
+
+int simdLevel(void);
+
+/* intersectKernel
+ *
+ * @param   level           SIMD_SCALAR, SIMD_SSE or SIMD_AVX2
+ *
+ * @return  success         the kernel for that instruction set
+ * @return  failure         NULL, if the processor lacks it
+ */
+
+IntersectFunc intersectKernel(int level);
+
+/* intersectScalar
+ *
+ * The reference kernel: merges the two lists, or when one is
+ * SKEW_RATIO times longer gallops through it for every number of
+ * the shorter one. Every other kernel has to give the same output.
+ *
+ * @param   a               first list, ascending
+ * @param   na              its length
+ * @param   b               second list, ascending
+ * @param   nb              its length
+ * @param   out             where to write the common numbers
+ *
+ * @return  int             number of common numbers
+ */
+
+int intersectScalar(const int *a, int na, const int *b, int nb, int *out);
+
+/* pickKernel
+ *
+ * Picks the kernel intersectSorted runs. It does so itself on its
+ * first call, a program that intersects from several threads picks
+ * it up front so they never race to.
+ *
+ * @return  void
+ */
+
+void pickKernel(void);
+
+/* intersectSorted
+ *
+ * Intersects two lists with the best kernel for this processor
+ * (see simdLevel).
+ *
+ * @param   a               first list, ascending
+ * @param   na              its length
+ * @param   b               second list, ascending
+ * @param   nb              its length
+ * @param   out             where to write the common numbers, room
+ *                          for the shorter list plus INTERSECT_SLACK
+ *
+ * @return  int             number of common numbers
+ */
+
+int intersectSorted(const int *a, int na, const int *b, int nb, int *out);
+
+#endif /* SWIFT_INTERSECT_H_ */
@@ -0,0 +1,950 @@
+/*
+ * File: lexicon.c
+ *
+ * Author: Mike Swift
+ * Email: theycallmeswift@gmail.com
+ * Date Created: May 13th, 2011
+ * Date Modified: May 13th, 2011
+ */
+
+/********************************
+ *          1. Includes         *
+ ********************************/
+
+#include "lexicon.h"
+
+/********************************
+ *          2. Structs          *
+ ********************************/
+
+/* Lexicon_
+ *
+ * @param   strings     every term, '\0' terminated, back to back
+ * @param   used        bytes of strings in use
+ * @param   size        bytes of strings allocated
+ * @param   terms       offset of each term in strings
+ * @param   df          number of files holding each term
+ * @param   offsets     offset of each term's <list> in the index
+ * @param   blocks      offset of each term's block summary
+ * @param   impacts     offset of each term's impact list
+ * @param   containers  offset of each term's containers
+ * @param   packed      offset of each term's packed postings
+ * @param   count       number of terms
+ * @param   capacity    number of terms there is room for
+ * @param   hash        minimal perfect hash of the terms, NULL if
+ *                      there is none
+ */
+
+struct Lexicon_ {
+    char *strings;
+    size_t used;
+    size_t size;
+    size_t *terms;
+    int *df;
+    long *offsets;
+    long *blocks;
+    long *impacts;
+    long *containers;
+    long *packed;
+    int count;
+    int capacity;
+    Mphf hash;
+};
+
+/********************************
+ *      3. Helper Functions     *
+ ********************************/
+
+/* growLexicon
+ *
+ * Makes sure the lexicon has room for one more term of len bytes.
+ *
+ * @param   lex         lexicon
+ * @param   len         length of the term, '\0' included
+ *
+ * @return  success     1
+ * @return  failure     0
+ */
+
+int growLexicon(Lexicon lex, size_t len)
+{
+    char *strings;
+    size_t *terms;
+    int *df;
+    long *offsets, *blocks, *impacts, *containers, *packed;
+    size_t size;
+    
+    if(lex->used + len > lex->size)
+    {
+        size = lex->size;
+        while(lex->used + len > size)
+        {
+            size *= 2;
+        }
+        
+        strings = (char*) realloc(lex->strings, size);
+        if(strings == NULL)
+        {
+            return 0;
+        }
+        lex->strings = strings;
+        lex->size = size;
+    }
+    
+    if(lex->count == lex->capacity)
+    {
+        terms = (size_t*) realloc(lex->terms, sizeof(size_t) * lex->capacity * 2);
+        if(terms == NULL)
+        {
+            return 0;
+        }
+        lex->terms = terms;
+        
+        df = (int*) realloc(lex->df, sizeof(int) * lex->capacity * 2);
+        if(df == NULL)
+        {
+            return 0;
+        }
+        lex->df = df;
+        
+        offsets = (long*) realloc(lex->offsets, sizeof(long) * lex->capacity * 2);
+        if(offsets == NULL)
+        {
+            return 0;
+        }
+        lex->offsets = offsets;
+        
+        blocks = (long*) realloc(lex->blocks, sizeof(long) * lex->capacity * 2);
+        if(blocks == NULL)
+        {
+            return 0;
+        }
+        lex->blocks = blocks;
+        
+        impacts = (long*) realloc(lex->impacts, sizeof(long) * lex->capacity * 2);
+        if(impacts == NULL)
+        {
+            return 0;
+        }
+        lex->impacts = impacts;
+        
+        containers = (long*) realloc(lex->containers, sizeof(long) * lex->capacity * 2);
+        if(containers == NULL)
+        {
+            return 0;
+        }
+        lex->containers = containers;
+        
+        packed = (long*) realloc(lex->packed, sizeof(long) * lex->capacity * 2);
+        if(packed == NULL)
+        {
+            return 0;
+        }
+        lex->packed = packed;
+        
+        lex->capacity *= 2;
+    }
+    
+    return 1;
+}
+
+/* lowerBound
+ *
+ * Binary search for the first term that is not smaller than key
+ * when only the first n characters are compared.
+ *
+ * @param   lex         lexicon
+ * @param   key         key to look for
+ * @param   n           characters to compare
+ * @param   upper       0 for the first term >= key, 1 for the first
+ *                      term > key
+ *
+ * @return  int         term number (count if there is none)
+ */
+
+int lowerBound(Lexicon lex, char *key, size_t n, int upper)
+{
+    int low, high, mid, res;
+    
+    low = 0;
+    high = lex->count;
+    
+    while(low < high)
+    {
+        mid = low + (high - low) / 2;
+        res = strncmp(lex->strings + lex->terms[mid], key, n);
+        
+        if(res < 0 || (upper && res == 0))
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+    
+    return low;
+}
+
+/* rarerTerm
+ *
+ * Order the expansions of a query word are dropped in: fewer
+ * files first, and of terms in as many files the later one in
+ * the index. The terms kept are then the same whichever order
+ * they are offered in, which lets a sharded index choose them
+ * with the counts of the whole index (see chooseExpansions).
+ *
+ * @param   lex         lexicon
+ * @param   a           term number
+ * @param   b           another term number
+ *
+ * @return  a first     1
+ * @return  b first     0
+ */
+
+int rarerTerm(Lexicon lex, int a, int b)
+{
+    int dfa, dfb;
+    
+    dfa = lexiconFrequency(lex, a);
+    dfb = lexiconFrequency(lex, b);
+    
+    return dfa < dfb || (dfa == dfb && a > b);
+}
+
+/* keepFrequent
+ *
+ * Offers a term to the expansions of a query word. The expansions
+ * are a min-heap in the order of rarerTerm, so once max terms are
+ * kept a new one only gets in by pushing out the rarest.
+ *
+ * @param   lex         lexicon
+ * @param   heap        term numbers kept so far
+ * @param   count       number of terms kept (updated)
+ * @param   max         most terms to keep
+ * @param   term        term number to offer
+ *
+ * @return  void
+ */
+
+void keepFrequent(Lexicon lex, int *heap, int *count, int max, int term)
+{
+    int i, child, tmp;
+    
+    if(*count < max)
+    {
+        /* Sift up */
+        i = *count;
+        heap[i] = term;
+        (*count)++;
+        
+        while(i > 0 && rarerTerm(lex, heap[i], heap[(i - 1) / 2]))
+        {
+            tmp = heap[i];
+            heap[i] = heap[(i - 1) / 2];
+            heap[(i - 1) / 2] = tmp;
+            i = (i - 1) / 2;
+        }
+        
+        return;
+    }
+    
+    if(rarerTerm(lex, term, heap[0]))
+    {
+        return;
+    }
+    
+    /* Replace the rarest and sift down */
+    heap[0] = term;
+    i = 0;
+    
+    while((child = 2 * i + 1) < *count)
+    {
+        if(child + 1 < *count && rarerTerm(lex, heap[child + 1], heap[child]))
+        {
+            child++;
+        }
+        
+        if(rarerTerm(lex, heap[i], heap[child]))
+        {
+            break;
+        }
+        
+        tmp = heap[i];
+        heap[i] = heap[child];
+        heap[child] = tmp;
+        i = child;
+    }
+}
+
+/* compTermNumbers
+ *
+ * qsort comparator for term numbers, ascending (which is also
+ * the order of the terms in the index).
+ *
+ * @param   ptr1        first term number
+ * @param   ptr2        second term number
+ *
+ * @return  int         <0, 0 or >0
+ */
+
+int compTermNumbers(const void *ptr1, const void *ptr2)
+{
+    return *((int*) ptr1) - *((int*) ptr2);
+}
+
+/* nextRow
+ *
+ * One step of the Levenshtein automaton: the row of edit distances
+ * after one more character of a lexicon term, computed from the
+ * row before it.
+ *
+ * @param   term        query term
+ * @param   m           length of term
+ * @param   prev        row for the characters so far
+ * @param   row         where to store the new row
+ * @param   c           next character of the lexicon term
+ *
+ * @return  int         smallest distance in the new row
+ */
+
+int nextRow(char *term, int m, int *prev, int *row, char c)
+{
+    int j, best, cost;
+    
+    row[0] = prev[0] + 1;
+    best = row[0];
+    
+    for(j = 1; j <= m; j++)
+    {
+        cost = (term[j - 1] == c) ? 0 : 1;
+        
+        row[j] = prev[j - 1] + cost;
+        if(prev[j] + 1 < row[j])
+        {
+            row[j] = prev[j] + 1;
+        }
+        if(row[j - 1] + 1 < row[j])
+        {
+            row[j] = row[j - 1] + 1;
+        }
+        
+        if(row[j] < best)
+        {
+            best = row[j];
+        }
+    }
+    
+    return best;
+}
+
+/* skipPrefix
+ *
+ * Finds the first term after term i that does not start with the
+ * first n characters of term i. Subtrees deep in the lexicon are
+ * small, so the search gallops forward from i before it bisects
+ * and stays close to i in memory.
+ *
+ * @param   lex         lexicon
+ * @param   i           term number
+ * @param   n           length of the prefix
+ *
+ * @return  int         term number (count if there is none)
+ */
+
+int skipPrefix(Lexicon lex, int i, int n)
+{
+    char *prefix;
+    int low, high, mid, step;
+    
+    prefix = lex->strings + lex->terms[i];
+    
+    /* Gallop until a term past the prefix is found */
+    low = i;
+    step = 1;
+    
+    while(1)
+    {
+        high = low + step;
+        if(high >= lex->count)
+        {
+            high = lex->count;
+            break;
+        }
+        
+        if(strncmp(lex->strings + lex->terms[high], prefix, n) != 0)
+        {
+            break;
+        }
+        
+        low = high;
+        step *= 2;
+    }
+    
+    /* low starts with the prefix and high does not (or is the end) */
+    while(high - low > 1)
+    {
+        mid = low + (high - low) / 2;
+        
+        if(strncmp(lex->strings + lex->terms[mid], prefix, n) == 0)
+        {
+            low = mid;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+    
+    return high;
+}
+
+/********************************
+ *      4. Lexicon Functions    *
+ ********************************/
+
+/* writeLexiconEntry
+ *
+ * Writes one line of the lexicon stream that sits next to an
+ * inverted index:
+ *
+ *      term #files offset blocks impacts containers packed
+ *
+ * offset is where the term's <list> starts in the index, blocks
+ * where its block summary starts (see writeBlockMaxima), impacts
+ * where its impact ordered list starts (see writeImpacts, -1 when
+ * the index has none), containers where its file set starts (see
+ * writeContainers, -1 unless the term is common) and packed where
+ * its binary postings start (see writePacked). Terms must be
+ * written in the same (sorted) order as the index.
+ *
+ * @param   lexicon         lexicon stream
+ * @param   word            word about to be written to the index
+ * @param   offset          position of the word's <list> header
+ * @param   blocks          position of the word's block summary
+ * @param   impacts         position of the word's impact list, or -1
+ * @param   containers      position of the word's containers, or -1
+ * @param   packed          position of the word's packed postings
+ *
+ * @return  success         1
+ * @return  failure         0
+ */
+
+int writeLexiconEntry(FILE *lexicon, Word word, long offset, long blocks, long impacts, long containers, long packed)
+{
+    if(lexicon == NULL || word == NULL)
+    {
+        fprintf(stderr, "Error: Cannot write NULL word to lexicon.\n");
+        return 0;
+    }
+    
+    if(fprintf(lexicon, "%s %i %li %li %li %li %li\n", word->word, word->numFiles, offset, blocks, impacts, containers, packed) < 0)
+    {
+        fprintf(stderr, "Error: Could not write to lexicon.\n");
+        return 0;
+    }
+    
+    return 1;
+}
+
+/* loadLexicon
+ *
+ * Loads the lexicon of an inverted index into memory: every term
+ * in sorted order, with its document frequency, the offset of its
+ * <list> in the index, of its block summary, of its impact list,
+ * of its containers and of its packed postings (-1 for lexicons
+ * written before there were any). All the terms share one buffer.
+ * The minimal perfect hash of the terms comes with it, if the
+ * index has one (see writeMphf).
+ *
+ * @param   index           name of the inverted index
+ *
+ * @return  success         new Lexicon
+ * @return  no lexicon      NULL
+ */
+
+Lexicon loadLexicon(char *index)
+{
+    Lexicon lex;
+    FILE *file;
+    char line[LEXICON_LINE_SIZE], *space;
+    size_t len;
+    int df, n;
+    long offset, blocks, impacts, containers, packed;
+    
+    file = openSidecar(index, LEXICON_SUFFIX, "r");
+    if(file == NULL)
+    {
+        return NULL;
+    }
+    
+    lex = (Lexicon) malloc(sizeof(struct Lexicon_));
+    if(lex == NULL)
+    {
+        fprintf(stderr, "Error: Could not allocate space for lexicon.\n");
+        fclose(file);
+        return NULL;
+    }
+    
+    lex->strings = (char*) malloc(LEXICON_SIZE * 8);
+    lex->terms = (size_t*) malloc(sizeof(size_t) * LEXICON_SIZE);
+    lex->df = (int*) malloc(sizeof(int) * LEXICON_SIZE);
+    lex->offsets = (long*) malloc(sizeof(long) * LEXICON_SIZE);
+    lex->blocks = (long*) malloc(sizeof(long) * LEXICON_SIZE);
+    lex->impacts = (long*) malloc(sizeof(long) * LEXICON_SIZE);
+    lex->containers = (long*) malloc(sizeof(long) * LEXICON_SIZE);
+    lex->packed = (long*) malloc(sizeof(long) * LEXICON_SIZE);
+    lex->used = 0;
+    lex->size = LEXICON_SIZE * 8;
+    lex->count = 0;
+    lex->capacity = LEXICON_SIZE;
+    lex->hash = NULL;
+    
+    if(lex->strings == NULL || lex->terms == NULL || lex->df == NULL || lex->offsets == NULL || lex->blocks == NULL || lex->impacts == NULL || lex->containers == NULL || lex->packed == NULL)
+    {
+        fprintf(stderr, "Error: Could not allocate space for lexicon.\n");
+        destroyLexicon(lex);
+        fclose(file);
+        return NULL;
+    }
+    
+    while(fgets(line, LEXICON_LINE_SIZE, file) != NULL)
+    {
+        /* term #files offset [blocks impacts containers packed], the term never holds a space */
+        space = strchr(line, ' ');
+        blocks = -1;
+        impacts = -1;
+        containers = -1;
+        packed = -1;
+        n = (space == NULL) ? 0 : sscanf(space + 1, "%d %ld %ld %ld %ld %ld", &df, &offset, &blocks, &impacts, &containers, &packed);
+        if(n < 2)
+        {
+            fprintf(stderr, "Error: Malformed lexicon file.\n");
+            destroyLexicon(lex);
+            fclose(file);
+            return NULL;
+        }
+        *space = '\0';
+        len = space - line + 1;
+        
+        if(growLexicon(lex, len) == 0)
+        {
+            fprintf(stderr, "Error: Could not allocate space for lexicon.\n");
+            destroyLexicon(lex);
+            fclose(file);
+            return NULL;
+        }
+        
+        memcpy(lex->strings + lex->used, line, len);
+        lex->terms[lex->count] = lex->used;
+        lex->df[lex->count] = df;
+        lex->offsets[lex->count] = offset;
+        lex->blocks[lex->count] = blocks;
+        lex->impacts[lex->count] = impacts;
+        lex->containers[lex->count] = containers;
+        lex->packed[lex->count] = packed;
+        lex->used += len;
+        lex->count++;
+    }
+    
+    fclose(file);
+    
+    /* Without a hash terms are found with a binary search */
+    lex->hash = loadMphf(index, lex->count);
+    
+    return lex;
+}
+
+/* destroyLexicon
+ *
+ * Frees a lexicon. NULL is ignored.
+ *
+ * @param   lex             lexicon to destroy
+ *
+ * @return  void
+ */
+
+void destroyLexicon(Lexicon lex)
+{
+    if(lex != NULL)
+    {
+        free(lex->strings);
+        free(lex->terms);
+        free(lex->df);
+        free(lex->offsets);
+        free(lex->blocks);
+        free(lex->impacts);
+        free(lex->containers);
+        free(lex->packed);
+        destroyMphf(lex->hash);
+        free(lex);
+    }
+}
+
+/* lexiconSize
+ *
+ * @param   lex             lexicon
+ *
+ * @return  int             number of terms
+ */
+
+int lexiconSize(Lexicon lex)
+{
+    return lex->count;
+}
+
+/* lexiconTerm
+ *
+ * @param   lex             lexicon
+ * @param   i               term number
+ *
+ * @return  char*           the i-th term
+ */
+
+char *lexiconTerm(Lexicon lex, int i)
+{
+    return lex->strings + lex->terms[i];
+}
+
+/* lexiconFrequency
+ *
+ * @param   lex             lexicon
+ * @param   i               term number
+ *
+ * @return  int             number of files holding the i-th term
+ */
+
+int lexiconFrequency(Lexicon lex, int i)
+{
+    return lex->df[i];
+}
+
+/* lexiconOffset
+ *
+ * @param   lex             lexicon
+ * @param   i               term number
+ *
+ * @return  long            offset of the i-th term's <list>
+ */
+
+long lexiconOffset(Lexicon lex, int i)
+{
+    return lex->offsets[i];
+}
+
+/* lexiconBlocks
+ *
+ * @param   lex             lexicon
+ * @param   i               term number
+ *
+ * @return  long            offset of the i-th term's block summary,
+ *                          -1 if there is none
+ */
+
+long lexiconBlocks(Lexicon lex, int i)
+{
+    return lex->blocks[i];
+}
+
+/* lexiconImpacts
+ *
+ * @param   lex             lexicon
+ * @param   i               term number
+ *
+ * @return  long            offset of the i-th term's impact list,
+ *                          -1 if there is none
+ */
+
+long lexiconImpacts(Lexicon lex, int i)
+{
+    return lex->impacts[i];
+}
+
+/* lexiconContainers
+ *
+ * @param   lex             lexicon
+ * @param   i               term number
+ *
+ * @return  long            offset of the i-th term's containers, -1
+ *                          if there are none
+ */
+
+long lexiconContainers(Lexicon lex, int i)
+{
+    return lex->containers[i];
+}
+
+/* lexiconPacked
+ *
+ * @param   lex             lexicon
+ * @param   i               term number
+ *
+ * @return  long            offset of the i-th term's packed postings,
+ *                          -1 if there are none
+ */
+
+long lexiconPacked(Lexicon lex, int i)
+{
+    return lex->packed[i];
+}
+
+/* findTerm
+ *
+ * Finds a term through the lexicon's minimal perfect hash, which
+ * gives the only term it can be, or failing that with a binary
+ * search.
+ *
+ * @param   lex             lexicon
+ * @param   term            term to find
+ *
+ * @return  found           term number
+ * @return  not found       -1
+ */
+
+int findTerm(Lexicon lex, char *term)
+{
+    int i;
+    
+    /* Every other term gets some term's number too, so check it is the one */
+    if(lex->hash != NULL)
+    {
+        i = mphfLookup(lex->hash, term);
+        
+        return (i >= 0 && strcmp(lex->strings + lex->terms[i], term) == 0) ? i : -1;
+    }
+    
+    i = lowerBound(lex, term, strlen(term) + 1, 0);
+    
+    if(i < lex->count && strcmp(lex->strings + lex->terms[i], term) == 0)
+    {
+        return i;
+    }
+    
+    return -1;
+}
+
+/* findPrefix
+ *
+ * Finds the range of terms that start with a prefix with two
+ * binary searches, so the cost does not depend on how many terms
+ * match.
+ *
+ * @param   lex             lexicon
+ * @param   prefix          prefix (the empty string matches all)
+ * @param   last            where to store one past the last match
+ *
+ * @return  int             number of the first match
+ */
+
+int findPrefix(Lexicon lex, char *prefix, int *last)
+{
+    size_t len;
+    
+    len = strlen(prefix);
+    
+    *last = lowerBound(lex, prefix, len, 1);
+    
+    return lowerBound(lex, prefix, len, 0);
+}
+
+/* matchWildcard
+ *
+ * Matches a term against a pattern where '*' stands for any run of
+ * characters and '?' for exactly one.
+ *
+ * @param   pattern         wildcard pattern
+ * @param   term            term to test
+ *
+ * @return  match           1
+ * @return  no match        0
+ */
+
+int matchWildcard(char *pattern, char *term)
+{
+    char *star, *retry;
+    
+    star = NULL;
+    retry = NULL;
+    
+    while(*term != '\0')
+    {
+        if(*pattern == '*')
+        {
+            /* Try matching nothing first, come back if that fails */
+            star = ++pattern;
+            retry = term;
+        }
+        else if(*pattern == '?' || *pattern == *term)
+        {
+            pattern++;
+            term++;
+        }
+        else if(star != NULL)
+        {
+            pattern = star;
+            term = ++retry;
+        }
+        else
+        {
+            return 0;
+        }
+    }
+    
+    while(*pattern == '*')
+    {
+        pattern++;
+    }
+    
+    return *pattern == '\0';
+}
+
+/* expandWildcard
+ *
+ * Finds the terms that match a wildcard pattern (see matchWildcard).
+ * The literal prefix in front of the first wildcard narrows them
+ * down to one range (see findPrefix), the rest of the pattern is
+ * checked against each term in it. When more than max terms match,
+ * the ones in the most files are kept (see rarerTerm).
+ *
+ * @param   lex             lexicon
+ * @param   pattern         wildcard pattern
+ * @param   terms           where to store up to max term numbers,
+ *                          in index order
+ * @param   max             most terms to keep
+ *
+ * @return  int             number of terms kept
+ */
+
+int expandWildcard(Lexicon lex, char *pattern, int *terms, int max)
+{
+    char *prefix;
+    int first, last, i, len, count, prefixonly;
+    
+    /* Everything in front of the first wildcard is a literal prefix */
+    len = strcspn(pattern, WILDCARD_CHARS);
+    
+    prefix = (char*) malloc(len + 1);
+    if(prefix == NULL)
+    {
+        fprintf(stderr, "Error: Could not allocate space for prefix.\n");
+        return 0;
+    }
+    
+    memcpy(prefix, pattern, len);
+    prefix[len] = '\0';
+    
+    first = findPrefix(lex, prefix, &last);
+    free(prefix);
+    
+    /* "foo*" takes the whole range, anything else is checked per term */
+    prefixonly = (strcmp(pattern + len, "*") == 0);
+    count = 0;
+    
+    for(i = first; i < last; i++)
+    {
+        if(prefixonly || matchWildcard(pattern + len, lexiconTerm(lex, i) + len))
+        {
+            keepFrequent(lex, terms, &count, max, i);
+        }
+    }
+    
+    qsort(terms, count, sizeof(int), compTermNumbers);
+    
+    return count;
+}
+
+/* expandFuzzy
+ *
+ * Finds the terms within an edit distance of a query term. The
+ * sorted lexicon is walked as a trie: a Levenshtein automaton for
+ * the query term steps through one character at a time, terms
+ * sharing a prefix reuse its rows, and as soon as no row entry is
+ * within distance the whole subtree under that prefix is skipped
+ * by galloping past it (see skipPrefix). When more than max
+ * terms match, the ones in the most files are kept (see
+ * rarerTerm).
+ *
+ * @param   lex             lexicon
+ * @param   term            query term
+ * @param   distance        largest edit distance allowed
+ * @param   terms           where to store up to max term numbers,
+ *                          in index order
+ * @param   max             most terms to keep
+ *
+ * @return  success         number of terms kept
+ * @return  failure         -1
+ */
+
+int expandFuzzy(Lexicon lex, char *term, int distance, int *terms, int max)
+{
+    int *rows, *row, m, i, j, depth, shared, len, count, pruned;
+    char *path, *t;
+    
+    m = strlen(term);
+    
+    /* Past m + distance characters no row can be within distance */
+    rows = (int*) malloc(sizeof(int) * (m + 1) * (m + distance + 2));
+    if(rows == NULL)
+    {
+        fprintf(stderr, "Error: Could not allocate space for fuzzy match.\n");
+        return -1;
+    }
+    
+    for(j = 0; j <= m; j++)
+    {
+        rows[j] = j;
+    }
+    
+    path = "";
+    depth = 0;
+    count = 0;
+    i = 0;
+    
+    while(i < lex->count)
+    {
+        t = lex->strings + lex->terms[i];
+        len = strlen(t);
+        
+        /* Rows for the prefix this term shares with the last path still hold */
+        shared = 0;
+        while(shared < depth && path[shared] == t[shared])
+        {
+            shared++;
+        }
+        depth = shared;
+        path = t;
+        pruned = 0;
+        
+        while(depth < len)
+        {
+            row = rows + (depth + 1) * (m + 1);
+            
+            if(nextRow(term, m, row - (m + 1), row, t[depth]) > distance)
+            {
+                /* Nothing under t[0..depth] can match, skip all of it */
+                i = skipPrefix(lex, i, depth + 1);
+                depth++;
+                pruned = 1;
+                break;
+            }
+            
+            depth++;
+        }
+        
+        if(pruned == 0)
+        {
+            if(rows[len * (m + 1) + m] <= distance)
+            {
+                keepFrequent(lex, terms, &count, max, i);
+            }
+            i++;
+        }
+    }
+    
+    free(rows);
+    
+    qsort(terms, count, sizeof(int), compTermNumbers);
+    
+    return count;
+}
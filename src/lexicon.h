@@ -0,0 +1,277 @@
+/*
+ * File: lexicon.h
+ *
+ * Author: Mike Swift
+ * Email: theycallmeswift@gmail.com
+ * Date Created: May 13th, 2011
+ * Date Modified: May 13th, 2011
+ */
+
+#ifndef SWIFT_LEXICON_H_
+#define SWIFT_LEXICON_H_
+
+/********************************
+ *          1. Includes         *
+ ********************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mphf.h"
+#include "postings.h"
+#include "words.h"
+
+/********************************
+ *          2. Constants        *
+ ********************************/
+
+/* Text stream of "term #files offset blocks impacts containers packed" lines next to an inverted index */
+#define LEXICON_SUFFIX ".lex"
+
+/* Longest lexicon line (terms are at most one token long) */
+#define LEXICON_LINE_SIZE 2048
+
+/* Initial number of terms a lexicon has room for (grows as needed) */
+#define LEXICON_SIZE 1024
+
+/* Characters that make a query term a wildcard */
+#define WILDCARD_CHARS "*?"
+
+/********************************
+ *      3. Structs & Typedefs   *
+ ********************************/
+
+struct Lexicon_;
+typedef struct Lexicon_* Lexicon;
+
+/********************************
+ *      4. Lexicon Functions    *
+ ********************************/
+
+/* writeLexiconEntry
+ *
+ * Writes one line of the lexicon stream that sits next to an
+ * inverted index:
+ *
+ *      term #files offset blocks impacts containers packed
+ *
+ * offset is where the term's <list> starts in the index, blocks
+ * where its block summary starts (see writeBlockMaxima), impacts
+ * where its impact ordered list starts (see writeImpacts, -1 when
+ * the index has none), containers where its file set starts (see
+ * writeContainers, -1 unless the term is common) and packed where
+ * its binary postings start (see writePacked). Terms must be
+ * written in the same (sorted) order as the index.
+ *
+ * @param   lexicon         lexicon stream
+ * @param   word            word about to be written to the index
+ * @param   offset          position of the word's <list> header
+ * @param   blocks          position of the word's block summary
+ * @param   impacts         position of the word's impact list, or -1
+ * @param   containers      position of the word's containers, or -1
+ * @param   packed          position of the word's packed postings
+ *
+ * @return  success         1
+ * @return  failure         0
+ */
+
+int writeLexiconEntry(FILE *lexicon, Word word, long offset, long blocks, long impacts, long containers, long packed);
+
+/* loadLexicon
+ *
+ * Loads the lexicon of an inverted index into memory: every term
+ * in sorted order, with its document frequency, the offset of its
+ * <list> in the index, of its block summary, of its impact list,
+ * of its containers and of its packed postings (-1 for lexicons
+ * written before there were any). All the terms share one buffer.
+ * The minimal perfect hash of the terms comes with it, if the
+ * index has one (see writeMphf).
+ *
+ * @param   index           name of the inverted index
+ *
+ * @return  success         new Lexicon
+ * @return  no lexicon      NULL
+ */
+
+Lexicon loadLexicon(char *index);
+
+/* destroyLexicon
+ *
+ * Frees a lexicon. NULL is ignored.
+ *
+ * @param   lex             lexicon to destroy
+ *
+ * @return  void
+ */
+
+void destroyLexicon(Lexicon lex);
+
+/* lexiconSize
+ *
+ * @param   lex             lexicon
+ *
+ * @return  int             number of terms
+ */
+
+int lexiconSize(Lexicon lex);
+
+/* lexiconTerm
+ *
+ * @param   lex             lexicon
+ * @param   i               term number
+ *
+ * @return  char*           the i-th term
+ */
+
+char *lexiconTerm(Lexicon lex, int i);
+
+/* lexiconFrequency
+ *
+ * @param   lex             lexicon
+ * @param   i               term number
+ *
+ * @return  int             number of files holding the i-th term
+ */
+
+int lexiconFrequency(Lexicon lex, int i);
+
+/* lexiconOffset
+ *
+ * @param   lex             lexicon
+ * @param   i               term number
+ *
+ * @return  long            offset of the i-th term's <list>
+ */
+
+long lexiconOffset(Lexicon lex, int i);
+
+/* lexiconBlocks
+ *
+ * @param   lex             lexicon
+ * @param   i               term number
+ *
+ * @return  long            offset of the i-th term's block summary,
+ *                          -1 if there is none
+ */
+
+long lexiconBlocks(Lexicon lex, int i);
+
+/* lexiconImpacts
+ *
+ * @param   lex             lexicon
+ * @param   i               term number
+ *
+ * @return  long            offset of the i-th term's impact list,
+ *                          -1 if there is none
+ */
+
+long lexiconImpacts(Lexicon lex, int i);
+
+/* lexiconContainers
+ *
+ * @param   lex             lexicon
+ * @param   i               term number
+ *
+ * @return  long            offset of the i-th term's containers, -1
+ *                          if there are none
+ */
+
+long lexiconContainers(Lexicon lex, int i);
+
+/* lexiconPacked
+ *
+ * @param   lex             lexicon
+ * @param   i               term number
+ *
+ * @return  long            offset of the i-th term's packed postings,
+ *                          -1 if there are none
+ */
+
+long lexiconPacked(Lexicon lex, int i);
+
+/* findTerm
+ *
+ * Finds a term through the lexicon's minimal perfect hash, which
+ * gives the only term it can be, or failing that with a binary
+ * search.
+ *
+ * @param   lex             lexicon
+ * @param   term            term to find
+ *
+ * @return  found           term number
+ * @return  not found       -1
+ */
+
+int findTerm(Lexicon lex, char *term);
+
+/* findPrefix
+ *
+ * Finds the range of terms that start with a prefix with two
+ * binary searches, so the cost does not depend on how many terms
+ * match.
+ *
+ * @param   lex             lexicon
+ * @param   prefix          prefix (the empty string matches all)
+ * @param   last            where to store one past the last match
+ *
+ * @return  int             number of the first match
+ */
+
+int findPrefix(Lexicon lex, char *prefix, int *last);
+
+/* matchWildcard
+ *
+ * Matches a term against a pattern where '*' stands for any run of
+ * characters and '?' for exactly one.
+ *
+ * @param   pattern         wildcard pattern
+ * @param   term            term to test
+ *
+ * @return  match           1
+ * @return  no match        0
+ */
+
+int matchWildcard(char *pattern, char *term);
+
+/* expandWildcard
+ *
+ * Finds the terms that match a wildcard pattern (see matchWildcard).
+ * The literal prefix in front of the first wildcard narrows them
+ * down to one range (see findPrefix), the rest of the pattern is
+ * checked against each term in it. When more than max terms match,
+ * the ones in the most files are kept (see rarerTerm).
+ *
+ * @param   lex             lexicon
+ * @param   pattern         wildcard pattern
+ * @param   terms           where to store up to max term numbers,
+ *                          in index order
+ * @param   max             most terms to keep
+ *
+ * @return  int             number of terms kept
+ */
+
+int expandWildcard(Lexicon lex, char *pattern, int *terms, int max);
+
+/* expandFuzzy
+ *
+ * Finds the terms within an edit distance of a query term. The
+ * sorted lexicon is walked as a trie: a Levenshtein automaton for
+ * the query term steps through one character at a time, terms
+ * sharing a prefix reuse its rows, and as soon as no row entry is
+ * within distance the whole subtree under that prefix is skipped
+ * by galloping past it. When more than max terms match, the ones
+ * in the most files are kept (see rarerTerm).
+ *
+ * @param   lex             lexicon
+ * @param   term            query term
+ * @param   distance        largest edit distance allowed
+ * @param   terms           where to store up to max term numbers,
+ *                          in index order
+ * @param   max             most terms to keep
+ *
+ * @return  success         number of terms kept
+ * @return  failure         -1
+ */
+
+int expandFuzzy(Lexicon lex, char *term, int distance, int *terms, int max);
+
+#endif /* SWIFT_LEXICON_H_ */
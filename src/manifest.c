@@ -0,0 +1,225 @@
+/*
+ * File: manifest.c
+ *
+ * Author: Mike Swift
+ * Email: theycallmeswift@gmail.com
+ * Date Created: May 15th, 2011
+ * Date Modified: May 15th, 2011
+ */
+
+/********************************
+ *          1. Includes         *
+ ********************************/
+
+#include "manifest.h"
+
+/********************************
+ *     2. Manifest Functions    *
+ ********************************/
+
+/* shardName
+ *
+ * Name of a shard of an index, e.g. "index.txt.2" for the third
+ * shard of "index.txt".
+ *
+ * @param   index           name of the sharded index
+ * @param   shard           number of the shard
+ *
+ * @return  success         the name, to be freed by the caller
+ * @return  failure         NULL
+ */
+
+char *shardName(char *index, int shard)
+{
+    char *name;
+    
+    name = (char*) malloc(strlen(index) + 16);
+    if(name == NULL)
+    {
+        fprintf(stderr, "Error: Could not allocate space for filename.\n");
+        return NULL;
+    }
+    
+    sprintf(name, "%s.%d", index, shard);
+    
+    return name;
+}
+
+/* writeManifest
+ *
+ * Writes the manifest of a sharded index in its place:
+ *
+ * <shards> #shards
+ *      shard name
+ *      shard name
+ *      ... etc ...
+ * </shards>
+ *
+ * Every shard is a whole index of its own (see shardName), file n
+ * of the index being file n / #shards of shard n % #shards.
+ *
+ * @param   index           name of the sharded index
+ * @param   numshards       number of shards
+ *
+ * @return  success         1
+ * @return  failure         0
+ */
+
+int writeManifest(char *index, int numshards)
+{
+    FILE *file;
+    char *name;
+    int i, ok;
+    
+    file = fopen(index, "w");
+    if(file == NULL)
+    {
+        fprintf(stderr, "Error: Could not create %s.\n", index);
+        return 0;
+    }
+    
+    ok = (fprintf(file, "%s %d\n", MANIFEST_OPEN, numshards) > 0);
+    
+    for(i = 0; i < numshards && ok; i++)
+    {
+        name = shardName(index, i);
+        ok = (name != NULL && fprintf(file, "%s\n", name) > 0);
+        free(name);
+    }
+    
+    ok = ok && (fprintf(file, "%s\n", MANIFEST_CLOSE) > 0);
+    
+    if(fclose(file) != 0 || !ok)
+    {
+        fprintf(stderr, "Error: Could not write the manifest of %s.\n", index);
+        return 0;
+    }
+    
+    return 1;
+}
+
+/* isManifest
+ *
+ * Checks whether an index is the manifest of a sharded index.
+ *
+ * @param   index           name of the index
+ *
+ * @return  manifest        1
+ * @return  otherwise       0
+ */
+
+int isManifest(char *index)
+{
+    FILE *file;
+    char line[MANIFEST_LINE_SIZE];
+    int res;
+    
+    file = fopen(index, "r");
+    if(file == NULL)
+    {
+        return 0;
+    }
+    
+    res = (fgets(line, MANIFEST_LINE_SIZE, file) != NULL && strncmp(line, MANIFEST_OPEN, strlen(MANIFEST_OPEN)) == 0);
+    fclose(file);
+    
+    return res;
+}
+
+/* readManifest
+ *
+ * Reads the names of the shards of a sharded index, in order.
+ *
+ * @param   index           name of the sharded index
+ * @param   numshards       where to store the number of shards
+ *
+ * @return  success         array of names (see destroyManifest)
+ * @return  failure         NULL
+ */
+
+char **readManifest(char *index, int *numshards)
+{
+    FILE *file;
+    char line[MANIFEST_LINE_SIZE], **shards;
+    int i, count;
+    
+    file = fopen(index, "r");
+    if(file == NULL)
+    {
+        fprintf(stderr, "Error: Could not open %s.\n", index);
+        return NULL;
+    }
+    
+    if(fgets(line, MANIFEST_LINE_SIZE, file) == NULL ||
+       strncmp(line, MANIFEST_OPEN, strlen(MANIFEST_OPEN)) != 0 ||
+       sscanf(line + strlen(MANIFEST_OPEN), "%d", &count) != 1 || count < 1 || count > MAX_SHARDS)
+    {
+        fprintf(stderr, "Error: %s is not a sharded index.\n", index);
+        fclose(file);
+        return NULL;
+    }
+    
+    shards = (char**) malloc(sizeof(char*) * count);
+    if(shards == NULL)
+    {
+        fprintf(stderr, "Error: Could not allocate space for the shards.\n");
+        fclose(file);
+        return NULL;
+    }
+    
+    for(i = 0; i < count; i++)
+    {
+        shards[i] = NULL;
+        
+        if(fgets(line, MANIFEST_LINE_SIZE, file) == NULL)
+        {
+            fprintf(stderr, "Error: The manifest of %s names %d of its %d shards.\n", index, i, count);
+            destroyManifest(shards, i);
+            fclose(file);
+            return NULL;
+        }
+        
+        line[strcspn(line, "\r\n")] = '\0';
+        
+        shards[i] = (char*) malloc(strlen(line) + 1);
+        if(shards[i] == NULL)
+        {
+            fprintf(stderr, "Error: Could not allocate space for the shards.\n");
+            destroyManifest(shards, i);
+            fclose(file);
+            return NULL;
+        }
+        
+        strcpy(shards[i], line);
+    }
+    
+    fclose(file);
+    *numshards = count;
+    
+    return shards;
+}
+
+/* destroyManifest
+ *
+ * Frees what readManifest returned. NULL is ignored.
+ *
+ * @param   shards          names of the shards
+ * @param   numshards       number of shards
+ *
+ * @return  void
+ */
+
+void destroyManifest(char **shards, int numshards)
+{
+    int i;
+    
+    if(shards != NULL)
+    {
+        for(i = 0; i < numshards; i++)
+        {
+            free(shards[i]);
+        }
+        
+        free(shards);
+    }
+}
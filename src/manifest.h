@@ -0,0 +1,111 @@
+/*
+ * File: manifest.h
+ *
+ * Author: Mike Swift
+ * Email: theycallmeswift@gmail.com
+ * Date Created: May 15th, 2011
+ * Date Modified: May 15th, 2011
+ */
+
+#ifndef SWIFT_MANIFEST_H_
+#define SWIFT_MANIFEST_H_
+
+/********************************
+ *          1. Includes         *
+ ********************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/********************************
+ *          2. Constants        *
+ ********************************/
+
+/* A sharded index is a manifest naming its shards, between these */
+#define MANIFEST_OPEN "<shards>"
+#define MANIFEST_CLOSE "</shards>"
+
+/* Longest line of a manifest */
+#define MANIFEST_LINE_SIZE 4096
+
+/* Most shards an index can be split into */
+#define MAX_SHARDS 64
+
+/********************************
+ *     3. Manifest Functions    *
+ ********************************/
+
+/* shardName
+ *
+ * Name of a shard of an index, e.g. "index.txt.2" for the third
+ * shard of "index.txt".
+ *
+ * @param   index           name of the sharded index
+ * @param   shard           number of the shard
+ *
+ * @return  success         the name, to be freed by the caller
+ * @return  failure         NULL
+ */
+
+char *shardName(char *index, int shard);
+
+/* writeManifest
+ *
+ * Writes the manifest of a sharded index in its place:
+ *
+ * <shards> #shards
+ *      shard name
+ *      shard name
+ *      ... etc ...
+ * </shards>
+ *
+ * Every shard is a whole index of its own (see shardName), file n
+ * of the index being file n / #shards of shard n % #shards.
+ *
+ * @param   index           name of the sharded index
+ * @param   numshards       number of shards
+ *
+ * @return  success         1
+ * @return  failure         0
+ */
+
+int writeManifest(char *index, int numshards);
+
+/* isManifest
+ *
+ * Checks whether an index is the manifest of a sharded index.
+ *
+ * @param   index           name of the index
+ *
+ * @return  manifest        1
+ * @return  otherwise       0
+ */
+
+int isManifest(char *index);
+
+/* readManifest
+ *
+ * Reads the names of the shards of a sharded index, in order.
+ *
+ * @param   index           name of the sharded index
+ * @param   numshards       where to store the number of shards
+ *
+ * @return  success         array of names (see destroyManifest)
+ * @return  failure         NULL
+ */
+
+char **readManifest(char *index, int *numshards);
+
+/* destroyManifest
+ *
+ * Frees what readManifest returned. NULL is ignored.
+ *
+ * @param   shards          names of the shards
+ * @param   numshards       number of shards
+ *
+ * @return  void
+ */
+
+void destroyManifest(char **shards, int numshards);
+
+#endif /* SWIFT_MANIFEST_H_ */
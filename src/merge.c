@@ -0,0 +1,1189 @@
+/*
+ * File: merge.c
+ *
+ * Author: Mike Swift
+ * Email: theycallmeswift@gmail.com
+ * Date Created: May 9th, 2011
+ * Date Modified: May 9th, 2011
+ */
+
+/********************************
+ *          1. Includes         *
+ ********************************/
+
+/* fileno and posix_fadvise are POSIX, not ANSI */
+#define _XOPEN_SOURCE 600
+
+#include <fcntl.h>
+#include "merge.h"
+
+/********************************
+ *          2. Structs          *
+ ********************************/
+
+/* MergeRun_
+ *
+ * @param   file        the index being read
+ * @param   buffer      stdio buffer for the index
+ * @param   positions   the index's positions stream, read in step
+ *                      with the postings
+ * @param   line        current line
+ * @param   lineSize    allocated size of line
+ * @param   term        current term
+ * @param   termSize    allocated size of term
+ * @param   exhausted   1 once the last term has been read
+ * @param   failed      1 once the run could not be read, so a broken
+ *                      input is not taken for one that has ended
+ * @param   offset      merged number of the run's first file
+ * @param   numfiles    number of files in the run's table
+ */
+
+struct MergeRun_ {
+    FILE *file;
+    char *buffer;
+    FILE *positions;
+    char *line;
+    int lineSize;
+    char *term;
+    int termSize;
+    int exhausted;
+    int failed;
+    int offset;
+    int numfiles;
+};
+
+/* LoserTree_
+ *
+ * nodes[0] holds the winning run, nodes[1..k-1] hold the loser of
+ * the match played at that node. Leaf i sits at position k + i.
+ *
+ * @param   runs        array of runs
+ * @param   nodes       indexes into runs
+ * @param   k           number of runs
+ */
+
+struct LoserTree_ {
+    MergeRun *runs;
+    int *nodes;
+    int k;
+};
+
+/* Every stream a merge can write next to the index */
+static char *mergedSuffixes[] = {POSITIONS_SUFFIX, LEXICON_SUFFIX, BLOCKMAX_SUFFIX, IMPACT_SUFFIX, ROARING_SUFFIX,
+                                 PACKED_SUFFIX, TRIGRAM_SUFFIX, BLOOM_SUFFIX, MPHF_SUFFIX, STATS_SUFFIX};
+
+#define NUM_MERGED_SUFFIXES ((int) (sizeof(mergedSuffixes) / sizeof(mergedSuffixes[0])))
+
+/********************************
+ *      3. Helper Functions     *
+ ********************************/
+
+/* readLine
+ *
+ * Reads a full line from the run into run->line, growing the
+ * buffer for long filenames. The trailing newline is removed.
+ *
+ * @param   run         run to read from
+ *
+ * @return  success     1
+ * @return  EOF         0
+ * @return  failure     0, with the run flagged as failed
+ */
+
+int readLine(MergeRun run)
+{
+    int len;
+    char *bigger;
+    
+    if(fgets(run->line, run->lineSize, run->file) == NULL)
+    {
+        return 0;
+    }
+    
+    len = strlen(run->line);
+    
+    while(len > 0 && run->line[len - 1] != '\n' && !feof(run->file))
+    {
+        bigger = (char*) realloc(run->line, run->lineSize * 2);
+        if(bigger == NULL)
+        {
+            fprintf(stderr, "Error: Could not allocate space for line.\n");
+            run->failed = 1;
+            return 0;
+        }
+        run->line = bigger;
+        run->lineSize *= 2;
+        
+        if(fgets(run->line + len, run->lineSize - len, run->file) == NULL)
+        {
+            break;
+        }
+        len += strlen(run->line + len);
+    }
+    
+    if(len > 0 && run->line[len - 1] == '\n')
+    {
+        run->line[len - 1] = '\0';
+    }
+    
+    return 1;
+}
+
+/* beats
+ *
+ * Tournament comparison. An exhausted run loses to everything and
+ * index k is the sentinel that beats everything (used while the
+ * tree is being built). Ties go to the earlier run.
+ *
+ * @param   tree        loser tree
+ * @param   a           first run index
+ * @param   b           second run index
+ *
+ * @return  1           a beats b
+ * @return  0           b beats a
+ */
+
+int beats(LoserTree tree, int a, int b)
+{
+    int res;
+    MergeRun ra, rb;
+    
+    if(a == tree->k) return 1;
+    if(b == tree->k) return 0;
+    
+    ra = tree->runs[a];
+    rb = tree->runs[b];
+    
+    if(rb->exhausted) return 1;
+    if(ra->exhausted) return 0;
+    
+    res = strcmp(ra->term, rb->term);
+    
+    return res < 0 || (res == 0 && a < b);
+}
+
+/* playLeaf
+ *
+ * Plays the run at a leaf up to the root, leaving the loser of
+ * each match behind.
+ *
+ * @param   tree        loser tree
+ * @param   leaf        index of the run
+ *
+ * @return  void
+ */
+
+void playLeaf(LoserTree tree, int leaf)
+{
+    int node, winner, temp;
+    
+    winner = leaf;
+    node = (leaf + tree->k) / 2;
+    
+    while(node > 0)
+    {
+        if(beats(tree, tree->nodes[node], winner))
+        {
+            temp = tree->nodes[node];
+            tree->nodes[node] = winner;
+            winner = temp;
+        }
+        node /= 2;
+    }
+    
+    tree->nodes[0] = winner;
+}
+
+/* allHaveSidecar
+ *
+ * Checks whether every input of a merge has a given sidecar.
+ *
+ * @param   inputs      names of the indexes to merge
+ * @param   k           number of inputs
+ * @param   suffix      sidecar to look for
+ *
+ * @return  success     1 if every input has the sidecar
+ * @return  failure     0
+ */
+
+int allHaveSidecar(char **inputs, int k, char *suffix)
+{
+    FILE *file;
+    int i;
+    
+    for(i = 0; i < k; i++)
+    {
+        file = openSidecar(inputs[i], suffix, "rb");
+        if(file == NULL)
+        {
+            return 0;
+        }
+        fclose(file);
+    }
+    
+    return 1;
+}
+
+/* mergedCodec
+ *
+ * Picks the codec of the merged packed stream: that of the first
+ * input to have one, so merging keeps what index was told to use.
+ *
+ * @param   inputs      names of the indexes to merge
+ * @param   k           number of inputs
+ *
+ * @return  int         codec, DEFAULT_CODEC if no input has a
+ *                      readable packed stream
+ */
+
+int mergedCodec(char **inputs, int k)
+{
+    FILE *file;
+    int i, codec;
+    
+    for(i = 0; i < k; i++)
+    {
+        file = openPacked(inputs[i], &codec);
+        if(file != NULL)
+        {
+            fclose(file);
+            return codec;
+        }
+    }
+    
+    return DEFAULT_CODEC;
+}
+
+/* mergeTrigrams
+ *
+ * Merges the trigram streams of the inputs, shifting the file
+ * numbers the same way the file tables were. If an input has no
+ * trigrams the output gets none either.
+ *
+ * @param   output      name of the merged index
+ * @param   inputs      names of the indexes to merge
+ * @param   runs        the open inputs
+ * @param   k           number of inputs
+ *
+ * @return  success     1
+ * @return  failure     0
+ */
+
+int mergeTrigrams(char *output, char **inputs, MergeRun *runs, int k)
+{
+    Trigrams trigrams;
+    int i, res, offset;
+    
+    if(allHaveSidecar(inputs, k, TRIGRAM_SUFFIX) == 0)
+    {
+        return removeSidecar(output, TRIGRAM_SUFFIX);
+    }
+    
+    trigrams = createTrigrams();
+    if(trigrams == NULL)
+    {
+        return 0;
+    }
+    
+    res = 1;
+    offset = 0;
+    
+    for(i = 0; i < k && res == 1; i++)
+    {
+        res = loadTrigrams(trigrams, inputs[i], offset);
+        offset += runs[i]->numfiles;
+    }
+    
+    if(res == 1)
+    {
+        res = writeTrigrams(trigrams, output);
+    }
+    
+    destroyTrigrams(trigrams);
+    
+    return res;
+}
+
+/* discardIndex
+ *
+ * Deletes an index and every stream next to it, what is left of
+ * a merge that failed. Files that are not there are fine.
+ *
+ * @param   name        name of the index
+ *
+ * @return  void
+ */
+
+void discardIndex(char *name)
+{
+    int i;
+    
+    for(i = 0; i < NUM_MERGED_SUFFIXES; i++)
+    {
+        removeSidecar(name, mergedSuffixes[i]);
+    }
+    remove(name);
+}
+
+/* moveIndex
+ *
+ * Puts a finished index in the place of another. The streams go
+ * first and the index itself last, so whoever finds the new index
+ * finds its streams with it. Streams the new index does not have
+ * are removed rather than left to be read with it.
+ *
+ * @param   from        name the index was written under
+ * @param   to          name it is meant to have
+ *
+ * @return  success     1
+ * @return  failure     0
+ */
+
+int moveIndex(char *from, char *to)
+{
+    int i;
+    
+    for(i = 0; i < NUM_MERGED_SUFFIXES; i++)
+    {
+        if(renameSidecar(from, to, mergedSuffixes[i]) == 0)
+        {
+            return 0;
+        }
+    }
+    
+    if(rename(from, to) != 0)
+    {
+        fprintf(stderr, "Error: Could not rename %s to %s.\n", from, to);
+        return 0;
+    }
+    
+    return 1;
+}
+
+/* mergeStats
+ *
+ * Writes the statistics block of the merged index, the counts of
+ * every input folded together (see addIndexStats). Only lexicons
+ * are read, never a posting, so the block of an index that grows
+ * a segment at a time is kept up to date at the price of a pass
+ * over its terms. If an input has no lexicon the output gets no
+ * block.
+ *
+ * @param   output      name of the merged index
+ * @param   inputs      names of the indexes to merge
+ * @param   k           number of inputs
+ *
+ * @return  success     1
+ * @return  failure     0
+ */
+
+int mergeStats(char *output, char **inputs, int k)
+{
+    Stats stats;
+    int i, res;
+    
+    if(allHaveSidecar(inputs, k, LEXICON_SUFFIX) == 0)
+    {
+        return removeSidecar(output, STATS_SUFFIX);
+    }
+    
+    stats = createStats();
+    if(stats == NULL)
+    {
+        return 0;
+    }
+    
+    res = 1;
+    
+    for(i = 0; i < k && res == 1; i++)
+    {
+        res = addIndexStats(stats, inputs[i]);
+    }
+    
+    if(res == 1)
+    {
+        res = writeStats(stats, output);
+    }
+    
+    destroyStats(stats);
+    
+    return res;
+}
+
+/********************************
+ *      4. Run Functions        *
+ ********************************/
+
+/* openRun
+ *
+ * Opens a sorted inverted index (as written by runindex) and its
+ * positions stream for sequential reading with a large stdio
+ * buffer. The run is not
+ * positioned on a term until readRunFiles and advanceRun have
+ * been called.
+ *
+ * @param   filename        inverted index to read
+ *
+ * @return  success         new MergeRun
+ * @return  failure         NULL
+ */
+
+MergeRun openRun(char *filename)
+{
+    MergeRun run;
+    
+    run = (MergeRun) malloc(sizeof(struct MergeRun_));
+    if(run == NULL)
+    {
+        fprintf(stderr, "Error: Could not allocate space for run.\n");
+        return NULL;
+    }
+    
+    run->file = fopen(filename, "r");
+    if(run->file == NULL)
+    {
+        fprintf(stderr, "Error: Failed to open %s\n", filename);
+        free(run);
+        return NULL;
+    }
+    
+    run->positions = openSidecar(filename, POSITIONS_SUFFIX, "rb");
+    if(run->positions == NULL)
+    {
+        fprintf(stderr, "Error: Failed to open positions of %s\n", filename);
+        fclose(run->file);
+        free(run);
+        return NULL;
+    }
+    
+    /* Tell the kernel we read front to back so it reads ahead aggressively */
+    posix_fadvise(fileno(run->file), 0, 0, POSIX_FADV_SEQUENTIAL);
+    posix_fadvise(fileno(run->positions), 0, 0, POSIX_FADV_SEQUENTIAL);
+    
+    run->buffer = (char*) malloc(MERGE_BUFFER_SIZE);
+    run->line = (char*) malloc(MERGE_LINE_SIZE);
+    run->term = (char*) malloc(MERGE_LINE_SIZE);
+    
+    if(run->buffer == NULL || run->line == NULL || run->term == NULL)
+    {
+        fprintf(stderr, "Error: Could not allocate space for run buffers.\n");
+        fclose(run->file);
+        fclose(run->positions);
+        free(run->buffer);
+        free(run->line);
+        free(run->term);
+        free(run);
+        return NULL;
+    }
+    
+    setvbuf(run->file, run->buffer, _IOFBF, MERGE_BUFFER_SIZE);
+    
+    run->lineSize = MERGE_LINE_SIZE;
+    run->termSize = MERGE_LINE_SIZE;
+    run->term[0] = '\0';
+    run->exhausted = 1;
+    run->failed = 0;
+    run->offset = 0;
+    run->numfiles = 0;
+    
+    return run;
+}
+
+/* closeRun
+ *
+ * Closes the index and frees the run. NULL is ignored.
+ *
+ * @param   run             run to close
+ *
+ * @return  void
+ */
+
+void closeRun(MergeRun run)
+{
+    if(run != NULL)
+    {
+        /* Close before freeing the buffer stdio is still using */
+        fclose(run->file);
+        fclose(run->positions);
+        free(run->buffer);
+        free(run->line);
+        free(run->term);
+        free(run);
+    }
+}
+
+/* readRunFiles
+ *
+ * Reads the <files> table of a run and appends each file to the
+ * end of the merged file list. The run remembers the number of
+ * the first file so its postings can be renumbered.
+ *
+ * @param   run             run positioned at the top of the index
+ * @param   offset          merged number of the run's first file
+ * @param   tail            pointer to the tail of the merged list
+ *
+ * @return  success         number of files read
+ * @return  failure         -1
+ */
+
+int readRunFiles(MergeRun run, int offset, Entry *tail)
+{
+    char *name, *suffix;
+    int more, shared;
+    Entry ent;
+    
+    if(readLine(run) == 0 || strncmp(run->line, "<files>", 7) != 0)
+    {
+        fprintf(stderr, "Error: Malformed index file.\n");
+        run->failed = 1;
+        return -1;
+    }
+    
+    run->offset = offset;
+    run->numfiles = 0;
+    
+    while((more = readLine(run)) == 1 && strcmp(run->line, "</files>") != 0)
+    {
+        /* Lines look like "\t<file#>:<shared>:<suffix>" */
+        suffix = strchr(run->line, ':');
+        if(suffix == NULL)
+        {
+            fprintf(stderr, "Error: Malformed index file.\n");
+            run->failed = 1;
+            return -1;
+        }
+        shared = atoi(suffix + 1);
+        
+        suffix = strchr(suffix + 1, ':');
+        if(suffix == NULL || shared < 0 || (shared > 0 && run->numfiles == 0) ||
+           (shared > 0 && (size_t) shared > strlen((*tail)->filename)))
+        {
+            fprintf(stderr, "Error: Malformed index file.\n");
+            run->failed = 1;
+            return -1;
+        }
+        suffix++;
+        
+        /* The prefix comes from the run's previous file, the tail of the list */
+        name = (char*) malloc(shared + strlen(suffix) + 1);
+        if(name == NULL)
+        {
+            fprintf(stderr, "Error: Could not allocate space for filename.\n");
+            return -1;
+        }
+        
+        if(shared > 0)
+        {
+            memcpy(name, (*tail)->filename, shared);
+        }
+        strcpy(name + shared, suffix);
+        
+        ent = createEntry(name, offset + run->numfiles, 1);
+        free(name);
+        
+        if(ent == NULL)
+        {
+            return -1;
+        }
+        
+        (*tail)->next = ent;
+        *tail = ent;
+        
+        run->numfiles++;
+    }
+    
+    /* A table cut off by the end of the file is a truncated index */
+    if(more == 0)
+    {
+        fprintf(stderr, "Error: Malformed index file.\n");
+        run->failed = 1;
+        return -1;
+    }
+    
+    return run->numfiles;
+}
+
+/* advanceRun
+ *
+ * Moves the run to its next <list> header. When the index is
+ * exhausted the run is flagged as such and sorts after every
+ * other run. A run that cannot be read is flagged as failed as
+ * well, so the merge does not go on as if it had ended.
+ *
+ * @param   run             run to advance
+ *
+ * @return  success         1
+ * @return  exhausted       0
+ * @return  failure         -1
+ */
+
+int advanceRun(MergeRun run)
+{
+    char *start, *end;
+    int len;
+    
+    run->exhausted = 1;
+    
+    if(readLine(run) == 0)
+    {
+        return run->failed ? -1 : 0;
+    }
+    
+    if(strncmp(run->line, "<list> ", 7) != 0)
+    {
+        fprintf(stderr, "Error: Malformed index file.\n");
+        run->failed = 1;
+        return -1;
+    }
+    
+    /* Header looks like "<list> <term> <#files> <offset>" */
+    start = run->line + 7;
+    end = strchr(start, ' ');
+    len = (end == NULL) ? (int) strlen(start) : (int) (end - start);
+    
+    if(len + 1 > run->termSize)
+    {
+        free(run->term);
+        run->termSize = len + 1;
+        run->term = (char*) malloc(run->termSize);
+        if(run->term == NULL)
+        {
+            fprintf(stderr, "Error: Could not allocate space for term.\n");
+            run->failed = 1;
+            return -1;
+        }
+    }
+    
+    memcpy(run->term, start, len);
+    run->term[len] = '\0';
+    run->exhausted = 0;
+    
+    return 1;
+}
+
+/* readRunPostings
+ *
+ * Reads the postings of the run's current term and appends them
+ * to a word, renumbering files into the merged file table. The
+ * positions of every posting are read from the positions stream,
+ * which holds them in the same order as the postings. A list the
+ * file ends in before its </list> fails the run.
+ *
+ * @param   run             run positioned on a <list> header
+ * @param   word            word that collects the postings
+ * @param   tail            pointer to the word's last entry
+ *
+ * @return  success         1
+ * @return  failure         0
+ */
+
+int readRunPostings(MergeRun run, Word word, Entry *tail)
+{
+    char *ptr;
+    int more, filenum, frequency, i;
+    unsigned int gap, position;
+    Entry ent;
+    
+    while((more = readLine(run)) == 1 && strcmp(run->line, "</list>") != 0)
+    {
+        /* Lines look like "\t<file#>: <frequency>" */
+        filenum = (int) strtol(run->line, &ptr, 10);
+        if(*ptr != ':')
+        {
+            fprintf(stderr, "Error: Malformed index file.\n");
+            run->failed = 1;
+            return 0;
+        }
+        frequency = (int) strtol(ptr + 1, NULL, 10);
+        
+        ent = createEntry(NULL, run->offset + filenum, frequency);
+        if(ent == NULL)
+        {
+            run->failed = 1;
+            return 0;
+        }
+        
+        position = 0;
+        for(i = 0; i < frequency; i++)
+        {
+            if(readVByte(run->positions, &gap) == 0)
+            {
+                fprintf(stderr, "Error: Malformed positions file.\n");
+                destroyEntry(ent);
+                run->failed = 1;
+                return 0;
+            }
+            
+            position += gap;
+            if(addPosition(ent, position) == 0)
+            {
+                destroyEntry(ent);
+                run->failed = 1;
+                return 0;
+            }
+        }
+        
+        if(*tail == NULL)
+        {
+            word->head = ent;
+        }
+        else
+        {
+            (*tail)->next = ent;
+        }
+        *tail = ent;
+        
+        word->numFiles++;
+        word->totalAppearances += frequency;
+    }
+    
+    /* The file ended inside the list, its last postings are gone */
+    if(more == 0)
+    {
+        fprintf(stderr, "Error: Malformed index file.\n");
+        run->failed = 1;
+        return 0;
+    }
+    
+    return 1;
+}
+
+/********************************
+ *      5. Loser Tree Functions *
+ ********************************/
+
+/* createLoserTree
+ *
+ * Builds a tournament (loser) tree over k runs. Every run must
+ * already be positioned on its first term. The winner is the
+ * run holding the smallest term; ties go to the earlier run.
+ *
+ * @param   runs            array of runs
+ * @param   k               number of runs
+ *
+ * @return  success         new LoserTree
+ * @return  failure         NULL
+ */
+
+LoserTree createLoserTree(MergeRun *runs, int k)
+{
+    LoserTree tree;
+    int i;
+    
+    tree = (LoserTree) malloc(sizeof(struct LoserTree_));
+    if(tree == NULL)
+    {
+        fprintf(stderr, "Error: Could not allocate space for loser tree.\n");
+        return NULL;
+    }
+    
+    tree->nodes = (int*) malloc(sizeof(int) * k);
+    if(tree->nodes == NULL)
+    {
+        fprintf(stderr, "Error: Could not allocate space for loser tree.\n");
+        free(tree);
+        return NULL;
+    }
+    
+    tree->runs = runs;
+    tree->k = k;
+    
+    /* Seed every node with the sentinel, then play each leaf in */
+    for(i = 0; i < k; i++)
+    {
+        tree->nodes[i] = k;
+    }
+    
+    for(i = k - 1; i >= 0; i--)
+    {
+        playLeaf(tree, i);
+    }
+    
+    return tree;
+}
+
+/* destroyLoserTree
+ *
+ * Frees a loser tree. The runs are left alone.
+ *
+ * @param   tree            tree to free
+ *
+ * @return  void
+ */
+
+void destroyLoserTree(LoserTree tree)
+{
+    if(tree != NULL)
+    {
+        free(tree->nodes);
+        free(tree);
+    }
+}
+
+/* winnerLoserTree
+ *
+ * Returns the run currently holding the smallest term. Once every
+ * run is exhausted the winner is an exhausted run.
+ *
+ * @param   tree            loser tree
+ *
+ * @return  MergeRun
+ */
+
+MergeRun winnerLoserTree(LoserTree tree)
+{
+    return tree->runs[tree->nodes[0]];
+}
+
+/* replayLoserTree
+ *
+ * Replays the winner's path after it has been advanced. Costs
+ * log2(k) comparisons.
+ *
+ * @param   tree            loser tree
+ *
+ * @return  void
+ */
+
+void replayLoserTree(LoserTree tree)
+{
+    playLeaf(tree, tree->nodes[0]);
+}
+
+/********************************
+ *      6. Merge Functions      *
+ ********************************/
+
+/* mergeIndexes
+ *
+ * Merges several sorted inverted indexes into one. The file tables
+ * are concatenated in argument order and every term is emitted once
+ * with the postings of all inputs, in a single sequential pass over
+ * each input (and its positions stream, whose lists travel with
+ * their postings). Inputs are expected to cover disjoint sets of
+ * files. The lexicon of the output is written as terms go out.
+ * Trigrams and impact ordered lists are merged too when every
+ * input has them, and the inputs' statistics are folded into the
+ * block of the output (see mergeStats). Everything is written under the output's name
+ * with MERGE_PART_SUFFIX appended and only renamed into place once
+ * the merge has succeeded; a merge that fails, a truncated input
+ * included, leaves no output behind.
+ *
+ * @param   output          name of the merged index
+ * @param   inputs          names of the indexes to merge
+ * @param   k               number of inputs
+ *
+ * @return  success         1
+ * @return  failure         0
+ */
+
+int mergeIndexes(char *output, char **inputs, int k)
+{
+    MergeRun *runs, run;
+    LoserTree tree;
+    struct Entry_ files;
+    Entry tail, ent, next;
+    Word word;
+    Bloom bloom;
+    Mphf mphf;
+    FILE *index, *positions, *lexicon, *blocks, *impacts, *containers, *packed;
+    char *buffer, *part;
+    int i, res, offset, codec;
+    long start, first, summary, impact, container, pack, generation;
+    
+    res = 1;
+    tree = NULL;
+    index = NULL;
+    positions = NULL;
+    lexicon = NULL;
+    blocks = NULL;
+    impacts = NULL;
+    containers = NULL;
+    packed = NULL;
+    bloom = NULL;
+    mphf = NULL;
+    buffer = NULL;
+    files.next = NULL;
+    
+    runs = (MergeRun*) malloc(sizeof(MergeRun) * k);
+    if(runs == NULL)
+    {
+        fprintf(stderr, "Error: Could not allocate space for runs.\n");
+        return 0;
+    }
+    
+    for(i = 0; i < k; i++)
+    {
+        runs[i] = NULL;
+    }
+    
+    part = (char*) malloc(strlen(output) + strlen(MERGE_PART_SUFFIX) + 1);
+    if(part == NULL)
+    {
+        fprintf(stderr, "Error: Could not allocate space for filename.\n");
+        free(runs);
+        return 0;
+    }
+    strcpy(part, output);
+    strcat(part, MERGE_PART_SUFFIX);
+    
+    /* Whatever an earlier merge that died left behind */
+    discardIndex(part);
+    
+    /* The merged index counts on from the one it replaces */
+    generation = nextGeneration(output);
+    
+    /* Open every run and build the merged file table */
+    tail = &files;
+    offset = 0;
+    
+    for(i = 0; i < k && res == 1; i++)
+    {
+        if(strcmp(inputs[i], output) == 0)
+        {
+            fprintf(stderr, "Error: Output cannot also be an input (%s).\n", output);
+            res = 0;
+            break;
+        }
+        
+        runs[i] = openRun(inputs[i]);
+        if(runs[i] == NULL || readRunFiles(runs[i], offset, &tail) < 0)
+        {
+            res = 0;
+            break;
+        }
+        
+        offset += runs[i]->numfiles;
+        if(advanceRun(runs[i]) < 0)
+        {
+            res = 0;
+        }
+    }
+    
+    if(res == 1)
+    {
+        tree = createLoserTree(runs, k);
+        index = fopen(part, "w");
+        positions = openSidecar(part, POSITIONS_SUFFIX, "wb");
+        lexicon = openSidecar(part, LEXICON_SUFFIX, "w");
+        blocks = openSidecar(part, BLOCKMAX_SUFFIX, "wb");
+        containers = openSidecar(part, ROARING_SUFFIX, "wb");
+        packed = openSidecar(part, PACKED_SUFFIX, "wb");
+        bloom = createBloom();
+        mphf = createMphf();
+        buffer = (char*) malloc(MERGE_BUFFER_SIZE);
+        
+        if(tree == NULL || index == NULL || positions == NULL || lexicon == NULL || blocks == NULL || containers == NULL || packed == NULL || bloom == NULL || mphf == NULL || buffer == NULL)
+        {
+            fprintf(stderr, "Error: Could not set up the merge into %s.\n", output);
+            res = 0;
+        }
+    }
+    
+    /* Impacts are rebuilt from the merged postings, if all inputs had them */
+    if(res == 1)
+    {
+        if(allHaveSidecar(inputs, k, IMPACT_SUFFIX) == 1)
+        {
+            impacts = openSidecar(part, IMPACT_SUFFIX, "wb");
+            res = (impacts != NULL);
+        }
+    }
+    
+    /* Postings are packed again, they could not be copied with the file numbers shifted */
+    if(res == 1)
+    {
+        codec = mergedCodec(inputs, k);
+        res = writeCodecHeader(packed, codec);
+    }
+    
+    if(res == 1)
+    {
+        setvbuf(index, buffer, _IOFBF, MERGE_BUFFER_SIZE);
+        
+        res = indexFiles(index, files.next, generation);
+        
+        /* Pull the smallest term, drain every run that holds it, write it */
+        while(res == 1 && (run = winnerLoserTree(tree))->exhausted == 0)
+        {
+            word = createWord(run->term);
+            if(word == NULL)
+            {
+                res = 0;
+                break;
+            }
+            
+            ent = NULL;
+            
+            do
+            {
+                if(readRunPostings(run, word, &ent) == 0 || advanceRun(run) < 0)
+                {
+                    res = 0;
+                }
+                
+                replayLoserTree(tree);
+                
+                run = winnerLoserTree(tree);
+            }
+            while(res == 1 && run->exhausted == 0 && strcmp(run->term, word->word) == 0);
+            
+            if(res == 1)
+            {
+                start = ftell(index);
+                first = ftell(positions);
+                res = indexWord(index, positions, word);
+            }
+            
+            if(res == 1)
+            {
+                pack = writePacked(packed, codec, word, first);
+                res = (pack >= 0);
+            }
+            
+            if(res == 1)
+            {
+                summary = writeBlockMaxima(blocks, word);
+                res = (summary >= 0);
+            }
+            
+            impact = -1;
+            if(res == 1 && impacts != NULL)
+            {
+                impact = writeImpacts(impacts, word);
+                res = (impact >= 0);
+            }
+            
+            /* offset is the number of files in the merged index by now */
+            container = -1;
+            if(res == 1 && IS_DENSE(word->numFiles, offset))
+            {
+                container = writeContainers(containers, word);
+                res = (container >= 0);
+            }
+            
+            if(res == 1)
+            {
+                res = writeLexiconEntry(lexicon, word, start, summary, impact, container, pack);
+            }
+            
+            if(res == 1)
+            {
+                res = addBloom(bloom, word->word);
+            }
+            
+            if(res == 1)
+            {
+                res = addMphf(mphf, word->word);
+            }
+            
+            destroyWord(word);
+        }
+    }
+    
+    /* The filter of the merged terms, a stale one would turn away terms that are there */
+    if(res == 1)
+    {
+        res = writeBloom(bloom, part);
+    }
+    
+    /* Same for the perfect hash, a stale one would send terms to the wrong slots */
+    if(res == 1)
+    {
+        res = writeMphf(mphf, part);
+    }
+    
+    if(res == 1)
+    {
+        res = mergeTrigrams(part, inputs, runs, k);
+    }
+    
+    /* Scores have to come out the same whether the inputs are searched merged or side by side */
+    if(res == 1)
+    {
+        res = mergeStats(part, inputs, k);
+    }
+    
+    /* Burn it all down, a write that fails on close fails the merge too */
+    if(index != NULL && fclose(index) != 0)
+    {
+        res = 0;
+    }
+    if(positions != NULL && fclose(positions) != 0)
+    {
+        res = 0;
+    }
+    if(lexicon != NULL && fclose(lexicon) != 0)
+    {
+        res = 0;
+    }
+    if(blocks != NULL && fclose(blocks) != 0)
+    {
+        res = 0;
+    }
+    if(impacts != NULL && fclose(impacts) != 0)
+    {
+        res = 0;
+    }
+    if(containers != NULL && fclose(containers) != 0)
+    {
+        res = 0;
+    }
+    if(packed != NULL && fclose(packed) != 0)
+    {
+        res = 0;
+    }
+    free(buffer);
+    
+    destroyBloom(bloom);
+    destroyMphf(mphf);
+    destroyLoserTree(tree);
+    
+    for(i = 0; i < k; i++)
+    {
+        closeRun(runs[i]);
+    }
+    free(runs);
+    
+    ent = files.next;
+    while(ent != NULL)
+    {
+        next = ent->next;
+        destroyEntry(ent);
+        ent = next;
+    }
+    
+    /* Only a whole index replaces the output */
+    if(res == 1)
+    {
+        res = moveIndex(part, output);
+    }
+    if(res == 0)
+    {
+        discardIndex(part);
+    }
+    free(part);
+    
+    return res;
+}
+
+int runmerge( int argc, char** argv )
+{
+    /* Validate the inputs */
+    if( (argc == 2 && argv[1][0] == '-' && argv[1][1] == 'h') || argc < 3 )
+    {
+        fprintf(stderr, "Usage: %s <merged-index filename> <inverted-index> [<inverted-index> ...]\n", argv[0]);
+        return 1;
+    }
+    
+    if(mergeIndexes(argv[1], argv + 2, argc - 2) == 0)
+    {
+        fprintf(stderr, "Error: Could not merge indexes into %s.\n", argv[1]);
+        releaseWords();
+        return 0;
+    }
+    
+    releaseWords();
+    
+    return 1;
+}
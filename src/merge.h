@@ -0,0 +1,216 @@
+/*
+ * File: merge.h
+ *
+ * Author: Mike Swift
+ * Email: theycallmeswift@gmail.com
+ * Date Created: May 9th, 2011
+ * Date Modified: May 9th, 2011
+ */
+
+#ifndef SWIFT_MERGE_H_
+#define SWIFT_MERGE_H_
+
+/********************************
+ *          1. Includes         *
+ ********************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "impact.h"
+#include "index.h"
+#include "postings.h"
+#include "roaring.h"
+#include "trigram.h"
+#include "words.h"
+
+/********************************
+ *          2. Constants        *
+ ********************************/
+
+/* Size of the stdio buffer given to every input and to the output */
+#define MERGE_BUFFER_SIZE (1 << 20)
+
+/* Initial size of a run's line buffer (grows as needed) */
+#define MERGE_LINE_SIZE 256
+
+/* Appended to the output's name while the merge is written */
+#define MERGE_PART_SUFFIX ".part"
+
+/********************************
+ *      3. Structs & Typedefs   *
+ ********************************/
+
+struct MergeRun_;
+typedef struct MergeRun_* MergeRun;
+
+struct LoserTree_;
+typedef struct LoserTree_* LoserTree;
+
+/********************************
+ *      4. Run Functions        *
+ ********************************/
+
+/* openRun
+ *
+ * Opens a sorted inverted index (as written by runindex) and its
+ * positions stream for sequential reading with a large stdio
+ * buffer. The run is not
+ * positioned on a term until readRunFiles and advanceRun have
+ * been called.
+ *
+ * @param   filename        inverted index to read
+ *
+ * @return  success         new MergeRun
+ * @return  failure         NULL
+ */
+
+MergeRun openRun(char *filename);
+
+/* closeRun
+ *
+ * Closes the index and frees the run. NULL is ignored.
+ *
+ * @param   run             run to close
+ *
+ * @return  void
+ */
+
+void closeRun(MergeRun run);
+
+/* readRunFiles
+ *
+ * Reads the <files> table of a run and appends each file to the
+ * end of the merged file list. The run remembers the number of
+ * the first file so its postings can be renumbered.
+ *
+ * @param   run             run positioned at the top of the index
+ * @param   offset          merged number of the run's first file
+ * @param   tail            pointer to the tail of the merged list
+ *
+ * @return  success         number of files read
+ * @return  failure         -1
+ */
+
+int readRunFiles(MergeRun run, int offset, Entry *tail);
+
+/* advanceRun
+ *
+ * Moves the run to its next <list> header. When the index is
+ * exhausted the run is flagged as such and sorts after every
+ * other run. A run that cannot be read is flagged as failed as
+ * well, so the merge does not go on as if it had ended.
+ *
+ * @param   run             run to advance
+ *
+ * @return  success         1
+ * @return  exhausted       0
+ * @return  failure         -1
+ */
+
+int advanceRun(MergeRun run);
+
+/* readRunPostings
+ *
+ * Reads the postings of the run's current term and appends them
+ * to a word, renumbering files into the merged file table. The
+ * positions of every posting are read from the positions stream,
+ * which holds them in the same order as the postings. A list the
+ * file ends in before its </list> fails the run.
+ *
+ * @param   run             run positioned on a <list> header
+ * @param   word            word that collects the postings
+ * @param   tail            pointer to the word's last entry
+ *
+ * @return  success         1
+ * @return  failure         0
+ */
+
+int readRunPostings(MergeRun run, Word word, Entry *tail);
+
+/********************************
+ *      5. Loser Tree Functions *
+ ********************************/
+
+/* createLoserTree
+ *
+ * Builds a tournament (loser) tree over k runs. Every run must
+ * already be positioned on its first term. The winner is the
+ * run holding the smallest term; ties go to the earlier run.
+ *
+ * @param   runs            array of runs
+ * @param   k               number of runs
+ *
+ * @return  success         new LoserTree
+ * @return  failure         NULL
+ */
+
+LoserTree createLoserTree(MergeRun *runs, int k);
+
+/* destroyLoserTree
+ *
+ * Frees a loser tree. The runs are left alone.
+ *
+ * @param   tree            tree to free
+ *
+ * @return  void
+ */
+
+void destroyLoserTree(LoserTree tree);
+
+/* winnerLoserTree
+ *
+ * Returns the run currently holding the smallest term. Once every
+ * run is exhausted the winner is an exhausted run.
+ *
+ * @param   tree            loser tree
+ *
+ * @return  MergeRun
+ */
+
+MergeRun winnerLoserTree(LoserTree tree);
+
+/* replayLoserTree
+ *
+ * Replays the winner's path after it has been advanced. Costs
+ * log2(k) comparisons.
+ *
+ * @param   tree            loser tree
+ *
+ * @return  void
+ */
+
+void replayLoserTree(LoserTree tree);
+
+/********************************
+ *      6. Merge Functions      *
+ ********************************/
+
+/* mergeIndexes
+ *
+ * Merges several sorted inverted indexes into one. The file tables
+ * are concatenated in argument order and every term is emitted once
+ * with the postings of all inputs, in a single sequential pass over
+ * each input (and its positions stream, whose lists travel with
+ * their postings). Inputs are expected to cover disjoint sets of
+ * files. The lexicon of the output is written as terms go out.
+ * Trigrams and impact ordered lists are merged too when every
+ * input has them, and the inputs' statistics are folded into the
+ * block of the output (see mergeStats). Everything is written under the output's name
+ * with MERGE_PART_SUFFIX appended and only renamed into place once
+ * the merge has succeeded; a merge that fails, a truncated input
+ * included, leaves no output behind.
+ *
+ * @param   output          name of the merged index
+ * @param   inputs          names of the indexes to merge
+ * @param   k               number of inputs
+ *
+ * @return  success         1
+ * @return  failure         0
+ */
+
+int mergeIndexes(char *output, char **inputs, int k);
+
+/* Driver */
+int runmerge( int argc, char** argv );
+
+#endif /* SWIFT_MERGE_H_ */
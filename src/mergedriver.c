@@ -0,0 +1,17 @@
+/*
+ * File: mergedriver.c
+ *
+ * Author: Mike Swift
+ * Email: theycallmeswift@gmail.com
+ * Date Created: May 9th, 2011
+ * Date Modified: May 9th, 2011
+ */
+ 
+/* This is a simple driver for the index merger */
+
+#include "merge.h"
+
+int main(int argc, char** argv )
+{
+    return runmerge(argc, argv );
+}
\ No newline at end of file
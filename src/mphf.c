@@ -0,0 +1,781 @@
+/*
+ * File: mphf.c
+ *
+ * Author: Mike Swift
+ * Email: theycallmeswift@gmail.com
+ * Date Created: May 15th, 2011
+ * Date Modified: May 15th, 2011
+ */
+
+/********************************
+ *          1. Includes         *
+ ********************************/
+
+#include "mphf.h"
+
+/********************************
+ *          2. Structs          *
+ ********************************/
+
+/* Spill_
+ *
+ * A term left over after the last level.
+ *
+ * @param   key         hash of the term (see hashKey)
+ * @param   term        number of the term
+ */
+
+struct Spill_ {
+    unsigned long long key;
+    int term;
+};
+
+typedef struct Spill_* Spill;
+
+/* Mphf_
+ *
+ * A hash being built holds the hash of each of its terms as well,
+ * a loaded one only its levels, slots and spills.
+ *
+ * @param   keys        hash of every term added, NULL once loaded
+ * @param   count       number of terms
+ * @param   capacity    number of terms there is room for
+ * @param   bits        the bits of every level, back to back
+ * @param   levels      byte each level starts at, the one after the
+ *                      last where the bits end
+ * @param   numlevels   number of levels
+ * @param   ranks       bits set before every MPHF_RANK_BYTES bytes
+ * @param   placed      number of bits set, one per slot
+ * @param   slots       number of the term of each slot
+ * @param   prints      fingerprint of the term of each slot
+ * @param   spills      terms left over after the last level, by hash
+ * @param   numspills   number of them
+ */
+
+struct Mphf_ {
+    unsigned long long *keys;
+    int count;
+    int capacity;
+    unsigned char *bits;
+    long levels[MPHF_LEVELS + 1];
+    int numlevels;
+    unsigned int *ranks;
+    int placed;
+    int *slots;
+    unsigned char *prints;
+    Spill spills;
+    int numspills;
+};
+
+/********************************
+ *      3. Helper Functions     *
+ ********************************/
+
+/* hashKey
+ *
+ * 64 bit FNV-1a hash of a term, wide enough that no two terms of
+ * a lexicon share one.
+ *
+ * @param   term        term to hash
+ *
+ * @return  unsigned long long  the hash
+ */
+
+unsigned long long hashKey(char *term)
+{
+    unsigned long long h;
+    
+    h = 14695981039346656037ULL;
+    
+    while(*term != '\0')
+    {
+        h ^= (unsigned char) *term++;
+        h *= 1099511628211ULL;
+    }
+    
+    return h;
+}
+
+/* levelBit
+ *
+ * Bit a hashed term falls on in one level: the hash is mixed with
+ * the level number, so the terms that clashed on one level are
+ * spread out anew on the next.
+ *
+ * @param   mphf        Mphf object
+ * @param   h           hash of the term (see hashKey)
+ * @param   level       level number
+ *
+ * @return  long        the bit, counted from the first level
+ */
+
+long levelBit(Mphf mphf, unsigned long long h, int level)
+{
+    unsigned long long size;
+    
+    h ^= (unsigned long long) (level + 1) * 0x9E3779B97F4A7C15ULL;
+    h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    h = (h ^ (h >> 27)) * 0x94D049BB133111EBULL;
+    h ^= h >> 31;
+    
+    size = (unsigned long long) (mphf->levels[level + 1] - mphf->levels[level]) * 8;
+    
+    /* The top 32 bits scaled to the level, which is cheaper than h % size */
+    return mphf->levels[level] * 8 + (long) (((h >> 32) * size) >> 32);
+}
+
+/* countBits
+ *
+ * @param   byte        byte to count
+ *
+ * @return  int         number of bits set in it
+ */
+
+int countBits(unsigned char byte)
+{
+    static const int nibble[16] = {0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4};
+    
+    return nibble[byte & 15] + nibble[byte >> 4];
+}
+
+/* countWords
+ *
+ * Counts the bits set in a run of bytes 8 at a time, which is how
+ * a rank gets through up to MPHF_RANK_BYTES bytes quickly. Which
+ * order the bytes end up in within a word makes no difference.
+ *
+ * @param   bytes       first byte
+ * @param   numbytes    number of bytes, a multiple of 8
+ *
+ * @return  unsigned int    number of bits set
+ */
+
+unsigned int countWords(unsigned char *bytes, long numbytes)
+{
+    unsigned long long x;
+    unsigned int ones;
+    long b;
+    
+    ones = 0;
+    
+    for(b = 0; b < numbytes; b += 8)
+    {
+        memcpy(&x, bytes + b, 8);
+        x = x - ((x >> 1) & 0x5555555555555555ULL);
+        x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+        x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+        ones += (unsigned int) ((x * 0x0101010101010101ULL) >> 56);
+    }
+    
+    return ones;
+}
+
+/* fillRanks
+ *
+ * Counts the bits set before every MPHF_RANK_BYTES bytes, so a
+ * rank never counts more than that many bytes, and the bits set
+ * in all.
+ *
+ * @param   mphf        Mphf object with its levels
+ *
+ * @return  success     1
+ * @return  failure     0
+ */
+
+int fillRanks(Mphf mphf)
+{
+    long numbytes, b;
+    unsigned int ones;
+    
+    numbytes = mphf->levels[mphf->numlevels];
+    
+    free(mphf->ranks);
+    mphf->ranks = (unsigned int*) malloc(sizeof(unsigned int) * (numbytes / MPHF_RANK_BYTES + 1));
+    if(mphf->ranks == NULL)
+    {
+        return 0;
+    }
+    
+    ones = 0;
+    
+    for(b = 0; b < numbytes; b++)
+    {
+        if(b % MPHF_RANK_BYTES == 0)
+        {
+            mphf->ranks[b / MPHF_RANK_BYTES] = ones;
+        }
+        ones += countBits(mphf->bits[b]);
+    }
+    
+    if(numbytes % MPHF_RANK_BYTES == 0)
+    {
+        mphf->ranks[numbytes / MPHF_RANK_BYTES] = ones;
+    }
+    
+    mphf->placed = (int) ones;
+    
+    return 1;
+}
+
+/* findSlot
+ *
+ * Walks the levels until a hashed term falls on a set bit, the
+ * bits set before it are its slot.
+ *
+ * @param   mphf        Mphf object with its levels and ranks
+ * @param   h           hash of the term (see hashKey)
+ *
+ * @return  found       the slot
+ * @return  not found   -1
+ */
+
+long findSlot(Mphf mphf, unsigned long long h)
+{
+    long bit, byte, b;
+    unsigned int rank;
+    int level;
+    
+    for(level = 0; level < mphf->numlevels; level++)
+    {
+        bit = levelBit(mphf, h, level);
+        byte = bit / 8;
+        
+        if((mphf->bits[byte] & (1 << (bit % 8))) == 0)
+        {
+            continue;
+        }
+        
+        b = byte - byte % MPHF_RANK_BYTES;
+        rank = mphf->ranks[byte / MPHF_RANK_BYTES] + countWords(mphf->bits + b, (byte - b) & ~7L);
+        
+        for(b += (byte - b) & ~7L; b < byte; b++)
+        {
+            rank += countBits(mphf->bits[b]);
+        }
+        
+        return (long) rank + countBits((unsigned char) (mphf->bits[byte] & ((1 << (bit % 8)) - 1)));
+    }
+    
+    return -1;
+}
+
+/* compSpills
+ *
+ * qsort and bsearch comparison of two spills by hash.
+ *
+ * @param   a           first Spill_
+ * @param   b           second Spill_
+ *
+ * @return  int         <0, 0 or >0
+ */
+
+int compSpills(const void *a, const void *b)
+{
+    unsigned long long x, y;
+    
+    x = ((const struct Spill_*) a)->key;
+    y = ((const struct Spill_*) b)->key;
+    
+    return (x > y) - (x < y);
+}
+
+/********************************
+ *       4. Mphf Functions      *
+ ********************************/
+
+/* createMphf
+ *
+ * Creates a minimal perfect hash to add the terms of a lexicon to,
+ * in lexicon order.
+ *
+ * @return  success         new Mphf
+ * @return  failure         NULL
+ */
+
+Mphf createMphf(void)
+{
+    Mphf mphf;
+    
+    mphf = (Mphf) malloc(sizeof(struct Mphf_));
+    if(mphf == NULL)
+    {
+        fprintf(stderr, "Error: Could not allocate space for a perfect hash.\n");
+        return NULL;
+    }
+    
+    mphf->keys = (unsigned long long*) malloc(sizeof(unsigned long long) * MPHF_SIZE);
+    mphf->count = 0;
+    mphf->capacity = MPHF_SIZE;
+    mphf->bits = NULL;
+    mphf->levels[0] = 0;
+    mphf->numlevels = 0;
+    mphf->ranks = NULL;
+    mphf->placed = 0;
+    mphf->slots = NULL;
+    mphf->prints = NULL;
+    mphf->spills = NULL;
+    mphf->numspills = 0;
+    
+    if(mphf->keys == NULL)
+    {
+        fprintf(stderr, "Error: Could not allocate space for a perfect hash.\n");
+        free(mphf);
+        return NULL;
+    }
+    
+    return mphf;
+}
+
+/* destroyMphf
+ *
+ * Frees a minimal perfect hash. NULL is ignored.
+ *
+ * @param   mphf            Mphf object
+ *
+ * @return  void
+ */
+
+void destroyMphf(Mphf mphf)
+{
+    if(mphf != NULL)
+    {
+        free(mphf->keys);
+        free(mphf->bits);
+        free(mphf->ranks);
+        free(mphf->slots);
+        free(mphf->prints);
+        free(mphf->spills);
+        free(mphf);
+    }
+}
+
+/* addMphf
+ *
+ * Adds a term to a hash being built. Terms are numbered in the
+ * order they are added, from 0.
+ *
+ * @param   mphf            Mphf object
+ * @param   term            term to add
+ *
+ * @return  success         1
+ * @return  failure         0
+ */
+
+int addMphf(Mphf mphf, char *term)
+{
+    unsigned long long *keys;
+    
+    if(mphf->count == mphf->capacity)
+    {
+        keys = (unsigned long long*) realloc(mphf->keys, sizeof(unsigned long long) * mphf->capacity * 2);
+        if(keys == NULL)
+        {
+            fprintf(stderr, "Error: Could not allocate space for a perfect hash.\n");
+            return 0;
+        }
+        mphf->keys = keys;
+        mphf->capacity *= 2;
+    }
+    
+    mphf->keys[mphf->count++] = hashKey(term);
+    
+    return 1;
+}
+
+/* buildMphf
+ *
+ * Builds the hash of the terms added to it, BBHash style: every
+ * term left is hashed to a bit of a level with one bit per term,
+ * the terms that got a bit of their own keep it and the others
+ * move on to the next level. Counting the bits set before a
+ * term's bit gives its slot, and each slot holds the number of
+ * its term and an 8 bit fingerprint of it. The levels take about
+ * 3 bits a term. Terms still left after MPHF_LEVELS levels (a
+ * handful at millions of terms) are kept with their whole hash in
+ * a table sorted by it.
+ *
+ * @param   mphf            Mphf object
+ *
+ * @return  success         1
+ * @return  clash           -1, two different terms share their
+ *                          whole 64 bit hash, so no hash can tell
+ *                          them apart
+ * @return  failure         0
+ */
+
+int buildMphf(Mphf mphf)
+{
+    unsigned char *bits, *level, *clashes;
+    int *left, numleft, kept, i;
+    long bytes, bit, b, slot;
+    
+    left = (int*) malloc(sizeof(int) * (mphf->count + 1));
+    if(left == NULL)
+    {
+        fprintf(stderr, "Error: Could not allocate space for a perfect hash.\n");
+        return 0;
+    }
+    
+    for(i = 0; i < mphf->count; i++)
+    {
+        left[i] = i;
+    }
+    numleft = mphf->count;
+    
+    mphf->numlevels = 0;
+    mphf->levels[0] = 0;
+    
+    while(numleft > 0 && mphf->numlevels < MPHF_LEVELS)
+    {
+        bytes = (numleft + 7) / 8;
+        
+        bits = (unsigned char*) realloc(mphf->bits, mphf->levels[mphf->numlevels] + bytes);
+        clashes = (unsigned char*) calloc(bytes, 1);
+        if(bits == NULL || clashes == NULL)
+        {
+            fprintf(stderr, "Error: Could not allocate space for a perfect hash.\n");
+            if(bits != NULL)
+            {
+                mphf->bits = bits;
+            }
+            free(clashes);
+            free(left);
+            return 0;
+        }
+        
+        mphf->bits = bits;
+        level = bits + mphf->levels[mphf->numlevels];
+        memset(level, 0, bytes);
+        mphf->levels[mphf->numlevels + 1] = mphf->levels[mphf->numlevels] + bytes;
+        
+        /* A bit two terms fall on is given to neither */
+        for(i = 0; i < numleft; i++)
+        {
+            bit = levelBit(mphf, mphf->keys[left[i]], mphf->numlevels) - mphf->levels[mphf->numlevels] * 8;
+            
+            if(level[bit / 8] & (1 << (bit % 8)))
+            {
+                clashes[bit / 8] |= (unsigned char) (1 << (bit % 8));
+            }
+            else
+            {
+                level[bit / 8] |= (unsigned char) (1 << (bit % 8));
+            }
+        }
+        
+        for(b = 0; b < bytes; b++)
+        {
+            level[b] &= (unsigned char) ~clashes[b];
+        }
+        
+        kept = 0;
+        
+        for(i = 0; i < numleft; i++)
+        {
+            bit = levelBit(mphf, mphf->keys[left[i]], mphf->numlevels) - mphf->levels[mphf->numlevels] * 8;
+            
+            if((level[bit / 8] & (1 << (bit % 8))) == 0)
+            {
+                left[kept++] = left[i];
+            }
+        }
+        
+        free(clashes);
+        numleft = kept;
+        mphf->numlevels++;
+    }
+    
+    /* The few terms every level clashed on are found by their whole hash */
+    free(mphf->spills);
+    mphf->spills = (Spill) malloc(sizeof(struct Spill_) * (numleft + 1));
+    mphf->numspills = numleft;
+    if(mphf->spills == NULL)
+    {
+        fprintf(stderr, "Error: Could not allocate space for a perfect hash.\n");
+        free(left);
+        return 0;
+    }
+    
+    for(i = 0; i < numleft; i++)
+    {
+        mphf->spills[i].key = mphf->keys[left[i]];
+        mphf->spills[i].term = left[i];
+    }
+    free(left);
+    
+    qsort(mphf->spills, numleft, sizeof(struct Spill_), compSpills);
+    
+    for(i = 1; i < numleft; i++)
+    {
+        if(mphf->spills[i].key == mphf->spills[i - 1].key)
+        {
+            return -1;
+        }
+    }
+    
+    if(fillRanks(mphf) == 0)
+    {
+        fprintf(stderr, "Error: Could not allocate space for a perfect hash.\n");
+        return 0;
+    }
+    
+    free(mphf->slots);
+    free(mphf->prints);
+    mphf->slots = (int*) malloc(sizeof(int) * (mphf->placed + 1));
+    mphf->prints = (unsigned char*) malloc(mphf->placed + 1);
+    if(mphf->slots == NULL || mphf->prints == NULL)
+    {
+        fprintf(stderr, "Error: Could not allocate space for a perfect hash.\n");
+        return 0;
+    }
+    
+    /* A spilled term clashed on every level, so it finds no slot */
+    for(i = 0; i < mphf->count; i++)
+    {
+        slot = findSlot(mphf, mphf->keys[i]);
+        if(slot >= 0)
+        {
+            mphf->slots[slot] = i;
+            mphf->prints[slot] = MPHF_FINGERPRINT(mphf->keys[i]);
+        }
+    }
+    
+    return 1;
+}
+
+/* writeMphf
+ *
+ * Builds the hash of the terms added to it (see buildMphf) and
+ * writes it next to an index. Should two terms share their whole
+ * 64 bit hash, which is as good as never, this is reported, no
+ * hash is written and the lexicon is searched as before.
+ *
+ * @param   mphf            Mphf object
+ * @param   index           name of the index
+ *
+ * @return  success         1
+ * @return  failure         0
+ */
+
+int writeMphf(Mphf mphf, char *index)
+{
+    FILE *file;
+    int i, res, ok;
+    
+    res = buildMphf(mphf);
+    if(res == 0)
+    {
+        return 0;
+    }
+    
+    /* Never leave the hash of an older lexicon behind */
+    if(res < 0)
+    {
+        fprintf(stderr, "Error: Two terms of %s share a hash, its lexicon is searched without one.\n", index);
+        return removeSidecar(index, MPHF_SUFFIX);
+    }
+    
+    file = openSidecar(index, MPHF_SUFFIX, "wb");
+    if(file == NULL)
+    {
+        fprintf(stderr, "Error: Could not create the perfect hash of %s.\n", index);
+        return 0;
+    }
+    
+    ok = writeVByte(file, mphf->count) && writeVByte(file, mphf->numlevels);
+    
+    for(i = 0; i < mphf->numlevels && ok; i++)
+    {
+        ok = writeVByte(file, mphf->levels[i + 1] - mphf->levels[i]);
+    }
+    
+    ok = ok && fwrite(mphf->bits, 1, mphf->levels[mphf->numlevels], file) == (size_t) mphf->levels[mphf->numlevels];
+    
+    for(i = 0; i < mphf->placed && ok; i++)
+    {
+        ok = writeVByte(file, mphf->slots[i]);
+    }
+    
+    ok = ok && fwrite(mphf->prints, 1, mphf->placed, file) == (size_t) mphf->placed;
+    ok = ok && writeVByte(file, mphf->numspills);
+    
+    for(i = 0; i < mphf->numspills && ok; i++)
+    {
+        ok = writeVByte(file, (unsigned int) (mphf->spills[i].key >> 32)) &&
+             writeVByte(file, (unsigned int) (mphf->spills[i].key & 0xFFFFFFFFULL)) &&
+             writeVByte(file, mphf->spills[i].term);
+    }
+    
+    if(fclose(file) != 0 || !ok)
+    {
+        fprintf(stderr, "Error: Could not write the perfect hash of %s.\n", index);
+        return 0;
+    }
+    
+    return 1;
+}
+
+/* loadMphf
+ *
+ * Loads the hash written next to an index (see writeMphf). A hash
+ * of some other number of terms than the lexicon's is left out.
+ *
+ * @param   index           name of the index
+ * @param   numkeys         number of terms in the index's lexicon
+ *
+ * @return  success         new Mphf
+ * @return  no hash         NULL
+ */
+
+Mphf loadMphf(char *index, int numkeys)
+{
+    Mphf mphf;
+    FILE *file;
+    unsigned int count, numlevels, value, high, low;
+    int i, ok;
+    
+    file = openSidecar(index, MPHF_SUFFIX, "rb");
+    if(file == NULL)
+    {
+        return NULL;
+    }
+    
+    if(readVByte(file, &count) == 0 || readVByte(file, &numlevels) == 0 || numlevels > MPHF_LEVELS)
+    {
+        fprintf(stderr, "Error: Malformed perfect hash file.\n");
+        fclose(file);
+        return NULL;
+    }
+    
+    /* A hash of some other lexicon would send terms to the wrong slots */
+    if(count != (unsigned int) numkeys)
+    {
+        fprintf(stderr, "Error: The perfect hash of %s does not match its lexicon.\n", index);
+        fclose(file);
+        return NULL;
+    }
+    
+    mphf = (Mphf) malloc(sizeof(struct Mphf_));
+    if(mphf == NULL)
+    {
+        fprintf(stderr, "Error: Could not allocate space for a perfect hash.\n");
+        fclose(file);
+        return NULL;
+    }
+    
+    mphf->keys = NULL;
+    mphf->count = (int) count;
+    mphf->capacity = 0;
+    mphf->bits = NULL;
+    mphf->levels[0] = 0;
+    mphf->numlevels = (int) numlevels;
+    mphf->ranks = NULL;
+    mphf->placed = 0;
+    mphf->slots = NULL;
+    mphf->prints = NULL;
+    mphf->spills = NULL;
+    mphf->numspills = 0;
+    
+    ok = 1;
+    
+    for(i = 0; i < mphf->numlevels && ok; i++)
+    {
+        ok = (readVByte(file, &value) == 1 && value > 0);
+        mphf->levels[i + 1] = mphf->levels[i] + (long) value;
+    }
+    
+    if(ok)
+    {
+        mphf->bits = (unsigned char*) malloc(mphf->levels[mphf->numlevels] + 1);
+        ok = (mphf->bits != NULL &&
+              fread(mphf->bits, 1, mphf->levels[mphf->numlevels], file) == (size_t) mphf->levels[mphf->numlevels] &&
+              fillRanks(mphf) && mphf->placed <= mphf->count);
+    }
+    
+    if(ok)
+    {
+        mphf->slots = (int*) malloc(sizeof(int) * (mphf->placed + 1));
+        mphf->prints = (unsigned char*) malloc(mphf->placed + 1);
+        ok = (mphf->slots != NULL && mphf->prints != NULL);
+    }
+    
+    for(i = 0; i < mphf->placed && ok; i++)
+    {
+        ok = (readVByte(file, &value) == 1 && value < count);
+        mphf->slots[i] = (int) value;
+    }
+    
+    ok = ok && fread(mphf->prints, 1, mphf->placed, file) == (size_t) mphf->placed;
+    
+    /* Every term has either a bit or a spill */
+    ok = ok && readVByte(file, &value) == 1 && value == count - (unsigned int) mphf->placed;
+    
+    if(ok)
+    {
+        mphf->numspills = (int) value;
+        mphf->spills = (Spill) malloc(sizeof(struct Spill_) * (value + 1));
+        ok = (mphf->spills != NULL);
+    }
+    
+    for(i = 0; i < mphf->numspills && ok; i++)
+    {
+        ok = (readVByte(file, &high) == 1 && readVByte(file, &low) == 1 && readVByte(file, &value) == 1 && value < count);
+        mphf->spills[i].key = ((unsigned long long) high << 32) | low;
+        mphf->spills[i].term = (int) value;
+    }
+    
+    fclose(file);
+    
+    if(!ok)
+    {
+        fprintf(stderr, "Error: Malformed perfect hash file.\n");
+        destroyMphf(mphf);
+        return NULL;
+    }
+    
+    return mphf;
+}
+
+/* mphfLookup
+ *
+ * Finds the number of a term with one hash per level tried (one
+ * or two for most terms), one count of bits and one check of the
+ * slot's fingerprint. A term that falls through every level is
+ * looked for in the table of terms left over. All but about 1 in
+ * 256 terms that were never added get -1, the rest some other
+ * term's number, so the caller has to check the term it gets.
+ *
+ * @param   mphf            Mphf object
+ * @param   term            term to find
+ *
+ * @return  found           number of the term
+ * @return  not found       -1
+ */
+
+int mphfLookup(Mphf mphf, char *term)
+{
+    struct Spill_ key;
+    Spill spill;
+    unsigned long long h;
+    long slot;
+    
+    h = hashKey(term);
+    slot = findSlot(mphf, h);
+    
+    if(slot < 0)
+    {
+        key.key = h;
+        spill = (mphf->numspills > 0) ?
+                (Spill) bsearch(&key, mphf->spills, mphf->numspills, sizeof(struct Spill_), compSpills) : NULL;
+        
+        return (spill != NULL) ? spill->term : -1;
+    }
+    
+    /* Most terms that were never added are caught here */
+    if(mphf->prints[slot] != MPHF_FINGERPRINT(h))
+    {
+        return -1;
+    }
+    
+    return mphf->slots[slot];
+}
@@ -0,0 +1,160 @@
+/*
+ * File: mphf.h
+ *
+ * Author: Mike Swift
+ * Email: theycallmeswift@gmail.com
+ * Date Created: May 15th, 2011
+ * Date Modified: May 15th, 2011
+ */
+
+#ifndef SWIFT_MPHF_H_
+#define SWIFT_MPHF_H_
+
+/********************************
+ *          1. Includes         *
+ ********************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "postings.h"
+
+/********************************
+ *          2. Constants        *
+ ********************************/
+
+/* Binary stream of the levels of a minimal perfect hash, the term and fingerprint of each slot, next to the index */
+#define MPHF_SUFFIX ".mph"
+
+/* Most levels a hash is built with, the few terms left after that are looked up in a sorted table */
+#ifndef MPHF_LEVELS
+#define MPHF_LEVELS 32
+#endif
+
+/* Bytes of bits between two counts of the bits set before them */
+#define MPHF_RANK_BYTES 64
+
+/* Fingerprint of a hashed term kept in its slot */
+#define MPHF_FINGERPRINT(h) ((unsigned char) ((h) & 0xFF))
+
+/* Initial number of terms a hash being built has room for (grows as needed) */
+#define MPHF_SIZE 1024
+
+/********************************
+ *      3. Structs & Typedefs   *
+ ********************************/
+
+struct Mphf_;
+typedef struct Mphf_* Mphf;
+
+/********************************
+ *       4. Mphf Functions      *
+ ********************************/
+
+/* createMphf
+ *
+ * Creates a minimal perfect hash to add the terms of a lexicon to,
+ * in lexicon order.
+ *
+ * @return  success         new Mphf
+ * @return  failure         NULL
+ */
+
+Mphf createMphf(void);
+
+/* destroyMphf
+ *
+ * Frees a minimal perfect hash. NULL is ignored.
+ *
+ * @param   mphf            Mphf object
+ *
+ * @return  void
+ */
+
+void destroyMphf(Mphf mphf);
+
+/* addMphf
+ *
+ * Adds a term to a hash being built. Terms are numbered in the
+ * order they are added, from 0.
+ *
+ * @param   mphf            Mphf object
+ * @param   term            term to add
+ *
+ * @return  success         1
+ * @return  failure         0
+ */
+
+int addMphf(Mphf mphf, char *term);
+
+/* buildMphf
+ *
+ * Builds the hash of the terms added to it, BBHash style: every
+ * term left is hashed to a bit of a level with one bit per term,
+ * the terms that got a bit of their own keep it and the others
+ * move on to the next level. Counting the bits set before a
+ * term's bit gives its slot, and each slot holds the number of
+ * its term and an 8 bit fingerprint of it. The levels take about
+ * 3 bits a term. Terms still left after MPHF_LEVELS levels (a
+ * handful at millions of terms) are kept with their whole hash in
+ * a table sorted by it.
+ *
+ * @param   mphf            Mphf object
+ *
+ * @return  success         1
+ * @return  clash           -1, two different terms share their
+ *                          whole 64 bit hash, so no hash can tell
+ *                          them apart
+ * @return  failure         0
+ */
+
+int buildMphf(Mphf mphf);
+
+/* writeMphf
+ *
+ * Builds the hash of the terms added to it (see buildMphf) and
+ * writes it next to an index. Should two terms share their whole
+ * 64 bit hash, which is as good as never, this is reported, no
+ * hash is written and the lexicon is searched as before.
+ *
+ * @param   mphf            Mphf object
+ * @param   index           name of the index
+ *
+ * @return  success         1
+ * @return  failure         0
+ */
+
+int writeMphf(Mphf mphf, char *index);
+
+/* loadMphf
+ *
+ * Loads the hash written next to an index (see writeMphf). A hash
+ * of some other number of terms than the lexicon's is left out.
+ *
+ * @param   index           name of the index
+ * @param   numkeys         number of terms in the index's lexicon
+ *
+ * @return  success         new Mphf
+ * @return  no hash         NULL
+ */
+
+Mphf loadMphf(char *index, int numkeys);
+
+/* mphfLookup
+ *
+ * Finds the number of a term with one hash per level tried (one
+ * or two for most terms), one count of bits and one check of the
+ * slot's fingerprint. A term that falls through every level is
+ * looked for in the table of terms left over. All but about 1 in
+ * 256 terms that were never added get -1, the rest some other
+ * term's number, so the caller has to check the term it gets.
+ *
+ * @param   mphf            Mphf object
+ * @param   term            term to find
+ *
+ * @return  found           number of the term
+ * @return  not found       -1
+ */
+
+int mphfLookup(Mphf mphf, char *term);
+
+#endif /* SWIFT_MPHF_H_ */
@@ -0,0 +1,786 @@
+/*
+ * File: plan.c
+ *
+ * Author: Mike Swift
+ * Email: theycallmeswift@gmail.com
+ * Date Created: May 14th, 2011
+ * Date Modified: May 14th, 2011
+ */
+
+/********************************
+ *          1. Includes         *
+ ********************************/
+
+#include "plan.h"
+
+/********************************
+ *      2. Helper Functions     *
+ ********************************/
+
+/* advanceTerm
+ *
+ * advancePlan for a leaf: gallops forward through its files, then
+ * bisects, so skipping far ahead costs a few probes.
+ *
+ * @param   node        leaf
+ * @param   target      smallest file number wanted
+ *
+ * @return  int         file number, PLAN_END if there is none
+ */
+
+int advanceTerm(PlanNode node, int target)
+{
+    int low, high, mid, step;
+    
+    low = node->pos;
+    step = 1;
+    high = low;
+    
+    /* Gallop until docs[high] >= target */
+    while(high < node->count && node->docs[high] < target)
+    {
+        low = high + 1;
+        high += step;
+        step *= 2;
+    }
+    
+    if(high > node->count)
+    {
+        high = node->count;
+    }
+    
+    /* Bisect the range [low, high] */
+    while(low < high)
+    {
+        mid = low + (high - low) / 2;
+        
+        if(node->docs[mid] < target)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+    
+    node->pos = low;
+    node->doc = (low < node->count) ? node->docs[low] : PLAN_END;
+    
+    return node->doc;
+}
+
+/* advanceBits
+ *
+ * advancePlan for a node with a bitmap: scans it for the next set
+ * bit, a word at a time.
+ *
+ * @param   node        node with a bitmap
+ * @param   target      smallest file number wanted
+ *
+ * @return  int         file number, PLAN_END if there is none
+ */
+
+int advanceBits(PlanNode node, int target)
+{
+    int doc;
+    
+    doc = nextBit(node->bits, node->numfiles, target);
+    node->doc = (doc < node->numfiles) ? doc : PLAN_END;
+    
+    return node->doc;
+}
+
+/* advanceAnd
+ *
+ * advancePlan for an AND: leapfrogs over the operands, cheapest
+ * first, until they all agree on a file.
+ *
+ * @param   node        AND node
+ * @param   target      smallest file number wanted
+ *
+ * @return  int         file number, PLAN_END if there is none
+ */
+
+int advanceAnd(PlanNode node, int target)
+{
+    int i, doc, agreed;
+    
+    doc = target;
+    agreed = 0;
+    i = 0;
+    
+    while(agreed < node->numchildren)
+    {
+        target = advancePlan(node->children[i], doc);
+        
+        if(target == PLAN_END)
+        {
+            doc = PLAN_END;
+            break;
+        }
+        
+        if(target > doc)
+        {
+            /* Everybody has to catch up to this one */
+            doc = target;
+            agreed = 1;
+        }
+        else
+        {
+            agreed++;
+        }
+        
+        i = (i + 1) % node->numchildren;
+    }
+    
+    node->doc = doc;
+    
+    return doc;
+}
+
+/* advanceOr
+ *
+ * advancePlan for an OR: the smallest file any operand is on.
+ *
+ * @param   node        OR node
+ * @param   target      smallest file number wanted
+ *
+ * @return  int         file number, PLAN_END if there is none
+ */
+
+int advanceOr(PlanNode node, int target)
+{
+    int i, doc, best;
+    
+    best = PLAN_END;
+    
+    for(i = 0; i < node->numchildren; i++)
+    {
+        doc = advancePlan(node->children[i], target);
+        if(doc < best)
+        {
+            best = doc;
+        }
+    }
+    
+    node->doc = best;
+    
+    return best;
+}
+
+/* advanceNot
+ *
+ * advancePlan for a NOT: the first file its operand is not on.
+ *
+ * @param   node        NOT node
+ * @param   target      smallest file number wanted
+ *
+ * @return  int         file number, PLAN_END if there is none
+ */
+
+int advanceNot(PlanNode node, int target)
+{
+    int doc;
+    
+    doc = target;
+    
+    while(doc < node->numfiles && advancePlan(node->children[0], doc) == doc)
+    {
+        doc++;
+    }
+    
+    node->doc = (doc < node->numfiles) ? doc : PLAN_END;
+    
+    return node->doc;
+}
+
+/********************************
+ *      3. Plan Functions       *
+ ********************************/
+
+/* createTermNode
+ *
+ * Creates a leaf of the plan from the postings of a query unit. The
+ * postings are copied into arrays sorted by file number, so a unit
+ * read from the index or the cache can be iterated the same way.
+ *
+ * @param   arena           query arena
+ * @param   leaf            number of the query unit
+ * @param   word            postings of the unit (NULL matches nothing)
+ *
+ * @return  success         new PlanNode
+ * @return  failure         NULL
+ */
+
+PlanNode createTermNode(Arena arena, int leaf, Word word)
+{
+    PlanNode node;
+    Entry ent, *entries;
+    int i, count;
+    
+    node = (PlanNode) arenaAlloc(arena, sizeof(struct PlanNode_));
+    if(node == NULL)
+    {
+        return NULL;
+    }
+    
+    count = 0;
+    if(word != NULL)
+    {
+        for(ent = word->head; ent != NULL; ent = ent->next)
+        {
+            count++;
+        }
+    }
+    
+    node->type = PLAN_TERM;
+    node->doc = PLAN_START;
+    node->cost = count;
+    node->leaf = leaf;
+    node->count = count;
+    node->pos = 0;
+    node->blocklast = NULL;
+    node->blockmax = NULL;
+    node->numblocks = 0;
+    node->block = 0;
+    node->children = NULL;
+    node->numchildren = 0;
+    node->bits = NULL;
+    node->numfiles = 0;
+    
+    /* One extra slot keeps the arena from being asked for 0 bytes */
+    entries = (Entry*) arenaAlloc(arena, sizeof(Entry) * (count + 1));
+    node->docs = (int*) arenaAlloc(arena, sizeof(int) * (count + 1));
+    node->freqs = (int*) arenaAlloc(arena, sizeof(int) * (count + 1));
+    if(entries == NULL || node->docs == NULL || node->freqs == NULL)
+    {
+        return NULL;
+    }
+    
+    i = 0;
+    if(word != NULL)
+    {
+        for(ent = word->head; ent != NULL; ent = ent->next)
+        {
+            entries[i] = ent;
+            i++;
+        }
+    }
+    
+    /* The index keeps postings by frequency, iterators need file order */
+    qsort(entries, count, sizeof(Entry), compEntryFiles);
+    
+    for(i = 0; i < count; i++)
+    {
+        node->docs[i] = entries[i]->filenumber;
+        node->freqs[i] = entries[i]->frequency;
+    }
+    
+    return node;
+}
+
+/* createOperatorNode
+ *
+ * Creates an AND, OR or NOT node. Operands of the same kind are
+ * flattened into it ("a AND (b AND c)" becomes one AND of three).
+ * NOT takes exactly one operand.
+ *
+ * @param   arena           query arena
+ * @param   type            PLAN_AND, PLAN_OR or PLAN_NOT
+ * @param   children        operands
+ * @param   numchildren     number of operands
+ *
+ * @return  success         new PlanNode
+ * @return  failure         NULL
+ */
+
+PlanNode createOperatorNode(Arena arena, int type, PlanNode *children, int numchildren)
+{
+    PlanNode node;
+    int i, j, n;
+    
+    if(numchildren < 1 || (type == PLAN_NOT && numchildren != 1))
+    {
+        fprintf(stderr, "Error: Wrong number of operands for query operator.\n");
+        return NULL;
+    }
+    
+    node = (PlanNode) arenaAlloc(arena, sizeof(struct PlanNode_));
+    if(node == NULL)
+    {
+        return NULL;
+    }
+    
+    n = 0;
+    for(i = 0; i < numchildren; i++)
+    {
+        n += (type != PLAN_NOT && children[i]->type == type) ? children[i]->numchildren : 1;
+    }
+    
+    node->children = (PlanNode*) arenaAlloc(arena, sizeof(PlanNode) * n);
+    if(node->children == NULL)
+    {
+        return NULL;
+    }
+    
+    n = 0;
+    for(i = 0; i < numchildren; i++)
+    {
+        if(type != PLAN_NOT && children[i]->type == type)
+        {
+            for(j = 0; j < children[i]->numchildren; j++)
+            {
+                node->children[n] = children[i]->children[j];
+                n++;
+            }
+        }
+        else
+        {
+            node->children[n] = children[i];
+            n++;
+        }
+    }
+    
+    node->type = type;
+    node->doc = PLAN_START;
+    node->cost = 0;
+    node->leaf = -1;
+    node->docs = NULL;
+    node->freqs = NULL;
+    node->count = 0;
+    node->pos = 0;
+    node->blocklast = NULL;
+    node->blockmax = NULL;
+    node->numblocks = 0;
+    node->block = 0;
+    node->numchildren = n;
+    node->bits = NULL;
+    node->numfiles = 0;
+    
+    return node;
+}
+
+/* optimizePlan
+ *
+ * Estimates how many files every node matches and reorders the
+ * operands of each AND cheapest first, so the rarest operand leads
+ * the intersection and negated operands only check what is left.
+ * Also rewinds every node to PLAN_START.
+ *
+ * @param   node            root of the plan
+ * @param   numfiles        number of files in the index
+ *
+ * @return  void
+ */
+
+void optimizePlan(PlanNode node, int numfiles)
+{
+    PlanNode tmp;
+    int i, j;
+    
+    node->doc = PLAN_START;
+    node->pos = 0;
+    node->block = 0;
+    node->numfiles = numfiles;
+    
+    for(i = 0; i < node->numchildren; i++)
+    {
+        optimizePlan(node->children[i], numfiles);
+    }
+    
+    switch(node->type)
+    {
+        case PLAN_TERM:
+            node->cost = node->count;
+            break;
+        
+        case PLAN_NOT:
+            node->cost = numfiles - node->children[0]->cost;
+            if(node->cost < 0)
+            {
+                node->cost = 0;
+            }
+            break;
+        
+        case PLAN_OR:
+            node->cost = 0;
+            for(i = 0; i < node->numchildren; i++)
+            {
+                node->cost += node->children[i]->cost;
+            }
+            if(node->cost > numfiles)
+            {
+                node->cost = numfiles;
+            }
+            break;
+        
+        case PLAN_AND:
+            /* Cheapest first, equal costs keep their query order */
+            for(i = 1; i < node->numchildren; i++)
+            {
+                for(j = i; j > 0 && node->children[j]->cost < node->children[j - 1]->cost; j--)
+                {
+                    tmp = node->children[j];
+                    node->children[j] = node->children[j - 1];
+                    node->children[j - 1] = tmp;
+                }
+            }
+            node->cost = node->children[0]->cost;
+            break;
+    }
+}
+
+/* advancePlan
+ *
+ * Moves a node to the first file it matches that is not below
+ * target. Nothing is evaluated until it is asked for, and a node
+ * never moves backwards.
+ *
+ * @param   node            plan node
+ * @param   target          smallest file number wanted
+ *
+ * @return  int             file number, PLAN_END if there is none
+ */
+
+int advancePlan(PlanNode node, int target)
+{
+    if(node->doc >= target)
+    {
+        return node->doc;
+    }
+    
+    if(node->bits != NULL)
+    {
+        return advanceBits(node, target);
+    }
+    
+    switch(node->type)
+    {
+        case PLAN_TERM:
+            return advanceTerm(node, target);
+        
+        case PLAN_AND:
+            /* An AND of leaves has its own list (see intersectLeaves) */
+            if(node->docs != NULL)
+            {
+                return advanceTerm(node, target);
+            }
+            return advanceAnd(node, target);
+        
+        case PLAN_OR:
+            return advanceOr(node, target);
+        
+        case PLAN_NOT:
+            return advanceNot(node, target);
+    }
+    
+    return PLAN_END;
+}
+
+/* matchingLeaves
+ *
+ * Collects the leaves that match the file the plan is on, the ones
+ * that contribute to its score. Negated leaves never do.
+ *
+ * @param   node            plan node
+ * @param   doc             file the plan is on
+ * @param   leaves          where to store the leaves
+ * @param   count           number of leaves stored so far
+ *
+ * @return  int             new number of leaves stored
+ */
+
+int matchingLeaves(PlanNode node, int doc, PlanNode *leaves, int count)
+{
+    int i;
+    
+    if(node->doc != doc || node->type == PLAN_NOT)
+    {
+        return count;
+    }
+    
+    /* A node with a bitmap, or an AND with a list, left its operands (or files) behind */
+    if(node->bits != NULL || (node->type == PLAN_AND && node->docs != NULL))
+    {
+        if(node->type == PLAN_TERM)
+        {
+            advanceTerm(node, doc);
+        }
+        
+        for(i = 0; i < node->numchildren; i++)
+        {
+            advancePlan(node->children[i], doc);
+        }
+    }
+    
+    if(node->type == PLAN_TERM)
+    {
+        leaves[count] = node;
+        return count + 1;
+    }
+    
+    for(i = 0; i < node->numchildren; i++)
+    {
+        count = matchingLeaves(node->children[i], doc, leaves, count);
+    }
+    
+    return count;
+}
+
+/* computeBlockMaxima
+ *
+ * Cuts a leaf's files into blocks of BLOCK_SIZE and finds the
+ * highest frequency in each, for units that have no summary in
+ * the index (see writeBlockMaxima).
+ *
+ * @param   arena           query arena
+ * @param   node            leaf
+ *
+ * @return  success         1
+ * @return  failure         0
+ */
+
+int computeBlockMaxima(Arena arena, PlanNode node)
+{
+    int i, b;
+    
+    node->numblocks = NUM_BLOCKS(node->count);
+    node->block = 0;
+    node->blocklast = (int*) arenaAlloc(arena, sizeof(int) * (node->numblocks + 1));
+    node->blockmax = (int*) arenaAlloc(arena, sizeof(int) * (node->numblocks + 1));
+    if(node->blocklast == NULL || node->blockmax == NULL)
+    {
+        return 0;
+    }
+    
+    for(i = 0; i < node->count; i++)
+    {
+        b = i / BLOCK_SIZE;
+        
+        if(i % BLOCK_SIZE == 0 || node->freqs[i] > node->blockmax[b])
+        {
+            node->blockmax[b] = node->freqs[i];
+        }
+        node->blocklast[b] = node->docs[i];
+    }
+    
+    return 1;
+}
+
+/* shallowAdvance
+ *
+ * Moves a leaf's block cursor to the block that would hold target,
+ * without touching the files themselves. Only the block summaries
+ * are read, so this is how a top-k search checks what a stretch of
+ * files could score before it looks at any of them.
+ *
+ * @param   node            leaf with blocks
+ * @param   target          file number
+ *
+ * @return  int             block number, numblocks if every block
+ *                          ends before target
+ */
+
+int shallowAdvance(PlanNode node, int target)
+{
+    while(node->block < node->numblocks && node->blocklast[node->block] < target)
+    {
+        node->block++;
+    }
+    
+    return node->block;
+}
+
+/* combineBitmaps
+ *
+ * Gives every AND, OR and NOT whose operands all have bitmaps (the
+ * leaves of common words, see readContainers) a bitmap of its own,
+ * worked out a word at a time. Such a node then finds its next
+ * file by scanning its bitmap, and its operands are only caught up
+ * on the files it matches (see matchingLeaves). Expects a plan that
+ * went through optimizePlan.
+ *
+ * @param   arena           query arena
+ * @param   node            plan node
+ *
+ * @return  success         1
+ * @return  failure         0
+ */
+
+int combineBitmaps(Arena arena, PlanNode node)
+{
+    int i, j, words;
+    
+    for(i = 0; i < node->numchildren; i++)
+    {
+        if(combineBitmaps(arena, node->children[i]) == 0)
+        {
+            return 0;
+        }
+    }
+    
+    if(node->type == PLAN_TERM)
+    {
+        return 1;
+    }
+    
+    for(i = 0; i < node->numchildren; i++)
+    {
+        if(node->children[i]->bits == NULL)
+        {
+            return 1;
+        }
+    }
+    
+    words = BITMAP_WORDS(node->numfiles);
+    node->bits = (unsigned long*) arenaAlloc(arena, sizeof(unsigned long) * (words + 1));
+    if(node->bits == NULL)
+    {
+        return 0;
+    }
+    
+    memcpy(node->bits, node->children[0]->bits, sizeof(unsigned long) * words);
+    
+    for(i = 1; i < node->numchildren; i++)
+    {
+        for(j = 0; j < words; j++)
+        {
+            if(node->type == PLAN_AND)
+            {
+                node->bits[j] &= node->children[i]->bits[j];
+            }
+            else
+            {
+                node->bits[j] |= node->children[i]->bits[j];
+            }
+        }
+    }
+    
+    if(node->type == PLAN_NOT)
+    {
+        for(j = 0; j < words; j++)
+        {
+            node->bits[j] = ~node->bits[j];
+        }
+        
+        /* Nothing past the last file */
+        if(node->numfiles % BITS_PER_WORD != 0)
+        {
+            node->bits[words - 1] &= (1UL << (node->numfiles % BITS_PER_WORD)) - 1;
+        }
+    }
+    
+    return 1;
+}
+
+/* intersectLeaves
+ *
+ * Works out up front the files of every AND whose operands are all
+ * leaves: their lists are intersected two at a time, cheapest
+ * first, with intersectSorted, and whatever is left is checked
+ * against the bitmaps of the common ones. Such a node then steps
+ * through its own list, and its operands are only caught up on the
+ * files it matches (see matchingLeaves). Expects a plan that went
+ * through combineBitmaps.
+ *
+ * @param   arena           query arena
+ * @param   node            plan node
+ *
+ * @return  success         1
+ * @return  failure         0
+ */
+
+int intersectLeaves(Arena arena, PlanNode node)
+{
+    PlanNode child;
+    int *list, *spare, *tmp;
+    int i, j, n, size, first;
+    
+    for(i = 0; i < node->numchildren; i++)
+    {
+        if(intersectLeaves(arena, node->children[i]) == 0)
+        {
+            return 0;
+        }
+    }
+    
+    if(node->type != PLAN_AND || node->bits != NULL)
+    {
+        return 1;
+    }
+    
+    /* Only leaves, and at least one without a bitmap to lead */
+    first = -1;
+    for(i = 0; i < node->numchildren; i++)
+    {
+        child = node->children[i];
+        
+        if(child->type != PLAN_TERM)
+        {
+            return 1;
+        }
+        
+        if(child->bits == NULL && first < 0)
+        {
+            first = i;
+        }
+    }
+    
+    if(first < 0)
+    {
+        return 1;
+    }
+    
+    /* The cheapest list bounds the result, the kernels need some slack past it */
+    size = node->children[first]->count + INTERSECT_SLACK;
+    list = (int*) arenaAlloc(arena, sizeof(int) * size);
+    spare = (int*) arenaAlloc(arena, sizeof(int) * size);
+    if(list == NULL || spare == NULL)
+    {
+        return 0;
+    }
+    
+    n = node->children[first]->count;
+    memcpy(list, node->children[first]->docs, sizeof(int) * n);
+    
+    for(i = first + 1; i < node->numchildren && n > 0; i++)
+    {
+        child = node->children[i];
+        
+        if(child->bits == NULL)
+        {
+            n = intersectSorted(list, n, child->docs, child->count, spare);
+            tmp = list;
+            list = spare;
+            spare = tmp;
+        }
+    }
+    
+    /* Common words only need a bit tested */
+    for(i = 0; i < node->numchildren; i++)
+    {
+        child = node->children[i];
+        
+        if(child->bits != NULL)
+        {
+            size = 0;
+            for(j = 0; j < n; j++)
+            {
+                if(child->bits[list[j] / BITS_PER_WORD] & (1UL << (list[j] % BITS_PER_WORD)))
+                {
+                    list[size] = list[j];
+                    size++;
+                }
+            }
+            n = size;
+        }
+    }
+    
+    node->docs = list;
+    node->count = n;
+    node->pos = 0;
+    node->cost = n;
+    
+    return 1;
+}
@@ -0,0 +1,245 @@
+/*
+ * File: plan.h
+ *
+ * Author: Mike Swift
+ * Email: theycallmeswift@gmail.com
+ * Date Created: May 14th, 2011
+ * Date Modified: May 14th, 2011
+ */
+
+#ifndef SWIFT_PLAN_H_
+#define SWIFT_PLAN_H_
+
+/********************************
+ *          1. Includes         *
+ ********************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include "arena.h"
+#include "blockmax.h"
+#include "intersect.h"
+#include "roaring.h"
+#include "words.h"
+
+/********************************
+ *          2. Constants        *
+ ********************************/
+
+/* Kinds of PlanNode */
+#define PLAN_TERM 0
+#define PLAN_AND 1
+#define PLAN_OR 2
+#define PLAN_NOT 3
+
+/* Document a node is on before it has been advanced */
+#define PLAN_START -1
+
+/* Document a node is on once it has run out of matches */
+#define PLAN_END INT_MAX
+
+/********************************
+ *      3. Structs & Typedefs   *
+ ********************************/
+
+struct PlanNode_;
+typedef struct PlanNode_* PlanNode;
+
+/* PlanNode_
+ *
+ * One node of a compiled query. Every node is an iterator over the
+ * files it matches, in file number order (see advancePlan).
+ *
+ * @param   type        PLAN_TERM, PLAN_AND, PLAN_OR or PLAN_NOT
+ * @param   doc         file the node is on
+ * @param   cost        estimated number of files it matches
+ * @param   leaf        number of the query unit (terms only)
+ * @param   docs        files holding the unit, ascending (terms, and
+ *                      ANDs of terms, see intersectLeaves)
+ * @param   freqs       frequency in each of those files (terms only)
+ * @param   count       number of files in docs
+ * @param   pos         current index into docs
+ * @param   blocklast   last file of each block (terms only, see
+ *                      shallowAdvance)
+ * @param   blockmax    highest frequency in each block (terms only)
+ * @param   numblocks   number of blocks (terms only)
+ * @param   block       current block (terms only)
+ * @param   children    operands (operators only)
+ * @param   numchildren number of operands (operators only)
+ * @param   bits        bitmap of the files the node matches, the
+ *                      node skips through it instead of its
+ *                      operands or files (see combineBitmaps)
+ * @param   numfiles    number of files in the index (NOT and
+ *                      bitmaps only)
+ */
+
+struct PlanNode_ {
+    int type;
+    int doc;
+    int cost;
+    int leaf;
+    int *docs;
+    int *freqs;
+    int count;
+    int pos;
+    int *blocklast;
+    int *blockmax;
+    int numblocks;
+    int block;
+    PlanNode *children;
+    int numchildren;
+    unsigned long *bits;
+    int numfiles;
+};
+
+/********************************
+ *      4. Plan Functions       *
+ ********************************/
+
+/* createTermNode
+ *
+ * Creates a leaf of the plan from the postings of a query unit. The
+ * postings are copied into arrays sorted by file number, so a unit
+ * read from the index or the cache can be iterated the same way.
+ *
+ * @param   arena           query arena
+ * @param   leaf            number of the query unit
+ * @param   word            postings of the unit (NULL matches nothing)
+ *
+ * @return  success         new PlanNode
+ * @return  failure         NULL
+ */
+
+PlanNode createTermNode(Arena arena, int leaf, Word word);
+
+/* createOperatorNode
+ *
+ * Creates an AND, OR or NOT node. Operands of the same kind are
+ * flattened into it ("a AND (b AND c)" becomes one AND of three).
+ * NOT takes exactly one operand.
+ *
+ * @param   arena           query arena
+ * @param   type            PLAN_AND, PLAN_OR or PLAN_NOT
+ * @param   children        operands
+ * @param   numchildren     number of operands
+ *
+ * @return  success         new PlanNode
+ * @return  failure         NULL
+ */
+
+PlanNode createOperatorNode(Arena arena, int type, PlanNode *children, int numchildren);
+
+/* optimizePlan
+ *
+ * Estimates how many files every node matches and reorders the
+ * operands of each AND cheapest first, so the rarest operand leads
+ * the intersection and negated operands only check what is left.
+ * Also rewinds every node to PLAN_START.
+ *
+ * @param   node            root of the plan
+ * @param   numfiles        number of files in the index
+ *
+ * @return  void
+ */
+
+void optimizePlan(PlanNode node, int numfiles);
+
+/* advancePlan
+ *
+ * Moves a node to the first file it matches that is not below
+ * target. Nothing is evaluated until it is asked for, and a node
+ * never moves backwards.
+ *
+ * @param   node            plan node
+ * @param   target          smallest file number wanted
+ *
+ * @return  int             file number, PLAN_END if there is none
+ */
+
+int advancePlan(PlanNode node, int target);
+
+/* matchingLeaves
+ *
+ * Collects the leaves that match the file the plan is on, the ones
+ * that contribute to its score. Negated leaves never do.
+ *
+ * @param   node            plan node
+ * @param   doc             file the plan is on
+ * @param   leaves          where to store the leaves
+ * @param   count           number of leaves stored so far
+ *
+ * @return  int             new number of leaves stored
+ */
+
+int matchingLeaves(PlanNode node, int doc, PlanNode *leaves, int count);
+
+/* computeBlockMaxima
+ *
+ * Cuts a leaf's files into blocks of BLOCK_SIZE and finds the
+ * highest frequency in each, for units that have no summary in
+ * the index (see writeBlockMaxima).
+ *
+ * @param   arena           query arena
+ * @param   node            leaf
+ *
+ * @return  success         1
+ * @return  failure         0
+ */
+
+int computeBlockMaxima(Arena arena, PlanNode node);
+
+/* shallowAdvance
+ *
+ * Moves a leaf's block cursor to the block that would hold target,
+ * without touching the files themselves. Only the block summaries
+ * are read, so this is how a top-k search checks what a stretch of
+ * files could score before it looks at any of them.
+ *
+ * @param   node            leaf with blocks
+ * @param   target          file number
+ *
+ * @return  int             block number, numblocks if every block
+ *                          ends before target
+ */
+
+int shallowAdvance(PlanNode node, int target);
+
+/* combineBitmaps
+ *
+ * Gives every AND, OR and NOT whose operands all have bitmaps (the
+ * leaves of common words, see readContainers) a bitmap of its own,
+ * worked out a word at a time. Such a node then finds its next
+ * file by scanning its bitmap, and its operands are only caught up
+ * on the files it matches (see matchingLeaves). Expects a plan that
+ * went through optimizePlan.
+ *
+ * @param   arena           query arena
+ * @param   node            plan node
+ *
+ * @return  success         1
+ * @return  failure         0
+ */
+
+int combineBitmaps(Arena arena, PlanNode node);
+
+/* intersectLeaves
+ *
+ * Works out up front the files of every AND whose operands are all
+ * leaves: their lists are intersected two at a time, cheapest
+ * first, with intersectSorted, and whatever is left is checked
+ * against the bitmaps of the common ones. Such a node then steps
+ * through its own list, and its operands are only caught up on the
+ * files it matches (see matchingLeaves). Expects a plan that went
+ * through combineBitmaps.
+ *
+ * @param   arena           query arena
+ * @param   node            plan node
+ *
+ * @return  success         1
+ * @return  failure         0
+ */
+
+int intersectLeaves(Arena arena, PlanNode node);
+
+#endif /* SWIFT_PLAN_H_ */
@@ -0,0 +1,291 @@
+/*
+ * File: pool.c
+ *
+ * Author: Mike Swift
+ * Email: theycallmeswift@gmail.com
+ * Date Created: May 10th, 2011
+ * Date Modified: May 10th, 2011
+ */
+
+/********************************
+ *          1. Includes         *
+ ********************************/
+
+#include "pool.h"
+
+/********************************
+ *          2. Structs          *
+ ********************************/
+
+/* PoolAlign_
+ *
+ * Items are rounded up to a multiple of this union so every item
+ * is aligned for any of the node types stored in a pool.
+ */
+
+union PoolAlign_ {
+    long l;
+    double d;
+    void *p;
+};
+
+/* Slab_
+ *
+ * @param   next        next slab in the pool
+ *
+ * The items follow the header in the same allocation.
+ */
+
+struct Slab_ {
+    Slab next;
+    union PoolAlign_ align;
+};
+
+/* Pool_
+ *
+ * @param   itemSize    rounded size of an item
+ * @param   slabItems   number of items per slab
+ * @param   head        first slab
+ * @param   curr        slab currently being carved up
+ * @param   used        items carved out of curr so far
+ * @param   freed       list of items given back with poolFree
+ */
+
+struct Pool_ {
+    size_t itemSize;
+    int slabItems;
+    Slab head;
+    Slab curr;
+    int used;
+    void *freed;
+};
+
+/********************************
+ *      3. Helper Functions     *
+ ********************************/
+
+/* slabItem
+ *
+ * Returns a pointer to the i-th item of a slab.
+ *
+ * @param   pool        pool the slab belongs to
+ * @param   slab        slab
+ * @param   i           item number
+ *
+ * @return  void*       item
+ */
+
+void *slabItem(Pool pool, Slab slab, int i)
+{
+    return (char*) &slab->align + pool->itemSize * i;
+}
+
+/* createSlab
+ *
+ * Allocates a new slab and links it after the current one.
+ *
+ * @param   pool        pool to grow
+ *
+ * @return  success     new Slab
+ * @return  failure     NULL
+ */
+
+Slab createSlab(Pool pool)
+{
+    Slab slab;
+    
+    slab = (Slab) malloc(sizeof(struct Slab_) + pool->itemSize * pool->slabItems);
+    if(slab == NULL)
+    {
+        fprintf(stderr, "Error: Could not allocate space for slab.\n");
+        return NULL;
+    }
+    
+    slab->next = NULL;
+    
+    if(pool->curr == NULL)
+    {
+        pool->head = slab;
+    }
+    else
+    {
+        slab->next = pool->curr->next;
+        pool->curr->next = slab;
+    }
+    
+    return slab;
+}
+
+/********************************
+ *      4. Pool Functions       *
+ ********************************/
+
+/* createPool
+ *
+ * Creates a pool of fixed-size items. Items are carved out of
+ * large slabs, so one malloc covers many nodes and nodes that
+ * are used together sit next to each other in memory.
+ *
+ * @param   itemSize        size of a single item in bytes
+ * @param   slabItems       number of items per slab
+ *
+ * @return  success         new Pool
+ * @return  failure         NULL
+ */
+
+Pool createPool(size_t itemSize, int slabItems)
+{
+    Pool pool;
+    size_t align;
+    
+    if(itemSize == 0 || slabItems <= 0)
+    {
+        fprintf(stderr, "Error: Pool items and slabs must have a size.\n");
+        return NULL;
+    }
+    
+    pool = (Pool) malloc(sizeof(struct Pool_));
+    if(pool == NULL)
+    {
+        fprintf(stderr, "Error: Could not allocate space for pool.\n");
+        return NULL;
+    }
+    
+    /* Round up so every item is aligned (and can hold the free list link) */
+    align = sizeof(union PoolAlign_);
+    pool->itemSize = ((itemSize + align - 1) / align) * align;
+    
+    pool->slabItems = slabItems;
+    pool->head = NULL;
+    pool->curr = NULL;
+    pool->used = 0;
+    pool->freed = NULL;
+    
+    return pool;
+}
+
+/* destroyPool
+ *
+ * Releases every slab in the pool at once. Any item that was
+ * handed out is invalid afterwards. NULL is ignored.
+ *
+ * @param   pool            pool to destroy
+ *
+ * @return  void
+ */
+
+void destroyPool(Pool pool)
+{
+    Slab curr, next;
+    
+    if(pool != NULL)
+    {
+        curr = pool->head;
+        while(curr != NULL)
+        {
+            next = curr->next;
+            free(curr);
+            curr = next;
+        }
+        
+        free(pool);
+    }
+}
+
+/* poolAlloc
+ *
+ * Hands out one item, reusing freed items first. The memory is
+ * not cleared.
+ *
+ * @param   pool            pool to allocate from
+ *
+ * @return  success         pointer to the item
+ * @return  failure         NULL
+ */
+
+void *poolAlloc(Pool pool)
+{
+    void *item;
+    
+    if(pool == NULL)
+    {
+        fprintf(stderr, "Error: Cannot allocate from NULL pool.\n");
+        return NULL;
+    }
+    
+    /* Reuse a freed item first */
+    if(pool->freed != NULL)
+    {
+        item = pool->freed;
+        pool->freed = *(void**) item;
+        return item;
+    }
+    
+    /* Move on to the next slab (kept by resetPool or brand new) when full */
+    if(pool->curr == NULL || pool->used == pool->slabItems)
+    {
+        if(pool->curr != NULL && pool->curr->next != NULL)
+        {
+            pool->curr = pool->curr->next;
+        }
+        else if(pool->curr == NULL && pool->head != NULL)
+        {
+            pool->curr = pool->head;
+        }
+        else
+        {
+            pool->curr = createSlab(pool);
+            if(pool->curr == NULL)
+            {
+                return NULL;
+            }
+        }
+        
+        pool->used = 0;
+    }
+    
+    item = slabItem(pool, pool->curr, pool->used);
+    pool->used++;
+    
+    return item;
+}
+
+/* poolFree
+ *
+ * Returns a single item to the pool so the next poolAlloc can
+ * reuse it. The item must have come from the same pool.
+ *
+ * @param   pool            pool the item came from
+ * @param   item            item to give back
+ *
+ * @return  void
+ */
+
+void poolFree(Pool pool, void *item)
+{
+    if(pool != NULL && item != NULL)
+    {
+        *(void**) item = pool->freed;
+        pool->freed = item;
+    }
+}
+
+/* resetPool
+ *
+ * Forgets every item handed out but keeps the slabs, so the
+ * pool can be refilled without going back to malloc.
+ *
+ * @param   pool            pool to reset
+ *
+ * @return  void
+ */
+
+void resetPool(Pool pool)
+{
+    if(pool != NULL)
+    {
+        pool->curr = NULL;
+        pool->used = 0;
+        pool->freed = NULL;
+    }
+}
@@ -0,0 +1,105 @@
+/*
+ * File: pool.h
+ *
+ * Author: Mike Swift
+ * Email: theycallmeswift@gmail.com
+ * Date Created: May 10th, 2011
+ * Date Modified: May 10th, 2011
+ */
+
+#ifndef SWIFT_POOL_H_
+#define SWIFT_POOL_H_
+
+/********************************
+ *          1. Includes         *
+ ********************************/
+#include <stdio.h>
+#include <stdlib.h>
+
+/********************************
+ *          2. Constants        *
+ ********************************/
+
+/* Default number of items carved out of each slab */
+#define POOL_SLAB_ITEMS 1024
+
+/********************************
+ *      3. Structs & Typedefs   *
+ ********************************/
+
+struct Slab_;
+typedef struct Slab_* Slab;
+
+struct Pool_;
+typedef struct Pool_* Pool;
+
+/********************************
+ *      4. Pool Functions       *
+ ********************************/
+
+/* createPool
+ *
+ * Creates a pool of fixed-size items. Items are carved out of
+ * large slabs, so one malloc covers many nodes and nodes that
+ * are used together sit next to each other in memory.
+ *
+ * @param   itemSize        size of a single item in bytes
+ * @param   slabItems       number of items per slab
+ *
+ * @return  success         new Pool
+ * @return  failure         NULL
+ */
+
+Pool createPool(size_t itemSize, int slabItems);
+
+/* destroyPool
+ *
+ * Releases every slab in the pool at once. Any item that was
+ * handed out is invalid afterwards. NULL is ignored.
+ *
+ * @param   pool            pool to destroy
+ *
+ * @return  void
+ */
+
+void destroyPool(Pool pool);
+
+/* poolAlloc
+ *
+ * Hands out one item, reusing freed items first. The memory is
+ * not cleared.
+ *
+ * @param   pool            pool to allocate from
+ *
+ * @return  success         pointer to the item
+ * @return  failure         NULL
+ */
+
+void *poolAlloc(Pool pool);
+
+/* poolFree
+ *
+ * Returns a single item to the pool so the next poolAlloc can
+ * reuse it. The item must have come from the same pool.
+ *
+ * @param   pool            pool the item came from
+ * @param   item            item to give back
+ *
+ * @return  void
+ */
+
+void poolFree(Pool pool, void *item);
+
+/* resetPool
+ *
+ * Forgets every item handed out but keeps the slabs, so the
+ * pool can be refilled without going back to malloc.
+ *
+ * @param   pool            pool to reset
+ *
+ * @return  void
+ */
+
+void resetPool(Pool pool);
+
+#endif /* SWIFT_POOL_H_ */
@@ -0,0 +1,235 @@
+/*
+ * File: postings.c
+ *
+ * Author: Mike Swift
+ * Email: theycallmeswift@gmail.com
+ * Date Created: May 12th, 2011
+ * Date Modified: May 12th, 2011
+ */
+
+/********************************
+ *          1. Includes         *
+ ********************************/
+
+#include "postings.h"
+
+/********************************
+ *      2. Stream Functions     *
+ ********************************/
+
+/* openSidecar
+ *
+ * Opens the binary stream that belongs to an inverted index, e.g.
+ * "index.txt.pos" for "index.txt".
+ *
+ * @param   index           name of the inverted index
+ * @param   suffix          suffix of the stream
+ * @param   mode            fopen mode
+ *
+ * @return  success         FILE pointer
+ * @return  failure         NULL
+ */
+
+FILE *openSidecar(char *index, char *suffix, char *mode)
+{
+    FILE *file;
+    char *name;
+    
+    if(index == NULL || suffix == NULL || mode == NULL)
+    {
+        fprintf(stderr, "Error: Cannot open stream for NULL index.\n");
+        return NULL;
+    }
+    
+    name = (char*) malloc(strlen(index) + strlen(suffix) + 1);
+    if(name == NULL)
+    {
+        fprintf(stderr, "Error: Could not allocate space for filename.\n");
+        return NULL;
+    }
+    
+    strcpy(name, index);
+    strcat(name, suffix);
+    
+    file = fopen(name, mode);
+    free(name);
+    
+    return file;
+}
+
+/* removeSidecar
+ *
+ * Deletes the stream that belongs to an inverted index, so an
+ * optional stream left over from an earlier index is not read
+ * with a new one. A stream that does not exist is fine.
+ *
+ * @param   index           name of the inverted index
+ * @param   suffix          suffix of the stream
+ *
+ * @return  success         1
+ * @return  failure         0
+ */
+
+int removeSidecar(char *index, char *suffix)
+{
+    FILE *file;
+    char *name;
+    int res;
+    
+    /* Nothing to do if it is not there */
+    file = openSidecar(index, suffix, "rb");
+    if(file == NULL)
+    {
+        return 1;
+    }
+    fclose(file);
+    
+    name = (char*) malloc(strlen(index) + strlen(suffix) + 1);
+    if(name == NULL)
+    {
+        fprintf(stderr, "Error: Could not allocate space for filename.\n");
+        return 0;
+    }
+    
+    strcpy(name, index);
+    strcat(name, suffix);
+    
+    res = (remove(name) == 0);
+    if(res == 0)
+    {
+        fprintf(stderr, "Error: Could not remove %s.\n", name);
+    }
+    free(name);
+    
+    return res;
+}
+
+/* renameSidecar
+ *
+ * Moves the stream of one inverted index to that of another, so a
+ * finished index can take the place of the one it replaces. If the
+ * first index has no such stream the second loses its own, which
+ * would otherwise be read with the new index.
+ *
+ * @param   from            name of the index written
+ * @param   to              name of the index it replaces
+ * @param   suffix          suffix of the stream
+ *
+ * @return  success         1
+ * @return  failure         0
+ */
+
+int renameSidecar(char *from, char *to, char *suffix)
+{
+    FILE *file;
+    char *source, *target;
+    int res;
+    
+    file = openSidecar(from, suffix, "rb");
+    if(file == NULL)
+    {
+        return removeSidecar(to, suffix);
+    }
+    fclose(file);
+    
+    source = (char*) malloc(strlen(from) + strlen(suffix) + 1);
+    target = (char*) malloc(strlen(to) + strlen(suffix) + 1);
+    if(source == NULL || target == NULL)
+    {
+        fprintf(stderr, "Error: Could not allocate space for filename.\n");
+        free(source);
+        free(target);
+        return 0;
+    }
+    
+    strcpy(source, from);
+    strcat(source, suffix);
+    strcpy(target, to);
+    strcat(target, suffix);
+    
+    res = (rename(source, target) == 0);
+    if(res == 0)
+    {
+        fprintf(stderr, "Error: Could not rename %s to %s.\n", source, target);
+    }
+    free(source);
+    free(target);
+    
+    return res;
+}
+
+/* writeVByte
+ *
+ * Writes an unsigned value seven bits at a time, low bits first.
+ * The high bit of a byte is set when more bytes follow, so small
+ * values (like the gap between two positions) take one byte.
+ *
+ * @param   file            stream to write to
+ * @param   value           value to write
+ *
+ * @return  success         number of bytes written
+ * @return  failure         0
+ */
+
+int writeVByte(FILE *file, unsigned int value)
+{
+    int bytes;
+    
+    bytes = 0;
+    
+    while(value >= 0x80)
+    {
+        if(putc((int) ((value & 0x7f) | 0x80), file) == EOF)
+        {
+            return 0;
+        }
+        value >>= 7;
+        bytes++;
+    }
+    
+    if(putc((int) value, file) == EOF)
+    {
+        return 0;
+    }
+    
+    return bytes + 1;
+}
+
+/* readVByte
+ *
+ * Reads a value written by writeVByte.
+ *
+ * @param   file            stream to read from
+ * @param   value           where to store the value
+ *
+ * @return  success         1
+ * @return  failure         0
+ */
+
+int readVByte(FILE *file, unsigned int *value)
+{
+    int c, shift;
+    unsigned int result;
+    
+    result = 0;
+    shift = 0;
+    
+    while((c = getc(file)) != EOF)
+    {
+        result |= (unsigned int) (c & 0x7f) << shift;
+        
+        if((c & 0x80) == 0)
+        {
+            *value = result;
+            return 1;
+        }
+        
+        shift += 7;
+        if(shift > 28)
+        {
+            break;
+        }
+    }
+    
+    return 0;
+}
@@ -0,0 +1,109 @@
+/*
+ * File: postings.h
+ *
+ * Author: Mike Swift
+ * Email: theycallmeswift@gmail.com
+ * Date Created: May 12th, 2011
+ * Date Modified: May 12th, 2011
+ */
+
+#ifndef SWIFT_POSTINGS_H_
+#define SWIFT_POSTINGS_H_
+
+/********************************
+ *          1. Includes         *
+ ********************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/********************************
+ *          2. Constants        *
+ ********************************/
+
+/* Binary streams that sit next to an inverted index */
+#define POSITIONS_SUFFIX ".pos"
+
+/* Size of the stdio buffer given to a binary stream */
+#define POSTINGS_BUFFER_SIZE 65536
+
+/********************************
+ *      3. Stream Functions     *
+ ********************************/
+
+/* openSidecar
+ *
+ * Opens the binary stream that belongs to an inverted index, e.g.
+ * "index.txt.pos" for "index.txt".
+ *
+ * @param   index           name of the inverted index
+ * @param   suffix          suffix of the stream
+ * @param   mode            fopen mode
+ *
+ * @return  success         FILE pointer
+ * @return  failure         NULL
+ */
+
+FILE *openSidecar(char *index, char *suffix, char *mode);
+
+/* removeSidecar
+ *
+ * Deletes the stream that belongs to an inverted index, so an
+ * optional stream left over from an earlier index is not read
+ * with a new one. A stream that does not exist is fine.
+ *
+ * @param   index           name of the inverted index
+ * @param   suffix          suffix of the stream
+ *
+ * @return  success         1
+ * @return  failure         0
+ */
+
+int removeSidecar(char *index, char *suffix);
+
+/* renameSidecar
+ *
+ * Moves the stream of one inverted index to that of another, so a
+ * finished index can take the place of the one it replaces. If the
+ * first index has no such stream the second loses its own, which
+ * would otherwise be read with the new index.
+ *
+ * @param   from            name of the index written
+ * @param   to              name of the index it replaces
+ * @param   suffix          suffix of the stream
+ *
+ * @return  success         1
+ * @return  failure         0
+ */
+
+int renameSidecar(char *from, char *to, char *suffix);
+
+/* writeVByte
+ *
+ * Writes an unsigned value seven bits at a time, low bits first.
+ * The high bit of a byte is set when more bytes follow, so small
+ * values (like the gap between two positions) take one byte.
+ *
+ * @param   file            stream to write to
+ * @param   value           value to write
+ *
+ * @return  success         number of bytes written
+ * @return  failure         0
+ */
+
+int writeVByte(FILE *file, unsigned int value);
+
+/* readVByte
+ *
+ * Reads a value written by writeVByte.
+ *
+ * @param   file            stream to read from
+ * @param   value           where to store the value
+ *
+ * @return  success         1
+ * @return  failure         0
+ */
+
+int readVByte(FILE *file, unsigned int *value);
+
+#endif /* SWIFT_POSTINGS_H_ */
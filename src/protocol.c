@@ -0,0 +1,322 @@
+/*
+ * File: protocol.c
+ *
+ * Author: Mike Swift
+ * Email: theycallmeswift@gmail.com
+ * Date Created: May 15th, 2011
+ * Date Modified: May 15th, 2011
+ */
+
+/********************************
+ *          1. Includes         *
+ ********************************/
+
+/* Sockets, timeouts, lstat and S_ISSOCK are POSIX, not ANSI */
+#define _XOPEN_SOURCE 600
+
+#include <errno.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include "protocol.h"
+
+/********************************
+ *      2. Helper Functions     *
+ ********************************/
+
+/* writeAll
+ *
+ * Writes all of length bytes, however many calls it takes.
+ *
+ * @param   fd          file descriptor
+ * @param   data        bytes to write
+ * @param   length      number of bytes
+ *
+ * @return  success     1
+ * @return  failure     0
+ */
+
+int writeAll(int fd, const char *data, unsigned long length)
+{
+    ssize_t written;
+    
+    while(length > 0)
+    {
+        written = write(fd, data, length);
+        if(written < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        
+        if(written <= 0)
+        {
+            return 0;
+        }
+        
+        data += written;
+        length -= written;
+    }
+    
+    return 1;
+}
+
+/* readAll
+ *
+ * Reads exactly length bytes. A signal gives up like a hang up
+ * does, so a server waiting on a client can still be stopped, and
+ * so does a read past the socket's time limit (see limitSocket).
+ *
+ * @param   fd          file descriptor
+ * @param   data        where to store the bytes
+ * @param   length      number of bytes
+ *
+ * @return  success     1
+ * @return  failure     0 (the other end hung up or stalled first)
+ */
+
+int readAll(int fd, char *data, unsigned long length)
+{
+    ssize_t got;
+    
+    while(length > 0)
+    {
+        got = read(fd, data, length);
+        if(got <= 0)
+        {
+            return 0;
+        }
+        
+        data += got;
+        length -= got;
+    }
+    
+    return 1;
+}
+
+/* socketAddress
+ *
+ * @param   path        path of a Unix domain socket
+ * @param   address     where to store its address
+ *
+ * @return  success     1
+ * @return  failure     0 (the path does not fit)
+ */
+
+int socketAddress(char *path, struct sockaddr_un *address)
+{
+    if(strlen(path) >= sizeof(address->sun_path))
+    {
+        fprintf(stderr, "Error: Socket path %s is too long.\n", path);
+        return 0;
+    }
+    
+    memset(address, 0, sizeof(struct sockaddr_un));
+    address->sun_family = AF_UNIX;
+    strcpy(address->sun_path, path);
+    
+    return 1;
+}
+
+/********************************
+ *      3. Protocol Functions   *
+ ********************************/
+
+/* writeMessage
+ *
+ * Sends a message: its length (see MESSAGE_HEADER_SIZE), then its
+ * bytes. Short writes are retried until all of it is out.
+ *
+ * @param   fd              connected socket
+ * @param   data            bytes to send
+ * @param   length          number of bytes
+ *
+ * @return  success         1
+ * @return  failure         0
+ */
+
+int writeMessage(int fd, const char *data, unsigned long length)
+{
+    char header[MESSAGE_HEADER_SIZE];
+    
+    if(length > 0xFFFFFFFFUL)
+    {
+        fprintf(stderr, "Error: Message of %lu bytes is too long.\n", length);
+        return 0;
+    }
+    
+    header[0] = (char) ((length >> 24) & 0xFF);
+    header[1] = (char) ((length >> 16) & 0xFF);
+    header[2] = (char) ((length >> 8) & 0xFF);
+    header[3] = (char) (length & 0xFF);
+    
+    return writeAll(fd, header, MESSAGE_HEADER_SIZE) && writeAll(fd, data, length);
+}
+
+/* readMessage
+ *
+ * Receives a message sent by writeMessage. The bytes are followed
+ * by a '\0', so text can be used as a string straight away.
+ *
+ * @param   fd              connected socket
+ * @param   max             longest message to accept
+ * @param   length          where to store the number of bytes
+ *
+ * @return  success         the message, to be freed by the caller
+ * @return  failure         NULL (the other end hung up, or sent
+ *                          something too long)
+ */
+
+char *readMessage(int fd, unsigned long max, unsigned long *length)
+{
+    unsigned char header[MESSAGE_HEADER_SIZE];
+    char *data;
+    
+    if(readAll(fd, (char*) header, MESSAGE_HEADER_SIZE) == 0)
+    {
+        return NULL;
+    }
+    
+    *length = ((unsigned long) header[0] << 24) | ((unsigned long) header[1] << 16) |
+              ((unsigned long) header[2] << 8) | (unsigned long) header[3];
+    
+    if(*length > max)
+    {
+        fprintf(stderr, "Error: Message of %lu bytes is too long.\n", *length);
+        return NULL;
+    }
+    
+    data = (char*) malloc(*length + 1);
+    if(data == NULL)
+    {
+        fprintf(stderr, "Error: Could not allocate space for a message.\n");
+        return NULL;
+    }
+    
+    if(readAll(fd, data, *length) == 0)
+    {
+        free(data);
+        return NULL;
+    }
+    
+    data[*length] = '\0';
+    
+    return data;
+}
+
+/* limitSocket
+ *
+ * Makes every read or write on a socket that waits longer than
+ * seconds fail, like a hang up. A client that stops partway
+ * through a message then only holds the server up that long.
+ *
+ * @param   fd              connected socket
+ * @param   seconds         longest wait
+ *
+ * @return  success         1
+ * @return  failure         0
+ */
+
+int limitSocket(int fd, int seconds)
+{
+    struct timeval limit;
+    
+    limit.tv_sec = seconds;
+    limit.tv_usec = 0;
+    
+    if(setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &limit, sizeof(limit)) != 0 ||
+       setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &limit, sizeof(limit)) != 0)
+    {
+        fprintf(stderr, "Error: Could not limit how long a socket waits.\n");
+        return 0;
+    }
+    
+    return 1;
+}
+
+/* listenSocket
+ *
+ * Creates a Unix domain socket at path and starts listening on it.
+ * A socket left behind at path by an earlier server is replaced.
+ *
+ * @param   path            where to create the socket
+ *
+ * @return  success         listening socket
+ * @return  failure         -1
+ */
+
+int listenSocket(char *path)
+{
+    struct sockaddr_un address;
+    struct stat info;
+    int fd;
+    
+    if(socketAddress(path, &address) == 0)
+    {
+        return -1;
+    }
+    
+    /* Only ever remove a socket, never a file that happens to have the name */
+    if(lstat(path, &info) == 0)
+    {
+        if(!S_ISSOCK(info.st_mode))
+        {
+            fprintf(stderr, "Error: %s exists and is not a socket.\n", path);
+            return -1;
+        }
+        
+        unlink(path);
+    }
+    
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(fd < 0)
+    {
+        fprintf(stderr, "Error: Could not create a socket.\n");
+        return -1;
+    }
+    
+    if(bind(fd, (struct sockaddr*) &address, sizeof(address)) != 0 || listen(fd, SOMAXCONN) != 0)
+    {
+        fprintf(stderr, "Error: Could not listen on %s.\n", path);
+        close(fd);
+        return -1;
+    }
+    
+    return fd;
+}
+
+/* connectSocket
+ *
+ * @param   path            socket a server listens on
+ *
+ * @return  success         socket connected to the server
+ * @return  failure         -1
+ */
+
+int connectSocket(char *path)
+{
+    struct sockaddr_un address;
+    int fd;
+    
+    if(socketAddress(path, &address) == 0)
+    {
+        return -1;
+    }
+    
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(fd < 0)
+    {
+        fprintf(stderr, "Error: Could not create a socket.\n");
+        return -1;
+    }
+    
+    if(connect(fd, (struct sockaddr*) &address, sizeof(address)) != 0)
+    {
+        fprintf(stderr, "Error: Could not connect to %s, is the server running?\n", path);
+        close(fd);
+        return -1;
+    }
+    
+    return fd;
+}
@@ -0,0 +1,115 @@
+/*
+ * File: protocol.h
+ *
+ * Author: Mike Swift
+ * Email: theycallmeswift@gmail.com
+ * Date Created: May 15th, 2011
+ * Date Modified: May 15th, 2011
+ */
+
+#ifndef SWIFT_PROTOCOL_H_
+#define SWIFT_PROTOCOL_H_
+
+/********************************
+ *          1. Includes         *
+ ********************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/********************************
+ *          2. Constants        *
+ ********************************/
+
+/* Socket a search server listens on, unless told otherwise */
+#define DEFAULT_SOCKET "/tmp/search.sock"
+
+/* Every message starts with its length, 4 bytes, most significant first */
+#define MESSAGE_HEADER_SIZE 4
+
+/* Longest query a server will read, the REPL reads 1024 */
+#define MAX_REQUEST_SIZE 65536
+
+/* Longest answer a client will read */
+#define MAX_RESPONSE_SIZE (1L << 30)
+
+/* Seconds a server waits on a client that stops partway through a message */
+#define MESSAGE_TIMEOUT 5
+
+/* Request that ends a connection, like quitting the REPL */
+#define QUIT_REQUEST "q"
+
+/********************************
+ *      3. Protocol Functions   *
+ ********************************/
+
+/* writeMessage
+ *
+ * Sends a message: its length (see MESSAGE_HEADER_SIZE), then its
+ * bytes. Short writes are retried until all of it is out.
+ *
+ * @param   fd              connected socket
+ * @param   data            bytes to send
+ * @param   length          number of bytes
+ *
+ * @return  success         1
+ * @return  failure         0
+ */
+
+int writeMessage(int fd, const char *data, unsigned long length);
+
+/* readMessage
+ *
+ * Receives a message sent by writeMessage. The bytes are followed
+ * by a '\0', so text can be used as a string straight away.
+ *
+ * @param   fd              connected socket
+ * @param   max             longest message to accept
+ * @param   length          where to store the number of bytes
+ *
+ * @return  success         the message, to be freed by the caller
+ * @return  failure         NULL (the other end hung up, or sent
+ *                          something too long)
+ */
+
+char *readMessage(int fd, unsigned long max, unsigned long *length);
+
+/* limitSocket
+ *
+ * Makes every read or write on a socket that waits longer than
+ * seconds fail, like a hang up. A client that stops partway
+ * through a message then only holds the server up that long.
+ *
+ * @param   fd              connected socket
+ * @param   seconds         longest wait
+ *
+ * @return  success         1
+ * @return  failure         0
+ */
+
+int limitSocket(int fd, int seconds);
+
+/* listenSocket
+ *
+ * Creates a Unix domain socket at path and starts listening on it.
+ * A socket left behind at path by an earlier server is replaced.
+ *
+ * @param   path            where to create the socket
+ *
+ * @return  success         listening socket
+ * @return  failure         -1
+ */
+
+int listenSocket(char *path);
+
+/* connectSocket
+ *
+ * @param   path            socket a server listens on
+ *
+ * @return  success         socket connected to the server
+ * @return  failure         -1
+ */
+
+int connectSocket(char *path);
+
+#endif /* SWIFT_PROTOCOL_H_ */
@@ -0,0 +1,325 @@
+/*
+ * File: resultcache.c
+ *
+ * Author: Mike Swift
+ * Email: theycallmeswift@gmail.com
+ * Date Created: May 15th, 2011
+ * Date Modified: May 15th, 2011
+ */
+
+/********************************
+ *          1. Includes         *
+ ********************************/
+
+/* Read-write locks are POSIX, not ANSI */
+#define _XOPEN_SOURCE 600
+
+#include <pthread.h>
+#include "resultcache.h"
+
+/********************************
+ *          2. Structs          *
+ ********************************/
+
+/* Answer_
+ *
+ * The cached answer to one query, in a single allocation: the
+ * Answer, then its hits, then its key.
+ *
+ * @param   key         the query, normalized
+ * @param   generation  generation of the index it was run on
+ * @param   hits        the results, best first
+ * @param   count       number of results
+ * @param   size        bytes the answer is charged
+ * @param   next        next newer answer
+ * @param   prev        next older answer
+ */
+
+struct Answer_ {
+    char *key;
+    long generation;
+    Hit hits;
+    int count;
+    unsigned long long size;
+    Answer next;
+    Answer prev;
+};
+
+/* ResultCache_
+ *
+ * @param   table       answers by key
+ * @param   newest      most recently added answer
+ * @param   oldest      first answer to go when there is no room
+ * @param   max_size    bytes the answers may take, 0 for no limit
+ * @param   curr_size   bytes the answers take
+ * @param   lock        readers search, writers add and clear out
+ */
+
+struct ResultCache_ {
+    HashTable table;
+    Answer newest;
+    Answer oldest;
+    unsigned long long max_size;
+    unsigned long long curr_size;
+    pthread_rwlock_t lock;
+};
+
+/********************************
+ *      3. Helper Functions     *
+ ********************************/
+
+/* unlinkAnswer
+ *
+ * Takes an answer out of the cache and frees it. The caller holds
+ * the lock for writing.
+ *
+ * @param   cache       ResultCache object
+ * @param   answer      answer to take out
+ *
+ * @return  void
+ */
+
+void unlinkAnswer(ResultCache cache, Answer answer)
+{
+    if(answer->prev != NULL)
+    {
+        answer->prev->next = answer->next;
+    }
+    else
+    {
+        cache->oldest = answer->next;
+    }
+    
+    if(answer->next != NULL)
+    {
+        answer->next->prev = answer->prev;
+    }
+    else
+    {
+        cache->newest = answer->prev;
+    }
+    
+    cache->curr_size -= answer->size;
+    
+    /* The table frees the answer */
+    removeHT(cache->table, answer->key);
+}
+
+/********************************
+ *   4. Result Cache Functions  *
+ ********************************/
+
+/* createResultCache
+ *
+ * Creates a cache of the answers to whole queries, with a budget
+ * of its own (see parseCacheSize).
+ *
+ * @param   cache_size      size of the cache, e.g. "1MB"
+ *
+ * @return  success         new ResultCache
+ * @return  failure         NULL
+ */
+
+ResultCache createResultCache(char *cache_size)
+{
+    ResultCache cache;
+    unsigned long long bytes;
+    
+    if(parseCacheSize(cache_size, &bytes) == 0)
+    {
+        return NULL;
+    }
+    
+    cache = (ResultCache) malloc(sizeof(struct ResultCache_));
+    if(cache == NULL)
+    {
+        fprintf(stderr, "Error: Could not allocate space for the result cache.\n");
+        return NULL;
+    }
+    
+    cache->newest = NULL;
+    cache->oldest = NULL;
+    cache->max_size = bytes;
+    cache->curr_size = 0;
+    
+    cache->table = createHT(hash, compStrings, NULL, free, NULL);
+    if(cache->table == NULL || pthread_rwlock_init(&cache->lock, NULL) != 0)
+    {
+        fprintf(stderr, "Error: Could not allocate space for the result cache.\n");
+        destroyHT(cache->table);
+        free(cache);
+        return NULL;
+    }
+    
+    return cache;
+}
+
+/* destroyResultCache
+ *
+ * Frees a result cache and every answer in it. NULL is ignored.
+ *
+ * @param   cache           ResultCache object
+ *
+ * @return  void
+ */
+
+void destroyResultCache(ResultCache cache)
+{
+    if(cache != NULL)
+    {
+        /* The table frees the answers */
+        destroyHT(cache->table);
+        pthread_rwlock_destroy(&cache->lock);
+        free(cache);
+    }
+}
+
+/* insertAnswer
+ *
+ * Keeps a copy of the answer to a query. When the cache is full
+ * the oldest answers are cleared out until the new one fits, and
+ * an answer that could never fit is left out. An answer to the
+ * same query from another generation of the index is replaced.
+ * Safe to call from any thread.
+ *
+ * @param   cache           ResultCache object
+ * @param   key             the query, normalized (see answerKey)
+ * @param   generation      generation of the index it was run on
+ * @param   hits            the results, best first
+ * @param   count           number of results
+ *
+ * @return  success         1
+ * @return  failure         0
+ */
+
+int insertAnswer(ResultCache cache, char *key, long generation, Hit hits, int count)
+{
+    Answer answer, old;
+    size_t length;
+    unsigned long long size;
+    
+    if(cache == NULL || key == NULL)
+    {
+        fprintf(stderr, "Error: Cannot insert into NULL result cache.\n");
+        return 0;
+    }
+    
+    length = strlen(key) + 1;
+    size = sizeof(struct Answer_) + sizeof(struct Hit_) * count + length;
+    
+    if(cache->max_size != 0 && size > cache->max_size)
+    {
+        return 1;
+    }
+    
+    /* Copy before taking the lock, readers only wait for the list surgery */
+    answer = (Answer) malloc(size);
+    if(answer == NULL)
+    {
+        fprintf(stderr, "Error: Could not allocate space for a cached answer.\n");
+        return 0;
+    }
+    
+    answer->hits = (Hit) (answer + 1);
+    answer->key = (char*) (answer->hits + count);
+    memcpy(answer->hits, hits, sizeof(struct Hit_) * count);
+    memcpy(answer->key, key, length);
+    answer->generation = generation;
+    answer->count = count;
+    answer->size = size;
+    
+    pthread_rwlock_wrlock(&cache->lock);
+    
+    old = (Answer) searchHT(cache->table, answer->key);
+    if(old != NULL && old->generation == generation)
+    {
+        /* Another query got here first */
+        pthread_rwlock_unlock(&cache->lock);
+        free(answer);
+        return 1;
+    }
+    
+    if(old != NULL)
+    {
+        unlinkAnswer(cache, old);
+    }
+    
+    while(cache->max_size != 0 && cache->oldest != NULL && cache->curr_size + size > cache->max_size)
+    {
+        unlinkAnswer(cache, cache->oldest);
+    }
+    
+    if(insertHT(cache->table, answer->key, answer) == 0)
+    {
+        fprintf(stderr, "Error: Could not allocate space for a cached answer.\n");
+        pthread_rwlock_unlock(&cache->lock);
+        free(answer);
+        return 0;
+    }
+    
+    answer->next = NULL;
+    answer->prev = cache->newest;
+    if(cache->newest != NULL)
+    {
+        cache->newest->next = answer;
+    }
+    else
+    {
+        cache->oldest = answer;
+    }
+    cache->newest = answer;
+    cache->curr_size += size;
+    
+    pthread_rwlock_unlock(&cache->lock);
+    
+    return 1;
+}
+
+/* searchAnswers
+ *
+ * Looks up the answer to a query. Lookups only take the lock for
+ * reading, so any number of them run at once, and the results are
+ * copied into the caller's arena while it is held. An answer from
+ * another generation of the index is never handed out.
+ *
+ * @param   cache           ResultCache object
+ * @param   key             the query, normalized (see answerKey)
+ * @param   generation      generation of the index searched
+ * @param   arena           where to copy the results
+ * @param   hits            where to store the results
+ * @param   count           where to store the number of results
+ *
+ * @return  found           1
+ * @return  not found       0
+ */
+
+int searchAnswers(ResultCache cache, char *key, long generation, Arena arena, Hit *hits, int *count)
+{
+    Answer answer;
+    int found;
+    
+    if(cache == NULL || key == NULL)
+    {
+        return 0;
+    }
+    
+    found = 0;
+    
+    pthread_rwlock_rdlock(&cache->lock);
+    
+    answer = (Answer) searchHT(cache->table, key);
+    if(answer != NULL && answer->generation == generation)
+    {
+        *hits = (Hit) arenaAlloc(arena, sizeof(struct Hit_) * (answer->count + 1));
+        if(*hits != NULL)
+        {
+            memcpy(*hits, answer->hits, sizeof(struct Hit_) * answer->count);
+            *count = answer->count;
+            found = 1;
+        }
+    }
+    
+    pthread_rwlock_unlock(&cache->lock);
+    
+    return found;
+}
@@ -0,0 +1,126 @@
+/*
+ * File: resultcache.h
+ *
+ * Author: Mike Swift
+ * Email: theycallmeswift@gmail.com
+ * Date Created: May 15th, 2011
+ * Date Modified: May 15th, 2011
+ */
+
+#ifndef SWIFT_RESULTCACHE_H_
+#define SWIFT_RESULTCACHE_H_
+
+/********************************
+ *          1. Includes         *
+ ********************************/
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "arena.h"
+#include "cache.h"
+#include "hashtable.h"
+
+/********************************
+ *          2. Constants        *
+ ********************************/
+
+/* Room for the answers to whole queries, on top of the cache of words */
+#define DEFAULT_RESULT_CACHE_SIZE "1MB"
+
+/********************************
+ *      3. Structs & Typedefs   *
+ ********************************/
+
+/* Hit_
+ *
+ * One result of a cached answer, as search ranked it.
+ *
+ * @param   filenum     number of the file
+ * @param   frequency   occurrences of the terms in the file
+ * @param   numfiles    terms of the query the file holds
+ * @param   score       score of the file
+ */
+
+struct Hit_ {
+    int filenum;
+    int frequency;
+    int numfiles;
+    double score;
+};
+typedef struct Hit_* Hit;
+
+struct Answer_;
+typedef struct Answer_* Answer;
+
+struct ResultCache_;
+typedef struct ResultCache_* ResultCache;
+
+/********************************
+ *   4. Result Cache Functions  *
+ ********************************/
+
+/* createResultCache
+ *
+ * Creates a cache of the answers to whole queries, with a budget
+ * of its own (see parseCacheSize).
+ *
+ * @param   cache_size      size of the cache, e.g. "1MB"
+ *
+ * @return  success         new ResultCache
+ * @return  failure         NULL
+ */
+
+ResultCache createResultCache(char *cache_size);
+
+/* destroyResultCache
+ *
+ * Frees a result cache and every answer in it. NULL is ignored.
+ *
+ * @param   cache           ResultCache object
+ *
+ * @return  void
+ */
+
+void destroyResultCache(ResultCache cache);
+
+/* insertAnswer
+ *
+ * Keeps a copy of the answer to a query. When the cache is full
+ * the oldest answers are cleared out until the new one fits, and
+ * an answer that could never fit is left out. An answer to the
+ * same query from another generation of the index is replaced.
+ * Safe to call from any thread.
+ *
+ * @param   cache           ResultCache object
+ * @param   key             the query, normalized (see answerKey)
+ * @param   generation      generation of the index it was run on
+ * @param   hits            the results, best first
+ * @param   count           number of results
+ *
+ * @return  success         1
+ * @return  failure         0
+ */
+
+int insertAnswer(ResultCache cache, char *key, long generation, Hit hits, int count);
+
+/* searchAnswers
+ *
+ * Looks up the answer to a query. Lookups only take the lock for
+ * reading, so any number of them run at once, and the results are
+ * copied into the caller's arena while it is held. An answer from
+ * another generation of the index is never handed out.
+ *
+ * @param   cache           ResultCache object
+ * @param   key             the query, normalized (see answerKey)
+ * @param   generation      generation of the index searched
+ * @param   arena           where to copy the results
+ * @param   hits            where to store the results
+ * @param   count           where to store the number of results
+ *
+ * @return  found           1
+ * @return  not found       0
+ */
+
+int searchAnswers(ResultCache cache, char *key, long generation, Arena arena, Hit *hits, int *count);
+
+#endif /* SWIFT_RESULTCACHE_H_ */
@@ -0,0 +1,405 @@
+/*
+ * File: roaring.c
+ *
+ * Author: Mike Swift
+ * Email: theycallmeswift@gmail.com
+ * Date Created: May 15th, 2011
+ * Date Modified: May 15th, 2011
+ */
+
+/********************************
+ *          1. Includes         *
+ ********************************/
+
+#include "roaring.h"
+
+/********************************
+ *      2. Helper Functions     *
+ ********************************/
+
+/* writeShort
+ *
+ * Writes the low 16 bits of a number as two bytes, high byte first.
+ *
+ * @param   file        container stream
+ * @param   value       number to write
+ *
+ * @return  success     1
+ * @return  failure     0
+ */
+
+int writeShort(FILE *file, int value)
+{
+    if(fputc((value >> 8) & 0xFF, file) == EOF || fputc(value & 0xFF, file) == EOF)
+    {
+        fprintf(stderr, "Error: Could not write containers.\n");
+        return 0;
+    }
+    
+    return 1;
+}
+
+/* readShort
+ *
+ * Reads a number written by writeShort.
+ *
+ * @param   file        container stream
+ * @param   value       where to store it
+ *
+ * @return  success     1
+ * @return  failure     0
+ */
+
+int readShort(FILE *file, int *value)
+{
+    int high, low;
+    
+    high = fgetc(file);
+    low = fgetc(file);
+    
+    if(high == EOF || low == EOF)
+    {
+        return 0;
+    }
+    
+    *value = (high << 8) | low;
+    
+    return 1;
+}
+
+/* setRange
+ *
+ * Sets the bits first to last (inclusive) of a bitmap, a whole
+ * word at a time where it can.
+ *
+ * @param   bits        bitmap
+ * @param   first       first bit
+ * @param   last        last bit
+ *
+ * @return  void
+ */
+
+void setRange(unsigned long *bits, int first, int last)
+{
+    while(first <= last && first % BITS_PER_WORD != 0)
+    {
+        bits[first / BITS_PER_WORD] |= 1UL << (first % BITS_PER_WORD);
+        first++;
+    }
+    
+    while(first + BITS_PER_WORD - 1 <= last)
+    {
+        bits[first / BITS_PER_WORD] = ~0UL;
+        first += BITS_PER_WORD;
+    }
+    
+    while(first <= last)
+    {
+        bits[first / BITS_PER_WORD] |= 1UL << (first % BITS_PER_WORD);
+        first++;
+    }
+}
+
+/********************************
+ *     3. Container Functions   *
+ ********************************/
+
+/* writeContainers
+ *
+ * Writes the files holding a word to the container stream, the
+ * way a Roaring bitmap stores them. The files are split into
+ * chunks of CHUNK_FILES and each chunk goes into whichever
+ * container is smallest: a sorted array of the low 16 bits, a
+ * bitmap of CONTAINER_BYTES or a list of runs.
+ *
+ *      #chunks
+ *      per chunk: key (high bits), kind, #files, then
+ *          array:  the low bits of each file
+ *          bitmap: CONTAINER_BYTES bytes, lowest file first
+ *          run:    #runs, then the start and length - 1 of each
+ *
+ * Numbers in the headers are written with writeVByte, low bits,
+ * run starts and lengths as two bytes, high byte first.
+ *
+ * @param   file            container stream
+ * @param   word            word about to be written to the index
+ *
+ * @return  success         offset the containers start at
+ * @return  failure         -1
+ */
+
+long writeContainers(FILE *file, Word word)
+{
+    Entry ent, *entries;
+    unsigned char bitmap[CONTAINER_BYTES];
+    long offset;
+    int i, j, k, n, key, low, runs, start, kind, size, numchunks, res;
+    
+    if(file == NULL || word == NULL)
+    {
+        fprintf(stderr, "Error: Cannot write containers of NULL word.\n");
+        return -1;
+    }
+    
+    n = 0;
+    for(ent = word->head; ent != NULL; ent = ent->next)
+    {
+        n++;
+    }
+    
+    entries = (Entry*) malloc(sizeof(Entry) * (n + 1));
+    if(entries == NULL)
+    {
+        fprintf(stderr, "Error: Could not allocate space for containers.\n");
+        return -1;
+    }
+    
+    i = 0;
+    for(ent = word->head; ent != NULL; ent = ent->next)
+    {
+        entries[i] = ent;
+        i++;
+    }
+    
+    /* The index keeps postings by frequency, containers go by file */
+    qsort(entries, n, sizeof(Entry), compEntryFiles);
+    
+    numchunks = 0;
+    for(i = 0; i < n; i++)
+    {
+        if(i == 0 || (entries[i]->filenumber >> CHUNK_BITS) != (entries[i - 1]->filenumber >> CHUNK_BITS))
+        {
+            numchunks++;
+        }
+    }
+    
+    offset = ftell(file);
+    res = writeVByte(file, numchunks);
+    
+    for(i = 0; i < n && res == 1; i = j)
+    {
+        key = entries[i]->filenumber >> CHUNK_BITS;
+        
+        /* Find the end of the chunk, counting the runs in it */
+        runs = 1;
+        for(j = i + 1; j < n && (entries[j]->filenumber >> CHUNK_BITS) == key; j++)
+        {
+            if(entries[j]->filenumber != entries[j - 1]->filenumber + 1)
+            {
+                runs++;
+            }
+        }
+        
+        /* Whichever container is smallest */
+        kind = CONTAINER_BITMAP;
+        size = CONTAINER_BYTES;
+        
+        if(2 * (j - i) <= size)
+        {
+            kind = CONTAINER_ARRAY;
+            size = 2 * (j - i);
+        }
+        
+        if(4 * runs + 2 < size)
+        {
+            kind = CONTAINER_RUN;
+        }
+        
+        res = writeVByte(file, key) && writeVByte(file, kind) && writeVByte(file, j - i);
+        
+        if(kind == CONTAINER_ARRAY)
+        {
+            for(k = i; k < j && res == 1; k++)
+            {
+                res = writeShort(file, entries[k]->filenumber & (CHUNK_FILES - 1));
+            }
+        }
+        else if(kind == CONTAINER_RUN)
+        {
+            res = res && writeVByte(file, runs);
+            
+            for(k = i; k < j && res == 1; k++)
+            {
+                start = k;
+                while(k + 1 < j && entries[k + 1]->filenumber == entries[k]->filenumber + 1)
+                {
+                    k++;
+                }
+                
+                res = writeShort(file, entries[start]->filenumber & (CHUNK_FILES - 1)) &&
+                      writeShort(file, k - start);
+            }
+        }
+        else if(res == 1)
+        {
+            memset(bitmap, 0, CONTAINER_BYTES);
+            
+            for(k = i; k < j; k++)
+            {
+                low = entries[k]->filenumber & (CHUNK_FILES - 1);
+                bitmap[low / CHAR_BIT] |= 1 << (low % CHAR_BIT);
+            }
+            
+            if(fwrite(bitmap, 1, CONTAINER_BYTES, file) != CONTAINER_BYTES)
+            {
+                fprintf(stderr, "Error: Could not write containers.\n");
+                res = 0;
+            }
+        }
+    }
+    
+    free(entries);
+    
+    return (res == 1) ? offset : -1;
+}
+
+/* readContainers
+ *
+ * Reads back the containers written by writeContainers into a
+ * bitmap with one bit per file of the index.
+ *
+ * @param   file            container stream
+ * @param   offset          offset the containers start at
+ * @param   bits            where to store the bitmap, room for
+ *                          BITMAP_WORDS(numfiles)
+ * @param   numfiles        number of files in the index
+ *
+ * @return  success         1
+ * @return  failure         0
+ */
+
+int readContainers(FILE *file, long offset, unsigned long *bits, int numfiles)
+{
+    unsigned char bitmap[CONTAINER_BYTES];
+    unsigned int numchunks, key, kind, count, runs;
+    int i, k, base, doc, low, length;
+    
+    memset(bits, 0, sizeof(unsigned long) * BITMAP_WORDS(numfiles));
+    
+    if(file == NULL || fseek(file, offset, SEEK_SET) != 0 || readVByte(file, &numchunks) == 0)
+    {
+        fprintf(stderr, "Error: Malformed container file.\n");
+        return 0;
+    }
+    
+    for(i = 0; i < (int) numchunks; i++)
+    {
+        if(readVByte(file, &key) == 0 || readVByte(file, &kind) == 0 || readVByte(file, &count) == 0)
+        {
+            fprintf(stderr, "Error: Malformed container file.\n");
+            return 0;
+        }
+        
+        base = key << CHUNK_BITS;
+        
+        if(kind == CONTAINER_ARRAY)
+        {
+            for(k = 0; k < (int) count; k++)
+            {
+                if(readShort(file, &low) == 0 || base + low >= numfiles)
+                {
+                    fprintf(stderr, "Error: Malformed container file.\n");
+                    return 0;
+                }
+                
+                doc = base + low;
+                bits[doc / BITS_PER_WORD] |= 1UL << (doc % BITS_PER_WORD);
+            }
+        }
+        else if(kind == CONTAINER_RUN)
+        {
+            if(readVByte(file, &runs) == 0)
+            {
+                fprintf(stderr, "Error: Malformed container file.\n");
+                return 0;
+            }
+            
+            for(k = 0; k < (int) runs; k++)
+            {
+                if(readShort(file, &low) == 0 || readShort(file, &length) == 0 || base + low + length >= numfiles)
+                {
+                    fprintf(stderr, "Error: Malformed container file.\n");
+                    return 0;
+                }
+                
+                setRange(bits, base + low, base + low + length);
+            }
+        }
+        else
+        {
+            if(fread(bitmap, 1, CONTAINER_BYTES, file) != CONTAINER_BYTES)
+            {
+                fprintf(stderr, "Error: Malformed container file.\n");
+                return 0;
+            }
+            
+            /* Chunks start on a word, so bytes go straight into place */
+            for(k = 0; k < CONTAINER_BYTES; k++)
+            {
+                if(bitmap[k] == 0)
+                {
+                    continue;
+                }
+                
+                doc = base + k * CHAR_BIT;
+                if(doc >= numfiles || (doc + CHAR_BIT > numfiles && (bitmap[k] >> (numfiles - doc)) != 0))
+                {
+                    fprintf(stderr, "Error: Malformed container file.\n");
+                    return 0;
+                }
+                
+                bits[doc / BITS_PER_WORD] |= (unsigned long) bitmap[k] << (doc % BITS_PER_WORD);
+            }
+        }
+    }
+    
+    return 1;
+}
+
+/* nextBit
+ *
+ * Finds the first set bit of a bitmap that is not below from,
+ * skipping whole words at a time.
+ *
+ * @param   bits            bitmap
+ * @param   size            number of bits in it
+ * @param   from            first bit to look at
+ *
+ * @return  int             number of the bit, size if there is none
+ */
+
+int nextBit(unsigned long *bits, int size, int from)
+{
+    unsigned long word;
+    int i, words;
+    
+    if(from >= size)
+    {
+        return size;
+    }
+    
+    i = from / BITS_PER_WORD;
+    word = bits[i] >> (from % BITS_PER_WORD);
+    words = BITMAP_WORDS(size);
+    
+    /* Skip the empty words */
+    while(word == 0)
+    {
+        i++;
+        if(i >= words)
+        {
+            return size;
+        }
+        
+        word = bits[i];
+        from = i * BITS_PER_WORD;
+    }
+    
+    while((word & 1UL) == 0)
+    {
+        word >>= 1;
+        from++;
+    }
+    
+    return (from < size) ? from : size;
+}
@@ -0,0 +1,111 @@
+/*
+ * File: roaring.h
+ *
+ * Author: Mike Swift
+ * Email: theycallmeswift@gmail.com
+ * Date Created: May 15th, 2011
+ * Date Modified: May 15th, 2011
+ */
+
+#ifndef SWIFT_ROARING_H_
+#define SWIFT_ROARING_H_
+
+/********************************
+ *          1. Includes         *
+ ********************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include "postings.h"
+#include "words.h"
+
+/********************************
+ *          2. Constants        *
+ ********************************/
+
+/* Binary stream of the file sets of common words next to an inverted index */
+#define ROARING_SUFFIX ".rbm"
+
+/* Files are split into chunks of 2^16 by the high bits of their number */
+#define CHUNK_BITS 16
+#define CHUNK_FILES (1 << CHUNK_BITS)
+
+/* Kinds of container a chunk can be stored in */
+#define CONTAINER_ARRAY 0
+#define CONTAINER_BITMAP 1
+#define CONTAINER_RUN 2
+
+/* Bytes a bitmap container takes, one bit per file of the chunk */
+#define CONTAINER_BYTES (CHUNK_FILES / CHAR_BIT)
+
+/* A word gets containers when it is in at least 1 of every DENSE_FRACTION files */
+#define DENSE_FRACTION 32
+#define IS_DENSE(df, numfiles) ((long) (df) * DENSE_FRACTION >= (long) (numfiles))
+
+/* In memory a file set is a plain bitmap of unsigned longs */
+#define BITS_PER_WORD ((int) (sizeof(unsigned long) * CHAR_BIT))
+#define BITMAP_WORDS(n) (((n) + BITS_PER_WORD - 1) / BITS_PER_WORD)
+
+/********************************
+ *     3. Container Functions   *
+ ********************************/
+
+/* writeContainers
+ *
+ * Writes the files holding a word to the container stream, the
+ * way a Roaring bitmap stores them. The files are split into
+ * chunks of CHUNK_FILES and each chunk goes into whichever
+ * container is smallest: a sorted array of the low 16 bits, a
+ * bitmap of CONTAINER_BYTES or a list of runs.
+ *
+ *      #chunks
+ *      per chunk: key (high bits), kind, #files, then
+ *          array:  the low bits of each file
+ *          bitmap: CONTAINER_BYTES bytes, lowest file first
+ *          run:    #runs, then the start and length - 1 of each
+ *
+ * Numbers in the headers are written with writeVByte, low bits,
+ * run starts and lengths as two bytes, high byte first.
+ *
+ * @param   file            container stream
+ * @param   word            word about to be written to the index
+ *
+ * @return  success         offset the containers start at
+ * @return  failure         -1
+ */
+
+long writeContainers(FILE *file, Word word);
+
+/* readContainers
+ *
+ * Reads back the containers written by writeContainers into a
+ * bitmap with one bit per file of the index.
+ *
+ * @param   file            container stream
+ * @param   offset          offset the containers start at
+ * @param   bits            where to store the bitmap, room for
+ *                          BITMAP_WORDS(numfiles)
+ * @param   numfiles        number of files in the index
+ *
+ * @return  success         1
+ * @return  failure         0
+ */
+
+int readContainers(FILE *file, long offset, unsigned long *bits, int numfiles);
+
+/* nextBit
+ *
+ * Finds the first set bit of a bitmap that is not below from,
+ * skipping whole words at a time.
+ *
+ * @param   bits            bitmap
+ * @param   size            number of bits in it
+ * @param   from            first bit to look at
+ *
+ * @return  int             number of the bit, size if there is none
+ */
+
+int nextBit(unsigned long *bits, int size, int from);
+
+#endif /* SWIFT_ROARING_H_ */
@@ -0,0 +1,589 @@
+/*
+ * File: server.c
+ *
+ * Author: Mike Swift
+ * Email: theycallmeswift@gmail.com
+ * Date Created: May 15th, 2011
+ * Date Modified: May 15th, 2011
+ */
+
+/********************************
+ *          1. Includes         *
+ ********************************/
+
+/* Sockets, poll, sigaction and threads are POSIX, not ANSI */
+#define _XOPEN_SOURCE 600
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include "server.h"
+
+/* Set by SIGINT and SIGTERM, the server finishes up and returns */
+static volatile sig_atomic_t stopServer = 0;
+
+/********************************
+ *          2. Structs          *
+ ********************************/
+
+/* Client_
+ *
+ * @param   fd          connected socket, -1 for a free slot
+ * @param   busy        a worker is answering the client's request
+ * @param   keep        0 once the client hung up, quit or could
+ *                      not be answered
+ * @param   server      server the client is connected to
+ */
+
+struct Client_ {
+    int fd;
+    int busy;
+    int keep;
+    Server server;
+};
+
+/* Server_
+ *
+ * @param   clients     one slot per client that can be connected
+ * @param   cache       Cache object every worker shares
+ * @param   lock        guards busy and keep of every client
+ * @param   wake        pipe a worker writes to when it is done,
+ *                      so poll gives the client back
+ */
+
+struct Server_ {
+    struct Client_ clients[MAX_CLIENTS];
+    Cache cache;
+    pthread_mutex_t lock;
+    int wake[2];
+};
+
+/********************************
+ *      3. Helper Functions     *
+ ********************************/
+
+/* stopServing
+ *
+ * Signal handler for SIGINT and SIGTERM.
+ *
+ * @param   signum      signal number
+ *
+ * @return  void
+ */
+
+void stopServing(int signum)
+{
+    stopServer = 1;
+}
+
+/* serveRequest
+ *
+ * Answers the next request of a client.
+ *
+ * @param   client      connected socket, with a request waiting
+ * @param   files       filelist object
+ * @param   cache       Cache object
+ *
+ * @return  success     1
+ * @return  failure     0 (the client hung up or quit, or could not
+ *                      be answered)
+ */
+
+int serveRequest(int client, Filelist files, Cache cache)
+{
+    char *request, *answer;
+    unsigned long length;
+    int sent;
+    
+    request = readMessage(client, MAX_REQUEST_SIZE, &length);
+    if(request == NULL)
+    {
+        return 0;
+    }
+    
+    if(strcmp(request, QUIT_REQUEST) == 0)
+    {
+        free(request);
+        return 0;
+    }
+    
+    answer = answerQuery(request, files, cache, &length);
+    free(request);
+    
+    sent = (answer != NULL && writeMessage(client, answer, length) == 1);
+    free(answer);
+    
+    return sent;
+}
+
+/* answerClient
+ *
+ * JobFunc of the server's thread pool: answers a client's request
+ * with the worker's own Filelist, then hands the client back to
+ * the main thread.
+ *
+ * @param   worker      the worker's Filelist
+ * @param   job         the Client
+ *
+ * @return  void
+ */
+
+void answerClient(void *worker, void *job)
+{
+    Client client;
+    Server server;
+    int keep;
+    
+    client = (Client) job;
+    server = client->server;
+    
+    keep = serveRequest(client->fd, (Filelist) worker, server->cache);
+    
+    pthread_mutex_lock(&server->lock);
+    client->keep = keep;
+    client->busy = 0;
+    pthread_mutex_unlock(&server->lock);
+    
+    /* Wake poll up, a full pipe means it is awake already */
+    write(server->wake[1], "", 1);
+}
+
+/* addClient
+ *
+ * Takes a free slot for a new client.
+ *
+ * @param   server      Server object
+ * @param   fd          the client's socket
+ *
+ * @return  success     1
+ * @return  failure     0 (no slot left)
+ */
+
+int addClient(Server server, int fd)
+{
+    int i;
+    
+    for(i = 0; i < MAX_CLIENTS; i++)
+    {
+        if(server->clients[i].fd < 0)
+        {
+            server->clients[i].fd = fd;
+            server->clients[i].busy = 0;
+            server->clients[i].keep = 1;
+            return 1;
+        }
+    }
+    
+    return 0;
+}
+
+/* pollClients
+ *
+ * Fills in what poll waits on: the listening socket, the wake
+ * pipe, then every client not being answered, hanging up on the
+ * clients that are done first.
+ *
+ * @param   server      Server object
+ * @param   listener    listening socket
+ * @param   fds         where to put the pollfds
+ * @param   slots       where to put the slot of each client
+ *
+ * @return  number of pollfds
+ */
+
+int pollClients(Server server, int listener, struct pollfd *fds, int *slots)
+{
+    Client client;
+    int i, numfds;
+    
+    fds[0].fd = listener;
+    fds[1].fd = server->wake[0];
+    numfds = 2;
+    
+    pthread_mutex_lock(&server->lock);
+    
+    for(i = 0; i < MAX_CLIENTS; i++)
+    {
+        client = &server->clients[i];
+        
+        if(client->fd < 0 || client->busy)
+        {
+            continue;
+        }
+        
+        if(client->keep == 0)
+        {
+            close(client->fd);
+            client->fd = -1;
+            continue;
+        }
+        
+        fds[numfds].fd = client->fd;
+        slots[numfds] = i;
+        numfds++;
+    }
+    
+    pthread_mutex_unlock(&server->lock);
+    
+    for(i = 0; i < numfds; i++)
+    {
+        fds[i].events = POLLIN;
+        fds[i].revents = 0;
+    }
+    
+    return numfds;
+}
+
+/********************************
+ *      4. Server Functions     *
+ ********************************/
+
+/* appendAnswer
+ *
+ * Adds text to the end of an answer, making room as needed.
+ *
+ * @param   answer      answer so far, may be moved
+ * @param   length      its length
+ * @param   size        room it has
+ * @param   text        text to add
+ *
+ * @return  success     1
+ * @return  failure     0
+ */
+
+int appendAnswer(char **answer, unsigned long *length, unsigned long *size, char *text)
+{
+    unsigned long add;
+    char *grown;
+    
+    add = strlen(text);
+    
+    while(*length + add + 1 > *size)
+    {
+        grown = (char*) realloc(*answer, *size * 2);
+        if(grown == NULL)
+        {
+            fprintf(stderr, "Error: Could not allocate space for an answer.\n");
+            return 0;
+        }
+        
+        *answer = grown;
+        *size *= 2;
+    }
+    
+    memcpy(*answer + *length, text, add + 1);
+    *length += add;
+    
+    return 1;
+}
+
+/* answerQuery
+ *
+ * Runs one request the way the REPL would (see search) and writes
+ * out what the REPL would print for it: the path of every result,
+ * one per line, best first. The results are reset afterwards, the
+ * cache keeps whatever the query put in it. An index written anew
+ * since it was opened is opened again for the query, with a word
+ * cache of its own (see currentIndex).
+ *
+ * @param   request         "so ..." or "sa ...", no newline needed
+ * @param   files           filelist object, used by this query only
+ * @param   cache           Cache object
+ * @param   length          where to store the length of the answer
+ *
+ * @return  success         the answer, to be freed by the caller
+ * @return  failure         NULL
+ */
+
+char *answerQuery(char *request, Filelist files, Cache cache, unsigned long *length)
+{
+    char *action, *answer, path[MAX_BUFFER_SIZE];
+    unsigned long size, n;
+    Filelist current;
+    Cache words;
+    Result result;
+    int ok;
+    
+    size = ANSWER_SIZE;
+    *length = 0;
+    
+    answer = (char*) malloc(size);
+    n = strlen(request);
+    action = (char*) malloc(n + 2);
+    if(answer == NULL || action == NULL)
+    {
+        fprintf(stderr, "Error: Could not allocate space for an answer.\n");
+        free(answer);
+        free(action);
+        return NULL;
+    }
+    
+    answer[0] = '\0';
+    
+    /* Ended with a newline, like a line the REPL reads */
+    strcpy(action, request);
+    if(n == 0 || action[n - 1] != '\n')
+    {
+        strcat(action, "\n");
+    }
+    
+    ok = 1;
+    words = cache;
+    current = currentIndex(files, &words);
+    
+    if(action[0] == 's' && (action[1] == 'o' || action[1] == 'a'))
+    {
+        search(action, current->tok, current, words);
+    }
+    else
+    {
+        ok = appendAnswer(&answer, length, &size, UNKNOWN_COMMAND);
+    }
+    
+    for(result = current->results; result != NULL && ok; result = result->next)
+    {
+        if(result->frequency >= 0 && getFilename(current, result->filenum, path, MAX_BUFFER_SIZE) != NULL)
+        {
+            ok = appendAnswer(&answer, length, &size, path) && appendAnswer(&answer, length, &size, "\n");
+        }
+    }
+    
+    resetResults(current);
+    free(action);
+    
+    if(current != files)
+    {
+        destroyFilelist(current);
+        destroyCache(words);
+    }
+    
+    if(!ok)
+    {
+        free(answer);
+        return NULL;
+    }
+    
+    return answer;
+}
+
+/* serveSearch
+ *
+ * Serves queries on a Unix domain socket until the process gets
+ * SIGINT or SIGTERM. Every request and answer is one message (see
+ * writeMessage), a client sends as many as it likes and hangs up
+ * or sends QUIT_REQUEST when it is done. Up to MAX_CLIENTS stay
+ * connected. Requests are answered by a pool of threads, each
+ * with a Filelist of its own on the same open index (see
+ * createContext), so that many queries run at once, all sharing
+ * the cache. A client's requests are answered in the order it
+ * sent them. A client that stalls partway through a message for
+ * MESSAGE_TIMEOUT seconds is hung up on, and on the way out no
+ * worker waits for the rest of a request.
+ *
+ * @param   path            where to create the socket
+ * @param   files           filelist object, its index is served
+ *                          with its settings (proximity, topk,
+ *                          ranges)
+ * @param   cache           Cache object
+ * @param   numthreads      queries to answer at once
+ *
+ * @return  success         1 (stopped by a signal)
+ * @return  failure         0
+ */
+
+int serveSearch(char *path, Filelist files, Cache cache, int numthreads)
+{
+    struct sigaction action;
+    struct pollfd fds[MAX_CLIENTS + 2];
+    struct Server_ server;
+    sigset_t signals, old;
+    Filelist workers[MAX_THREADS];
+    ThreadPool pool;
+    char drain[64];
+    int slots[MAX_CLIENTS + 2], listener, numfds, client, res, i;
+    
+    if(numthreads < 1 || numthreads > MAX_THREADS)
+    {
+        fprintf(stderr, "Error: A server runs 1 to %d threads.\n", MAX_THREADS);
+        return 0;
+    }
+    
+    /* No SA_RESTART, so a signal gets the server out of poll and read */
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = stopServing;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    
+    /* A client that hangs up early is not worth dying over */
+    action.sa_handler = SIG_IGN;
+    sigaction(SIGPIPE, &action, NULL);
+    
+    /* Every worker reads the index through its own Filelist */
+    res = 1;
+    for(i = 0; i < numthreads; i++)
+    {
+        workers[i] = (res == 1) ? createContext(files->index) : NULL;
+        if(workers[i] == NULL)
+        {
+            res = 0;
+            continue;
+        }
+        
+        workers[i]->proximity = files->proximity;
+        workers[i]->topk = files->topk;
+        workers[i]->ranges = files->ranges;
+        workers[i]->answers = files->answers;
+    }
+    
+    listener = -1;
+    pool = NULL;
+    server.cache = cache;
+    server.wake[0] = server.wake[1] = -1;
+    pthread_mutex_init(&server.lock, NULL);
+    
+    for(client = 0; client < MAX_CLIENTS; client++)
+    {
+        server.clients[client].fd = -1;
+        server.clients[client].server = &server;
+    }
+    
+    if(res == 1 && (pipe(server.wake) != 0 ||
+       fcntl(server.wake[0], F_SETFL, O_NONBLOCK) != 0 || fcntl(server.wake[1], F_SETFL, O_NONBLOCK) != 0))
+    {
+        fprintf(stderr, "Error: Could not make a pipe for the workers.\n");
+        res = 0;
+    }
+    
+    if(res == 1)
+    {
+        /* The kernels for this processor are picked before any worker can race to */
+        pickKernel();
+        pickDecoders();
+        
+        /* Only the main thread takes signals, the workers just finish what they are doing */
+        sigemptyset(&signals);
+        sigaddset(&signals, SIGINT);
+        sigaddset(&signals, SIGTERM);
+        pthread_sigmask(SIG_BLOCK, &signals, &old);
+        
+        pool = createThreadPool(numthreads, answerClient, (void**) workers);
+        
+        pthread_sigmask(SIG_SETMASK, &old, NULL);
+        
+        listener = (pool != NULL) ? listenSocket(path) : -1;
+        res = (listener >= 0);
+    }
+    
+    if(res == 1)
+    {
+        printf("Serving on %s.\n", path);
+        fflush(stdout);
+    }
+    
+    while(res == 1 && stopServer == 0)
+    {
+        numfds = pollClients(&server, listener, fds, slots);
+        
+        if(poll(fds, numfds, -1) < 0)
+        {
+            if(errno == EINTR)
+            {
+                continue;
+            }
+            
+            fprintf(stderr, "Error: Could not wait for clients on %s.\n", path);
+            res = 0;
+            break;
+        }
+        
+        /* Workers that are done only need poll to come round again */
+        if((fds[1].revents & POLLIN) != 0)
+        {
+            while(read(server.wake[0], drain, sizeof(drain)) > 0)
+            {
+            }
+        }
+        
+        /* Every client with a request goes to the pool, it gets back the next round after its answer */
+        for(i = 2; i < numfds && stopServer == 0; i++)
+        {
+            if(fds[i].revents == 0)
+            {
+                continue;
+            }
+            
+            pthread_mutex_lock(&server.lock);
+            server.clients[slots[i]].busy = 1;
+            pthread_mutex_unlock(&server.lock);
+            
+            if(submitJob(pool, &server.clients[slots[i]]) == 0)
+            {
+                pthread_mutex_lock(&server.lock);
+                server.clients[slots[i]].busy = 0;
+                server.clients[slots[i]].keep = 0;
+                pthread_mutex_unlock(&server.lock);
+            }
+        }
+        
+        if((fds[0].revents & POLLIN) != 0)
+        {
+            client = accept(listener, NULL, NULL);
+            
+            /* A client that stalls mid-message is hung up on, not waited on */
+            if(client >= 0 && limitSocket(client, MESSAGE_TIMEOUT) == 0)
+            {
+                close(client);
+            }
+            else if(client >= 0 && addClient(&server, client) == 0)
+            {
+                fprintf(stderr, "Error: Too many clients, turning one away.\n");
+                close(client);
+            }
+        }
+    }
+    
+    /* A worker still reading a request gets an end of file now, answers already started are still sent */
+    for(i = 0; i < MAX_CLIENTS; i++)
+    {
+        if(server.clients[i].fd >= 0)
+        {
+            shutdown(server.clients[i].fd, SHUT_RD);
+        }
+    }
+    
+    destroyThreadPool(pool);
+    
+    for(i = 0; i < MAX_CLIENTS; i++)
+    {
+        if(server.clients[i].fd >= 0)
+        {
+            close(server.clients[i].fd);
+        }
+    }
+    
+    if(listener >= 0)
+    {
+        close(listener);
+        unlink(path);
+    }
+    
+    if(server.wake[0] >= 0)
+    {
+        close(server.wake[0]);
+        close(server.wake[1]);
+    }
+    
+    pthread_mutex_destroy(&server.lock);
+    
+    for(i = 0; i < numthreads; i++)
+    {
+        destroyFilelist(workers[i]);
+    }
+    
+    return res;
+}
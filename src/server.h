@@ -0,0 +1,113 @@
+/*
+ * File: server.h
+ *
+ * Author: Mike Swift
+ * Email: theycallmeswift@gmail.com
+ * Date Created: May 15th, 2011
+ * Date Modified: May 15th, 2011
+ */
+
+#ifndef SWIFT_SERVER_H_
+#define SWIFT_SERVER_H_
+
+/********************************
+ *          1. Includes         *
+ ********************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "csearch.h"
+#include "protocol.h"
+#include "threadpool.h"
+
+/********************************
+ *          2. Constants        *
+ ********************************/
+
+/* Answer to anything that is not "so ..." or "sa ...", same as the REPL */
+#define UNKNOWN_COMMAND "Command not found.\n"
+
+/* Room an answer starts with, it doubles as needed */
+#define ANSWER_SIZE 4096
+
+/* Clients connected at once, more are turned away */
+#define MAX_CLIENTS 64
+
+/* Queries answered at once, unless -j says otherwise */
+#define DEFAULT_THREADS 4
+
+/********************************
+ *      3. Structs & Typedefs   *
+ ********************************/
+
+struct Client_;
+typedef struct Client_* Client;
+
+struct Server_;
+typedef struct Server_* Server;
+
+/********************************
+ *      4. Server Functions     *
+ ********************************/
+
+/* appendAnswer
+ *
+ * Adds text to the end of an answer, making room as needed.
+ *
+ * @param   answer      answer so far, may be moved
+ * @param   length      its length
+ * @param   size        room it has
+ * @param   text        text to add
+ *
+ * @return  success     1
+ * @return  failure     0
+ */
+
+int appendAnswer(char **answer, unsigned long *length, unsigned long *size, char *text);
+
+/* answerQuery
+ *
+ * Runs one request the way the REPL would (see search) and writes
+ * out what the REPL would print for it: the path of every result,
+ * one per line, best first. The results are reset afterwards, the
+ * cache keeps whatever the query put in it.
+ *
+ * @param   request         "so ..." or "sa ...", no newline needed
+ * @param   files           filelist object, used by this query only
+ * @param   cache           Cache object
+ * @param   length          where to store the length of the answer
+ *
+ * @return  success         the answer, to be freed by the caller
+ * @return  failure         NULL
+ */
+
+char *answerQuery(char *request, Filelist files, Cache cache, unsigned long *length);
+
+/* serveSearch
+ *
+ * Serves queries on a Unix domain socket until the process gets
+ * SIGINT or SIGTERM. Every request and answer is one message (see
+ * writeMessage), a client sends as many as it likes and hangs up
+ * or sends QUIT_REQUEST when it is done. Up to MAX_CLIENTS stay
+ * connected. Requests are answered by a pool of threads, each
+ * with a Filelist of its own on the same open index (see
+ * createContext), so that many queries run at once, all sharing
+ * the cache. A client's requests are answered in the order it
+ * sent them. A client that stalls partway through a message for
+ * MESSAGE_TIMEOUT seconds is hung up on, and on the way out no
+ * worker waits for the rest of a request.
+ *
+ * @param   path            where to create the socket
+ * @param   files           filelist object, its index is served
+ *                          with its settings (proximity, topk,
+ *                          ranges)
+ * @param   cache           Cache object
+ * @param   numthreads      queries to answer at once
+ *
+ * @return  success         1 (stopped by a signal)
+ * @return  failure         0
+ */
+
+int serveSearch(char *path, Filelist files, Cache cache, int numthreads);
+
+#endif /* SWIFT_SERVER_H_ */
@@ -0,0 +1,1265 @@
+/*
+ * File: shard.c
+ *
+ * Author: Mike Swift
+ * Email: theycallmeswift@gmail.com
+ * Date Created: May 15th, 2011
+ * Date Modified: May 15th, 2011
+ */
+
+/********************************
+ *          1. Includes         *
+ ********************************/
+
+/* fork, socketpair and waitpid are POSIX, not ANSI */
+#define _XOPEN_SOURCE 600
+
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include "server.h"
+#include "shard.h"
+
+/********************************
+ *          2. Structs          *
+ ********************************/
+
+/* Shard_
+ *
+ * @param   pid         worker process answering for the shard
+ * @param   fd          socket to the worker
+ */
+
+struct Shard_ {
+    pid_t pid;
+    int fd;
+};
+
+/* ShardResult_
+ *
+ * @param   filenum     number of the file in the whole index
+ * @param   score       score of the file
+ * @param   path        path of the file, inside the shard's answer
+ */
+
+struct ShardResult_ {
+    long filenum;
+    double score;
+    char *path;
+};
+
+/* Coordinator_
+ *
+ * @param   shards      one worker per shard, in manifest order
+ * @param   numshards   number of shards
+ * @param   topk        best results wanted, 0 for all of them
+ * @param   stats       statistics block of the index, or NULL
+ * @param   arena       where queries are parsed and counted with
+ *                      the block
+ */
+
+struct Coordinator_ {
+    struct Shard_ shards[MAX_SHARDS];
+    int numshards;
+    int topk;
+    Stats stats;
+    Arena arena;
+};
+
+/* Expansion_
+ *
+ * @param   term        term a wildcard or fuzzy word matches, inside
+ *                      a shard's answer
+ * @param   numfiles    number of files holding it
+ */
+
+struct Expansion_ {
+    char *term;
+    long numfiles;
+};
+
+/********************************
+ *      3. Helper Functions     *
+ ********************************/
+
+/* runShardWorker
+ *
+ * Body of a worker process: opens its shard and answers the
+ * coordinator until it is done.
+ *
+ * @param   path        name of the shard's index
+ * @param   fd          socket to the coordinator
+ * @param   cachesize   size of the worker's cache
+ * @param   proximity   whether files with the terms close together
+ *                      rank higher
+ * @param   topk        best results wanted, 0 for all of them
+ * @param   ranges      ranges of files a top-k query is split into
+ *
+ * @return  success     1
+ * @return  failure     0
+ */
+
+int runShardWorker(char *path, int fd, char *cachesize, int proximity, int topk, int ranges)
+{
+    TokenizerT tok;
+    Filelist files;
+    Cache cache;
+    
+    tok = TKCreate(FILE_CHARS, path);
+    if(tok == NULL)
+    {
+        fprintf(stderr, "Error: Could not open shard %s.\n", path);
+        return 0;
+    }
+    
+    files = getFilelist(tok);
+    TKDestroy(tok);
+    tok = NULL;
+    
+    if(files == NULL)
+    {
+        return 0;
+    }
+    
+    files->proximity = proximity;
+    files->topk = topk;
+    files->ranges = ranges;
+    
+    cache = createCache(cachesize);
+    if(cache == NULL)
+    {
+        fprintf(stderr, "Error: Could not allocate space for Cache.\n");
+        destroyFilelist(files);
+        return 0;
+    }
+    
+    while(serveShard(fd, files, cache) == 1)
+    {
+        /* Until the coordinator quits or hangs up */
+    }
+    
+    destroyCache(cache);
+    destroyFilelist(files);
+    releaseWords();
+    
+    return 1;
+}
+
+/* askShards
+ *
+ * Sends a request to every shard, so they all work on it at once,
+ * then collects their answers in order. Every shard that got the
+ * request is read from, even when another one failed, so none of
+ * them is left an answer behind.
+ *
+ * @param   coordinator Coordinator object
+ * @param   request     request to send
+ * @param   answers     where to store the answer of each shard,
+ *                      to be freed by the caller (NULL if none)
+ *
+ * @return  success     1
+ * @return  failure     0
+ */
+
+int askShards(Coordinator coordinator, char *request, char **answers)
+{
+    unsigned long length;
+    int sent[MAX_SHARDS], i, ok;
+    
+    ok = 1;
+    
+    for(i = 0; i < coordinator->numshards; i++)
+    {
+        answers[i] = NULL;
+        
+        sent[i] = writeMessage(coordinator->shards[i].fd, request, strlen(request));
+        if(sent[i] == 0)
+        {
+            fprintf(stderr, "Error: Could not reach shard %d.\n", i);
+            ok = 0;
+        }
+    }
+    
+    for(i = 0; i < coordinator->numshards; i++)
+    {
+        if(sent[i] == 0)
+        {
+            continue;
+        }
+        
+        answers[i] = readMessage(coordinator->shards[i].fd, MAX_RESPONSE_SIZE, &length);
+        if(answers[i] == NULL)
+        {
+            fprintf(stderr, "Error: Shard %d did not answer.\n", i);
+            ok = 0;
+        }
+    }
+    
+    return ok;
+}
+
+/* freeAnswers
+ *
+ * Frees the answers collected by askShards.
+ *
+ * @param   answers     answer of each shard
+ * @param   numshards   number of shards
+ *
+ * @return  void
+ */
+
+void freeAnswers(char **answers, int numshards)
+{
+    int i;
+    
+    for(i = 0; i < numshards; i++)
+    {
+        free(answers[i]);
+        answers[i] = NULL;
+    }
+}
+
+/* compShardResults
+ *
+ * qsort comparator that orders ShardResults best first, the same
+ * way sortResults orders the results of one index: by score, and
+ * of two files with the same score the lower numbered one first.
+ *
+ * @param   ptr1        first result
+ * @param   ptr2        second result
+ *
+ * @return  int         <0, 0 or >0
+ */
+
+int compShardResults(const void *ptr1, const void *ptr2)
+{
+    ShardResult a, b;
+    
+    a = (ShardResult) ptr1;
+    b = (ShardResult) ptr2;
+    
+    if(a->score != b->score)
+    {
+        return (a->score > b->score) ? -1 : 1;
+    }
+    
+    if(a->filenum != b->filenum)
+    {
+        return (a->filenum < b->filenum) ? -1 : 1;
+    }
+    
+    return 0;
+}
+
+/* scoreRequest
+ *
+ * Writes the SCORE_REQUEST that hands the counts of the whole index
+ * to every shard, after the terms chosen for the query's wildcard
+ * and fuzzy words.
+ *
+ * @param   total       number of files of the whole index
+ * @param   numunits    number of units of the query
+ * @param   counts      number of files holding each unit
+ * @param   expansions  CHOSEN_TERMS lines of the query
+ * @param   query       the query, without a newline
+ *
+ * @return  success     the request, to be freed by the caller
+ * @return  failure     NULL
+ */
+
+char *scoreRequest(long total, int numunits, int *counts, char *expansions, char *query)
+{
+    char *request, *pos;
+    int u;
+    
+    request = (char*) malloc(strlen(expansions) + strlen(SCORE_REQUEST) + 24 * (numunits + 2) + strlen(query) + 1);
+    if(request == NULL)
+    {
+        fprintf(stderr, "Error: Could not allocate space for the request.\n");
+        return NULL;
+    }
+    
+    pos = request;
+    pos += sprintf(pos, "%s%s%ld %d", expansions, SCORE_REQUEST, total, numunits);
+    
+    for(u = 0; u < numunits; u++)
+    {
+        pos += sprintf(pos, " %d", counts[u]);
+    }
+    
+    sprintf(pos, "\n%s", query);
+    
+    return request;
+}
+
+/* sumStats
+ *
+ * Adds up the counts every shard sent for a query and writes the
+ * SCORE_REQUEST that hands the totals back to them.
+ *
+ * @param   coordinator Coordinator object
+ * @param   answers     answer of each shard to the STATS_REQUEST
+ * @param   expansions  CHOSEN_TERMS lines of the query
+ * @param   query       the query, without a newline
+ *
+ * @return  success     the request, to be freed by the caller
+ * @return  failure     NULL
+ */
+
+char *sumStats(Coordinator coordinator, char **answers, char *expansions, char *query)
+{
+    char *request, *end;
+    long total, numfiles;
+    int *counts, numunits, units, i, u;
+    
+    total = 0;
+    numunits = -1;
+    counts = NULL;
+    
+    for(i = 0; i < coordinator->numshards; i++)
+    {
+        numfiles = strtol(answers[i], &end, 10);
+        units = (int) strtol(end, &end, 10);
+        
+        if(numunits < 0)
+        {
+            numunits = units;
+            counts = (int*) calloc(numunits + 1, sizeof(int));
+            if(counts == NULL)
+            {
+                fprintf(stderr, "Error: Could not allocate space for the counts.\n");
+                return NULL;
+            }
+        }
+        else if(units != numunits)
+        {
+            fprintf(stderr, "Error: The shards do not agree on the query.\n");
+            free(counts);
+            return NULL;
+        }
+        
+        total += numfiles;
+        for(u = 0; u < numunits; u++)
+        {
+            counts[u] += (int) strtol(end, &end, 10);
+        }
+    }
+    
+    request = scoreRequest(total, numunits, counts, expansions, query);
+    free(counts);
+    
+    return request;
+}
+
+/* askStats
+ *
+ * Gets the counts of the whole index for a query, from the
+ * statistics block when the coordinator has one and it can count
+ * the query, or else from the shards (see answerStats), and writes
+ * the SCORE_REQUEST that hands them to every shard. Both requests
+ * hand the shards the terms chosen for the query's wildcard and
+ * fuzzy words first.
+ *
+ * @param   coordinator Coordinator object
+ * @param   expansions  CHOSEN_TERMS lines of the query
+ * @param   query       "so ..." or "sa ...", without a newline
+ *
+ * @return  success     the request, to be freed by the caller
+ * @return  failure     NULL
+ */
+
+char *askStats(Coordinator coordinator, char *expansions, char *query)
+{
+    char *request, *answers[MAX_SHARDS];
+    int *counts, numunits;
+    
+    if(coordinator->stats != NULL)
+    {
+        numunits = countTerms(query, coordinator->arena, coordinator->stats, &counts);
+        request = (numunits < 0) ? NULL : scoreRequest(statsFiles(coordinator->stats), numunits, counts, expansions, query);
+        resetArena(coordinator->arena);
+        
+        if(request != NULL)
+        {
+            return request;
+        }
+    }
+    
+    request = (char*) malloc(strlen(expansions) + strlen(STATS_REQUEST) + strlen(query) + 1);
+    if(request == NULL)
+    {
+        fprintf(stderr, "Error: Could not allocate space for the query.\n");
+        return NULL;
+    }
+    
+    strcpy(request, expansions);
+    strcat(request, STATS_REQUEST);
+    strcat(request, query);
+    
+    if(askShards(coordinator, request, answers) == 0)
+    {
+        freeAnswers(answers, coordinator->numshards);
+        free(request);
+        return NULL;
+    }
+    
+    free(request);
+    request = sumStats(coordinator, answers, expansions, query);
+    freeAnswers(answers, coordinator->numshards);
+    
+    return request;
+}
+
+/* compExpansionTerms
+ *
+ * qsort comparator that orders Expansions by term.
+ *
+ * @param   ptr1        first expansion
+ * @param   ptr2        second expansion
+ *
+ * @return  int         <0, 0 or >0
+ */
+
+int compExpansionTerms(const void *ptr1, const void *ptr2)
+{
+    return strcmp(((Expansion) ptr1)->term, ((Expansion) ptr2)->term);
+}
+
+/* compExpansionFiles
+ *
+ * qsort comparator that orders Expansions the way a lexicon keeps
+ * them (see rarerTerm): in the most files first, and of two terms
+ * in as many files the one first in the index.
+ *
+ * @param   ptr1        first expansion
+ * @param   ptr2        second expansion
+ *
+ * @return  int         <0, 0 or >0
+ */
+
+int compExpansionFiles(const void *ptr1, const void *ptr2)
+{
+    Expansion a, b;
+    
+    a = (Expansion) ptr1;
+    b = (Expansion) ptr2;
+    
+    if(a->numfiles != b->numfiles)
+    {
+        return (a->numfiles > b->numfiles) ? -1 : 1;
+    }
+    
+    return strcmp(a->term, b->term);
+}
+
+/* chooseTerms
+ *
+ * Asks every shard for the terms a wildcard or fuzzy word matches
+ * (see answerExpansions), adds up how many files of the whole
+ * index hold each one and writes the CHOSEN_TERMS line of the
+ * MAX_EXPANSIONS in the most files. Every shard then expands the
+ * word to the same terms, the ones one index of every file would
+ * expand it to, where its own counts could pick others.
+ *
+ * @param   coordinator Coordinator object
+ * @param   word        wildcard or fuzzy word
+ * @param   chosen      lines written so far, grown as needed
+ * @param   length      length of the lines
+ * @param   size        bytes allocated for the lines
+ *
+ * @return  success     1
+ * @return  failure     0
+ */
+
+int chooseTerms(Coordinator coordinator, char *word, char **chosen, unsigned long *length, unsigned long *size)
+{
+    Expansion expansions;
+    char *request, *answers[MAX_SHARDS], *line, *end, *sep;
+    long count, i, j;
+    int s, ok;
+    
+    request = (char*) malloc(strlen(EXPAND_REQUEST) + strlen(word) + 1);
+    if(request == NULL)
+    {
+        fprintf(stderr, "Error: Could not allocate space for the request.\n");
+        return 0;
+    }
+    
+    strcpy(request, EXPAND_REQUEST);
+    strcat(request, word);
+    
+    ok = askShards(coordinator, request, answers);
+    free(request);
+    
+    if(ok == 0)
+    {
+        freeAnswers(answers, coordinator->numshards);
+        return 0;
+    }
+    
+    count = 0;
+    for(s = 0; s < coordinator->numshards; s++)
+    {
+        for(line = answers[s]; *line != '\0'; line++)
+        {
+            count += (*line == '\n');
+        }
+    }
+    
+    expansions = (Expansion) malloc(sizeof(struct Expansion_) * (count + 1));
+    if(expansions == NULL)
+    {
+        fprintf(stderr, "Error: Could not allocate space for the expansions.\n");
+        freeAnswers(answers, coordinator->numshards);
+        return 0;
+    }
+    
+    /* Every "term files" line is cut into its term and count */
+    j = 0;
+    for(s = 0; s < coordinator->numshards; s++)
+    {
+        for(line = answers[s]; (end = strchr(line, '\n')) != NULL; line = end + 1)
+        {
+            *end = '\0';
+            
+            sep = strrchr(line, ' ');
+            if(sep != NULL)
+            {
+                *sep = '\0';
+                expansions[j].term = line;
+                expansions[j].numfiles = strtol(sep + 1, NULL, 10);
+                j++;
+            }
+        }
+    }
+    
+    /* A term on more than one shard is in the files of all of them */
+    qsort(expansions, j, sizeof(struct Expansion_), compExpansionTerms);
+    
+    count = 0;
+    for(i = 0; i < j; i++)
+    {
+        if(count > 0 && strcmp(expansions[count - 1].term, expansions[i].term) == 0)
+        {
+            expansions[count - 1].numfiles += expansions[i].numfiles;
+        }
+        else
+        {
+            expansions[count++] = expansions[i];
+        }
+    }
+    
+    qsort(expansions, count, sizeof(struct Expansion_), compExpansionFiles);
+    
+    if(count > MAX_EXPANSIONS)
+    {
+        count = MAX_EXPANSIONS;
+    }
+    
+    ok = appendAnswer(chosen, length, size, CHOSEN_TERMS) && appendAnswer(chosen, length, size, word);
+    
+    for(i = 0; i < count && ok; i++)
+    {
+        ok = appendAnswer(chosen, length, size, " ") && appendAnswer(chosen, length, size, expansions[i].term);
+    }
+    
+    ok = ok && appendAnswer(chosen, length, size, "\n");
+    
+    free(expansions);
+    freeAnswers(answers, coordinator->numshards);
+    
+    return ok;
+}
+
+/* chooseExpansions
+ *
+ * Chooses the terms every wildcard and fuzzy word of a query
+ * expands to on every shard (see chooseTerms).
+ *
+ * @param   coordinator Coordinator object
+ * @param   query       "so ..." or "sa ...", without a newline
+ *
+ * @return  success     the CHOSEN_TERMS lines of the query, "" when
+ *                      it has no such word, to be freed by the
+ *                      caller
+ * @return  failure     NULL
+ */
+
+char *chooseExpansions(Coordinator coordinator, char *query)
+{
+    char **words, *chosen;
+    unsigned long length, size;
+    int numwords, i, ok;
+    
+    size = ANSWER_SIZE;
+    length = 0;
+    
+    chosen = (char*) malloc(size);
+    if(chosen == NULL)
+    {
+        fprintf(stderr, "Error: Could not allocate space for the expansions.\n");
+        return NULL;
+    }
+    
+    chosen[0] = '\0';
+    
+    /* A query that does not parse is left to the shards to turn down */
+    numwords = expandableWords(query, coordinator->arena, &words);
+    ok = 1;
+    
+    for(i = 0; i < numwords && ok; i++)
+    {
+        ok = chooseTerms(coordinator, words[i], &chosen, &length, &size);
+    }
+    
+    resetArena(coordinator->arena);
+    
+    if(!ok)
+    {
+        free(chosen);
+        return NULL;
+    }
+    
+    return chosen;
+}
+
+/* mergeScores
+ *
+ * Merges the results every shard sent for a query into what the
+ * REPL would print: the path of every result, one per line, best
+ * first, only the best topk when that is set. File n of shard s
+ * is file n * numshards + s of the whole index (see
+ * writeManifest). The answers are cut up in the process.
+ *
+ * @param   coordinator Coordinator object
+ * @param   answers     answer of each shard to the SCORE_REQUEST
+ * @param   length      where to store the length of the answer
+ *
+ * @return  success     the answer, to be freed by the caller
+ * @return  failure     NULL
+ */
+
+char *mergeScores(Coordinator coordinator, char **answers, unsigned long *length)
+{
+    ShardResult results;
+    char *answer, *line, *end;
+    unsigned long size;
+    long count, i, limit;
+    int s, ok;
+    
+    count = 0;
+    for(s = 0; s < coordinator->numshards; s++)
+    {
+        for(line = answers[s]; *line != '\0'; line++)
+        {
+            count += (*line == '\n');
+        }
+    }
+    
+    size = ANSWER_SIZE;
+    *length = 0;
+    
+    results = (ShardResult) malloc(sizeof(struct ShardResult_) * (count + 1));
+    answer = (char*) malloc(size);
+    if(results == NULL || answer == NULL)
+    {
+        fprintf(stderr, "Error: Could not allocate space for an answer.\n");
+        free(results);
+        free(answer);
+        return NULL;
+    }
+    
+    answer[0] = '\0';
+    count = 0;
+    
+    for(s = 0; s < coordinator->numshards; s++)
+    {
+        line = answers[s];
+        
+        while(*line != '\0' && (end = strchr(line, '\n')) != NULL)
+        {
+            *end = '\0';
+            
+            results[count].filenum = strtol(line, &line, 10) * coordinator->numshards + s;
+            results[count].score = strtod(line, &line);
+            results[count].path = (*line == ' ') ? line + 1 : line;
+            count++;
+            
+            line = end + 1;
+        }
+    }
+    
+    qsort(results, count, sizeof(struct ShardResult_), compShardResults);
+    
+    limit = (coordinator->topk > 0 && coordinator->topk < count) ? coordinator->topk : count;
+    ok = 1;
+    
+    for(i = 0; i < limit && ok; i++)
+    {
+        ok = appendAnswer(&answer, length, &size, results[i].path) && appendAnswer(&answer, length, &size, "\n");
+    }
+    
+    free(results);
+    
+    if(!ok)
+    {
+        free(answer);
+        return NULL;
+    }
+    
+    return answer;
+}
+
+/********************************
+ *      4. Shard Functions      *
+ ********************************/
+
+/* answerStats
+ *
+ * Answers a STATS_REQUEST: how many files the shard has, how many
+ * units the query has and how many of the shard's files hold each
+ * one (see countUnits), on one line.
+ *
+ * @param   request         the request
+ * @param   files           filelist object of the shard
+ * @param   cache           Cache object
+ * @param   length          where to store the length of the answer
+ *
+ * @return  success         the answer, to be freed by the caller
+ * @return  failure         NULL
+ */
+
+char *answerStats(char *request, Filelist files, Cache cache, unsigned long *length)
+{
+    char *action, *answer, *pos;
+    int *counts, numunits, u;
+    
+    action = request + strlen(STATS_REQUEST);
+    if(strlen(action) < 3)
+    {
+        fprintf(stderr, "Error: Nothing to count.\n");
+        return NULL;
+    }
+    
+    numunits = countUnits(action, files->tok, files, cache, &counts);
+    if(numunits < 0)
+    {
+        resetResults(files);
+        return NULL;
+    }
+    
+    answer = (char*) malloc(24 * (numunits + 2) + 1);
+    if(answer == NULL)
+    {
+        fprintf(stderr, "Error: Could not allocate space for an answer.\n");
+        resetResults(files);
+        return NULL;
+    }
+    
+    pos = answer;
+    pos += sprintf(pos, "%d %d", files->numfiles, numunits);
+    
+    for(u = 0; u < numunits; u++)
+    {
+        pos += sprintf(pos, " %d", counts[u]);
+    }
+    
+    pos += sprintf(pos, "\n");
+    *length = pos - answer;
+    
+    resetResults(files);
+    
+    return answer;
+}
+
+/* answerExpansions
+ *
+ * Answers an EXPAND_REQUEST: every term of the shard the word
+ * matches and how many of the shard's files hold it, one per
+ * line (see matchExpansions).
+ *
+ * @param   request         the request
+ * @param   files           filelist object of the shard
+ * @param   length          where to store the length of the answer
+ *
+ * @return  success         the answer, to be freed by the caller
+ * @return  failure         NULL
+ */
+
+char *answerExpansions(char *request, Filelist files, unsigned long *length)
+{
+    char *answer, line[32];
+    unsigned long size;
+    int *terms, numterms, i, ok;
+    
+    numterms = matchExpansions(request + strlen(EXPAND_REQUEST), files, &terms);
+    if(numterms < 0)
+    {
+        resetResults(files);
+        return NULL;
+    }
+    
+    size = ANSWER_SIZE;
+    *length = 0;
+    
+    answer = (char*) malloc(size);
+    if(answer == NULL)
+    {
+        fprintf(stderr, "Error: Could not allocate space for an answer.\n");
+        resetResults(files);
+        return NULL;
+    }
+    
+    answer[0] = '\0';
+    ok = 1;
+    
+    for(i = 0; i < numterms && ok; i++)
+    {
+        sprintf(line, " %d\n", lexiconFrequency(files->lexicon, terms[i]));
+        ok = appendAnswer(&answer, length, &size, lexiconTerm(files->lexicon, terms[i])) &&
+             appendAnswer(&answer, length, &size, line);
+    }
+    
+    resetResults(files);
+    
+    if(!ok)
+    {
+        free(answer);
+        return NULL;
+    }
+    
+    return answer;
+}
+
+/* answerScores
+ *
+ * Answers a SCORE_REQUEST: runs the query (see search) with every
+ * file scored against the counts of the whole index instead of
+ * the shard's own, so a score means the same on every shard, and
+ * writes one line per result, best first:
+ *
+ *      file# score path
+ *
+ * file# being the file's number in the shard, the score exact.
+ *
+ * @param   request         the request
+ * @param   files           filelist object of the shard
+ * @param   cache           Cache object
+ * @param   length          where to store the length of the answer
+ *
+ * @return  success         the answer, to be freed by the caller
+ * @return  failure         NULL
+ */
+
+char *answerScores(char *request, Filelist files, Cache cache, unsigned long *length)
+{
+    char *pos, *query, *action, *answer, line[64], path[MAX_BUFFER_SIZE];
+    unsigned long size;
+    long total;
+    int *counts, numunits, u, ok;
+    Result result;
+    
+    pos = request + strlen(SCORE_REQUEST);
+    total = strtol(pos, &pos, 10);
+    numunits = (int) strtol(pos, &pos, 10);
+    
+    query = strchr(pos, '\n');
+    if(total < 0 || numunits < 0 || query == NULL)
+    {
+        fprintf(stderr, "Error: Not a score request.\n");
+        return NULL;
+    }
+    
+    query++;
+    size = ANSWER_SIZE;
+    *length = 0;
+    
+    counts = (int*) arenaAlloc(files->arena, sizeof(int) * (numunits + 1));
+    action = (char*) arenaAlloc(files->arena, strlen(query) + 2);
+    answer = (char*) malloc(size);
+    if(counts == NULL || answer == NULL || action == NULL)
+    {
+        fprintf(stderr, "Error: Could not allocate space for an answer.\n");
+        free(answer);
+        resetResults(files);
+        return NULL;
+    }
+    
+    answer[0] = '\0';
+    
+    /* Ended with a newline, like a line the REPL reads */
+    strcpy(action, query);
+    strcat(action, "\n");
+    
+    for(u = 0; u < numunits; u++)
+    {
+        counts[u] = (int) strtol(pos, &pos, 10);
+    }
+    
+    /* Every file is scored as a file of the whole index */
+    files->totalFiles = (int) total;
+    files->unitFiles = counts;
+    
+    search(action, files->tok, files, cache);
+    
+    files->totalFiles = files->numfiles;
+    files->unitFiles = NULL;
+    
+    ok = 1;
+    
+    for(result = files->results; result != NULL && ok; result = result->next)
+    {
+        if(result->frequency >= 0 && getFilename(files, result->filenum, path, MAX_BUFFER_SIZE) != NULL)
+        {
+            /* 17 digits bring back the very same double */
+            sprintf(line, "%d %.17g ", result->filenum, result->score);
+            ok = appendAnswer(&answer, length, &size, line) && appendAnswer(&answer, length, &size, path) &&
+                 appendAnswer(&answer, length, &size, "\n");
+        }
+    }
+    
+    resetResults(files);
+    
+    if(!ok)
+    {
+        free(answer);
+        return NULL;
+    }
+    
+    return answer;
+}
+
+/* serveShard
+ *
+ * Answers the next request of a coordinator.
+ *
+ * @param   fd              socket to the coordinator
+ * @param   files           filelist object of the shard
+ * @param   cache           Cache object
+ *
+ * @return  success         1
+ * @return  failure         0 (the coordinator hung up or quit, or
+ *                          could not be answered)
+ */
+
+int serveShard(int fd, Filelist files, Cache cache)
+{
+    char *request, *answer, *pos, *end, **chosen;
+    unsigned long length;
+    int numchosen, i, sent;
+    
+    /* The terms chosen for a query can run well past a query */
+    request = readMessage(fd, MAX_RESPONSE_SIZE, &length);
+    if(request == NULL)
+    {
+        return 0;
+    }
+    
+    numchosen = 0;
+    for(pos = request; strncmp(pos, CHOSEN_TERMS, strlen(CHOSEN_TERMS)) == 0 && (end = strchr(pos, '\n')) != NULL; pos = end + 1)
+    {
+        numchosen++;
+    }
+    
+    chosen = (char**) malloc(sizeof(char*) * (numchosen + 1));
+    if(chosen == NULL)
+    {
+        fprintf(stderr, "Error: Could not allocate space for the expansions.\n");
+        free(request);
+        return 0;
+    }
+    
+    for(i = 0, pos = request; i < numchosen; i++, pos = end + 1)
+    {
+        end = strchr(pos, '\n');
+        *end = '\0';
+        chosen[i] = pos + strlen(CHOSEN_TERMS);
+    }
+    chosen[numchosen] = NULL;
+    
+    files->expansions = (numchosen > 0) ? chosen : NULL;
+    answer = NULL;
+    
+    if(strncmp(pos, STATS_REQUEST, strlen(STATS_REQUEST)) == 0)
+    {
+        answer = answerStats(pos, files, cache, &length);
+    }
+    else if(strncmp(pos, SCORE_REQUEST, strlen(SCORE_REQUEST)) == 0)
+    {
+        answer = answerScores(pos, files, cache, &length);
+    }
+    else if(strncmp(pos, EXPAND_REQUEST, strlen(EXPAND_REQUEST)) == 0)
+    {
+        answer = answerExpansions(pos, files, &length);
+    }
+    
+    files->expansions = NULL;
+    free(chosen);
+    free(request);
+    
+    sent = (answer != NULL && writeMessage(fd, answer, length) == 1);
+    free(answer);
+    
+    return sent;
+}
+
+/* startShards
+ *
+ * Starts one worker process per shard of a sharded index (see
+ * writeManifest). Each opens its shard with a cache of its own
+ * and answers the coordinator's requests on a socket until the
+ * coordinator is done (see stopShards). The coordinator loads the
+ * statistics block of the index, if it has one.
+ *
+ * @param   index           name of the sharded index
+ * @param   cachesize       cache size of every worker
+ * @param   proximity       whether files with the terms close
+ *                          together rank higher
+ * @param   topk            best results wanted, 0 for all of them
+ * @param   ranges          ranges of files a top-k query is split
+ *                          into on every worker
+ *
+ * @return  success         new Coordinator
+ * @return  failure         NULL
+ */
+
+Coordinator startShards(char *index, char *cachesize, int proximity, int topk, int ranges)
+{
+    Coordinator coordinator;
+    char **shards;
+    int ends[2], numshards, i, j, res;
+    pid_t pid;
+    
+    shards = readManifest(index, &numshards);
+    if(shards == NULL)
+    {
+        return NULL;
+    }
+    
+    coordinator = (Coordinator) malloc(sizeof(struct Coordinator_));
+    if(coordinator == NULL)
+    {
+        fprintf(stderr, "Error: Could not allocate space for the coordinator.\n");
+        destroyManifest(shards, numshards);
+        return NULL;
+    }
+    
+    coordinator->numshards = 0;
+    coordinator->topk = topk;
+    coordinator->arena = NULL;
+    
+    coordinator->arena = createArena(ARENA_CHUNK_SIZE);
+    if(coordinator->arena == NULL)
+    {
+        destroyManifest(shards, numshards);
+        free(coordinator);
+        return NULL;
+    }
+    
+    /* With the counts of the whole index at hand most queries need not ask the shards for theirs */
+    coordinator->stats = loadStats(index);
+    
+    /* A worker that died must not take the coordinator with it */
+    signal(SIGPIPE, SIG_IGN);
+    
+    for(i = 0; i < numshards; i++)
+    {
+        if(socketpair(AF_UNIX, SOCK_STREAM, 0, ends) != 0)
+        {
+            fprintf(stderr, "Error: Could not create a socket for shard %d.\n", i);
+            break;
+        }
+        
+        /* Or the worker prints whatever is still buffered again */
+        fflush(stdout);
+        fflush(stderr);
+        
+        pid = fork();
+        if(pid < 0)
+        {
+            fprintf(stderr, "Error: Could not start a worker for shard %d.\n", i);
+            close(ends[0]);
+            close(ends[1]);
+            break;
+        }
+        
+        if(pid == 0)
+        {
+            /* The worker keeps its own end only, so it sees the coordinator hang up */
+            close(ends[0]);
+            for(j = 0; j < i; j++)
+            {
+                close(coordinator->shards[j].fd);
+            }
+            
+            res = runShardWorker(shards[i], ends[1], cachesize, proximity, topk, ranges);
+            close(ends[1]);
+            exit(res == 1 ? 0 : 1);
+        }
+        
+        close(ends[1]);
+        coordinator->shards[i].pid = pid;
+        coordinator->shards[i].fd = ends[0];
+        coordinator->numshards++;
+    }
+    
+    destroyManifest(shards, numshards);
+    
+    if(coordinator->numshards < numshards)
+    {
+        stopShards(coordinator);
+        return NULL;
+    }
+    
+    return coordinator;
+}
+
+/* answerShards
+ *
+ * Runs a query on every shard at once and writes out what the REPL
+ * would print for it on the whole index. The shards score their
+ * files with the counts of the whole index, its files and the files
+ * holding each unit of the query, so the merged results and their
+ * order are the same as those of one index of every file. The
+ * counts come from the statistics block written with the index
+ * (see writeStats), or for a query it cannot count from the shards
+ * themselves, which takes one more trip to them.
+ *
+ * @param   coordinator     Coordinator object
+ * @param   action          "so ..." or "sa ..."
+ * @param   length          where to store the length of the answer
+ *
+ * @return  success         the answer, to be freed by the caller
+ * @return  failure         NULL
+ */
+
+char *answerShards(Coordinator coordinator, char *action, unsigned long *length)
+{
+    char *query, *expansions, *request, *answer, *answers[MAX_SHARDS];
+    
+    query = (char*) malloc(strlen(action) + 1);
+    if(query == NULL)
+    {
+        fprintf(stderr, "Error: Could not allocate space for the query.\n");
+        return NULL;
+    }
+    
+    /* Both requests end the query without a newline */
+    strcpy(query, action);
+    query[strcspn(query, "\r\n")] = '\0';
+    
+    expansions = chooseExpansions(coordinator, query);
+    request = (expansions != NULL) ? askStats(coordinator, expansions, query) : NULL;
+    free(expansions);
+    free(query);
+    
+    if(request == NULL)
+    {
+        return NULL;
+    }
+    
+    answer = NULL;
+    
+    if(askShards(coordinator, request, answers) == 1)
+    {
+        answer = mergeScores(coordinator, answers, length);
+    }
+    
+    freeAnswers(answers, coordinator->numshards);
+    free(request);
+    
+    return answer;
+}
+
+/* stopShards
+ *
+ * Lets every worker know the coordinator is done, waits for them
+ * to exit and frees the Coordinator. NULL is ignored.
+ *
+ * @param   coordinator     Coordinator object
+ *
+ * @return  void
+ */
+
+void stopShards(Coordinator coordinator)
+{
+    int i;
+    
+    if(coordinator == NULL)
+    {
+        return;
+    }
+    
+    for(i = 0; i < coordinator->numshards; i++)
+    {
+        writeMessage(coordinator->shards[i].fd, QUIT_REQUEST, strlen(QUIT_REQUEST));
+        close(coordinator->shards[i].fd);
+    }
+    
+    for(i = 0; i < coordinator->numshards; i++)
+    {
+        waitpid(coordinator->shards[i].pid, NULL, 0);
+    }
+    
+    destroyStats(coordinator->stats);
+    destroyArena(coordinator->arena);
+    free(coordinator);
+}
+
+/* runShards
+ *
+ * The REPL of search, for a sharded index: every query is answered
+ * by all the shards together (see answerShards).
+ *
+ * @param   index           name of the sharded index
+ * @param   cachesize       cache size of every worker
+ * @param   proximity       whether files with the terms close
+ *                          together rank higher
+ * @param   topk            best results wanted, 0 for all of them
+ * @param   ranges          ranges of files a top-k query is split
+ *                          into on every worker
+ *
+ * @return  success         1
+ * @return  failure         0
+ */
+
+int runShards(char *index, char *cachesize, int proximity, int topk, int ranges)
+{
+    Coordinator coordinator;
+    char action[1024], *answer;
+    unsigned long length;
+    
+    coordinator = startShards(index, cachesize, proximity, topk, ranges);
+    if(coordinator == NULL)
+    {
+        return 0;
+    }
+    
+    /* Main Loop */
+    printf("search> ");
+    
+    while(fgets(action, 1024, stdin) != NULL && action[0] != 'q')
+    {
+        if(action[0] == 's' && (action[1] == 'o' || action[1] == 'a'))
+        {
+            answer = answerShards(coordinator, action, &length);
+            if(answer != NULL)
+            {
+                fwrite(answer, 1, length, stdout);
+                free(answer);
+            }
+        }
+        else
+        {
+            printf("Command not found.\n");
+        }
+        
+        printf("search> ");
+    }
+    
+    stopShards(coordinator);
+    
+    return 1;
+}
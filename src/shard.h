@@ -0,0 +1,208 @@
+/*
+ * File: shard.h
+ *
+ * Author: Mike Swift
+ * Email: theycallmeswift@gmail.com
+ * Date Created: May 15th, 2011
+ * Date Modified: May 15th, 2011
+ */
+
+#ifndef SWIFT_SHARD_H_
+#define SWIFT_SHARD_H_
+
+/********************************
+ *          1. Includes         *
+ ********************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "csearch.h"
+#include "manifest.h"
+#include "protocol.h"
+
+/********************************
+ *          2. Constants        *
+ ********************************/
+
+/* Asks a shard for its counts of a query: "df so cats dogs" */
+#define STATS_REQUEST "df "
+
+/* Asks a shard for its results scored with every shard's counts: "sc <files> <units> <count>...\nso cats dogs" */
+#define SCORE_REQUEST "sc "
+
+/* Asks a shard for every term a wildcard or fuzzy word matches, "term files" a line: "ex cat*" */
+#define EXPAND_REQUEST "ex "
+
+/* Hands a shard the terms chosen for a wildcard or fuzzy word, a line ahead of a request: "ct cat* cat cats\n" */
+#define CHOSEN_TERMS "ct "
+
+/********************************
+ *      3. Structs & Typedefs   *
+ ********************************/
+
+struct Shard_;
+typedef struct Shard_* Shard;
+
+struct ShardResult_;
+typedef struct ShardResult_* ShardResult;
+
+struct Coordinator_;
+typedef struct Coordinator_* Coordinator;
+
+struct Expansion_;
+typedef struct Expansion_* Expansion;
+
+/********************************
+ *      4. Shard Functions      *
+ ********************************/
+
+/* answerStats
+ *
+ * Answers a STATS_REQUEST: how many files the shard has, how many
+ * units the query has and how many of the shard's files hold each
+ * one (see countUnits), on one line.
+ *
+ * @param   request         the request
+ * @param   files           filelist object of the shard
+ * @param   cache           Cache object
+ * @param   length          where to store the length of the answer
+ *
+ * @return  success         the answer, to be freed by the caller
+ * @return  failure         NULL
+ */
+
+char *answerStats(char *request, Filelist files, Cache cache, unsigned long *length);
+
+/* answerExpansions
+ *
+ * Answers an EXPAND_REQUEST: every term of the shard the word
+ * matches and how many of the shard's files hold it, one per
+ * line (see matchExpansions).
+ *
+ * @param   request         the request
+ * @param   files           filelist object of the shard
+ * @param   length          where to store the length of the answer
+ *
+ * @return  success         the answer, to be freed by the caller
+ * @return  failure         NULL
+ */
+
+char *answerExpansions(char *request, Filelist files, unsigned long *length);
+
+/* answerScores
+ *
+ * Answers a SCORE_REQUEST: runs the query (see search) with every
+ * file scored against the counts of the whole index instead of
+ * the shard's own, so a score means the same on every shard, and
+ * writes one line per result, best first:
+ *
+ *      file# score path
+ *
+ * file# being the file's number in the shard, the score exact.
+ *
+ * @param   request         the request
+ * @param   files           filelist object of the shard
+ * @param   cache           Cache object
+ * @param   length          where to store the length of the answer
+ *
+ * @return  success         the answer, to be freed by the caller
+ * @return  failure         NULL
+ */
+
+char *answerScores(char *request, Filelist files, Cache cache, unsigned long *length);
+
+/* serveShard
+ *
+ * Answers the next request of a coordinator. The CHOSEN_TERMS
+ * lines ahead of it are what the wildcard and fuzzy words of its
+ * query expand to (see files->expansions).
+ *
+ * @param   fd              socket to the coordinator
+ * @param   files           filelist object of the shard
+ * @param   cache           Cache object
+ *
+ * @return  success         1
+ * @return  failure         0 (the coordinator hung up or quit, or
+ *                          could not be answered)
+ */
+
+int serveShard(int fd, Filelist files, Cache cache);
+
+/* startShards
+ *
+ * Starts one worker process per shard of a sharded index (see
+ * writeManifest). Each opens its shard with a cache of its own
+ * and answers the coordinator's requests on a socket until the
+ * coordinator is done (see stopShards). The coordinator loads the
+ * statistics block of the index, if it has one.
+ *
+ * @param   index           name of the sharded index
+ * @param   cachesize       cache size of every worker
+ * @param   proximity       whether files with the terms close
+ *                          together rank higher
+ * @param   topk            best results wanted, 0 for all of them
+ * @param   ranges          ranges of files a top-k query is split
+ *                          into on every worker
+ *
+ * @return  success         new Coordinator
+ * @return  failure         NULL
+ */
+
+Coordinator startShards(char *index, char *cachesize, int proximity, int topk, int ranges);
+
+/* answerShards
+ *
+ * Runs a query on every shard at once and writes out what the REPL
+ * would print for it on the whole index. The shards score their
+ * files with the counts of the whole index, its files and the files
+ * holding each unit of the query, so the merged results and their
+ * order are the same as those of one index of every file. The
+ * counts come from the statistics block written with the index
+ * (see writeStats), or for a query it cannot count from the shards
+ * themselves, which takes one more trip to them. A wildcard or
+ * fuzzy word is expanded to the terms in the most files of the
+ * whole index, chosen once for every shard (see
+ * chooseExpansions), which takes one more trip as well.
+ *
+ * @param   coordinator     Coordinator object
+ * @param   action          "so ..." or "sa ..."
+ * @param   length          where to store the length of the answer
+ *
+ * @return  success         the answer, to be freed by the caller
+ * @return  failure         NULL
+ */
+
+char *answerShards(Coordinator coordinator, char *action, unsigned long *length);
+
+/* stopShards
+ *
+ * Lets every worker know the coordinator is done, waits for them
+ * to exit and frees the Coordinator. NULL is ignored.
+ *
+ * @param   coordinator     Coordinator object
+ *
+ * @return  void
+ */
+
+void stopShards(Coordinator coordinator);
+
+/* runShards
+ *
+ * The REPL of search, for a sharded index: every query is answered
+ * by all the shards together (see answerShards).
+ *
+ * @param   index           name of the sharded index
+ * @param   cachesize       cache size of every worker
+ * @param   proximity       whether files with the terms close
+ *                          together rank higher
+ * @param   topk            best results wanted, 0 for all of them
+ * @param   ranges          ranges of files a top-k query is split
+ *                          into on every worker
+ *
+ * @return  success         1
+ * @return  failure         0
+ */
+
+int runShards(char *index, char *cachesize, int proximity, int topk, int ranges);
+
+#endif /* SWIFT_SHARD_H_ */
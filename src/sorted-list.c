@@ -11,6 +11,7 @@
 #include <stdlib.h>
 #include <assert.h>
 #include "sorted-list.h"
+#include "pool.h"
 
 /* Internal Structs */
 
@@ -31,7 +32,7 @@ struct SLItemT_ {
  * SortedListT is the actual struct for the sorted list. It holds pointers 
  * to the first node in the list and a comparison function.  Also, there is
  * an integer that keeps track of changes to the list so the iterator can 
- * work properly.
+ * work properly. The nodes are carved out of the list's own pool.
  */
 
 struct SortedListT_ {
@@ -39,6 +40,7 @@ struct SortedListT_ {
     CompareFuncT comp;
     DestroyDataFuncT destroy;
     int version;
+    Pool items;
 };
 
 /* SortedListIterT
@@ -75,6 +77,13 @@ SortedListT SLCreate(CompareFuncT cf, DestroyDataFuncT destroy)
         return NULL;
     }
         
+    sl->items = createPool(sizeof(struct SLItemT_), POOL_SLAB_ITEMS);
+    if( sl->items == NULL )
+    {
+        free(sl);
+        return NULL;
+    }
+    
     sl->comp = cf;
     sl->destroy = destroy;
     sl->version = 0;
@@ -90,24 +99,19 @@ SortedListT SLCreate(CompareFuncT cf, DestroyDataFuncT destroy)
  */
 void SLDestroy(SortedListT list)
 {
-    SLItemT curr, next;
+    SLItemT curr;
     if(list != NULL)
     {
-        curr = list->head;
-        
-        while(curr != NULL)
+        /* Nodes go with the pool, only walk them if the data needs destroying */
+        if(list->destroy)
         {
-            next = curr->next;
-            
-            if(list->destroy)
+            for(curr = list->head; curr != NULL; curr = curr->next)
             {
                 list->destroy(curr->data);
             }
-            
-            free(curr);
-            curr = next;
         }
         
+        destroyPool(list->items);
         free(list);
     }
     
@@ -139,7 +143,7 @@ int SLInsert(SortedListT list, void* data)
         return 0;
     }
     
-    newNode = (SLItemT) malloc( sizeof( struct SLItemT_ ) );
+    newNode = (SLItemT) poolAlloc(list->items);
     if(newNode == NULL)
     {
         fprintf(stderr, "Error: Could not malloc new node. Out of memory.\n");
@@ -233,7 +237,7 @@ int SLRemove(SortedListT list, void* data)
                 list->destroy(curr->data);
             }
             
-            free(curr);
+            poolFree(list->items, curr);
             
             list->version++;
             return 1;
@@ -0,0 +1,498 @@
+/*
+ * File: stats.c
+ *
+ * Author: Mike Swift
+ * Email: theycallmeswift@gmail.com
+ * Date Created: May 15th, 2011
+ * Date Modified: May 15th, 2011
+ */
+
+/********************************
+ *          1. Includes         *
+ ********************************/
+
+#include "stats.h"
+
+/********************************
+ *          2. Structs          *
+ ********************************/
+
+/* Stats_
+ *
+ * @param   strings     every term, '\0' terminated, back to back
+ * @param   used        bytes of strings in use
+ * @param   size        bytes of strings allocated
+ * @param   terms       offset of each term in strings
+ * @param   df          number of files holding each term
+ * @param   count       number of terms
+ * @param   capacity    number of terms there is room for
+ * @param   numfiles    number of files
+ */
+
+struct Stats_ {
+    char *strings;
+    size_t used;
+    size_t size;
+    size_t *terms;
+    int *df;
+    int count;
+    int capacity;
+    long numfiles;
+};
+
+/********************************
+ *      3. Helper Functions     *
+ ********************************/
+
+/* appendStat
+ *
+ * Adds a term after the last one of a statistics block, making
+ * room for it as needed.
+ *
+ * @param   stats       Stats object
+ * @param   term        the term, after every term of the block
+ * @param   df          number of files holding it
+ *
+ * @return  success     1
+ * @return  failure     0
+ */
+
+int appendStat(Stats stats, char *term, int df)
+{
+    char *strings;
+    size_t *terms, len, size;
+    int *counts;
+    
+    len = strlen(term) + 1;
+    
+    if(stats->used + len > stats->size)
+    {
+        size = stats->size;
+        while(stats->used + len > size)
+        {
+            size *= 2;
+        }
+        
+        strings = (char*) realloc(stats->strings, size);
+        if(strings == NULL)
+        {
+            return 0;
+        }
+        stats->strings = strings;
+        stats->size = size;
+    }
+    
+    if(stats->count == stats->capacity)
+    {
+        terms = (size_t*) realloc(stats->terms, sizeof(size_t) * stats->capacity * 2);
+        if(terms == NULL)
+        {
+            return 0;
+        }
+        stats->terms = terms;
+        
+        counts = (int*) realloc(stats->df, sizeof(int) * stats->capacity * 2);
+        if(counts == NULL)
+        {
+            return 0;
+        }
+        stats->df = counts;
+        
+        stats->capacity *= 2;
+    }
+    
+    memcpy(stats->strings + stats->used, term, len);
+    stats->terms[stats->count] = stats->used;
+    stats->df[stats->count] = df;
+    stats->used += len;
+    stats->count++;
+    
+    return 1;
+}
+
+/* readNumFiles
+ *
+ * Reads how many files an index has from its <files> line.
+ *
+ * @param   index       name of the index
+ *
+ * @return  success     number of files
+ * @return  failure     -1
+ */
+
+long readNumFiles(char *index)
+{
+    FILE *file;
+    long numfiles;
+    
+    file = fopen(index, "r");
+    if(file == NULL)
+    {
+        fprintf(stderr, "Error: Could not open %s.\n", index);
+        return -1;
+    }
+    
+    if(fscanf(file, "<files> %ld", &numfiles) != 1 || numfiles < 0)
+    {
+        fprintf(stderr, "Error: Malformed index file.\n");
+        numfiles = -1;
+    }
+    
+    fclose(file);
+    
+    return numfiles;
+}
+
+/********************************
+ *      4. Stats Functions      *
+ ********************************/
+
+/* createStats
+ *
+ * Creates an empty statistics block: no files and no terms.
+ *
+ * @return  success         new Stats
+ * @return  failure         NULL
+ */
+
+Stats createStats(void)
+{
+    Stats stats;
+    
+    stats = (Stats) malloc(sizeof(struct Stats_));
+    if(stats == NULL)
+    {
+        fprintf(stderr, "Error: Could not allocate space for statistics.\n");
+        return NULL;
+    }
+    
+    stats->strings = (char*) malloc(STATS_SIZE * 8);
+    stats->terms = (size_t*) malloc(sizeof(size_t) * STATS_SIZE);
+    stats->df = (int*) malloc(sizeof(int) * STATS_SIZE);
+    stats->used = 0;
+    stats->size = STATS_SIZE * 8;
+    stats->count = 0;
+    stats->capacity = STATS_SIZE;
+    stats->numfiles = 0;
+    
+    if(stats->strings == NULL || stats->terms == NULL || stats->df == NULL)
+    {
+        fprintf(stderr, "Error: Could not allocate space for statistics.\n");
+        destroyStats(stats);
+        return NULL;
+    }
+    
+    return stats;
+}
+
+/* destroyStats
+ *
+ * Frees a statistics block. NULL is ignored.
+ *
+ * @param   stats           Stats object
+ *
+ * @return  void
+ */
+
+void destroyStats(Stats stats)
+{
+    if(stats != NULL)
+    {
+        free(stats->strings);
+        free(stats->terms);
+        free(stats->df);
+        free(stats);
+    }
+}
+
+/* addIndexStats
+ *
+ * Folds the counts of one more index into a statistics block: its
+ * files are added to the block's, and the files holding each of
+ * its terms (from its lexicon) to those of the term. The block
+ * of a whole sharded index is grown a shard at a time this way,
+ * without going over any postings.
+ *
+ * @param   stats           Stats object
+ * @param   index           name of the index, which needs a lexicon
+ *
+ * @return  success         1
+ * @return  failure         0
+ */
+
+int addIndexStats(Stats stats, char *index)
+{
+    Stats merged;
+    Lexicon lex;
+    char *term;
+    long numfiles;
+    int i, j, cmp, ok;
+    
+    numfiles = readNumFiles(index);
+    if(numfiles < 0)
+    {
+        return 0;
+    }
+    
+    lex = loadLexicon(index);
+    if(lex == NULL)
+    {
+        fprintf(stderr, "Error: %s has no lexicon.\n", index);
+        return 0;
+    }
+    
+    merged = createStats();
+    if(merged == NULL)
+    {
+        destroyLexicon(lex);
+        return 0;
+    }
+    
+    /* Both are sorted, so one pass over each merges them */
+    i = 0;
+    j = 0;
+    ok = 1;
+    
+    while(ok && (i < stats->count || j < lexiconSize(lex)))
+    {
+        term = (j < lexiconSize(lex)) ? lexiconTerm(lex, j) : NULL;
+        
+        if(i == stats->count)
+        {
+            cmp = 1;
+        }
+        else if(term == NULL)
+        {
+            cmp = -1;
+        }
+        else
+        {
+            cmp = strcmp(stats->strings + stats->terms[i], term);
+        }
+        
+        if(cmp < 0)
+        {
+            ok = appendStat(merged, stats->strings + stats->terms[i], stats->df[i]);
+            i++;
+        }
+        else if(cmp > 0)
+        {
+            ok = appendStat(merged, term, lexiconFrequency(lex, j));
+            j++;
+        }
+        else
+        {
+            ok = appendStat(merged, term, stats->df[i] + lexiconFrequency(lex, j));
+            i++;
+            j++;
+        }
+    }
+    
+    destroyLexicon(lex);
+    
+    if(!ok)
+    {
+        fprintf(stderr, "Error: Could not allocate space for statistics.\n");
+        destroyStats(merged);
+        return 0;
+    }
+    
+    /* The block takes over the merged terms */
+    free(stats->strings);
+    free(stats->terms);
+    free(stats->df);
+    
+    stats->strings = merged->strings;
+    stats->used = merged->used;
+    stats->size = merged->size;
+    stats->terms = merged->terms;
+    stats->df = merged->df;
+    stats->count = merged->count;
+    stats->capacity = merged->capacity;
+    stats->numfiles += numfiles;
+    
+    free(merged);
+    
+    return 1;
+}
+
+/* writeStats
+ *
+ * Writes a statistics block next to an index:
+ *
+ * <stats> #files
+ * term #files
+ * term #files
+ * ... etc ...
+ * </stats>
+ *
+ * terms in sorted order.
+ *
+ * @param   stats           Stats object
+ * @param   index           name of the index
+ *
+ * @return  success         1
+ * @return  failure         0
+ */
+
+int writeStats(Stats stats, char *index)
+{
+    FILE *file;
+    int i, ok;
+    
+    file = openSidecar(index, STATS_SUFFIX, "w");
+    if(file == NULL)
+    {
+        fprintf(stderr, "Error: Could not create the statistics of %s.\n", index);
+        return 0;
+    }
+    
+    ok = (fprintf(file, "%s %ld\n", STATS_OPEN, stats->numfiles) > 0);
+    
+    for(i = 0; i < stats->count && ok; i++)
+    {
+        ok = (fprintf(file, "%s %d\n", stats->strings + stats->terms[i], stats->df[i]) > 0);
+    }
+    
+    ok = ok && (fprintf(file, "%s\n", STATS_CLOSE) > 0);
+    
+    if(fclose(file) != 0 || !ok)
+    {
+        fprintf(stderr, "Error: Could not write the statistics of %s.\n", index);
+        return 0;
+    }
+    
+    return 1;
+}
+
+/* loadStats
+ *
+ * Loads the statistics block written next to an index (see
+ * writeStats).
+ *
+ * @param   index           name of the index
+ *
+ * @return  success         new Stats
+ * @return  no block        NULL
+ */
+
+Stats loadStats(char *index)
+{
+    Stats stats;
+    FILE *file;
+    char line[LEXICON_LINE_SIZE], *space;
+    int df, closed;
+    
+    file = openSidecar(index, STATS_SUFFIX, "r");
+    if(file == NULL)
+    {
+        return NULL;
+    }
+    
+    stats = createStats();
+    if(stats == NULL)
+    {
+        fclose(file);
+        return NULL;
+    }
+    
+    if(fgets(line, LEXICON_LINE_SIZE, file) == NULL ||
+       strncmp(line, STATS_OPEN, strlen(STATS_OPEN)) != 0 ||
+       sscanf(line + strlen(STATS_OPEN), "%ld", &stats->numfiles) != 1)
+    {
+        fprintf(stderr, "Error: Malformed statistics file.\n");
+        destroyStats(stats);
+        fclose(file);
+        return NULL;
+    }
+    
+    closed = 0;
+    
+    while(!closed && fgets(line, LEXICON_LINE_SIZE, file) != NULL)
+    {
+        if(strncmp(line, STATS_CLOSE, strlen(STATS_CLOSE)) == 0)
+        {
+            closed = 1;
+            continue;
+        }
+        
+        /* term #files, the term never holds a space */
+        space = strchr(line, ' ');
+        if(space == NULL || sscanf(space + 1, "%d", &df) != 1)
+        {
+            break;
+        }
+        *space = '\0';
+        
+        if(appendStat(stats, line, df) == 0)
+        {
+            fprintf(stderr, "Error: Could not allocate space for statistics.\n");
+            destroyStats(stats);
+            fclose(file);
+            return NULL;
+        }
+    }
+    
+    fclose(file);
+    
+    /* A block cut short would score with counts that are too low */
+    if(!closed)
+    {
+        fprintf(stderr, "Error: Malformed statistics file.\n");
+        destroyStats(stats);
+        return NULL;
+    }
+    
+    return stats;
+}
+
+/* statsFiles
+ *
+ * @param   stats           Stats object
+ *
+ * @return  long            number of files
+ */
+
+long statsFiles(Stats stats)
+{
+    return stats->numfiles;
+}
+
+/* statsFrequency
+ *
+ * Binary search for the number of files holding a term.
+ *
+ * @param   stats           Stats object
+ * @param   term            term to find
+ *
+ * @return  int             number of files, 0 for a term no file has
+ */
+
+int statsFrequency(Stats stats, char *term)
+{
+    int lo, hi, mid, cmp;
+    
+    lo = 0;
+    hi = stats->count - 1;
+    
+    while(lo <= hi)
+    {
+        mid = lo + (hi - lo) / 2;
+        cmp = strcmp(stats->strings + stats->terms[mid], term);
+        
+        if(cmp == 0)
+        {
+            return stats->df[mid];
+        }
+        else if(cmp < 0)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid - 1;
+        }
+    }
+    
+    return 0;
+}
@@ -0,0 +1,140 @@
+/*
+ * File: stats.h
+ *
+ * Author: Mike Swift
+ * Email: theycallmeswift@gmail.com
+ * Date Created: May 15th, 2011
+ * Date Modified: May 15th, 2011
+ */
+
+#ifndef SWIFT_STATS_H_
+#define SWIFT_STATS_H_
+
+/********************************
+ *          1. Includes         *
+ ********************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "lexicon.h"
+#include "postings.h"
+
+/********************************
+ *          2. Constants        *
+ ********************************/
+
+/* Text stream of "<stats> #files", "term #files" lines and "</stats>" next to a sharded or a merged index */
+#define STATS_SUFFIX ".gst"
+
+/* Marks the statistics block, the opening one followed by the files of every shard */
+#define STATS_OPEN "<stats>"
+#define STATS_CLOSE "</stats>"
+
+/* Initial number of terms a statistics block has room for (grows as needed) */
+#define STATS_SIZE 1024
+
+/********************************
+ *      3. Structs & Typedefs   *
+ ********************************/
+
+struct Stats_;
+typedef struct Stats_* Stats;
+
+/********************************
+ *      4. Stats Functions      *
+ ********************************/
+
+/* createStats
+ *
+ * Creates an empty statistics block: no files and no terms.
+ *
+ * @return  success         new Stats
+ * @return  failure         NULL
+ */
+
+Stats createStats(void);
+
+/* destroyStats
+ *
+ * Frees a statistics block. NULL is ignored.
+ *
+ * @param   stats           Stats object
+ *
+ * @return  void
+ */
+
+void destroyStats(Stats stats);
+
+/* addIndexStats
+ *
+ * Folds the counts of one more index into a statistics block: its
+ * files are added to the block's, and the files holding each of
+ * its terms (from its lexicon) to those of the term. The block
+ * of a whole sharded index is grown a shard at a time this way,
+ * without going over any postings.
+ *
+ * @param   stats           Stats object
+ * @param   index           name of the index, which needs a lexicon
+ *
+ * @return  success         1
+ * @return  failure         0
+ */
+
+int addIndexStats(Stats stats, char *index);
+
+/* writeStats
+ *
+ * Writes a statistics block next to an index:
+ *
+ * <stats> #files
+ * term #files
+ * term #files
+ * ... etc ...
+ * </stats>
+ *
+ * terms in sorted order.
+ *
+ * @param   stats           Stats object
+ * @param   index           name of the index
+ *
+ * @return  success         1
+ * @return  failure         0
+ */
+
+int writeStats(Stats stats, char *index);
+
+/* loadStats
+ *
+ * Loads the statistics block written next to an index (see
+ * writeStats).
+ *
+ * @param   index           name of the index
+ *
+ * @return  success         new Stats
+ * @return  no block        NULL
+ */
+
+Stats loadStats(char *index);
+
+/* statsFiles
+ *
+ * @param   stats           Stats object
+ *
+ * @return  long            number of files
+ */
+
+long statsFiles(Stats stats);
+
+/* statsFrequency
+ *
+ * Binary search for the number of files holding a term.
+ *
+ * @param   stats           Stats object
+ * @param   term            term to find
+ *
+ * @return  int             number of files, 0 for a term no file has
+ */
+
+int statsFrequency(Stats stats, char *term);
+
+#endif /* SWIFT_STATS_H_ */
@@ -0,0 +1,322 @@
+/*
+ * File: threadpool.c
+ *
+ * Author: Mike Swift
+ * Email: theycallmeswift@gmail.com
+ * Date Created: May 15th, 2011
+ * Date Modified: May 15th, 2011
+ */
+
+/********************************
+ *          1. Includes         *
+ ********************************/
+
+/* Threads are POSIX, not ANSI */
+#define _XOPEN_SOURCE 600
+
+#include <pthread.h>
+#include "threadpool.h"
+
+/********************************
+ *          2. Structs          *
+ ********************************/
+
+/* Job_
+ *
+ * @param   job         what was passed to submitJob
+ * @param   next        next job in the queue
+ */
+
+struct Job_ {
+    void *job;
+    Job next;
+};
+
+/* Worker_
+ *
+ * @param   pool        pool the thread belongs to
+ * @param   state       the thread's own state
+ */
+
+struct Worker_ {
+    ThreadPool pool;
+    void *state;
+};
+
+/* ThreadPool_
+ *
+ * @param   func        function that runs a job
+ * @param   threads     the running threads
+ * @param   workers     what each thread was started with
+ * @param   numthreads  number of threads
+ * @param   head        next job to run
+ * @param   tail        last job queued
+ * @param   running     jobs taken off the queue and not done yet
+ * @param   stopping    set once no more jobs will come
+ * @param   lock        guards the queue, running and stopping
+ * @param   ready       signalled when a job is queued or the pool stops
+ * @param   idle        signalled when the last job queued is done
+ */
+
+struct ThreadPool_ {
+    JobFunc func;
+    pthread_t *threads;
+    struct Worker_ *workers;
+    int numthreads;
+    Job head;
+    Job tail;
+    int running;
+    int stopping;
+    pthread_mutex_t lock;
+    pthread_cond_t ready;
+    pthread_cond_t idle;
+};
+
+/********************************
+ *      3. Helper Functions     *
+ ********************************/
+
+/* runWorker
+ *
+ * Body of every thread in a pool: takes jobs off the queue and
+ * runs them until the pool stops and the queue is empty.
+ *
+ * @param   arg         the thread's Worker_
+ *
+ * @return  NULL
+ */
+
+void *runWorker(void *arg)
+{
+    struct Worker_ *worker;
+    ThreadPool pool;
+    Job job;
+    
+    worker = (struct Worker_*) arg;
+    pool = worker->pool;
+    
+    for(;;)
+    {
+        pthread_mutex_lock(&pool->lock);
+        
+        while(pool->head == NULL && !pool->stopping)
+        {
+            pthread_cond_wait(&pool->ready, &pool->lock);
+        }
+        
+        job = pool->head;
+        if(job == NULL)
+        {
+            /* Stopping, and nothing left to do */
+            pthread_mutex_unlock(&pool->lock);
+            return NULL;
+        }
+        
+        pool->head = job->next;
+        if(pool->head == NULL)
+        {
+            pool->tail = NULL;
+        }
+        pool->running++;
+        
+        pthread_mutex_unlock(&pool->lock);
+        
+        pool->func(worker->state, job->job);
+        free(job);
+        
+        pthread_mutex_lock(&pool->lock);
+        
+        pool->running--;
+        if(pool->running == 0 && pool->head == NULL)
+        {
+            pthread_cond_broadcast(&pool->idle);
+        }
+        
+        pthread_mutex_unlock(&pool->lock);
+    }
+}
+
+/********************************
+ *    4. Thread Pool Functions  *
+ ********************************/
+
+/* createThreadPool
+ *
+ * Starts a fixed number of threads that take jobs off a queue
+ * (see submitJob) in the order they were submitted. Every thread
+ * has its own piece of state that only it ever sees, for whatever
+ * is not safe to share, like a Filelist.
+ *
+ * @param   numthreads      number of threads, 1 to MAX_THREADS
+ * @param   func            function that runs a job
+ * @param   workers         one piece of state per thread, or NULL
+ *
+ * @return  success         new ThreadPool
+ * @return  failure         NULL
+ */
+
+ThreadPool createThreadPool(int numthreads, JobFunc func, void **workers)
+{
+    ThreadPool pool;
+    int i;
+    
+    if(numthreads < 1 || numthreads > MAX_THREADS || func == NULL)
+    {
+        fprintf(stderr, "Error: A thread pool needs a job function and 1 to %d threads.\n", MAX_THREADS);
+        return NULL;
+    }
+    
+    pool = (ThreadPool) malloc(sizeof(struct ThreadPool_));
+    if(pool == NULL)
+    {
+        fprintf(stderr, "Error: Could not allocate space for the thread pool.\n");
+        return NULL;
+    }
+    
+    pool->threads = (pthread_t*) malloc(sizeof(pthread_t) * numthreads);
+    pool->workers = (struct Worker_*) malloc(sizeof(struct Worker_) * numthreads);
+    if(pool->threads == NULL || pool->workers == NULL)
+    {
+        fprintf(stderr, "Error: Could not allocate space for the thread pool.\n");
+        free(pool->threads);
+        free(pool->workers);
+        free(pool);
+        return NULL;
+    }
+    
+    pool->func = func;
+    pool->numthreads = 0;
+    pool->head = NULL;
+    pool->tail = NULL;
+    pool->running = 0;
+    pool->stopping = 0;
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->ready, NULL);
+    pthread_cond_init(&pool->idle, NULL);
+    
+    for(i = 0; i < numthreads; i++)
+    {
+        pool->workers[i].pool = pool;
+        pool->workers[i].state = (workers != NULL) ? workers[i] : NULL;
+        
+        if(pthread_create(&pool->threads[i], NULL, runWorker, &pool->workers[i]) != 0)
+        {
+            fprintf(stderr, "Error: Could not start thread %d of the pool.\n", i);
+            destroyThreadPool(pool);
+            return NULL;
+        }
+        
+        pool->numthreads++;
+    }
+    
+    return pool;
+}
+
+/* submitJob
+ *
+ * Queues a job for the next free thread and returns right away.
+ *
+ * @param   pool            ThreadPool object
+ * @param   job             job to hand to the JobFunc
+ *
+ * @return  success         1
+ * @return  failure         0
+ */
+
+int submitJob(ThreadPool pool, void *job)
+{
+    Job queued;
+    
+    if(pool == NULL)
+    {
+        fprintf(stderr, "Error: Cannot submit a job to a NULL thread pool.\n");
+        return 0;
+    }
+    
+    queued = (Job) malloc(sizeof(struct Job_));
+    if(queued == NULL)
+    {
+        fprintf(stderr, "Error: Could not allocate space for a job.\n");
+        return 0;
+    }
+    
+    queued->job = job;
+    queued->next = NULL;
+    
+    pthread_mutex_lock(&pool->lock);
+    
+    if(pool->tail == NULL)
+    {
+        pool->head = queued;
+    }
+    else
+    {
+        pool->tail->next = queued;
+    }
+    pool->tail = queued;
+    
+    pthread_cond_signal(&pool->ready);
+    pthread_mutex_unlock(&pool->lock);
+    
+    return 1;
+}
+
+/* waitThreadPool
+ *
+ * Waits until every job queued so far is done, and leaves the
+ * threads running for the next ones. NULL is ignored.
+ *
+ * @param   pool            ThreadPool object
+ *
+ * @return  void
+ */
+
+void waitThreadPool(ThreadPool pool)
+{
+    if(pool != NULL)
+    {
+        pthread_mutex_lock(&pool->lock);
+        
+        while(pool->head != NULL || pool->running > 0)
+        {
+            pthread_cond_wait(&pool->idle, &pool->lock);
+        }
+        
+        pthread_mutex_unlock(&pool->lock);
+    }
+}
+
+/* destroyThreadPool
+ *
+ * Lets the threads finish every job already queued, then stops
+ * them and frees the pool. NULL is ignored.
+ *
+ * @param   pool            ThreadPool object
+ *
+ * @return  void
+ */
+
+void destroyThreadPool(ThreadPool pool)
+{
+    int i;
+    
+    if(pool != NULL)
+    {
+        pthread_mutex_lock(&pool->lock);
+        pool->stopping = 1;
+        pthread_cond_broadcast(&pool->ready);
+        pthread_mutex_unlock(&pool->lock);
+        
+        for(i = 0; i < pool->numthreads; i++)
+        {
+            pthread_join(pool->threads[i], NULL);
+        }
+        
+        pthread_mutex_destroy(&pool->lock);
+        pthread_cond_destroy(&pool->ready);
+        pthread_cond_destroy(&pool->idle);
+        free(pool->threads);
+        free(pool->workers);
+        free(pool);
+    }
+}
@@ -0,0 +1,107 @@
+/*
+ * File: threadpool.h
+ *
+ * Author: Mike Swift
+ * Email: theycallmeswift@gmail.com
+ * Date Created: May 15th, 2011
+ * Date Modified: May 15th, 2011
+ */
+
+#ifndef SWIFT_THREADPOOL_H_
+#define SWIFT_THREADPOOL_H_
+
+/********************************
+ *          1. Includes         *
+ ********************************/
+#include <stdio.h>
+#include <stdlib.h>
+
+/********************************
+ *          2. Constants        *
+ ********************************/
+
+/* Most threads a pool will start */
+#define MAX_THREADS 64
+
+/********************************
+ *      3. Structs & Typedefs   *
+ ********************************/
+
+/* JobFunc
+ *
+ * Runs one job on a worker thread.
+ *
+ * @param   worker          the state handed to this thread
+ *                          (see createThreadPool)
+ * @param   job             the job, as passed to submitJob
+ *
+ * @return  void
+ */
+
+typedef void (*JobFunc)(void *worker, void *job);
+
+struct Job_;
+typedef struct Job_* Job;
+
+struct ThreadPool_;
+typedef struct ThreadPool_* ThreadPool;
+
+/********************************
+ *    4. Thread Pool Functions  *
+ ********************************/
+
+/* createThreadPool
+ *
+ * Starts a fixed number of threads that take jobs off a queue
+ * (see submitJob) in the order they were submitted. Every thread
+ * has its own piece of state that only it ever sees, for whatever
+ * is not safe to share, like a Filelist.
+ *
+ * @param   numthreads      number of threads, 1 to MAX_THREADS
+ * @param   func            function that runs a job
+ * @param   workers         one piece of state per thread, or NULL
+ *
+ * @return  success         new ThreadPool
+ * @return  failure         NULL
+ */
+
+ThreadPool createThreadPool(int numthreads, JobFunc func, void **workers);
+
+/* submitJob
+ *
+ * Queues a job for the next free thread and returns right away.
+ *
+ * @param   pool            ThreadPool object
+ * @param   job             job to hand to the JobFunc
+ *
+ * @return  success         1
+ * @return  failure         0
+ */
+
+int submitJob(ThreadPool pool, void *job);
+
+/* waitThreadPool
+ *
+ * Waits until every job queued so far is done, and leaves the
+ * threads running for the next ones. NULL is ignored.
+ *
+ * @param   pool            ThreadPool object
+ *
+ * @return  void
+ */
+
+void waitThreadPool(ThreadPool pool);
+
+/* destroyThreadPool
+ *
+ * Lets the threads finish every job already queued, then stops
+ * them and frees the pool. NULL is ignored.
+ *
+ * @param   pool            ThreadPool object
+ *
+ * @return  void
+ */
+
+void destroyThreadPool(ThreadPool pool);
+
+#endif /* SWIFT_THREADPOOL_H_ */
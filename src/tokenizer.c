@@ -195,8 +195,46 @@ void TKDestroy(TokenizerT tk)
 
 char *TKGetNextToken(TokenizerT tk)
 {
-    int characterCounter, bufferSize, bufferLocation;
-    char *buffer, *bufferPtr, c;
+    char buffer[MAX_BUFFER_SIZE], *token;
+    int length;
+    
+    if(TKGetNextTokenInto(tk, buffer, MAX_BUFFER_SIZE) == 0)
+    {
+        return 0;
+    }
+    
+    length = strlen(buffer);
+    
+    token = (char *) malloc( sizeof(char) * (length + 1) );
+    if(token == NULL)
+    {
+        printf("ERROR: Malloc failed");
+        exit(-1);
+    }
+    
+    memcpy(token, buffer, length + 1);
+    return token;
+}
+
+/* TKGetNextTokenInto
+ *
+ * Same as TKGetNextToken, but the token is written into a buffer
+ * supplied by the caller so nothing is allocated. Tokens that do
+ * not fit (including the '\0') end the stream, just like tokens
+ * longer than MAX_BUFFER_SIZE do for TKGetNextToken.
+ *
+ * @param   tk          Tokenizer object
+ * @param   buffer      where to write the token
+ * @param   size        size of buffer
+ *
+ * @return  success     buffer
+ * @return  failure     0
+ */
+
+char *TKGetNextTokenInto(TokenizerT tk, char *buffer, int size)
+{
+    int characterCounter, bufferLocation;
+    char c;
 
     if(tk == NULL)
     {
@@ -209,33 +247,10 @@ char *TKGetNextToken(TokenizerT tk)
         return 0;
     }
 
-    bufferSize = 256;
-
-    buffer = (char *) malloc( sizeof(char) * bufferSize );
     bufferLocation = 0;
 
     while ((c = (char) fgetc(tk->file)) != EOF)
     {
-        if(bufferLocation >= bufferSize)
-        {
-            if( bufferSize >= MAX_BUFFER_SIZE )
-            {
-                /* printf("String too big for Buffer!\n");*/
-                free(buffer);
-                return 0;
-            }
-
-            bufferSize *= 2;
-
-            bufferPtr = buffer;
-
-            buffer = (char *) malloc( sizeof(char) * bufferSize );
-            strcpy(buffer, bufferPtr);
-
-            free(bufferPtr);
-            bufferPtr = NULL;
-        }
-
         characterCounter = 0;
         while(tk->allowedCharacters[characterCounter] != c && tk->allowedCharacters[characterCounter] != '\0')
         {
@@ -253,11 +268,15 @@ char *TKGetNextToken(TokenizerT tk)
         }
         else
         {
+            if(bufferLocation >= size - 1)
+            {
+                /* printf("String too big for Buffer!\n");*/
+                return 0;
+            }
+            
             buffer[bufferLocation] = tolower(c);
             bufferLocation++;
         }
     }
-    free(buffer);
     return 0;
 }
-
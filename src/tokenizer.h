@@ -58,6 +58,23 @@ void TKDestroy(TokenizerT tk);
 
 char *TKGetNextToken(TokenizerT tk);
 
+/* TKGetNextTokenInto
+ *
+ * Same as TKGetNextToken, but the token is written into a buffer
+ * supplied by the caller so nothing is allocated. Tokens that do
+ * not fit (including the '\0') end the stream, just like tokens
+ * longer than MAX_BUFFER_SIZE do for TKGetNextToken.
+ *
+ * @param   tk          Tokenizer object
+ * @param   buffer      where to write the token
+ * @param   size        size of buffer
+ *
+ * @return  success     buffer
+ * @return  failure     0
+ */
+
+char *TKGetNextTokenInto(TokenizerT tk, char *buffer, int size);
+
 /* TKReset
  *
  * Resets the tokenizer to the start of the current file.
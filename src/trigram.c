@@ -0,0 +1,847 @@
+/*
+ * File: trigram.c
+ *
+ * Author: Mike Swift
+ * Email: theycallmeswift@gmail.com
+ * Date Created: May 13th, 2011
+ * Date Modified: May 13th, 2011
+ */
+
+/********************************
+ *          1. Includes         *
+ ********************************/
+
+#include "trigram.h"
+
+/********************************
+ *          2. Structs          *
+ ********************************/
+
+/* TrigramPair_
+ *
+ * @param   gram        trigram, the three bytes high to low
+ * @param   filenum     file that holds it
+ */
+
+struct TrigramPair_ {
+    unsigned int gram;
+    int filenum;
+};
+
+/* Trigrams_
+ *
+ * @param   pairs       every (trigram, file) pair recorded
+ * @param   count       number of pairs
+ * @param   capacity    number of pairs there is room for
+ * @param   seen        one bit per trigram, set while a file is read
+ */
+
+struct Trigrams_ {
+    struct TrigramPair_ *pairs;
+    size_t count;
+    size_t capacity;
+    unsigned char *seen;
+};
+
+/* TrigramIndex_
+ *
+ * @param   file        the trigram stream
+ * @param   grams       every trigram, ascending
+ * @param   df          number of files holding each trigram
+ * @param   offsets     where each trigram's list starts
+ * @param   count       number of trigrams
+ */
+
+struct TrigramIndex_ {
+    FILE *file;
+    unsigned int *grams;
+    int *df;
+    long *offsets;
+    int count;
+    int shared;
+};
+
+/********************************
+ *      3. Helper Functions     *
+ ********************************/
+
+/* addPair
+ *
+ * Appends a (trigram, file) pair to a builder.
+ *
+ * @param   trigrams    builder
+ * @param   gram        trigram
+ * @param   filenum     file number
+ *
+ * @return  success     1
+ * @return  failure     0
+ */
+
+int addPair(Trigrams trigrams, unsigned int gram, int filenum)
+{
+    struct TrigramPair_ *pairs;
+    
+    if(trigrams->count == trigrams->capacity)
+    {
+        pairs = (struct TrigramPair_*) realloc(trigrams->pairs, sizeof(struct TrigramPair_) * trigrams->capacity * 2);
+        if(pairs == NULL)
+        {
+            fprintf(stderr, "Error: Could not allocate space for trigrams.\n");
+            return 0;
+        }
+        
+        trigrams->pairs = pairs;
+        trigrams->capacity *= 2;
+    }
+    
+    trigrams->pairs[trigrams->count].gram = gram;
+    trigrams->pairs[trigrams->count].filenum = filenum;
+    trigrams->count++;
+    
+    return 1;
+}
+
+/* compTrigramPairs
+ *
+ * qsort comparator that orders pairs by trigram, then by file.
+ *
+ * @param   ptr1        first pair
+ * @param   ptr2        second pair
+ *
+ * @return  int         <0, 0 or >0
+ */
+
+int compTrigramPairs(const void *ptr1, const void *ptr2)
+{
+    const struct TrigramPair_ *p1, *p2;
+    
+    p1 = (const struct TrigramPair_*) ptr1;
+    p2 = (const struct TrigramPair_*) ptr2;
+    
+    if(p1->gram != p2->gram)
+    {
+        return (p1->gram < p2->gram) ? -1 : 1;
+    }
+    
+    return p1->filenum - p2->filenum;
+}
+
+/* vbyteLength
+ *
+ * @param   value       value to encode
+ *
+ * @return  int         bytes writeVByte takes for value
+ */
+
+int vbyteLength(unsigned int value)
+{
+    int bytes;
+    
+    bytes = 1;
+    while(value >= 0x80)
+    {
+        value >>= 7;
+        bytes++;
+    }
+    
+    return bytes;
+}
+
+/* findGram
+ *
+ * Binary search for a trigram in the directory.
+ *
+ * @param   trigrams    trigram index
+ * @param   gram        trigram to find
+ *
+ * @return  found       its number
+ * @return  not found   -1
+ */
+
+int findGram(TrigramIndex trigrams, unsigned int gram)
+{
+    int low, high, mid;
+    
+    low = 0;
+    high = trigrams->count - 1;
+    
+    while(low <= high)
+    {
+        mid = low + (high - low) / 2;
+        
+        if(trigrams->grams[mid] == gram)
+        {
+            return mid;
+        }
+        
+        if(trigrams->grams[mid] < gram)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid - 1;
+        }
+    }
+    
+    return -1;
+}
+
+/* readGramList
+ *
+ * Reads the file numbers of one trigram.
+ *
+ * @param   trigrams    trigram index
+ * @param   i           number of the trigram
+ * @param   files       where to store its df file numbers
+ *
+ * @return  success     1
+ * @return  failure     0
+ */
+
+int readGramList(TrigramIndex trigrams, int i, int *files)
+{
+    unsigned int gap;
+    int j, filenum;
+    
+    if(fseek(trigrams->file, trigrams->offsets[i], SEEK_SET) != 0)
+    {
+        return 0;
+    }
+    
+    filenum = 0;
+    
+    for(j = 0; j < trigrams->df[i]; j++)
+    {
+        if(readVByte(trigrams->file, &gap) == 0)
+        {
+            fprintf(stderr, "Error: Malformed trigram file.\n");
+            return 0;
+        }
+        
+        filenum += gap;
+        files[j] = filenum;
+    }
+    
+    return 1;
+}
+
+/********************************
+ *      4. Builder Functions    *
+ ********************************/
+
+/* createTrigrams
+ *
+ * Creates an empty trigram index builder. Every file added records
+ * each distinct (lowercased) three byte sequence it holds once.
+ *
+ * @return  success         new Trigrams
+ * @return  failure         NULL
+ */
+
+Trigrams createTrigrams(void)
+{
+    Trigrams trigrams;
+    
+    trigrams = (Trigrams) malloc(sizeof(struct Trigrams_));
+    if(trigrams == NULL)
+    {
+        fprintf(stderr, "Error: Could not allocate space for trigrams.\n");
+        return NULL;
+    }
+    
+    trigrams->pairs = (struct TrigramPair_*) malloc(sizeof(struct TrigramPair_) * TRIGRAM_PAIRS);
+    trigrams->seen = (unsigned char*) calloc(TRIGRAM_SPACE / 8, 1);
+    trigrams->count = 0;
+    trigrams->capacity = TRIGRAM_PAIRS;
+    
+    if(trigrams->pairs == NULL || trigrams->seen == NULL)
+    {
+        fprintf(stderr, "Error: Could not allocate space for trigrams.\n");
+        destroyTrigrams(trigrams);
+        return NULL;
+    }
+    
+    return trigrams;
+}
+
+/* destroyTrigrams
+ *
+ * Frees a builder. NULL is ignored.
+ *
+ * @param   trigrams        builder to destroy
+ *
+ * @return  void
+ */
+
+void destroyTrigrams(Trigrams trigrams)
+{
+    if(trigrams != NULL)
+    {
+        free(trigrams->pairs);
+        free(trigrams->seen);
+        free(trigrams);
+    }
+}
+
+/* addFileTrigrams
+ *
+ * Reads a file and records its trigrams. Files must be added in
+ * file number order.
+ *
+ * @param   trigrams        builder
+ * @param   filename        file to read
+ * @param   filenum         number of the file
+ *
+ * @return  success         1
+ * @return  failure         0
+ */
+
+int addFileTrigrams(Trigrams trigrams, char *filename, int filenum)
+{
+    FILE *file;
+    size_t first, i;
+    unsigned int gram;
+    int c, n, res;
+    
+    file = fopen(filename, "rb");
+    if(file == NULL)
+    {
+        fprintf(stderr, "Error: Could not open %s for trigrams.\n", filename);
+        return 0;
+    }
+    
+    first = trigrams->count;
+    gram = 0;
+    n = 0;
+    res = 1;
+    
+    while(res == 1 && (c = getc(file)) != EOF)
+    {
+        gram = ((gram << 8) | (unsigned int) tolower(c)) & (TRIGRAM_SPACE - 1);
+        n++;
+        
+        /* Only the first sighting in a file is recorded */
+        if(n >= 3 && (trigrams->seen[gram >> 3] & (1 << (gram & 7))) == 0)
+        {
+            trigrams->seen[gram >> 3] |= 1 << (gram & 7);
+            res = addPair(trigrams, gram, filenum);
+        }
+    }
+    
+    fclose(file);
+    
+    /* Clear only the bits this file set */
+    for(i = first; i < trigrams->count; i++)
+    {
+        gram = trigrams->pairs[i].gram;
+        trigrams->seen[gram >> 3] &= ~(1 << (gram & 7));
+    }
+    
+    return res;
+}
+
+/* loadTrigrams
+ *
+ * Adds every posting of an existing trigram index to a builder,
+ * shifting its file numbers, so several indexes can be merged.
+ * Indexes must be added in file number order.
+ *
+ * @param   trigrams        builder
+ * @param   index           name of the inverted index
+ * @param   offset          added to every file number
+ *
+ * @return  success         1
+ * @return  failure         0
+ */
+
+int loadTrigrams(Trigrams trigrams, char *index, int offset)
+{
+    FILE *file;
+    unsigned int count, gap, df, bytes, gram, i, j;
+    int filenum, res;
+    
+    file = openSidecar(index, TRIGRAM_SUFFIX, "rb");
+    if(file == NULL)
+    {
+        fprintf(stderr, "Error: Could not open the trigrams of %s.\n", index);
+        return 0;
+    }
+    
+    res = readVByte(file, &count);
+    gram = 0;
+    
+    for(i = 0; res == 1 && i < count; i++)
+    {
+        if(readVByte(file, &gap) == 0 || readVByte(file, &df) == 0 || readVByte(file, &bytes) == 0)
+        {
+            res = 0;
+            break;
+        }
+        
+        gram += gap;
+        filenum = 0;
+        
+        for(j = 0; res == 1 && j < df; j++)
+        {
+            if(readVByte(file, &gap) == 0)
+            {
+                res = 0;
+                break;
+            }
+            
+            filenum += gap;
+            res = addPair(trigrams, gram, filenum + offset);
+        }
+    }
+    
+    if(res == 0)
+    {
+        fprintf(stderr, "Error: Malformed trigram file.\n");
+    }
+    
+    fclose(file);
+    
+    return res;
+}
+
+/* writeTrigrams
+ *
+ * Writes the trigram stream of an inverted index:
+ *
+ *      #trigrams
+ *      per trigram: gap to the last trigram, #files, #bytes,
+ *                   then the gaps between its file numbers
+ *
+ * Every number is written with writeVByte, so a posting usually
+ * takes one byte. #bytes lets a reader skip a list unread.
+ *
+ * @param   trigrams        builder
+ * @param   index           name of the inverted index
+ *
+ * @return  success         1
+ * @return  failure         0
+ */
+
+int writeTrigrams(Trigrams trigrams, char *index)
+{
+    FILE *file;
+    struct TrigramPair_ *pairs;
+    size_t start, end, i;
+    unsigned int numgrams, prevgram, bytes;
+    int df, prev, res;
+    
+    pairs = trigrams->pairs;
+    qsort(pairs, trigrams->count, sizeof(struct TrigramPair_), compTrigramPairs);
+    
+    numgrams = 0;
+    for(i = 0; i < trigrams->count; i++)
+    {
+        if(i == 0 || pairs[i].gram != pairs[i - 1].gram)
+        {
+            numgrams++;
+        }
+    }
+    
+    file = openSidecar(index, TRIGRAM_SUFFIX, "wb");
+    if(file == NULL)
+    {
+        fprintf(stderr, "Error: Could not open the trigrams of %s.\n", index);
+        return 0;
+    }
+    
+    res = (writeVByte(file, numgrams) != 0);
+    prevgram = 0;
+    
+    for(start = 0; res == 1 && start < trigrams->count; start = end)
+    {
+        /* Size up the list first so a reader can skip it */
+        df = 0;
+        bytes = 0;
+        prev = 0;
+        
+        for(end = start; end < trigrams->count && pairs[end].gram == pairs[start].gram; end++)
+        {
+            if(end == start || pairs[end].filenum != pairs[end - 1].filenum)
+            {
+                bytes += vbyteLength(pairs[end].filenum - prev);
+                prev = pairs[end].filenum;
+                df++;
+            }
+        }
+        
+        res = writeVByte(file, pairs[start].gram - prevgram) != 0 &&
+              writeVByte(file, df) != 0 &&
+              writeVByte(file, bytes) != 0;
+        prevgram = pairs[start].gram;
+        prev = 0;
+        
+        for(i = start; res == 1 && i < end; i++)
+        {
+            if(i == start || pairs[i].filenum != pairs[i - 1].filenum)
+            {
+                res = (writeVByte(file, pairs[i].filenum - prev) != 0);
+                prev = pairs[i].filenum;
+            }
+        }
+    }
+    
+    if(fclose(file) != 0 || res == 0)
+    {
+        fprintf(stderr, "Error: Could not write the trigrams of %s.\n", index);
+        return 0;
+    }
+    
+    return 1;
+}
+
+/********************************
+ *      5. Search Functions     *
+ ********************************/
+
+/* openTrigramIndex
+ *
+ * Opens the trigram stream of an inverted index and reads its
+ * directory (every trigram, its #files and where its list starts).
+ * The lists themselves are read on demand.
+ *
+ * @param   index           name of the inverted index
+ *
+ * @return  success         new TrigramIndex
+ * @return  no trigrams     NULL
+ */
+
+TrigramIndex openTrigramIndex(char *index)
+{
+    TrigramIndex trigrams;
+    FILE *file;
+    unsigned int count, gap, df, bytes, gram;
+    int i;
+    
+    file = openSidecar(index, TRIGRAM_SUFFIX, "rb");
+    if(file == NULL)
+    {
+        return NULL;
+    }
+    
+    if(readVByte(file, &count) == 0)
+    {
+        fprintf(stderr, "Error: Malformed trigram file.\n");
+        fclose(file);
+        return NULL;
+    }
+    
+    trigrams = (TrigramIndex) malloc(sizeof(struct TrigramIndex_));
+    if(trigrams == NULL)
+    {
+        fprintf(stderr, "Error: Could not allocate space for trigrams.\n");
+        fclose(file);
+        return NULL;
+    }
+    
+    trigrams->file = file;
+    trigrams->count = (int) count;
+    trigrams->shared = 0;
+    trigrams->grams = (unsigned int*) malloc(sizeof(unsigned int) * (count + 1));
+    trigrams->df = (int*) malloc(sizeof(int) * (count + 1));
+    trigrams->offsets = (long*) malloc(sizeof(long) * (count + 1));
+    
+    if(trigrams->grams == NULL || trigrams->df == NULL || trigrams->offsets == NULL)
+    {
+        fprintf(stderr, "Error: Could not allocate space for trigrams.\n");
+        closeTrigramIndex(trigrams);
+        return NULL;
+    }
+    
+    gram = 0;
+    
+    for(i = 0; i < trigrams->count; i++)
+    {
+        if(readVByte(file, &gap) == 0 || readVByte(file, &df) == 0 || readVByte(file, &bytes) == 0)
+        {
+            fprintf(stderr, "Error: Malformed trigram file.\n");
+            closeTrigramIndex(trigrams);
+            return NULL;
+        }
+        
+        gram += gap;
+        trigrams->grams[i] = gram;
+        trigrams->df[i] = (int) df;
+        trigrams->offsets[i] = ftell(file);
+        
+        /* Skip the list, it is read when a query needs it */
+        if(fseek(file, (long) bytes, SEEK_CUR) != 0)
+        {
+            fprintf(stderr, "Error: Malformed trigram file.\n");
+            closeTrigramIndex(trigrams);
+            return NULL;
+        }
+    }
+    
+    return trigrams;
+}
+
+/* shareTrigramIndex
+ *
+ * Opens the trigram stream of an inverted index again, reusing the
+ * directory an open trigram index already read. Each copy reads
+ * its lists through its own stream, so copies can be used from
+ * different threads at once. The copy has to be closed before the
+ * trigram index it was shared from.
+ *
+ * @param   trigrams        open trigram index (NULL gives NULL)
+ * @param   index           name of the inverted index
+ *
+ * @return  success         new TrigramIndex
+ * @return  failure         NULL
+ */
+
+TrigramIndex shareTrigramIndex(TrigramIndex trigrams, char *index)
+{
+    TrigramIndex copy;
+    
+    if(trigrams == NULL)
+    {
+        return NULL;
+    }
+    
+    copy = (TrigramIndex) malloc(sizeof(struct TrigramIndex_));
+    if(copy == NULL)
+    {
+        fprintf(stderr, "Error: Could not allocate space for trigrams.\n");
+        return NULL;
+    }
+    
+    *copy = *trigrams;
+    copy->shared = 1;
+    copy->file = openSidecar(index, TRIGRAM_SUFFIX, "rb");
+    
+    if(copy->file == NULL)
+    {
+        fprintf(stderr, "Error: Could not open the trigrams of %s again.\n", index);
+        free(copy);
+        return NULL;
+    }
+    
+    return copy;
+}
+
+/* closeTrigramIndex
+ *
+ * Closes a trigram index. NULL is ignored.
+ *
+ * @param   trigrams        trigram index to close
+ *
+ * @return  void
+ */
+
+void closeTrigramIndex(TrigramIndex trigrams)
+{
+    if(trigrams != NULL)
+    {
+        fclose(trigrams->file);
+        
+        /* The directory belongs to the index it was shared from */
+        if(trigrams->shared == 0)
+        {
+            free(trigrams->grams);
+            free(trigrams->df);
+            free(trigrams->offsets);
+        }
+        
+        free(trigrams);
+    }
+}
+
+/* findCandidates
+ *
+ * Intersects the lists of every trigram of a (lowercased) string,
+ * rarest first, giving the files that may hold it. Strings shorter
+ * than three bytes have no trigrams and cannot be looked up.
+ *
+ * @param   trigrams        trigram index
+ * @param   str             string to look for
+ * @param   files           where to store the file numbers, room
+ *                          for every file is needed
+ *
+ * @return  success         number of candidates
+ * @return  failure         -1
+ */
+
+int findCandidates(TrigramIndex trigrams, char *str, int *files)
+{
+    unsigned int gram;
+    int *grams, *list, len, numgrams, i, j, k, tmp, count, n;
+    
+    len = strlen(str);
+    if(len < 3)
+    {
+        return -1;
+    }
+    
+    grams = (int*) malloc(sizeof(int) * len);
+    if(grams == NULL)
+    {
+        fprintf(stderr, "Error: Could not allocate space for trigrams.\n");
+        return -1;
+    }
+    
+    /* Look every trigram up, one that is missing rules out every file */
+    numgrams = 0;
+    
+    for(i = 2; i < len; i++)
+    {
+        gram = ((unsigned int) tolower((unsigned char) str[i - 2]) << 16) |
+               ((unsigned int) tolower((unsigned char) str[i - 1]) << 8) |
+               (unsigned int) tolower((unsigned char) str[i]);
+        
+        grams[numgrams] = findGram(trigrams, gram);
+        if(grams[numgrams] < 0)
+        {
+            free(grams);
+            return 0;
+        }
+        numgrams++;
+    }
+    
+    /* Rarest first (a query only has a few trigrams) */
+    for(i = 1; i < numgrams; i++)
+    {
+        for(j = i; j > 0 && trigrams->df[grams[j]] < trigrams->df[grams[j - 1]]; j--)
+        {
+            tmp = grams[j];
+            grams[j] = grams[j - 1];
+            grams[j - 1] = tmp;
+        }
+    }
+    
+    if(readGramList(trigrams, grams[0], files) == 0)
+    {
+        free(grams);
+        return -1;
+    }
+    count = trigrams->df[grams[0]];
+    
+    for(i = 1; i < numgrams && count > 0; i++)
+    {
+        if(grams[i] == grams[i - 1])
+        {
+            continue;
+        }
+        
+        list = (int*) malloc(sizeof(int) * (trigrams->df[grams[i]] + 1));
+        if(list == NULL || readGramList(trigrams, grams[i], list) == 0)
+        {
+            free(list);
+            free(grams);
+            return -1;
+        }
+        
+        /* Keep the candidates that are in this list too */
+        n = 0;
+        k = 0;
+        
+        for(j = 0; j < count; j++)
+        {
+            while(k < trigrams->df[grams[i]] && list[k] < files[j])
+            {
+                k++;
+            }
+            
+            if(k < trigrams->df[grams[i]] && list[k] == files[j])
+            {
+                files[n] = files[j];
+                n++;
+            }
+        }
+        
+        count = n;
+        free(list);
+    }
+    
+    free(grams);
+    
+    return count;
+}
+
+/* countSubstring
+ *
+ * Counts how many times a string occurs in a file, ignoring case.
+ * This is how candidates are verified.
+ *
+ * @param   filename        file to read
+ * @param   str             string to count
+ *
+ * @return  success         number of occurrences
+ * @return  failure         -1
+ */
+
+int countSubstring(char *filename, char *str)
+{
+    FILE *file;
+    char *needle, *window;
+    int c, len, count, i, n, filled;
+    
+    len = strlen(str);
+    if(len == 0)
+    {
+        return 0;
+    }
+    
+    file = fopen(filename, "rb");
+    if(file == NULL)
+    {
+        return -1;
+    }
+    
+    needle = (char*) malloc(len);
+    window = (char*) malloc(len);
+    if(needle == NULL || window == NULL)
+    {
+        fprintf(stderr, "Error: Could not allocate space for substring.\n");
+        free(needle);
+        free(window);
+        fclose(file);
+        return -1;
+    }
+    
+    for(i = 0; i < len; i++)
+    {
+        needle[i] = (char) tolower((unsigned char) str[i]);
+    }
+    
+    /* Slide a window of len bytes over the file, window[n % len] is the newest */
+    count = 0;
+    filled = 0;
+    
+    for(n = 0; (c = getc(file)) != EOF; n++)
+    {
+        window[n % len] = (char) tolower(c);
+        if(filled < len)
+        {
+            filled++;
+        }
+        
+        if(filled == len && window[n % len] == needle[len - 1])
+        {
+            for(i = 0; i < len; i++)
+            {
+                if(window[(n + 1 + i) % len] != needle[i])
+                {
+                    break;
+                }
+            }
+            
+            if(i == len)
+            {
+                count++;
+            }
+        }
+    }
+    
+    free(needle);
+    free(window);
+    fclose(file);
+    
+    return count;
+}
@@ -0,0 +1,199 @@
+/*
+ * File: trigram.h
+ *
+ * Author: Mike Swift
+ * Email: theycallmeswift@gmail.com
+ * Date Created: May 13th, 2011
+ * Date Modified: May 13th, 2011
+ */
+
+#ifndef SWIFT_TRIGRAM_H_
+#define SWIFT_TRIGRAM_H_
+
+/********************************
+ *          1. Includes         *
+ ********************************/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "postings.h"
+
+/********************************
+ *          2. Constants        *
+ ********************************/
+
+/* Binary stream of trigram postings next to an inverted index */
+#define TRIGRAM_SUFFIX ".tri"
+
+/* Number of distinct trigrams (three bytes each) */
+#define TRIGRAM_SPACE (1 << 24)
+
+/* Initial number of (trigram, file) pairs a builder has room for */
+#define TRIGRAM_PAIRS 65536
+
+/********************************
+ *      3. Structs & Typedefs   *
+ ********************************/
+
+struct Trigrams_;
+typedef struct Trigrams_* Trigrams;
+
+struct TrigramIndex_;
+typedef struct TrigramIndex_* TrigramIndex;
+
+/********************************
+ *      4. Builder Functions    *
+ ********************************/
+
+/* createTrigrams
+ *
+ * Creates an empty trigram index builder. Every file added records
+ * each distinct (lowercased) three byte sequence it holds once.
+ *
+ * @return  success         new Trigrams
+ * @return  failure         NULL
+ */
+
+Trigrams createTrigrams(void);
+
+/* destroyTrigrams
+ *
+ * Frees a builder. NULL is ignored.
+ *
+ * @param   trigrams        builder to destroy
+ *
+ * @return  void
+ */
+
+void destroyTrigrams(Trigrams trigrams);
+
+/* addFileTrigrams
+ *
+ * Reads a file and records its trigrams. Files must be added in
+ * file number order.
+ *
+ * @param   trigrams        builder
+ * @param   filename        file to read
+ * @param   filenum         number of the file
+ *
+ * @return  success         1
+ * @return  failure         0
+ */
+
+int addFileTrigrams(Trigrams trigrams, char *filename, int filenum);
+
+/* loadTrigrams
+ *
+ * Adds every posting of an existing trigram index to a builder,
+ * shifting its file numbers, so several indexes can be merged.
+ * Indexes must be added in file number order.
+ *
+ * @param   trigrams        builder
+ * @param   index           name of the inverted index
+ * @param   offset          added to every file number
+ *
+ * @return  success         1
+ * @return  failure         0
+ */
+
+int loadTrigrams(Trigrams trigrams, char *index, int offset);
+
+/* writeTrigrams
+ *
+ * Writes the trigram stream of an inverted index:
+ *
+ *      #trigrams
+ *      per trigram: gap to the last trigram, #files, #bytes,
+ *                   then the gaps between its file numbers
+ *
+ * Every number is written with writeVByte, so a posting usually
+ * takes one byte. #bytes lets a reader skip a list unread.
+ *
+ * @param   trigrams        builder
+ * @param   index           name of the inverted index
+ *
+ * @return  success         1
+ * @return  failure         0
+ */
+
+int writeTrigrams(Trigrams trigrams, char *index);
+
+/********************************
+ *      5. Search Functions     *
+ ********************************/
+
+/* openTrigramIndex
+ *
+ * Opens the trigram stream of an inverted index and reads its
+ * directory (every trigram, its #files and where its list starts).
+ * The lists themselves are read on demand.
+ *
+ * @param   index           name of the inverted index
+ *
+ * @return  success         new TrigramIndex
+ * @return  no trigrams     NULL
+ */
+
+TrigramIndex openTrigramIndex(char *index);
+
+/* shareTrigramIndex
+ *
+ * Opens the trigram stream of an inverted index again, reusing the
+ * directory an open trigram index already read. Each copy reads
+ * its lists through its own stream, so copies can be used from
+ * different threads at once. The copy has to be closed before the
+ * trigram index it was shared from.
+ *
+ * @param   trigrams        open trigram index (NULL gives NULL)
+ * @param   index           name of the inverted index
+ *
+ * @return  success         new TrigramIndex
+ * @return  failure         NULL
+ */
+
+TrigramIndex shareTrigramIndex(TrigramIndex trigrams, char *index);
+
+/* closeTrigramIndex
+ *
+ * Closes a trigram index. NULL is ignored.
+ *
+ * @param   trigrams        trigram index to close
+ *
+ * @return  void
+ */
+
+void closeTrigramIndex(TrigramIndex trigrams);
+
+/* findCandidates
+ *
+ * Intersects the lists of every trigram of a (lowercased) string,
+ * rarest first, giving the files that may hold it. Strings shorter
+ * than three bytes have no trigrams and cannot be looked up.
+ *
+ * @param   trigrams        trigram index
+ * @param   str             string to look for
+ * @param   files           where to store the file numbers, room
+ *                          for every file is needed
+ *
+ * @return  success         number of candidates
+ * @return  failure         -1
+ */
+
+int findCandidates(TrigramIndex trigrams, char *str, int *files);
+
+/* countSubstring
+ *
+ * Counts how many times a string occurs in a file, ignoring case.
+ * This is how candidates are verified.
+ *
+ * @param   filename        file to read
+ * @param   str             string to count
+ *
+ * @return  success         number of occurrences
+ * @return  failure         -1
+ */
+
+int countSubstring(char *filename, char *str);
+
+#endif /* SWIFT_TRIGRAM_H_ */
@@ -15,9 +15,44 @@
 #include <stdlib.h>
 #include <string.h>
 #include "words.h"
+#include "pool.h"
 
 /********************************
- *      2. Word Functions       *
+ *      2. Globals              *
+ ********************************/
+
+/* Pools the Word, Entry and PosBlock nodes are carved out of (created on first use) */
+static Pool wordPool = NULL;
+static Pool entryPool = NULL;
+static Pool positionPool = NULL;
+
+/********************************
+ *      3. Helper Functions     *
+ ********************************/
+
+/* getPool
+ *
+ * Returns a node pool, creating it the first time it is needed.
+ *
+ * @param   pool        address of the pool
+ * @param   size        size of the nodes it holds
+ *
+ * @return  success     Pool
+ * @return  failure     NULL
+ */
+
+Pool getPool(Pool *pool, size_t size)
+{
+    if(*pool == NULL)
+    {
+        *pool = createPool(size, POOL_SLAB_ITEMS);
+    }
+    
+    return *pool;
+}
+
+/********************************
+ *      4. Word Functions       *
  ********************************/
 
 
@@ -35,7 +70,7 @@
 Word createWord(char *word)
 {
     Word newWord;
-    newWord = (Word) malloc( sizeof( struct Word_ ) );
+    newWord = (Word) poolAlloc( getPool(&wordPool, sizeof( struct Word_ )) );
      
     if( newWord == NULL )
     {
@@ -46,7 +81,7 @@ Word createWord(char *word)
     newWord->word = (char *) malloc( sizeof( char ) * ( strlen(word) + 1 ) );
     if( newWord->word == NULL )
     {
-        free(newWord);
+        poolFree(wordPool, newWord);
         fprintf(stderr, "Error: Could not allocate memory for Word.\n");
         return NULL;
     }
@@ -57,11 +92,44 @@ Word createWord(char *word)
     newWord->totalAppearances = 0;
     
     newWord->head = NULL;
+    newWord->positions = -1;
 
     return newWord;
 }
 
 
+/* createInternedWord
+ *
+ * Same as createWord, but the Word points at a string that is
+ * owned elsewhere (e.g. an interned term) instead of copying it.
+ * Release such words with releaseWords, never with destroyWord.
+ *
+ * @param   word        interned string
+ *
+ * @return  success     new Word
+ * @return  failure     NULL
+ */
+
+Word createInternedWord(char *word)
+{
+    Word newWord;
+    newWord = (Word) poolAlloc( getPool(&wordPool, sizeof( struct Word_ )) );
+     
+    if( newWord == NULL )
+    {
+        fprintf(stderr, "Error: Could not allocate memory for Word.\n");
+        return NULL;
+    }
+    
+    newWord->word = word;
+    newWord->numFiles = 0;
+    newWord->totalAppearances = 0;
+    newWord->head = NULL;
+    newWord->positions = -1;
+    
+    return newWord;
+}
+
 /* destroyWord
  *
  * Destroys a word object and the list of file Entries. 
@@ -88,15 +156,11 @@ void destroyWord(void *wordptr)
         while(curr != NULL)
         {
             next = curr->next;
-            if(curr->filename != NULL)
-            {
-                free(curr->filename);
-            }
-            free(curr);
+            destroyEntry(curr);
             curr = next;
         }
         
-        free(word);
+        poolFree(wordPool, word);
     }
 }
 
@@ -116,7 +180,7 @@ Entry createEntry(char *filename, int filenum, int frequency)
 {
     Entry ent;
     
-    ent = (Entry) malloc( sizeof(struct Entry_) );
+    ent = (Entry) poolAlloc( getPool(&entryPool, sizeof(struct Entry_)) );
     if(ent == NULL)
     {
         fprintf(stderr, "Error: Could not allocate memory for Entry.\n");
@@ -128,7 +192,7 @@ Entry createEntry(char *filename, int filenum, int frequency)
         ent->filename = (char*) malloc( sizeof(char) * (strlen(filename) + 1));
         if(ent->filename == NULL)
         {
-            free(ent);
+            poolFree(entryPool, ent);
             fprintf(stderr, "Error: Could not allocate memory for Entry.\n");
             return NULL;
         }
@@ -142,30 +206,120 @@ Entry createEntry(char *filename, int filenum, int frequency)
     ent->frequency = frequency;
     ent->filenumber = filenum;
     
+    ent->positions = NULL;
+    ent->lastPositions = NULL;
+    ent->numPositions = 0;
+    
     ent->next = NULL;
     
     return ent;
 }
 
 
+/* destroyEntry
+ *
+ * Destroys a single entry, its filename and its positions.
+ * When NULL is passed to the function, no action will be taken.
+ *
+ * @param   ent             entry to destroy
+ *
+ * @return  void
+ */
+
+void destroyEntry(Entry ent)
+{
+    PosBlock block, next;
+    
+    if(ent != NULL)
+    {
+        if(ent->filename != NULL)
+        {
+            free(ent->filename);
+        }
+        
+        block = ent->positions;
+        while(block != NULL)
+        {
+            next = block->next;
+            poolFree(positionPool, block);
+            block = next;
+        }
+        
+        poolFree(entryPool, ent);
+    }
+}
+
+/* addPosition
+ *
+ * Appends a token position to an entry. Positions are kept in
+ * small pooled blocks, so recording one never moves the others.
+ *
+ * @param   ent             entry
+ * @param   position        position of the word in the file
+ *
+ * @return  success         1
+ * @return  failure         0
+ */
+
+int addPosition(Entry ent, unsigned int position)
+{
+    PosBlock block;
+    
+    if(ent == NULL)
+    {
+        fprintf(stderr, "Error: Entry cannot be NULL.\n");
+        return 0;
+    }
+    
+    /* Start a new block when the last one is full */
+    if(ent->numPositions % POSITION_BLOCK == 0)
+    {
+        block = (PosBlock) poolAlloc( getPool(&positionPool, sizeof(struct PosBlock_)) );
+        if(block == NULL)
+        {
+            fprintf(stderr, "Error: Could not allocate memory for positions.\n");
+            return 0;
+        }
+        block->next = NULL;
+        
+        if(ent->lastPositions == NULL)
+        {
+            ent->positions = block;
+        }
+        else
+        {
+            ent->lastPositions->next = block;
+        }
+        ent->lastPositions = block;
+    }
+    
+    ent->lastPositions->pos[ent->numPositions % POSITION_BLOCK] = position;
+    ent->numPositions++;
+    
+    return 1;
+}
+
 /* insertEntry
  *
  * Inserts an entry into a word object. If the file is
  * already in the list, the frequency will be incremented
- * instead of creating a new node.
+ * instead of creating a new node. New files go at the head
+ * of the list, so while a file is being tokenized its entry
+ * is found on the first comparison.
  *
  * @param       word            word object
- * @param       filename        where the file was found
+ * @param       filenum         number of the file the word was found in
+ * @param       position        position of the word in the file, or
+ *                              -1 to not record one
  *
  * @return      new Filename    2
  * @return      increased freq  1
  * @return      failure         0
  */
 
-int insertEntry(Word word, char *filename)
+int insertEntry(Word word, int filenum, int position)
 {
     Entry ent;
-    int res;
     
     if(word == NULL)
     {
@@ -173,29 +327,31 @@ int insertEntry(Word word, char *filename)
         return 0;
     }
     
-    if(filename == NULL)
-    {
-        fprintf(stderr, "Error: Filename cannot be NULL.\n");
-        return 0;
-    }
-    
     ent = word->head;
     
-    /* Check if the filename is already in the list, if so increment and return */
+    /* Check if the file is already in the list, if so increment and return */
     while(ent != NULL)
     {
-        res = strcmp(filename, ent->filename);
-        if( res == 0 )
+        if(ent->filenumber == filenum)
         {
             ent->frequency++;
             word->totalAppearances++;
+            
+            if(position >= 0 && addPosition(ent, (unsigned int) position) == 0)
+            {
+                return 0;
+            }
             return 1;
         }
         ent = ent->next;
     }
     
-    /* Filename is not in the list, create a new entry and insert it at the head */
-    ent = createEntry(filename, -1, 1);
+    /* File is not in the list, create a new entry and insert it at the head */
+    ent = createEntry(NULL, filenum, 1);
+    if(ent == NULL)
+    {
+        return 0;
+    }
     
     ent->next = word->head;
     word->head = ent;
@@ -203,12 +359,115 @@ int insertEntry(Word word, char *filename)
     word->numFiles++;
     word->totalAppearances++;
     
+    if(position >= 0 && addPosition(ent, (unsigned int) position) == 0)
+    {
+        return 0;
+    }
+    
     return 2;
 }
 
+/* releaseWords
+ *
+ * Releases every Word, Entry and position block at once without walking
+ * any lists. Word strings and entry filenames are not freed, so
+ * the caller must be done with (or have freed) those already.
+ * Every Word and Entry is invalid afterwards.
+ *
+ * @return  void
+ */
+
+void releaseWords()
+{
+    destroyPool(wordPool);
+    wordPool = NULL;
+    
+    destroyPool(entryPool);
+    entryPool = NULL;
+    
+    destroyPool(positionPool);
+    positionPool = NULL;
+}
+
+/* mergeEntries
+ *
+ * Merges two lists of entries that are already sorted by
+ * frequency (desc) into a single sorted list. Entries from
+ * the first list win ties so the sort stays stable.
+ *
+ * @param   left        first sorted list
+ * @param   right       second sorted list
+ *
+ * @return  Entry       head of the merged list
+ */
+
+Entry mergeEntries(Entry left, Entry right)
+{
+    struct Entry_ head;
+    Entry tail;
+    
+    tail = &head;
+    
+    while(left != NULL && right != NULL)
+    {
+        if(left->frequency >= right->frequency)
+        {
+            tail->next = left;
+            left = left->next;
+        }
+        else
+        {
+            tail->next = right;
+            right = right->next;
+        }
+        tail = tail->next;
+    }
+    
+    tail->next = (left != NULL) ? left : right;
+    
+    return head.next;
+}
+
+/* sortEntryList
+ *
+ * Recursive merge sort over a list of entries. Splits the list
+ * in half with a slow/fast walk, sorts each half and merges them
+ * back together.
+ *
+ * @param   list        head of the list to sort
+ *
+ * @return  Entry       head of the sorted list
+ */
+
+Entry sortEntryList(Entry list)
+{
+    Entry slow, fast, right;
+    
+    if(list == NULL || list->next == NULL)
+    {
+        return list;
+    }
+    
+    slow = list;
+    fast = list->next;
+    
+    while(fast != NULL && fast->next != NULL)
+    {
+        slow = slow->next;
+        fast = fast->next->next;
+    }
+    
+    right = slow->next;
+    slow->next = NULL;
+    
+    return mergeEntries(sortEntryList(list), sortEntryList(right));
+}
+
 /* sortEntries
  *
- * Sorts the entries in a word by frequency (desc).
+ * Sorts the entries in a word by frequency (desc). Uses a merge
+ * sort so long posting lists (merged indexes, common words) sort
+ * in O(n log n).
  *
  * @param   word        the word whose entries should be sorted
  *
@@ -217,72 +476,13 @@ int insertEntry(Word word, char *filename)
  */
 int sortEntries(Word word)
 {
-    Entry curr, next, sorted, scurr, sprev;
-    int diff, inserted;
-    
     if(word == NULL)
     {
         fprintf(stderr, "Error: Cannot sort entries of NULL word.\n");
         return 0;
     }
     
-    curr = word->head;
-    sorted = NULL;
-    
-    while(curr != NULL)
-    {
-        next = curr->next;
-        
-        /* Set scurr to the front of the list, sprev to NULL, and inserted to 0 */
-        scurr = sorted;
-        sprev = NULL;
-        inserted = 0;
-        
-        while(scurr != NULL && inserted == 0)
-        {
-            diff = curr->frequency - scurr->frequency;
-            
-            if(diff >= 0)
-            {
-                /* The new one is bigger than the current node */
-                if(sprev == NULL)
-                {
-                    /* Insert it at the front of the list */
-                    curr->next = scurr;
-                    sorted = curr;
-                }
-                else
-                {
-                    sprev->next = curr;
-                    curr->next = scurr;
-                }
-                inserted = 1;
-            }
-            
-            sprev = scurr;
-            scurr = scurr->next;
-        }
-        
-        if(inserted == 0)
-        {
-            /* We reached the end of the list, put it there */
-            if(sprev == NULL)
-            {
-                /* Insert it at the front of the list */
-                curr->next = scurr;
-                sorted = curr;
-            }
-            else
-            {
-                sprev->next = curr;
-                curr->next = scurr;
-            }
-        }
-        
-        curr = next;
-    }
-    
-    word->head = sorted;
+    word->head = sortEntryList(word->head);
     
     return 1;
 }
@@ -349,6 +549,21 @@ int compWords(void* word1, void* word2)
     return strcmp(w1->word, w2->word);
 }
 
+/* compEntryFiles
+ *
+ * qsort comparator that orders Entry pointers by file number.
+ *
+ * @param   ptr1        first entry
+ * @param   ptr2        second entry
+ *
+ * @return  int         <0, 0 or >0
+ */
+
+int compEntryFiles(const void *ptr1, const void *ptr2)
+{
+    return (*(Entry*) ptr1)->filenumber - (*(Entry*) ptr2)->filenumber;
+}
+
 /* printWordHT
  *
  * Wrapper for printing words with the HT print function.
@@ -367,3 +582,126 @@ void printWordHT(void *key, void* val)
         printf("->");
     }
 }
+
+/* createArenaWord
+ *
+ * Same as createWord, but the Word and its string live in a
+ * query arena and go away when the arena is reset.
+ *
+ * @param   arena       query arena
+ * @param   str         the word's string
+ *
+ * @return  success     new Word
+ * @return  failure     NULL
+ */
+
+Word createArenaWord(Arena arena, char *str)
+{
+    Word word;
+    
+    word = (Word) arenaAlloc(arena, sizeof(struct Word_));
+    if(word == NULL)
+    {
+        return NULL;
+    }
+    
+    word->word = arenaString(arena, str);
+    if(word->word == NULL)
+    {
+        return NULL;
+    }
+    
+    word->head = NULL;
+    word->numFiles = 0;
+    word->totalAppearances = 0;
+    word->positions = -1;
+    
+    return word;
+}
+
+/* createArenaEntry
+ *
+ * Same as createEntry (without a filename), but the Entry lives
+ * in a query arena.
+ *
+ * @param   arena       query arena
+ * @param   filenum     file number
+ * @param   frequency   frequency of the word in the file
+ *
+ * @return  success     new Entry
+ * @return  failure     NULL
+ */
+
+Entry createArenaEntry(Arena arena, int filenum, int frequency)
+{
+    Entry ent;
+    
+    ent = (Entry) arenaAlloc(arena, sizeof(struct Entry_));
+    if(ent == NULL)
+    {
+        return NULL;
+    }
+    
+    ent->filename = NULL;
+    ent->filenumber = filenum;
+    ent->frequency = frequency;
+    
+    ent->positions = NULL;
+    ent->lastPositions = NULL;
+    ent->numPositions = 0;
+    
+    ent->next = NULL;
+    
+    return ent;
+}
+
+/* copyArenaWord
+ *
+ * Copies a word and its entries into a query arena, so a query
+ * works on its own copy of a word someone else may free (see
+ * searchCache).
+ *
+ * @param   arena       query arena
+ * @param   word        word to copy
+ *
+ * @return  success     new Word
+ * @return  failure     NULL
+ */
+
+Word copyArenaWord(Arena arena, Word word)
+{
+    Word copy;
+    Entry ent, tail;
+    
+    copy = createArenaWord(arena, word->word);
+    if(copy == NULL)
+    {
+        return NULL;
+    }
+    
+    copy->numFiles = word->numFiles;
+    copy->totalAppearances = word->totalAppearances;
+    copy->positions = word->positions;
+    
+    tail = NULL;
+    for(ent = word->head; ent != NULL; ent = ent->next)
+    {
+        if(tail == NULL)
+        {
+            copy->head = createArenaEntry(arena, ent->filenumber, ent->frequency);
+            tail = copy->head;
+        }
+        else
+        {
+            tail->next = createArenaEntry(arena, ent->filenumber, ent->frequency);
+            tail = tail->next;
+        }
+        
+        if(tail == NULL)
+        {
+            return NULL;
+        }
+    }
+    
+    return copy;
+}
@@ -10,21 +10,45 @@
 #ifndef SWIFT_WORDS_H_
 #define SWIFT_WORDS_H_
 
+#include "arena.h"
+
 /********************************
  *          1. Structs          *
  ********************************/
 
+/* Number of positions held by one PosBlock (fills 64 bytes) */
+#define POSITION_BLOCK 14
+
+/* PosBlock_
+ *
+ * @param   pos         token positions, in the order they were added
+ * @param   next        next block of positions
+ */
+
+struct PosBlock_ {
+    unsigned int pos[POSITION_BLOCK];
+    struct PosBlock_* next;
+};
+
+typedef struct PosBlock_* PosBlock;
+
 /* Entry_
  *
- * @param   filename    filename and path
- * @param   frequency   how often the word appears
- * @param   next        next entry in list
+ * @param   filename        filename and path
+ * @param   frequency       how often the word appears
+ * @param   positions       first block of token positions
+ * @param   lastPositions   block the next position goes into
+ * @param   numPositions    number of positions recorded
+ * @param   next            next entry in list
  */
 
 struct Entry_ {
     char *filename;
     int filenumber;
     int frequency;
+    PosBlock positions;
+    PosBlock lastPositions;
+    int numPositions;
     struct Entry_* next;
 };
 
@@ -36,6 +60,8 @@ typedef struct Entry_* Entry;
  * @param   head                pointer to head of entry list
  * @param   numFiles            The number of files the word appears in
  * @param   totalAppearances    The total number of appearances
+ * @param   positions           offset of the word's positions in the
+ *                              positions stream (-1 if unknown)
  */
 
 struct Word_ {
@@ -43,6 +69,7 @@ struct Word_ {
     Entry head;
     int numFiles;
     int totalAppearances;
+    long positions;
 };
 
 typedef struct Word_* Word;
@@ -64,6 +91,20 @@ typedef struct Word_* Word;
 
 Word createWord(char *word);
 
+/* createInternedWord
+ *
+ * Same as createWord, but the Word points at a string that is
+ * owned elsewhere (e.g. an interned term) instead of copying it.
+ * Release such words with releaseWords, never with destroyWord.
+ *
+ * @param   word        interned string
+ *
+ * @return  success     new Word
+ * @return  failure     NULL
+ */
+
+Word createInternedWord(char *word);
+
 /* destroyWord
  *
  * Destroys a word object and the list of file Entries. 
@@ -81,17 +122,21 @@ void destroyWord(void *wordptr);
  *
  * Inserts an entry into a word object. If the file is
  * already in the list, the frequency will be incremented
- * instead of creating a new node.
+ * instead of creating a new node. New files go at the head
+ * of the list, so while a file is being tokenized its entry
+ * is found on the first comparison.
  *
  * @param       word            word object
- * @param       filename        where the file was found
+ * @param       filenum         number of the file the word was found in
+ * @param       position        position of the word in the file, or
+ *                              -1 to not record one
  *
  * @return      new Filename    2
  * @return      increased freq  1
  * @return      failure         0
  */
 
-int insertEntry(Word word, char *filename);
+int insertEntry(Word word, int filenum, int position);
 
 /* createEntry
  *
@@ -107,6 +152,44 @@ int insertEntry(Word word, char *filename);
  */
 Entry createEntry(char *filename, int filenum, int frequency);
 
+/* destroyEntry
+ *
+ * Destroys a single entry, its filename and its positions.
+ * When NULL is passed to the function, no action will be taken.
+ *
+ * @param   ent             entry to destroy
+ *
+ * @return  void
+ */
+
+void destroyEntry(Entry ent);
+
+/* addPosition
+ *
+ * Appends a token position to an entry. Positions are kept in
+ * small pooled blocks, so recording one never moves the others.
+ *
+ * @param   ent             entry
+ * @param   position        position of the word in the file
+ *
+ * @return  success         1
+ * @return  failure         0
+ */
+
+int addPosition(Entry ent, unsigned int position);
+
+/* releaseWords
+ *
+ * Releases every Word, Entry and position block at once without walking
+ * any lists. Word strings and entry filenames are not freed, so
+ * the caller must be done with (or have freed) those already.
+ * Every Word and Entry is invalid afterwards.
+ *
+ * @return  void
+ */
+
+void releaseWords();
+
 /* sortEntries
  *
  * Sorts the entries in a word by frequency (desc).
@@ -143,6 +226,18 @@ void printWord(void* ptr);
  
 int compWords(void* word1, void* word2);
 
+/* compEntryFiles
+ *
+ * qsort comparator that orders Entry pointers by file number.
+ *
+ * @param   ptr1        first entry
+ * @param   ptr2        second entry
+ *
+ * @return  int         <0, 0 or >0
+ */
+
+int compEntryFiles(const void *ptr1, const void *ptr2);
+
 /* printWordHT
  *
  * Wrapper for printing words with the HT print function.
@@ -155,5 +250,49 @@ int compWords(void* word1, void* word2);
 
 void printWordHT(void *key, void* val);
 
+/* createArenaWord
+ *
+ * Same as createWord, but the Word and its string live in a
+ * query arena and go away when the arena is reset.
+ *
+ * @param   arena       query arena
+ * @param   str         the word's string
+ *
+ * @return  success     new Word
+ * @return  failure     NULL
+ */
+
+Word createArenaWord(Arena arena, char *str);
+
+/* createArenaEntry
+ *
+ * Same as createEntry (without a filename), but the Entry lives
+ * in a query arena.
+ *
+ * @param   arena       query arena
+ * @param   filenum     file number
+ * @param   frequency   frequency of the word in the file
+ *
+ * @return  success     new Entry
+ * @return  failure     NULL
+ */
+
+Entry createArenaEntry(Arena arena, int filenum, int frequency);
+
+/* copyArenaWord
+ *
+ * Copies a word and its entries into a query arena, so a query
+ * works on its own copy of a word someone else may free (see
+ * searchCache).
+ *
+ * @param   arena       query arena
+ * @param   word        word to copy
+ *
+ * @return  success     new Word
+ * @return  failure     NULL
+ */
+
+Word copyArenaWord(Arena arena, Word word);
+
 #endif
 /* SWIFT_WORDS_H_ */
@@ -0,0 +1,136 @@
+/* bench_codec.c
+ *
+ * This file times every block decoder the processor has on file
+ * number gaps like the ones in postings lists, and prints how many
+ * numbers each gets through a second and how small each codes them.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../src/codec.h"
+
+/* Numbers decoded per run, a whole number of blocks */
+#define NUM_BLOCKS 8192
+
+/* Each decoder runs for at least this long per case */
+#define MIN_SECONDS 0.5
+
+static const char *levelNames[] = {"Scalar", "SSE", "AVX2"};
+
+/* Helpers */
+
+/* Gaps of a list holding one file in every density, roughly geometric */
+void randomGaps(unsigned int *gaps, int n, int density)
+{
+    int i;
+    
+    for(i = 0; i < n; i++)
+    {
+        gaps[i] = 1 + (unsigned int) ((double) rand() / ((double) RAND_MAX + 1.0) * 2 * density);
+        
+        /* Now and then a long jump */
+        if(rand() % 64 == 0)
+        {
+            gaps[i] *= 50;
+        }
+    }
+}
+
+/* Decodes every block over and over, returns the millions of numbers it gets through a second */
+double timeDecoder(DecodeFunc decoder, const unsigned char *coded, unsigned int *out)
+{
+    const unsigned char *p;
+    clock_t start;
+    double seconds;
+    long runs;
+    int i;
+    
+    runs = 0;
+    start = clock();
+    
+    do
+    {
+        p = coded;
+        for(i = 0; i < NUM_BLOCKS; i++)
+        {
+            p += decoder(p, out + i * CODEC_BLOCK);
+        }
+        
+        runs++;
+        seconds = (double) (clock() - start) / CLOCKS_PER_SEC;
+    } while(seconds < MIN_SECONDS);
+    
+    return (double) runs * NUM_BLOCKS * CODEC_BLOCK / seconds / 1e6;
+}
+
+/* Benchmark */
+
+int main(int argc, char **argv)
+{
+    static const int densities[] = {2, 16, 128, 4096};
+    unsigned int *gaps, *out;
+    unsigned char *coded;
+    double speed, scalar;
+    long size;
+    int d, codec, level, i;
+    
+    srand(42);
+    
+    gaps = (unsigned int*) malloc(sizeof(unsigned int) * NUM_BLOCKS * CODEC_BLOCK);
+    out = (unsigned int*) malloc(sizeof(unsigned int) * NUM_BLOCKS * CODEC_BLOCK);
+    coded = (unsigned char*) malloc((size_t) NUM_BLOCKS * CODEC_BLOCK_BYTES + CODEC_BLOCK_BYTES);
+    if(gaps == NULL || out == NULL || coded == NULL)
+    {
+        fprintf(stderr, "Error: Could not allocate space for the blocks.\n");
+        return 1;
+    }
+    
+    printf("Processor supports %s, blocks of %d.\n\n", levelNames[simdLevel()], CODEC_BLOCK);
+    printf("%8s %12s %8s %10s %14s %9s\n", "gap", "codec", "kernel", "bits/int", "Mints/sec", "speedup");
+    
+    for(d = 0; d < (int) (sizeof(densities) / sizeof(densities[0])); d++)
+    {
+        randomGaps(gaps, NUM_BLOCKS * CODEC_BLOCK, densities[d]);
+        
+        for(codec = 0; codec < NUM_CODECS; codec++)
+        {
+            size = 0;
+            for(i = 0; i < NUM_BLOCKS; i++)
+            {
+                size += encodeBlock(codec, gaps + i * CODEC_BLOCK, coded + size);
+            }
+            memset(coded + size, 0, CODEC_BLOCK_BYTES);
+            
+            scalar = 0.0;
+            
+            for(level = SIMD_SCALAR; level <= simdLevel(); level++)
+            {
+                /* Codecs without a kernel for this level fall back to the one below */
+                if(level > SIMD_SCALAR && decodeKernel(codec, level) == decodeKernel(codec, level - 1))
+                {
+                    continue;
+                }
+                
+                memset(out, 0, sizeof(unsigned int) * NUM_BLOCKS * CODEC_BLOCK);
+                speed = timeDecoder(decodeKernel(codec, level), coded, out);
+                
+                if(level == SIMD_SCALAR)
+                {
+                    scalar = speed;
+                }
+                
+                printf("%8d %12s %8s %10.2f %14.1f %8.2fx%s\n", densities[d], codecName(codec), levelNames[level],
+                       8.0 * size / (NUM_BLOCKS * CODEC_BLOCK), speed, speed / scalar,
+                       (memcmp(gaps, out, sizeof(unsigned int) * NUM_BLOCKS * CODEC_BLOCK) == 0) ? "" : "  WRONG RESULT");
+            }
+        }
+    }
+    
+    free(gaps);
+    free(out);
+    free(coded);
+    
+    return 0;
+}
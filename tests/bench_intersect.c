@@ -0,0 +1,122 @@
+/* bench_intersect.c
+ *
+ * This file times every intersection kernel the processor has on
+ * pairs of postings lists with the length ratios queries run into,
+ * and prints how much faster each is than the scalar reference.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "../src/intersect.h"
+
+/* Documents in the made up collection */
+#define UNIVERSE 10000000
+
+/* Each kernel runs for at least this long per case */
+#define MIN_SECONDS 0.5
+
+static const char *levelNames[] = {"Scalar", "SSE", "AVX2"};
+
+struct Case_ {
+    int na, nb;
+};
+
+/* Helpers */
+
+/* Picks n different numbers below universe, ascending (Knuth's selection sampling) */
+void randomList(int *list, int n, int universe)
+{
+    int i, k;
+
+    k = 0;
+    for(i = 0; i < universe && k < n; i++)
+    {
+        if((double) rand() / ((double) RAND_MAX + 1.0) * (universe - i) < n - k)
+        {
+            list[k] = i;
+            k++;
+        }
+    }
+}
+
+/* Runs a kernel over and over, returns the millions of input numbers it gets through a second */
+double timeKernel(IntersectFunc kernel, const int *a, int na, const int *b, int nb, int *out, int *found)
+{
+    clock_t start;
+    double seconds;
+    long runs;
+
+    runs = 0;
+    start = clock();
+
+    do
+    {
+        *found = kernel(a, na, b, nb, out);
+        runs++;
+        seconds = (double) (clock() - start) / CLOCKS_PER_SEC;
+    } while(seconds < MIN_SECONDS);
+
+    return (double) runs * (na + nb) / seconds / 1e6;
+}
+
+/* Benchmark */
+
+int main(int argc, char **argv)
+{
+    static const struct Case_ cases[] = {
+        {1000000, 1000000},
+        {100000, 1000000},
+        {30000, 1000000},
+        {10000, 1000000},
+        {1000, 1000000},
+        {100, 1000000}
+    };
+    int *a, *b, *out;
+    double speed, scalar;
+    int c, level, found, expected;
+
+    srand(42);
+
+    a = (int*) malloc(sizeof(int) * 1000000);
+    b = (int*) malloc(sizeof(int) * 1000000);
+    out = (int*) malloc(sizeof(int) * (1000000 + INTERSECT_SLACK));
+    if(a == NULL || b == NULL || out == NULL)
+    {
+        fprintf(stderr, "Error: Could not allocate space for the lists.\n");
+        return 1;
+    }
+
+    printf("Processor supports %s, intersecting lists of %d documents.\n\n", levelNames[simdLevel()], UNIVERSE);
+    printf("%10s %10s %8s %14s %9s\n", "short", "long", "kernel", "Mints/sec", "speedup");
+
+    for(c = 0; c < (int) (sizeof(cases) / sizeof(cases[0])); c++)
+    {
+        randomList(a, cases[c].na, UNIVERSE);
+        randomList(b, cases[c].nb, UNIVERSE);
+
+        scalar = 0.0;
+        expected = -1;
+
+        for(level = SIMD_SCALAR; level <= simdLevel(); level++)
+        {
+            speed = timeKernel(intersectKernel(level), a, cases[c].na, b, cases[c].nb, out, &found);
+
+            if(level == SIMD_SCALAR)
+            {
+                scalar = speed;
+                expected = found;
+            }
+
+            printf("%10d %10d %8s %14.1f %8.2fx%s\n", cases[c].na, cases[c].nb, levelNames[level],
+                   speed, speed / scalar, (found == expected) ? "" : "  WRONG RESULT");
+        }
+    }
+
+    free(a);
+    free(b);
+    free(out);
+
+    return 0;
+}
@@ -0,0 +1,300 @@
+/* test_batch.c
+ *
+ * This file contains the tests for batches of queries: every query
+ * of a batch (see loadBatch) has to find the same files as it does
+ * asked on its own, the way the REPL asks it, with the index's
+ * lexicon and without it.
+ */
+
+/* mkdir and rmdir are POSIX, not ANSI */
+#define _XOPEN_SOURCE 600
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "testing.h"
+#include "../src/csearch.h"
+#include "../src/index.h"
+#include "../src/hashtable.h"
+
+#define TEST_DIR "test_batch_files"
+#define TEST_INDEX "test_batch.idx"
+#define TEST_FILES 300
+#define TEST_WORDS 60
+#define TEST_VOCABULARY 1500
+#define TEST_QUERIES 120
+#define TEST_CHAINED 8
+#define TEST_ANSWER 8192
+
+int tests_run, failures;
+
+/* Helpers */
+
+/* Files of words drawn from w0 ... w(TEST_VOCABULARY - 1) */
+int writeCorpus(void)
+{
+    FILE *file;
+    char name[256];
+    int i, j;
+    
+    if(mkdir(TEST_DIR, 0755) != 0)
+    {
+        return 0;
+    }
+    
+    for(i = 0; i < TEST_FILES; i++)
+    {
+        sprintf(name, "%s/file%d.txt", TEST_DIR, i);
+        file = fopen(name, "w");
+        if(file == NULL)
+        {
+            return 0;
+        }
+        
+        for(j = 0; j < TEST_WORDS; j++)
+        {
+            fprintf(file, "w%d ", rand() % TEST_VOCABULARY);
+        }
+        fclose(file);
+    }
+    
+    return 1;
+}
+
+void removeCorpus(void)
+{
+    static char *suffixes[] = {POSITIONS_SUFFIX, LEXICON_SUFFIX, BLOCKMAX_SUFFIX, IMPACT_SUFFIX,
+                               ROARING_SUFFIX, PACKED_SUFFIX, TRIGRAM_SUFFIX, BLOOM_SUFFIX, MPHF_SUFFIX};
+    char name[256];
+    int i;
+    
+    for(i = 0; i < TEST_FILES; i++)
+    {
+        sprintf(name, "%s/file%d.txt", TEST_DIR, i);
+        remove(name);
+    }
+    rmdir(TEST_DIR);
+    
+    for(i = 0; i < (int) (sizeof(suffixes) / sizeof(suffixes[0])); i++)
+    {
+        removeSidecar(TEST_INDEX, suffixes[i]);
+    }
+    remove(TEST_INDEX);
+}
+
+/* Builds the test index the way index does */
+int buildTestIndex(void)
+{
+    char *argv[3];
+    FILE *file;
+    
+    argv[0] = "index";
+    argv[1] = TEST_INDEX;
+    argv[2] = TEST_DIR;
+    
+    runindex(3, argv);
+    
+    file = fopen(TEST_INDEX, "r");
+    if(file == NULL)
+    {
+        return 0;
+    }
+    fclose(file);
+    
+    return 1;
+}
+
+/* Plain terms, terms the index lacks, NOT and a phrase, like a user would ask */
+void makeQueries(char **queries)
+{
+    int i, a, b;
+    
+    for(i = 0; i < TEST_QUERIES; i++)
+    {
+        a = rand() % TEST_VOCABULARY;
+        b = rand() % TEST_VOCABULARY;
+        
+        switch(i % 5)
+        {
+            case 0: sprintf(queries[i], "so w%d w%d\n", a, b); break;
+            case 1: sprintf(queries[i], "sa w%d w%d\n", a, b); break;
+            case 2: sprintf(queries[i], "so w%d AND NOT w%d\n", a, b); break;
+            case 3: sprintf(queries[i], "so w%d nothere%d\n", a, b); break;
+            default: sprintf(queries[i], "so \"w%d w%d\" w%d\n", a, b, b); break;
+        }
+    }
+}
+
+/* Queries of terms that all land in the last bucket of a new batch, chained */
+int makeChainedQueries(char **queries)
+{
+    HashTable table;
+    char terms[2 * TEST_CHAINED][16];
+    int i, found, buckets;
+    
+    table = createHT(hash, compStrings, NULL, NULL, NULL);
+    if(table == NULL)
+    {
+        return 0;
+    }
+    buckets = getNumBuckets(table);
+    destroyHT(table);
+    
+    found = 0;
+    for(i = 0; i < TEST_VOCABULARY && found < 2 * TEST_CHAINED; i++)
+    {
+        sprintf(terms[found], "w%d", i);
+        if(hash(terms[found]) % buckets == buckets - 1)
+        {
+            found++;
+        }
+    }
+    
+    if(found < 2 * TEST_CHAINED)
+    {
+        return 0;
+    }
+    
+    for(i = 0; i < TEST_CHAINED; i++)
+    {
+        sprintf(queries[i], "so %s %s\n", terms[2 * i], terms[2 * i + 1]);
+    }
+    
+    return 1;
+}
+
+/* Asks a query and writes down the files it found, in order */
+void recordAnswer(char *query, Filelist files, Cache cache, char *answer)
+{
+    Result result;
+    
+    answer[0] = '\0';
+    
+    search(query, files->tok, files, cache);
+    
+    for(result = files->results; result != NULL && strlen(answer) + 16 < TEST_ANSWER; result = result->next)
+    {
+        sprintf(answer + strlen(answer), "%d ", result->filenum);
+    }
+    
+    resetResults(files);
+}
+
+/* Every query of the batch has to find what it finds on its own */
+int sameAnswers(char **queries, int numqueries)
+{
+    TokenizerT tok;
+    Filelist files;
+    Cache cache;
+    char *asked, *batched;
+    int i, same;
+    
+    tok = TKCreate(FILE_CHARS, TEST_INDEX);
+    files = (tok != NULL) ? getFilelist(tok) : NULL;
+    TKDestroy(tok);
+    
+    asked = (char*) malloc(TEST_ANSWER * numqueries);
+    batched = (char*) malloc(TEST_ANSWER);
+    if(files == NULL || asked == NULL || batched == NULL)
+    {
+        destroyFilelist(files);
+        free(asked);
+        free(batched);
+        return 0;
+    }
+    
+    /* A cache of its own for each, so neither answers from the other's words */
+    cache = createCache("1MB");
+    for(i = 0; i < numqueries; i++)
+    {
+        recordAnswer(queries[i], files, cache, asked + i * TEST_ANSWER);
+    }
+    destroyCache(cache);
+    
+    cache = createCache("1MB");
+    same = (loadBatch(files, queries, numqueries) > 0);
+    
+    for(i = 0; i < numqueries && same; i++)
+    {
+        recordAnswer(queries[i], files, cache, batched);
+        same = (strcmp(asked + i * TEST_ANSWER, batched) == 0);
+        
+        if(!same)
+        {
+            fprintf(stderr, "%s  asked:   %s\n  batched: %s\n", queries[i], asked + i * TEST_ANSWER, batched);
+        }
+    }
+    
+    clearBatch(files);
+    destroyCache(cache);
+    destroyFilelist(files);
+    free(asked);
+    free(batched);
+    
+    return same;
+}
+
+/* Tests */
+
+void run_tests()
+{
+    char *queries[TEST_QUERIES], lines[TEST_QUERIES][64];
+    char *chained[TEST_CHAINED], chainedLines[TEST_CHAINED][64];
+    int i, ok, chainedOk;
+    
+    srand(42);
+    
+    for(i = 0; i < TEST_QUERIES; i++)
+    {
+        queries[i] = lines[i];
+    }
+    makeQueries(queries);
+    
+    for(i = 0; i < TEST_CHAINED; i++)
+    {
+        chained[i] = chainedLines[i];
+    }
+    chainedOk = makeChainedQueries(chained);
+    
+    removeCorpus();
+    ok = writeCorpus() && buildTestIndex();
+    SW_ASSERT(ok == 1, "Index of the test files built", tests_run, failures);
+    
+    ok = ok && sameAnswers(queries, TEST_QUERIES);
+    SW_ASSERT(ok == 1, "A batch finds what each query finds on its own, with a lexicon", tests_run, failures);
+    
+    chainedOk = ok && chainedOk && sameAnswers(chained, TEST_CHAINED);
+    SW_ASSERT(chainedOk == 1, "A batch finds the terms chained in the last bucket, with a lexicon", tests_run, failures);
+    
+    /* Without the lexicon (and what only works with it) the batch is one pass over the index */
+    removeSidecar(TEST_INDEX, LEXICON_SUFFIX);
+    removeSidecar(TEST_INDEX, MPHF_SUFFIX);
+    
+    ok = ok && sameAnswers(queries, TEST_QUERIES);
+    SW_ASSERT(ok == 1, "A batch finds what each query finds on its own, without a lexicon", tests_run, failures);
+    
+    chainedOk = ok && makeChainedQueries(chained) && sameAnswers(chained, TEST_CHAINED);
+    SW_ASSERT(chainedOk == 1, "A batch finds the terms chained in the last bucket, without a lexicon", tests_run, failures);
+    
+    removeCorpus();
+}
+
+
+int main(int argc, char **argv) {
+    
+    tests_run = 0;
+    failures = 0;
+    
+    printf("Starting tests for Batch...\n");
+    
+    run_tests();
+    
+    printf("Ran %d tests, with %d failures.\n", tests_run, failures);
+    if(failures == 0)
+    {
+        printf("ALL TESTS PASSED.\n");
+    }
+    return 0;
+}
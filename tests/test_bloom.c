@@ -0,0 +1,319 @@
+/* test_bloom.c
+ *
+ * This file contains the tests for the Bloom filter of the terms of
+ * an index: a filter written next to an index has to read back
+ * passing every term that went in, however many that was, and
+ * turning away all but a few of the terms that did not. An index
+ * without a filter has none to load. A query has to find the same
+ * files whether the filter turns its terms away or the index does.
+ */
+
+/* mkdir and rmdir are POSIX, not ANSI */
+#define _XOPEN_SOURCE 600
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "testing.h"
+#include "../src/csearch.h"
+#include "../src/bloom.h"
+#include "../src/index.h"
+
+#define TEST_DIR "test_bloom_files"
+#define TEST_INDEX "test_bloom.idx"
+#define TEST_ANSWER 256
+#define TEST_FILTER "test_bloom_filter.idx"
+#define TEST_TERMS 5000
+#define TEST_ABSENT 20000
+
+int tests_run, failures;
+
+char *texts[] = {"the quick brown fox jumps over the lazy dog",
+                 "the lazy brown dog sleeps",
+                 "quick quick fox",
+                 "brown fox quick",
+                 "a fox that is quick and brown",
+                 "jumping jumper jumps"};
+
+#define TEST_FILES ((int) (sizeof(texts) / sizeof(texts[0])))
+
+/* Helpers */
+
+int writeCorpus(void)
+{
+    FILE *file;
+    char name[256];
+    int i;
+    
+    if(mkdir(TEST_DIR, 0755) != 0)
+    {
+        return 0;
+    }
+    
+    for(i = 0; i < TEST_FILES; i++)
+    {
+        sprintf(name, "%s/f%d.txt", TEST_DIR, i);
+        file = fopen(name, "w");
+        if(file == NULL)
+        {
+            return 0;
+        }
+        fprintf(file, "%s\n", texts[i]);
+        fclose(file);
+    }
+    
+    return 1;
+}
+
+void removeCorpus(void)
+{
+    static char *suffixes[] = {POSITIONS_SUFFIX, LEXICON_SUFFIX, BLOCKMAX_SUFFIX, IMPACT_SUFFIX, ROARING_SUFFIX,
+                               PACKED_SUFFIX, TRIGRAM_SUFFIX, BLOOM_SUFFIX, MPHF_SUFFIX, STATS_SUFFIX};
+    char name[256];
+    int i;
+    
+    for(i = 0; i < TEST_FILES; i++)
+    {
+        sprintf(name, "%s/f%d.txt", TEST_DIR, i);
+        remove(name);
+    }
+    rmdir(TEST_DIR);
+    
+    for(i = 0; i < (int) (sizeof(suffixes) / sizeof(suffixes[0])); i++)
+    {
+        removeSidecar(TEST_INDEX, suffixes[i]);
+    }
+    remove(TEST_INDEX);
+    removeSidecar(TEST_FILTER, BLOOM_SUFFIX);
+}
+
+Filelist openIndex(void)
+{
+    TokenizerT tok;
+    Filelist files;
+    
+    tok = TKCreate(FILE_CHARS, TEST_INDEX);
+    files = (tok != NULL) ? getFilelist(tok) : NULL;
+    TKDestroy(tok);
+    
+    return files;
+}
+
+/* Number of the file a name was written to: f3.txt is 3 */
+int fileNumber(Filelist files, int filenum)
+{
+    char name[256], *base;
+    
+    if(getFilename(files, filenum, name, sizeof(name)) == NULL)
+    {
+        return -1;
+    }
+    
+    base = strrchr(name, '/');
+    return atoi((base != NULL) ? base + 2 : name + 1);
+}
+
+/* The files a query finds as "f0 f3 ", in file order */
+int findFiles(char *query, char *answer)
+{
+    Filelist files;
+    Cache cache;
+    Result result;
+    int found[TEST_FILES], i, num;
+    
+    answer[0] = '\0';
+    
+    files = openIndex();
+    cache = createCache("1MB");
+    if(files == NULL || cache == NULL)
+    {
+        destroyCache(cache);
+        destroyFilelist(files);
+        return 0;
+    }
+    
+    for(i = 0; i < TEST_FILES; i++)
+    {
+        found[i] = 0;
+    }
+    
+    search(query, files->tok, files, cache);
+    
+    for(result = files->results; result != NULL; result = result->next)
+    {
+        num = fileNumber(files, result->filenum);
+        if(num >= 0 && num < TEST_FILES)
+        {
+            found[num] = 1;
+        }
+    }
+    
+    for(i = 0; i < TEST_FILES; i++)
+    {
+        if(found[i])
+        {
+            sprintf(answer + strlen(answer), "f%d ", i);
+        }
+    }
+    
+    resetResults(files);
+    destroyFilelist(files);
+    destroyCache(cache);
+    
+    return 1;
+}
+
+/* A query has to find exactly the files expected */
+int finds(char *query, char *expected)
+{
+    char answer[TEST_ANSWER];
+    
+    if(findFiles(query, answer) == 0)
+    {
+        return 0;
+    }
+    
+    if(strcmp(answer, expected) != 0)
+    {
+        fprintf(stderr, "%s  expected \"%s\", found \"%s\"\n", query, expected, answer);
+        return 0;
+    }
+    
+    return 1;
+}
+
+/* Writes a filter of numterms terms next to TEST_FILTER and loads it back */
+Bloom writeFilter(int numterms)
+{
+    Bloom bloom;
+    char term[32];
+    int i, ok;
+    
+    bloom = createBloom();
+    ok = (bloom != NULL);
+    
+    for(i = 0; i < numterms && ok; i++)
+    {
+        sprintf(term, "term%d", i);
+        ok = addBloom(bloom, term);
+    }
+    
+    ok = ok && writeBloom(bloom, TEST_FILTER);
+    destroyBloom(bloom);
+    
+    return ok ? loadBloom(TEST_FILTER) : NULL;
+}
+
+/* Every term that went in has to pass */
+int passesAll(Bloom bloom, int numterms)
+{
+    char term[32];
+    int i;
+    
+    for(i = 0; i < numterms; i++)
+    {
+        sprintf(term, "term%d", i);
+        if(!bloomContains(bloom, term))
+        {
+            return 0;
+        }
+    }
+    
+    return 1;
+}
+
+/* Number of terms that never went in the filter lets through */
+int falsePositives(Bloom bloom)
+{
+    char term[32];
+    int i, passed;
+    
+    passed = 0;
+    for(i = 0; i < TEST_ABSENT; i++)
+    {
+        sprintf(term, "absent%d", i);
+        passed += bloomContains(bloom, term);
+    }
+    
+    return passed;
+}
+
+/* Tests */
+
+void run_tests()
+{
+    char *queries[] = {"so fox\n", "so zebra\n", "so zebra dog\n", "sa zebra dog\n", "so NOT zebra\n"};
+    char *expected[] = {"f0 f2 f3 f4 ", "", "f0 f1 ", "", "f0 f1 f2 f3 f4 f5 "};
+    Bloom bloom;
+    int i, ok;
+    
+    removeCorpus();
+    
+    /* Test a filter reads back passing every term that went in, and few others */
+    
+    bloom = writeFilter(TEST_TERMS);
+    SW_ASSERT(bloom != NULL, "A filter of many more terms than it started with written and read back",
+              tests_run, failures);
+    SW_ASSERT(bloom != NULL && passesAll(bloom, TEST_TERMS) == 1, "Every term that went in passes",
+              tests_run, failures);
+    SW_ASSERT(bloom != NULL && falsePositives(bloom) < TEST_ABSENT / 50, "All but a few terms that did not are turned away",
+              tests_run, failures);
+    destroyBloom(bloom);
+    
+    bloom = writeFilter(1);
+    SW_ASSERT(bloom != NULL && passesAll(bloom, 1) == 1 && falsePositives(bloom) < TEST_ABSENT / 10,
+              "A filter of one term is still of use", tests_run, failures);
+    destroyBloom(bloom);
+    
+    bloom = writeFilter(0);
+    SW_ASSERT(bloom != NULL && falsePositives(bloom) == 0, "A filter of no terms turns every term away",
+              tests_run, failures);
+    destroyBloom(bloom);
+    
+    removeSidecar(TEST_FILTER, BLOOM_SUFFIX);
+    SW_ASSERT(loadBloom(TEST_FILTER) == NULL, "An index without a filter has none to load", tests_run, failures);
+    
+    /* Test queries find the same files with the filter as without */
+    
+    ok = writeCorpus() && buildIndex(TEST_INDEX, TEST_DIR, DEFAULT_CODEC, 0, 0);
+    SW_ASSERT(ok == 1, "Index of the test files built", tests_run, failures);
+    
+    bloom = loadBloom(TEST_INDEX);
+    SW_ASSERT(bloom != NULL && bloomContains(bloom, "fox") && bloomContains(bloom, "jumping"),
+              "The filter of an index passes its terms", tests_run, failures);
+    destroyBloom(bloom);
+    
+    for(i = 0; i < 5; i++)
+    {
+        SW_ASSERT(finds(queries[i], expected[i]) == 1, "A query finds its files with the filter", tests_run, failures);
+    }
+    
+    removeSidecar(TEST_INDEX, BLOOM_SUFFIX);
+    
+    for(i = 0; i < 5; i++)
+    {
+        SW_ASSERT(finds(queries[i], expected[i]) == 1, "A query finds the same files without it", tests_run, failures);
+    }
+    
+    removeCorpus();
+}
+
+
+int main(int argc, char **argv) {
+    
+    tests_run = 0;
+    failures = 0;
+    
+    printf("Starting tests for Bloom...\n");
+    
+    run_tests();
+    
+    printf("Ran %d tests, with %d failures.\n", tests_run, failures);
+    if(failures == 0)
+    {
+        printf("ALL TESTS PASSED.\n");
+    }
+    return 0;
+}
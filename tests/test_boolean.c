@@ -0,0 +1,414 @@
+/* test_boolean.c
+ *
+ * This file contains the tests for boolean queries: a plan of
+ * postings iterators (see advancePlan) has to walk exactly the
+ * files its AND, OR and NOT nodes match, in file order, skipping
+ * to any file asked for, before and after it is optimized and its
+ * ANDs intersected. A query has to be parsed into the plan its
+ * operators and parentheses say, AND before OR, NOT NOT undone,
+ * and a stray operator or parenthesis has to be dropped.
+ */
+
+/* mkdir and rmdir are POSIX, not ANSI */
+#define _XOPEN_SOURCE 600
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "testing.h"
+#include "../src/csearch.h"
+#include "../src/index.h"
+#include "../src/plan.h"
+
+#define TEST_DIR "test_boolean_files"
+#define TEST_INDEX "test_boolean.idx"
+#define TEST_ANSWER 256
+#define TEST_PLAN_FILES 40
+
+int tests_run, failures;
+
+char *texts[] = {"the quick brown fox jumps over the lazy dog",
+                 "the lazy brown dog sleeps",
+                 "quick quick fox",
+                 "brown fox quick",
+                 "a fox that is quick and brown",
+                 "jumping jumper jumps"};
+
+#define TEST_FILES ((int) (sizeof(texts) / sizeof(texts[0])))
+
+/* Helpers */
+
+int writeCorpus(void)
+{
+    FILE *file;
+    char name[256];
+    int i;
+    
+    if(mkdir(TEST_DIR, 0755) != 0)
+    {
+        return 0;
+    }
+    
+    for(i = 0; i < TEST_FILES; i++)
+    {
+        sprintf(name, "%s/f%d.txt", TEST_DIR, i);
+        file = fopen(name, "w");
+        if(file == NULL)
+        {
+            return 0;
+        }
+        fprintf(file, "%s\n", texts[i]);
+        fclose(file);
+    }
+    
+    return 1;
+}
+
+void removeCorpus(void)
+{
+    static char *suffixes[] = {POSITIONS_SUFFIX, LEXICON_SUFFIX, BLOCKMAX_SUFFIX, IMPACT_SUFFIX, ROARING_SUFFIX,
+                               PACKED_SUFFIX, TRIGRAM_SUFFIX, BLOOM_SUFFIX, MPHF_SUFFIX, STATS_SUFFIX};
+    char name[256];
+    int i;
+    
+    for(i = 0; i < TEST_FILES; i++)
+    {
+        sprintf(name, "%s/f%d.txt", TEST_DIR, i);
+        remove(name);
+    }
+    rmdir(TEST_DIR);
+    
+    for(i = 0; i < (int) (sizeof(suffixes) / sizeof(suffixes[0])); i++)
+    {
+        removeSidecar(TEST_INDEX, suffixes[i]);
+    }
+    remove(TEST_INDEX);
+}
+
+Filelist openIndex(void)
+{
+    TokenizerT tok;
+    Filelist files;
+    
+    tok = TKCreate(FILE_CHARS, TEST_INDEX);
+    files = (tok != NULL) ? getFilelist(tok) : NULL;
+    TKDestroy(tok);
+    
+    return files;
+}
+
+/* Number of the file a name was written to: f3.txt is 3 */
+int fileNumber(Filelist files, int filenum)
+{
+    char name[256], *base;
+    
+    if(getFilename(files, filenum, name, sizeof(name)) == NULL)
+    {
+        return -1;
+    }
+    
+    base = strrchr(name, '/');
+    return atoi((base != NULL) ? base + 2 : name + 1);
+}
+
+/* The files a query finds as "f0 f3 ", in file order */
+int findFiles(char *query, char *answer)
+{
+    Filelist files;
+    Cache cache;
+    Result result;
+    int found[TEST_FILES], i, num;
+    
+    answer[0] = '\0';
+    
+    files = openIndex();
+    cache = createCache("1MB");
+    if(files == NULL || cache == NULL)
+    {
+        destroyCache(cache);
+        destroyFilelist(files);
+        return 0;
+    }
+    
+    for(i = 0; i < TEST_FILES; i++)
+    {
+        found[i] = 0;
+    }
+    
+    search(query, files->tok, files, cache);
+    
+    for(result = files->results; result != NULL; result = result->next)
+    {
+        num = fileNumber(files, result->filenum);
+        if(num >= 0 && num < TEST_FILES)
+        {
+            found[num] = 1;
+        }
+    }
+    
+    for(i = 0; i < TEST_FILES; i++)
+    {
+        if(found[i])
+        {
+            sprintf(answer + strlen(answer), "f%d ", i);
+        }
+    }
+    
+    resetResults(files);
+    destroyFilelist(files);
+    destroyCache(cache);
+    
+    return 1;
+}
+
+/* A query has to find exactly the files expected */
+int finds(char *query, char *expected)
+{
+    char answer[TEST_ANSWER];
+    
+    if(findFiles(query, answer) == 0)
+    {
+        return 0;
+    }
+    
+    if(strcmp(answer, expected) != 0)
+    {
+        fprintf(stderr, "%s  expected \"%s\", found \"%s\"\n", query, expected, answer);
+        return 0;
+    }
+    
+    return 1;
+}
+
+/* A leaf holding every file number from 0 that is a multiple of step, or just the files listed when step is 0 */
+PlanNode createLeaf(Arena arena, int leaf, int step, int *list, int count)
+{
+    Word word;
+    PlanNode node;
+    int i;
+    
+    word = createWord("term");
+    if(word == NULL)
+    {
+        return NULL;
+    }
+    
+    for(i = 0; step > 0 && i < TEST_PLAN_FILES; i += step)
+    {
+        insertEntry(word, i, -1);
+    }
+    
+    for(i = 0; i < count; i++)
+    {
+        insertEntry(word, list[i], -1);
+    }
+    
+    node = createTermNode(arena, leaf, word);
+    destroyWord(word);
+    
+    return node;
+}
+
+PlanNode createNode(Arena arena, int type, PlanNode first, PlanNode second)
+{
+    PlanNode children[2];
+    
+    children[0] = first;
+    children[1] = second;
+    
+    return createOperatorNode(arena, type, children, (second != NULL) ? 2 : 1);
+}
+
+/* Walks a plan from the start and checks it lands on exactly the files matching, none twice */
+int walks(PlanNode root, int (*matches)(int))
+{
+    int doc, expected;
+    
+    expected = 0;
+    for(doc = advancePlan(root, 0); doc != PLAN_END; doc = advancePlan(root, doc + 1))
+    {
+        while(expected < TEST_PLAN_FILES && !matches(expected))
+        {
+            expected++;
+        }
+        if(doc != expected)
+        {
+            fprintf(stderr, "plan on %d, expected %d\n", doc, expected);
+            return 0;
+        }
+        expected++;
+    }
+    
+    while(expected < TEST_PLAN_FILES && !matches(expected))
+    {
+        expected++;
+    }
+    
+    return expected == TEST_PLAN_FILES;
+}
+
+int evenAndThird(int doc)
+{
+    return doc % 2 == 0 && doc % 3 == 0;
+}
+
+int evenOrListed(int doc)
+{
+    return doc % 2 == 0 || doc == 1 || doc == 5 || doc == 37;
+}
+
+int evenNotThird(int doc)
+{
+    return doc % 2 == 0 && doc % 3 != 0;
+}
+
+int even(int doc)
+{
+    return doc % 2 == 0;
+}
+
+int notFifth(int doc)
+{
+    return doc % 5 != 0;
+}
+
+int mixed(int doc)
+{
+    return (doc % 2 == 0 && (doc % 3 == 0 || doc % 5 == 0)) || doc == 1 || doc == 5 || doc == 37;
+}
+
+/* Tests */
+
+void run_tests()
+{
+    Arena arena;
+    PlanNode two, three, five, listed, root;
+    int list[] = {1, 5, 37}, ok;
+    
+    /* Test every kind of node walks exactly the files it matches */
+    
+    arena = createArena(ARENA_CHUNK_SIZE);
+    two = createLeaf(arena, 0, 2, NULL, 0);
+    three = createLeaf(arena, 1, 3, NULL, 0);
+    five = createLeaf(arena, 2, 5, NULL, 0);
+    listed = createLeaf(arena, 3, 0, list, 3);
+    SW_ASSERT(two != NULL && three != NULL && five != NULL && listed != NULL, "Leaves of the plan created",
+              tests_run, failures);
+    
+    root = createNode(arena, PLAN_AND, two, three);
+    optimizePlan(root, TEST_PLAN_FILES);
+    SW_ASSERT(walks(root, evenAndThird) == 1, "AND walks the files of both", tests_run, failures);
+    
+    two = createLeaf(arena, 0, 2, NULL, 0);
+    root = createNode(arena, PLAN_OR, two, listed);
+    optimizePlan(root, TEST_PLAN_FILES);
+    SW_ASSERT(walks(root, evenOrListed) == 1, "OR walks the files of either", tests_run, failures);
+    
+    two = createLeaf(arena, 0, 2, NULL, 0);
+    three = createLeaf(arena, 1, 3, NULL, 0);
+    root = createNode(arena, PLAN_AND, two, createNode(arena, PLAN_NOT, three, NULL));
+    optimizePlan(root, TEST_PLAN_FILES);
+    SW_ASSERT(walks(root, evenNotThird) == 1, "AND NOT walks the files of one without the other",
+              tests_run, failures);
+    
+    two = createLeaf(arena, 0, 2, NULL, 0);
+    root = createNode(arena, PLAN_NOT, createNode(arena, PLAN_NOT, two, NULL), NULL);
+    optimizePlan(root, TEST_PLAN_FILES);
+    SW_ASSERT(walks(root, even) == 1, "NOT NOT walks the files of the term", tests_run, failures);
+    
+    five = createLeaf(arena, 2, 5, NULL, 0);
+    root = createNode(arena, PLAN_NOT, five, NULL);
+    optimizePlan(root, TEST_PLAN_FILES);
+    SW_ASSERT(walks(root, notFifth) == 1, "NOT alone walks every other file of the index", tests_run, failures);
+    
+    root = createTermNode(arena, 0, NULL);
+    optimizePlan(root, TEST_PLAN_FILES);
+    SW_ASSERT(root != NULL && advancePlan(root, 0) == PLAN_END, "A term that matched nothing walks no file",
+              tests_run, failures);
+    
+    /* Test operands of the same kind are flattened */
+    
+    two = createLeaf(arena, 0, 2, NULL, 0);
+    three = createLeaf(arena, 1, 3, NULL, 0);
+    five = createLeaf(arena, 2, 5, NULL, 0);
+    root = createNode(arena, PLAN_AND, two, createNode(arena, PLAN_AND, three, five));
+    SW_ASSERT(root != NULL && root->numchildren == 3, "An AND of an AND is one AND", tests_run, failures);
+    
+    /* Test a plan optimized, intersected and skipped through walks the same files */
+    
+    two = createLeaf(arena, 0, 2, NULL, 0);
+    three = createLeaf(arena, 1, 3, NULL, 0);
+    five = createLeaf(arena, 2, 5, NULL, 0);
+    listed = createLeaf(arena, 3, 0, list, 3);
+    root = createNode(arena, PLAN_OR, createNode(arena, PLAN_AND, two, createNode(arena, PLAN_OR, three, five)), listed);
+    optimizePlan(root, TEST_PLAN_FILES);
+    ok = intersectLeaves(arena, root);
+    SW_ASSERT(ok && walks(root, mixed) == 1, "A mixed plan optimized and intersected walks its files",
+              tests_run, failures);
+    
+    two = createLeaf(arena, 0, 2, NULL, 0);
+    three = createLeaf(arena, 1, 3, NULL, 0);
+    root = createNode(arena, PLAN_AND, two, three);
+    optimizePlan(root, TEST_PLAN_FILES);
+    SW_ASSERT(advancePlan(root, 7) == 12 && advancePlan(root, 12) == 12 && advancePlan(root, 31) == 36 &&
+              advancePlan(root, 37) == PLAN_END, "A plan skips to the first file it matches from any file",
+              tests_run, failures);
+    
+    destroyArena(arena);
+    
+    /* Test queries are parsed into the plan their operators say */
+    
+    removeCorpus();
+    ok = writeCorpus() && buildIndex(TEST_INDEX, TEST_DIR, DEFAULT_CODEC, 0, 0);
+    SW_ASSERT(ok == 1, "Index of the test files built", tests_run, failures);
+    
+    SW_ASSERT(finds("sa brown NOT dog\n", "f3 f4 ") == 1, "NOT takes the files of a term away", tests_run, failures);
+    SW_ASSERT(finds("so NOT fox\n", "f1 f5 ") == 1, "NOT alone finds every other file", tests_run, failures);
+    SW_ASSERT(finds("so fox OR sleeps AND jumps\n", "f0 f2 f3 f4 ") == 1, "AND goes before OR",
+              tests_run, failures);
+    SW_ASSERT(finds("so (fox OR sleeps) AND jumps\n", "f0 ") == 1, "Parentheses go before AND", tests_run, failures);
+    SW_ASSERT(finds("so NOT (fox OR dog)\n", "f5 ") == 1, "NOT of a group", tests_run, failures);
+    SW_ASSERT(finds("sa fox (dog)\n", "f0 ") == 1, "A group with no operator in front is AND'd by sa",
+              tests_run, failures);
+    SW_ASSERT(finds("so and\n", "f4 ") == 1, "Operators are upper case only, and is a word", tests_run, failures);
+    
+    /* Test the edge cases of the parser */
+    
+    SW_ASSERT(finds("so NOT NOT fox\n", "f0 f2 f3 f4 ") == 1, "NOT NOT is undone", tests_run, failures);
+    SW_ASSERT(finds("so NOT NOT NOT fox\n", "f1 f5 ") == 1, "NOT NOT NOT is NOT", tests_run, failures);
+    SW_ASSERT(finds("sa fox NOT NOT quick\n", "f0 f2 f3 f4 ") == 1, "NOT NOT after a term is the term",
+              tests_run, failures);
+    SW_ASSERT(finds("so fox OR OR dog\n", "f0 f1 f2 f3 f4 ") == 1, "An operator twice counts once",
+              tests_run, failures);
+    SW_ASSERT(finds("so AND fox\n", "f0 f2 f3 f4 ") == 1, "An operator with nothing in front is dropped",
+              tests_run, failures);
+    SW_ASSERT(finds("so fox NOT\n", "f0 f2 f3 f4 ") == 1, "An operator with nothing after it is dropped",
+              tests_run, failures);
+    SW_ASSERT(finds("so NOT\n", "") == 1, "An operator alone finds nothing", tests_run, failures);
+    SW_ASSERT(finds("so ((fox)\n", "f0 f2 f3 f4 ") == 1, "A parenthesis left open is closed at the end",
+              tests_run, failures);
+    SW_ASSERT(finds("so ) fox (\n", "f0 f2 f3 f4 ") == 1, "Stray parentheses are dropped", tests_run, failures);
+    SW_ASSERT(finds("so ()\n", "") == 1, "Empty parentheses find nothing", tests_run, failures);
+    
+    removeCorpus();
+}
+
+
+int main(int argc, char **argv) {
+    
+    tests_run = 0;
+    failures = 0;
+    
+    printf("Starting tests for Boolean...\n");
+    
+    run_tests();
+    
+    printf("Ran %d tests, with %d failures.\n", tests_run, failures);
+    if(failures == 0)
+    {
+        printf("ALL TESTS PASSED.\n");
+    }
+    return 0;
+}
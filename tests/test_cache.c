@@ -0,0 +1,188 @@
+/* test_cache.c
+ *
+ * This file contains the tests for the word cache (see insertWord):
+ * the stripes share the one size of the cache, so a word of any
+ * size up to the whole cache has to be kept, however many stripes
+ * there are, a word bigger than that never is, and the words kept
+ * never add up to more than the cache's size, whichever stripes
+ * they went into.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "testing.h"
+#include "../src/cache.h"
+
+#define TEST_ENTRIES 100
+#define TEST_WORDS 200
+
+int tests_run, failures;
+
+struct Entry_ entries[TEST_ENTRIES];
+
+/* Helpers */
+
+/* A word found in the first numFiles files */
+struct Word_ makeWord(char *str, int numFiles)
+{
+    struct Word_ word;
+    int i;
+    
+    for(i = 0; i < numFiles; i++)
+    {
+        entries[i].filename = NULL;
+        entries[i].filenumber = i;
+        entries[i].frequency = 1;
+        entries[i].positions = NULL;
+        entries[i].lastPositions = NULL;
+        entries[i].numPositions = 0;
+        entries[i].next = (i + 1 < numFiles) ? &entries[i + 1] : NULL;
+    }
+    
+    word.word = str;
+    word.head = (numFiles > 0) ? entries : NULL;
+    word.numFiles = numFiles;
+    word.totalAppearances = numFiles;
+    word.positions = -1;
+    
+    return word;
+}
+
+/* Bytes a word of numFiles files is charged, as wordSize counts them */
+unsigned long long chargedSize(char *str, int numFiles)
+{
+    return sizeof(Word) + sizeof(struct Word_) + strlen(str) + 1 + sizeof(struct Entry_) * numFiles;
+}
+
+/* Whether a word is in the cache with all its files */
+int isCached(Cache cache, char *str, int numFiles)
+{
+    Arena arena;
+    Word word;
+    int found;
+    
+    arena = createArena(4096);
+    word = searchCache(cache, str, arena);
+    found = (word != NULL && word->numFiles == numFiles);
+    destroyArena(arena);
+    
+    return found;
+}
+
+/* Keeps one word of numFiles files per name and counts the ones still there after */
+int countCached(Cache cache, int numwords, int numFiles)
+{
+    struct Word_ word;
+    char str[32];
+    int i, count;
+    
+    for(i = 0; i < numwords; i++)
+    {
+        sprintf(str, "w%d", i);
+        word = makeWord(str, numFiles);
+        insertWord(cache, &word);
+    }
+    
+    count = 0;
+    for(i = 0; i < numwords; i++)
+    {
+        sprintf(str, "w%d", i);
+        count += isCached(cache, str, numFiles);
+    }
+    
+    return count;
+}
+
+/* Tests */
+
+void run_tests()
+{
+    struct Word_ word;
+    Cache cache;
+    unsigned long long size;
+    int count, numFiles;
+    
+    /* Test a word much bigger than 1 / CACHE_STRIPES of the cache is kept */
+    
+    cache = createCache("2KB");
+    SW_ASSERT(cache != NULL, "Cache of 2KB made", tests_run, failures);
+    
+    numFiles = 30;
+    size = chargedSize("big", numFiles);
+    word = makeWord("big", numFiles);
+    
+    SW_ASSERT(size > 2048 / CACHE_STRIPES && size < 2048, "The word is bigger than a stripe's share and fits the cache",
+              tests_run, failures);
+    SW_ASSERT(fitsCache(cache, &word) == 1, "A word smaller than the cache fits it", tests_run, failures);
+    SW_ASSERT(insertWord(cache, &word) == 1, "The word went in without clearing anything out", tests_run, failures);
+    SW_ASSERT(isCached(cache, "big", numFiles) == 1, "The word is kept", tests_run, failures);
+    
+    destroyCache(cache);
+    
+    /* Test a word bigger than the whole cache is never kept */
+    
+    cache = createCache("1KB");
+    
+    numFiles = TEST_ENTRIES;
+    word = makeWord("huge", numFiles);
+    
+    SW_ASSERT(chargedSize("huge", numFiles) > 1024 && fitsCache(cache, &word) == 0,
+              "A word bigger than the cache does not fit it", tests_run, failures);
+    SW_ASSERT(insertWord(cache, &word) == 1 && isCached(cache, "huge", numFiles) == 0,
+              "A word bigger than the cache is left out", tests_run, failures);
+    
+    destroyCache(cache);
+    
+    /* Test many words across the stripes never take more than the cache */
+    
+    cache = createCache("4KB");
+    
+    numFiles = 4;
+    count = countCached(cache, TEST_WORDS, numFiles);
+    
+    /* w0 ... w199 are charged a byte or two apart by the length of their names */
+    SW_ASSERT(count > 0 && count * chargedSize("w0", numFiles) <= 4096, "The words kept add up to no more than the cache",
+              tests_run, failures);
+    SW_ASSERT((count + 1) * chargedSize("w100", numFiles) > 4096, "The words kept fill the cache",
+              tests_run, failures);
+    
+    /* A big word whose stripe has little to clear out takes its room from the others */
+    numFiles = 70;
+    word = makeWord("big", numFiles);
+    
+    SW_ASSERT(chargedSize("big", numFiles) > 3 * 1024 && chargedSize("big", numFiles) < 4096,
+              "The big word takes most of the cache", tests_run, failures);
+    SW_ASSERT(insertWord(cache, &word) == -1, "The big word cleared other words out", tests_run, failures);
+    SW_ASSERT(isCached(cache, "big", numFiles) == 1, "The big word is kept in a full cache", tests_run, failures);
+    
+    destroyCache(cache);
+    
+    /* Test a cache of 0 keeps everything */
+    
+    cache = createCache("0KB");
+    
+    numFiles = 4;
+    SW_ASSERT(countCached(cache, TEST_WORDS, numFiles) == TEST_WORDS, "An unbounded cache keeps every word",
+              tests_run, failures);
+    
+    destroyCache(cache);
+}
+
+
+int main(int argc, char **argv) {
+    
+    tests_run = 0;
+    failures = 0;
+    
+    printf("Starting tests for Cache...\n");
+    
+    run_tests();
+    
+    printf("Ran %d tests, with %d failures.\n", tests_run, failures);
+    if(failures == 0)
+    {
+        printf("ALL TESTS PASSED.\n");
+    }
+    return 0;
+}
@@ -0,0 +1,190 @@
+/* test_codec.c
+ *
+ * This file contains the tests for the postings codecs: every block
+ * decoder the processor has must give back what encodeBlock coded,
+ * and packed postings must read back in the order they were written.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "testing.h"
+#include "../src/codec.h"
+
+int tests_run, failures;
+
+static const char *levelNames[] = {"Scalar", "SSE", "AVX2"};
+
+/* Helpers */
+
+/* Numbers of up to bits bits, with one in every outlier (if any) much wider */
+void randomBlock(unsigned int *block, int bits, int outlier)
+{
+    int i;
+    
+    for(i = 0; i < CODEC_BLOCK; i++)
+    {
+        block[i] = ((unsigned int) rand() << 16) ^ (unsigned int) rand();
+        block[i] &= (bits >= 32) ? 0xFFFFFFFFU : (1U << bits) - 1;
+        
+        if(outlier > 0 && rand() % outlier == 0)
+        {
+            block[i] |= 0x80000000U >> (rand() % 8);
+        }
+    }
+}
+
+/* Codes a block, then decodes it with one kernel, it has to come back whole */
+int roundTrip(int codec, int level, const unsigned int *block)
+{
+    unsigned char coded[CODEC_BLOCK_BYTES * 2];
+    unsigned int out[CODEC_BLOCK];
+    int written, read;
+    
+    memset(coded, 0xEE, sizeof(coded));
+    written = encodeBlock(codec, block, coded);
+    read = decodeKernel(codec, level)(coded, out);
+    
+    return written <= CODEC_BLOCK_BYTES && read == written && memcmp(block, out, sizeof(out)) == 0;
+}
+
+/* Tests */
+
+void run_tests()
+{
+    static const int widths[] = {0, 1, 2, 3, 5, 7, 8, 9, 13, 16, 17, 24, 25, 31, 32};
+    unsigned int block[CODEC_BLOCK];
+    unsigned char coded[CODEC_BLOCK_BYTES * 2];
+    char text[256];
+    Word word;
+    Entry ent, tail;
+    Arena arena;
+    FILE *file;
+    long offset, second, positions;
+    int *files, *freqs;
+    int codec, level, i, w, n, ok;
+    
+    srand(42);
+    
+    printf("Processor supports %s.\n", levelNames[simdLevel()]);
+    
+    /* Test names */
+    
+    SW_ASSERT(codecByName("pfor") == CODEC_PFOR, "pfor is a codec.", tests_run, failures);
+    SW_ASSERT(codecByName("zip") == -1, "zip is not a codec.", tests_run, failures);
+    SW_ASSERT(strcmp(codecName(CODEC_STREAMVBYTE), "streamvbyte") == 0, "Codec names go both ways.", tests_run, failures);
+    SW_ASSERT(decodeKernel(CODEC_PFOR, simdLevel() + 1) == NULL, "No decoder past what the processor has.", tests_run, failures);
+    
+    /* Test every decoder on every bit width, with and without exceptions */
+    
+    for(codec = 0; codec < NUM_CODECS; codec++)
+    {
+        for(level = SIMD_SCALAR; level <= simdLevel(); level++)
+        {
+            ok = 1;
+            
+            for(w = 0; w < (int) (sizeof(widths) / sizeof(widths[0])); w++)
+            {
+                for(i = 0; i < 20; i++)
+                {
+                    randomBlock(block, widths[w], (i % 2 == 0) ? 0 : 1 + i);
+                    if(!roundTrip(codec, level, block))
+                    {
+                        ok = 0;
+                    }
+                }
+            }
+            
+            for(i = 0; i < CODEC_BLOCK; i++) block[i] = 0xFFFFFFFFU;
+            ok = ok && roundTrip(codec, level, block);
+            
+            for(i = 0; i < CODEC_BLOCK; i++) block[i] = (i == 77) ? 0xFFFFFFFFU : 1;
+            ok = ok && roundTrip(codec, level, block);
+            
+            sprintf(text, "%s decoder of %s gives back every block", levelNames[level], codecName(codec));
+            SW_ASSERT(ok == 1, text, tests_run, failures);
+        }
+    }
+    
+    /* Test pfor keeps outliers out of the bit width */
+    
+    for(i = 0; i < CODEC_BLOCK; i++) block[i] = (i % 32 == 0) ? 1000000 : i % 4;
+    n = encodeBlock(CODEC_PFOR, block, coded);
+    SW_ASSERT(coded[0] == 2 && n < 16 * 3 + 30, "pfor codes a few outliers as exceptions.", tests_run, failures);
+    
+    coded[0] = 40;
+    SW_ASSERT(decodeBlock(CODEC_PFOR, coded, block) == -1, "pfor refuses a bit width past 32.", tests_run, failures);
+    
+    /* Test packed postings read back in list order, for every codec */
+    
+    arena = createArena(65536);
+    
+    for(codec = 0; codec < NUM_CODECS; codec++)
+    {
+        word = createWord("term");
+        tail = NULL;
+        n = 0;
+        
+        /* Runs of equal frequency going up, then down, each long enough for several blocks */
+        for(i = 0; i < 1000; i++)
+        {
+            ent = createEntry(NULL, (i < 600) ? 7 * i + (i % 7) : 7 * (1600 - i) + (i % 7), (i < 10) ? 50 - i : (i < 600) ? 2 : 1);
+            if(tail == NULL) word->head = ent;
+            else tail->next = ent;
+            tail = ent;
+            n++;
+        }
+        
+        /* And a file that goes back up, which has to start a new run */
+        ent = createEntry(NULL, 100000, 1);
+        tail->next = ent;
+        n++;
+        word->numFiles = n;
+        
+        file = tmpfile();
+        writeCodecHeader(file, codec);
+        offset = writePacked(file, codec, word, 123456789L);
+        second = writePacked(file, codec, word, 42L);
+        rewind(file);
+        
+        ok = (readCodecHeader(file) == codec && offset > 0 && second > offset);
+        
+        resetArena(arena);
+        ok = ok && readPacked(file, offset, codec, arena, &files, &freqs, &positions) == n && positions == 123456789L;
+        
+        i = 0;
+        for(ent = word->head; ent != NULL && ok; ent = ent->next)
+        {
+            ok = (files[i] == ent->filenumber && freqs[i] == ent->frequency);
+            i++;
+        }
+        
+        ok = ok && readPacked(file, second, codec, arena, &files, &freqs, &positions) == n && positions == 42L;
+        
+        sprintf(text, "%s postings read back in list order", codecName(codec));
+        SW_ASSERT(ok == 1, text, tests_run, failures);
+        
+        fclose(file);
+        destroyWord(word);
+    }
+    
+    destroyArena(arena);
+}
+
+
+int main(int argc, char **argv) {
+    
+    tests_run = 0;
+    failures = 0;
+    
+    printf("Starting tests for Codec...\n");
+    
+    run_tests();
+    
+    printf("Ran %d tests, with %d failures.\n", tests_run, failures);
+    if(failures == 0)
+    {
+        printf("ALL TESTS PASSED.\n");
+    }
+    return 0;
+}
@@ -0,0 +1,362 @@
+/* test_fuzzy.c
+ *
+ * This file contains the tests for fuzzy terms (see getFuzzy): the
+ * Levenshtein automaton walked over the lexicon (see expandFuzzy)
+ * has to find exactly the terms a plain edit distance finds, for
+ * every distance, on a lexicon of many close terms. A query term
+ * ending in ~N has to find the files of every term within N edits,
+ * ~ alone meaning FUZZY_DISTANCE and N past MAX_FUZZY_DISTANCE
+ * meaning that.
+ */
+
+/* mkdir and rmdir are POSIX, not ANSI */
+#define _XOPEN_SOURCE 600
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "testing.h"
+#include "../src/csearch.h"
+#include "../src/index.h"
+#include "../src/lexicon.h"
+
+#define TEST_DIR "test_fuzzy_files"
+#define TEST_INDEX "test_fuzzy.idx"
+#define TEST_ANSWER 256
+#define TEST_TERMS_DIR "test_fuzzy_terms"
+#define TEST_TERMS_INDEX "test_fuzzy_terms.idx"
+#define TEST_TERMS 2000
+
+int tests_run, failures;
+
+char *texts[] = {"the quick brown fox jumps over the lazy dog",
+                 "the lazy brown dog sleeps",
+                 "quick quick fox",
+                 "brown fox quick",
+                 "a fox that is quick and brown",
+                 "jumping jumper jumps"};
+
+#define TEST_FILES ((int) (sizeof(texts) / sizeof(texts[0])))
+
+/* Helpers */
+
+int writeCorpus(void)
+{
+    FILE *file;
+    char name[256];
+    int i;
+    
+    if(mkdir(TEST_DIR, 0755) != 0)
+    {
+        return 0;
+    }
+    
+    for(i = 0; i < TEST_FILES; i++)
+    {
+        sprintf(name, "%s/f%d.txt", TEST_DIR, i);
+        file = fopen(name, "w");
+        if(file == NULL)
+        {
+            return 0;
+        }
+        fprintf(file, "%s\n", texts[i]);
+        fclose(file);
+    }
+    
+    return 1;
+}
+
+/* One file of many short terms of a few letters, so most are a few edits from many others */
+int writeTerms(void)
+{
+    FILE *file;
+    int i, j, len;
+    
+    if(mkdir(TEST_TERMS_DIR, 0755) != 0)
+    {
+        return 0;
+    }
+    
+    file = fopen(TEST_TERMS_DIR "/terms.txt", "w");
+    if(file == NULL)
+    {
+        return 0;
+    }
+    
+    for(i = 0; i < TEST_TERMS; i++)
+    {
+        len = 1 + rand() % 7;
+        for(j = 0; j < len; j++)
+        {
+            fputc("abcd"[rand() % 4], file);
+        }
+        fputc(' ', file);
+    }
+    fclose(file);
+    
+    return 1;
+}
+
+void removeCorpus(void)
+{
+    static char *suffixes[] = {POSITIONS_SUFFIX, LEXICON_SUFFIX, BLOCKMAX_SUFFIX, IMPACT_SUFFIX, ROARING_SUFFIX,
+                               PACKED_SUFFIX, TRIGRAM_SUFFIX, BLOOM_SUFFIX, MPHF_SUFFIX, STATS_SUFFIX};
+    char name[256];
+    int i;
+    
+    for(i = 0; i < TEST_FILES; i++)
+    {
+        sprintf(name, "%s/f%d.txt", TEST_DIR, i);
+        remove(name);
+    }
+    rmdir(TEST_DIR);
+    
+    remove(TEST_TERMS_DIR "/terms.txt");
+    rmdir(TEST_TERMS_DIR);
+    
+    for(i = 0; i < (int) (sizeof(suffixes) / sizeof(suffixes[0])); i++)
+    {
+        removeSidecar(TEST_INDEX, suffixes[i]);
+        removeSidecar(TEST_TERMS_INDEX, suffixes[i]);
+    }
+    remove(TEST_INDEX);
+    remove(TEST_TERMS_INDEX);
+}
+
+Filelist openIndex(void)
+{
+    TokenizerT tok;
+    Filelist files;
+    
+    tok = TKCreate(FILE_CHARS, TEST_INDEX);
+    files = (tok != NULL) ? getFilelist(tok) : NULL;
+    TKDestroy(tok);
+    
+    return files;
+}
+
+/* Number of the file a name was written to: f3.txt is 3 */
+int fileNumber(Filelist files, int filenum)
+{
+    char name[256], *base;
+    
+    if(getFilename(files, filenum, name, sizeof(name)) == NULL)
+    {
+        return -1;
+    }
+    
+    base = strrchr(name, '/');
+    return atoi((base != NULL) ? base + 2 : name + 1);
+}
+
+/* The files a query finds as "f0 f3 ", in file order */
+int findFiles(char *query, char *answer)
+{
+    Filelist files;
+    Cache cache;
+    Result result;
+    int found[TEST_FILES], i, num;
+    
+    answer[0] = '\0';
+    
+    files = openIndex();
+    cache = createCache("1MB");
+    if(files == NULL || cache == NULL)
+    {
+        destroyCache(cache);
+        destroyFilelist(files);
+        return 0;
+    }
+    
+    for(i = 0; i < TEST_FILES; i++)
+    {
+        found[i] = 0;
+    }
+    
+    search(query, files->tok, files, cache);
+    
+    for(result = files->results; result != NULL; result = result->next)
+    {
+        num = fileNumber(files, result->filenum);
+        if(num >= 0 && num < TEST_FILES)
+        {
+            found[num] = 1;
+        }
+    }
+    
+    for(i = 0; i < TEST_FILES; i++)
+    {
+        if(found[i])
+        {
+            sprintf(answer + strlen(answer), "f%d ", i);
+        }
+    }
+    
+    resetResults(files);
+    destroyFilelist(files);
+    destroyCache(cache);
+    
+    return 1;
+}
+
+/* A query has to find exactly the files expected */
+int finds(char *query, char *expected)
+{
+    char answer[TEST_ANSWER];
+    
+    if(findFiles(query, answer) == 0)
+    {
+        return 0;
+    }
+    
+    if(strcmp(answer, expected) != 0)
+    {
+        fprintf(stderr, "%s  expected \"%s\", found \"%s\"\n", query, expected, answer);
+        return 0;
+    }
+    
+    return 1;
+}
+
+/* Edit distance between two terms, one row at a time */
+int editDistance(char *a, char *b)
+{
+    int row[64], i, j, diag, above, m;
+    
+    m = strlen(b);
+    
+    for(j = 0; j <= m; j++)
+    {
+        row[j] = j;
+    }
+    
+    for(i = 1; a[i - 1] != '\0'; i++)
+    {
+        diag = row[0];
+        row[0] = i;
+        
+        for(j = 1; j <= m; j++)
+        {
+            above = row[j];
+            row[j] = diag + (a[i - 1] != b[j - 1]);
+            if(above + 1 < row[j])
+            {
+                row[j] = above + 1;
+            }
+            if(row[j - 1] + 1 < row[j])
+            {
+                row[j] = row[j - 1] + 1;
+            }
+            diag = above;
+        }
+    }
+    
+    return row[m];
+}
+
+/* The automaton has to keep exactly the terms within distance, for every term of a few and every distance */
+int sameAsDistance(char **queries, int numqueries)
+{
+    Lexicon lex;
+    int *terms, numterms, i, j, q, distance, same;
+    
+    lex = loadLexicon(TEST_TERMS_INDEX);
+    terms = (lex != NULL) ? (int*) malloc(sizeof(int) * lexiconSize(lex)) : NULL;
+    same = (terms != NULL && lexiconSize(lex) > 100);
+    
+    for(q = 0; q < numqueries && same; q++)
+    {
+        for(distance = 0; distance <= MAX_FUZZY_DISTANCE && same; distance++)
+        {
+            numterms = expandFuzzy(lex, queries[q], distance, terms, lexiconSize(lex));
+            same = (numterms >= 0);
+            
+            /* Terms come back in index order, so one pass checks both ways */
+            j = 0;
+            for(i = 0; i < lexiconSize(lex) && same; i++)
+            {
+                if(editDistance(queries[q], lexiconTerm(lex, i)) <= distance)
+                {
+                    same = (j < numterms && terms[j] == i);
+                    j++;
+                }
+            }
+            same = same && (j == numterms);
+            
+            if(!same)
+            {
+                fprintf(stderr, "%s~%d  %d terms kept, %d within distance\n", queries[q], distance, numterms, j);
+            }
+        }
+    }
+    
+    free(terms);
+    destroyLexicon(lex);
+    
+    return same;
+}
+
+/* Tests */
+
+void run_tests()
+{
+    char *queries[] = {"a", "abc", "dcba", "abcdabc", "bbbbbbb", "aaaaaaaaaa"};
+    char capped[TEST_ANSWER], most[TEST_ANSWER];
+    int ok;
+    
+    srand(34);
+    
+    removeCorpus();
+    ok = writeCorpus() && buildIndex(TEST_INDEX, TEST_DIR, DEFAULT_CODEC, 0, 0);
+    SW_ASSERT(ok == 1, "Index of the test files built", tests_run, failures);
+    
+    ok = writeTerms() && buildIndex(TEST_TERMS_INDEX, TEST_TERMS_DIR, DEFAULT_CODEC, 0, 0);
+    SW_ASSERT(ok == 1, "Index of many close terms built", tests_run, failures);
+    
+    /* Test the automaton against the edit distance */
+    
+    SW_ASSERT(ok && sameAsDistance(queries, 6) == 1, "The automaton keeps exactly the terms within distance",
+              tests_run, failures);
+    
+    /* Test a query finds the files of every term within distance */
+    
+    SW_ASSERT(finds("so jump~1\n", "f0 f5 ") == 1, "~1 finds a term one edit away", tests_run, failures);
+    SW_ASSERT(finds("so jumpy~2\n", "f0 f5 ") == 1, "~2 finds terms two edits away", tests_run, failures);
+    SW_ASSERT(finds("so lazy~0\n", "f0 f1 ") == 1, "~0 is the term itself", tests_run, failures);
+    SW_ASSERT(finds("so lazzy~0\n", "") == 1, "~0 finds nothing for a term not in the index", tests_run, failures);
+    SW_ASSERT(finds("so lazzy~\n", "f0 f1 ") == 1, "~ alone is FUZZY_DISTANCE", tests_run, failures);
+    SW_ASSERT(finds("sa sleepy~1 dog\n", "f1 ") == 1, "A fuzzy term is one term of a query", tests_run, failures);
+    
+    /* Test the edge cases of the operator */
+    
+    SW_ASSERT(findFiles("so foxes~9\n", capped) && findFiles("so foxes~3\n", most) && strcmp(capped, most) == 0 &&
+              strcmp(capped, "f0 f2 f3 f4 ") == 0, "A distance past MAX_FUZZY_DISTANCE is cut down to it",
+              tests_run, failures);
+    SW_ASSERT(finds("so ~1\n", "") == 1, "~ with no term in front of it is a word like any other", tests_run, failures);
+    SW_ASSERT(finds("so dog~x\n", "") == 1, "~ followed by more than a number is a word like any other",
+              tests_run, failures);
+    SW_ASSERT(finds("so dog NEAR/1 lazzy~1\n", "f0 f1 ") == 1, "A fuzzy term is never joined by NEAR",
+              tests_run, failures);
+    
+    removeCorpus();
+}
+
+
+int main(int argc, char **argv) {
+    
+    tests_run = 0;
+    failures = 0;
+    
+    printf("Starting tests for Fuzzy...\n");
+    
+    run_tests();
+    
+    printf("Ran %d tests, with %d failures.\n", tests_run, failures);
+    if(failures == 0)
+    {
+        printf("ALL TESTS PASSED.\n");
+    }
+    return 0;
+}
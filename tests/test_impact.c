@@ -0,0 +1,251 @@
+/* test_impact.c
+ *
+ * This file contains the tests for impact ordered postings: a list
+ * written by writeImpacts has to read back one segment per
+ * frequency, highest first, with every file of that frequency in
+ * file order. The best k files of terms OR'd together, found by
+ * reading only the heads of those lists (see searchImpacts), have
+ * to be the first k of every file scored and sorted (see
+ * sortResults), with the same scores, files of the same score in
+ * file order, for any k.
+ */
+
+/* mkdir and rmdir are POSIX, not ANSI */
+#define _XOPEN_SOURCE 600
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "testing.h"
+#include "../src/csearch.h"
+#include "../src/impact.h"
+#include "../src/index.h"
+
+#define TEST_DIR "test_impact_files"
+#define TEST_INDEX "test_impact.idx"
+#define TEST_FILES 600
+#define TEST_WORDS 20
+#define TEST_VOCABULARY 50
+#define TEST_ANSWER 65536
+#define TEST_POSTINGS 1000
+#define TEST_LEVELS 5
+
+int tests_run, failures;
+
+/* Helpers */
+
+/* Files of words drawn from w0 ... w(TEST_VOCABULARY - 1), the first ones far more often, so lists differ in length and many files tie */
+int writeCorpus(void)
+{
+    FILE *file;
+    char name[256];
+    int i, j;
+    
+    if(mkdir(TEST_DIR, 0755) != 0)
+    {
+        return 0;
+    }
+    
+    for(i = 0; i < TEST_FILES; i++)
+    {
+        sprintf(name, "%s/file%d.txt", TEST_DIR, i);
+        file = fopen(name, "w");
+        if(file == NULL)
+        {
+            return 0;
+        }
+        
+        for(j = 0; j < TEST_WORDS; j++)
+        {
+            fprintf(file, "w%d ", (rand() % TEST_VOCABULARY) * (rand() % TEST_VOCABULARY) / TEST_VOCABULARY);
+        }
+        fclose(file);
+    }
+    
+    return 1;
+}
+
+void removeCorpus(void)
+{
+    static char *suffixes[] = {POSITIONS_SUFFIX, LEXICON_SUFFIX, BLOCKMAX_SUFFIX, IMPACT_SUFFIX, ROARING_SUFFIX,
+                               PACKED_SUFFIX, TRIGRAM_SUFFIX, BLOOM_SUFFIX, MPHF_SUFFIX, STATS_SUFFIX};
+    char name[256];
+    int i;
+    
+    for(i = 0; i < TEST_FILES; i++)
+    {
+        sprintf(name, "%s/file%d.txt", TEST_DIR, i);
+        remove(name);
+    }
+    rmdir(TEST_DIR);
+    
+    for(i = 0; i < (int) (sizeof(suffixes) / sizeof(suffixes[0])); i++)
+    {
+        removeSidecar(TEST_INDEX, suffixes[i]);
+    }
+    remove(TEST_INDEX);
+}
+
+/* Writes down the first k files a query finds with their scores, in the order they were found, k of 0 for all */
+int recordAnswer(char *query, int topk, int k, char *answer)
+{
+    TokenizerT tok;
+    Filelist files;
+    Cache cache;
+    Result result;
+    char found[64];
+    int count;
+    
+    answer[0] = '\0';
+    
+    tok = TKCreate(FILE_CHARS, TEST_INDEX);
+    files = (tok != NULL) ? getFilelist(tok) : NULL;
+    TKDestroy(tok);
+    
+    cache = createCache("1MB");
+    if(files == NULL || cache == NULL)
+    {
+        destroyCache(cache);
+        destroyFilelist(files);
+        return 0;
+    }
+    
+    files->topk = topk;
+    search(query, files->tok, files, cache);
+    
+    count = 0;
+    for(result = files->results; result != NULL && (k == 0 || count < k); result = result->next)
+    {
+        sprintf(found, "%d:%.6f ", result->filenum, result->score);
+        if(strlen(answer) + strlen(found) < TEST_ANSWER)
+        {
+            strcat(answer, found);
+        }
+        count++;
+    }
+    
+    resetResults(files);
+    destroyFilelist(files);
+    destroyCache(cache);
+    
+    return 1;
+}
+
+/* Every query has to find as its best k the first k of every file it matches, sorted */
+int sameAnswers(char **queries, int numqueries, int k)
+{
+    char sorted[TEST_ANSWER], best[TEST_ANSWER];
+    int i, same;
+    
+    same = 1;
+    
+    for(i = 0; i < numqueries && same; i++)
+    {
+        same = recordAnswer(queries[i], 0, k, sorted) &&
+               recordAnswer(queries[i], k, 0, best) &&
+               sorted[0] != '\0' && strcmp(sorted, best) == 0;
+        if(!same)
+        {
+            fprintf(stderr, "%s  k %d\n  sorted: %s\n  best:   %s\n", queries[i], k, sorted, best);
+        }
+    }
+    
+    return same;
+}
+
+/* A list of TEST_POSTINGS files, file i holding the word (i % TEST_LEVELS) + 1 times, has to read back a level at a time */
+int readsBack(void)
+{
+    FILE *file;
+    Word word;
+    long pos;
+    int files[TEST_POSTINGS], i, j, freq, count, level, same;
+    
+    word = createWord("term");
+    file = tmpfile();
+    same = (word != NULL && file != NULL);
+    
+    for(i = 0; i < TEST_POSTINGS && same; i++)
+    {
+        for(j = 0; j <= i % TEST_LEVELS && same; j++)
+        {
+            same = (insertEntry(word, i, -1) != 0);
+        }
+    }
+    
+    pos = same ? writeImpacts(file, word) : -1;
+    same = (pos >= 0);
+    
+    for(level = TEST_LEVELS; level > 0 && same; level--)
+    {
+        same = readImpactSegment(file, &pos, &freq, &count) && freq == level && count == TEST_POSTINGS / TEST_LEVELS &&
+               readImpactFiles(file, &pos, files, count);
+        
+        for(i = 0; i < count && same; i++)
+        {
+            same = (files[i] == level - 1 + i * TEST_LEVELS);
+        }
+    }
+    
+    /* Then the end of the list */
+    same = same && readImpactSegment(file, &pos, &freq, &count) && freq == 0;
+    
+    if(file != NULL)
+    {
+        fclose(file);
+    }
+    destroyWord(word);
+    
+    return same;
+}
+
+/* Tests */
+
+void run_tests()
+{
+    char *queries[] = {"so w0\n", "so w1 w30\n", "so w2 w3 w4\n", "so w40 w45 w0\n", "so w10 w11 w12 w13 w14 w15\n"};
+    int ok;
+    
+    /* Test a list reads back a level at a time */
+    
+    SW_ASSERT(readsBack() == 1, "A list reads back highest frequency first, files in order", tests_run, failures);
+    
+    srand(38);
+    
+    removeCorpus();
+    ok = writeCorpus() && buildIndex(TEST_INDEX, TEST_DIR, DEFAULT_CODEC, 1, 0);
+    SW_ASSERT(ok == 1, "Index of the test files built with impact ordered lists", tests_run, failures);
+    
+    /* Test the best k from the heads of the lists are the first k of every file scored, ties at the cut included */
+    
+    SW_ASSERT(ok && sameAnswers(queries, 5, 1) == 1, "The best file is the first of every file sorted",
+              tests_run, failures);
+    SW_ASSERT(ok && sameAnswers(queries, 5, 7) == 1, "The best 7 files are the first 7 of every file sorted",
+              tests_run, failures);
+    SW_ASSERT(ok && sameAnswers(queries, 5, 100) == 1, "The best 100 files are the first 100 of every file sorted",
+              tests_run, failures);
+    SW_ASSERT(ok && sameAnswers(queries, 5, TEST_FILES) == 1, "With k past the end every file is found, sorted",
+              tests_run, failures);
+    
+    removeCorpus();
+}
+
+
+int main(int argc, char **argv) {
+    
+    tests_run = 0;
+    failures = 0;
+    
+    printf("Starting tests for Impact...\n");
+    
+    run_tests();
+    
+    printf("Ran %d tests, with %d failures.\n", tests_run, failures);
+    if(failures == 0)
+    {
+        printf("ALL TESTS PASSED.\n");
+    }
+    return 0;
+}
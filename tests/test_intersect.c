@@ -0,0 +1,214 @@
+/* test_intersect.c
+ *
+ * This file contains the differential tests for the intersection
+ * kernels: every kernel the processor has must give the same output
+ * as a plain merge.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "testing.h"
+#include "../src/intersect.h"
+
+#define CANARY 0x5A5A5A5A
+
+int tests_run, failures;
+
+static const char *levelNames[] = {"Scalar", "SSE", "AVX2"};
+
+/* Helpers */
+
+/* Picks n different numbers below universe, ascending (Knuth's selection sampling) */
+void randomList(int *list, int n, int universe)
+{
+    int i, k;
+    
+    k = 0;
+    for(i = 0; i < universe && k < n; i++)
+    {
+        if((double) rand() / ((double) RAND_MAX + 1.0) * (universe - i) < n - k)
+        {
+            list[k] = i;
+            k++;
+        }
+    }
+}
+
+int naiveIntersect(const int *a, int na, const int *b, int nb, int *out)
+{
+    int i, j, k;
+    
+    i = j = k = 0;
+    while(i < na && j < nb)
+    {
+        if(a[i] < b[j]) i++;
+        else if(a[i] > b[j]) j++;
+        else
+        {
+            out[k++] = a[i];
+            i++;
+            j++;
+        }
+    }
+    
+    return k;
+}
+
+/* Runs one kernel both ways round and compares it to the merge, out has to stay in bounds */
+int sameAsNaive(IntersectFunc kernel, const int *a, int na, const int *b, int nb)
+{
+    int *expected, *out, n, m, size, ok;
+    
+    size = ((na < nb) ? na : nb) + INTERSECT_SLACK;
+    expected = (int*) malloc(sizeof(int) * (size + 1));
+    out = (int*) malloc(sizeof(int) * (size + 1));
+    
+    n = naiveIntersect(a, na, b, nb, expected);
+    
+    out[size] = CANARY;
+    m = kernel(a, na, b, nb, out);
+    ok = (m == n && memcmp(out, expected, sizeof(int) * n) == 0 && out[size] == CANARY);
+    
+    out[size] = CANARY;
+    m = kernel(b, nb, a, na, out);
+    ok = ok && (m == n && memcmp(out, expected, sizeof(int) * n) == 0 && out[size] == CANARY);
+    
+    free(expected);
+    free(out);
+    
+    return ok;
+}
+
+/* Asserts every kernel the processor has gets a and b right */
+void checkKernels(const int *a, int na, const int *b, int nb, const char *what)
+{
+    char text[256];
+    int level;
+    
+    for(level = SIMD_SCALAR; level <= simdLevel(); level++)
+    {
+        sprintf(text, "%s kernel on %s", levelNames[level], what);
+        SW_ASSERT(sameAsNaive(intersectKernel(level), a, na, b, nb), text, tests_run, failures);
+    }
+}
+
+/* Tests */
+
+void run_tests()
+{
+    static int a[200000], b[200000];
+    static const int ratios[] = {1, 2, 8, 31, 32, 33, 100, 1000};
+    char text[256];
+    int i, r, n, level, ok;
+    
+    srand(42);
+    
+    printf("Processor supports %s.\n", levelNames[simdLevel()]);
+    
+    /* Test dispatch */
+    
+    SW_ASSERT(intersectKernel(SIMD_SCALAR) == intersectScalar, "Scalar kernel is always there.", tests_run, failures);
+    SW_ASSERT(intersectKernel(simdLevel() + 1) == NULL, "No kernel past what the processor has.", tests_run, failures);
+    
+    /* Test edge cases */
+    
+    checkKernels(a, 0, b, 0, "two empty lists");
+    
+    for(i = 0; i < 100; i++) b[i] = i;
+    checkKernels(a, 0, b, 100, "an empty list");
+    
+    a[0] = 7;
+    checkKernels(a, 1, b, 100, "a single number");
+    
+    a[0] = 100;
+    checkKernels(a, 1, b, 100, "a single number past the end");
+    
+    for(i = 0; i < 1000; i++) a[i] = b[i] = 3 * i;
+    checkKernels(a, 1000, b, 1000, "identical lists");
+    
+    for(i = 0; i < 1000; i++)
+    {
+        a[i] = 2 * i;
+        b[i] = 2 * i + 1;
+    }
+    checkKernels(a, 1000, b, 1000, "disjoint interleaved lists");
+    
+    for(i = 0; i < 1000; i++)
+    {
+        a[i] = i;
+        b[i] = 500 + i;
+    }
+    checkKernels(a, 1000, b, 1000, "half overlapping runs");
+    
+    for(i = 0; i < 37; i++) a[i] = 100000 + i;
+    for(i = 0; i < 5000; i++) b[i] = i;
+    checkKernels(a, 37, b, 5000, "a short list past the long one");
+    
+    /* Test random lists at every length ratio, odd lengths included to leave tails */
+    
+    for(r = 0; r < (int) (sizeof(ratios) / sizeof(ratios[0])); r++)
+    {
+        for(level = SIMD_SCALAR; level <= simdLevel(); level++)
+        {
+            ok = 1;
+            for(n = 1; n <= 150 && n * ratios[r] <= 200000; n += 7)
+            {
+                randomList(a, n, 4 * n * ratios[r]);
+                randomList(b, n * ratios[r], 4 * n * ratios[r]);
+                
+                if(!sameAsNaive(intersectKernel(level), a, n, b, n * ratios[r]))
+                {
+                    ok = 0;
+                }
+            }
+            
+            sprintf(text, "%s kernel on random lists at ratio 1:%d", levelNames[level], ratios[r]);
+            SW_ASSERT(ok == 1, text, tests_run, failures);
+        }
+    }
+    
+    /* Test dense lists, where most blocks match in several lanes */
+    
+    for(level = SIMD_SCALAR; level <= simdLevel(); level++)
+    {
+        ok = 1;
+        for(n = 10; n < 5000; n = n * 3 + 1)
+        {
+            randomList(a, n, n + n / 4);
+            randomList(b, n, n + n / 4);
+            
+            if(!sameAsNaive(intersectKernel(level), a, n, b, n))
+            {
+                ok = 0;
+            }
+        }
+        
+        sprintf(text, "%s kernel on dense random lists", levelNames[level]);
+        SW_ASSERT(ok == 1, text, tests_run, failures);
+    }
+    
+    /* Test the dispatcher picks one of them */
+    
+    randomList(a, 3000, 20000);
+    randomList(b, 9000, 20000);
+    SW_ASSERT(sameAsNaive(intersectSorted, a, 3000, b, 9000), "intersectSorted gives the merge's output.", tests_run, failures);
+}
+
+
+int main(int argc, char **argv) {
+    
+    tests_run = 0;
+    failures = 0;
+    
+    printf("Starting tests for Intersect...\n");
+    
+    run_tests();
+    
+    printf("Ran %d tests, with %d failures.\n", tests_run, failures);
+    if(failures == 0)
+    {
+        printf("ALL TESTS PASSED.\n");
+    }
+    return 0;
+}
@@ -0,0 +1,306 @@
+/* test_merge.c
+ *
+ * This file contains the tests for merging indexes (see
+ * mergeIndexes): the indexes of two directories merged have to
+ * answer every query the way one index of both does, and an input
+ * cut short has to fail the merge without leaving anything in the
+ * place of the output.
+ */
+
+/* mkdir and rmdir are POSIX, not ANSI */
+#define _XOPEN_SOURCE 600
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "testing.h"
+#include "../src/csearch.h"
+#include "../src/index.h"
+#include "../src/merge.h"
+
+#define TEST_DIR "test_merge_files"
+#define TEST_FIRST "test_merge_files/first"
+#define TEST_SECOND "test_merge_files/second"
+#define TEST_WHOLE "test_merge_whole.idx"
+#define TEST_INPUT_FIRST "test_merge_first.idx"
+#define TEST_INPUT_SECOND "test_merge_second.idx"
+#define TEST_MERGED "test_merge.idx"
+#define TEST_FILES 30
+#define TEST_WORDS 30
+#define TEST_VOCABULARY 200
+#define TEST_ANSWER 8192
+
+int tests_run, failures;
+
+/* Helpers */
+
+/* Files of words drawn from w0 ... w(TEST_VOCABULARY - 1) */
+int writeCorpus(char *dir)
+{
+    FILE *file;
+    char name[256];
+    int i, j;
+    
+    mkdir(dir, 0755);
+    
+    for(i = 0; i < TEST_FILES; i++)
+    {
+        sprintf(name, "%s/file%d.txt", dir, i);
+        file = fopen(name, "w");
+        if(file == NULL)
+        {
+            return 0;
+        }
+        
+        for(j = 0; j < TEST_WORDS; j++)
+        {
+            fprintf(file, "w%d ", rand() % TEST_VOCABULARY);
+        }
+        fclose(file);
+    }
+    
+    return 1;
+}
+
+void removeIndex(char *index)
+{
+    static char *suffixes[] = {POSITIONS_SUFFIX, LEXICON_SUFFIX, BLOCKMAX_SUFFIX, IMPACT_SUFFIX, ROARING_SUFFIX,
+                               PACKED_SUFFIX, TRIGRAM_SUFFIX, BLOOM_SUFFIX, MPHF_SUFFIX, STATS_SUFFIX};
+    int i;
+    
+    for(i = 0; i < (int) (sizeof(suffixes) / sizeof(suffixes[0])); i++)
+    {
+        removeSidecar(index, suffixes[i]);
+    }
+    remove(index);
+}
+
+void removeCorpus(void)
+{
+    char name[256];
+    int i;
+    
+    for(i = 0; i < TEST_FILES; i++)
+    {
+        sprintf(name, "%s/file%d.txt", TEST_FIRST, i);
+        remove(name);
+        sprintf(name, "%s/file%d.txt", TEST_SECOND, i);
+        remove(name);
+    }
+    rmdir(TEST_FIRST);
+    rmdir(TEST_SECOND);
+    rmdir(TEST_DIR);
+    
+    removeIndex(TEST_WHOLE);
+    removeIndex(TEST_INPUT_FIRST);
+    removeIndex(TEST_INPUT_SECOND);
+    removeIndex(TEST_MERGED);
+    removeIndex(TEST_MERGED MERGE_PART_SUFFIX);
+}
+
+int exists(char *name)
+{
+    FILE *file;
+    
+    file = fopen(name, "r");
+    if(file == NULL)
+    {
+        return 0;
+    }
+    fclose(file);
+    
+    return 1;
+}
+
+/* Cuts the closing </list> off the last list, as a write that died would */
+int truncateIndex(char *name)
+{
+    FILE *file;
+    char *data, *last, *next;
+    long size;
+    
+    file = fopen(name, "r");
+    if(file == NULL)
+    {
+        return 0;
+    }
+    
+    fseek(file, 0, SEEK_END);
+    size = ftell(file);
+    rewind(file);
+    
+    data = (char*) malloc(size + 1);
+    if(data == NULL || (long) fread(data, 1, size, file) != size)
+    {
+        free(data);
+        fclose(file);
+        return 0;
+    }
+    data[size] = '\0';
+    fclose(file);
+    
+    last = NULL;
+    for(next = strstr(data, "</list>"); next != NULL; next = strstr(next + 1, "</list>"))
+    {
+        last = next;
+    }
+    
+    file = (last != NULL) ? fopen(name, "w") : NULL;
+    if(file == NULL)
+    {
+        free(data);
+        return 0;
+    }
+    
+    fwrite(data, 1, last - data, file);
+    fclose(file);
+    free(data);
+    
+    return 1;
+}
+
+int compNames(const void *a, const void *b)
+{
+    return strcmp(*(char**) a, *(char**) b);
+}
+
+/* Writes down every file a query finds with its score, by name since the two indexes number files apart */
+int recordAnswer(char *index, char *query, char *answer)
+{
+    TokenizerT tok;
+    Filelist files;
+    Cache cache;
+    Result result;
+    char name[256], *found[2 * TEST_FILES];
+    int i, count;
+    
+    answer[0] = '\0';
+    
+    tok = TKCreate(FILE_CHARS, index);
+    files = (tok != NULL) ? getFilelist(tok) : NULL;
+    TKDestroy(tok);
+    
+    cache = createCache("1MB");
+    if(files == NULL || cache == NULL)
+    {
+        destroyCache(cache);
+        destroyFilelist(files);
+        return 0;
+    }
+    
+    search(query, files->tok, files, cache);
+    
+    count = 0;
+    for(result = files->results; result != NULL && count < 2 * TEST_FILES; result = result->next)
+    {
+        found[count] = (char*) malloc(sizeof(name) + 32);
+        if(found[count] == NULL || getFilename(files, result->filenum, name, sizeof(name)) == NULL)
+        {
+            free(found[count]);
+            break;
+        }
+        sprintf(found[count], "%s:%.6f ", name, result->score);
+        count++;
+    }
+    
+    qsort(found, count, sizeof(char*), compNames);
+    
+    for(i = 0; i < count; i++)
+    {
+        if(strlen(answer) + strlen(found[i]) < TEST_ANSWER)
+        {
+            strcat(answer, found[i]);
+        }
+        free(found[i]);
+    }
+    
+    resetResults(files);
+    destroyFilelist(files);
+    destroyCache(cache);
+    
+    return 1;
+}
+
+/* Every query has to find the same files, with the same scores, on the merged index as on the whole one */
+int sameAnswers(char **queries, int numqueries)
+{
+    char whole[TEST_ANSWER], merged[TEST_ANSWER];
+    int i, same;
+    
+    same = 1;
+    
+    for(i = 0; i < numqueries && same; i++)
+    {
+        same = recordAnswer(TEST_WHOLE, queries[i], whole) &&
+               recordAnswer(TEST_MERGED, queries[i], merged) &&
+               strcmp(whole, merged) == 0;
+        if(!same)
+        {
+            fprintf(stderr, "%s\n  whole:  %s\n  merged: %s\n", queries[i], whole, merged);
+        }
+    }
+    
+    return same;
+}
+
+/* Tests */
+
+void run_tests()
+{
+    char *queries[] = {"so w1 w2\n", "sa w10 w20\n", "so w100 AND NOT w7\n", "so w1*\n", "so \"w3 w4\"\n"};
+    char *inputs[2];
+    int ok;
+    
+    srand(7);
+    
+    removeCorpus();
+    mkdir(TEST_DIR, 0755);
+    ok = writeCorpus(TEST_FIRST) && writeCorpus(TEST_SECOND) &&
+         buildIndex(TEST_WHOLE, TEST_DIR, DEFAULT_CODEC, 1, 1) &&
+         buildIndex(TEST_INPUT_FIRST, TEST_FIRST, DEFAULT_CODEC, 1, 1) &&
+         buildIndex(TEST_INPUT_SECOND, TEST_SECOND, DEFAULT_CODEC, 1, 1);
+    SW_ASSERT(ok == 1, "Indexes of the test files built", tests_run, failures);
+    
+    /* Test the merged index answers as the index of every file does */
+    
+    inputs[0] = TEST_INPUT_FIRST;
+    inputs[1] = TEST_INPUT_SECOND;
+    
+    ok = ok && mergeIndexes(TEST_MERGED, inputs, 2) == 1;
+    SW_ASSERT(ok == 1, "Two indexes merged", tests_run, failures);
+    
+    ok = ok && sameAnswers(queries, 5);
+    SW_ASSERT(ok == 1, "The merged index finds what one index of every file finds", tests_run, failures);
+    
+    /* Test an input cut short fails the merge and leaves the output as it was */
+    
+    ok = truncateIndex(TEST_INPUT_SECOND);
+    SW_ASSERT(ok == 1, "An input cut off before its last </list>", tests_run, failures);
+    
+    SW_ASSERT(mergeIndexes(TEST_MERGED, inputs, 2) == 0, "A merge of a truncated input fails", tests_run, failures);
+    SW_ASSERT(exists(TEST_MERGED MERGE_PART_SUFFIX) == 0 && exists(TEST_MERGED MERGE_PART_SUFFIX LEXICON_SUFFIX) == 0,
+              "A merge that fails leaves nothing of its own behind", tests_run, failures);
+    SW_ASSERT(sameAnswers(queries, 5) == 1, "A merge that fails leaves the output it would have replaced", tests_run, failures);
+    
+    removeCorpus();
+}
+
+
+int main(int argc, char **argv) {
+    
+    tests_run = 0;
+    failures = 0;
+    
+    printf("Starting tests for Merge...\n");
+    
+    run_tests();
+    
+    printf("Ran %d tests, with %d failures.\n", tests_run, failures);
+    if(failures == 0)
+    {
+        printf("ALL TESTS PASSED.\n");
+    }
+    return 0;
+}
@@ -0,0 +1,119 @@
+/* test_mphf.c
+ *
+ * This file contains the tests for the minimal perfect hash of the
+ * lexicon: every term has to get back its own number, from the
+ * hash just built and from the one written next to an index.
+ * Built with a small MPHF_LEVELS (test_mphf_spill) most terms are
+ * left over after the last level, so the same tests go through
+ * the table of spilled terms.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "testing.h"
+#include "../src/mphf.h"
+
+#define TEST_INDEX "test_mphf.idx"
+
+int tests_run, failures;
+
+/* Helpers */
+
+/* The i-th term of a made up lexicon */
+void makeTerm(char *term, int i)
+{
+    sprintf(term, "t%d%c", i * 7919, 'a' + i % 26);
+}
+
+/* Every term has to come back with its own number */
+int findsAll(Mphf mphf, int count)
+{
+    char term[64];
+    int i;
+    
+    for(i = 0; i < count; i++)
+    {
+        makeTerm(term, i);
+        if(mphfLookup(mphf, term) != i)
+        {
+            return 0;
+        }
+    }
+    
+    return 1;
+}
+
+/* Tests */
+
+void run_tests()
+{
+    static const int sizes[] = {0, 1, 2, 7, 64, 1000, 100000};
+    char term[64], text[256];
+    Mphf mphf, loaded;
+    int s, i, ok;
+    
+    for(s = 0; s < (int) (sizeof(sizes) / sizeof(sizes[0])); s++)
+    {
+        mphf = createMphf();
+        ok = (mphf != NULL);
+        
+        for(i = 0; i < sizes[s] && ok; i++)
+        {
+            makeTerm(term, i);
+            ok = addMphf(mphf, term);
+        }
+        
+        ok = ok && buildMphf(mphf) == 1 && findsAll(mphf, sizes[s]);
+        
+        sprintf(text, "Each of %d terms gets its own number", sizes[s]);
+        SW_ASSERT(ok == 1, text, tests_run, failures);
+        
+        ok = ok && writeMphf(mphf, TEST_INDEX);
+        loaded = ok ? loadMphf(TEST_INDEX, sizes[s]) : NULL;
+        ok = (loaded != NULL && findsAll(loaded, sizes[s]));
+        
+        sprintf(text, "Each of %d terms gets its own number from disk", sizes[s]);
+        SW_ASSERT(ok == 1, text, tests_run, failures);
+        
+        destroyMphf(loaded);
+        destroyMphf(mphf);
+    }
+    
+    /* A hash of another lexicon is never used */
+    loaded = loadMphf(TEST_INDEX, 99999);
+    SW_ASSERT(loaded == NULL, "A hash of another number of terms is left out", tests_run, failures);
+    destroyMphf(loaded);
+    
+    /* Two terms with the same whole hash clash on every level and cannot be told apart */
+    mphf = createMphf();
+    ok = (mphf != NULL && addMphf(mphf, "twin") && addMphf(mphf, "other") && addMphf(mphf, "twin"));
+    SW_ASSERT(ok && buildMphf(mphf) == -1, "Terms that share their whole hash are a clash", tests_run, failures);
+    
+    ok = ok && writeMphf(mphf, TEST_INDEX);
+    loaded = loadMphf(TEST_INDEX, 3);
+    SW_ASSERT(ok && loaded == NULL, "No hash is left behind after a clash", tests_run, failures);
+    
+    destroyMphf(loaded);
+    destroyMphf(mphf);
+    
+    removeSidecar(TEST_INDEX, MPHF_SUFFIX);
+}
+
+
+int main(int argc, char **argv) {
+    
+    tests_run = 0;
+    failures = 0;
+    
+    printf("Starting tests for Mphf...\n");
+    
+    run_tests();
+    
+    printf("Ran %d tests, with %d failures.\n", tests_run, failures);
+    if(failures == 0)
+    {
+        printf("ALL TESTS PASSED.\n");
+    }
+    return 0;
+}
@@ -0,0 +1,278 @@
+/* test_near.c
+ *
+ * This file contains the tests for the NEAR/k operator (see
+ * getNear): terms joined by it have to find only the files holding
+ * all of them within k tokens of each other, in any order, a chain
+ * of them within the smallest k. NEAR/0 only ever matches a word
+ * with itself, and NEAR without a k, or with nothing to join, is a
+ * plain term. Scoring by proximity has to rank the file with the
+ * terms closest together first.
+ */
+
+/* mkdir and rmdir are POSIX, not ANSI */
+#define _XOPEN_SOURCE 600
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "testing.h"
+#include "../src/csearch.h"
+#include "../src/index.h"
+
+#define TEST_DIR "test_near_files"
+#define TEST_INDEX "test_near.idx"
+#define TEST_ANSWER 256
+
+int tests_run, failures;
+
+char *texts[] = {"the quick brown fox jumps over the lazy dog",
+                 "the lazy brown dog sleeps",
+                 "quick quick fox",
+                 "brown fox quick",
+                 "a fox that is quick and brown",
+                 "jumping jumper jumps"};
+
+#define TEST_FILES ((int) (sizeof(texts) / sizeof(texts[0])))
+
+/* Helpers */
+
+int writeCorpus(void)
+{
+    FILE *file;
+    char name[256];
+    int i;
+    
+    if(mkdir(TEST_DIR, 0755) != 0)
+    {
+        return 0;
+    }
+    
+    for(i = 0; i < TEST_FILES; i++)
+    {
+        sprintf(name, "%s/f%d.txt", TEST_DIR, i);
+        file = fopen(name, "w");
+        if(file == NULL)
+        {
+            return 0;
+        }
+        fprintf(file, "%s\n", texts[i]);
+        fclose(file);
+    }
+    
+    return 1;
+}
+
+void removeCorpus(void)
+{
+    static char *suffixes[] = {POSITIONS_SUFFIX, LEXICON_SUFFIX, BLOCKMAX_SUFFIX, IMPACT_SUFFIX, ROARING_SUFFIX,
+                               PACKED_SUFFIX, TRIGRAM_SUFFIX, BLOOM_SUFFIX, MPHF_SUFFIX, STATS_SUFFIX};
+    char name[256];
+    int i;
+    
+    for(i = 0; i < TEST_FILES; i++)
+    {
+        sprintf(name, "%s/f%d.txt", TEST_DIR, i);
+        remove(name);
+    }
+    rmdir(TEST_DIR);
+    
+    for(i = 0; i < (int) (sizeof(suffixes) / sizeof(suffixes[0])); i++)
+    {
+        removeSidecar(TEST_INDEX, suffixes[i]);
+    }
+    remove(TEST_INDEX);
+}
+
+Filelist openIndex(void)
+{
+    TokenizerT tok;
+    Filelist files;
+    
+    tok = TKCreate(FILE_CHARS, TEST_INDEX);
+    files = (tok != NULL) ? getFilelist(tok) : NULL;
+    TKDestroy(tok);
+    
+    return files;
+}
+
+/* Number of the file a name was written to: f3.txt is 3 */
+int fileNumber(Filelist files, int filenum)
+{
+    char name[256], *base;
+    
+    if(getFilename(files, filenum, name, sizeof(name)) == NULL)
+    {
+        return -1;
+    }
+    
+    base = strrchr(name, '/');
+    return atoi((base != NULL) ? base + 2 : name + 1);
+}
+
+/* The files a query finds as "f0 f3 ", in file order */
+int findFiles(char *query, char *answer)
+{
+    Filelist files;
+    Cache cache;
+    Result result;
+    int found[TEST_FILES], i, num;
+    
+    answer[0] = '\0';
+    
+    files = openIndex();
+    cache = createCache("1MB");
+    if(files == NULL || cache == NULL)
+    {
+        destroyCache(cache);
+        destroyFilelist(files);
+        return 0;
+    }
+    
+    for(i = 0; i < TEST_FILES; i++)
+    {
+        found[i] = 0;
+    }
+    
+    search(query, files->tok, files, cache);
+    
+    for(result = files->results; result != NULL; result = result->next)
+    {
+        num = fileNumber(files, result->filenum);
+        if(num >= 0 && num < TEST_FILES)
+        {
+            found[num] = 1;
+        }
+    }
+    
+    for(i = 0; i < TEST_FILES; i++)
+    {
+        if(found[i])
+        {
+            sprintf(answer + strlen(answer), "f%d ", i);
+        }
+    }
+    
+    resetResults(files);
+    destroyFilelist(files);
+    destroyCache(cache);
+    
+    return 1;
+}
+
+/* A query has to find exactly the files expected */
+int finds(char *query, char *expected)
+{
+    char answer[TEST_ANSWER];
+    
+    if(findFiles(query, answer) == 0)
+    {
+        return 0;
+    }
+    
+    if(strcmp(answer, expected) != 0)
+    {
+        fprintf(stderr, "%s  expected \"%s\", found \"%s\"\n", query, expected, answer);
+        return 0;
+    }
+    
+    return 1;
+}
+
+/* Number of the file a query ranks first, -1 if it finds none */
+int firstFile(char *query, int proximity)
+{
+    Filelist files;
+    Cache cache;
+    int first;
+    
+    files = openIndex();
+    cache = createCache("1MB");
+    if(files == NULL || cache == NULL)
+    {
+        destroyCache(cache);
+        destroyFilelist(files);
+        return -1;
+    }
+    
+    files->proximity = proximity;
+    search(query, files->tok, files, cache);
+    
+    first = (files->results != NULL) ? fileNumber(files, files->results->filenum) : -1;
+    
+    resetResults(files);
+    destroyFilelist(files);
+    destroyCache(cache);
+    
+    return first;
+}
+
+/* Tests */
+
+void run_tests()
+{
+    int ok;
+    
+    removeCorpus();
+    ok = writeCorpus() && buildIndex(TEST_INDEX, TEST_DIR, DEFAULT_CODEC, 0, 0);
+    SW_ASSERT(ok == 1, "Index of the test files built", tests_run, failures);
+    
+    /* Test the window, in either order */
+    
+    SW_ASSERT(finds("so quick NEAR/1 brown\n", "f0 ") == 1, "NEAR/1 finds the words next to each other",
+              tests_run, failures);
+    SW_ASSERT(finds("so brown NEAR/1 quick\n", "f0 ") == 1, "NEAR/1 finds them whichever comes first",
+              tests_run, failures);
+    SW_ASSERT(finds("so quick NEAR/2 brown\n", "f0 f3 f4 ") == 1, "NEAR/2 finds them a word apart, in any order",
+              tests_run, failures);
+    SW_ASSERT(finds("sa dog NEAR/3 lazy sleeps\n", "f1 ") == 1, "A NEAR group is one term of a query",
+              tests_run, failures);
+    
+    /* Test a chain is held to its smallest window */
+    
+    SW_ASSERT(finds("so quick NEAR/2 brown NEAR/9 fox\n", "f0 f3 ") == 1, "A chain of NEARs uses the smallest k",
+              tests_run, failures);
+    SW_ASSERT(finds("so quick NEAR/9 brown NEAR/1 fox\n", "") == 1, "Three words never fit in a window of 1",
+              tests_run, failures);
+    
+    /* Test the edge cases of the operator */
+    
+    SW_ASSERT(finds("so quick NEAR/0 brown\n", "") == 1, "NEAR/0 never matches two different words",
+              tests_run, failures);
+    SW_ASSERT(finds("so fox NEAR/0 fox\n", "f0 f2 f3 f4 ") == 1, "NEAR/0 matches a word with itself",
+              tests_run, failures);
+    SW_ASSERT(finds("so NEAR/2 fox\n", "f0 f2 f3 f4 ") == 1, "NEAR with nothing in front of it is dropped",
+              tests_run, failures);
+    SW_ASSERT(finds("so fox NEAR/2\n", "f0 f2 f3 f4 ") == 1, "NEAR with nothing after it is dropped",
+              tests_run, failures);
+    SW_ASSERT(finds("so dog NEAR/ sleeps\n", "f0 f1 ") == 1, "NEAR without a k is a word like any other",
+              tests_run, failures);
+    SW_ASSERT(finds("so jump* NEAR/1 fox\n", "f0 f2 f3 f4 f5 ") == 1, "A wildcard is never joined by NEAR",
+              tests_run, failures);
+    
+    /* Test proximity puts the file with the words closest together first */
+    
+    SW_ASSERT(firstFile("so brown quick\n", 1) == 0, "Scored by proximity the words next to each other rank first",
+              tests_run, failures);
+    
+    removeCorpus();
+}
+
+
+int main(int argc, char **argv) {
+    
+    tests_run = 0;
+    failures = 0;
+    
+    printf("Starting tests for Near...\n");
+    
+    run_tests();
+    
+    printf("Ran %d tests, with %d failures.\n", tests_run, failures);
+    if(failures == 0)
+    {
+        printf("ALL TESTS PASSED.\n");
+    }
+    return 0;
+}
@@ -0,0 +1,268 @@
+/* test_phrase.c
+ *
+ * This file contains the tests for quoted phrases (see getPhrase):
+ * the positions written next to an index have to read back as the
+ * files were tokenized (see readPositions), and a phrase has to
+ * find only the files holding its words one right after the other,
+ * however the quotes are left open or empty.
+ */
+
+/* mkdir and rmdir are POSIX, not ANSI */
+#define _XOPEN_SOURCE 600
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "testing.h"
+#include "../src/csearch.h"
+#include "../src/index.h"
+
+#define TEST_DIR "test_phrase_files"
+#define TEST_INDEX "test_phrase.idx"
+#define TEST_ANSWER 256
+
+int tests_run, failures;
+
+char *texts[] = {"the quick brown fox jumps over the lazy dog",
+                 "the lazy brown dog sleeps",
+                 "quick quick fox",
+                 "brown fox quick",
+                 "a fox that is quick and brown",
+                 "jumping jumper jumps"};
+
+#define TEST_FILES ((int) (sizeof(texts) / sizeof(texts[0])))
+
+/* Helpers */
+
+int writeCorpus(void)
+{
+    FILE *file;
+    char name[256];
+    int i;
+    
+    if(mkdir(TEST_DIR, 0755) != 0)
+    {
+        return 0;
+    }
+    
+    for(i = 0; i < TEST_FILES; i++)
+    {
+        sprintf(name, "%s/f%d.txt", TEST_DIR, i);
+        file = fopen(name, "w");
+        if(file == NULL)
+        {
+            return 0;
+        }
+        fprintf(file, "%s\n", texts[i]);
+        fclose(file);
+    }
+    
+    return 1;
+}
+
+void removeCorpus(void)
+{
+    static char *suffixes[] = {POSITIONS_SUFFIX, LEXICON_SUFFIX, BLOCKMAX_SUFFIX, IMPACT_SUFFIX, ROARING_SUFFIX,
+                               PACKED_SUFFIX, TRIGRAM_SUFFIX, BLOOM_SUFFIX, MPHF_SUFFIX, STATS_SUFFIX};
+    char name[256];
+    int i;
+    
+    for(i = 0; i < TEST_FILES; i++)
+    {
+        sprintf(name, "%s/f%d.txt", TEST_DIR, i);
+        remove(name);
+    }
+    rmdir(TEST_DIR);
+    
+    for(i = 0; i < (int) (sizeof(suffixes) / sizeof(suffixes[0])); i++)
+    {
+        removeSidecar(TEST_INDEX, suffixes[i]);
+    }
+    remove(TEST_INDEX);
+}
+
+Filelist openIndex(void)
+{
+    TokenizerT tok;
+    Filelist files;
+    
+    tok = TKCreate(FILE_CHARS, TEST_INDEX);
+    files = (tok != NULL) ? getFilelist(tok) : NULL;
+    TKDestroy(tok);
+    
+    return files;
+}
+
+/* Number of the file a name was written to: f3.txt is 3 */
+int fileNumber(Filelist files, int filenum)
+{
+    char name[256], *base;
+    
+    if(getFilename(files, filenum, name, sizeof(name)) == NULL)
+    {
+        return -1;
+    }
+    
+    base = strrchr(name, '/');
+    return atoi((base != NULL) ? base + 2 : name + 1);
+}
+
+/* The files a query finds as "f0 f3 ", in file order */
+int findFiles(char *query, char *answer)
+{
+    Filelist files;
+    Cache cache;
+    Result result;
+    int found[TEST_FILES], i, num;
+    
+    answer[0] = '\0';
+    
+    files = openIndex();
+    cache = createCache("1MB");
+    if(files == NULL || cache == NULL)
+    {
+        destroyCache(cache);
+        destroyFilelist(files);
+        return 0;
+    }
+    
+    for(i = 0; i < TEST_FILES; i++)
+    {
+        found[i] = 0;
+    }
+    
+    search(query, files->tok, files, cache);
+    
+    for(result = files->results; result != NULL; result = result->next)
+    {
+        num = fileNumber(files, result->filenum);
+        if(num >= 0 && num < TEST_FILES)
+        {
+            found[num] = 1;
+        }
+    }
+    
+    for(i = 0; i < TEST_FILES; i++)
+    {
+        if(found[i])
+        {
+            sprintf(answer + strlen(answer), "f%d ", i);
+        }
+    }
+    
+    resetResults(files);
+    destroyFilelist(files);
+    destroyCache(cache);
+    
+    return 1;
+}
+
+/* A query has to find exactly the files expected */
+int finds(char *query, char *expected)
+{
+    char answer[TEST_ANSWER];
+    
+    if(findFiles(query, answer) == 0)
+    {
+        return 0;
+    }
+    
+    if(strcmp(answer, expected) != 0)
+    {
+        fprintf(stderr, "%s  expected \"%s\", found \"%s\"\n", query, expected, answer);
+        return 0;
+    }
+    
+    return 1;
+}
+
+/* The positions of a word in a file have to read back as it was written: "the" is at 0 and 6 of f0 */
+int samePositions(char *term, int file, unsigned int *expected, int numexpected)
+{
+    Filelist files;
+    Word word;
+    PositionList lists;
+    int i, count, same;
+    
+    files = openIndex();
+    if(files == NULL)
+    {
+        return 0;
+    }
+    
+    word = getWord(files->tok, term, files->arena);
+    lists = (word != NULL) ? readPositions(files, word, &count) : NULL;
+    
+    same = 0;
+    for(i = 0; lists != NULL && i < count; i++)
+    {
+        if(fileNumber(files, lists[i].filenum) == file)
+        {
+            same = (lists[i].count == numexpected &&
+                    memcmp(lists[i].positions, expected, sizeof(unsigned int) * numexpected) == 0);
+        }
+    }
+    
+    destroyFilelist(files);
+    
+    return same;
+}
+
+/* Tests */
+
+void run_tests()
+{
+    unsigned int the[] = {0, 6}, quick[] = {0, 1}, jumps[] = {2};
+    int ok;
+    
+    removeCorpus();
+    ok = writeCorpus() && buildIndex(TEST_INDEX, TEST_DIR, DEFAULT_CODEC, 0, 0);
+    SW_ASSERT(ok == 1, "Index of the test files built", tests_run, failures);
+    
+    /* Test the positions read back as they were written */
+    
+    SW_ASSERT(samePositions("the", 0, the, 2) == 1, "Both positions of \"the\" read back", tests_run, failures);
+    SW_ASSERT(samePositions("quick", 2, quick, 2) == 1, "A word twice in a row reads back twice", tests_run, failures);
+    SW_ASSERT(samePositions("jumps", 5, jumps, 1) == 1, "A word last in a file reads back", tests_run, failures);
+    
+    /* Test a phrase finds its words in order and next to each other only */
+    
+    SW_ASSERT(finds("so \"quick brown\"\n", "f0 ") == 1, "A phrase finds the file it is in", tests_run, failures);
+    SW_ASSERT(finds("so \"brown fox\"\n", "f0 f3 ") == 1, "A phrase finds every file it is in", tests_run, failures);
+    SW_ASSERT(finds("so \"brown quick\"\n", "") == 1, "A phrase in the wrong order finds nothing", tests_run, failures);
+    SW_ASSERT(finds("so \"quick and brown\"\n", "f4 ") == 1, "A phrase of three words", tests_run, failures);
+    SW_ASSERT(finds("so \"quick quick\"\n", "f2 ") == 1, "A phrase of the same word twice", tests_run, failures);
+    SW_ASSERT(finds("so \"dog\"\n", "f0 f1 ") == 1, "A phrase of one word is the word", tests_run, failures);
+    SW_ASSERT(finds("sa \"lazy dog\" jumps\n", "f0 ") == 1, "A phrase is one term of a query", tests_run, failures);
+    
+    /* Test the quotes left open or empty */
+    
+    SW_ASSERT(finds("so \"quick brown\n", "f0 ") == 1, "A phrase left open runs to the end of the query",
+              tests_run, failures);
+    SW_ASSERT(finds("so \"\"\n", "") == 1, "An empty phrase finds nothing", tests_run, failures);
+    SW_ASSERT(finds("so dog \"\" sleeps\n", "f0 f1 ") == 1, "An empty phrase is dropped from a query",
+              tests_run, failures);
+    SW_ASSERT(finds("so dog \"\n", "f0 f1 ") == 1, "A quote opened at the end is dropped", tests_run, failures);
+    
+    removeCorpus();
+}
+
+
+int main(int argc, char **argv) {
+    
+    tests_run = 0;
+    failures = 0;
+    
+    printf("Starting tests for Phrase...\n");
+    
+    run_tests();
+    
+    printf("Ran %d tests, with %d failures.\n", tests_run, failures);
+    if(failures == 0)
+    {
+        printf("ALL TESTS PASSED.\n");
+    }
+    return 0;
+}
@@ -0,0 +1,108 @@
+/* test_pool.c
+ * 
+ * This file contains the unit tests for the Pool Object.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "testing.h"
+#include "../src/pool.h"
+
+int tests_run, failures;
+
+struct Node_ {
+    int value;
+    struct Node_* next;
+};
+
+typedef struct Node_* Node;
+
+/* Tests */
+
+void run_tests()
+{
+    Pool pool;
+    Node nodes[3000], node, reused;
+    int i, ok;
+    
+    /* Test pool Creation */
+    
+    pool = createPool(0, POOL_SLAB_ITEMS);
+    SW_ASSERT(pool == NULL, "Items must have a size.", tests_run, failures);
+    
+    pool = createPool(sizeof(struct Node_), 0);
+    SW_ASSERT(pool == NULL, "Slabs must hold at least one item.", tests_run, failures);
+    
+    pool = createPool(sizeof(struct Node_), 1000);
+    SW_ASSERT(pool != NULL, "Valid inputs produce a new Pool.", tests_run, failures);
+    
+    /* Test allocation across several slabs */
+    
+    ok = 1;
+    for(i = 0; i < 3000; i++)
+    {
+        nodes[i] = (Node) poolAlloc(pool);
+        if(nodes[i] == NULL || ((unsigned long) nodes[i]) % sizeof(void*) != 0)
+        {
+            ok = 0;
+        }
+        else
+        {
+            nodes[i]->value = i;
+        }
+    }
+    SW_ASSERT(ok == 1, "Allocated 3000 aligned items over three slabs.", tests_run, failures);
+    
+    ok = 1;
+    for(i = 0; i < 3000; i++)
+    {
+        if(nodes[i]->value != i) ok = 0;
+    }
+    SW_ASSERT(ok == 1, "Items do not overlap.", tests_run, failures);
+    
+    SW_ASSERT(poolAlloc(NULL) == NULL, "Cannot allocate from NULL pool.", tests_run, failures);
+    
+    /* Test freeing single items */
+    
+    node = nodes[1234];
+    poolFree(pool, node);
+    reused = (Node) poolAlloc(pool);
+    SW_ASSERT(reused == node, "Freed item is handed out again.", tests_run, failures);
+    
+    /* Test reset keeps the slabs */
+    
+    resetPool(pool);
+    node = (Node) poolAlloc(pool);
+    SW_ASSERT(node == nodes[0], "Reset starts over at the first slab.", tests_run, failures);
+    
+    for(i = 1; i < 2500; i++)
+    {
+        node = (Node) poolAlloc(pool);
+    }
+    SW_ASSERT(node == nodes[2499], "Reset reuses the later slabs in order.", tests_run, failures);
+    
+    destroyPool(pool);
+    pool = NULL;
+    
+    destroyPool(NULL);
+    SW_ASSERT(1, "Destroying a NULL pool does nothing.", tests_run, failures);
+}
+
+
+int main(int argc, char **argv) {
+
+    tests_run = 0;
+    failures = 0;
+    
+    printf("Starting tests for Pool...\n");
+    
+    run_tests();
+    
+    printf("Ran %d tests, with %d failures.\n", tests_run, failures);
+    if(failures == 0)
+    {
+        printf("ALL TESTS PASSED.\n");
+    }
+    return 0;
+}
@@ -0,0 +1,135 @@
+/* test_protocol.c
+ *
+ * This file contains the tests for the messages search servers and
+ * clients trade: whatever goes in one end has to come out the other
+ * whole, and anything too long or cut short has to be refused.
+ */
+
+/* socketpair and unlink are POSIX, not ANSI */
+#define _XOPEN_SOURCE 600
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include "testing.h"
+#include "../src/protocol.h"
+
+int tests_run, failures;
+
+/* Tests */
+
+void run_tests()
+{
+    static const unsigned long sizes[] = {0, 1, 3, 255, 256, 65536};
+    char *sent, *got, text[256], path[64];
+    unsigned long length;
+    FILE *file;
+    int ends[2], server, client, i, ok;
+    
+    sent = (char*) malloc(65536);
+    for(i = 0; i < 65536; i++)
+    {
+        sent[i] = (char) (i * 7 + 1);
+    }
+    
+    /* Test messages of every size come back whole */
+    
+    for(i = 0; i < (int) (sizeof(sizes) / sizeof(sizes[0])); i++)
+    {
+        socketpair(AF_UNIX, SOCK_STREAM, 0, ends);
+        
+        ok = writeMessage(ends[0], sent, sizes[i]);
+        got = readMessage(ends[1], MAX_REQUEST_SIZE, &length);
+        ok = ok && got != NULL && length == sizes[i] && memcmp(got, sent, length) == 0 && got[length] == '\0';
+        
+        sprintf(text, "A message of %lu bytes comes back whole", sizes[i]);
+        SW_ASSERT(ok == 1, text, tests_run, failures);
+        
+        free(got);
+        close(ends[0]);
+        close(ends[1]);
+    }
+    
+    /* Test several messages on one connection stay apart */
+    
+    socketpair(AF_UNIX, SOCK_STREAM, 0, ends);
+    writeMessage(ends[0], "so cats", 7);
+    writeMessage(ends[0], QUIT_REQUEST, strlen(QUIT_REQUEST));
+    
+    got = readMessage(ends[1], MAX_REQUEST_SIZE, &length);
+    ok = (got != NULL && strcmp(got, "so cats") == 0);
+    free(got);
+    
+    got = readMessage(ends[1], MAX_REQUEST_SIZE, &length);
+    ok = ok && (got != NULL && strcmp(got, QUIT_REQUEST) == 0);
+    free(got);
+    
+    SW_ASSERT(ok == 1, "Messages on one connection stay apart.", tests_run, failures);
+    
+    /* Test anything too long or cut short is refused */
+    
+    writeMessage(ends[0], sent, 100);
+    SW_ASSERT(readMessage(ends[1], 99, &length) == NULL, "A message past the limit is refused.", tests_run, failures);
+    close(ends[0]);
+    close(ends[1]);
+    
+    socketpair(AF_UNIX, SOCK_STREAM, 0, ends);
+    write(ends[0], "\0\0\0\x10half", 8);
+    close(ends[0]);
+    SW_ASSERT(readMessage(ends[1], MAX_REQUEST_SIZE, &length) == NULL, "A message cut short is refused.", tests_run, failures);
+    SW_ASSERT(readMessage(ends[1], MAX_REQUEST_SIZE, &length) == NULL, "Nothing comes after a hang up.", tests_run, failures);
+    close(ends[1]);
+    
+    /* Test a client that stalls partway through a message is given up on */
+    
+    socketpair(AF_UNIX, SOCK_STREAM, 0, ends);
+    write(ends[0], "\0\0\0\x10half", 8);
+    ok = limitSocket(ends[1], 1);
+    ok = ok && readMessage(ends[1], MAX_REQUEST_SIZE, &length) == NULL;
+    SW_ASSERT(ok == 1, "A message that stalls partway is given up on.", tests_run, failures);
+    close(ends[0]);
+    close(ends[1]);
+    
+    /* Test a server and a client find each other */
+    
+    sprintf(path, "/tmp/test_protocol.%d.sock", (int) getpid());
+    server = listenSocket(path);
+    client = connectSocket(path);
+    
+    SW_ASSERT(server >= 0 && client >= 0, "A client connects to a listening socket.", tests_run, failures);
+    
+    close(client);
+    close(server);
+    
+    SW_ASSERT(listenSocket(path) >= 0, "A socket left behind is replaced.", tests_run, failures);
+    unlink(path);
+    
+    SW_ASSERT(connectSocket(path) == -1, "Nothing to connect to without a server.", tests_run, failures);
+    
+    file = fopen(path, "w");
+    fclose(file);
+    SW_ASSERT(listenSocket(path) == -1, "A file that is not a socket is left alone.", tests_run, failures);
+    unlink(path);
+    
+    free(sent);
+}
+
+
+int main(int argc, char **argv) {
+    
+    tests_run = 0;
+    failures = 0;
+    
+    printf("Starting tests for Protocol...\n");
+    
+    run_tests();
+    
+    printf("Ran %d tests, with %d failures.\n", tests_run, failures);
+    if(failures == 0)
+    {
+        printf("ALL TESTS PASSED.\n");
+    }
+    return 0;
+}
@@ -0,0 +1,210 @@
+/* test_ranges.c
+ *
+ * This file contains the tests for a top-k search split into
+ * ranges of files scored on threads of their own (see searchTopK).
+ * It is built with MIN_RANGE_POSTINGS at 1, so even the lists of a
+ * small index are split, and every query has to find the same
+ * files, with the same scores, in the same order, as the search
+ * that scores all the files as one range. The threads have to be
+ * started once and kept for the searches after.
+ */
+
+/* mkdir and rmdir are POSIX, not ANSI */
+#define _XOPEN_SOURCE 600
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "testing.h"
+#include "../src/csearch.h"
+#include "../src/index.h"
+
+#define TEST_DIR "test_ranges_files"
+#define TEST_INDEX "test_ranges.idx"
+#define TEST_FILES 200
+#define TEST_WORDS 30
+#define TEST_VOCABULARY 40
+#define TEST_RANGES 4
+#define TEST_ANSWER 16384
+
+int tests_run, failures;
+
+/* Helpers */
+
+/* Files of words drawn from w0 ... w(TEST_VOCABULARY - 1), few enough that many files tie */
+int writeCorpus(void)
+{
+    FILE *file;
+    char name[256];
+    int i, j;
+    
+    if(mkdir(TEST_DIR, 0755) != 0)
+    {
+        return 0;
+    }
+    
+    for(i = 0; i < TEST_FILES; i++)
+    {
+        sprintf(name, "%s/file%d.txt", TEST_DIR, i);
+        file = fopen(name, "w");
+        if(file == NULL)
+        {
+            return 0;
+        }
+        
+        for(j = 0; j < TEST_WORDS; j++)
+        {
+            fprintf(file, "w%d ", rand() % TEST_VOCABULARY);
+        }
+        fclose(file);
+    }
+    
+    return 1;
+}
+
+void removeCorpus(void)
+{
+    static char *suffixes[] = {POSITIONS_SUFFIX, LEXICON_SUFFIX, BLOCKMAX_SUFFIX, IMPACT_SUFFIX, ROARING_SUFFIX,
+                               PACKED_SUFFIX, TRIGRAM_SUFFIX, BLOOM_SUFFIX, MPHF_SUFFIX, STATS_SUFFIX};
+    char name[256];
+    int i;
+    
+    for(i = 0; i < TEST_FILES; i++)
+    {
+        sprintf(name, "%s/file%d.txt", TEST_DIR, i);
+        remove(name);
+    }
+    rmdir(TEST_DIR);
+    
+    for(i = 0; i < (int) (sizeof(suffixes) / sizeof(suffixes[0])); i++)
+    {
+        removeSidecar(TEST_INDEX, suffixes[i]);
+    }
+    remove(TEST_INDEX);
+}
+
+Filelist openIndex(int k, int ranges)
+{
+    TokenizerT tok;
+    Filelist files;
+    
+    tok = TKCreate(FILE_CHARS, TEST_INDEX);
+    files = (tok != NULL) ? getFilelist(tok) : NULL;
+    TKDestroy(tok);
+    
+    if(files != NULL)
+    {
+        files->topk = k;
+        files->ranges = ranges;
+    }
+    
+    return files;
+}
+
+/* Writes down every file a query finds with its score, in the order they were found */
+void recordAnswer(Filelist files, Cache cache, char *query, char *answer)
+{
+    Result result;
+    char found[64];
+    
+    answer[0] = '\0';
+    
+    search(query, files->tok, files, cache);
+    
+    for(result = files->results; result != NULL; result = result->next)
+    {
+        sprintf(found, "%d:%.6f ", result->filenum, result->score);
+        if(strlen(answer) + strlen(found) < TEST_ANSWER)
+        {
+            strcat(answer, found);
+        }
+    }
+    
+    resetResults(files);
+}
+
+/* Every query has to find the same k files split into ranges as it does scored as one range */
+int sameAnswers(char **queries, int numqueries, int k)
+{
+    Filelist serial, split;
+    Cache cache;
+    ThreadPool pool;
+    char one[TEST_ANSWER], many[TEST_ANSWER];
+    int i, same;
+    
+    serial = openIndex(k, 1);
+    split = openIndex(k, TEST_RANGES);
+    cache = createCache("1MB");
+    same = (serial != NULL && split != NULL && cache != NULL);
+    
+    pool = NULL;
+    for(i = 0; i < numqueries && same; i++)
+    {
+        recordAnswer(serial, cache, queries[i], one);
+        recordAnswer(split, cache, queries[i], many);
+        
+        same = (one[0] != '\0' && strcmp(one, many) == 0);
+        if(!same)
+        {
+            fprintf(stderr, "%s  k %d\n  one range: %s\n  %d ranges: %s\n", queries[i], k, one, TEST_RANGES, many);
+        }
+        
+        /* One pool for every search of the Filelist, none for the one that is never split */
+        if(i == 0)
+        {
+            pool = split->rangePool;
+        }
+        same = same && pool != NULL && split->rangePool == pool && serial->rangePool == NULL;
+    }
+    
+    destroyCache(cache);
+    destroyFilelist(serial);
+    destroyFilelist(split);
+    
+    return same;
+}
+
+/* Tests */
+
+void run_tests()
+{
+    char *queries[] = {"so w1 w2\n", "so w3 w4 w5\n", "so w6\n", "so w1 w2\n", "so w7 w8 w9 w10 w11\n"};
+    int ok;
+    
+    srand(45);
+    
+    removeCorpus();
+    ok = writeCorpus() && buildIndex(TEST_INDEX, TEST_DIR, DEFAULT_CODEC, 0, 0);
+    SW_ASSERT(ok == 1, "Index of the test files built", tests_run, failures);
+    
+    /* Test the ranges find the best files, in order, for a few k */
+    
+    SW_ASSERT(ok && sameAnswers(queries, 5, 1) == 1, "Split into ranges, the best file is the best of one range",
+              tests_run, failures);
+    SW_ASSERT(ok && sameAnswers(queries, 5, 10) == 1, "Split into ranges, the best 10 files are the best 10 of one range",
+              tests_run, failures);
+    SW_ASSERT(ok && sameAnswers(queries, 5, TEST_FILES) == 1, "Split into ranges, every file is found as in one range",
+              tests_run, failures);
+    
+    removeCorpus();
+}
+
+
+int main(int argc, char **argv) {
+    
+    tests_run = 0;
+    failures = 0;
+    
+    printf("Starting tests for Ranges...\n");
+    
+    run_tests();
+    
+    printf("Ran %d tests, with %d failures.\n", tests_run, failures);
+    if(failures == 0)
+    {
+        printf("ALL TESTS PASSED.\n");
+    }
+    return 0;
+}
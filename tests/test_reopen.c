@@ -0,0 +1,292 @@
+/* test_reopen.c
+ *
+ * This file contains the tests for an index written anew while it
+ * is open: the prompt has to open it again (see reopenIndex) and
+ * answer from it as it is now, never with an answer the result
+ * cache kept from the index as it was, even when the new index is
+ * the same size as the old one and written within the same second.
+ * A server, which keeps the index open for every client, has to
+ * answer from the index as it is now as well, not from the words
+ * its cache kept, and an index that cannot be opened again has to
+ * leave the one that is open as it was.
+ */
+
+/* mkdir and rmdir are POSIX, not ANSI */
+#define _XOPEN_SOURCE 600
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "testing.h"
+#include "../src/csearch.h"
+#include "../src/index.h"
+#include "../src/server.h"
+
+#define TEST_DIR "test_reopen_files"
+#define TEST_INDEX "test_reopen.idx"
+#define TEST_FILES 20
+#define TEST_QUERY "so alpha\n"
+#define TEST_ANSWER 1024
+
+int tests_run, failures;
+
+/* Helpers */
+
+/* Files of "beta", the first few of which hold another word as well */
+int writeCorpus(char *word, int withWord)
+{
+    FILE *file;
+    char name[256];
+    int i;
+    
+    mkdir(TEST_DIR, 0755);
+    
+    for(i = 0; i < TEST_FILES; i++)
+    {
+        sprintf(name, "%s/file%d.txt", TEST_DIR, i);
+        file = fopen(name, "w");
+        if(file == NULL)
+        {
+            return 0;
+        }
+        
+        fprintf(file, (i < withWord) ? "%s beta\n" : "beta\n", word);
+        fclose(file);
+    }
+    
+    return 1;
+}
+
+/* Writes the index by hand, as a write that is not done yet leaves it */
+int writeIndex(char *text)
+{
+    FILE *file;
+    
+    file = fopen(TEST_INDEX, "w");
+    if(file == NULL)
+    {
+        return 0;
+    }
+    
+    fputs(text, file);
+    fclose(file);
+    
+    return 1;
+}
+
+void removeCorpus(void)
+{
+    static char *suffixes[] = {POSITIONS_SUFFIX, LEXICON_SUFFIX, BLOCKMAX_SUFFIX, IMPACT_SUFFIX,
+                               ROARING_SUFFIX, PACKED_SUFFIX, TRIGRAM_SUFFIX, BLOOM_SUFFIX, MPHF_SUFFIX};
+    char name[256];
+    int i;
+    
+    for(i = 0; i < TEST_FILES; i++)
+    {
+        sprintf(name, "%s/file%d.txt", TEST_DIR, i);
+        remove(name);
+    }
+    rmdir(TEST_DIR);
+    
+    for(i = 0; i < (int) (sizeof(suffixes) / sizeof(suffixes[0])); i++)
+    {
+        removeSidecar(TEST_INDEX, suffixes[i]);
+    }
+    remove(TEST_INDEX);
+}
+
+/* Opens the test index the way the prompt does */
+Filelist openIndex(void)
+{
+    TokenizerT tok;
+    Filelist files;
+    
+    tok = TKCreate(FILE_CHARS, TEST_INDEX);
+    files = (tok != NULL) ? getFilelist(tok) : NULL;
+    TKDestroy(tok);
+    
+    return files;
+}
+
+/* Number of files in an answer of the server, one per line */
+int countLines(char *answer)
+{
+    int lines;
+    
+    for(lines = 0; answer != NULL && *answer != '\0'; answer++)
+    {
+        lines += (*answer == '\n');
+    }
+    
+    return (answer != NULL) ? lines : -1;
+}
+
+long indexSize(void)
+{
+    struct stat info;
+    
+    return (stat(TEST_INDEX, &info) == 0) ? (long) info.st_size : -1;
+}
+
+/* Asks TEST_QUERY and writes down the files it found, in order */
+void recordAnswer(Filelist files, Cache cache, char *answer)
+{
+    Result result;
+    
+    answer[0] = '\0';
+    
+    search(TEST_QUERY, files->tok, files, cache);
+    
+    for(result = files->results; result != NULL && strlen(answer) + 16 < TEST_ANSWER; result = result->next)
+    {
+        sprintf(answer + strlen(answer), "%d ", result->filenum);
+    }
+    
+    resetResults(files);
+}
+
+/* Tests */
+
+void run_tests()
+{
+    char before[TEST_ANSWER], cached[TEST_ANSWER], after[TEST_ANSWER], fresh[TEST_ANSWER];
+    Filelist files, reopened, other;
+    Cache cache;
+    char *answer;
+    unsigned long length;
+    long size;
+    int ok;
+    
+    removeCorpus();
+    ok = writeCorpus("alpha", 1) && buildIndex(TEST_INDEX, TEST_DIR, DEFAULT_CODEC, 0, 0);
+    SW_ASSERT(ok == 1, "Index of the test files built", tests_run, failures);
+    
+    files = ok ? openIndex() : NULL;
+    cache = createCache("1MB");
+    ok = (files != NULL && cache != NULL);
+    
+    if(ok)
+    {
+        files->answers = createResultCache("1MB");
+        ok = (files->answers != NULL);
+    }
+    
+    if(!ok)
+    {
+        SW_ASSERT(ok == 1, "Index of the test files opened", tests_run, failures);
+        destroyCache(cache);
+        destroyFilelist(files);
+        removeCorpus();
+        return;
+    }
+    
+    /* Test the answer is kept and handed out again while the index stays as it is */
+    
+    recordAnswer(files, cache, before);
+    recordAnswer(files, cache, cached);
+    SW_ASSERT(before[0] != '\0' && strcmp(before, cached) == 0,
+              "A query asked again gets the same answer", tests_run, failures);
+    SW_ASSERT(reopenIndex(files) == files, "An index that was not written anew stays open as it is", tests_run, failures);
+    
+    /* Test the index written anew while it is open is opened again */
+    
+    ok = writeCorpus("alpha", 5) && buildIndex(TEST_INDEX, TEST_DIR, DEFAULT_CODEC, 0, 0);
+    SW_ASSERT(ok && indexGeneration(TEST_INDEX) != files->index->generation,
+              "Writing the index anew changes its generation", tests_run, failures);
+    
+    reopened = reopenIndex(files);
+    SW_ASSERT(reopened != NULL && reopened != files, "An index written anew is opened again", tests_run, failures);
+    
+    if(reopened != NULL)
+    {
+        files = reopened;
+    }
+    
+    /* A new word cache, as the prompt makes, so only the result cache could be stale */
+    destroyCache(cache);
+    cache = createCache("1MB");
+    
+    recordAnswer(files, cache, after);
+    
+    other = openIndex();
+    fresh[0] = '\0';
+    if(other != NULL)
+    {
+        recordAnswer(other, cache, fresh);
+    }
+    
+    SW_ASSERT(strcmp(after, before) != 0 && strcmp(after, fresh) == 0,
+              "The index opened again answers as it is now, not from the result cache", tests_run, failures);
+    
+    destroyFilelist(other);
+    
+    /* Test an index written anew to the very same size, within the same second, is told apart too
+       (aleph sorts where alpha did, so every list and offset keeps its length) */
+    
+    size = indexSize();
+    ok = writeCorpus("aleph", 5) && buildIndex(TEST_INDEX, TEST_DIR, DEFAULT_CODEC, 0, 0);
+    SW_ASSERT(ok && indexSize() == size && indexGeneration(TEST_INDEX) != files->index->generation,
+              "Writing the index anew to the same size changes its generation", tests_run, failures);
+    
+    reopened = reopenIndex(files);
+    SW_ASSERT(reopened != NULL && reopened != files, "An index written anew to the same size is opened again", tests_run, failures);
+    
+    if(reopened != NULL)
+    {
+        files = reopened;
+    }
+    
+    destroyCache(cache);
+    cache = createCache("1MB");
+    
+    recordAnswer(files, cache, after);
+    SW_ASSERT(after[0] == '\0', "The index written anew to the same size answers as it is now", tests_run, failures);
+    
+    /* Test a server answers from the index as it is now, not from the words its cache kept */
+    
+    answer = answerQuery("so aleph", files, cache, &length);
+    SW_ASSERT(countLines(answer) == 5, "The server answers from the index it opened", tests_run, failures);
+    free(answer);
+    
+    ok = writeCorpus("aleph", 2) && buildIndex(TEST_INDEX, TEST_DIR, DEFAULT_CODEC, 0, 0);
+    answer = answerQuery("so aleph", files, cache, &length);
+    SW_ASSERT(ok && countLines(answer) == 2, "The server answers from the index written anew, not from its word cache", tests_run, failures);
+    free(answer);
+    
+    /* Test an index that cannot be opened again leaves the open one as it was */
+    
+    ok = writeIndex("<files> 3 1\n\t0:0:test_reopen_files/file0.txt\n");
+    reopened = ok ? reopenIndex(files) : files;
+    SW_ASSERT(reopened == NULL, "A half written index is not opened again", tests_run, failures);
+    
+    answer = answerQuery("so aleph", files, cache, &length);
+    SW_ASSERT(answer != NULL && files->index->generation > 0, "The index that was open still answers", tests_run, failures);
+    free(answer);
+    
+    destroyResultCache(files->answers);
+    files->answers = NULL;
+    destroyFilelist(files);
+    destroyCache(cache);
+    
+    removeCorpus();
+}
+
+
+int main(int argc, char **argv) {
+    
+    tests_run = 0;
+    failures = 0;
+    
+    printf("Starting tests for Reopen...\n");
+    
+    run_tests();
+    
+    printf("Ran %d tests, with %d failures.\n", tests_run, failures);
+    if(failures == 0)
+    {
+        printf("ALL TESTS PASSED.\n");
+    }
+    return 0;
+}
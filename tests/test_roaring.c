@@ -0,0 +1,346 @@
+/* test_roaring.c
+ *
+ * This file contains the tests for the containers of common words:
+ * the files of a word written by writeContainers have to read back
+ * as exactly the same bitmap (see readContainers), in whichever
+ * container is smallest for each chunk, arrays, bitmaps and runs,
+ * and across chunks. nextBit has to find every bit set and no
+ * other. Boolean queries have to find the same files through the
+ * containers as they do through the lists alone.
+ */
+
+/* mkdir and rmdir are POSIX, not ANSI */
+#define _XOPEN_SOURCE 600
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "testing.h"
+#include "../src/csearch.h"
+#include "../src/index.h"
+#include "../src/roaring.h"
+
+#define TEST_DIR "test_roaring_files"
+#define TEST_INDEX "test_roaring.idx"
+#define TEST_ANSWER 256
+#define TEST_BITS (3 * CHUNK_FILES + 100)
+
+int tests_run, failures;
+
+char *texts[] = {"the quick brown fox jumps over the lazy dog",
+                 "the lazy brown dog sleeps",
+                 "quick quick fox",
+                 "brown fox quick",
+                 "a fox that is quick and brown",
+                 "jumping jumper jumps"};
+
+#define TEST_FILES ((int) (sizeof(texts) / sizeof(texts[0])))
+
+/* Helpers */
+
+int writeCorpus(void)
+{
+    FILE *file;
+    char name[256];
+    int i;
+    
+    if(mkdir(TEST_DIR, 0755) != 0)
+    {
+        return 0;
+    }
+    
+    for(i = 0; i < TEST_FILES; i++)
+    {
+        sprintf(name, "%s/f%d.txt", TEST_DIR, i);
+        file = fopen(name, "w");
+        if(file == NULL)
+        {
+            return 0;
+        }
+        fprintf(file, "%s\n", texts[i]);
+        fclose(file);
+    }
+    
+    return 1;
+}
+
+void removeCorpus(void)
+{
+    static char *suffixes[] = {POSITIONS_SUFFIX, LEXICON_SUFFIX, BLOCKMAX_SUFFIX, IMPACT_SUFFIX, ROARING_SUFFIX,
+                               PACKED_SUFFIX, TRIGRAM_SUFFIX, BLOOM_SUFFIX, MPHF_SUFFIX, STATS_SUFFIX};
+    char name[256];
+    int i;
+    
+    for(i = 0; i < TEST_FILES; i++)
+    {
+        sprintf(name, "%s/f%d.txt", TEST_DIR, i);
+        remove(name);
+    }
+    rmdir(TEST_DIR);
+    
+    for(i = 0; i < (int) (sizeof(suffixes) / sizeof(suffixes[0])); i++)
+    {
+        removeSidecar(TEST_INDEX, suffixes[i]);
+    }
+    remove(TEST_INDEX);
+}
+
+Filelist openIndex(void)
+{
+    TokenizerT tok;
+    Filelist files;
+    
+    tok = TKCreate(FILE_CHARS, TEST_INDEX);
+    files = (tok != NULL) ? getFilelist(tok) : NULL;
+    TKDestroy(tok);
+    
+    return files;
+}
+
+/* Number of the file a name was written to: f3.txt is 3 */
+int fileNumber(Filelist files, int filenum)
+{
+    char name[256], *base;
+    
+    if(getFilename(files, filenum, name, sizeof(name)) == NULL)
+    {
+        return -1;
+    }
+    
+    base = strrchr(name, '/');
+    return atoi((base != NULL) ? base + 2 : name + 1);
+}
+
+/* The files a query finds as "f0 f3 ", in file order */
+int findFiles(char *query, char *answer)
+{
+    Filelist files;
+    Cache cache;
+    Result result;
+    int found[TEST_FILES], i, num;
+    
+    answer[0] = '\0';
+    
+    files = openIndex();
+    cache = createCache("1MB");
+    if(files == NULL || cache == NULL)
+    {
+        destroyCache(cache);
+        destroyFilelist(files);
+        return 0;
+    }
+    
+    for(i = 0; i < TEST_FILES; i++)
+    {
+        found[i] = 0;
+    }
+    
+    search(query, files->tok, files, cache);
+    
+    for(result = files->results; result != NULL; result = result->next)
+    {
+        num = fileNumber(files, result->filenum);
+        if(num >= 0 && num < TEST_FILES)
+        {
+            found[num] = 1;
+        }
+    }
+    
+    for(i = 0; i < TEST_FILES; i++)
+    {
+        if(found[i])
+        {
+            sprintf(answer + strlen(answer), "f%d ", i);
+        }
+    }
+    
+    resetResults(files);
+    destroyFilelist(files);
+    destroyCache(cache);
+    
+    return 1;
+}
+
+/* A query has to find exactly the files expected */
+int finds(char *query, char *expected)
+{
+    char answer[TEST_ANSWER];
+    
+    if(findFiles(query, answer) == 0)
+    {
+        return 0;
+    }
+    
+    if(strcmp(answer, expected) != 0)
+    {
+        fprintf(stderr, "%s  expected \"%s\", found \"%s\"\n", query, expected, answer);
+        return 0;
+    }
+    
+    return 1;
+}
+
+/* Writes a word in the files listed, reads it back and checks the bitmap holds them and nothing else */
+int readsBack(int *list, int count, int kind)
+{
+    FILE *file;
+    Word word;
+    Entry ent;
+    unsigned long *bits;
+    unsigned char header[3];
+    long offset;
+    int i, bit, same;
+    
+    word = createWord("term");
+    bits = (unsigned long*) malloc(sizeof(unsigned long) * BITMAP_WORDS(TEST_BITS));
+    file = tmpfile();
+    same = (word != NULL && bits != NULL && file != NULL);
+    
+    /* Entries go in by hand, insertEntry would look for each file through the whole list */
+    for(i = count - 1; i >= 0 && same; i--)
+    {
+        ent = createEntry(NULL, list[i], 1);
+        same = (ent != NULL);
+        if(same)
+        {
+            ent->next = word->head;
+            word->head = ent;
+            word->numFiles++;
+        }
+    }
+    
+    offset = same ? writeContainers(file, word) : -1;
+    same = (offset >= 0) && readContainers(file, offset, bits, TEST_BITS);
+    
+    /* One chunk of key 0: #chunks, key and kind take a byte each */
+    if(same && kind >= 0)
+    {
+        same = (fseek(file, offset, SEEK_SET) == 0 && fread(header, 1, 3, file) == 3 &&
+                header[0] == 1 && header[1] == 0 && header[2] == kind);
+    }
+    
+    /* nextBit has to land on every file in turn, then on the end */
+    bit = -1;
+    for(i = 0; i < count && same; i++)
+    {
+        bit = nextBit(bits, TEST_BITS, bit + 1);
+        same = (bit == list[i]);
+    }
+    same = same && nextBit(bits, TEST_BITS, bit + 1) == TEST_BITS;
+    
+    if(file != NULL)
+    {
+        fclose(file);
+    }
+    free(bits);
+    destroyWord(word);
+    
+    return same;
+}
+
+/* Tests */
+
+void run_tests()
+{
+    char *queries[] = {"sa brown quick\n", "so lazy dog\n", "sa brown NOT dog\n", "so NOT fox\n",
+                       "so (fox AND quick) OR sleeps\n"};
+    char *expected[] = {"f0 f3 f4 ", "f0 f1 ", "f3 f4 ", "f1 f5 ", "f0 f1 f2 f3 f4 "};
+    int *list, i, n, ok;
+    
+    list = (int*) malloc(sizeof(int) * TEST_BITS);
+    SW_ASSERT(list != NULL, "Room for the files of a word", tests_run, failures);
+    if(list == NULL)
+    {
+        return;
+    }
+    
+    /* Test each kind of container reads back */
+    
+    list[0] = 3;
+    list[1] = 100;
+    list[2] = 5000;
+    SW_ASSERT(readsBack(list, 3, CONTAINER_ARRAY) == 1, "A few files go in an array and read back",
+              tests_run, failures);
+    
+    for(i = 0; i < CHUNK_FILES / 2; i++)
+    {
+        list[i] = 2 * i;
+    }
+    SW_ASSERT(readsBack(list, CHUNK_FILES / 2, CONTAINER_BITMAP) == 1, "Every other file goes in a bitmap and reads back",
+              tests_run, failures);
+    
+    for(i = 0; i < 30000; i++)
+    {
+        list[i] = 1000 + i;
+    }
+    SW_ASSERT(readsBack(list, 30000, CONTAINER_RUN) == 1, "Files in a row go in a run and read back",
+              tests_run, failures);
+    
+    for(i = 0; i < CHUNK_FILES; i++)
+    {
+        list[i] = i;
+    }
+    SW_ASSERT(readsBack(list, CHUNK_FILES, CONTAINER_RUN) == 1, "A whole chunk reads back", tests_run, failures);
+    
+    list[0] = 0;
+    SW_ASSERT(readsBack(list, 1, CONTAINER_ARRAY) == 1, "A word in the first file only", tests_run, failures);
+    
+    /* Test a word across chunks, each in a container of its own kind */
+    
+    n = 0;
+    for(i = CHUNK_FILES - 10; i < CHUNK_FILES + 10; i++)
+    {
+        list[n++] = i;
+    }
+    for(i = CHUNK_FILES + 100; i < 2 * CHUNK_FILES; i += 3)
+    {
+        list[n++] = i;
+    }
+    list[n++] = 3 * CHUNK_FILES + 99;
+    SW_ASSERT(readsBack(list, n, -1) == 1, "A word across chunks reads back, up to the last file",
+              tests_run, failures);
+    
+    free(list);
+    
+    /* Test queries find the same files through the containers as through the lists */
+    
+    removeCorpus();
+    ok = writeCorpus() && buildIndex(TEST_INDEX, TEST_DIR, DEFAULT_CODEC, 0, 0);
+    SW_ASSERT(ok == 1, "Index of the test files built", tests_run, failures);
+    
+    for(i = 0; i < 5; i++)
+    {
+        SW_ASSERT(finds(queries[i], expected[i]) == 1, "A query finds its files through the containers",
+                  tests_run, failures);
+    }
+    
+    removeSidecar(TEST_INDEX, ROARING_SUFFIX);
+    
+    for(i = 0; i < 5; i++)
+    {
+        SW_ASSERT(finds(queries[i], expected[i]) == 1, "A query finds the same files without them",
+                  tests_run, failures);
+    }
+    
+    removeCorpus();
+}
+
+
+int main(int argc, char **argv) {
+    
+    tests_run = 0;
+    failures = 0;
+    
+    printf("Starting tests for Roaring...\n");
+    
+    run_tests();
+    
+    printf("Ran %d tests, with %d failures.\n", tests_run, failures);
+    if(failures == 0)
+    {
+        printf("ALL TESTS PASSED.\n");
+    }
+    return 0;
+}
@@ -0,0 +1,363 @@
+/* test_shard.c
+ *
+ * This file contains the tests for a sharded index: every query
+ * answered by all the shards together (see answerShards) has to
+ * find the same files, in the same order, as it does on one index
+ * of every file, wildcards and fuzzy terms that match more than
+ * MAX_EXPANSIONS terms included. The shards merged into one index
+ * (see mergeIndexes) have to count and score every file the same.
+ */
+
+/* mkdir and rmdir are POSIX, not ANSI */
+#define _XOPEN_SOURCE 600
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "testing.h"
+#include "../src/csearch.h"
+#include "../src/index.h"
+#include "../src/merge.h"
+#include "../src/server.h"
+#include "../src/shard.h"
+
+#define TEST_DIR "test_shard_files"
+#define TEST_INDEX "test_shard.idx"
+#define TEST_PLAIN "test_shard_plain.idx"
+#define TEST_MERGED "test_shard_merged.idx"
+#define TEST_SHARDS 3
+#define TEST_FILES 90
+#define TEST_WORDS 40
+#define TEST_VOCABULARY 600
+#define TEST_ANSWER 16384
+
+int tests_run, failures;
+
+/* Helpers */
+
+/* Files of words drawn from w0 ... w(TEST_VOCABULARY - 1) */
+int writeCorpus(void)
+{
+    FILE *file;
+    char name[256];
+    int i, j;
+    
+    if(mkdir(TEST_DIR, 0755) != 0)
+    {
+        return 0;
+    }
+    
+    for(i = 0; i < TEST_FILES; i++)
+    {
+        sprintf(name, "%s/file%d.txt", TEST_DIR, i);
+        file = fopen(name, "w");
+        if(file == NULL)
+        {
+            return 0;
+        }
+        
+        for(j = 0; j < TEST_WORDS; j++)
+        {
+            fprintf(file, "w%d ", rand() % TEST_VOCABULARY);
+        }
+        fclose(file);
+    }
+    
+    return 1;
+}
+
+void removeIndex(char *index)
+{
+    static char *suffixes[] = {POSITIONS_SUFFIX, LEXICON_SUFFIX, BLOCKMAX_SUFFIX, IMPACT_SUFFIX, ROARING_SUFFIX,
+                               PACKED_SUFFIX, TRIGRAM_SUFFIX, BLOOM_SUFFIX, MPHF_SUFFIX, STATS_SUFFIX};
+    int i;
+    
+    for(i = 0; i < (int) (sizeof(suffixes) / sizeof(suffixes[0])); i++)
+    {
+        removeSidecar(index, suffixes[i]);
+    }
+    remove(index);
+}
+
+void removeCorpus(void)
+{
+    char name[256], *shard;
+    int i;
+    
+    for(i = 0; i < TEST_FILES; i++)
+    {
+        sprintf(name, "%s/file%d.txt", TEST_DIR, i);
+        remove(name);
+    }
+    rmdir(TEST_DIR);
+    
+    for(i = 0; i < TEST_SHARDS; i++)
+    {
+        shard = shardName(TEST_INDEX, i);
+        if(shard != NULL)
+        {
+            removeIndex(shard);
+            free(shard);
+        }
+    }
+    
+    removeIndex(TEST_INDEX);
+    removeIndex(TEST_PLAIN);
+    removeIndex(TEST_MERGED);
+}
+
+/* Builds the index both whole and split into TEST_SHARDS shards, the way index does */
+int buildIndexes(void)
+{
+    char shards[8], *argv[5];
+    
+    sprintf(shards, "%d", TEST_SHARDS);
+    
+    argv[0] = "index";
+    argv[1] = TEST_PLAIN;
+    argv[2] = TEST_DIR;
+    
+    if(runindex(3, argv) != 1)
+    {
+        return 0;
+    }
+    
+    argv[1] = "-s";
+    argv[2] = shards;
+    argv[3] = TEST_INDEX;
+    argv[4] = TEST_DIR;
+    
+    runindex(5, argv);
+    
+    return isManifest(TEST_INDEX);
+}
+
+/* Merges the shards back into one index */
+int mergeShards(void)
+{
+    char *shards[TEST_SHARDS];
+    int i, res;
+    
+    for(i = 0; i < TEST_SHARDS; i++)
+    {
+        shards[i] = shardName(TEST_INDEX, i);
+    }
+    
+    res = mergeIndexes(TEST_MERGED, shards, TEST_SHARDS);
+    
+    for(i = 0; i < TEST_SHARDS; i++)
+    {
+        free(shards[i]);
+    }
+    
+    return res;
+}
+
+/* The merged index has to count every term as the block of the sharded one does */
+int sameStats(void)
+{
+    Stats merged, sharded;
+    char term[16];
+    int i, same;
+    
+    merged = loadStats(TEST_MERGED);
+    sharded = loadStats(TEST_INDEX);
+    
+    same = (merged != NULL && sharded != NULL && statsFiles(merged) == statsFiles(sharded));
+    
+    for(i = 0; i < TEST_VOCABULARY && same; i++)
+    {
+        sprintf(term, "w%d", i);
+        same = (statsFrequency(merged, term) == statsFrequency(sharded, term));
+    }
+    
+    destroyStats(merged);
+    destroyStats(sharded);
+    
+    return same;
+}
+
+int compNames(const void *a, const void *b)
+{
+    return strcmp(*(char**) a, *(char**) b);
+}
+
+/* Writes down every file a query finds with its score, by name since the indexes number files apart */
+int recordScores(char *index, char *query, char *answer)
+{
+    TokenizerT tok;
+    Filelist files;
+    Cache cache;
+    Result result;
+    char name[256], *found[TEST_FILES];
+    int i, count;
+    
+    answer[0] = '\0';
+    
+    tok = TKCreate(FILE_CHARS, index);
+    files = (tok != NULL) ? getFilelist(tok) : NULL;
+    TKDestroy(tok);
+    
+    cache = createCache("1MB");
+    if(files == NULL || cache == NULL)
+    {
+        destroyCache(cache);
+        destroyFilelist(files);
+        return 0;
+    }
+    
+    search(query, files->tok, files, cache);
+    
+    count = 0;
+    for(result = files->results; result != NULL && count < TEST_FILES; result = result->next)
+    {
+        found[count] = (char*) malloc(sizeof(name) + 32);
+        if(found[count] == NULL || getFilename(files, result->filenum, name, sizeof(name)) == NULL)
+        {
+            free(found[count]);
+            break;
+        }
+        sprintf(found[count], "%s:%.6f ", name, result->score);
+        count++;
+    }
+    
+    qsort(found, count, sizeof(char*), compNames);
+    
+    for(i = 0; i < count; i++)
+    {
+        if(strlen(answer) + strlen(found[i]) < TEST_ANSWER)
+        {
+            strcat(answer, found[i]);
+        }
+        free(found[i]);
+    }
+    
+    resetResults(files);
+    destroyFilelist(files);
+    destroyCache(cache);
+    
+    return 1;
+}
+
+/* Every query has to score every file it finds on the merged index as it does on the whole one */
+int sameScores(char **queries, int numqueries)
+{
+    char whole[TEST_ANSWER], merged[TEST_ANSWER];
+    int i, same;
+    
+    same = 1;
+    
+    for(i = 0; i < numqueries && same; i++)
+    {
+        same = recordScores(TEST_PLAIN, queries[i], whole) &&
+               recordScores(TEST_MERGED, queries[i], merged) &&
+               whole[0] != '\0' && strcmp(whole, merged) == 0;
+        if(!same)
+        {
+            fprintf(stderr, "%s\n  whole:  %s\n  merged: %s\n", queries[i], whole, merged);
+        }
+    }
+    
+    return same;
+}
+
+/* Every query has to find on the shards what it finds on the whole index */
+int sameAnswers(char **queries, int numqueries)
+{
+    TokenizerT tok;
+    Filelist files;
+    Coordinator coordinator;
+    Cache cache;
+    char *whole, *sharded;
+    unsigned long length;
+    int i, same;
+    
+    tok = TKCreate(FILE_CHARS, TEST_PLAIN);
+    files = (tok != NULL) ? getFilelist(tok) : NULL;
+    TKDestroy(tok);
+    
+    cache = createCache("1MB");
+    coordinator = startShards(TEST_INDEX, "1MB", 0, 0, 1);
+    same = (files != NULL && cache != NULL && coordinator != NULL);
+    
+    for(i = 0; i < numqueries && same; i++)
+    {
+        whole = answerQuery(queries[i], files, cache, &length);
+        sharded = answerShards(coordinator, queries[i], &length);
+        
+        same = (whole != NULL && sharded != NULL && strcmp(whole, sharded) == 0);
+        if(!same)
+        {
+            fprintf(stderr, "%s\n  whole:   %s\n  sharded: %s\n", queries[i], whole, sharded);
+        }
+        
+        free(whole);
+        free(sharded);
+    }
+    
+    stopShards(coordinator);
+    destroyCache(cache);
+    destroyFilelist(files);
+    
+    return same;
+}
+
+/* Tests */
+
+void run_tests()
+{
+    char *plain[] = {"so w1 w2", "sa w10 w20", "so w100 AND NOT w200"};
+    char *wildcards[] = {"so w*", "so w?? w5*", "sa w* w1"};
+    char *fuzzy[] = {"so w12~2", "so w345~2 w1"};
+    char *scored[] = {"so w1 w2\n", "so w10 w20 w30\n", "sa w5 w6\n"};
+    int ok;
+    
+    srand(42);
+    
+    removeCorpus();
+    ok = writeCorpus() && buildIndexes();
+    SW_ASSERT(ok == 1, "Index of the test files built whole and sharded", tests_run, failures);
+    
+    ok = ok && sameAnswers(plain, 3);
+    SW_ASSERT(ok == 1, "The shards find what the whole index finds", tests_run, failures);
+    
+    /* w* matches every term, many more than MAX_EXPANSIONS, so each shard's own counts would keep others */
+    ok = ok && sameAnswers(wildcards, 3);
+    SW_ASSERT(ok == 1, "The shards expand a wildcard to the terms the whole index does", tests_run, failures);
+    
+    ok = ok && sameAnswers(fuzzy, 2);
+    SW_ASSERT(ok == 1, "The shards expand a fuzzy term to the terms the whole index does", tests_run, failures);
+    
+    /* Test the shards merged into one index keep the counts and the scores of the sharded one */
+    
+    ok = ok && mergeShards();
+    SW_ASSERT(ok == 1, "The shards merged into one index", tests_run, failures);
+    
+    ok = ok && sameStats();
+    SW_ASSERT(ok == 1, "The merged index counts every term as the sharded index does", tests_run, failures);
+    
+    ok = ok && sameScores(scored, 3);
+    SW_ASSERT(ok == 1, "The merged index scores every file as the whole index does", tests_run, failures);
+    
+    removeCorpus();
+}
+
+
+int main(int argc, char **argv) {
+    
+    tests_run = 0;
+    failures = 0;
+    
+    printf("Starting tests for Shard...\n");
+    
+    run_tests();
+    
+    printf("Ran %d tests, with %d failures.\n", tests_run, failures);
+    if(failures == 0)
+    {
+        printf("ALL TESTS PASSED.\n");
+    }
+    return 0;
+}
@@ -0,0 +1,299 @@
+/* test_substring.c
+ *
+ * This file contains the tests for substrings (see getSubstring):
+ * the trigrams written next to an index have to read back as the
+ * files held them, so the candidates of a string (see
+ * findCandidates) are every file holding all its trigrams, and a
+ * query between single quotes has to find exactly the files
+ * holding the text, whatever the case, spaces included, shorter
+ * than a trigram or with the quote left open.
+ */
+
+/* mkdir and rmdir are POSIX, not ANSI */
+#define _XOPEN_SOURCE 600
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "testing.h"
+#include "../src/csearch.h"
+#include "../src/index.h"
+#include "../src/trigram.h"
+
+#define TEST_DIR "test_substring_files"
+#define TEST_INDEX "test_substring.idx"
+#define TEST_ANSWER 256
+#define TEST_TRIGRAMS "test_substring_trigrams.idx"
+
+int tests_run, failures;
+
+char *texts[] = {"the quick brown fox jumps over the lazy dog",
+                 "the lazy brown dog sleeps",
+                 "quick quick fox",
+                 "brown fox quick",
+                 "a fox that is quick and brown",
+                 "jumping jumper jumps"};
+
+#define TEST_FILES ((int) (sizeof(texts) / sizeof(texts[0])))
+
+/* Helpers */
+
+int writeCorpus(void)
+{
+    FILE *file;
+    char name[256];
+    int i;
+    
+    if(mkdir(TEST_DIR, 0755) != 0)
+    {
+        return 0;
+    }
+    
+    for(i = 0; i < TEST_FILES; i++)
+    {
+        sprintf(name, "%s/f%d.txt", TEST_DIR, i);
+        file = fopen(name, "w");
+        if(file == NULL)
+        {
+            return 0;
+        }
+        fprintf(file, "%s\n", texts[i]);
+        fclose(file);
+    }
+    
+    return 1;
+}
+
+void removeCorpus(void)
+{
+    static char *suffixes[] = {POSITIONS_SUFFIX, LEXICON_SUFFIX, BLOCKMAX_SUFFIX, IMPACT_SUFFIX, ROARING_SUFFIX,
+                               PACKED_SUFFIX, TRIGRAM_SUFFIX, BLOOM_SUFFIX, MPHF_SUFFIX, STATS_SUFFIX};
+    char name[256];
+    int i;
+    
+    for(i = 0; i < TEST_FILES; i++)
+    {
+        sprintf(name, "%s/f%d.txt", TEST_DIR, i);
+        remove(name);
+    }
+    rmdir(TEST_DIR);
+    
+    for(i = 0; i < (int) (sizeof(suffixes) / sizeof(suffixes[0])); i++)
+    {
+        removeSidecar(TEST_INDEX, suffixes[i]);
+    }
+    remove(TEST_INDEX);
+    removeSidecar(TEST_TRIGRAMS, TRIGRAM_SUFFIX);
+}
+
+Filelist openIndex(void)
+{
+    TokenizerT tok;
+    Filelist files;
+    
+    tok = TKCreate(FILE_CHARS, TEST_INDEX);
+    files = (tok != NULL) ? getFilelist(tok) : NULL;
+    TKDestroy(tok);
+    
+    return files;
+}
+
+/* Number of the file a name was written to: f3.txt is 3 */
+int fileNumber(Filelist files, int filenum)
+{
+    char name[256], *base;
+    
+    if(getFilename(files, filenum, name, sizeof(name)) == NULL)
+    {
+        return -1;
+    }
+    
+    base = strrchr(name, '/');
+    return atoi((base != NULL) ? base + 2 : name + 1);
+}
+
+/* The files a query finds as "f0 f3 ", in file order */
+int findFiles(char *query, char *answer)
+{
+    Filelist files;
+    Cache cache;
+    Result result;
+    int found[TEST_FILES], i, num;
+    
+    answer[0] = '\0';
+    
+    files = openIndex();
+    cache = createCache("1MB");
+    if(files == NULL || cache == NULL)
+    {
+        destroyCache(cache);
+        destroyFilelist(files);
+        return 0;
+    }
+    
+    for(i = 0; i < TEST_FILES; i++)
+    {
+        found[i] = 0;
+    }
+    
+    search(query, files->tok, files, cache);
+    
+    for(result = files->results; result != NULL; result = result->next)
+    {
+        num = fileNumber(files, result->filenum);
+        if(num >= 0 && num < TEST_FILES)
+        {
+            found[num] = 1;
+        }
+    }
+    
+    for(i = 0; i < TEST_FILES; i++)
+    {
+        if(found[i])
+        {
+            sprintf(answer + strlen(answer), "f%d ", i);
+        }
+    }
+    
+    resetResults(files);
+    destroyFilelist(files);
+    destroyCache(cache);
+    
+    return 1;
+}
+
+/* A query has to find exactly the files expected */
+int finds(char *query, char *expected)
+{
+    char answer[TEST_ANSWER];
+    
+    if(findFiles(query, answer) == 0)
+    {
+        return 0;
+    }
+    
+    if(strcmp(answer, expected) != 0)
+    {
+        fprintf(stderr, "%s  expected \"%s\", found \"%s\"\n", query, expected, answer);
+        return 0;
+    }
+    
+    return 1;
+}
+
+/* Writes the trigrams of every test file next to an index of their own */
+int writeTrigramIndex(void)
+{
+    Trigrams trigrams;
+    char name[256];
+    int i, ok;
+    
+    trigrams = createTrigrams();
+    ok = (trigrams != NULL);
+    
+    for(i = 0; i < TEST_FILES && ok; i++)
+    {
+        sprintf(name, "%s/f%d.txt", TEST_DIR, i);
+        ok = addFileTrigrams(trigrams, name, i);
+    }
+    
+    ok = ok && writeTrigrams(trigrams, TEST_TRIGRAMS);
+    destroyTrigrams(trigrams);
+    
+    return ok;
+}
+
+/* The candidates of a string read back from the trigram stream have to be exactly the files expected */
+int candidates(char *str, char *expected)
+{
+    TrigramIndex trigrams;
+    char answer[TEST_ANSWER];
+    int files[TEST_FILES], count, i;
+    
+    answer[0] = '\0';
+    
+    trigrams = openTrigramIndex(TEST_TRIGRAMS);
+    count = (trigrams != NULL) ? findCandidates(trigrams, str, files) : -1;
+    closeTrigramIndex(trigrams);
+    
+    for(i = 0; i < count; i++)
+    {
+        sprintf(answer + strlen(answer), "f%d ", files[i]);
+    }
+    
+    if(count < 0 || strcmp(answer, expected) != 0)
+    {
+        fprintf(stderr, "%s  expected \"%s\", found \"%s\"\n", str, expected, answer);
+        return 0;
+    }
+    
+    return 1;
+}
+
+/* Tests */
+
+void run_tests()
+{
+    int ok;
+    
+    removeCorpus();
+    ok = writeCorpus() && buildIndex(TEST_INDEX, TEST_DIR, DEFAULT_CODEC, 0, 1);
+    SW_ASSERT(ok == 1, "Index of the test files built with trigrams", tests_run, failures);
+    
+    /* Test the trigrams read back as they were written */
+    
+    SW_ASSERT(ok && writeTrigramIndex() == 1, "Trigrams of the test files written", tests_run, failures);
+    SW_ASSERT(candidates("fox", "f0 f2 f3 f4 ") == 1, "One trigram reads back with every file holding it",
+              tests_run, failures);
+    SW_ASSERT(candidates("uick b", "f0 ") == 1, "The lists of every trigram of a string are intersected",
+              tests_run, failures);
+    SW_ASSERT(candidates("jumpi", "f5 ") == 1, "A trigram of a single file", tests_run, failures);
+    SW_ASSERT(candidates("xyz", "") == 1, "A trigram of no file has no candidates", tests_run, failures);
+    
+    /* Test candidates are checked against the files themselves */
+    
+    SW_ASSERT(countSubstring(TEST_DIR "/f2.txt", "quick") == 2, "Every occurrence in a file is counted",
+              tests_run, failures);
+    SW_ASSERT(countSubstring(TEST_DIR "/f0.txt", "QUICK BROWN") == 1, "Counting ignores case", tests_run, failures);
+    SW_ASSERT(countSubstring(TEST_DIR "/f3.txt", "quick brown") == 0, "The words in another order do not count",
+              tests_run, failures);
+    
+    /* Test a query finds the files holding the text */
+    
+    SW_ASSERT(finds("so 'uick b'\n", "f0 ") == 1, "Text across a space is found", tests_run, failures);
+    SW_ASSERT(finds("so 'OX Q'\n", "f3 ") == 1, "Text is found whatever its case", tests_run, failures);
+    SW_ASSERT(finds("so 'ox jumps ov'\n", "f0 ") == 1, "Text spanning three words is found", tests_run, failures);
+    SW_ASSERT(finds("so 'fox quick brown'\n", "") == 1, "Words of files in an order no file has finds nothing",
+              tests_run, failures);
+    SW_ASSERT(finds("sa 'qu' dog\n", "f0 ") == 1, "Text shorter than a trigram is found, as one term of a query",
+              tests_run, failures);
+    
+    /* Test the edge cases of the quotes */
+    
+    SW_ASSERT(finds("so 'uick b\n", "f0 ") == 1, "A quote left open runs to the end of the query",
+              tests_run, failures);
+    SW_ASSERT(finds("so ''\n", "") == 1, "Empty quotes find nothing", tests_run, failures);
+    SW_ASSERT(finds("so '' sleeps\n", "f1 ") == 1, "Empty quotes are dropped from a query", tests_run, failures);
+    
+    removeCorpus();
+}
+
+
+int main(int argc, char **argv) {
+    
+    tests_run = 0;
+    failures = 0;
+    
+    printf("Starting tests for Substring...\n");
+    
+    run_tests();
+    
+    printf("Ran %d tests, with %d failures.\n", tests_run, failures);
+    if(failures == 0)
+    {
+        printf("ALL TESTS PASSED.\n");
+    }
+    return 0;
+}
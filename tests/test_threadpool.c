@@ -0,0 +1,125 @@
+/* test_threadpool.c
+ *
+ * This file contains the tests for the thread pool the search
+ * server answers queries with: every job queued runs exactly once,
+ * on some thread's own state, and all of them are done by the time
+ * the pool is destroyed.
+ */
+
+/* Threads are POSIX, not ANSI */
+#define _XOPEN_SOURCE 600
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "testing.h"
+#include "../src/threadpool.h"
+
+#define NUM_JOBS 10000
+#define NUM_WORKERS 8
+
+int tests_run, failures;
+
+/* Each worker counts the jobs it ran, nobody else touches its count */
+int ran[NUM_WORKERS];
+
+/* Times each job ran, jobs of different workers can land at once */
+int done[NUM_JOBS];
+pthread_mutex_t doneLock = PTHREAD_MUTEX_INITIALIZER;
+
+/* Helpers */
+
+void countJob(void *worker, void *job)
+{
+    int *count, *times;
+    
+    count = (int*) worker;
+    times = (int*) job;
+    
+    (*count)++;
+    
+    pthread_mutex_lock(&doneLock);
+    (*times)++;
+    pthread_mutex_unlock(&doneLock);
+}
+
+/* Tests */
+
+void run_tests()
+{
+    ThreadPool pool;
+    void *workers[NUM_WORKERS];
+    int i, ok, total;
+    
+    memset(ran, 0, sizeof(ran));
+    memset(done, 0, sizeof(done));
+    
+    for(i = 0; i < NUM_WORKERS; i++)
+    {
+        workers[i] = &ran[i];
+    }
+    
+    /* Test bad pools are refused */
+    
+    SW_ASSERT(createThreadPool(0, countJob, NULL) == NULL, "A pool without threads is refused.", tests_run, failures);
+    SW_ASSERT(createThreadPool(MAX_THREADS + 1, countJob, NULL) == NULL, "A pool past MAX_THREADS is refused.", tests_run, failures);
+    SW_ASSERT(createThreadPool(2, NULL, NULL) == NULL, "A pool without a job function is refused.", tests_run, failures);
+    SW_ASSERT(submitJob(NULL, done) == 0, "A job for a NULL pool is refused.", tests_run, failures);
+    
+    /* Test every job runs exactly once */
+    
+    pool = createThreadPool(NUM_WORKERS, countJob, workers);
+    SW_ASSERT(pool != NULL, "A pool of 8 threads starts.", tests_run, failures);
+    
+    ok = 1;
+    for(i = 0; i < NUM_JOBS; i++)
+    {
+        ok = ok && submitJob(pool, &done[i]);
+    }
+    SW_ASSERT(ok == 1, "Every job is queued.", tests_run, failures);
+    
+    destroyThreadPool(pool);
+    
+    ok = 1;
+    for(i = 0; i < NUM_JOBS; i++)
+    {
+        ok = ok && (done[i] == 1);
+    }
+    SW_ASSERT(ok == 1, "Every job ran exactly once before the pool went away.", tests_run, failures);
+    
+    /* Test the jobs ran on the workers' own state */
+    
+    total = 0;
+    for(i = 0; i < NUM_WORKERS; i++)
+    {
+        total += ran[i];
+    }
+    SW_ASSERT(total == NUM_JOBS, "The workers' own counts add up to every job.", tests_run, failures);
+    
+    /* Test a pool with nothing to do stops too */
+    
+    pool = createThreadPool(3, countJob, NULL);
+    destroyThreadPool(pool);
+    SW_ASSERT(pool != NULL, "An idle pool starts and stops.", tests_run, failures);
+    
+    destroyThreadPool(NULL);
+}
+
+
+int main(int argc, char **argv) {
+    
+    tests_run = 0;
+    failures = 0;
+    
+    printf("Starting tests for Thread Pool...\n");
+    
+    run_tests();
+    
+    printf("Ran %d tests, with %d failures.\n", tests_run, failures);
+    if(failures == 0)
+    {
+        printf("ALL TESTS PASSED.\n");
+    }
+    return 0;
+}
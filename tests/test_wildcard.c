@@ -0,0 +1,312 @@
+/* test_wildcard.c
+ *
+ * This file contains the tests for prefix and wildcard terms (see
+ * getWildcard): the lexicon written next to an index has to read
+ * back sorted, every term found where it was written (see
+ * findTerm), a prefix has to give the range of terms starting with
+ * it (see findPrefix) and a pattern every term it matches (see
+ * expandWildcard). A query has to find the files holding any of
+ * them, a bare '*' every file.
+ */
+
+/* mkdir and rmdir are POSIX, not ANSI */
+#define _XOPEN_SOURCE 600
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "testing.h"
+#include "../src/csearch.h"
+#include "../src/index.h"
+#include "../src/lexicon.h"
+
+#define TEST_DIR "test_wildcard_files"
+#define TEST_INDEX "test_wildcard.idx"
+#define TEST_ANSWER 256
+
+int tests_run, failures;
+
+char *texts[] = {"the quick brown fox jumps over the lazy dog",
+                 "the lazy brown dog sleeps",
+                 "quick quick fox",
+                 "brown fox quick",
+                 "a fox that is quick and brown",
+                 "jumping jumper jumps"};
+
+#define TEST_FILES ((int) (sizeof(texts) / sizeof(texts[0])))
+
+/* Helpers */
+
+int writeCorpus(void)
+{
+    FILE *file;
+    char name[256];
+    int i;
+    
+    if(mkdir(TEST_DIR, 0755) != 0)
+    {
+        return 0;
+    }
+    
+    for(i = 0; i < TEST_FILES; i++)
+    {
+        sprintf(name, "%s/f%d.txt", TEST_DIR, i);
+        file = fopen(name, "w");
+        if(file == NULL)
+        {
+            return 0;
+        }
+        fprintf(file, "%s\n", texts[i]);
+        fclose(file);
+    }
+    
+    return 1;
+}
+
+void removeCorpus(void)
+{
+    static char *suffixes[] = {POSITIONS_SUFFIX, LEXICON_SUFFIX, BLOCKMAX_SUFFIX, IMPACT_SUFFIX, ROARING_SUFFIX,
+                               PACKED_SUFFIX, TRIGRAM_SUFFIX, BLOOM_SUFFIX, MPHF_SUFFIX, STATS_SUFFIX};
+    char name[256];
+    int i;
+    
+    for(i = 0; i < TEST_FILES; i++)
+    {
+        sprintf(name, "%s/f%d.txt", TEST_DIR, i);
+        remove(name);
+    }
+    rmdir(TEST_DIR);
+    
+    for(i = 0; i < (int) (sizeof(suffixes) / sizeof(suffixes[0])); i++)
+    {
+        removeSidecar(TEST_INDEX, suffixes[i]);
+    }
+    remove(TEST_INDEX);
+}
+
+Filelist openIndex(void)
+{
+    TokenizerT tok;
+    Filelist files;
+    
+    tok = TKCreate(FILE_CHARS, TEST_INDEX);
+    files = (tok != NULL) ? getFilelist(tok) : NULL;
+    TKDestroy(tok);
+    
+    return files;
+}
+
+/* Number of the file a name was written to: f3.txt is 3 */
+int fileNumber(Filelist files, int filenum)
+{
+    char name[256], *base;
+    
+    if(getFilename(files, filenum, name, sizeof(name)) == NULL)
+    {
+        return -1;
+    }
+    
+    base = strrchr(name, '/');
+    return atoi((base != NULL) ? base + 2 : name + 1);
+}
+
+/* The files a query finds as "f0 f3 ", in file order */
+int findFiles(char *query, char *answer)
+{
+    Filelist files;
+    Cache cache;
+    Result result;
+    int found[TEST_FILES], i, num;
+    
+    answer[0] = '\0';
+    
+    files = openIndex();
+    cache = createCache("1MB");
+    if(files == NULL || cache == NULL)
+    {
+        destroyCache(cache);
+        destroyFilelist(files);
+        return 0;
+    }
+    
+    for(i = 0; i < TEST_FILES; i++)
+    {
+        found[i] = 0;
+    }
+    
+    search(query, files->tok, files, cache);
+    
+    for(result = files->results; result != NULL; result = result->next)
+    {
+        num = fileNumber(files, result->filenum);
+        if(num >= 0 && num < TEST_FILES)
+        {
+            found[num] = 1;
+        }
+    }
+    
+    for(i = 0; i < TEST_FILES; i++)
+    {
+        if(found[i])
+        {
+            sprintf(answer + strlen(answer), "f%d ", i);
+        }
+    }
+    
+    resetResults(files);
+    destroyFilelist(files);
+    destroyCache(cache);
+    
+    return 1;
+}
+
+/* A query has to find exactly the files expected */
+int finds(char *query, char *expected)
+{
+    char answer[TEST_ANSWER];
+    
+    if(findFiles(query, answer) == 0)
+    {
+        return 0;
+    }
+    
+    if(strcmp(answer, expected) != 0)
+    {
+        fprintf(stderr, "%s  expected \"%s\", found \"%s\"\n", query, expected, answer);
+        return 0;
+    }
+    
+    return 1;
+}
+
+/* Every term of the lexicon, in the order it holds them: "a and brown " */
+void listTerms(Lexicon lex, int *terms, int numterms, char *answer)
+{
+    int i;
+    
+    answer[0] = '\0';
+    
+    for(i = 0; i < numterms; i++)
+    {
+        if(strlen(answer) + strlen(lexiconTerm(lex, terms[i])) + 2 < TEST_ANSWER)
+        {
+            strcat(answer, lexiconTerm(lex, terms[i]));
+            strcat(answer, " ");
+        }
+    }
+}
+
+/* A pattern has to expand to exactly the terms expected */
+int expands(Lexicon lex, char *pattern, char *expected)
+{
+    char answer[TEST_ANSWER];
+    int terms[MAX_EXPANSIONS], numterms;
+    
+    numterms = expandWildcard(lex, pattern, terms, MAX_EXPANSIONS);
+    listTerms(lex, terms, numterms, answer);
+    
+    if(strcmp(answer, expected) != 0)
+    {
+        fprintf(stderr, "%s  expected \"%s\", found \"%s\"\n", pattern, expected, answer);
+        return 0;
+    }
+    
+    return 1;
+}
+
+/* Tests */
+
+void run_tests()
+{
+    char *sorted = "a and brown dog fox is jumper jumping jumps lazy over quick sleeps that the ";
+    char answer[TEST_ANSWER];
+    int terms[MAX_EXPANSIONS], first, last, i, ok;
+    Lexicon lex;
+    
+    removeCorpus();
+    ok = writeCorpus() && buildIndex(TEST_INDEX, TEST_DIR, DEFAULT_CODEC, 0, 0);
+    SW_ASSERT(ok == 1, "Index of the test files built", tests_run, failures);
+    
+    /* Test the lexicon reads back sorted, every term where it was written */
+    
+    lex = loadLexicon(TEST_INDEX);
+    SW_ASSERT(lex != NULL && lexiconSize(lex) == 15, "The lexicon reads back with every term", tests_run, failures);
+    
+    for(i = 0; lex != NULL && i < lexiconSize(lex) && i < MAX_EXPANSIONS; i++)
+    {
+        terms[i] = i;
+    }
+    if(lex != NULL)
+    {
+        listTerms(lex, terms, lexiconSize(lex), answer);
+    }
+    SW_ASSERT(lex != NULL && strcmp(answer, sorted) == 0, "The lexicon holds its terms sorted", tests_run, failures);
+    
+    ok = (lex != NULL);
+    for(i = 0; ok && i < lexiconSize(lex); i++)
+    {
+        ok = (findTerm(lex, lexiconTerm(lex, i)) == i);
+    }
+    SW_ASSERT(ok == 1, "Every term is found where it was written", tests_run, failures);
+    SW_ASSERT(lex != NULL && findTerm(lex, "jump") == -1 && findTerm(lex, "zebra") == -1,
+              "A term not in the index is not found", tests_run, failures);
+    SW_ASSERT(lex != NULL && lexiconFrequency(lex, findTerm(lex, "fox")) == 4, "A term reads back with its files",
+              tests_run, failures);
+    
+    /* Test prefixes give one range of terms */
+    
+    first = (lex != NULL) ? findPrefix(lex, "jump", &last) : 0;
+    SW_ASSERT(lex != NULL && last - first == 3 && strcmp(lexiconTerm(lex, first), "jumper") == 0,
+              "A prefix gives the range of terms starting with it", tests_run, failures);
+    first = (lex != NULL) ? findPrefix(lex, "", &last) : 0;
+    SW_ASSERT(lex != NULL && first == 0 && last == lexiconSize(lex), "The empty prefix gives every term",
+              tests_run, failures);
+    first = (lex != NULL) ? findPrefix(lex, "zz", &last) : 0;
+    SW_ASSERT(lex != NULL && first == last, "A prefix of no term gives an empty range", tests_run, failures);
+    
+    /* Test patterns expand to the terms they match */
+    
+    SW_ASSERT(lex != NULL && expands(lex, "jump*", "jumper jumping jumps ") == 1, "A prefix pattern",
+              tests_run, failures);
+    SW_ASSERT(lex != NULL && expands(lex, "j*s", "jumps ") == 1, "A pattern with a suffix", tests_run, failures);
+    SW_ASSERT(lex != NULL && expands(lex, "*o*", "brown dog fox over ") == 1, "A pattern starting with '*'",
+              tests_run, failures);
+    SW_ASSERT(lex != NULL && expands(lex, "?", "a ") == 1, "A '?' stands for exactly one character",
+              tests_run, failures);
+    SW_ASSERT(lex != NULL && expands(lex, "*", sorted) == 1, "A bare '*' matches every term", tests_run, failures);
+    SW_ASSERT(lex != NULL && expands(lex, "**", sorted) == 1, "So does '*' twice", tests_run, failures);
+    SW_ASSERT(lex != NULL && expands(lex, "*zz*", "") == 1, "A pattern no term matches", tests_run, failures);
+    
+    destroyLexicon(lex);
+    
+    /* Test a query finds the files of every term a pattern matches */
+    
+    SW_ASSERT(finds("so jum*\n", "f0 f5 ") == 1, "A prefix finds the files of every term", tests_run, failures);
+    SW_ASSERT(finds("so qu?ck\n", "f0 f2 f3 f4 ") == 1, "A '?' in a query", tests_run, failures);
+    SW_ASSERT(finds("so *\n", "f0 f1 f2 f3 f4 f5 ") == 1, "A bare '*' finds every file", tests_run, failures);
+    SW_ASSERT(finds("sa * dog\n", "f0 f1 ") == 1, "A bare '*' AND'd with a term finds the term",
+              tests_run, failures);
+    SW_ASSERT(finds("so zz*\n", "") == 1, "A pattern no term matches finds nothing", tests_run, failures);
+    
+    removeCorpus();
+}
+
+
+int main(int argc, char **argv) {
+    
+    tests_run = 0;
+    failures = 0;
+    
+    printf("Starting tests for Wildcard...\n");
+    
+    run_tests();
+    
+    printf("Ran %d tests, with %d failures.\n", tests_run, failures);
+    if(failures == 0)
+    {
+        printf("ALL TESTS PASSED.\n");
+    }
+    return 0;
+}